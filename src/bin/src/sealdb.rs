@@ -3,6 +3,11 @@ mod config;
 use clap::Parser;
 use anyhow::Result;
 use config::Config;
+use server::Server;
+use sql::SqlEngine;
+use sql::executor::StorageExecutor;
+use std::sync::Arc;
+use storage::{EngineType, StorageConfig};
 
 #[derive(Parser)]
 #[command(name = "sealdb")]
@@ -218,9 +223,43 @@ fn start_server(config: &Config, cli: &Cli) -> Result<()> {
         println!("运行模式: 前台运行");
     }
 
-    // TODO: 这里应该启动实际的服务器
-    // 目前只是打印信息
+    let runtime = tokio::runtime::Runtime::new()?;
+    runtime.block_on(run_server(config))
+}
 
+/// 连接 TiKV，以它为存储启动 SQL 引擎与服务端，直到服务端退出
+///
+/// 引擎装上存储感知执行器后，查询按流从 TiKV 读取，LIMIT 凑满即停止扫描。
+async fn run_server(config: &Config) -> Result<()> {
+    let storage_config = StorageConfig {
+        engine_type: EngineType::TiKV,
+        connection_string: config.storage.tikv_pd_endpoints.join(","),
+        timeout_ms: config.storage.tikv_request_timeout,
+        ..StorageConfig::default()
+    };
+    let mut storage_executor = StorageExecutor::new();
+    storage_executor.set_default_engine(EngineType::TiKV);
+    storage_executor.register_storage_engine(EngineType::TiKV, storage_config).await?;
+    // 引擎按需创建，启动时先连上 PD，连接失败直接退出
+    let connect_timeout = std::time::Duration::from_millis(config.storage.tikv_connect_timeout);
+    tokio::time::timeout(connect_timeout, storage_executor.storage_handler().get_engine(None))
+        .await
+        .map_err(|_| anyhow::anyhow!("连接 TiKV PD 超时: {:?}", config.storage.tikv_pd_endpoints))??;
+
+    let mut engine = SqlEngine::new();
+    engine.set_storage_executor(storage_executor);
+    let engine = Arc::new(engine);
+
+    let server_config = common::config::ServerConfig {
+        host: config.server.host.clone(),
+        port: config.server.port,
+        max_connections: config.server.max_connections as usize,
+        ..common::config::ServerConfig::default()
+    };
+    Server::new(engine.clone(), server_config)
+        .with_metrics(engine.metrics_sources())
+        .run()
+        .await?;
     Ok(())
 }
 
@@ -1,11 +1,27 @@
-use std::collections::HashMap;
+//! 连接管理器
+//!
+//! 连接元数据放在固定大小的槽位数组里，状态与时间戳都是原子量；空闲连接按线程分片
+//! 放在多条无锁队列中。释放时放回当前线程的分片，获取时先取本分片、再从其他分片窃取，
+//! 获取/释放路径上只有 CAS，没有全局锁，也不再扫描整张连接表。
+//!
+//! 连接 id 的低 64 位是槽位下标、高 64 位是槽位代数，按 id 直接定位槽位；槽位回收后
+//! 再分配时代数递增，旧 id 随之失效，分片队列中残留的旧条目在出队时校验丢弃。
+//! 代数与槽位状态放在同一个原子字里，状态迁移总是连同代数一起 CAS，持有旧 id
+//! 或旧条目的一方不会误占、误关重新分配后的连接。
+//!
+//! 后台任务负责预热到 `min_connections`，并定期清理空闲超时与超过最大生存时间的连接；
+//! 获取和释放时也会检查生存时间，过期连接不会交给调用方。
+
+use std::cell::Cell;
+use std::sync::atomic::{AtomicU64, AtomicUsize, Ordering};
 use std::sync::Arc;
-use tokio::sync::{Mutex, RwLock};
+use tokio::sync::Notify;
 use tokio::time::{Duration, Instant};
 use tracing::{debug, info};
 use uuid::Uuid;
 
 use crate::{
+    mpmc_queue::MpmcQueue,
     thread_pool::{Connection, ConnectionState},
     Error, Result,
 };
@@ -52,311 +68,400 @@ pub struct ConnectionPoolStats {
     pub avg_acquire_time: f64,
 }
 
-/// 连接管理器
-pub struct ConnectionManager {
-    /// 配置
-    config: ConnectionPoolConfig,
-    /// 连接池
-    connections: Arc<RwLock<HashMap<Uuid, Connection>>>,
-    /// 空闲连接队列
-    idle_connections: Arc<Mutex<Vec<Uuid>>>,
-    /// 统计信息
-    stats: Arc<RwLock<ConnectionPoolStats>>,
-    /// 清理任务句柄
-    cleanup_handle: Option<tokio::task::JoinHandle<()>>,
+/// 后台维护 (预热、过期清理) 的间隔上限
+const MAINTENANCE_INTERVAL: Duration = Duration::from_secs(60);
+
+/// 获取耗时移动平均的平滑因子 (每个样本占 1/8)
+const ACQUIRE_EWMA_SHIFT: u32 = 3;
+
+/// 槽位状态
+const SLOT_EMPTY: u8 = 0;
+const SLOT_IDLE: u8 = 1;
+const SLOT_BUSY: u8 = 2;
+
+/// 状态字中状态所占的低位数
+const STATE_BITS: u32 = 2;
+
+fn pack(generation: u64, state: u8) -> u64 {
+    (generation << STATE_BITS) | state as u64
 }
 
-impl ConnectionManager {
-    /// 创建新的连接管理器
-    pub async fn new(config: ConnectionPoolConfig) -> Result<Self> {
-        let manager = Self {
-            config,
-            connections: Arc::new(RwLock::new(HashMap::new())),
-            idle_connections: Arc::new(Mutex::new(Vec::new())),
-            stats: Arc::new(RwLock::new(ConnectionPoolStats {
-                total_connections: 0,
-                active_connections: 0,
-                idle_connections: 0,
-                waiting_requests: 0,
-                avg_acquire_time: 0.0,
-            })),
-            cleanup_handle: None,
-        };
+/// 连接槽位
+struct Slot {
+    /// 状态字：高位是代数 (槽位每分配一次加一，与下标一起组成连接 id)，低位是状态
+    state: AtomicU64,
+    /// 相对连接池 epoch 的纳秒数
+    created_at: AtomicU64,
+    last_used: AtomicU64,
+    request_count: AtomicU64,
+    /// 会话信息，只有持有该连接的调用方会写入，不存在竞争
+    session: std::sync::Mutex<(Option<String>, Option<String>)>,
+}
 
-        // 启动清理任务
-        let cleanup_handle = manager.start_cleanup_task().await?;
+impl Slot {
+    fn new() -> Self {
+        Self {
+            state: AtomicU64::new(pack(0, SLOT_EMPTY)),
+            created_at: AtomicU64::new(0),
+            last_used: AtomicU64::new(0),
+            request_count: AtomicU64::new(0),
+            session: std::sync::Mutex::new((None, None)),
+        }
+    }
 
-        info!("ConnectionManager initialized successfully");
-        Ok(Self {
-            cleanup_handle: Some(cleanup_handle),
-            ..manager
-        })
+    /// 当前的 (代数, 状态)
+    fn load(&self) -> (u64, u8) {
+        let word = self.state.load(Ordering::Acquire);
+        (word >> STATE_BITS, (word & ((1 << STATE_BITS) - 1)) as u8)
     }
 
-    /// 启动清理任务
-    async fn start_cleanup_task(&self) -> Result<tokio::task::JoinHandle<()>> {
-        let connections = self.connections.clone();
-        let idle_connections = self.idle_connections.clone();
-        let stats = self.stats.clone();
-        let config = self.config.clone();
+    /// 仅当槽位仍是 `generation` 代且处于 `from` 状态时迁移到 `to`
+    fn transition(&self, generation: u64, from: u8, to: u8) -> bool {
+        self.state
+            .compare_exchange(pack(generation, from), pack(generation, to), Ordering::AcqRel, Ordering::Acquire)
+            .is_ok()
+    }
 
-        let handle = tokio::spawn(async move {
-            let mut interval = tokio::time::interval(Duration::from_secs(60));
+    fn set_session(&self, user_id: Option<String>, database: Option<String>) {
+        let mut session = self.session.lock().unwrap_or_else(|e| e.into_inner());
+        *session = (user_id, database);
+    }
+}
 
-            loop {
-                interval.tick().await;
+/// 分片队列中的空闲连接
+#[derive(Debug, Clone, Copy)]
+struct IdleEntry {
+    index: usize,
+    generation: u64,
+}
 
-                let now = Instant::now();
-                let mut to_remove = Vec::new();
-                let mut to_idle = Vec::new();
-
-                // 检查连接状态
-                {
-                    let mut connections_guard = connections.write().await;
-                    for (id, connection) in connections_guard.iter_mut() {
-                        // 检查连接是否超时
-                        if now.duration_since(connection.last_used).as_secs() > config.idle_timeout
-                            && connection.state == ConnectionState::Idle
-                        {
-                            to_remove.push(*id);
-                        }
-
-                        // 检查连接是否超过最大生存时间
-                        if now.duration_since(connection.created_at).as_secs() > config.max_lifetime
-                        {
-                            to_remove.push(*id);
-                        }
-
-                        // 将长时间忙碌的连接标记为空闲
-                        if connection.state == ConnectionState::Busy
-                            && now.duration_since(connection.last_used).as_secs() > 30
-                        {
-                            connection.state = ConnectionState::Idle;
-                            to_idle.push(*id);
-                        }
-                    }
+/// 当前线程的分片提示：线程首次访问时轮流分配，之后固定不变
+fn shard_hint() -> usize {
+    static NEXT_SHARD: AtomicUsize = AtomicUsize::new(0);
+    thread_local! {
+        static SHARD: Cell<Option<usize>> = const { Cell::new(None) };
+    }
+    SHARD.with(|shard| {
+        shard.get().unwrap_or_else(|| {
+            let assigned = NEXT_SHARD.fetch_add(1, Ordering::Relaxed);
+            shard.set(Some(assigned));
+            assigned
+        })
+    })
+}
 
-                    // 移除过期连接
-                    for id in &to_remove {
-                        connections_guard.remove(id);
-                    }
-                }
+/// 连接池共享状态，由管理器与后台维护任务共同持有
+struct PoolInner {
+    config: ConnectionPoolConfig,
+    /// 时间基准，槽位中的时间戳都是相对它的纳秒数
+    epoch: Instant,
+    slots: Box<[Slot]>,
+    /// 未分配连接的槽位
+    free_slots: MpmcQueue<usize>,
+    /// 按线程分片的空闲连接
+    idle_shards: Box<[MpmcQueue<IdleEntry>]>,
+    /// 有连接被释放或槽位被回收时唤醒一个等待者
+    released: Notify,
+    total: AtomicUsize,
+    active: AtomicUsize,
+    idle: AtomicUsize,
+    waiting: AtomicUsize,
+    acquire_nanos: AtomicU64,
+}
 
-                // 更新空闲连接队列
-                {
-                    let mut idle_guard = idle_connections.lock().await;
-                    for id in &to_idle {
-                        if !idle_guard.contains(id) {
-                            idle_guard.push(*id);
-                        }
-                    }
-                }
+impl PoolInner {
+    fn new(config: ConnectionPoolConfig) -> Self {
+        let max = config.max_connections;
+        let shards = std::thread::available_parallelism().map(|n| n.get()).unwrap_or(1).clamp(1, max);
+        let free_slots = MpmcQueue::with_capacity(max);
+        for index in 0..max {
+            let _ = free_slots.push(index);
+        }
+        Self {
+            // 每条分片都能容纳全部连接，另留同样多的余量给尚未清理的失效条目
+            idle_shards: (0..shards).map(|_| MpmcQueue::with_capacity(max * 2)).collect(),
+            slots: (0..max).map(|_| Slot::new()).collect(),
+            free_slots,
+            epoch: Instant::now(),
+            released: Notify::new(),
+            total: AtomicUsize::new(0),
+            active: AtomicUsize::new(0),
+            idle: AtomicUsize::new(0),
+            waiting: AtomicUsize::new(0),
+            acquire_nanos: AtomicU64::new(0),
+            config,
+        }
+    }
 
-                // 更新统计
-                {
-                    let mut stats_guard = stats.write().await;
-                    let connections_guard = connections.read().await;
-                    stats_guard.total_connections = connections_guard.len();
-                    stats_guard.idle_connections = idle_connections.lock().await.len();
-                    stats_guard.active_connections =
-                        connections_guard.len() - stats_guard.idle_connections;
-                }
+    fn now(&self) -> u64 {
+        Instant::now().saturating_duration_since(self.epoch).as_nanos() as u64
+    }
 
-                debug!(
-                    "Connection cleanup completed: removed {}, moved to idle: {}",
-                    to_remove.len(),
-                    to_idle.len()
-                );
-            }
-        });
+    fn connection_id(index: usize, generation: u64) -> Uuid {
+        Uuid::from_u64_pair(generation, index as u64)
+    }
 
-        Ok(handle)
+    /// 按 id 定位仍然存活的连接槽位
+    fn slot_of(&self, connection_id: Uuid) -> Option<(usize, &Slot)> {
+        let (generation, index) = connection_id.as_u64_pair();
+        let slot = self.slots.get(usize::try_from(index).ok()?)?;
+        let (current, state) = slot.load();
+        (current == generation && state != SLOT_EMPTY).then_some((index as usize, slot))
     }
 
-    /// 获取连接
-    pub async fn get_connection(
-        &self,
-        user_id: Option<String>,
-        database: Option<String>,
-    ) -> Result<Uuid> {
-        let start_time = Instant::now();
+    fn exceeds_lifetime(&self, slot: &Slot, now: u64) -> bool {
+        let age = now.saturating_sub(slot.created_at.load(Ordering::Relaxed));
+        Duration::from_nanos(age) > Duration::from_secs(self.config.max_lifetime)
+    }
 
-        // 首先尝试从空闲连接池获取
-        {
-            let mut idle_guard = self.idle_connections.lock().await;
-            if let Some(connection_id) = idle_guard.pop() {
-                // 检查连接是否仍然有效
-                let mut connections_guard = self.connections.write().await;
-                if let Some(connection) = connections_guard.get_mut(&connection_id) {
-                    connection.state = ConnectionState::Busy;
-                    connection.last_used = Instant::now();
-                    connection.user_id = user_id.clone();
-                    connection.database = database.clone();
-
-                    // 更新统计
-                    {
-                        let mut stats_guard = self.stats.write().await;
-                        stats_guard.idle_connections -= 1;
-                        stats_guard.active_connections += 1;
-                        stats_guard.avg_acquire_time = (stats_guard.avg_acquire_time
-                            + start_time.elapsed().as_millis() as f64)
-                            / 2.0;
-                    }
+    fn exceeds_idle_timeout(&self, slot: &Slot, now: u64) -> bool {
+        let idle = now.saturating_sub(slot.last_used.load(Ordering::Relaxed));
+        Duration::from_nanos(idle) > Duration::from_secs(self.config.idle_timeout)
+    }
+
+    /// 在空闲槽位上新建连接，已达上限时返回 None
+    fn open(&self, state: u8) -> Option<(usize, u64)> {
+        let index = self.free_slots.pop()?;
+        let slot = &self.slots[index];
+        // 槽位从空闲槽位队列取出后只归本线程所有，元数据写完再发布新一代的状态
+        let generation = slot.load().0 + 1;
+        let now = self.now();
+        slot.created_at.store(now, Ordering::Relaxed);
+        slot.last_used.store(now, Ordering::Relaxed);
+        slot.request_count.store(0, Ordering::Relaxed);
+        slot.set_session(None, None);
+        slot.state.store(pack(generation, state), Ordering::Release);
+
+        self.total.fetch_add(1, Ordering::Relaxed);
+        match state {
+            SLOT_BUSY => self.active.fetch_add(1, Ordering::Relaxed),
+            _ => self.idle.fetch_add(1, Ordering::Relaxed),
+        };
+        Some((index, generation))
+    }
 
-                    debug!("Reused connection: {}", connection_id);
-                    return Ok(connection_id);
+    /// 把 `generation` 代、处于 `expected` 状态的连接关闭并回收槽位
+    fn retire(&self, index: usize, generation: u64, expected: u8) -> bool {
+        if !self.slots[index].transition(generation, expected, SLOT_EMPTY) {
+            return false;
+        }
+        match expected {
+            SLOT_BUSY => self.active.fetch_sub(1, Ordering::Relaxed),
+            _ => self.idle.fetch_sub(1, Ordering::Relaxed),
+        };
+        self.total.fetch_sub(1, Ordering::Relaxed);
+        let _ = self.free_slots.push(index);
+        self.released.notify_one();
+        true
+    }
+
+    /// 空闲连接放入分片队列，从 `shard` 开始找有空位的分片
+    fn park(&self, entry: IdleEntry, shard: usize) -> bool {
+        let shards = self.idle_shards.len();
+        (0..shards).any(|offset| self.idle_shards[(shard + offset) % shards].push(entry).is_ok())
+    }
+
+    /// 取一个空闲连接：先取本分片，再依次窃取其他分片
+    fn take_idle(&self, shard: usize) -> Option<(usize, u64)> {
+        let shards = self.idle_shards.len();
+        for offset in 0..shards {
+            let queue = &self.idle_shards[(shard + offset) % shards];
+            while let Some(entry) = queue.pop() {
+                let slot = &self.slots[entry.index];
+                // 槽位已被回收、重新分配或正被持有时条目失效：新一代空闲连接有自己的条目，
+                // 被持有的连接释放时会重新入队
+                if !slot.transition(entry.generation, SLOT_IDLE, SLOT_BUSY) {
+                    continue;
+                }
+                self.idle.fetch_sub(1, Ordering::Relaxed);
+                self.active.fetch_add(1, Ordering::Relaxed);
+                if self.exceeds_lifetime(slot, self.now()) {
+                    self.retire(entry.index, entry.generation, SLOT_BUSY);
+                    continue;
                 }
+                return Some((entry.index, entry.generation));
             }
         }
+        None
+    }
 
-        // 创建新连接
-        if self.can_create_new_connection().await {
-            let connection_id = self.create_connection(user_id, database).await?;
-
-            // 更新统计
-            {
-                let mut stats_guard = self.stats.write().await;
-                stats_guard.total_connections += 1;
-                stats_guard.active_connections += 1;
-                stats_guard.avg_acquire_time =
-                    (stats_guard.avg_acquire_time + start_time.elapsed().as_millis() as f64) / 2.0;
-            }
+    fn try_acquire(&self, shard: usize) -> Option<(usize, u64)> {
+        self.take_idle(shard).or_else(|| self.open(SLOT_BUSY))
+    }
 
-            debug!("Created new connection: {}", connection_id);
-            return Ok(connection_id);
+    fn record_acquire_time(&self, elapsed: Duration) {
+        let sample = elapsed.as_nanos() as u64;
+        let _ = self.acquire_nanos.fetch_update(Ordering::Relaxed, Ordering::Relaxed, |avg| {
+            Some(avg - (avg >> ACQUIRE_EWMA_SHIFT) + (sample >> ACQUIRE_EWMA_SHIFT))
+        });
+    }
+
+    /// 预热：补足到 `min_connections` 个连接，新连接轮流放入各分片
+    fn warm_up(&self) -> usize {
+        let mut opened = 0;
+        while self.total.load(Ordering::Relaxed) < self.config.min_connections {
+            let Some((index, generation)) = self.open(SLOT_IDLE) else { break };
+            if !self.park(IdleEntry { index, generation }, opened) {
+                self.retire(index, generation, SLOT_IDLE);
+                break;
+            }
+            self.released.notify_one();
+            opened += 1;
         }
+        opened
+    }
 
-        // 等待可用连接
-        self.wait_for_connection(user_id, database).await
+    /// 清理过期空闲连接并顺带丢弃分片中的失效条目，返回关闭的连接数。
+    /// 超过最大生存时间的连接总是关闭；空闲超时只在连接数高于 `min_connections` 时关闭
+    fn evict_expired(&self) -> usize {
+        let now = self.now();
+        let mut evicted = 0;
+        for (shard, queue) in self.idle_shards.iter().enumerate() {
+            for _ in 0..queue.len() {
+                let Some(entry) = queue.pop() else { break };
+                let slot = &self.slots[entry.index];
+                if slot.load() != (entry.generation, SLOT_IDLE) {
+                    continue;
+                }
+                let expired = self.exceeds_lifetime(slot, now)
+                    || (self.exceeds_idle_timeout(slot, now)
+                        && self.total.load(Ordering::Relaxed) > self.config.min_connections);
+                if expired {
+                    if self.retire(entry.index, entry.generation, SLOT_IDLE) {
+                        evicted += 1;
+                    }
+                } else if !self.park(entry, shard) {
+                    self.retire(entry.index, entry.generation, SLOT_IDLE);
+                }
+            }
+        }
+        evicted
     }
 
-    /// 检查是否可以创建新连接
-    async fn can_create_new_connection(&self) -> bool {
-        let stats = self.stats.read().await;
-        stats.total_connections < self.config.max_connections
+    fn stats(&self) -> ConnectionPoolStats {
+        ConnectionPoolStats {
+            total_connections: self.total.load(Ordering::Relaxed),
+            active_connections: self.active.load(Ordering::Relaxed),
+            idle_connections: self.idle.load(Ordering::Relaxed),
+            waiting_requests: self.waiting.load(Ordering::Relaxed),
+            avg_acquire_time: self.acquire_nanos.load(Ordering::Relaxed) as f64 / 1e6,
+        }
     }
+}
 
-    /// 创建新连接
-    async fn create_connection(
-        &self,
-        user_id: Option<String>,
-        database: Option<String>,
-    ) -> Result<Uuid> {
-        let connection_id = Uuid::new_v4();
-        let connection = Connection {
-            id: connection_id,
-            user_id,
-            database,
-            state: ConnectionState::Busy,
-            created_at: Instant::now(),
-            last_used: Instant::now(),
-            request_count: 0,
-            total_execution_time: Duration::ZERO,
-        };
+/// 连接管理器
+pub struct ConnectionManager {
+    inner: Arc<PoolInner>,
+    /// 后台维护任务句柄
+    cleanup_handle: Option<tokio::task::JoinHandle<()>>,
+}
 
-        {
-            let mut connections_guard = self.connections.write().await;
-            connections_guard.insert(connection_id, connection);
+impl ConnectionManager {
+    /// 创建新的连接管理器，预热在后台进行
+    pub async fn new(config: ConnectionPoolConfig) -> Result<Self> {
+        if config.max_connections == 0 {
+            return Err(Error::Config("max_connections must be greater than 0".to_string()));
+        }
+        if config.min_connections > config.max_connections {
+            return Err(Error::Config(format!(
+                "min_connections ({}) exceeds max_connections ({})",
+                config.min_connections, config.max_connections
+            )));
         }
 
-        Ok(connection_id)
+        let inner = Arc::new(PoolInner::new(config));
+        let cleanup_handle = Self::start_cleanup_task(inner.clone());
+
+        info!("ConnectionManager initialized successfully");
+        Ok(Self { inner, cleanup_handle: Some(cleanup_handle) })
     }
 
-    /// 等待可用连接
-    async fn wait_for_connection(
+    /// 启动后台维护任务：立即预热一次，之后定期清理过期连接并补足最小连接数
+    fn start_cleanup_task(inner: Arc<PoolInner>) -> tokio::task::JoinHandle<()> {
+        let period = Duration::from_secs(inner.config.idle_timeout.clamp(1, MAINTENANCE_INTERVAL.as_secs()));
+        tokio::spawn(async move {
+            let mut interval = tokio::time::interval(period);
+            loop {
+                interval.tick().await;
+                let evicted = inner.evict_expired();
+                let opened = inner.warm_up();
+                if evicted > 0 || opened > 0 {
+                    debug!("Connection maintenance completed: evicted {}, opened {}", evicted, opened);
+                }
+            }
+        })
+    }
+
+    /// 获取连接
+    pub async fn get_connection(
         &self,
         user_id: Option<String>,
         database: Option<String>,
     ) -> Result<Uuid> {
-        let timeout = Duration::from_secs(self.config.acquire_timeout);
         let start_time = Instant::now();
+        let shard = shard_hint() % self.inner.idle_shards.len();
 
-        // 更新统计
-        {
-            let mut stats_guard = self.stats.write().await;
-            stats_guard.waiting_requests += 1;
-        }
+        let (index, generation) = match self.inner.try_acquire(shard) {
+            Some(found) => found,
+            None => self.wait_for_connection(shard, start_time).await?,
+        };
 
-        loop {
-            if start_time.elapsed() > timeout {
-                // 更新统计
-                {
-                    let mut stats_guard = self.stats.write().await;
-                    stats_guard.waiting_requests -= 1;
-                }
-                return Err(Error::Execution("Connection acquire timeout".to_string()));
-            }
+        let slot = &self.inner.slots[index];
+        slot.last_used.store(self.inner.now(), Ordering::Relaxed);
+        slot.set_session(user_id, database);
+        self.inner.record_acquire_time(start_time.elapsed());
 
-            // 尝试直接创建或获取连接
-            if self.can_create_new_connection().await {
-                let connection_id = self
-                    .create_connection(user_id.clone(), database.clone())
-                    .await?;
-
-                // 更新统计
-                {
-                    let mut stats_guard = self.stats.write().await;
-                    stats_guard.waiting_requests -= 1;
-                    stats_guard.total_connections += 1;
-                    stats_guard.active_connections += 1;
-                }
-                return Ok(connection_id);
-            }
+        let connection_id = PoolInner::connection_id(index, generation);
+        debug!("Acquired connection: {}", connection_id);
+        Ok(connection_id)
+    }
 
-            // 检查是否有空闲连接
-            {
-                let mut idle_guard = self.idle_connections.lock().await;
-                if let Some(connection_id) = idle_guard.pop() {
-                    // 检查连接是否仍然有效
-                    let mut connections_guard = self.connections.write().await;
-                    if let Some(connection) = connections_guard.get_mut(&connection_id) {
-                        connection.state = ConnectionState::Busy;
-                        connection.last_used = Instant::now();
-                        connection.user_id = user_id.clone();
-                        connection.database = database.clone();
-
-                        // 更新统计
-                        {
-                            let mut stats_guard = self.stats.write().await;
-                            stats_guard.waiting_requests -= 1;
-                            stats_guard.idle_connections -= 1;
-                            stats_guard.active_connections += 1;
-                        }
-                        return Ok(connection_id);
-                    }
-                }
+    /// 等待可用连接：连接被释放或槽位被回收时唤醒重试，超时返回错误
+    async fn wait_for_connection(&self, shard: usize, start_time: Instant) -> Result<(usize, u64)> {
+        let deadline = start_time + Duration::from_secs(self.inner.config.acquire_timeout);
+        self.inner.waiting.fetch_add(1, Ordering::Relaxed);
+        let result = loop {
+            // Notify 在无人等待时保留一个许可，检查与等待之间的释放不会丢失
+            if tokio::time::timeout_at(deadline, self.inner.released.notified()).await.is_err() {
+                break Err(Error::Execution("Connection acquire timeout".to_string()));
             }
-
-            // 等待一段时间后重试
-            tokio::time::sleep(Duration::from_millis(100)).await;
-        }
+            if let Some(found) = self.inner.try_acquire(shard) {
+                break Ok(found);
+            }
+        };
+        self.inner.waiting.fetch_sub(1, Ordering::Relaxed);
+        result
     }
 
     /// 释放连接
     pub async fn release_connection(&self, connection_id: Uuid) -> Result<()> {
-        {
-            let mut connections_guard = self.connections.write().await;
-            if let Some(connection) = connections_guard.get_mut(&connection_id) {
-                connection.state = ConnectionState::Idle;
-                connection.last_used = Instant::now();
-                connection.request_count += 1;
-            }
+        let inner = &self.inner;
+        let (index, slot) = inner
+            .slot_of(connection_id)
+            .ok_or_else(|| Error::Execution(format!("Unknown connection: {}", connection_id)))?;
+        let (generation, _) = connection_id.as_u64_pair();
+        if slot.load() != (generation, SLOT_BUSY) {
+            return Err(Error::Execution(format!("Connection {} is not in use", connection_id)));
         }
-
-        // 添加到空闲连接队列
-        {
-            let mut idle_guard = self.idle_connections.lock().await;
-            if !idle_guard.contains(&connection_id) {
-                idle_guard.push(connection_id);
-            }
+        let now = inner.now();
+        if inner.exceeds_lifetime(slot, now) && inner.retire(index, generation, SLOT_BUSY) {
+            debug!("Retired expired connection: {}", connection_id);
+            return Ok(());
         }
-
-        // 更新统计
-        {
-            let mut stats_guard = self.stats.write().await;
-            stats_guard.active_connections -= 1;
-            stats_guard.idle_connections += 1;
+        // 只有持有者会释放，CAS 失败说明同一连接被并发重复释放
+        if !slot.transition(generation, SLOT_BUSY, SLOT_IDLE) {
+            return Err(Error::Execution(format!("Connection {} is not in use", connection_id)));
+        }
+        slot.last_used.store(now, Ordering::Relaxed);
+        slot.request_count.fetch_add(1, Ordering::Relaxed);
+        inner.active.fetch_sub(1, Ordering::Relaxed);
+        inner.idle.fetch_add(1, Ordering::Relaxed);
+
+        let shard = shard_hint() % inner.idle_shards.len();
+        if !inner.park(IdleEntry { index, generation }, shard) {
+            inner.retire(index, generation, SLOT_IDLE);
         }
+        inner.released.notify_one();
 
         debug!("Released connection: {}", connection_id);
         Ok(())
@@ -364,51 +469,65 @@ impl ConnectionManager {
 
     /// 关闭连接
     pub async fn close_connection(&self, connection_id: Uuid) -> Result<()> {
-        {
-            let mut connections_guard = self.connections.write().await;
-            connections_guard.remove(&connection_id);
-        }
-
-        // 从空闲连接队列中移除
-        {
-            let mut idle_guard = self.idle_connections.lock().await;
-            idle_guard.retain(|&id| id != connection_id);
-        }
-
-        // 更新统计
-        {
-            let mut stats_guard = self.stats.write().await;
-            stats_guard.total_connections -= 1;
-            stats_guard.active_connections -= 1;
+        let (index, _) = self
+            .inner
+            .slot_of(connection_id)
+            .ok_or_else(|| Error::Execution(format!("Unknown connection: {}", connection_id)))?;
+        // 按 id 中的代数回收：查找之后槽位若已被回收并重新分配，新连接不受影响。
+        // 空闲连接在分片中的条目会在出队时因状态不符被丢弃
+        let (generation, _) = connection_id.as_u64_pair();
+        if !self.inner.retire(index, generation, SLOT_BUSY) {
+            self.inner.retire(index, generation, SLOT_IDLE);
         }
 
         debug!("Closed connection: {}", connection_id);
         Ok(())
     }
 
+    /// 查询连接信息
+    pub fn connection_info(&self, connection_id: Uuid) -> Option<Connection> {
+        let (_, slot) = self.inner.slot_of(connection_id)?;
+        let (user_id, database) = slot.session.lock().unwrap_or_else(|e| e.into_inner()).clone();
+        let at = |nanos: &AtomicU64| self.inner.epoch + Duration::from_nanos(nanos.load(Ordering::Relaxed));
+        Some(Connection {
+            id: connection_id,
+            user_id,
+            database,
+            state: match slot.load().1 {
+                SLOT_BUSY => ConnectionState::Busy,
+                SLOT_IDLE => ConnectionState::Idle,
+                _ => ConnectionState::Closed,
+            },
+            created_at: at(&slot.created_at),
+            last_used: at(&slot.last_used),
+            request_count: slot.request_count.load(Ordering::Relaxed),
+            total_execution_time: Duration::ZERO,
+        })
+    }
+
     /// 获取连接池统计信息
     pub async fn get_stats(&self) -> ConnectionPoolStats {
-        self.stats.read().await.clone()
+        self.inner.stats()
     }
 
     /// 关闭连接管理器
     pub async fn shutdown(&self) -> Result<()> {
         info!("Shutting down ConnectionManager...");
 
-        // 取消清理任务
+        // 取消维护任务
         if let Some(handle) = &self.cleanup_handle {
             handle.abort();
         }
 
         // 关闭所有连接
-        {
-            let mut connections_guard = self.connections.write().await;
-            connections_guard.clear();
+        for (index, slot) in self.inner.slots.iter().enumerate() {
+            let (generation, _) = slot.load();
+            if !self.inner.retire(index, generation, SLOT_IDLE) {
+                self.inner.retire(index, generation, SLOT_BUSY);
+            }
         }
-
-        {
-            let mut idle_guard = self.idle_connections.lock().await;
-            idle_guard.clear();
+        for queue in self.inner.idle_shards.iter() {
+            while queue.pop().is_some() {}
         }
 
         info!("ConnectionManager shutdown completed");
@@ -416,6 +535,14 @@ impl ConnectionManager {
     }
 }
 
+impl Drop for ConnectionManager {
+    fn drop(&mut self) {
+        if let Some(handle) = &self.cleanup_handle {
+            handle.abort();
+        }
+    }
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -559,6 +686,141 @@ mod tests {
         assert!(result.is_err());
     }
 
+    fn pool_config(max_connections: usize, min_connections: usize) -> ConnectionPoolConfig {
+        ConnectionPoolConfig {
+            max_connections,
+            min_connections,
+            idle_timeout: 300,
+            max_lifetime: 3600,
+            acquire_timeout: 5,
+        }
+    }
+
+    #[tokio::test]
+    async fn test_connection_manager_warms_up_in_background() {
+        let manager = ConnectionManager::new(pool_config(8, 3)).await.unwrap();
+        for _ in 0..100 {
+            if manager.get_stats().await.idle_connections == 3 {
+                break;
+            }
+            tokio::time::sleep(Duration::from_millis(10)).await;
+        }
+        let stats = manager.get_stats().await;
+        assert_eq!((stats.total_connections, stats.idle_connections), (3, 3));
+
+        // 预热的连接被复用，不会新建
+        let id = manager.get_connection(Some("user1".to_string()), None).await.unwrap();
+        let stats = manager.get_stats().await;
+        assert_eq!((stats.total_connections, stats.active_connections, stats.idle_connections), (3, 1, 2));
+        let info = manager.connection_info(id).unwrap();
+        assert_eq!((info.state, info.user_id), (ConnectionState::Busy, Some("user1".to_string())));
+    }
+
+    #[tokio::test]
+    async fn test_connection_manager_reuses_and_invalidates_ids() {
+        let manager = ConnectionManager::new(pool_config(1, 0)).await.unwrap();
+        let first = manager.get_connection(None, None).await.unwrap();
+        manager.release_connection(first).await.unwrap();
+        assert!(manager.release_connection(first).await.is_err());
+
+        let again = manager.get_connection(None, None).await.unwrap();
+        assert_eq!(again, first);
+        assert_eq!(manager.connection_info(again).unwrap().request_count, 1);
+
+        // 关闭后槽位重新分配，旧 id 失效
+        manager.close_connection(again).await.unwrap();
+        let fresh = manager.get_connection(None, None).await.unwrap();
+        assert_ne!(fresh, first);
+        assert!(manager.connection_info(first).is_none());
+        assert!(manager.release_connection(first).await.is_err());
+    }
+
+    #[tokio::test]
+    async fn test_stale_ids_and_entries_do_not_touch_reopened_slot() {
+        let manager = ConnectionManager::new(pool_config(1, 0)).await.unwrap();
+        let inner = &manager.inner;
+        let old = manager.get_connection(None, None).await.unwrap();
+        let (old_generation, _) = old.as_u64_pair();
+        manager.release_connection(old).await.unwrap();
+        manager.close_connection(old).await.unwrap();
+
+        // 同一槽位上的新一代连接，先空闲入队
+        let (index, generation) = inner.open(SLOT_IDLE).unwrap();
+        assert!(inner.park(IdleEntry { index, generation }, 0));
+
+        // 查找之后才到达的旧代回收不会关掉新连接
+        assert!(!inner.retire(index, old_generation, SLOT_IDLE));
+        assert_eq!(inner.slots[index].load(), (generation, SLOT_IDLE));
+
+        // 释放旧连接时留下的旧条目排在前面，它被丢弃，新一代的条目仍能取到连接，
+        // 不会留下没有条目的空闲槽位
+        assert_eq!(inner.idle_shards[0].len(), 2);
+        assert_eq!(inner.take_idle(0), Some((index, generation)));
+        let current = PoolInner::connection_id(index, generation);
+        manager.release_connection(current).await.unwrap();
+        assert_eq!(inner.take_idle(0), Some((index, generation)));
+        assert!(inner.idle_shards[0].is_empty());
+        assert_eq!(inner.stats().idle_connections, 0);
+    }
+
+    #[tokio::test]
+    async fn test_connection_manager_retires_connections_past_lifetime() {
+        let config = ConnectionPoolConfig { max_lifetime: 0, ..pool_config(2, 0) };
+        let manager = ConnectionManager::new(config).await.unwrap();
+        let id = manager.get_connection(None, None).await.unwrap();
+        tokio::time::sleep(Duration::from_millis(2)).await;
+        manager.release_connection(id).await.unwrap();
+
+        let stats = manager.get_stats().await;
+        assert_eq!((stats.total_connections, stats.idle_connections), (0, 0));
+        assert!(manager.connection_info(id).is_none());
+    }
+
+    #[tokio::test]
+    async fn test_connection_manager_waiter_woken_by_release() {
+        let manager = Arc::new(ConnectionManager::new(pool_config(1, 0)).await.unwrap());
+        let held = manager.get_connection(None, None).await.unwrap();
+
+        let waiter = {
+            let manager = manager.clone();
+            tokio::spawn(async move { manager.get_connection(None, None).await })
+        };
+        tokio::time::sleep(Duration::from_millis(20)).await;
+        assert_eq!(manager.get_stats().await.waiting_requests, 1);
+
+        let released_at = Instant::now();
+        manager.release_connection(held).await.unwrap();
+        let acquired = waiter.await.unwrap().unwrap();
+        assert_eq!(acquired, held);
+        assert!(released_at.elapsed() < Duration::from_secs(1));
+        assert_eq!(manager.get_stats().await.waiting_requests, 0);
+    }
+
+    #[tokio::test(flavor = "multi_thread", worker_threads = 4)]
+    async fn test_connection_manager_concurrent_burst() {
+        let manager = Arc::new(ConnectionManager::new(pool_config(4, 2)).await.unwrap());
+        let tasks: Vec<_> = (0..16)
+            .map(|_| {
+                let manager = manager.clone();
+                tokio::spawn(async move {
+                    for _ in 0..200 {
+                        let id = manager.get_connection(None, None).await.unwrap();
+                        tokio::task::yield_now().await;
+                        manager.release_connection(id).await.unwrap();
+                    }
+                })
+            })
+            .collect();
+        for task in tasks {
+            task.await.unwrap();
+        }
+
+        let stats = manager.get_stats().await;
+        assert_eq!(stats.active_connections, 0);
+        assert!(stats.total_connections <= 4);
+        assert_eq!(stats.idle_connections, stats.total_connections);
+    }
+
     #[tokio::test]
     async fn test_connection_manager_get_stats() {
         let config = ConnectionPoolConfig {
@@ -2,6 +2,7 @@ pub mod config;
 pub mod connection_manager;
 pub mod constants;
 pub mod error;
+pub mod mpmc_queue;
 pub mod priority_queue;
 pub mod thread_pool;
 pub mod thread_pool_manager;
@@ -10,6 +11,7 @@ pub mod types;
 pub use config::Config;
 pub use connection_manager::*;
 pub use error::{Error, Result};
+pub use mpmc_queue::{MpmcQueue, SegmentedMpmcQueue};
 pub use priority_queue::*;
 pub use thread_pool::*;
 pub use thread_pool_manager::*;
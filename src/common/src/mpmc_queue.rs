@@ -0,0 +1,302 @@
+//! 有界无锁多生产者多消费者队列
+//!
+//! Dmitry Vyukov 的环形缓冲算法：每个槽位带一个序号，生产者/消费者各自以 CAS
+//! 推进写/读游标，序号告诉它槽位是否已可写/可读。入队、出队都不加锁，也不分配内存。
+//!
+//! `SegmentedMpmcQueue` 把若干容量逐段翻倍的环形队列串起来，段在第一次用到时才分配，
+//! 容量上限很大而平时排队很少的场景下内存随实际积压增长。
+
+use std::cell::UnsafeCell;
+use std::mem::MaybeUninit;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::OnceLock;
+
+/// 按缓存行对齐，避免读写游标落在同一缓存行上互相失效
+#[repr(align(64))]
+struct CachePadded<T>(T);
+
+struct Slot<T> {
+    /// 序号等于写游标时可写，等于写游标 + 1 时可读
+    sequence: AtomicUsize,
+    value: UnsafeCell<MaybeUninit<T>>,
+}
+
+/// 有界无锁 MPMC 队列，容量向上取整到 2 的幂
+pub struct MpmcQueue<T> {
+    buffer: Box<[Slot<T>]>,
+    mask: usize,
+    enqueue_pos: CachePadded<AtomicUsize>,
+    dequeue_pos: CachePadded<AtomicUsize>,
+}
+
+// SAFETY: 槽位中的值只会被成功推进游标的那一个线程写入或取出
+unsafe impl<T: Send> Send for MpmcQueue<T> {}
+unsafe impl<T: Send> Sync for MpmcQueue<T> {}
+
+impl<T> MpmcQueue<T> {
+    pub fn with_capacity(capacity: usize) -> Self {
+        let capacity = capacity.max(2).next_power_of_two();
+        let buffer = (0..capacity)
+            .map(|i| Slot { sequence: AtomicUsize::new(i), value: UnsafeCell::new(MaybeUninit::uninit()) })
+            .collect();
+        Self {
+            buffer,
+            mask: capacity - 1,
+            enqueue_pos: CachePadded(AtomicUsize::new(0)),
+            dequeue_pos: CachePadded(AtomicUsize::new(0)),
+        }
+    }
+
+    pub fn capacity(&self) -> usize {
+        self.mask + 1
+    }
+
+    /// 入队；队列已满时原样返回该值
+    pub fn push(&self, value: T) -> Result<(), T> {
+        let mut pos = self.enqueue_pos.0.load(Ordering::Relaxed);
+        loop {
+            let slot = &self.buffer[pos & self.mask];
+            let sequence = slot.sequence.load(Ordering::Acquire);
+            let diff = sequence as isize - pos as isize;
+            if diff == 0 {
+                match self.enqueue_pos.0.compare_exchange_weak(pos, pos + 1, Ordering::Relaxed, Ordering::Relaxed) {
+                    Ok(_) => {
+                        // SAFETY: 推进写游标后本线程独占该槽位，直到发布新的序号
+                        unsafe { (*slot.value.get()).write(value) };
+                        slot.sequence.store(pos + 1, Ordering::Release);
+                        return Ok(());
+                    }
+                    Err(current) => pos = current,
+                }
+            } else if diff < 0 {
+                // 槽位还留着上一圈未被取走的值
+                return Err(value);
+            } else {
+                pos = self.enqueue_pos.0.load(Ordering::Relaxed);
+            }
+        }
+    }
+
+    /// 出队；队列为空时返回 None
+    pub fn pop(&self) -> Option<T> {
+        let mut pos = self.dequeue_pos.0.load(Ordering::Relaxed);
+        loop {
+            let slot = &self.buffer[pos & self.mask];
+            let sequence = slot.sequence.load(Ordering::Acquire);
+            let diff = sequence as isize - (pos + 1) as isize;
+            if diff == 0 {
+                match self.dequeue_pos.0.compare_exchange_weak(pos, pos + 1, Ordering::Relaxed, Ordering::Relaxed) {
+                    Ok(_) => {
+                        // SAFETY: 序号表明生产者已写完，推进读游标后本线程独占该槽位
+                        let value = unsafe { (*slot.value.get()).assume_init_read() };
+                        slot.sequence.store(pos + self.mask + 1, Ordering::Release);
+                        return Some(value);
+                    }
+                    Err(current) => pos = current,
+                }
+            } else if diff < 0 {
+                return None;
+            } else {
+                pos = self.dequeue_pos.0.load(Ordering::Relaxed);
+            }
+        }
+    }
+
+    /// 近似长度 (并发入队/出队时只是一个快照)
+    pub fn len(&self) -> usize {
+        let tail = self.enqueue_pos.0.load(Ordering::Acquire);
+        let head = self.dequeue_pos.0.load(Ordering::Acquire);
+        tail.saturating_sub(head)
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+}
+
+impl<T> Drop for MpmcQueue<T> {
+    fn drop(&mut self) {
+        while self.pop().is_some() {}
+    }
+}
+
+/// 第一段的容量
+const INITIAL_SEGMENT_CAPACITY: usize = 64;
+
+/// 按需分配的有界无锁 MPMC 队列
+///
+/// 生产者只往当前段写，当前段满了才切到容量翻倍的下一段；消费者从最老的段开始取。
+/// 生产者不会回到更老的段，因此先入队的值先出队。已分配的段留着复用，
+/// 占用的内存不超过积压峰值的两倍左右。只有分配新段时初始化者之间会短暂等待。
+pub struct SegmentedMpmcQueue<T> {
+    segments: Box<[OnceLock<MpmcQueue<T>>]>,
+    /// 第一段的容量，之后每段翻倍
+    first_capacity: usize,
+    /// 生产者写入的段
+    current: AtomicUsize,
+}
+
+impl<T> SegmentedMpmcQueue<T> {
+    /// 最多容纳 `capacity` 个值 (向上取整到 2 的幂)，创建时不分配任何槽位
+    pub fn with_capacity(capacity: usize) -> Self {
+        let capacity = capacity.max(2).next_power_of_two();
+        let first_capacity = INITIAL_SEGMENT_CAPACITY.min(capacity);
+        let segment_count = (capacity / first_capacity).trailing_zeros() as usize + 1;
+        Self {
+            segments: (0..segment_count).map(|_| OnceLock::new()).collect(),
+            first_capacity,
+            current: AtomicUsize::new(0),
+        }
+    }
+
+    fn segment(&self, index: usize) -> &MpmcQueue<T> {
+        self.segments[index].get_or_init(|| MpmcQueue::with_capacity(self.first_capacity << index))
+    }
+
+    /// 最后一段的容量，即队列能容纳的值数
+    pub fn capacity(&self) -> usize {
+        self.first_capacity << (self.segments.len() - 1)
+    }
+
+    /// 已分配的槽位数
+    pub fn allocated(&self) -> usize {
+        self.segments.iter().filter_map(OnceLock::get).map(MpmcQueue::capacity).sum()
+    }
+
+    /// 入队；队列已满时原样返回该值
+    pub fn push(&self, mut value: T) -> Result<(), T> {
+        let mut index = self.current.load(Ordering::Acquire);
+        loop {
+            match self.segment(index).push(value) {
+                Ok(()) => return Ok(()),
+                Err(rejected) => value = rejected,
+            }
+            if index + 1 == self.segments.len() {
+                return Err(value);
+            }
+            // 当前段已满，切到下一段；CAS 失败说明别的生产者已经切过
+            let _ = self.current.compare_exchange(index, index + 1, Ordering::AcqRel, Ordering::Acquire);
+            index = self.current.load(Ordering::Acquire);
+        }
+    }
+
+    /// 出队；队列为空时返回 None
+    pub fn pop(&self) -> Option<T> {
+        self.segments.iter().filter_map(OnceLock::get).find_map(MpmcQueue::pop)
+    }
+
+    /// 近似长度 (并发入队/出队时只是一个快照)
+    pub fn len(&self) -> usize {
+        self.segments.iter().filter_map(OnceLock::get).map(MpmcQueue::len).sum()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::Arc;
+
+    #[test]
+    fn test_bounded_fifo() {
+        let queue = MpmcQueue::with_capacity(3);
+        assert_eq!(queue.capacity(), 4);
+        for i in 0..4 {
+            queue.push(i).unwrap();
+        }
+        assert_eq!(queue.push(4), Err(4));
+        assert_eq!(queue.len(), 4);
+        assert_eq!(queue.pop(), Some(0));
+        queue.push(4).unwrap();
+        assert_eq!((1..=4).map(|_| queue.pop().unwrap()).collect::<Vec<_>>(), vec![1, 2, 3, 4]);
+        assert_eq!(queue.pop(), None);
+        assert!(queue.is_empty());
+    }
+
+    #[test]
+    fn test_concurrent_producers_and_consumers() {
+        const PRODUCERS: usize = 4;
+        const PER_PRODUCER: usize = 10_000;
+        let queue = Arc::new(MpmcQueue::with_capacity(256));
+
+        let producers: Vec<_> = (0..PRODUCERS)
+            .map(|p| {
+                let queue = queue.clone();
+                std::thread::spawn(move || {
+                    for i in 0..PER_PRODUCER {
+                        let mut value = p * PER_PRODUCER + i;
+                        while let Err(v) = queue.push(value) {
+                            value = v;
+                            std::thread::yield_now();
+                        }
+                    }
+                })
+            })
+            .collect();
+        let consumers: Vec<_> = (0..PRODUCERS)
+            .map(|_| {
+                let queue = queue.clone();
+                std::thread::spawn(move || {
+                    let mut received = Vec::new();
+                    while received.len() < PER_PRODUCER {
+                        match queue.pop() {
+                            Some(value) => received.push(value),
+                            None => std::thread::yield_now(),
+                        }
+                    }
+                    received
+                })
+            })
+            .collect();
+
+        producers.into_iter().for_each(|p| p.join().unwrap());
+        let mut all: Vec<usize> = consumers.into_iter().flat_map(|c| c.join().unwrap()).collect();
+        all.sort_unstable();
+        assert_eq!(all, (0..PRODUCERS * PER_PRODUCER).collect::<Vec<_>>());
+    }
+
+    #[test]
+    fn test_drop_releases_queued_values() {
+        let value = Arc::new(());
+        let queue = MpmcQueue::with_capacity(4);
+        queue.push(value.clone()).unwrap();
+        queue.push(value.clone()).unwrap();
+        drop(queue);
+        assert_eq!(Arc::strong_count(&value), 1);
+    }
+
+    #[test]
+    fn test_segmented_queue_allocates_on_demand() {
+        let queue = SegmentedMpmcQueue::with_capacity(1000);
+        assert_eq!(queue.capacity(), 1024);
+        assert_eq!(queue.allocated(), 0);
+
+        // 100 个值用满第一段 (64) 后只再分配第二段 (128)
+        for i in 0..100 {
+            queue.push(i).unwrap();
+        }
+        assert_eq!(queue.allocated(), 64 + 128);
+        assert_eq!(queue.len(), 100);
+
+        // 跨段仍按入队顺序出队
+        assert_eq!((0..100).map(|_| queue.pop().unwrap()).collect::<Vec<_>>(), (0..100).collect::<Vec<_>>());
+        assert_eq!(queue.pop(), None);
+
+        // 排空后的段被复用，稳态下不再分配
+        for round in 0..50 {
+            queue.push(round).unwrap();
+            assert_eq!(queue.pop(), Some(round));
+        }
+        assert_eq!(queue.allocated(), 64 + 128);
+
+        let mut accepted = 0;
+        while queue.push(accepted).is_ok() {
+            accepted += 1;
+        }
+        assert!(accepted >= 1024);
+        assert_eq!(queue.pop(), Some(0));
+    }
+}
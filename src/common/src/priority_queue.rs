@@ -1,56 +1,86 @@
+//! 多级请求优先级队列
+//!
+//! 每个优先级一条无锁 MPMC 队列，统计信息全部为原子量，入队/出队路径上没有锁。
+//! 出队按平滑加权轮询选层 (权重逐级减半)，被选中的层为空时再按严格优先级找下一个
+//! 非空层：高优先级始终多拿份额，低优先级在持续积压时也会被调度，不会饿死。
+//!
+//! 准入控制借鉴 CoDel：出队时测量请求的排队时延，若持续 `interval` 都高于
+//! `target_delay` 则判定过载。过载期间 `Low`/`Background` 请求在入队时被拒绝，
+//! 已排队且超过目标时延的此类请求在出队时被丢弃，把有限的处理能力留给高优先级请求；
+//! 排队时延回落到目标以下 (或队列排空) 即解除过载。
+
+use crate::mpmc_queue::SegmentedMpmcQueue;
 use crate::thread_pool::{Request, RequestPriority, RequestType};
-use std::collections::{BinaryHeap, VecDeque};
-use std::sync::Arc;
-use tokio::sync::{Mutex, RwLock};
+use std::fmt;
+use std::sync::atomic::{AtomicBool, AtomicU64, AtomicUsize, Ordering};
 use tokio::time::{Duration, Instant};
+use tracing::debug;
 
-/// 优先级队列项
+/// 优先级层数，与 `RequestPriority` 的取值一一对应
+const TIER_COUNT: usize = 6;
+
+/// 各层的调度权重，按 `RequestPriority` 的顺序
+const TIER_WEIGHTS: [u32; TIER_COUNT] = [32, 16, 8, 4, 2, 1];
+
+/// 排队时延移动平均的平滑因子 (每个样本占 1/8)
+const WAIT_EWMA_SHIFT: u32 = 3;
+
+/// 优先级队列配置
 #[derive(Debug, Clone)]
-pub struct PriorityQueueItem {
-    pub request: Request,
-    pub priority_score: f64,
-    pub wait_time: Duration,
-    pub estimated_cost: u64,
+pub struct PriorityQueueConfig {
+    /// 所有层合计的最大排队请求数
+    pub capacity: usize,
+    /// 目标排队时延
+    pub target_delay: Duration,
+    /// 排队时延持续高于目标值多久即判定为过载
+    pub interval: Duration,
 }
 
-impl PartialEq for PriorityQueueItem {
-    fn eq(&self, other: &Self) -> bool {
-        self.priority_score == other.priority_score
+impl Default for PriorityQueueConfig {
+    fn default() -> Self {
+        Self { capacity: 10_000, target_delay: Duration::from_millis(5), interval: Duration::from_millis(100) }
     }
 }
 
-impl Eq for PriorityQueueItem {}
+/// 请求被拒绝入队的原因
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum RejectReason {
+    /// 队列已达容量上限
+    QueueFull,
+    /// 排队时延过高，低优先级请求被提前拒绝
+    Overloaded,
+}
 
-impl PartialOrd for PriorityQueueItem {
-    fn partial_cmp(&self, other: &Self) -> Option<std::cmp::Ordering> {
-        Some(self.cmp(other))
+impl fmt::Display for RejectReason {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        match self {
+            RejectReason::QueueFull => write!(f, "request queue is full"),
+            RejectReason::Overloaded => write!(f, "request queue is overloaded, low priority request shed"),
+        }
     }
 }
 
-impl Ord for PriorityQueueItem {
-    fn cmp(&self, other: &Self) -> std::cmp::Ordering {
-        self.partial_cmp(other).unwrap_or(std::cmp::Ordering::Equal)
-    }
+/// 排队中的请求
+struct Queued {
+    request: Request,
+    enqueued_at: Instant,
 }
 
 /// 多级优先级队列
 pub struct MultiLevelPriorityQueue {
-    /// 系统级队列（最高优先级）
-    system_queue: Arc<Mutex<VecDeque<Request>>>,
-    /// 管理级队列
-    admin_queue: Arc<Mutex<VecDeque<Request>>>,
-    /// 高优先级队列
-    high_queue: Arc<Mutex<VecDeque<Request>>>,
-    /// 普通优先级队列
-    normal_queue: Arc<Mutex<VecDeque<Request>>>,
-    /// 低优先级队列
-    low_queue: Arc<Mutex<VecDeque<Request>>>,
-    /// 后台队列（最低优先级）
-    background_queue: Arc<Mutex<VecDeque<Request>>>,
-    /// 自适应优先级队列
-    adaptive_queue: Arc<Mutex<BinaryHeap<PriorityQueueItem>>>,
+    /// 各优先级队列，下标即 `RequestPriority as usize`
+    tiers: [SegmentedMpmcQueue<Queued>; TIER_COUNT],
+    /// 平滑加权轮询的出队顺序，每个元素是层下标
+    schedule: Vec<usize>,
+    /// 轮询游标
+    cursor: AtomicUsize,
+    /// 所有层合计的排队请求数
+    len: AtomicUsize,
+    config: PriorityQueueConfig,
+    /// 过载检测
+    codel: CoDel,
     /// 队列统计信息
-    stats: Arc<RwLock<QueueStats>>,
+    stats: AtomicQueueStats,
     /// 是否启用自适应调度
     enable_adaptive: bool,
 }
@@ -64,141 +94,192 @@ pub struct QueueStats {
     pub normal_queue_size: usize,
     pub low_queue_size: usize,
     pub background_queue_size: usize,
-    pub adaptive_queue_size: usize,
+    /// 累计入队的请求数
     pub total_requests: u64,
+    /// 入队时被拒绝的请求数
+    pub rejected_requests: u64,
+    /// 过载时出队被丢弃的请求数
+    pub shed_requests: u64,
+    /// 排队时延的指数移动平均
     pub avg_wait_time: Duration,
     pub max_wait_time: Duration,
+    /// 当前是否处于过载状态
+    pub overloaded: bool,
+}
+
+#[derive(Default)]
+struct AtomicQueueStats {
+    total_requests: AtomicU64,
+    rejected_requests: AtomicU64,
+    shed_requests: AtomicU64,
+    avg_wait_nanos: AtomicU64,
+    max_wait_nanos: AtomicU64,
+}
+
+impl AtomicQueueStats {
+    fn record_wait(&self, wait: Duration) {
+        let sample = wait.as_nanos() as u64;
+        let _ = self.avg_wait_nanos.fetch_update(Ordering::Relaxed, Ordering::Relaxed, |avg| {
+            Some(avg - (avg >> WAIT_EWMA_SHIFT) + (sample >> WAIT_EWMA_SHIFT))
+        });
+        self.max_wait_nanos.fetch_max(sample, Ordering::Relaxed);
+    }
+}
+
+/// CoDel 式过载检测，状态全部为原子量
+struct CoDel {
+    /// 时间基准，下面的时间点都是相对它的纳秒数
+    epoch: Instant,
+    /// 排队时延首次高于目标后，判定过载的截止时间点 (0 表示当前不高于目标)
+    first_above: AtomicU64,
+    overloaded: AtomicBool,
+}
+
+impl CoDel {
+    fn new(epoch: Instant) -> Self {
+        Self { epoch, first_above: AtomicU64::new(0), overloaded: AtomicBool::new(false) }
+    }
+
+    /// 根据一次出队的排队时延更新过载状态
+    fn observe(&self, sojourn: Duration, now: Instant, config: &PriorityQueueConfig) {
+        if sojourn < config.target_delay {
+            self.reset();
+            return;
+        }
+        // 加 1 使时间点恒大于 0，与“未设置”区分
+        let now = now.saturating_duration_since(self.epoch).as_nanos() as u64 + 1;
+        let deadline = self.first_above.load(Ordering::Relaxed);
+        if deadline == 0 {
+            let deadline = now + config.interval.as_nanos() as u64;
+            let _ = self.first_above.compare_exchange(0, deadline, Ordering::Relaxed, Ordering::Relaxed);
+        } else if now >= deadline && !self.overloaded.swap(true, Ordering::Relaxed) {
+            debug!("request queue overloaded: sojourn {:?} above target {:?}", sojourn, config.target_delay);
+        }
+    }
+
+    fn reset(&self) {
+        self.first_above.store(0, Ordering::Relaxed);
+        if self.overloaded.swap(false, Ordering::Relaxed) {
+            debug!("request queue recovered from overload");
+        }
+    }
+
+    fn is_overloaded(&self) -> bool {
+        self.overloaded.load(Ordering::Relaxed)
+    }
+}
+
+/// 过载时可被拒绝或丢弃的优先级
+fn is_sheddable(priority: RequestPriority) -> bool {
+    matches!(priority, RequestPriority::Low | RequestPriority::Background)
+}
+
+/// 按权重生成平滑加权轮询序列 (nginx 的 smooth weighted round-robin)，
+/// 同一层的出队机会在一轮中均匀散开而不是连续扎堆
+fn smooth_weighted_schedule(weights: &[u32]) -> Vec<usize> {
+    let total: i64 = weights.iter().map(|&w| w as i64).sum();
+    let mut current = vec![0i64; weights.len()];
+    (0..total)
+        .map(|_| {
+            for (c, &w) in current.iter_mut().zip(weights) {
+                *c += w as i64;
+            }
+            let (picked, _) = current.iter().enumerate().max_by_key(|&(i, &c)| (c, std::cmp::Reverse(i))).unwrap();
+            current[picked] -= total;
+            picked
+        })
+        .collect()
 }
 
 impl MultiLevelPriorityQueue {
     pub fn new(enable_adaptive: bool) -> Self {
+        Self::with_config(enable_adaptive, PriorityQueueConfig::default())
+    }
+
+    pub fn with_config(enable_adaptive: bool, config: PriorityQueueConfig) -> Self {
+        let capacity = config.capacity.max(1);
         Self {
-            system_queue: Arc::new(Mutex::new(VecDeque::new())),
-            admin_queue: Arc::new(Mutex::new(VecDeque::new())),
-            high_queue: Arc::new(Mutex::new(VecDeque::new())),
-            normal_queue: Arc::new(Mutex::new(VecDeque::new())),
-            low_queue: Arc::new(Mutex::new(VecDeque::new())),
-            background_queue: Arc::new(Mutex::new(VecDeque::new())),
-            adaptive_queue: Arc::new(Mutex::new(BinaryHeap::new())),
-            stats: Arc::new(RwLock::new(QueueStats::default())),
+            // 每层的上限都是总容量，任一层都能独占全部额度；槽位随该层的积压按需分配
+            tiers: std::array::from_fn(|_| SegmentedMpmcQueue::with_capacity(capacity)),
+            schedule: smooth_weighted_schedule(&TIER_WEIGHTS),
+            cursor: AtomicUsize::new(0),
+            len: AtomicUsize::new(0),
+            codel: CoDel::new(Instant::now()),
+            stats: AtomicQueueStats::default(),
+            config: PriorityQueueConfig { capacity, ..config },
             enable_adaptive,
         }
     }
 
     /// 添加请求到队列
-    pub async fn push(&self, request: Request) -> Result<(), String> {
-        let now = Instant::now();
-        let wait_time = now.duration_since(request.created_at);
-
-        // 更新统计信息
-        {
-            let mut stats = self.stats.write().await;
-            stats.total_requests += 1;
-            stats.avg_wait_time = Duration::from_millis(
-                ((stats.avg_wait_time.as_millis() as u64 + wait_time.as_millis() as u64) / 2)
-                    as u64,
-            );
-            if wait_time > stats.max_wait_time {
-                stats.max_wait_time = wait_time;
-            }
-        }
-
-        if self.enable_adaptive {
-            // 使用自适应队列
-            let priority_score = self.calculate_priority_score(&request, wait_time);
-            let item = PriorityQueueItem {
-                request: request.clone(),
-                priority_score,
-                wait_time,
-                estimated_cost: request.estimated_cost,
-            };
+    pub fn push(&self, request: Request) -> Result<(), RejectReason> {
+        self.push_at(request, Instant::now())
+    }
 
-            let mut queue = self.adaptive_queue.lock().await;
-            queue.push(item);
+    fn push_at(&self, request: Request, now: Instant) -> Result<(), RejectReason> {
+        if self.codel.is_overloaded() && is_sheddable(request.priority) {
+            self.stats.rejected_requests.fetch_add(1, Ordering::Relaxed);
+            return Err(RejectReason::Overloaded);
+        }
+        if self.len.fetch_add(1, Ordering::AcqRel) >= self.config.capacity {
+            self.len.fetch_sub(1, Ordering::AcqRel);
+            self.stats.rejected_requests.fetch_add(1, Ordering::Relaxed);
+            return Err(RejectReason::QueueFull);
+        }
 
-            // 更新统计
-            {
-                let mut stats = self.stats.write().await;
-                stats.adaptive_queue_size = queue.len();
-            }
+        let tier = if self.enable_adaptive {
+            let wait_time = now.saturating_duration_since(request.created_at);
+            let score = self.calculate_priority_score(&request, wait_time);
+            // 分数约在 [-10, 13]，每 2 分一层
+            (score / 2.0).round().clamp(0.0, (TIER_COUNT - 1) as f64) as usize
         } else {
-            // 使用固定优先级队列
-            let queue = match request.priority {
-                RequestPriority::System => &self.system_queue,
-                RequestPriority::Admin => &self.admin_queue,
-                RequestPriority::High => &self.high_queue,
-                RequestPriority::Normal => &self.normal_queue,
-                RequestPriority::Low => &self.low_queue,
-                RequestPriority::Background => &self.background_queue,
-            };
+            request.priority as usize
+        };
 
-            let mut queue_guard = queue.lock().await;
-            queue_guard.push_back(request.clone());
-
-            // 更新统计
-            {
-                let mut stats = self.stats.write().await;
-                match request.priority {
-                    RequestPriority::System => stats.system_queue_size = queue_guard.len(),
-                    RequestPriority::Admin => stats.admin_queue_size = queue_guard.len(),
-                    RequestPriority::High => stats.high_queue_size = queue_guard.len(),
-                    RequestPriority::Normal => stats.normal_queue_size = queue_guard.len(),
-                    RequestPriority::Low => stats.low_queue_size = queue_guard.len(),
-                    RequestPriority::Background => stats.background_queue_size = queue_guard.len(),
-                }
-            }
+        if self.tiers[tier].push(Queued { request, enqueued_at: now }).is_err() {
+            // 每层容量不小于总容量，只有计数与队列之间的短暂竞争才会走到这里
+            self.len.fetch_sub(1, Ordering::AcqRel);
+            self.stats.rejected_requests.fetch_add(1, Ordering::Relaxed);
+            return Err(RejectReason::QueueFull);
         }
-
+        self.stats.total_requests.fetch_add(1, Ordering::Relaxed);
         Ok(())
     }
 
     /// 从队列中获取下一个请求
-    pub async fn pop(&self) -> Option<Request> {
-        if self.enable_adaptive {
-            // 从自适应队列获取
-            let mut queue = self.adaptive_queue.lock().await;
-            if let Some(item) = queue.pop() {
-                // 更新统计
-                {
-                    let mut stats = self.stats.write().await;
-                    stats.adaptive_queue_size = queue.len();
-                }
-                return Some(item.request);
-            }
-        } else {
-            // 按优先级顺序从固定队列获取
-            let queues = [
-                &self.system_queue,
-                &self.admin_queue,
-                &self.high_queue,
-                &self.normal_queue,
-                &self.low_queue,
-                &self.background_queue,
-            ];
-
-            for queue in queues.iter() {
-                let mut queue_guard = queue.lock().await;
-                if let Some(request) = queue_guard.pop_front() {
-                    // 更新统计
-                    {
-                        let mut stats = self.stats.write().await;
-                        match request.priority {
-                            RequestPriority::System => stats.system_queue_size = queue_guard.len(),
-                            RequestPriority::Admin => stats.admin_queue_size = queue_guard.len(),
-                            RequestPriority::High => stats.high_queue_size = queue_guard.len(),
-                            RequestPriority::Normal => stats.normal_queue_size = queue_guard.len(),
-                            RequestPriority::Low => stats.low_queue_size = queue_guard.len(),
-                            RequestPriority::Background => {
-                                stats.background_queue_size = queue_guard.len()
-                            }
-                        }
-                    }
-                    return Some(request);
-                }
+    pub fn pop(&self) -> Option<Request> {
+        self.pop_at(Instant::now())
+    }
+
+    fn pop_at(&self, now: Instant) -> Option<Request> {
+        loop {
+            let Some(Queued { request, enqueued_at }) = self.pop_weighted() else {
+                // 排空即说明积压已消化
+                self.codel.reset();
+                return None;
+            };
+            self.len.fetch_sub(1, Ordering::AcqRel);
+
+            let sojourn = now.saturating_duration_since(enqueued_at);
+            self.stats.record_wait(sojourn);
+            self.codel.observe(sojourn, now, &self.config);
+
+            if self.codel.is_overloaded() && is_sheddable(request.priority) && sojourn >= self.config.target_delay {
+                self.stats.shed_requests.fetch_add(1, Ordering::Relaxed);
+                debug!("shed request {} after queueing {:?}", request.id, sojourn);
+                continue;
             }
+            return Some(request);
         }
+    }
 
-        None
+    /// 先取轮询选中的层，该层为空时按严格优先级取第一个非空层
+    fn pop_weighted(&self) -> Option<Queued> {
+        let slot = self.cursor.fetch_add(1, Ordering::Relaxed) % self.schedule.len();
+        let preferred = self.schedule[slot];
+        std::iter::once(preferred)
+            .chain((0..TIER_COUNT).filter(|&tier| tier != preferred))
+            .find_map(|tier| self.tiers[tier].pop())
     }
 
     /// 计算优先级分数（自适应调度）
@@ -233,28 +314,32 @@ impl MultiLevelPriorityQueue {
     }
 
     /// 获取队列统计信息
-    pub async fn get_stats(&self) -> QueueStats {
-        self.stats.read().await.clone()
+    pub fn get_stats(&self) -> QueueStats {
+        let tier_len = |priority: RequestPriority| self.tiers[priority as usize].len();
+        QueueStats {
+            system_queue_size: tier_len(RequestPriority::System),
+            admin_queue_size: tier_len(RequestPriority::Admin),
+            high_queue_size: tier_len(RequestPriority::High),
+            normal_queue_size: tier_len(RequestPriority::Normal),
+            low_queue_size: tier_len(RequestPriority::Low),
+            background_queue_size: tier_len(RequestPriority::Background),
+            total_requests: self.stats.total_requests.load(Ordering::Relaxed),
+            rejected_requests: self.stats.rejected_requests.load(Ordering::Relaxed),
+            shed_requests: self.stats.shed_requests.load(Ordering::Relaxed),
+            avg_wait_time: Duration::from_nanos(self.stats.avg_wait_nanos.load(Ordering::Relaxed)),
+            max_wait_time: Duration::from_nanos(self.stats.max_wait_nanos.load(Ordering::Relaxed)),
+            overloaded: self.codel.is_overloaded(),
+        }
     }
 
     /// 获取队列总长度
-    pub async fn len(&self) -> usize {
-        if self.enable_adaptive {
-            self.adaptive_queue.lock().await.len()
-        } else {
-            let stats = self.stats.read().await;
-            stats.system_queue_size
-                + stats.admin_queue_size
-                + stats.high_queue_size
-                + stats.normal_queue_size
-                + stats.low_queue_size
-                + stats.background_queue_size
-        }
+    pub fn len(&self) -> usize {
+        self.len.load(Ordering::Acquire)
     }
 
     /// 检查队列是否为空
-    pub async fn is_empty(&self) -> bool {
-        self.len().await == 0
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
     }
 }
 
@@ -264,15 +349,15 @@ mod tests {
     use std::time::Duration;
     use uuid::Uuid;
 
-    #[tokio::test]
-    async fn test_priority_queue_new() {
+    #[test]
+    fn test_priority_queue_new() {
         let queue = MultiLevelPriorityQueue::new(false);
-        assert_eq!(queue.len().await, 0);
-        assert!(queue.is_empty().await);
+        assert_eq!(queue.len(), 0);
+        assert!(queue.is_empty());
     }
 
-    #[tokio::test]
-    async fn test_priority_queue_push_and_pop() {
+    #[test]
+    fn test_priority_queue_push_and_pop() {
         let queue = MultiLevelPriorityQueue::new(false);
 
         // 添加不同优先级的请求
@@ -315,27 +400,27 @@ mod tests {
             estimated_cost: 200,
         };
 
-        queue.push(request1).await.unwrap();
-        queue.push(request2).await.unwrap();
-        queue.push(request3).await.unwrap();
+        queue.push(request1).unwrap();
+        queue.push(request2).unwrap();
+        queue.push(request3).unwrap();
 
-        assert_eq!(queue.len().await, 3);
+        assert_eq!(queue.len(), 3);
 
         // 验证优先级顺序：System > High > Low
-        let first = queue.pop().await.unwrap();
+        let first = queue.pop().unwrap();
         assert_eq!(first.priority, RequestPriority::System);
 
-        let second = queue.pop().await.unwrap();
+        let second = queue.pop().unwrap();
         assert_eq!(second.priority, RequestPriority::High);
 
-        let third = queue.pop().await.unwrap();
+        let third = queue.pop().unwrap();
         assert_eq!(third.priority, RequestPriority::Low);
 
-        assert!(queue.is_empty().await);
+        assert!(queue.is_empty());
     }
 
-    #[tokio::test]
-    async fn test_priority_queue_peek() {
+    #[test]
+    fn test_priority_queue_peek() {
         let queue = MultiLevelPriorityQueue::new(false);
 
         let request = Request {
@@ -351,17 +436,17 @@ mod tests {
             estimated_cost: 100,
         };
 
-        queue.push(request).await.unwrap();
+        queue.push(request).unwrap();
 
-        let peeked = queue.pop().await.unwrap();
+        let peeked = queue.pop().unwrap();
         assert_eq!(peeked.priority, RequestPriority::High);
 
         // 验证 peek 不会移除元素
-        assert_eq!(queue.len().await, 0);
+        assert_eq!(queue.len(), 0);
     }
 
-    #[tokio::test]
-    async fn test_priority_queue_stats() {
+    #[test]
+    fn test_priority_queue_stats() {
         let queue = MultiLevelPriorityQueue::new(false);
         let start_time = Instant::now();
 
@@ -379,14 +464,102 @@ mod tests {
                 timeout: Duration::from_secs(30),
                 estimated_cost: 100,
             };
-            queue.push(request).await.unwrap();
+            queue.push(request).unwrap();
         }
 
-        let stats = queue.get_stats().await;
+        let stats = queue.get_stats();
         assert_eq!(stats.total_requests, 3);
         assert_eq!(stats.avg_wait_time.as_millis(), 0); // 刚添加的请求等待时间为0
     }
 
+    fn request(priority: RequestPriority, created_at: Instant) -> Request {
+        Request {
+            id: Uuid::new_v4(),
+            priority,
+            request_type: RequestType::Query,
+            sql: "SELECT 1".to_string(),
+            connection_id: Uuid::new_v4(),
+            user_id: None,
+            database: None,
+            created_at,
+            timeout: Duration::from_secs(30),
+            estimated_cost: 0,
+        }
+    }
+
+    #[test]
+    fn test_weighted_dequeue_does_not_starve_background() {
+        let queue = MultiLevelPriorityQueue::new(false);
+        let now = Instant::now();
+        for _ in 0..100 {
+            queue.push_at(request(RequestPriority::System, now), now).unwrap();
+            queue.push_at(request(RequestPriority::Background, now), now).unwrap();
+        }
+
+        // 一轮轮询共 63 次出队，System 与 Background 都积压时 Background 分到 1 次，
+        // 其余层为空的 30 次回落到 System
+        let round: u32 = TIER_WEIGHTS.iter().sum();
+        let background = (0..round)
+            .filter(|_| queue.pop_at(now).unwrap().priority == RequestPriority::Background)
+            .count();
+        assert_eq!(background, 1);
+        assert_eq!(queue.len(), 200 - round as usize);
+    }
+
+    #[test]
+    fn test_capacity_rejects_when_full() {
+        let config = PriorityQueueConfig { capacity: 2, ..Default::default() };
+        let queue = MultiLevelPriorityQueue::with_config(false, config);
+        let now = Instant::now();
+        queue.push_at(request(RequestPriority::High, now), now).unwrap();
+        queue.push_at(request(RequestPriority::Normal, now), now).unwrap();
+        assert_eq!(queue.push_at(request(RequestPriority::System, now), now), Err(RejectReason::QueueFull));
+        assert_eq!(queue.get_stats().rejected_requests, 1);
+
+        queue.pop_at(now).unwrap();
+        queue.push_at(request(RequestPriority::System, now), now).unwrap();
+        assert_eq!(queue.len(), 2);
+    }
+
+    #[test]
+    fn test_sustained_queue_delay_sheds_low_priority() {
+        let config = PriorityQueueConfig {
+            capacity: 100,
+            target_delay: Duration::from_millis(5),
+            interval: Duration::from_millis(100),
+        };
+        let queue = MultiLevelPriorityQueue::with_config(false, config);
+        let t0 = Instant::now();
+        for _ in 0..4 {
+            queue.push_at(request(RequestPriority::High, t0), t0).unwrap();
+        }
+        queue.push_at(request(RequestPriority::Low, t0), t0).unwrap();
+
+        // 排队 50ms 高于目标，但还未持续满一个 interval
+        queue.pop_at(t0 + Duration::from_millis(50)).unwrap();
+        assert!(!queue.get_stats().overloaded);
+        queue.push_at(request(RequestPriority::Background, t0), t0).unwrap();
+
+        // 160ms 时高于目标已超过 interval：进入过载，低优先级入队被拒绝
+        queue.pop_at(t0 + Duration::from_millis(160)).unwrap();
+        assert!(queue.get_stats().overloaded);
+        let now = t0 + Duration::from_millis(160);
+        assert_eq!(queue.push_at(request(RequestPriority::Low, now), now), Err(RejectReason::Overloaded));
+        queue.push_at(request(RequestPriority::Normal, now), now).unwrap();
+
+        // 已排队的 Low/Background 在出队时被丢弃，只剩高优先级请求
+        let later = now + Duration::from_millis(10);
+        let mut served: Vec<_> = std::iter::from_fn(|| queue.pop_at(later)).map(|r| r.priority).collect();
+        served.sort();
+        assert_eq!(served, vec![RequestPriority::High, RequestPriority::High, RequestPriority::Normal]);
+        let stats = queue.get_stats();
+        assert_eq!((stats.shed_requests, stats.rejected_requests), (2, 1));
+
+        // 排空后解除过载
+        assert!(!stats.overloaded);
+        queue.push_at(request(RequestPriority::Background, later), later).unwrap();
+    }
+
     #[test]
     fn test_request_priority_ordering() {
         let priorities = [
@@ -96,6 +96,10 @@ pub struct ThreadPoolConfig {
     pub connection_idle_timeout: u64,
     /// 是否启用优先级队列
     pub enable_priority_queue: bool,
+    /// 目标排队时延（毫秒），持续高于该值时拒绝/丢弃低优先级请求
+    pub queue_target_delay_ms: u64,
+    /// 排队时延持续高于目标值多久判定为过载（毫秒）
+    pub queue_overload_interval_ms: u64,
     /// 是否启用资源限制
     pub enable_resource_limit: bool,
     /// 最大内存使用量（MB）
@@ -115,6 +119,8 @@ impl Default for ThreadPoolConfig {
             connection_pool_size: 100,
             connection_idle_timeout: 300,
             enable_priority_queue: true,
+            queue_target_delay_ms: 5,
+            queue_overload_interval_ms: 100,
             enable_resource_limit: true,
             max_memory_usage: 1024, // 1GB
             max_cpu_usage: 80.0,
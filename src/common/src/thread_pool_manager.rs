@@ -1,11 +1,12 @@
-use std::collections::{HashMap, VecDeque};
+use std::collections::HashMap;
 use std::sync::Arc;
 use sysinfo::{CpuExt, System, SystemExt};
-use tokio::sync::{Mutex, RwLock, Semaphore};
+use tokio::sync::{Notify, RwLock, Semaphore};
 use tokio::time::{Duration, Instant};
 use tracing::{debug, error, info};
 use uuid::Uuid;
 
+use crate::priority_queue::{MultiLevelPriorityQueue, PriorityQueueConfig, QueueStats};
 use crate::{thread_pool::*, Error, Result};
 
 /// 工作线程状态
@@ -35,8 +36,10 @@ pub struct ThreadPoolManager {
     workers: Arc<RwLock<HashMap<usize, Worker>>>,
     /// 连接池
     connections: Arc<RwLock<HashMap<Uuid, Connection>>>,
-    /// 请求队列
-    request_queue: Arc<Mutex<VecDeque<Request>>>,
+    /// 请求队列（无锁多级优先级队列，带准入控制）
+    request_queue: Arc<MultiLevelPriorityQueue>,
+    /// 有新请求入队时唤醒空闲的工作线程
+    request_ready: Arc<Notify>,
     /// 工作线程信号量
     worker_semaphore: Arc<Semaphore>,
     /// 连接池信号量
@@ -108,11 +111,18 @@ impl ThreadPoolManager {
     pub async fn new(config: ThreadPoolConfig) -> Result<Self> {
         let resource_monitor = Arc::new(ResourceMonitor::new(Duration::from_secs(5)));
 
+        let queue_config = PriorityQueueConfig {
+            capacity: config.queue_size,
+            target_delay: Duration::from_millis(config.queue_target_delay_ms),
+            interval: Duration::from_millis(config.queue_overload_interval_ms),
+        };
+
         let manager = Self {
             config: config.clone(),
             workers: Arc::new(RwLock::new(HashMap::new())),
             connections: Arc::new(RwLock::new(HashMap::new())),
-            request_queue: Arc::new(Mutex::new(VecDeque::new())),
+            request_queue: Arc::new(MultiLevelPriorityQueue::with_config(false, queue_config)),
+            request_ready: Arc::new(Notify::new()),
             worker_semaphore: Arc::new(Semaphore::new(config.max_threads)),
             connection_semaphore: Arc::new(Semaphore::new(config.connection_pool_size)),
             stats: Arc::new(RwLock::new(ThreadPoolStats {
@@ -152,6 +162,7 @@ impl ThreadPoolManager {
     async fn spawn_worker(&self, worker_id: usize) -> Result<()> {
         let workers = self.workers.clone();
         let request_queue = self.request_queue.clone();
+        let request_ready = self.request_ready.clone();
         let worker_semaphore = self.worker_semaphore.clone();
         let stats = self.stats.clone();
         let shutdown = self.shutdown.clone();
@@ -185,12 +196,7 @@ impl ThreadPoolManager {
                 }
 
                 // 获取请求
-                let request = {
-                    let mut queue = request_queue.lock().await;
-                    queue.pop_front()
-                };
-
-                if let Some(request) = request {
+                if let Some(request) = request_queue.pop() {
                     // 更新工作线程状态
                     {
                         let mut workers_guard = workers.write().await;
@@ -204,7 +210,6 @@ impl ThreadPoolManager {
                     {
                         let mut stats_guard = stats.write().await;
                         stats_guard.active_threads += 1;
-                        stats_guard.queued_requests = request_queue.lock().await.len();
                     }
 
                     // 处理请求
@@ -239,8 +244,8 @@ impl ThreadPoolManager {
                         Err(e) => error!("Request {} failed: {}", request.id, e),
                     }
                 } else {
-                    // 没有请求，等待一段时间
-                    tokio::time::sleep(Duration::from_millis(10)).await;
+                    // 没有请求，等待入队通知；超时后重新检查关闭标志
+                    let _ = tokio::time::timeout(Duration::from_millis(10), request_ready.notified()).await;
                 }
             }
 
@@ -310,20 +315,11 @@ impl ThreadPoolManager {
             }
         }
 
-        // 添加到队列
-        {
-            let mut queue = self.request_queue.lock().await;
-            if queue.len() >= self.config.queue_size {
-                return Err(Error::Execution("Request queue is full".to_string()));
-            }
-            queue.push_back(request);
-        }
-
-        // 更新统计
-        {
-            let mut stats = self.stats.write().await;
-            stats.queued_requests = self.request_queue.lock().await.len();
-        }
+        // 添加到队列：队列满或过载时的低优先级请求直接拒绝
+        self.request_queue
+            .push(request)
+            .map_err(|reason| Error::Execution(format!("Request rejected: {}", reason)))?;
+        self.request_ready.notify_one();
 
         Ok(())
     }
@@ -391,12 +387,18 @@ impl ThreadPoolManager {
         let mut stats = self.stats.read().await.clone();
 
         // 更新实时统计
+        stats.queued_requests = self.request_queue.len();
         stats.memory_usage = self.resource_monitor.get_memory_usage().await / (1024 * 1024);
         stats.cpu_usage = self.resource_monitor.get_cpu_usage().await;
 
         stats
     }
 
+    /// 获取请求队列统计信息（各层长度、排队时延、拒绝与丢弃数）
+    pub fn queue_stats(&self) -> QueueStats {
+        self.request_queue.get_stats()
+    }
+
     /// 关闭线程池管理器
     pub async fn shutdown(&self) -> Result<()> {
         info!("Shutting down ThreadPoolManager...");
@@ -414,3 +416,43 @@ impl ThreadPoolManager {
         Ok(())
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn request(priority: RequestPriority) -> Request {
+        Request {
+            id: Uuid::new_v4(),
+            priority,
+            request_type: RequestType::Query,
+            sql: "SELECT 1".to_string(),
+            connection_id: Uuid::new_v4(),
+            user_id: None,
+            database: None,
+            created_at: Instant::now(),
+            timeout: Duration::from_secs(30),
+            estimated_cost: 0,
+        }
+    }
+
+    #[tokio::test]
+    async fn test_submit_request_rejects_beyond_queue_size() {
+        // 不启动工作线程，请求只进不出
+        let config = ThreadPoolConfig {
+            core_threads: 0,
+            queue_size: 2,
+            enable_resource_limit: false,
+            ..Default::default()
+        };
+        let manager = ThreadPoolManager::new(config).await.unwrap();
+        manager.submit_request(request(RequestPriority::Normal)).await.unwrap();
+        manager.submit_request(request(RequestPriority::Low)).await.unwrap();
+        let err = manager.submit_request(request(RequestPriority::System)).await.unwrap_err();
+        assert!(err.to_string().contains("request queue is full"));
+
+        let queue_stats = manager.queue_stats();
+        assert_eq!((queue_stats.total_requests, queue_stats.rejected_requests), (2, 1));
+        assert_eq!(manager.get_stats().await.queued_requests, 2);
+    }
+}
@@ -95,8 +95,8 @@ impl TiKVClient {
         }
     }
 
+    /// 开始事务，写入缓冲在本地直到提交
     pub async fn begin_transaction(&self) -> Result<TiKVTransaction> {
-        // 简化实现，暂时返回空事务
-        Ok(TiKVTransaction::new())
+        Ok(TiKVTransaction::new(self.client.clone()))
     }
 }
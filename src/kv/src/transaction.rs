@@ -1,58 +1,106 @@
 use common::{Error, Result};
-use tracing::debug;
+use std::collections::BTreeMap;
+use tikv_client::{Key, RawClient};
+use tracing::{debug, error};
 
-/// TiKV 事务封装 (简化实现)
+/// TiKV 事务封装
+///
+/// 写入先留在本地写缓冲，读自己写过的键不访问 TiKV，提交时所有写入合成一次批量写入与
+/// 一次批量删除发出。底层是 Raw KV 接口，批量写入之间没有跨键原子性；需要原子提交的
+/// 事务走 `storage::engine::tikv` 的事务实现。
 pub struct TiKVTransaction {
-    // 暂时为空，后续实现
-}
-
-impl Default for TiKVTransaction {
-    fn default() -> Self {
-        Self::new()
-    }
+    client: RawClient,
+    /// 键 -> 写入的值，删除为 None
+    writes: BTreeMap<Vec<u8>, Option<Vec<u8>>>,
 }
 
 impl TiKVTransaction {
-    pub fn new() -> Self {
-        Self {}
+    pub fn new(client: RawClient) -> Self {
+        Self { client, writes: BTreeMap::new() }
     }
 
-    pub async fn get(&mut self, _key: &[u8]) -> Result<Option<Vec<u8>>> {
-        Err(Error::Transaction(
-            "Transaction not implemented yet".to_string(),
-        ))
+    pub async fn get(&mut self, key: &[u8]) -> Result<Option<Vec<u8>>> {
+        if let Some(buffered) = self.writes.get(key) {
+            return Ok(buffered.clone());
+        }
+        self.client
+            .get(Key::from(key.to_vec()))
+            .await
+            .map_err(|e| Error::Transaction(format!("Transaction get failed: {e}")))
     }
 
-    pub async fn put(&mut self, _key: &[u8], _value: &[u8]) -> Result<()> {
-        Err(Error::Transaction(
-            "Transaction not implemented yet".to_string(),
-        ))
+    pub async fn put(&mut self, key: &[u8], value: &[u8]) -> Result<()> {
+        self.writes.insert(key.to_vec(), Some(value.to_vec()));
+        Ok(())
     }
 
-    pub async fn delete(&mut self, _key: &[u8]) -> Result<()> {
-        Err(Error::Transaction(
-            "Transaction not implemented yet".to_string(),
-        ))
+    pub async fn delete(&mut self, key: &[u8]) -> Result<()> {
+        self.writes.insert(key.to_vec(), None);
+        Ok(())
     }
 
+    /// 扫描 `[start_key, end_key)`，结果包含本事务未提交的写入
     pub async fn scan(
         &mut self,
-        _start_key: &[u8],
-        _end_key: &[u8],
-        _limit: u32,
+        start_key: &[u8],
+        end_key: &[u8],
+        limit: u32,
     ) -> Result<Vec<(Vec<u8>, Vec<u8>)>> {
-        Err(Error::Transaction(
-            "Transaction not implemented yet".to_string(),
-        ))
+        let buffered: Vec<(&Vec<u8>, &Option<Vec<u8>>)> = match start_key < end_key {
+            true => self.writes.range(start_key.to_vec()..end_key.to_vec()).collect(),
+            false => Vec::new(),
+        };
+        // 本事务删除的键会从结果中去掉，多取这么多个才能凑满 limit
+        let deleted = buffered.iter().filter(|(_, value)| value.is_none()).count() as u32;
+        let pairs = self
+            .client
+            .scan(Key::from(start_key.to_vec())..Key::from(end_key.to_vec()), limit.saturating_add(deleted))
+            .await
+            .map_err(|e| Error::Transaction(format!("Transaction scan failed: {e}")))?;
+
+        let mut merged: BTreeMap<Vec<u8>, Vec<u8>> =
+            pairs.into_iter().map(|pair| (pair.key().clone().into(), pair.value().clone())).collect();
+        for (key, value) in buffered {
+            match value {
+                Some(value) => merged.insert(key.clone(), value.clone()),
+                None => merged.remove(key),
+            };
+        }
+        Ok(merged.into_iter().take(limit as usize).collect())
     }
 
     pub async fn commit(self) -> Result<()> {
-        debug!("Transaction committed successfully");
+        if self.writes.is_empty() {
+            return Ok(());
+        }
+        let mut puts = Vec::new();
+        let mut deletes = Vec::new();
+        for (key, value) in self.writes {
+            match value {
+                Some(value) => puts.push((Key::from(key), value)),
+                None => deletes.push(Key::from(key)),
+            }
+        }
+        let (put_count, delete_count) = (puts.len(), deletes.len());
+
+        if !puts.is_empty() {
+            self.client.batch_put(puts).await.map_err(|e| {
+                error!("Transaction batch put failed: {}", e);
+                Error::Transaction(format!("Transaction commit failed: {e}"))
+            })?;
+        }
+        if !deletes.is_empty() {
+            self.client.batch_delete(deletes).await.map_err(|e| {
+                error!("Transaction batch delete failed: {}", e);
+                Error::Transaction(format!("Transaction commit failed: {e}"))
+            })?;
+        }
+        debug!("Transaction committed: {} puts, {} deletes", put_count, delete_count);
         Ok(())
     }
 
     pub async fn rollback(self) -> Result<()> {
-        debug!("Transaction rolled back successfully");
+        debug!("Transaction rolled back, {} buffered writes discarded", self.writes.len());
         Ok(())
     }
 }
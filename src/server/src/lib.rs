@@ -1 +1,118 @@
+//! SealDB 服务端
+//!
+//! 监听客户端连接，每个连接一个会话。查询结果以流的形式逐块发给客户端：首行不必等整个
+//! 结果集，客户端读得慢时执行随之停下，客户端取消或断开时查询被终止。
+//!
+//! `run` 同时在 `http_port` 上提供 Prometheus 的 `GET /metrics`。
 
+pub mod protocol;
+pub mod session;
+
+pub use protocol::{ClientMessage, ServerMessage};
+pub use session::{serve_connection, QueryService};
+
+use common::config::ServerConfig;
+use common::Result;
+use sql::metrics::{serve_metrics, MetricsSource};
+use std::net::SocketAddr;
+use std::sync::Arc;
+use std::time::Duration;
+use tokio::net::TcpListener;
+use tokio::sync::Semaphore;
+use tokio::task::JoinHandle;
+use tracing::{info, warn};
+
+/// 接受连接失败后重试前的等待，避免在持续性错误上空转
+const ACCEPT_RETRY_DELAY: Duration = Duration::from_millis(100);
+
+/// SealDB 服务端
+pub struct Server {
+    service: Arc<dyn QueryService>,
+    config: ServerConfig,
+    /// 除引擎级指标外随 `/metrics` 导出的组件指标
+    metrics: Vec<Arc<dyn MetricsSource>>,
+}
+
+impl Server {
+    pub fn new(service: Arc<dyn QueryService>, config: ServerConfig) -> Self {
+        Self { service, config, metrics: Vec::new() }
+    }
+
+    /// 设置随 `/metrics` 导出的组件指标，如 `SqlEngine::metrics_sources`
+    pub fn with_metrics(mut self, sources: Vec<Arc<dyn MetricsSource>>) -> Self {
+        self.metrics = sources;
+        self
+    }
+
+    /// 绑定配置中的地址并开始服务，同时启动 `/metrics`
+    pub async fn run(&self) -> Result<()> {
+        let (metrics_addr, metrics) = self.start_metrics().await?;
+        info!("SealDB metrics listening on {}", metrics_addr);
+        let listener = TcpListener::bind((self.config.host.as_str(), self.config.port)).await?;
+        info!("SealDB server listening on {}", listener.local_addr()?);
+        let result = self.serve(listener).await;
+        metrics.abort();
+        result
+    }
+
+    /// 在 `http_port` 上启动 `/metrics`，返回实际监听的地址
+    pub async fn start_metrics(&self) -> Result<(SocketAddr, JoinHandle<Result<()>>)> {
+        let listener = TcpListener::bind((self.config.host.as_str(), self.config.http_port)).await?;
+        let addr = listener.local_addr()?;
+        Ok((addr, tokio::spawn(serve_metrics(listener, self.metrics.clone()))))
+    }
+
+    /// 在已绑定的监听器上接受连接，超过 `max_connections` 时等待已有连接结束
+    ///
+    /// 接受连接失败 (例如文件描述符耗尽) 只记录日志，稍等片刻后继续服务。
+    pub async fn serve(&self, listener: TcpListener) -> Result<()> {
+        let permits = Arc::new(Semaphore::new(self.config.max_connections.max(1)));
+        loop {
+            let permit = permits.clone().acquire_owned().await.expect("semaphore is never closed");
+            let (connection, peer) = match listener.accept().await {
+                Ok(accepted) => accepted,
+                Err(e) => {
+                    warn!("Failed to accept connection: {}", e);
+                    tokio::time::sleep(ACCEPT_RETRY_DELAY).await;
+                    continue;
+                }
+            };
+            if let Err(e) = connection.set_nodelay(true) {
+                warn!("Failed to set TCP_NODELAY for {}: {}", peer, e);
+            }
+            let service = self.service.clone();
+            tokio::spawn(async move {
+                if let Err(e) = serve_connection(service, connection).await {
+                    warn!("Session with {} ended with error: {}", peer, e);
+                }
+                drop(permit);
+            });
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use sql::SqlEngine;
+    use tokio::io::{AsyncReadExt, AsyncWriteExt};
+
+    #[tokio::test]
+    async fn test_metrics_include_engine_component_stats() {
+        let engine = Arc::new(SqlEngine::new());
+        let config = ServerConfig { http_port: 0, ..ServerConfig::default() };
+        let server = Server::new(engine.clone(), config).with_metrics(engine.metrics_sources());
+        let (addr, metrics) = server.start_metrics().await.unwrap();
+
+        let mut stream = tokio::net::TcpStream::connect(addr).await.unwrap();
+        stream.write_all(b"GET /metrics HTTP/1.1\r\n\r\n").await.unwrap();
+        let mut response = String::new();
+        stream.read_to_string(&mut response).await.unwrap();
+        assert!(response.starts_with("HTTP/1.1 200 OK"));
+        assert!(response.contains("# TYPE sealdb_query_duration_seconds histogram"));
+        assert!(response.contains("\nsealdb_executor_queries_total "));
+        assert!(response.contains("\nsealdb_work_memory_limit_bytes "));
+        assert!(response.contains("sealdb_cache_hit_ratio{cache=\"plan\"}"));
+        metrics.abort();
+    }
+}
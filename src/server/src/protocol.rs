@@ -0,0 +1,184 @@
+//! 线路协议
+//!
+//! 每条消息为 1 字节类型、4 字节大端长度、负载。客户端发送查询 (`Q`)、取消当前查询 (`C`)
+//! 与结束会话 (`X`)；服务端对每个查询依次返回列描述 (`T`)、若干数据行 (`D`)，最后以
+//! 完成 (`S`) 或错误 (`E`) 结束。行内每个字段为 4 字节长度加 UTF-8 内容。
+
+use common::{Error, Result};
+use tokio::io::{AsyncRead, AsyncReadExt, AsyncWrite, AsyncWriteExt};
+
+/// 单条消息负载的上限
+pub const MAX_FRAME_SIZE: usize = 64 * 1024 * 1024;
+
+/// 客户端消息
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub enum ClientMessage {
+    Query(String),
+    Cancel,
+    Terminate,
+}
+
+/// 服务端消息
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub enum ServerMessage {
+    RowDescription(Vec<String>),
+    DataRow(Vec<String>),
+    /// 返回或影响的行数
+    CommandComplete(u64),
+    Error(String),
+}
+
+impl ClientMessage {
+    pub fn encode(&self, out: &mut Vec<u8>) {
+        match self {
+            ClientMessage::Query(sql) => put_frame(out, b'Q', sql.as_bytes()),
+            ClientMessage::Cancel => put_frame(out, b'C', &[]),
+            ClientMessage::Terminate => put_frame(out, b'X', &[]),
+        }
+    }
+
+    fn decode(tag: u8, payload: Vec<u8>) -> Result<Self> {
+        match tag {
+            b'Q' => Ok(ClientMessage::Query(utf8(payload)?)),
+            b'C' => Ok(ClientMessage::Cancel),
+            b'X' => Ok(ClientMessage::Terminate),
+            other => Err(Error::Network(format!("unknown client message type {other:#04x}"))),
+        }
+    }
+}
+
+impl ServerMessage {
+    pub fn encode(&self, out: &mut Vec<u8>) {
+        match self {
+            ServerMessage::RowDescription(fields) => put_frame(out, b'T', &encode_fields(fields)),
+            ServerMessage::DataRow(fields) => put_frame(out, b'D', &encode_fields(fields)),
+            ServerMessage::CommandComplete(rows) => put_frame(out, b'S', &rows.to_be_bytes()),
+            ServerMessage::Error(message) => put_frame(out, b'E', message.as_bytes()),
+        }
+    }
+
+    fn decode(tag: u8, payload: Vec<u8>) -> Result<Self> {
+        match tag {
+            b'T' => Ok(ServerMessage::RowDescription(decode_fields(&payload)?)),
+            b'D' => Ok(ServerMessage::DataRow(decode_fields(&payload)?)),
+            b'S' => {
+                let rows = payload
+                    .try_into()
+                    .map_err(|_| Error::Network("malformed command complete".to_string()))?;
+                Ok(ServerMessage::CommandComplete(u64::from_be_bytes(rows)))
+            }
+            b'E' => Ok(ServerMessage::Error(utf8(payload)?)),
+            other => Err(Error::Network(format!("unknown server message type {other:#04x}"))),
+        }
+    }
+}
+
+/// 读取一条客户端消息，连接在消息边界上关闭时返回 `None`
+pub async fn read_client_message<R: AsyncRead + Unpin>(reader: &mut R) -> Result<Option<ClientMessage>> {
+    match read_frame(reader).await? {
+        Some((tag, payload)) => ClientMessage::decode(tag, payload).map(Some),
+        None => Ok(None),
+    }
+}
+
+/// 读取一条服务端消息，连接在消息边界上关闭时返回 `None`
+pub async fn read_server_message<R: AsyncRead + Unpin>(reader: &mut R) -> Result<Option<ServerMessage>> {
+    match read_frame(reader).await? {
+        Some((tag, payload)) => ServerMessage::decode(tag, payload).map(Some),
+        None => Ok(None),
+    }
+}
+
+/// 写出已编码的消息并刷新
+pub async fn write_frames<W: AsyncWrite + Unpin>(writer: &mut W, frames: &[u8]) -> Result<()> {
+    writer.write_all(frames).await?;
+    writer.flush().await?;
+    Ok(())
+}
+
+async fn read_frame<R: AsyncRead + Unpin>(reader: &mut R) -> Result<Option<(u8, Vec<u8>)>> {
+    let mut tag = [0u8; 1];
+    if reader.read(&mut tag).await? == 0 {
+        return Ok(None);
+    }
+    let len = reader.read_u32().await? as usize;
+    if len > MAX_FRAME_SIZE {
+        return Err(Error::Network(format!("frame of {len} bytes exceeds limit")));
+    }
+    let mut payload = vec![0u8; len];
+    reader.read_exact(&mut payload).await?;
+    Ok(Some((tag[0], payload)))
+}
+
+fn put_frame(out: &mut Vec<u8>, tag: u8, payload: &[u8]) {
+    out.push(tag);
+    out.extend_from_slice(&(payload.len() as u32).to_be_bytes());
+    out.extend_from_slice(payload);
+}
+
+fn encode_fields(fields: &[String]) -> Vec<u8> {
+    let mut payload = Vec::with_capacity(4 + fields.iter().map(|f| 4 + f.len()).sum::<usize>());
+    payload.extend_from_slice(&(fields.len() as u32).to_be_bytes());
+    for field in fields {
+        payload.extend_from_slice(&(field.len() as u32).to_be_bytes());
+        payload.extend_from_slice(field.as_bytes());
+    }
+    payload
+}
+
+fn decode_fields(mut payload: &[u8]) -> Result<Vec<String>> {
+    fn take<'a>(payload: &mut &'a [u8], len: usize) -> Result<&'a [u8]> {
+        if payload.len() < len {
+            return Err(Error::Network("truncated row".to_string()));
+        }
+        let (head, rest) = payload.split_at(len);
+        *payload = rest;
+        Ok(head)
+    }
+    let count = u32::from_be_bytes(take(&mut payload, 4)?.try_into().unwrap()) as usize;
+    let mut fields = Vec::with_capacity(count.min(payload.len() / 4));
+    for _ in 0..count {
+        let len = u32::from_be_bytes(take(&mut payload, 4)?.try_into().unwrap()) as usize;
+        fields.push(utf8(take(&mut payload, len)?.to_vec())?);
+    }
+    Ok(fields)
+}
+
+fn utf8(bytes: Vec<u8>) -> Result<String> {
+    String::from_utf8(bytes).map_err(|e| Error::Network(format!("invalid utf-8 in message: {e}")))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[tokio::test]
+    async fn test_messages_round_trip() {
+        let mut wire = Vec::new();
+        ClientMessage::Query("SELECT 1".to_string()).encode(&mut wire);
+        ClientMessage::Cancel.encode(&mut wire);
+        let mut reader = wire.as_slice();
+        assert_eq!(read_client_message(&mut reader).await.unwrap(), Some(ClientMessage::Query("SELECT 1".to_string())));
+        assert_eq!(read_client_message(&mut reader).await.unwrap(), Some(ClientMessage::Cancel));
+        assert_eq!(read_client_message(&mut reader).await.unwrap(), None);
+
+        let messages = vec![
+            ServerMessage::RowDescription(vec!["id".to_string(), "名字".to_string()]),
+            ServerMessage::DataRow(vec!["1".to_string(), String::new()]),
+            ServerMessage::CommandComplete(1),
+            ServerMessage::Error("boom".to_string()),
+        ];
+        let mut wire = Vec::new();
+        for message in &messages {
+            message.encode(&mut wire);
+        }
+        let mut reader = wire.as_slice();
+        for message in messages {
+            assert_eq!(read_server_message(&mut reader).await.unwrap(), Some(message));
+        }
+
+        // 截断的行与未知类型都被拒绝
+        assert!(decode_fields(&[0, 0, 0, 2, 0, 0, 0, 1]).is_err());
+        assert!(read_client_message(&mut [b'?', 0, 0, 0, 0].as_slice()).await.is_err());
+    }
+}
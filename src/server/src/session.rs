@@ -0,0 +1,322 @@
+//! 客户端会话
+//!
+//! 每个连接一个会话：读取任务解析客户端消息，查询排队交给执行循环，取消与断开直接作用于
+//! 正在执行的查询。执行循环每从结果流取一块就写出并刷新一次，写不出去 (客户端读得慢)
+//! 时不会再取下一块，背压经算子链一直传到存储层的预读。
+//!
+//! 查询按收到的顺序编号，取消作用于在它之前发来的所有查询 (正在执行或仍在排队)，
+//! 不会波及之后的查询；取消句柄在规划之前登记，规划期间到达的取消同样生效。
+
+use async_trait::async_trait;
+use common::{Error, Result};
+use sql::executor::{CancelHandle, ResultStream};
+use sql::SqlEngine;
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::{Arc, Mutex};
+use tokio::io::{AsyncRead, AsyncWrite, AsyncWriteExt};
+use tokio::sync::mpsc;
+use tracing::{debug, warn};
+
+use crate::protocol::{read_client_message, write_frames, ClientMessage, ServerMessage};
+
+/// 客户端发来但尚未开始执行的查询数上限
+const MAX_PENDING_QUERIES: usize = 16;
+
+/// 会话执行查询所需的服务
+#[async_trait]
+pub trait QueryService: Send + Sync {
+    async fn execute_stream(&self, sql: &str) -> Result<ResultStream>;
+}
+
+#[async_trait]
+impl QueryService for SqlEngine {
+    async fn execute_stream(&self, sql: &str) -> Result<ResultStream> {
+        self.execute_query_stream(sql).await
+    }
+}
+
+/// 读取任务与执行循环共享的状态
+#[derive(Default)]
+struct SessionState {
+    /// 正在执行的查询的编号与取消句柄
+    current: Mutex<Option<(u64, CancelHandle)>>,
+    /// 编号不超过该值的查询都已被取消
+    cancelled_through: AtomicU64,
+    /// 客户端已结束会话或断开
+    closed: AtomicBool,
+}
+
+impl SessionState {
+    /// 取消编号不超过 `query` 的查询
+    fn cancel_through(&self, query: u64) {
+        self.cancelled_through.fetch_max(query, Ordering::AcqRel);
+        if let Some((current, cancel)) = self.current.lock().unwrap().as_ref() {
+            if *current <= query {
+                cancel.cancel();
+            }
+        }
+    }
+
+    /// 登记开始执行的查询，返回它的取消句柄
+    fn begin(&self, query: u64) -> CancelHandle {
+        let cancel = CancelHandle::default();
+        *self.current.lock().unwrap() = Some((query, cancel.clone()));
+        // 先登记再检查：与 cancel_through 的先更新再加锁配合，两边至少有一边看到对方
+        if query <= self.cancelled_through.load(Ordering::Acquire) {
+            cancel.cancel();
+        }
+        cancel
+    }
+
+    fn finish(&self) {
+        *self.current.lock().unwrap() = None;
+    }
+}
+
+/// 在一个连接上运行会话，直到客户端结束会话或断开
+pub async fn serve_connection<S>(service: Arc<dyn QueryService>, connection: S) -> Result<()>
+where
+    S: AsyncRead + AsyncWrite + Send + 'static,
+{
+    let (mut reader, mut writer) = tokio::io::split(connection);
+    let state = Arc::new(SessionState::default());
+    let (queries, mut pending) = mpsc::channel::<(u64, String)>(MAX_PENDING_QUERIES);
+
+    let reader_state = state.clone();
+    let reader_task = tokio::spawn(async move {
+        let mut received = 0;
+        loop {
+            match read_client_message(&mut reader).await {
+                Ok(Some(ClientMessage::Query(sql))) => {
+                    received += 1;
+                    if queries.send((received, sql)).await.is_err() {
+                        break;
+                    }
+                }
+                Ok(Some(ClientMessage::Cancel)) => reader_state.cancel_through(received),
+                Ok(Some(ClientMessage::Terminate)) | Ok(None) => break,
+                Err(e) => {
+                    warn!("Failed to read client message: {}", e);
+                    break;
+                }
+            }
+        }
+        reader_state.closed.store(true, Ordering::Release);
+        reader_state.cancel_through(u64::MAX);
+    });
+
+    let outcome = async {
+        while let Some((query, sql)) = pending.recv().await {
+            if state.closed.load(Ordering::Acquire) {
+                break;
+            }
+            run_query(service.as_ref(), query, &sql, &mut writer, &state).await?;
+        }
+        Ok::<(), Error>(())
+    }
+    .await;
+
+    reader_task.abort();
+    let _ = writer.shutdown().await;
+    outcome
+}
+
+/// 执行第 `query` 个查询并把结果写给客户端；只有写客户端失败时返回错误
+async fn run_query<W: AsyncWrite + Unpin>(
+    service: &dyn QueryService,
+    query: u64,
+    sql: &str,
+    writer: &mut W,
+    state: &SessionState,
+) -> Result<()> {
+    debug!("Session query {}: {}", query, sql);
+    let cancel = state.begin(query);
+    let sent = match service.execute_stream(sql).await {
+        Ok(stream) => send_stream(&mut stream.with_cancel_handle(cancel), writer).await,
+        Err(e) => send(writer, ServerMessage::Error(e.to_string())).await,
+    };
+    state.finish();
+    sent
+}
+
+async fn send_stream<W: AsyncWrite + Unpin>(stream: &mut ResultStream, writer: &mut W) -> Result<()> {
+    let mut frames = Vec::new();
+    if !stream.columns().is_empty() {
+        ServerMessage::RowDescription(stream.columns().to_vec()).encode(&mut frames);
+    }
+    loop {
+        match stream.next_rows().await {
+            Ok(Some(rows)) => {
+                for row in rows {
+                    ServerMessage::DataRow(row).encode(&mut frames);
+                }
+                write_frames(writer, &frames).await?;
+                frames.clear();
+            }
+            Ok(None) => {
+                let rows = if stream.columns().is_empty() { stream.affected_rows() } else { stream.rows_returned() };
+                ServerMessage::CommandComplete(rows).encode(&mut frames);
+                break;
+            }
+            Err(e) => {
+                ServerMessage::Error(e.to_string()).encode(&mut frames);
+                break;
+            }
+        }
+    }
+    write_frames(writer, &frames).await
+}
+
+async fn send<W: AsyncWrite + Unpin>(writer: &mut W, message: ServerMessage) -> Result<()> {
+    let mut frames = Vec::new();
+    message.encode(&mut frames);
+    write_frames(writer, &frames).await
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::protocol::read_server_message;
+    use sql::executor::{LimitSource, RowSource};
+    use std::sync::atomic::AtomicUsize;
+    use std::time::Duration;
+
+    /// 每块 100 行的无限结果，记录被拉取的块数
+    struct Numbers {
+        columns: Vec<String>,
+        next: u64,
+        pulls: Arc<AtomicUsize>,
+    }
+
+    #[async_trait]
+    impl RowSource for Numbers {
+        fn columns(&self) -> &[String] {
+            &self.columns
+        }
+
+        async fn next_rows(&mut self) -> Result<Option<Vec<Vec<String>>>> {
+            self.pulls.fetch_add(1, Ordering::Relaxed);
+            let rows = (self.next..self.next + 100).map(|i| vec![i.to_string()]).collect();
+            self.next += 100;
+            tokio::task::yield_now().await;
+            Ok(Some(rows))
+        }
+    }
+
+    /// `SELECT n` 返回前 n 行，`SELECT *` 返回无限结果，`SLOW` 规划 50ms 后返回无限结果
+    #[derive(Default)]
+    struct NumbersService {
+        pulls: Arc<AtomicUsize>,
+    }
+
+    #[async_trait]
+    impl QueryService for NumbersService {
+        async fn execute_stream(&self, sql: &str) -> Result<ResultStream> {
+            let source = Box::new(Numbers { columns: vec!["n".to_string()], next: 0, pulls: self.pulls.clone() });
+            if sql == "SLOW" {
+                tokio::time::sleep(Duration::from_millis(50)).await;
+                return Ok(ResultStream::new(source));
+            }
+            match sql.strip_prefix("SELECT ") {
+                Some("*") => Ok(ResultStream::new(source)),
+                Some(limit) => {
+                    let limit = limit.parse().map_err(|_| Error::SqlParse(sql.to_string()))?;
+                    Ok(ResultStream::new(Box::new(LimitSource::new(source, limit, 0))))
+                }
+                None => Err(Error::SqlParse(sql.to_string())),
+            }
+        }
+    }
+
+    async fn send_client<W: AsyncWrite + Unpin>(writer: &mut W, message: ClientMessage) {
+        let mut frames = Vec::new();
+        message.encode(&mut frames);
+        write_frames(writer, &frames).await.unwrap();
+    }
+
+    async fn read_until_done<R: tokio::io::AsyncRead + Unpin>(reader: &mut R) -> (usize, ServerMessage) {
+        let mut rows = 0;
+        loop {
+            match read_server_message(reader).await.unwrap().unwrap() {
+                ServerMessage::DataRow(_) => rows += 1,
+                ServerMessage::RowDescription(_) => {}
+                done => return (rows, done),
+            }
+        }
+    }
+
+    #[tokio::test]
+    async fn test_session_streams_results_and_reports_errors() {
+        let (client, connection) = tokio::io::duplex(64 * 1024);
+        let service = Arc::new(NumbersService::default());
+        let session = tokio::spawn(serve_connection(service.clone(), connection));
+        let (mut reader, mut writer) = tokio::io::split(client);
+
+        // 查询可以连续发送，按顺序返回
+        send_client(&mut writer, ClientMessage::Query("SELECT 250".to_string())).await;
+        send_client(&mut writer, ClientMessage::Query("DROP".to_string())).await;
+        assert_eq!(read_until_done(&mut reader).await, (250, ServerMessage::CommandComplete(250)));
+        assert!(matches!(read_until_done(&mut reader).await, (0, ServerMessage::Error(_))));
+        // LIMIT 凑满后不再拉取上游
+        assert_eq!(service.pulls.load(Ordering::Relaxed), 3);
+
+        send_client(&mut writer, ClientMessage::Terminate).await;
+        session.await.unwrap().unwrap();
+    }
+
+    #[tokio::test]
+    async fn test_slow_client_applies_backpressure_and_cancel_stops_query() {
+        let (client, connection) = tokio::io::duplex(4 * 1024);
+        let service = Arc::new(NumbersService::default());
+        let session = tokio::spawn(serve_connection(service.clone(), connection));
+        let (mut reader, mut writer) = tokio::io::split(client);
+
+        send_client(&mut writer, ClientMessage::Query("SELECT *".to_string())).await;
+        assert!(matches!(read_server_message(&mut reader).await.unwrap(), Some(ServerMessage::RowDescription(_))));
+
+        // 客户端不读，服务端写满连接缓冲后停止拉取
+        tokio::time::sleep(Duration::from_millis(50)).await;
+        let stalled = service.pulls.load(Ordering::Relaxed);
+        tokio::time::sleep(Duration::from_millis(50)).await;
+        assert_eq!(service.pulls.load(Ordering::Relaxed), stalled);
+        assert!(stalled < 10);
+
+        send_client(&mut writer, ClientMessage::Cancel).await;
+        let (_, done) = read_until_done(&mut reader).await;
+        assert_eq!(done, ServerMessage::Error(Error::Execution("query cancelled".to_string()).to_string()));
+        assert!(service.pulls.load(Ordering::Relaxed) <= stalled + 1);
+
+        // 取消后会话仍可继续使用；断开连接结束会话
+        send_client(&mut writer, ClientMessage::Query("SELECT 5".to_string())).await;
+        assert_eq!(read_until_done(&mut reader).await, (5, ServerMessage::CommandComplete(5)));
+        drop(writer);
+        drop(reader);
+        session.await.unwrap().unwrap();
+    }
+
+    #[tokio::test]
+    async fn test_cancel_is_tagged_to_earlier_queries() {
+        let (client, connection) = tokio::io::duplex(64 * 1024);
+        let service = Arc::new(NumbersService::default());
+        let session = tokio::spawn(serve_connection(service.clone(), connection));
+        let (mut reader, mut writer) = tokio::io::split(client);
+        let cancelled = ServerMessage::Error(Error::Execution("query cancelled".to_string()).to_string());
+
+        // 规划期间到达的取消同样生效
+        send_client(&mut writer, ClientMessage::Query("SLOW".to_string())).await;
+        tokio::time::sleep(Duration::from_millis(10)).await;
+        send_client(&mut writer, ClientMessage::Cancel).await;
+        assert_eq!(read_until_done(&mut reader).await, (0, cancelled));
+        assert_eq!(service.pulls.load(Ordering::Relaxed), 0);
+
+        // 查询结束后才到达的取消不影响下一个查询
+        send_client(&mut writer, ClientMessage::Query("SELECT 5".to_string())).await;
+        assert_eq!(read_until_done(&mut reader).await, (5, ServerMessage::CommandComplete(5)));
+        send_client(&mut writer, ClientMessage::Cancel).await;
+        send_client(&mut writer, ClientMessage::Query("SELECT 3".to_string())).await;
+        assert_eq!(read_until_done(&mut reader).await, (3, ServerMessage::CommandComplete(3)));
+
+        send_client(&mut writer, ClientMessage::Terminate).await;
+        session.await.unwrap().unwrap();
+    }
+}
@@ -0,0 +1,221 @@
+//! 算子与缓存层微基准
+//!
+//! 覆盖 HashJoin / HashAgg / Sort / ExternalSort 四个列式算子，以及缓冲池取页和
+//! 缓存管理器查找。算子基准直接驱动算子的批处理入口，不经过 SQL 解析与规划。
+//!
+//! 运行：`cargo bench -p sql --bench operators`，基线的保存与比较见顶层 Makefile。
+
+mod support;
+
+use std::sync::Arc;
+use std::time::{Duration, Instant};
+
+use criterion::{black_box, criterion_group, criterion_main, BatchSize, BenchmarkId, Criterion, Throughput};
+use sql::executor::execution_models::QueryResult;
+use sql::executor::{ExternalSortOperator, HashAggOperator, HashJoinOperator, MaterializedSource, RowSource, SortOperator};
+use sql::optimizer::{OptimizedPlan, PlanNode};
+use sql::storage::buffer_pool::{BufferPool, PageId};
+use sql::storage::cache_manager::CacheManager;
+use sql::storage::memory::MemoryManager;
+
+use support::{dimension_batch, fact_batch, runtime, Lcg, ROW_COUNTS};
+
+fn scan(table: &str) -> PlanNode {
+    PlanNode::TableScan { table: table.to_string(), columns: vec![] }
+}
+
+fn bench_hash_join(c: &mut Criterion) {
+    let rt = runtime();
+    let mut group = c.benchmark_group("hash_join");
+    for rows in ROW_COUNTS {
+        // 构建侧为维度表 (行数为探测侧的十分之一)，探测侧为事实表
+        let build = dimension_batch(rows / 10);
+        let probe = fact_batch(rows, 100, 7);
+        let mut op = HashJoinOperator::new(
+            scan("dim"),
+            scan("fact"),
+            "inner".to_string(),
+            "dim.id = fact.id".to_string(),
+            Arc::new(MemoryManager::new()),
+            Arc::new(BufferPool::new()),
+        );
+        op.set_join_keys(vec!["id".to_string()]);
+        op.set_hash_table_size(rows);
+
+        group.throughput(Throughput::Elements(rows as u64));
+        group.bench_with_input(BenchmarkId::new("inner", rows), &rows, |b, _| {
+            b.to_async(&rt).iter(|| async { black_box(op.perform_hash_join(&build, &probe).await.unwrap()) })
+        });
+    }
+    group.finish();
+}
+
+fn bench_hash_agg(c: &mut Criterion) {
+    let rt = runtime();
+    let mut group = c.benchmark_group("hash_agg");
+    for rows in ROW_COUNTS {
+        // 低基数分组走部分聚合，高基数分组触发直通
+        for groups in [16, rows / 2] {
+            let input = fact_batch(rows, groups, 11);
+            let mut op = HashAggOperator::new(
+                scan("fact"),
+                vec!["name".to_string()],
+                vec!["count(*)".to_string(), "sum(value)".to_string(), "avg(value)".to_string()],
+                Arc::new(MemoryManager::new()),
+                Arc::new(BufferPool::new()),
+            );
+            op.set_group_keys(vec!["name".to_string()]);
+
+            group.throughput(Throughput::Elements(rows as u64));
+            group.bench_with_input(BenchmarkId::new(format!("groups_{}", groups), rows), &rows, |b, _| {
+                b.to_async(&rt).iter(|| async { black_box(op.perform_hash_aggregation(&input).await.unwrap()) })
+            });
+        }
+    }
+    group.finish();
+}
+
+fn bench_sort(c: &mut Criterion) {
+    let rt = runtime();
+    let mut group = c.benchmark_group("sort");
+    for rows in ROW_COUNTS {
+        let input = fact_batch(rows, 100, 13);
+        group.throughput(Throughput::Elements(rows as u64));
+
+        let op = SortOperator::new(scan("fact"), vec!["value".to_string(), "id".to_string()], Arc::new(MemoryManager::new()));
+        group.bench_with_input(BenchmarkId::new("in_memory", rows), &rows, |b, _| {
+            b.to_async(&rt).iter(|| async { black_box(op.perform_sort(&input).await.unwrap()) })
+        });
+
+        // 段缓冲足够大时只有一个段，压到 256KB 时强制落盘并多路归并
+        for (label, max_memory) in [("external_fit", 256 * 1024 * 1024), ("external_spill", 256 * 1024)] {
+            let mut op = ExternalSortOperator::new(
+                scan("fact"),
+                vec!["value DESC".to_string(), "id".to_string()],
+                Arc::new(MemoryManager::new()),
+                Arc::new(BufferPool::new()),
+            );
+            op.set_max_memory(max_memory);
+            group.bench_with_input(BenchmarkId::new(label, rows), &rows, |b, _| {
+                b.to_async(&rt).iter_batched(
+                    || Box::new(MaterializedSource::new(input.clone().into_query_result(), 4096)),
+                    |source| async {
+                        let mut sorted = op.sort_stream(source).unwrap();
+                        let mut rows = 0;
+                        while let Some(chunk) = sorted.next_rows().await.unwrap() {
+                            rows += chunk.len();
+                        }
+                        black_box(rows)
+                    },
+                    BatchSize::LargeInput,
+                )
+            });
+        }
+    }
+    group.finish();
+}
+
+fn bench_buffer_pool(c: &mut Criterion) {
+    let mut group = c.benchmark_group("buffer_pool");
+    const PAGE_SIZE: usize = 8 * 1024;
+    const LOOKUPS: usize = 1024;
+    group.throughput(Throughput::Elements(LOOKUPS as u64));
+
+    // 命中路径：工作集完全驻留
+    let pool = BufferPool::with_size(4096 * PAGE_SIZE, PAGE_SIZE);
+    for page in 0..2048 {
+        drop(pool.get_buffer(PageId(page)).unwrap());
+    }
+    let mut rng = Lcg::new(17);
+    let hot_pages: Vec<PageId> = (0..LOOKUPS).map(|_| PageId(rng.below(2048) as usize)).collect();
+    group.bench_function("get_buffer/hit", |b| {
+        b.iter(|| {
+            for &page in &hot_pages {
+                black_box(pool.get_buffer(page).unwrap().page_id());
+            }
+        })
+    });
+
+    // 淘汰路径：工作集是帧数的 16 倍，几乎每次都走 CLOCK 扫描
+    let small_pool = BufferPool::with_size(256 * PAGE_SIZE, PAGE_SIZE);
+    let cold_pages: Vec<PageId> = (0..LOOKUPS).map(|_| PageId(rng.below(4096) as usize)).collect();
+    group.bench_function("get_buffer/evict", |b| {
+        b.iter(|| {
+            for &page in &cold_pages {
+                black_box(small_pool.get_buffer(page).unwrap().page_id());
+            }
+        })
+    });
+
+    // 多线程命中：衡量分片页表与原子 pin 计数下的可扩展性
+    for threads in [2, 8] {
+        group.throughput(Throughput::Elements((LOOKUPS * threads) as u64));
+        group.bench_with_input(BenchmarkId::new("get_buffer/concurrent_hit", threads), &threads, |b, &threads| {
+            b.iter_custom(|iters| {
+                let started = Instant::now();
+                std::thread::scope(|scope| {
+                    for _ in 0..threads {
+                        scope.spawn(|| {
+                            for _ in 0..iters {
+                                for &page in &hot_pages {
+                                    black_box(pool.get_buffer(page).unwrap().page_id());
+                                }
+                            }
+                        });
+                    }
+                });
+                started.elapsed()
+            })
+        });
+    }
+    group.finish();
+}
+
+fn bench_cache_manager(c: &mut Criterion) {
+    let mut group = c.benchmark_group("cache_manager");
+    const KEYS: usize = 1024;
+    let cache = CacheManager::new();
+    let keys: Vec<String> = (0..KEYS).map(|i| format!("SELECT * FROM t WHERE id = {}", i)).collect();
+    for key in &keys {
+        let plan = OptimizedPlan { nodes: vec![scan("t")], estimated_cost: 1.0, estimated_rows: 1 };
+        cache.cache_plan(key, plan).unwrap();
+
+        let mut result = QueryResult::new();
+        result.columns = vec!["id".to_string(), "name".to_string()];
+        result.rows = (0..16).map(|i| vec![i.to_string(), format!("name_{}", i)]).collect();
+        cache.cache_result_for_tables(key, result, &["t".to_string()]).unwrap();
+    }
+    let misses: Vec<String> = (0..KEYS).map(|i| format!("SELECT * FROM u WHERE id = {}", i)).collect();
+
+    group.throughput(Throughput::Elements(KEYS as u64));
+    group.bench_function("plan/hit", |b| {
+        b.iter(|| {
+            for key in &keys {
+                black_box(cache.get_cached_plan(key));
+            }
+        })
+    });
+    group.bench_function("plan/miss", |b| {
+        b.iter(|| {
+            for key in &misses {
+                black_box(cache.get_cached_plan(key));
+            }
+        })
+    });
+    group.bench_function("result/hit", |b| {
+        b.iter(|| {
+            for key in &keys {
+                black_box(cache.get_cached_result(key));
+            }
+        })
+    });
+    group.finish();
+}
+
+criterion_group! {
+    name = operators;
+    config = Criterion::default().measurement_time(Duration::from_secs(5));
+    targets = bench_hash_join, bench_hash_agg, bench_sort
+}
+criterion_group!(caches, bench_buffer_pool, bench_cache_manager);
+criterion_main!(operators, caches);
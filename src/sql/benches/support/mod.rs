@@ -0,0 +1,69 @@
+//! 基准测试共用的数据生成
+//!
+//! 数据由固定种子的线性同余序列生成，同一规模下每次运行的输入完全一致，
+//! 保存的基线之间才有可比性。
+
+#![allow(dead_code)]
+
+use common::DataType;
+use sql::executor::{ColumnVector, Field, RecordBatch, Schema};
+
+/// 微基准的输入规模 (行数)
+pub const ROW_COUNTS: [usize; 3] = [1_000, 10_000, 100_000];
+
+/// 确定性的伪随机序列 (PCG 常数的 LCG)
+pub struct Lcg(u64);
+
+impl Lcg {
+    pub fn new(seed: u64) -> Self {
+        Self(seed)
+    }
+
+    pub fn next_u64(&mut self) -> u64 {
+        self.0 = self.0.wrapping_mul(6_364_136_223_846_793_005).wrapping_add(1_442_695_040_888_963_407);
+        self.0 >> 33
+    }
+
+    pub fn below(&mut self, bound: u64) -> u64 {
+        self.next_u64() % bound.max(1)
+    }
+}
+
+/// `(id, name, value)` 三列的输入批，`name` 有 `groups` 个不同取值
+pub fn fact_batch(rows: usize, groups: usize, seed: u64) -> RecordBatch {
+    let mut rng = Lcg::new(seed);
+    let ids = (0..rows).map(|_| rng.below(rows as u64) as i64).collect();
+    let names: Vec<String> = (0..rows).map(|_| format!("group_{}", rng.below(groups as u64))).collect();
+    let values = (0..rows).map(|_| rng.below(10_000) as i64).collect();
+    RecordBatch::try_new(
+        Schema::new(vec![
+            Field::new("id", DataType::BigInt),
+            Field::new("name", DataType::String),
+            Field::new("value", DataType::BigInt),
+        ]),
+        vec![ColumnVector::from_i64(ids), ColumnVector::from_strings(names), ColumnVector::from_i64(values)],
+    )
+    .expect("fact batch")
+}
+
+/// `(id, dept, salary)` 三列的维度批，`id` 为 `0..rows` 的主键
+pub fn dimension_batch(rows: usize) -> RecordBatch {
+    RecordBatch::try_new(
+        Schema::new(vec![
+            Field::new("id", DataType::BigInt),
+            Field::new("dept", DataType::String),
+            Field::new("salary", DataType::BigInt),
+        ]),
+        vec![
+            ColumnVector::from_i64((0..rows as i64).collect()),
+            ColumnVector::from_strings((0..rows).map(|i| format!("dept_{}", i % 16)).collect()),
+            ColumnVector::from_i64((0..rows as i64).map(|i| 3_000 + i % 7_000).collect()),
+        ],
+    )
+    .expect("dimension batch")
+}
+
+/// 基准使用的多线程运行时
+pub fn runtime() -> tokio::runtime::Runtime {
+    tokio::runtime::Builder::new_multi_thread().enable_all().build().expect("tokio runtime")
+}
@@ -0,0 +1,474 @@
+//! 端到端负载基准
+//!
+//! 查询以计划树的形式直接构造，交给 `Executor::execute` 对已装载数据的存储执行：
+//! 当前的 SQL 解析器只会为任意 SELECT 生成同一个 `TableScan`，经 `execute_query`
+//! 执行的不同语句其实跑的是同一个计划，无法区分负载。
+//! - `tpch`：SF 0.01 规模的 lineitem / orders / customer 表上的 Q1、Q3、Q6、Q10
+//! - `sysbench`：10000 行 sbtest1 表上 oltp_* 风格的点查、范围查询与写入，参数随迭代变化
+//!
+//! 执行器对存储只能执行以表扫描为叶子的过滤、投影、LIMIT 与聚合 (下推到存储端)，
+//! 连接、聚合之上的排序和 DISTINCT 后的排序由基准在取回的批上调用对应的列式算子完成；
+//! 聚合参数只能是列，Q3 / Q6 / Q10 的收入以 `l_extendedprice` 代替
+//! `l_extendedprice * (1 - l_discount)`，Q1 的结果不再按分组键排序。
+//!
+//! 运行：`cargo bench -p sql --bench workloads`，基线的保存与比较见顶层 Makefile，
+//! 提交在 `benches/baselines/` 下的结果是参考机器上的一次运行。
+
+mod support;
+
+use std::sync::Arc;
+use std::time::Duration;
+
+use common::DataType;
+use criterion::{black_box, criterion_group, criterion_main, BatchSize, BenchmarkId, Criterion, Throughput};
+use sql::executor::{HashAggOperator, HashJoinOperator, RecordBatch, SortOperator, StorageExecutor, TopNOperator};
+use sql::optimizer::{OptimizedPlan, PlanNode};
+use sql::parser::{ParsedExpression, ParsedOperator, ParsedValue};
+use sql::storage::buffer_pool::BufferPool;
+use sql::storage::memory::MemoryManager;
+use sql::storage::table_catalog::{TableCatalog, TableColumn};
+use sql::Executor;
+use storage::codec::Datum;
+use tokio::runtime::Runtime;
+
+use support::{runtime, Lcg};
+
+fn column(name: &str) -> ParsedExpression {
+    ParsedExpression::Column(name.to_string())
+}
+
+fn number(value: impl ToString) -> ParsedExpression {
+    ParsedExpression::Literal(ParsedValue::Number(value.to_string()))
+}
+
+fn string(value: &str) -> ParsedExpression {
+    ParsedExpression::Literal(ParsedValue::String(value.to_string()))
+}
+
+fn compare(name: &str, operator: ParsedOperator, value: ParsedExpression) -> ParsedExpression {
+    ParsedExpression::BinaryOp { left: Box::new(column(name)), operator, right: Box::new(value) }
+}
+
+/// 多个条件的合取
+fn all(predicates: Vec<ParsedExpression>) -> ParsedExpression {
+    predicates
+        .into_iter()
+        .reduce(|left, right| ParsedExpression::BinaryOp {
+            left: Box::new(left),
+            operator: ParsedOperator::And,
+            right: Box::new(right),
+        })
+        .expect("at least one predicate")
+}
+
+/// `name BETWEEN low AND high`
+fn between(name: &str, low: ParsedExpression, high: ParsedExpression) -> ParsedExpression {
+    all(vec![compare(name, ParsedOperator::GreaterThanOrEqual, low), compare(name, ParsedOperator::LessThanOrEqual, high)])
+}
+
+fn strings(names: &[&str]) -> Vec<String> {
+    names.iter().map(|name| name.to_string()).collect()
+}
+
+fn scan(table: &str, columns: &[&str]) -> PlanNode {
+    PlanNode::TableScan { table: table.to_string(), columns: strings(columns) }
+}
+
+fn filter(input: PlanNode, predicate: ParsedExpression) -> PlanNode {
+    PlanNode::Filter { input: Box::new(input), predicate }
+}
+
+fn project(input: PlanNode, columns: &[&str]) -> PlanNode {
+    PlanNode::Project { input: Box::new(input), columns: strings(columns) }
+}
+
+fn aggregate(input: PlanNode, group_by: &[&str], aggregates: &[&str]) -> PlanNode {
+    PlanNode::Aggregate { input: Box::new(input), group_by: strings(group_by), aggregates: strings(aggregates) }
+}
+
+fn plan(node: PlanNode) -> OptimizedPlan {
+    OptimizedPlan { nodes: vec![node], estimated_cost: 1.0, estimated_rows: 1 }
+}
+
+/// 装载了基准数据的执行器
+struct Workload {
+    executor: Executor,
+    storage: Arc<StorageExecutor>,
+    catalog: Arc<TableCatalog>,
+    memory_manager: Arc<MemoryManager>,
+}
+
+impl Workload {
+    fn new() -> Self {
+        let catalog = Arc::new(TableCatalog::new());
+        let mut storage = StorageExecutor::new();
+        storage.set_table_catalog(catalog.clone());
+        let storage = Arc::new(storage);
+        let executor = Executor::new();
+        executor.set_storage_executor(storage.clone());
+        Self { executor, storage, catalog, memory_manager: Arc::new(MemoryManager::new()) }
+    }
+
+    fn register(&self, table: &str, columns: &[(&str, DataType)]) {
+        let columns = columns
+            .iter()
+            .enumerate()
+            .map(|(i, (name, data_type))| TableColumn::new(*name, i as u32 + 1, data_type.clone()))
+            .collect();
+        self.catalog.register(table, columns);
+    }
+
+    /// 按列定义顺序写入一行，列 ID 从 1 开始
+    async fn insert(&self, table: &str, primary_key: &[Datum], values: Vec<Datum>) {
+        let columns: Vec<(u32, Datum)> = values.into_iter().enumerate().map(|(i, v)| (i as u32 + 1, v)).collect();
+        self.storage.storage_handler().insert_record(table, primary_key, &columns, None).await.unwrap();
+    }
+
+    async fn rows(&self, node: PlanNode) -> Vec<Vec<String>> {
+        self.executor.execute(plan(node)).await.unwrap().rows
+    }
+
+    /// 执行以 `table` 为叶子的计划，按表定义中的列类型取回为批
+    async fn batch(&self, table: &str, columns: &[&str], node: PlanNode) -> RecordBatch {
+        let schema = self.catalog.schema(table, &strings(columns)).expect("registered columns");
+        RecordBatch::from_rows(schema, &self.rows(node).await).unwrap()
+    }
+
+    async fn hash_join(&self, build: &RecordBatch, probe: &RecordBatch, key: &str) -> RecordBatch {
+        let mut op = HashJoinOperator::new(
+            scan("build", &[]),
+            scan("probe", &[]),
+            "inner".to_string(),
+            format!("{} = {}", key, key),
+            self.memory_manager.clone(),
+            Arc::new(BufferPool::new()),
+        );
+        op.set_join_keys(vec![key.to_string()]);
+        op.set_hash_table_size(build.num_rows());
+        op.perform_hash_join(build, probe).await.unwrap()
+    }
+
+    async fn hash_agg(&self, input: &RecordBatch, group_by: &[&str], aggregates: &[&str]) -> RecordBatch {
+        let mut op = HashAggOperator::new(
+            scan("input", &[]),
+            strings(group_by),
+            strings(aggregates),
+            self.memory_manager.clone(),
+            Arc::new(BufferPool::new()),
+        );
+        op.set_group_keys(strings(group_by));
+        op.perform_hash_aggregation(input).await.unwrap()
+    }
+
+    fn top_n(&self, input: &RecordBatch, order_by: &[&str], limit: usize) -> RecordBatch {
+        TopNOperator::new(scan("input", &[]), strings(order_by), limit, self.memory_manager.clone(), Arc::new(BufferPool::new()))
+            .top_n(input)
+            .unwrap()
+    }
+
+    async fn sort(&self, input: &RecordBatch, order_by: &[&str]) -> RecordBatch {
+        SortOperator::new(scan("input", &[]), strings(order_by), self.memory_manager.clone())
+            .perform_sort(input)
+            .await
+            .unwrap()
+    }
+}
+
+/// TPC-H SF 0.01 的表规模
+const CUSTOMERS: u64 = 1_500;
+const ORDERS: u64 = 15_000;
+const LINES_PER_ORDER: u64 = 4;
+
+const SEGMENTS: [&str; 5] = ["AUTOMOBILE", "BUILDING", "FURNITURE", "HOUSEHOLD", "MACHINERY"];
+
+/// 1992-01-01 之后 `days` 天附近的日期 (每月按 28 天计，只需保持字典序与时间序一致)
+fn date(days: u64) -> String {
+    let months = days / 28;
+    format!("{:04}-{:02}-{:02}", 1992 + months / 12, months % 12 + 1, days % 28 + 1)
+}
+
+fn text(value: impl AsRef<str>) -> Datum {
+    Datum::Bytes(value.as_ref().as_bytes().to_vec())
+}
+
+/// 生成 TPC-H 表；连接键在两侧同名 (`custkey`、`orderkey`)，哈希连接按同名列匹配
+fn load_tpch(rt: &Runtime) -> Workload {
+    let workload = Workload::new();
+    workload.register("customer", &[("custkey", DataType::BigInt), ("c_name", DataType::String), ("c_mktsegment", DataType::String)]);
+    workload.register("orders", &[
+        ("orderkey", DataType::BigInt),
+        ("custkey", DataType::BigInt),
+        ("o_orderdate", DataType::String),
+        ("o_shippriority", DataType::BigInt),
+    ]);
+    workload.register("lineitem", &[
+        ("orderkey", DataType::BigInt),
+        ("l_quantity", DataType::BigInt),
+        ("l_extendedprice", DataType::Double),
+        ("l_discount", DataType::Double),
+        ("l_returnflag", DataType::String),
+        ("l_linestatus", DataType::String),
+        ("l_shipdate", DataType::String),
+    ]);
+
+    rt.block_on(async {
+        let mut rng = Lcg::new(41);
+        for custkey in 1..=CUSTOMERS as i64 {
+            let segment = SEGMENTS[rng.below(SEGMENTS.len() as u64) as usize];
+            let row = vec![Datum::Int(custkey), text(format!("Customer#{:09}", custkey)), text(segment)];
+            workload.insert("customer", &[Datum::Int(custkey)], row).await;
+        }
+        for orderkey in 1..=ORDERS as i64 {
+            let order_day = rng.below(2_400);
+            let custkey = rng.below(CUSTOMERS) as i64 + 1;
+            let row = vec![Datum::Int(orderkey), Datum::Int(custkey), text(date(order_day)), Datum::Int(0)];
+            workload.insert("orders", &[Datum::Int(orderkey)], row).await;
+            for line in 0..LINES_PER_ORDER as i64 {
+                let quantity = rng.below(50) as i64 + 1;
+                let ship_day = order_day + rng.below(120) + 1;
+                let row = vec![
+                    Datum::Int(orderkey),
+                    Datum::Int(quantity),
+                    Datum::Float(quantity as f64 * (900.0 + rng.below(1_000) as f64)),
+                    Datum::Float(rng.below(11) as f64 / 100.0),
+                    text(["A", "N", "R"][rng.below(3) as usize]),
+                    text(if ship_day > 2_200 { "O" } else { "F" }),
+                    text(date(ship_day)),
+                ];
+                workload.insert("lineitem", &[Datum::Int(orderkey), Datum::Int(line)], row).await;
+            }
+        }
+    });
+    workload
+}
+
+/// Q1：按退货标记与行状态汇总，整段聚合下推到存储端
+async fn q1_pricing_summary(workload: &Workload) -> usize {
+    let lineitem = scan("lineitem", &["l_returnflag", "l_linestatus", "l_quantity", "l_extendedprice", "l_discount", "l_shipdate"]);
+    let node = aggregate(
+        filter(lineitem, compare("l_shipdate", ParsedOperator::LessThanOrEqual, string("1998-09-02"))),
+        &["l_returnflag", "l_linestatus"],
+        &["sum(l_quantity)", "sum(l_extendedprice)", "avg(l_discount)", "count(*)"],
+    );
+    workload.rows(node).await.len()
+}
+
+/// Q3：BUILDING 客户的未发货订单，三表下推过滤后哈希连接、聚合并取收入前 10
+async fn q3_shipping_priority(workload: &Workload) -> usize {
+    let customer_columns = ["custkey"];
+    let customer = project(
+        filter(scan("customer", &["custkey", "c_mktsegment"]), compare("c_mktsegment", ParsedOperator::Equal, string("BUILDING"))),
+        &customer_columns,
+    );
+    let order_columns = ["orderkey", "custkey", "o_orderdate", "o_shippriority"];
+    let orders = filter(scan("orders", &order_columns), compare("o_orderdate", ParsedOperator::LessThan, string("1995-03-15")));
+    let line_columns = ["orderkey", "l_extendedprice"];
+    let lineitem = project(
+        filter(scan("lineitem", &["orderkey", "l_extendedprice", "l_shipdate"]), compare("l_shipdate", ParsedOperator::GreaterThan, string("1995-03-15"))),
+        &line_columns,
+    );
+
+    let customer = workload.batch("customer", &customer_columns, customer).await;
+    let orders = workload.batch("orders", &order_columns, orders).await;
+    let lineitem = workload.batch("lineitem", &line_columns, lineitem).await;
+    let customer_orders = workload.hash_join(&customer, &orders, "custkey").await;
+    let joined = workload.hash_join(&customer_orders, &lineitem, "orderkey").await;
+    let revenue = workload
+        .hash_agg(&joined, &["orderkey", "o_orderdate", "o_shippriority"], &["sum(l_extendedprice)"])
+        .await;
+    workload.top_n(&revenue, &["sum(l_extendedprice) DESC", "o_orderdate"], 10).num_rows()
+}
+
+/// Q6：单表多条件过滤后的收入合计，整段下推
+async fn q6_forecast_revenue(workload: &Workload) -> usize {
+    let predicate = all(vec![
+        compare("l_shipdate", ParsedOperator::GreaterThanOrEqual, string("1994-01-01")),
+        compare("l_shipdate", ParsedOperator::LessThan, string("1995-01-01")),
+        between("l_discount", number("0.05"), number("0.07")),
+        compare("l_quantity", ParsedOperator::LessThan, number(24)),
+    ]);
+    let lineitem = scan("lineitem", &["l_extendedprice", "l_discount", "l_quantity", "l_shipdate"]);
+    workload.rows(aggregate(filter(lineitem, predicate), &[], &["sum(l_extendedprice)"])).await.len()
+}
+
+/// Q10：退货明细按客户汇总，取收入前 20
+async fn q10_returned_items(workload: &Workload) -> usize {
+    let customer_columns = ["custkey", "c_name"];
+    let order_columns = ["orderkey", "custkey"];
+    let line_columns = ["orderkey", "l_extendedprice"];
+    let lineitem = project(
+        filter(scan("lineitem", &["orderkey", "l_extendedprice", "l_returnflag"]), compare("l_returnflag", ParsedOperator::Equal, string("R"))),
+        &line_columns,
+    );
+
+    let customer = workload.batch("customer", &customer_columns, scan("customer", &customer_columns)).await;
+    let orders = workload.batch("orders", &order_columns, scan("orders", &order_columns)).await;
+    let lineitem = workload.batch("lineitem", &line_columns, lineitem).await;
+    let customer_orders = workload.hash_join(&customer, &orders, "custkey").await;
+    let joined = workload.hash_join(&customer_orders, &lineitem, "orderkey").await;
+    let revenue = workload.hash_agg(&joined, &["custkey", "c_name"], &["sum(l_extendedprice)"]).await;
+    workload.top_n(&revenue, &["sum(l_extendedprice) DESC"], 20).num_rows()
+}
+
+fn bench_tpch(c: &mut Criterion) {
+    let rt = runtime();
+    let workload = load_tpch(&rt);
+    // 每个查询都应有结果，否则基准测到的只是空扫描
+    rt.block_on(async {
+        assert!(q1_pricing_summary(&workload).await > 1);
+        assert_eq!(q3_shipping_priority(&workload).await, 10);
+        assert_eq!(q6_forecast_revenue(&workload).await, 1);
+        assert_eq!(q10_returned_items(&workload).await, 20);
+    });
+
+    let mut group = c.benchmark_group("tpch");
+    group.bench_function("q1_pricing_summary", |b| b.to_async(&rt).iter(|| async { black_box(q1_pricing_summary(&workload).await) }));
+    group.bench_function("q3_shipping_priority", |b| b.to_async(&rt).iter(|| async { black_box(q3_shipping_priority(&workload).await) }));
+    group.bench_function("q6_forecast_revenue", |b| b.to_async(&rt).iter(|| async { black_box(q6_forecast_revenue(&workload).await) }));
+    group.bench_function("q10_returned_items", |b| b.to_async(&rt).iter(|| async { black_box(q10_returned_items(&workload).await) }));
+    group.finish();
+}
+
+/// sysbench 表的行数，参数在 `1..=TABLE_SIZE` 内取值
+const TABLE_SIZE: u64 = 10_000;
+/// 范围查询的跨度 (sysbench 默认 range_size)
+const RANGE_SIZE: u64 = 100;
+
+const SBTEST_COLUMNS: [&str; 4] = ["id", "k", "c", "pad"];
+
+fn load_sysbench(rt: &Runtime) -> Workload {
+    let workload = Workload::new();
+    workload.register("sbtest1", &[
+        ("id", DataType::BigInt),
+        ("k", DataType::BigInt),
+        ("c", DataType::String),
+        ("pad", DataType::String),
+    ]);
+    rt.block_on(async {
+        let mut rng = Lcg::new(19);
+        for id in 1..=TABLE_SIZE as i64 {
+            let k = rng.below(TABLE_SIZE) as i64 + 1;
+            workload.insert("sbtest1", &[Datum::Int(id)], sbtest_row(id, k, rng.below(TABLE_SIZE))).await;
+        }
+    });
+    workload
+}
+
+fn sbtest_row(id: i64, k: i64, c: u64) -> Vec<Datum> {
+    vec![Datum::Int(id), Datum::Int(k), text(format!("c-{:011}", c)), text("pad")]
+}
+
+fn id_range(id: u64) -> ParsedExpression {
+    between("id", number(id), number(id + RANGE_SIZE - 1))
+}
+
+/// 按 sysbench 的语句模板执行一条语句，返回读出或写入的行数
+async fn sysbench_statement(workload: &Workload, kind: &str, id: u64) -> usize {
+    let sbtest = || scan("sbtest1", &SBTEST_COLUMNS);
+    match kind {
+        // SELECT c FROM sbtest1 WHERE id = ?
+        "point_select" => {
+            let node = project(filter(sbtest(), compare("id", ParsedOperator::Equal, number(id))), &["c"]);
+            workload.rows(node).await.len()
+        }
+        // SELECT c FROM sbtest1 WHERE id BETWEEN ? AND ?
+        "simple_range" => workload.rows(project(filter(sbtest(), id_range(id)), &["c"])).await.len(),
+        // SELECT SUM(k) FROM sbtest1 WHERE id BETWEEN ? AND ?
+        "sum_range" => workload.rows(aggregate(filter(sbtest(), id_range(id)), &[], &["sum(k)"])).await.len(),
+        // SELECT c FROM sbtest1 WHERE id BETWEEN ? AND ? ORDER BY c
+        "order_range" => {
+            let rows = workload.batch("sbtest1", &["c"], project(filter(sbtest(), id_range(id)), &["c"])).await;
+            workload.sort(&rows, &["c"]).await.num_rows()
+        }
+        // SELECT DISTINCT c FROM sbtest1 WHERE id BETWEEN ? AND ? ORDER BY c
+        "distinct_range" => {
+            let rows = workload.batch("sbtest1", &["c"], aggregate(filter(sbtest(), id_range(id)), &["c"], &[])).await;
+            workload.sort(&rows, &["c"]).await.num_rows()
+        }
+        // UPDATE sbtest1 SET k = k + 1 WHERE id = ?：读出旧行再整行写回
+        "update_index" => {
+            let node = filter(sbtest(), compare("id", ParsedOperator::Equal, number(id)));
+            let rows = workload.rows(node).await;
+            for row in &rows {
+                let k: i64 = row[1].parse().unwrap();
+                let c: u64 = row[2].trim_start_matches("c-").parse().unwrap();
+                workload.insert("sbtest1", &[Datum::Int(id as i64)], sbtest_row(id as i64, k + 1, c)).await;
+            }
+            rows.len()
+        }
+        // INSERT INTO sbtest1 (id, k, c, pad) VALUES (?, ?, ?, ?)
+        "insert" => {
+            let new_id = (TABLE_SIZE + id) as i64;
+            workload.insert("sbtest1", &[Datum::Int(new_id)], sbtest_row(new_id, id as i64, id)).await;
+            1
+        }
+        other => unreachable!("unknown sysbench statement: {}", other),
+    }
+}
+
+fn bench_sysbench(c: &mut Criterion) {
+    let rt = runtime();
+    let workload = load_sysbench(&rt);
+    rt.block_on(async {
+        assert_eq!(sysbench_statement(&workload, "point_select", 7).await, 1);
+        assert_eq!(sysbench_statement(&workload, "simple_range", 7).await, RANGE_SIZE as usize);
+    });
+
+    let mut group = c.benchmark_group("sysbench");
+    group.throughput(Throughput::Elements(1));
+    for kind in ["point_select", "simple_range", "sum_range", "order_range", "distinct_range", "update_index", "insert"] {
+        let mut rng = Lcg::new(23);
+        group.bench_function(BenchmarkId::new("oltp", kind), |b| {
+            b.to_async(&rt).iter_batched(
+                || rng.below(TABLE_SIZE - RANGE_SIZE) + 1,
+                |id| {
+                    let workload = &workload;
+                    async move { black_box(sysbench_statement(workload, kind, id).await) }
+                },
+                BatchSize::SmallInput,
+            )
+        });
+    }
+
+    // oltp_read_write 的一个事务：10 条点查、4 类范围查询、1 条索引更新、1 条插入
+    const READ_WRITE_MIX: [(&str, usize); 7] = [
+        ("point_select", 10),
+        ("simple_range", 1),
+        ("sum_range", 1),
+        ("order_range", 1),
+        ("distinct_range", 1),
+        ("update_index", 1),
+        ("insert", 1),
+    ];
+    let statements_per_txn: usize = READ_WRITE_MIX.iter().map(|(_, count)| count).sum();
+    let mut rng = Lcg::new(29);
+    group.throughput(Throughput::Elements(statements_per_txn as u64));
+    group.bench_function("oltp_read_write", |b| {
+        b.to_async(&rt).iter_batched(
+            || {
+                READ_WRITE_MIX
+                    .iter()
+                    .flat_map(|&(kind, count)| std::iter::repeat(kind).take(count))
+                    .map(|kind| (kind, rng.below(TABLE_SIZE - RANGE_SIZE) + 1))
+                    .collect::<Vec<_>>()
+            },
+            |statements| {
+                let workload = &workload;
+                async move {
+                    for (kind, id) in statements {
+                        black_box(sysbench_statement(workload, kind, id).await);
+                    }
+                }
+            },
+            BatchSize::SmallInput,
+        )
+    });
+    group.finish();
+}
+
+criterion_group! {
+    name = workloads;
+    config = Criterion::default().measurement_time(Duration::from_secs(10));
+    targets = bench_tpch, bench_sysbench
+}
+criterion_main!(workloads);
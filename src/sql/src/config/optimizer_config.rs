@@ -123,6 +123,9 @@ pub struct CboConfig {
     /// 最大搜索深度
     pub max_search_depth: usize,
 
+    /// 连接表数超过该值时由动态规划改用贪心算法排序
+    pub join_reorder_dp_threshold: usize,
+
     /// 成本模型配置
     pub cost_model: CostModelConfig,
 }
@@ -137,6 +140,7 @@ impl Default for CboConfig {
             enable_parallelization_optimization: true,
             max_plans_per_group: 100,
             max_search_depth: 10,
+            join_reorder_dp_threshold: 12,
             cost_model: CostModelConfig::default(),
         }
     }
@@ -274,6 +278,10 @@ impl OptimizerConfigManager {
             return Err("max_search_depth must be greater than 0".to_string());
         }
 
+        if self.config.cbo_config.join_reorder_dp_threshold == 0 {
+            return Err("join_reorder_dp_threshold must be greater than 0".to_string());
+        }
+
         if self.config.rbo_config.max_rule_applications == 0 {
             return Err("max_rule_applications must be greater than 0".to_string());
         }
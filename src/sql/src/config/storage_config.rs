@@ -93,6 +93,15 @@ pub struct CacheConfig {
     /// 结果缓存大小
     pub result_cache_size: usize,
 
+    /// 查询计划缓存字节预算
+    pub query_plan_cache_bytes: usize,
+
+    /// 结果缓存字节预算
+    pub result_cache_bytes: usize,
+
+    /// 表统计信息缓存字节预算
+    pub table_stats_cache_bytes: usize,
+
     /// 缓存过期时间（秒）
     pub cache_ttl_seconds: u64,
 
@@ -110,6 +119,9 @@ impl Default for CacheConfig {
             query_plan_cache_size: 1000,
             enable_result_cache: true,
             result_cache_size: 1000,
+            query_plan_cache_bytes: 64 * 1024 * 1024,
+            result_cache_bytes: 256 * 1024 * 1024,
+            table_stats_cache_bytes: 8 * 1024 * 1024,
             cache_ttl_seconds: 3600,
             enable_cache_statistics: true,
             cache_hit_rate_threshold: 0.8,
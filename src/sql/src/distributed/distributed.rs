@@ -1,9 +1,21 @@
 use common::Result;
 use tracing::{debug, info};
 use std::collections::HashMap;
+use parking_lot::RwLock;
 use std::sync::{Arc, Mutex};
 use serde::{Deserialize, Serialize};
 
+use storage::client::RegionMap;
+use storage::common::{Key, StorageContext, StorageOptions, Value};
+use storage::engine::{
+    commit_buffer, CommitMode, CommitPolicy, GroupCommitConfig, GroupCommitStats, GroupCommitter, StorageEngine,
+    StorageTransaction, WriteBuffer,
+};
+
+use crate::executor::exchange::{exchange_batches, ExchangeConfig, ExchangeMode};
+use crate::executor::execution_models::QueryResult;
+use crate::executor::record_batch::RecordBatch;
+
 // ============================================================================
 // 核心数据结构
 // ============================================================================
@@ -318,6 +330,8 @@ pub struct DistributedExecutor {
     transaction_manager: Arc<DistributedTransactionManager>,
     /// 执行统计
     stats: Arc<Mutex<DistributedExecutionStats>>,
+    /// 片段间数据交换配置
+    exchange_config: ExchangeConfig,
 }
 
 impl DistributedExecutor {
@@ -327,7 +341,46 @@ impl DistributedExecutor {
             shard_manager: Arc::new(ShardManager::new()),
             transaction_manager: Arc::new(DistributedTransactionManager::new()),
             stats: Arc::new(Mutex::new(DistributedExecutionStats::new())),
+            exchange_config: ExchangeConfig::default(),
+        }
+    }
+
+    pub fn set_exchange_config(&mut self, config: ExchangeConfig) {
+        self.exchange_config = config;
+    }
+
+    /// 把上游片段的结果按 `key_column` 列哈希重分区为 `partitions` 份
+    ///
+    /// 用于跨节点连接和分组聚合：相同键的行落到同一个下游片段，每个上游片段
+    /// 作为一个发送端，经 Exchange 以列式帧和信用流控传输。
+    pub async fn shuffle_fragment_results(
+        &self,
+        results: &[FragmentResult],
+        key_column: usize,
+        partitions: usize,
+    ) -> Result<Vec<Vec<Vec<String>>>> {
+        let width = results.iter().flat_map(|r| r.data.iter()).map(|row| row.len()).max().unwrap_or(0);
+        if key_column >= width {
+            return Err(common::Error::Execution(format!(
+                "shuffle key column {} out of range for fragment rows of width {}",
+                key_column, width
+            )));
         }
+        let columns: Vec<String> = (0..width).map(|i| format!("c{}", i)).collect();
+        // 所有片段使用同一模式，类型按全部行推断
+        let mut sample = QueryResult::new();
+        sample.columns = columns;
+        sample.rows = results.iter().flat_map(|r| r.data.iter().cloned()).collect();
+        let schema = RecordBatch::from_query_result(&sample)?.schema;
+        let inputs = results
+            .iter()
+            .map(|r| RecordBatch::from_rows(schema.clone(), &r.data).map(|b| vec![b]))
+            .collect::<Result<Vec<_>>>()?;
+
+        let mode = ExchangeMode::Hash { key_columns: vec![key_column] };
+        let (outputs, stats) = exchange_batches(mode, schema, inputs, partitions, &self.exchange_config).await?;
+        debug!("Shuffled {} fragment results into {} partitions: {:?}", results.len(), partitions, stats);
+        Ok(outputs.into_iter().map(|b| b.into_query_result().rows).collect())
     }
 
     /// 执行分布式查询计划
@@ -696,24 +749,100 @@ pub struct TableInfo {
 // ============================================================================
 
 /// 分布式事务管理器
+///
+/// 事务开始时打开一个存储引擎事务，事务内的读都经过它，读到的是开始时的快照。写入留在事务
+/// 自己的写缓冲里，读自己写过的键不访问存储层；提交时按写集合涉及的区域选择提交方式：读过
+/// 存储层的事务把写缓冲写入开始时打开的引擎事务提交，冲突由引擎按快照判定；只写不读、写集合
+/// 只涉及一个区域的事务交给组提交器，与并发提交合并成一个存储层事务。未配置存储引擎时只记录状态。
 pub struct DistributedTransactionManager {
     transactions: Mutex<HashMap<String, DistributedTransaction>>,
+    backend: Option<TransactionBackend>,
+}
+
+struct TransactionBackend {
+    engine: Arc<dyn StorageEngine>,
+    /// 与组提交器共用，组提交器按同一份划分分组
+    regions: Arc<RwLock<RegionMap>>,
+    policy: CommitPolicy,
+    group_committer: Arc<GroupCommitter>,
+    /// 活动事务在存储引擎上的事务，开始时打开，提交或回滚时取出
+    engine_transactions: Mutex<HashMap<String, EngineTransaction>>,
+}
+
+type EngineTransaction = Arc<tokio::sync::Mutex<Box<dyn StorageTransaction>>>;
+
+fn storage_error(e: storage::common::StorageError) -> common::Error {
+    common::Error::Storage(e.to_string())
 }
 
 impl DistributedTransactionManager {
     pub fn new() -> Self {
         Self {
             transactions: Mutex::new(HashMap::new()),
+            backend: None,
         }
     }
 
+    /// 事务提交到 `engine`，按引擎自己的区域划分 (TiKV 上从 PD 加载并定期刷新) 判断写集合涉及的区域
+    pub fn from_engine(engine: Arc<dyn StorageEngine>) -> Self {
+        let regions = engine.region_map().unwrap_or_default();
+        Self::with_shared_regions(engine, regions)
+    }
+
+    /// 事务提交到 `engine`，按 `regions` 判断写集合涉及的区域
+    pub fn with_engine(engine: Arc<dyn StorageEngine>, regions: RegionMap) -> Self {
+        Self::with_shared_regions(engine, Arc::new(RwLock::new(regions)))
+    }
+
+    fn with_shared_regions(engine: Arc<dyn StorageEngine>, regions: Arc<RwLock<RegionMap>>) -> Self {
+        let group_committer =
+            Arc::new(GroupCommitter::with_regions(engine.clone(), GroupCommitConfig::default(), regions.clone()));
+        Self {
+            transactions: Mutex::new(HashMap::new()),
+            backend: Some(TransactionBackend {
+                engine,
+                regions,
+                policy: CommitPolicy::default(),
+                group_committer,
+                engine_transactions: Mutex::new(HashMap::new()),
+            }),
+        }
+    }
+
+    pub fn with_commit_policy(mut self, policy: CommitPolicy) -> Self {
+        if let Some(backend) = self.backend.as_mut() {
+            backend.policy = policy;
+        }
+        self
+    }
+
+    /// 组提交统计，未配置存储引擎时为 None
+    pub fn group_commit_stats(&self) -> Option<GroupCommitStats> {
+        self.backend.as_ref().map(|backend| backend.group_committer.stats())
+    }
+
     pub async fn begin_transaction(&self) -> Result<String> {
         let transaction_id = uuid::Uuid::new_v4().to_string();
+        if let Some(backend) = self.backend.as_ref() {
+            let engine_transaction = backend
+                .engine
+                .begin_transaction(&StorageContext::default(), &StorageOptions::default())
+                .await
+                .map_err(storage_error)?;
+            backend
+                .engine_transactions
+                .lock()
+                .unwrap()
+                .insert(transaction_id.clone(), Arc::new(tokio::sync::Mutex::new(engine_transaction)));
+        }
         let transaction = DistributedTransaction {
             id: transaction_id.clone(),
             status: TransactionStatus::Active,
             participants: Vec::new(),
             start_time: std::time::Instant::now(),
+            writes: WriteBuffer::new(),
+            commit_mode: None,
+            read_from_store: false,
         };
 
         let mut transactions = self.transactions.lock().unwrap();
@@ -722,21 +851,147 @@ impl DistributedTransactionManager {
         Ok(transaction_id)
     }
 
+    /// 写入事务的写缓冲，提交时才发往存储层
+    pub fn put(&self, transaction_id: &str, key: Key, value: Value) -> Result<()> {
+        self.buffer_write(transaction_id, key, Some(value))
+    }
+
+    pub fn delete(&self, transaction_id: &str, key: Key) -> Result<()> {
+        self.buffer_write(transaction_id, key, None)
+    }
+
+    /// 读取键值：本事务写过的键从写缓冲返回，否则从事务开始时的快照读取
+    pub async fn get(&self, transaction_id: &str, key: &Key) -> Result<Option<Value>> {
+        {
+            let mut transactions = self.transactions.lock().unwrap();
+            Self::active(&transactions, transaction_id)?;
+            let transaction = transactions.get_mut(transaction_id).expect("checked above");
+            if let Some(buffered) = transaction.writes.get(key) {
+                return Ok(buffered.cloned());
+            }
+            transaction.read_from_store = true;
+        }
+        let Some(backend) = self.backend.as_ref() else { return Ok(None) };
+        let engine_transaction = backend
+            .engine_transactions
+            .lock()
+            .unwrap()
+            .get(transaction_id)
+            .cloned()
+            .ok_or_else(|| common::Error::Transaction(format!("Transaction {transaction_id} is not active")))?;
+        let result = engine_transaction
+            .lock()
+            .await
+            .get(key, &StorageOptions::default())
+            .await
+            .map_err(storage_error)?;
+        Ok(result.value)
+    }
+
     pub async fn commit_transaction(&self, transaction_id: &str) -> Result<()> {
+        // 在同一把锁下取出写缓冲并转入提交中，之后的写入与重复提交都会被拒绝；
+        // 释放锁后再提交，提交期间不阻塞其他事务
+        let (writes, read_from_store) = {
+            let mut transactions = self.transactions.lock().unwrap();
+            Self::active(&transactions, transaction_id)?;
+            let transaction = transactions.get_mut(transaction_id).expect("checked above");
+            transaction.status = TransactionStatus::Committing;
+            (std::mem::take(&mut transaction.writes), transaction.read_from_store)
+        };
+
+        let mut commit_mode = None;
+        let mut committed = Ok(());
+        if let Some(backend) = self.backend.as_ref() {
+            let mode = backend.policy.choose(&backend.regions.read(), &writes);
+            debug!("Committing transaction {} with {} writes ({:?})", transaction_id, writes.len(), mode);
+            let engine_transaction = backend.engine_transactions.lock().unwrap().remove(transaction_id);
+            committed = match engine_transaction {
+                // 只写不读的单区域事务没有需要校验的快照读，可以与并发提交合并
+                Some(engine_transaction) if mode == CommitMode::OnePhase && !read_from_store => {
+                    let _ = engine_transaction.lock().await.rollback().await;
+                    backend.group_committer.commit(writes).await
+                }
+                Some(engine_transaction) => commit_buffer(engine_transaction.lock().await.as_mut(), writes).await,
+                None => Err(storage::common::StorageError::Internal(format!(
+                    "Transaction {transaction_id} has no storage transaction"
+                ))),
+            };
+            commit_mode = Some(mode);
+        }
+
         let mut transactions = self.transactions.lock().unwrap();
         if let Some(transaction) = transactions.get_mut(transaction_id) {
-            transaction.status = TransactionStatus::Committed;
+            transaction.commit_mode = commit_mode;
+            transaction.status = match committed {
+                Ok(()) => TransactionStatus::Committed,
+                Err(_) => TransactionStatus::RolledBack,
+            };
         }
-        Ok(())
+        committed.map_err(|e| common::Error::Transaction(format!("Commit of {transaction_id} failed: {e}")))
     }
 
+    /// 回滚事务；已回滚的事务再次回滚无操作，提交中或已提交的事务不能回滚
     pub async fn rollback_transaction(&self, transaction_id: &str) -> Result<()> {
+        {
+            let mut transactions = self.transactions.lock().unwrap();
+            let transaction = transactions
+                .get_mut(transaction_id)
+                .ok_or_else(|| common::Error::Transaction(format!("Transaction {transaction_id} not found")))?;
+            match transaction.status {
+                TransactionStatus::Active => {
+                    transaction.writes = WriteBuffer::new();
+                    transaction.status = TransactionStatus::RolledBack;
+                }
+                TransactionStatus::RolledBack => return Ok(()),
+                TransactionStatus::Committing | TransactionStatus::Committed => {
+                    return Err(common::Error::Transaction(format!(
+                        "Transaction {transaction_id} is already committing"
+                    )));
+                }
+            }
+        }
+        let engine_transaction = self
+            .backend
+            .as_ref()
+            .and_then(|backend| backend.engine_transactions.lock().unwrap().remove(transaction_id));
+        if let Some(engine_transaction) = engine_transaction {
+            engine_transaction.lock().await.rollback().await.map_err(storage_error)?;
+        }
+        Ok(())
+    }
+
+    /// 事务快照 (状态、参与区域、提交方式)
+    pub fn transaction(&self, transaction_id: &str) -> Option<DistributedTransaction> {
+        self.transactions.lock().unwrap().get(transaction_id).cloned()
+    }
+
+    fn buffer_write(&self, transaction_id: &str, key: Key, value: Option<Value>) -> Result<()> {
         let mut transactions = self.transactions.lock().unwrap();
-        if let Some(transaction) = transactions.get_mut(transaction_id) {
-            transaction.status = TransactionStatus::RolledBack;
+        Self::active(&transactions, transaction_id)?;
+        let transaction = transactions.get_mut(transaction_id).expect("checked above");
+        if let Some(backend) = self.backend.as_ref() {
+            let participant = format!("region-{}", backend.regions.read().region_of(&key));
+            if !transaction.participants.contains(&participant) {
+                transaction.participants.push(participant);
+            }
+        }
+        match value {
+            Some(value) => transaction.writes.put(key, value),
+            None => transaction.writes.delete(key),
         }
         Ok(())
     }
+
+    fn active<'a>(
+        transactions: &'a HashMap<String, DistributedTransaction>,
+        transaction_id: &str,
+    ) -> Result<&'a DistributedTransaction> {
+        match transactions.get(transaction_id) {
+            Some(transaction) if matches!(transaction.status, TransactionStatus::Active) => Ok(transaction),
+            Some(_) => Err(common::Error::Transaction(format!("Transaction {transaction_id} is not active"))),
+            None => Err(common::Error::Transaction(format!("Transaction {transaction_id} not found"))),
+        }
+    }
 }
 
 /// 分布式事务
@@ -744,14 +999,23 @@ impl DistributedTransactionManager {
 pub struct DistributedTransaction {
     pub id: String,
     pub status: TransactionStatus,
+    /// 写集合涉及的区域
     pub participants: Vec<String>,
     pub start_time: std::time::Instant,
+    /// 未提交的写入
+    pub writes: WriteBuffer,
+    /// 提交时选定的提交方式
+    pub commit_mode: Option<CommitMode>,
+    /// 是否从存储层读过，读过的事务提交时经过开始时打开的引擎事务
+    pub read_from_store: bool,
 }
 
 /// 事务状态
 #[derive(Debug, Clone)]
 pub enum TransactionStatus {
     Active,
+    /// 写缓冲已取出，正在提交
+    Committing,
     Committed,
     RolledBack,
 }
@@ -869,6 +1133,27 @@ mod tests {
         assert_eq!(result.fragment_count, 1);
     }
 
+    #[tokio::test]
+    async fn test_shuffle_fragment_results() {
+        let executor = DistributedExecutor::new();
+        let fragment = |id: &str, keys: &[&str]| FragmentResult {
+            fragment_id: id.to_string(),
+            node_id: "node-1".to_string(),
+            data: keys.iter().map(|k| vec![k.to_string(), id.to_string()]).collect(),
+            execution_time: std::time::Duration::from_millis(1),
+        };
+        let results = vec![fragment("f1", &["1", "2", "3"]), fragment("f2", &["2", "3", "4"])];
+
+        let partitions = executor.shuffle_fragment_results(&results, 0, 2).await.unwrap();
+        assert_eq!(partitions.len(), 2);
+        assert_eq!(partitions.iter().map(|p| p.len()).sum::<usize>(), 6);
+        for key in ["1", "2", "3", "4"] {
+            let holders = partitions.iter().filter(|p| p.iter().any(|row| row[0] == key)).count();
+            assert_eq!(holders, 1);
+        }
+        assert!(executor.shuffle_fragment_results(&results, 5, 2).await.is_err());
+    }
+
     #[tokio::test]
     async fn test_node_manager() {
         let node_manager = NodeManager::new();
@@ -904,4 +1189,82 @@ mod tests {
         assert!(tables.iter().any(|t| t.name == "users"));
         assert!(tables.iter().any(|t| t.name == "orders"));
     }
+
+    #[tokio::test]
+    async fn test_transaction_buffers_writes_and_picks_commit_mode() {
+        let mut engine = storage::engine::MemoryEngine::new();
+        engine.initialize(&storage::common::StorageConfig::default()).await.unwrap();
+        let engine: Arc<dyn StorageEngine> = Arc::new(engine);
+        let manager = DistributedTransactionManager::with_engine(engine.clone(), RegionMap::new(vec![Key::from("m")]));
+        let (context, options) = (StorageContext::default(), StorageOptions::default());
+
+        // 单区域：读自己的写，提交前存储层不可见，提交走组提交
+        let txn = manager.begin_transaction().await.unwrap();
+        manager.put(&txn, Key::from("a"), Value::from("1")).unwrap();
+        manager.put(&txn, Key::from("b"), Value::from("2")).unwrap();
+        assert_eq!(manager.get(&txn, &Key::from("a")).await.unwrap(), Some(Value::from("1")));
+        assert!(engine.get(&Key::from("a"), &context, &options).await.unwrap().value.is_none());
+        manager.commit_transaction(&txn).await.unwrap();
+        let committed = manager.transaction(&txn).unwrap();
+        assert_eq!(committed.commit_mode, Some(CommitMode::OnePhase));
+        assert_eq!(committed.participants, vec!["region-0".to_string()]);
+        assert_eq!(manager.group_commit_stats().unwrap().groups, 1);
+        assert!(manager.put(&txn, Key::from("c"), Value::from("3")).is_err());
+
+        // 跨区域：走存储引擎事务
+        let txn = manager.begin_transaction().await.unwrap();
+        manager.delete(&txn, Key::from("a")).unwrap();
+        manager.put(&txn, Key::from("x"), Value::from("9")).unwrap();
+        assert_eq!(manager.get(&txn, &Key::from("a")).await.unwrap(), None);
+        assert_eq!(manager.get(&txn, &Key::from("b")).await.unwrap(), Some(Value::from("2")));
+        manager.commit_transaction(&txn).await.unwrap();
+        assert_eq!(manager.transaction(&txn).unwrap().commit_mode, Some(CommitMode::AsyncCommit));
+        assert!(engine.get(&Key::from("a"), &context, &options).await.unwrap().value.is_none());
+        assert!(engine.get(&Key::from("x"), &context, &options).await.unwrap().value.is_some());
+
+        // 回滚丢弃写缓冲
+        let txn = manager.begin_transaction().await.unwrap();
+        manager.put(&txn, Key::from("y"), Value::from("0")).unwrap();
+        manager.rollback_transaction(&txn).await.unwrap();
+        assert!(manager.commit_transaction(&txn).await.is_err());
+        assert!(matches!(manager.transaction(&txn).unwrap().status, TransactionStatus::RolledBack));
+        assert!(engine.get(&Key::from("y"), &context, &options).await.unwrap().value.is_none());
+
+        // 未知事务、重复提交、提交后回滚都报错
+        assert!(manager.commit_transaction("missing").await.is_err());
+        let txn = manager.begin_transaction().await.unwrap();
+        manager.put(&txn, Key::from("z"), Value::from("1")).unwrap();
+        manager.commit_transaction(&txn).await.unwrap();
+        assert!(manager.commit_transaction(&txn).await.is_err());
+        assert!(manager.rollback_transaction(&txn).await.is_err());
+        assert!(matches!(manager.transaction(&txn).unwrap().status, TransactionStatus::Committed));
+    }
+
+    #[tokio::test]
+    async fn test_transaction_reads_and_commits_through_its_begin_snapshot() {
+        let mut engine = storage::engine::MemoryEngine::new();
+        engine.initialize(&storage::common::StorageConfig::default()).await.unwrap();
+        let engine: Arc<dyn StorageEngine> = Arc::new(engine);
+        let manager = DistributedTransactionManager::from_engine(engine.clone());
+        let (context, options) = (StorageContext::default(), StorageOptions::default());
+        engine.put(&Key::from("k"), &Value::from("old"), &context, &options).await.unwrap();
+
+        // 开始之后的写入对事务不可见
+        let txn = manager.begin_transaction().await.unwrap();
+        engine.put(&Key::from("k"), &Value::from("new"), &context, &options).await.unwrap();
+        assert_eq!(manager.get(&txn, &Key::from("k")).await.unwrap(), Some(Value::from("old")));
+        assert!(manager.transaction(&txn).unwrap().read_from_store);
+
+        // 读过存储层的单区域事务经过自己的引擎事务提交，不进组提交
+        manager.put(&txn, Key::from("k2"), Value::from("1")).unwrap();
+        manager.commit_transaction(&txn).await.unwrap();
+        assert_eq!(manager.transaction(&txn).unwrap().commit_mode, Some(CommitMode::OnePhase));
+        assert_eq!(manager.group_commit_stats().unwrap().groups, 0);
+        assert!(engine.get(&Key::from("k2"), &context, &options).await.unwrap().value.is_some());
+
+        // 回滚同时回滚引擎事务，之后的读被拒绝
+        let txn = manager.begin_transaction().await.unwrap();
+        manager.rollback_transaction(&txn).await.unwrap();
+        assert!(manager.get(&txn, &Key::from("k")).await.is_err());
+    }
 }
\ No newline at end of file
@@ -0,0 +1,361 @@
+//! 表达式编译
+//!
+//! `vector_kernels::evaluate` 每个批都要重新遍历 `ParsedExpression`、按列名查找列、
+//! 解析字面量。这里在算子打开时把表达式编译一次：
+//!
+//! - 先复用 `ConstantFoldingRule` 折叠数值常量运算，再把不引用任何列的子树
+//!   (如 `1 < 2`、`'a' = 'a'`) 预先求值为标量；
+//! - 列名按输入模式绑定为列下标，字面量预先解析为 `Value`；
+//! - 每个节点编译为一个闭包，运算符与操作数形态 (列/常量) 在编译期分派，
+//!   例如 `列 > 常量` 直接调用标量比较内核。
+//!
+//! 编译结果按批求值，内层循环仍然是 `vector_kernels` 中的列式内核。
+
+use common::{Error, Result, Value};
+use std::borrow::Cow;
+use std::fmt;
+
+use crate::executor::record_batch::{ColumnVector, Field, RecordBatch, Schema};
+use crate::executor::vector_kernels::{self, ArithmeticOp, CompareOp, Operand};
+use crate::parser::{ParsedExpression, ParsedOperator};
+use crate::planner::ConstantFoldingRule;
+
+type EvalFn = Box<dyn for<'a> Fn(&'a RecordBatch) -> Result<Operand<'a>> + Send + Sync>;
+
+/// 编译后的表达式
+pub struct CompiledExpr {
+    /// 折叠后的表达式，仅用于调试输出
+    source: ParsedExpression,
+    /// 编译时输入模式的列数，求值时用于校验批的形态
+    input_width: usize,
+    /// 引用到的列下标 (去重、升序)
+    columns: Vec<usize>,
+    eval: EvalFn,
+}
+
+impl fmt::Debug for CompiledExpr {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("CompiledExpr")
+            .field("source", &self.source)
+            .field("columns", &self.columns)
+            .finish()
+    }
+}
+
+impl CompiledExpr {
+    /// 按输入模式编译表达式，引用了不存在的列或不支持的函数时返回错误
+    pub fn compile(expr: &ParsedExpression, schema: &Schema) -> Result<Self> {
+        let folded = ConstantFoldingRule.fold(expr.clone());
+        let mut columns = Vec::new();
+        let eval = compile_node(&folded, schema, &mut columns)?;
+        columns.sort_unstable();
+        columns.dedup();
+        Ok(Self {
+            source: folded,
+            input_width: schema.fields.len(),
+            columns,
+            eval,
+        })
+    }
+
+    /// 表达式引用的列下标
+    pub fn columns(&self) -> &[usize] {
+        &self.columns
+    }
+
+    /// 表达式是否已整体折叠为常量
+    pub fn is_constant(&self) -> bool {
+        self.columns.is_empty()
+    }
+
+    fn check_input(&self, batch: &RecordBatch) -> Result<()> {
+        if batch.columns.len() != self.input_width {
+            return Err(Error::Execution(format!(
+                "expression compiled for {} columns, batch has {}",
+                self.input_width,
+                batch.columns.len()
+            )));
+        }
+        Ok(())
+    }
+
+    /// 计算表达式，返回与批物理行数等长的列
+    pub fn evaluate(&self, batch: &RecordBatch) -> Result<ColumnVector> {
+        self.check_input(batch)?;
+        Ok((self.eval)(batch)?.into_column(batch.physical_rows()).into_owned())
+    }
+
+    /// 计算谓词，返回满足条件的物理行下标 (已与批原有的选择向量求交)
+    pub fn evaluate_predicate(&self, batch: &RecordBatch) -> Result<Vec<u32>> {
+        self.check_input(batch)?;
+        let result = (self.eval)(batch)?.into_column(batch.physical_rows());
+        vector_kernels::predicate_selection(&result, batch)
+    }
+
+    /// 在批上应用过滤条件，只更新选择向量而不搬移数据
+    pub fn filter(&self, batch: RecordBatch) -> Result<RecordBatch> {
+        let selection = self.evaluate_predicate(&batch)?;
+        Ok(batch.with_selection(selection))
+    }
+}
+
+/// 绑定列名：先精确匹配，再去掉表名限定 (`t.id` → `id`) 重试
+pub fn bind_column(schema: &Schema, name: &str) -> Result<usize> {
+    schema
+        .index_of(name)
+        .or_else(|| name.rsplit_once('.').and_then(|(_, column)| schema.index_of(column)))
+        .ok_or_else(|| Error::Execution(format!("column '{}' not found in input schema", name)))
+}
+
+fn references_columns(expr: &ParsedExpression) -> bool {
+    match expr {
+        ParsedExpression::Column(_) => true,
+        ParsedExpression::BinaryOp { left, right, .. } => references_columns(left) || references_columns(right),
+        ParsedExpression::Function { arguments, .. } => arguments.iter().any(references_columns),
+        ParsedExpression::Literal(_) | ParsedExpression::Parameter(_) => false,
+    }
+}
+
+/// 在单行的占位批上求出常量子树的值；求值失败 (如溢出) 时保留原表达式，
+/// 让错误在真正执行时按行出现
+fn fold_constant(eval: &EvalFn) -> Option<Value> {
+    let batch = RecordBatch::try_new(
+        Schema::new(vec![Field::new("$const", common::DataType::BigInt)]),
+        vec![ColumnVector::from_i64(vec![0])],
+    )
+    .ok()?;
+    let value = match eval(&batch).ok()? {
+        Operand::Scalar(value) => value,
+        operand => operand.into_column(1).value(0),
+    };
+    Some(value)
+}
+
+fn compile_node(expr: &ParsedExpression, schema: &Schema, columns: &mut Vec<usize>) -> Result<EvalFn> {
+    let eval = compile_tree(expr, schema, columns)?;
+    if matches!(expr, ParsedExpression::BinaryOp { .. }) && !references_columns(expr) {
+        if let Some(value) = fold_constant(&eval) {
+            return Ok(scalar(value));
+        }
+    }
+    Ok(eval)
+}
+
+/// 把闭包装箱为求值节点 (借助泛型约束推断出高阶生命周期签名)
+fn node<F>(eval: F) -> EvalFn
+where
+    F: for<'a> Fn(&'a RecordBatch) -> Result<Operand<'a>> + Send + Sync + 'static,
+{
+    Box::new(eval)
+}
+
+fn scalar(value: Value) -> EvalFn {
+    node(move |_| Ok(Operand::Scalar(value.clone())))
+}
+
+fn compile_tree(expr: &ParsedExpression, schema: &Schema, columns: &mut Vec<usize>) -> Result<EvalFn> {
+    match expr {
+        ParsedExpression::Column(name) => {
+            let index = bind_column(schema, name)?;
+            columns.push(index);
+            Ok(node(move |batch| Ok(Operand::Column(Cow::Borrowed(&batch.columns[index])))))
+        }
+        ParsedExpression::Literal(value) => Ok(scalar(vector_kernels::literal_value(value))),
+        ParsedExpression::BinaryOp { left, operator, right } => {
+            compile_binary(left, *operator, right, schema, columns)
+        }
+        ParsedExpression::Function { name, .. } => Err(Error::Execution(format!(
+            "function '{}' is not supported by compiled expressions",
+            name
+        ))),
+        ParsedExpression::Parameter(index) => Err(Error::Execution(format!("unbound parameter ${}", index + 1))),
+    }
+}
+
+fn compile_binary(
+    left: &ParsedExpression,
+    operator: ParsedOperator,
+    right: &ParsedExpression,
+    schema: &Schema,
+    columns: &mut Vec<usize>,
+) -> Result<EvalFn> {
+    if let Some(op) = compare_op(operator) {
+        // 列与非 NULL 常量比较：编译期确定列下标与常量，直接走标量比较内核
+        if let Some((index, value, op)) = column_scalar(left, right, op, schema)? {
+            columns.push(index);
+            return Ok(node(move |batch| {
+                let column = &batch.columns[index];
+                Ok(Operand::Column(Cow::Owned(vector_kernels::compare_column_scalar(column, &value, op))))
+            }));
+        }
+        let (l, r) = (compile_node(left, schema, columns)?, compile_node(right, schema, columns)?);
+        return Ok(node(move |batch| {
+            let len = batch.physical_rows();
+            vector_kernels::compare_operands(l(batch)?, r(batch)?, op, len).map(|c| Operand::Column(Cow::Owned(c)))
+        }));
+    }
+
+    let (l, r) = (compile_node(left, schema, columns)?, compile_node(right, schema, columns)?);
+    if let Some(op) = arithmetic_op(operator) {
+        return Ok(node(move |batch| {
+            let len = batch.physical_rows();
+            vector_kernels::arithmetic_operands(l(batch)?, r(batch)?, op, len).map(|c| Operand::Column(Cow::Owned(c)))
+        }));
+    }
+    match operator {
+        ParsedOperator::And | ParsedOperator::Or => Ok(node(move |batch| {
+            let len = batch.physical_rows();
+            vector_kernels::boolean_operands(l(batch)?, r(batch)?, operator, len).map(|c| Operand::Column(Cow::Owned(c)))
+        })),
+        other => Err(Error::Execution(format!("operator {:?} is not supported by compiled expressions", other))),
+    }
+}
+
+/// 识别 `列 op 常量` / `常量 op 列`，返回 (列下标, 常量, 以列为左操作数的运算)
+fn column_scalar(
+    left: &ParsedExpression,
+    right: &ParsedExpression,
+    op: CompareOp,
+    schema: &Schema,
+) -> Result<Option<(usize, Value, CompareOp)>> {
+    let (name, literal, op) = match (left, right) {
+        (ParsedExpression::Column(name), ParsedExpression::Literal(value)) => (name, value, op),
+        (ParsedExpression::Literal(value), ParsedExpression::Column(name)) => (name, value, op.flip()),
+        _ => return Ok(None),
+    };
+    match vector_kernels::literal_value(literal) {
+        // NULL 比较的结果恒为 NULL，交给通用路径处理
+        Value::Null => Ok(None),
+        value => Ok(Some((bind_column(schema, name)?, value, op))),
+    }
+}
+
+fn compare_op(operator: ParsedOperator) -> Option<CompareOp> {
+    match operator {
+        ParsedOperator::Equal => Some(CompareOp::Eq),
+        ParsedOperator::NotEqual => Some(CompareOp::NotEq),
+        ParsedOperator::LessThan => Some(CompareOp::Lt),
+        ParsedOperator::LessThanOrEqual => Some(CompareOp::LtEq),
+        ParsedOperator::GreaterThan => Some(CompareOp::Gt),
+        ParsedOperator::GreaterThanOrEqual => Some(CompareOp::GtEq),
+        _ => None,
+    }
+}
+
+fn arithmetic_op(operator: ParsedOperator) -> Option<ArithmeticOp> {
+    match operator {
+        ParsedOperator::Add => Some(ArithmeticOp::Add),
+        ParsedOperator::Subtract => Some(ArithmeticOp::Subtract),
+        ParsedOperator::Multiply => Some(ArithmeticOp::Multiply),
+        ParsedOperator::Divide => Some(ArithmeticOp::Divide),
+        _ => None,
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::parser::ParsedValue;
+    use common::DataType;
+
+    fn column(name: &str) -> Box<ParsedExpression> {
+        Box::new(ParsedExpression::Column(name.to_string()))
+    }
+
+    fn number(text: &str) -> Box<ParsedExpression> {
+        Box::new(ParsedExpression::Literal(ParsedValue::Number(text.to_string())))
+    }
+
+    fn binary(left: Box<ParsedExpression>, operator: ParsedOperator, right: Box<ParsedExpression>) -> Box<ParsedExpression> {
+        Box::new(ParsedExpression::BinaryOp { left, operator, right })
+    }
+
+    fn batch() -> RecordBatch {
+        let mut value = ColumnVector::new(DataType::BigInt);
+        for v in [Some(100), Some(200), None, Some(400), Some(500)] {
+            match v {
+                Some(v) => value.push_value(&Value::BigInt(v)),
+                None => value.push_null(),
+            }
+        }
+        RecordBatch::try_new(
+            Schema::new(vec![
+                Field::new("id", DataType::BigInt),
+                Field::new("name", DataType::String),
+                Field::new("value", DataType::BigInt),
+            ]),
+            vec![
+                ColumnVector::from_i64(vec![1, 2, 3, 4, 5]),
+                ColumnVector::from_strs(&["a", "b", "c", "d", "e"]),
+                value,
+            ],
+        )
+        .unwrap()
+    }
+
+    #[test]
+    fn test_matches_interpreted_kernels() {
+        let batch = batch();
+        let predicates = [
+            binary(column("value"), ParsedOperator::GreaterThan, binary(number("100"), ParsedOperator::Add, number("50"))),
+            binary(number("3"), ParsedOperator::GreaterThanOrEqual, column("id")),
+            binary(
+                binary(column("value"), ParsedOperator::GreaterThan, number("150")),
+                ParsedOperator::Or,
+                binary(column("id"), ParsedOperator::Equal, number("3")),
+            ),
+            binary(
+                binary(column("value"), ParsedOperator::Subtract, column("id")),
+                ParsedOperator::LessThan,
+                number("399"),
+            ),
+        ];
+        for predicate in predicates.iter() {
+            let compiled = CompiledExpr::compile(predicate, &batch.schema).unwrap();
+            let expected = vector_kernels::evaluate_predicate(predicate, &batch).unwrap();
+            assert_eq!(compiled.evaluate_predicate(&batch).unwrap(), expected, "{:?}", predicate);
+        }
+
+        // 带表名限定的列名绑定到同一列
+        let qualified = binary(number("3"), ParsedOperator::GreaterThanOrEqual, column("t.id"));
+        let compiled = CompiledExpr::compile(&qualified, &batch.schema).unwrap();
+        assert_eq!(compiled.evaluate_predicate(&batch).unwrap(), vec![0, 1, 2]);
+
+        let sum = binary(column("value"), ParsedOperator::Multiply, number("2"));
+        let compiled = CompiledExpr::compile(&sum, &batch.schema).unwrap();
+        assert_eq!(compiled.columns(), &[2]);
+        let result = compiled.evaluate(&batch).unwrap();
+        assert_eq!(result.value(1), Value::BigInt(400));
+        assert!(result.is_null(2));
+    }
+
+    #[test]
+    fn test_constant_subtrees_are_folded() {
+        let batch = batch().with_selection(vec![0, 3]);
+        let always = binary(
+            binary(number("1"), ParsedOperator::LessThan, number("2")),
+            ParsedOperator::And,
+            binary(column("id"), ParsedOperator::GreaterThan, number("0")),
+        );
+        let compiled = CompiledExpr::compile(&always, &batch.schema).unwrap();
+        assert_eq!(compiled.evaluate_predicate(&batch).unwrap(), vec![0, 3]);
+
+        let never = binary(number("1"), ParsedOperator::Equal, number("2"));
+        let compiled = CompiledExpr::compile(&never, &batch.schema).unwrap();
+        assert!(compiled.is_constant());
+        assert!(compiled.filter(batch).unwrap().row_indices().is_empty());
+    }
+
+    #[test]
+    fn test_binding_errors() {
+        let batch = batch();
+        let missing = binary(column("missing"), ParsedOperator::Equal, number("1"));
+        assert!(CompiledExpr::compile(&missing, &batch.schema).is_err());
+
+        let function = ParsedExpression::Function { name: "upper".to_string(), arguments: vec![] };
+        assert!(CompiledExpr::compile(&function, &batch.schema).is_err());
+
+        let compiled = CompiledExpr::compile(&binary(column("id"), ParsedOperator::Equal, number("1")), &batch.schema).unwrap();
+        assert!(compiled.evaluate(&batch.project(&[0])).is_err());
+    }
+}
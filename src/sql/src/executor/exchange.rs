@@ -0,0 +1,499 @@
+//! 节点间数据交换 (Exchange)
+//!
+//! 一次交换有 M 个发送端 (上游片段) 和 N 个接收端 (下游片段)，支持三种方式：
+//!
+//! - 哈希重分区：按分组键/连接键的哈希把行路由到 `hash % N` 号接收端
+//! - 广播：每个批发给所有接收端 (小表广播连接)
+//! - 汇聚：所有批发给 0 号接收端 (协调节点)
+//!
+//! 批以列式帧在链路上传输，帧体沿用落盘文件的编码 (见 `spill`)：
+//!
+//! ```text
+//! u8 帧类型 | u32 发送端编号 | (数据帧) 列式批编码
+//! ```
+//!
+//! 每条 发送端→接收端 链路有固定数量的信用 (credit)。发送数据帧前先取得一个信用，
+//! 接收端解码完一帧后归还，因此每条链路上在途的帧数有上界，慢的接收端会反压上游，
+//! 而不会在内存中堆积无限多的帧。结束帧不占用信用。
+
+use common::{Error, Result};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::Arc;
+use tokio::sync::{mpsc, Semaphore};
+use tracing::debug;
+
+use crate::executor::hash_join::hash_keys;
+use crate::executor::record_batch::{RecordBatch, Schema};
+use crate::executor::spill::{read_batch, write_batch};
+
+const FRAME_DATA: u8 = 1;
+const FRAME_END: u8 = 2;
+
+/// 交换方式
+#[derive(Debug, Clone, PartialEq)]
+pub enum ExchangeMode {
+    /// 按键列哈希重分区
+    Hash { key_columns: Vec<usize> },
+    /// 广播到所有接收端
+    Broadcast,
+    /// 汇聚到 0 号接收端
+    Gather,
+}
+
+/// 交换配置
+#[derive(Debug, Clone)]
+pub struct ExchangeConfig {
+    /// 每条链路的信用数，即最多在途的数据帧数
+    pub credits_per_link: usize,
+    /// 发送端按目标缓冲的行数，攒够后编码为一帧发出
+    pub batch_rows: usize,
+    /// 构建侧不超过该行数时，内连接改为广播构建侧
+    pub broadcast_threshold_rows: usize,
+}
+
+impl Default for ExchangeConfig {
+    fn default() -> Self {
+        Self {
+            credits_per_link: 4,
+            batch_rows: 4096,
+            broadcast_threshold_rows: 10_000,
+        }
+    }
+}
+
+/// 交换统计，所有发送端共享
+#[derive(Debug, Default)]
+pub struct ExchangeMetrics {
+    pub frames_sent: AtomicU64,
+    pub bytes_sent: AtomicU64,
+    pub rows_sent: AtomicU64,
+    /// 发送端因信用耗尽而等待的次数
+    pub credit_waits: AtomicU64,
+}
+
+impl ExchangeMetrics {
+    pub fn snapshot(&self) -> ExchangeStats {
+        ExchangeStats {
+            frames_sent: self.frames_sent.load(Ordering::Relaxed),
+            bytes_sent: self.bytes_sent.load(Ordering::Relaxed),
+            rows_sent: self.rows_sent.load(Ordering::Relaxed),
+            credit_waits: self.credit_waits.load(Ordering::Relaxed),
+        }
+    }
+}
+
+/// 交换统计快照
+#[derive(Debug, Clone, Default, PartialEq)]
+pub struct ExchangeStats {
+    pub frames_sent: u64,
+    pub bytes_sent: u64,
+    pub rows_sent: u64,
+    pub credit_waits: u64,
+}
+
+/// 编码数据帧
+pub fn encode_data_frame(sender: usize, batch: &RecordBatch) -> Result<Vec<u8>> {
+    let mut frame = Vec::with_capacity(batch.memory_size() + 16);
+    frame.push(FRAME_DATA);
+    frame.extend_from_slice(&(sender as u32).to_le_bytes());
+    write_batch(&mut frame, batch)?;
+    Ok(frame)
+}
+
+/// 编码结束帧
+pub fn encode_end_frame(sender: usize) -> Vec<u8> {
+    let mut frame = Vec::with_capacity(5);
+    frame.push(FRAME_END);
+    frame.extend_from_slice(&(sender as u32).to_le_bytes());
+    frame
+}
+
+/// 解码一帧，返回发送端编号和数据 (结束帧为 None)
+pub fn decode_frame(frame: &[u8], schema: &Schema) -> Result<(usize, Option<RecordBatch>)> {
+    if frame.len() < 5 {
+        return Err(Error::Deserialization(format!("exchange frame too short: {} bytes", frame.len())));
+    }
+    let sender = u32::from_le_bytes([frame[1], frame[2], frame[3], frame[4]]) as usize;
+    match frame[0] {
+        FRAME_END => Ok((sender, None)),
+        FRAME_DATA => {
+            let mut body = &frame[5..];
+            let batch = read_batch(&mut body, schema)?
+                .ok_or_else(|| Error::Deserialization("exchange data frame has no batch".to_string()))?;
+            Ok((sender, Some(batch)))
+        }
+        tag => Err(Error::Deserialization(format!("unknown exchange frame type {}", tag))),
+    }
+}
+
+/// 一条 发送端→接收端 链路
+struct Link {
+    tx: mpsc::UnboundedSender<Vec<u8>>,
+    credits: Arc<Semaphore>,
+}
+
+/// 交换的一组端点
+pub struct Exchange {
+    senders: Vec<ExchangeSender>,
+    receivers: Vec<ExchangeReceiver>,
+    metrics: Arc<ExchangeMetrics>,
+}
+
+impl Exchange {
+    pub fn new(mode: ExchangeMode, schema: Schema, senders: usize, receivers: usize, config: &ExchangeConfig) -> Result<Self> {
+        if senders == 0 || receivers == 0 {
+            return Err(Error::Execution(format!(
+                "exchange needs at least one sender and one receiver, got {} and {}",
+                senders, receivers
+            )));
+        }
+        if let ExchangeMode::Hash { key_columns } = &mode {
+            if let Some(&c) = key_columns.iter().find(|&&c| c >= schema.fields.len()) {
+                return Err(Error::Execution(format!("exchange key column {} out of range", c)));
+            }
+        }
+        let credits_per_link = config.credits_per_link.max(1);
+        let metrics = Arc::new(ExchangeMetrics::default());
+
+        // credits[s][r] 为 s→r 链路的信用
+        let credits: Vec<Vec<Arc<Semaphore>>> = (0..senders)
+            .map(|_| (0..receivers).map(|_| Arc::new(Semaphore::new(credits_per_link))).collect())
+            .collect();
+        let mut txs = Vec::with_capacity(receivers);
+        let mut receiver_list = Vec::with_capacity(receivers);
+        for r in 0..receivers {
+            let (tx, rx) = mpsc::unbounded_channel();
+            txs.push(tx);
+            receiver_list.push(ExchangeReceiver {
+                id: r,
+                schema: schema.clone(),
+                rx,
+                credits: credits.iter().map(|links| links[r].clone()).collect(),
+                finished: vec![false; senders],
+                remaining: senders,
+            });
+        }
+
+        let targets = match mode {
+            ExchangeMode::Hash { .. } => receivers,
+            ExchangeMode::Broadcast | ExchangeMode::Gather => 1,
+        };
+        let sender_list = (0..senders)
+            .map(|s| ExchangeSender {
+                id: s,
+                mode: mode.clone(),
+                schema: schema.clone(),
+                links: (0..receivers).map(|r| Link { tx: txs[r].clone(), credits: credits[s][r].clone() }).collect(),
+                buffers: (0..targets).map(|_| RecordBatch::empty(schema.clone())).collect(),
+                batch_rows: config.batch_rows.max(1),
+                metrics: metrics.clone(),
+            })
+            .collect();
+
+        Ok(Self { senders: sender_list, receivers: receiver_list, metrics })
+    }
+
+    pub fn metrics(&self) -> Arc<ExchangeMetrics> {
+        self.metrics.clone()
+    }
+
+    /// 拆分为发送端和接收端，分别交给上下游片段
+    pub fn split(self) -> (Vec<ExchangeSender>, Vec<ExchangeReceiver>) {
+        (self.senders, self.receivers)
+    }
+}
+
+/// 交换发送端
+pub struct ExchangeSender {
+    id: usize,
+    mode: ExchangeMode,
+    schema: Schema,
+    links: Vec<Link>,
+    /// 每个目标一个缓冲；广播与汇聚只有一个
+    buffers: Vec<RecordBatch>,
+    batch_rows: usize,
+    metrics: Arc<ExchangeMetrics>,
+}
+
+impl ExchangeSender {
+    pub fn id(&self) -> usize {
+        self.id
+    }
+
+    /// 发送一个批，行按交换方式缓冲到目标上，攒够 `batch_rows` 后发出
+    pub async fn send(&mut self, batch: &RecordBatch) -> Result<()> {
+        if batch.num_rows() == 0 {
+            return Ok(());
+        }
+        match &self.mode {
+            ExchangeMode::Hash { key_columns } => {
+                let hashes = hash_keys(batch, key_columns);
+                let receivers = self.links.len() as u64;
+                let mut rows: Vec<Vec<usize>> = vec![Vec::new(); self.buffers.len()];
+                for row in batch.row_indices() {
+                    rows[(hashes[row] % receivers) as usize].push(row);
+                }
+                for (target, rows) in rows.iter().enumerate() {
+                    if !rows.is_empty() {
+                        self.buffers[target].append(&batch.take(rows))?;
+                    }
+                }
+            }
+            ExchangeMode::Broadcast | ExchangeMode::Gather => self.buffers[0].append(batch)?,
+        }
+        for target in 0..self.buffers.len() {
+            if self.buffers[target].num_rows() >= self.batch_rows {
+                self.flush(target).await?;
+            }
+        }
+        Ok(())
+    }
+
+    /// 发出剩余缓冲并向所有接收端发送结束帧
+    pub async fn finish(mut self) -> Result<()> {
+        for target in 0..self.buffers.len() {
+            self.flush(target).await?;
+        }
+        let end = encode_end_frame(self.id);
+        for link in &self.links {
+            link.tx.send(end.clone()).map_err(|_| receiver_closed())?;
+        }
+        debug!("Exchange sender {} finished", self.id);
+        Ok(())
+    }
+
+    async fn flush(&mut self, target: usize) -> Result<()> {
+        if self.buffers[target].num_rows() == 0 {
+            return Ok(());
+        }
+        let batch = std::mem::replace(&mut self.buffers[target], RecordBatch::empty(self.schema.clone()));
+        let frame = encode_data_frame(self.id, &batch)?;
+        let links: Vec<usize> = match self.mode {
+            ExchangeMode::Hash { .. } => vec![target],
+            ExchangeMode::Broadcast => (0..self.links.len()).collect(),
+            ExchangeMode::Gather => vec![0],
+        };
+        for link in links {
+            self.send_frame(link, frame.clone(), batch.num_rows()).await?;
+        }
+        Ok(())
+    }
+
+    async fn send_frame(&self, link: usize, frame: Vec<u8>, rows: usize) -> Result<()> {
+        let link = &self.links[link];
+        // 先取得信用再发送，信用耗尽时等待接收端消费
+        let permit = match link.credits.try_acquire() {
+            Ok(permit) => permit,
+            Err(_) => {
+                self.metrics.credit_waits.fetch_add(1, Ordering::Relaxed);
+                link.credits.acquire().await.map_err(|_| receiver_closed())?
+            }
+        };
+        permit.forget();
+        self.metrics.frames_sent.fetch_add(1, Ordering::Relaxed);
+        self.metrics.bytes_sent.fetch_add(frame.len() as u64, Ordering::Relaxed);
+        self.metrics.rows_sent.fetch_add(rows as u64, Ordering::Relaxed);
+        link.tx.send(frame).map_err(|_| receiver_closed())
+    }
+}
+
+fn receiver_closed() -> Error {
+    Error::Network("exchange receiver closed".to_string())
+}
+
+/// 交换接收端
+pub struct ExchangeReceiver {
+    id: usize,
+    schema: Schema,
+    rx: mpsc::UnboundedReceiver<Vec<u8>>,
+    /// credits[s] 为 s→本接收端 链路的信用
+    credits: Vec<Arc<Semaphore>>,
+    finished: Vec<bool>,
+    remaining: usize,
+}
+
+impl ExchangeReceiver {
+    pub fn id(&self) -> usize {
+        self.id
+    }
+
+    pub fn schema(&self) -> &Schema {
+        &self.schema
+    }
+
+    /// 读取下一个批，所有发送端都结束后返回 None
+    pub async fn next_batch(&mut self) -> Result<Option<RecordBatch>> {
+        while self.remaining > 0 {
+            let frame = self
+                .rx
+                .recv()
+                .await
+                .ok_or_else(|| Error::Network("exchange sender dropped before end of stream".to_string()))?;
+            let (sender, batch) = decode_frame(&frame, &self.schema)?;
+            if sender >= self.credits.len() {
+                return Err(Error::Deserialization(format!("exchange frame from unknown sender {}", sender)));
+            }
+            match batch {
+                Some(batch) => {
+                    // 解码完成即归还信用
+                    self.credits[sender].add_permits(1);
+                    return Ok(Some(batch));
+                }
+                None if !self.finished[sender] => {
+                    self.finished[sender] = true;
+                    self.remaining -= 1;
+                }
+                None => {}
+            }
+        }
+        Ok(None)
+    }
+
+    /// 读取全部数据并拼接为一个批
+    pub async fn collect(mut self) -> Result<RecordBatch> {
+        let mut out = RecordBatch::empty(self.schema.clone());
+        while let Some(batch) = self.next_batch().await? {
+            out.append(&batch)?;
+        }
+        Ok(out)
+    }
+}
+
+/// 运行一次完整的交换：第 i 组输入由第 i 个发送端发出，返回每个接收端收到的数据
+pub async fn exchange_batches(
+    mode: ExchangeMode,
+    schema: Schema,
+    inputs: Vec<Vec<RecordBatch>>,
+    receivers: usize,
+    config: &ExchangeConfig,
+) -> Result<(Vec<RecordBatch>, ExchangeStats)> {
+    let exchange = Exchange::new(mode, schema, inputs.len(), receivers, config)?;
+    let metrics = exchange.metrics();
+    let (senders, receivers) = exchange.split();
+
+    // 收发两端并发运行，信用才能在消费后回到发送端
+    let send_handles: Vec<_> = senders
+        .into_iter()
+        .zip(inputs)
+        .map(|(mut sender, batches)| {
+            tokio::spawn(async move {
+                for batch in &batches {
+                    sender.send(batch).await?;
+                }
+                sender.finish().await
+            })
+        })
+        .collect();
+    let receive_handles: Vec<_> = receivers.into_iter().map(|r| tokio::spawn(r.collect())).collect();
+
+    for handle in send_handles {
+        handle.await.map_err(|e| Error::Execution(format!("exchange sender task failed: {}", e)))??;
+    }
+    let mut outputs = Vec::with_capacity(receive_handles.len());
+    for handle in receive_handles {
+        outputs.push(handle.await.map_err(|e| Error::Execution(format!("exchange receiver task failed: {}", e)))??);
+    }
+    Ok((outputs, metrics.snapshot()))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::executor::record_batch::{ColumnVector, Field};
+    use common::DataType;
+
+    fn batch(ids: std::ops::Range<i64>) -> RecordBatch {
+        RecordBatch::try_new(
+            Schema::new(vec![Field::new("id", DataType::BigInt), Field::new("name", DataType::String)]),
+            vec![
+                ColumnVector::from_i64(ids.clone().collect()),
+                ColumnVector::from_strings(ids.map(|i| format!("n{}", i % 7)).collect()),
+            ],
+        )
+        .unwrap()
+    }
+
+    fn ids(batch: &RecordBatch) -> Vec<i64> {
+        (0..batch.num_rows()).map(|r| batch.column(0).format_value(r).parse().unwrap()).collect()
+    }
+
+    #[tokio::test]
+    async fn test_hash_exchange_partitions_keys_disjointly() {
+        let inputs = vec![vec![batch(0..1000)], vec![batch(1000..2500), batch(2500..3000)]];
+        let config = ExchangeConfig { batch_rows: 128, credits_per_link: 2, ..ExchangeConfig::default() };
+        let (outputs, stats) =
+            exchange_batches(ExchangeMode::Hash { key_columns: vec![1] }, batch(0..0).schema, inputs, 3, &config)
+                .await
+                .unwrap();
+
+        assert_eq!(outputs.len(), 3);
+        assert_eq!(stats.rows_sent, 3000);
+        let mut all: Vec<i64> = outputs.iter().flat_map(ids).collect();
+        all.sort_unstable();
+        assert_eq!(all, (0..3000).collect::<Vec<_>>());
+        // 同一个键只会出现在一个接收端
+        for name in 0..7 {
+            let holders = outputs
+                .iter()
+                .filter(|o| (0..o.num_rows()).any(|r| o.column(1).format_value(r) == format!("n{}", name)))
+                .count();
+            assert_eq!(holders, 1);
+        }
+    }
+
+    #[tokio::test]
+    async fn test_broadcast_and_gather() {
+        let schema = batch(0..0).schema;
+        let (outputs, _) = exchange_batches(
+            ExchangeMode::Broadcast,
+            schema.clone(),
+            vec![vec![batch(0..10)], vec![batch(10..20)]],
+            3,
+            &ExchangeConfig::default(),
+        )
+        .await
+        .unwrap();
+        assert!(outputs.iter().all(|o| o.num_rows() == 20));
+
+        let (outputs, _) =
+            exchange_batches(ExchangeMode::Gather, schema, vec![vec![batch(0..10)], vec![batch(10..20)]], 2, &ExchangeConfig::default())
+                .await
+                .unwrap();
+        assert_eq!((outputs[0].num_rows(), outputs[1].num_rows()), (20, 0));
+    }
+
+    #[tokio::test]
+    async fn test_credits_bound_in_flight_frames() {
+        let exchange =
+            Exchange::new(ExchangeMode::Gather, batch(0..0).schema, 1, 1, &ExchangeConfig { credits_per_link: 2, batch_rows: 1, ..ExchangeConfig::default() })
+                .unwrap();
+        let metrics = exchange.metrics();
+        let (mut senders, mut receivers) = exchange.split();
+        let mut sender = senders.pop().unwrap();
+
+        let producer = tokio::spawn(async move {
+            for i in 0..5 {
+                sender.send(&batch(i..i + 1)).await.unwrap();
+            }
+            sender.finish().await.unwrap();
+        });
+        // 接收端不消费时，发送端最多发出 2 帧
+        tokio::time::sleep(std::time::Duration::from_millis(50)).await;
+        assert_eq!(metrics.snapshot().frames_sent, 2);
+
+        let received = receivers.pop().unwrap().collect().await.unwrap();
+        producer.await.unwrap();
+        assert_eq!(ids(&received), vec![0, 1, 2, 3, 4]);
+        assert!(metrics.snapshot().credit_waits > 0);
+    }
+
+    #[test]
+    fn test_frame_round_trip() {
+        let b = batch(0..5);
+        let (sender, decoded) = decode_frame(&encode_data_frame(3, &b).unwrap(), &b.schema).unwrap();
+        assert_eq!(sender, 3);
+        assert_eq!(ids(&decoded.unwrap()), vec![0, 1, 2, 3, 4]);
+        assert_eq!(decode_frame(&encode_end_frame(1), &b.schema).unwrap().0, 1);
+        assert!(decode_frame(&[9, 0, 0, 0, 0], &b.schema).is_err());
+    }
+}
@@ -1,9 +1,18 @@
 use common::Result;
-use tracing::{info, warn};
+use futures::future::BoxFuture;
+use tracing::{debug, info, warn};
 use std::sync::Arc;
+use std::time::Instant;
 
 use crate::optimizer::{OptimizedPlan, PlanNode};
+use crate::parser::{ParsedExpression, ParsedOperator};
+use crate::executor::exchange::ExchangeConfig;
 use crate::executor::operators::*;
+use crate::executor::record_batch::RecordBatch;
+use crate::executor::compiled_expr::{self, CompiledExpr};
+use crate::executor::profile::{OperatorProfile, QueryProfile};
+use crate::executor::vector_kernels::{self, VECTOR_SIZE};
+use crate::metrics;
 use crate::storage::memory::MemoryManager;
 
 /// 执行引擎
@@ -48,22 +57,55 @@ impl ExecutionEngine {
         info!("Selected execution model: {:?}", execution_model);
 
         // 3. 使用选定的执行模型执行
+        let started = Instant::now();
         let result = match execution_model {
             ExecutionModel::Volcano => {
-                self.volcano_executor.execute(plan).await?
+                self.volcano_executor.execute(plan).await
             }
             ExecutionModel::Pipeline => {
-                self.pipeline_executor.execute(plan).await?
+                self.pipeline_executor.execute(plan).await
             }
             ExecutionModel::Vectorized => {
-                self.vectorized_executor.execute(plan).await?
+                self.vectorized_executor.execute(plan).await
             }
             ExecutionModel::Mpp => {
-                self.mpp_executor.execute(plan).await?
+                self.mpp_executor.execute(plan).await
             }
         };
+        metrics::global().record_query(execution_model.label(), started.elapsed(), result.is_ok());
 
-        Ok(result)
+        result
+    }
+
+    /// 执行查询并收集运行时画像 (EXPLAIN ANALYZE)
+    ///
+    /// 向量化模型给出逐算子的画像；其他模型尚未插桩，只给出整体的输出行数和耗时。
+    pub async fn explain_analyze(&self, plan: OptimizedPlan) -> Result<(QueryResult, QueryProfile)> {
+        let query_features = self.analyze_query_features(&plan).await?;
+        let execution_model = self.model_selector.select_model(&query_features).await?;
+
+        let started = Instant::now();
+        let outcome = match execution_model {
+            ExecutionModel::Vectorized => self.vectorized_executor.execute_profiled(plan).await,
+            ref model => {
+                let result = match model {
+                    ExecutionModel::Volcano => self.volcano_executor.execute(plan).await,
+                    ExecutionModel::Pipeline => self.pipeline_executor.execute(plan).await,
+                    _ => self.mpp_executor.execute(plan).await,
+                };
+                result.map(|result| {
+                    let mut profile = OperatorProfile::new(format!("{:?}", model), "");
+                    profile.rows_out = result.rows.len() as u64;
+                    profile.wall_time = started.elapsed();
+                    (result, vec![profile])
+                })
+            }
+        };
+        let total_time = started.elapsed();
+        metrics::global().record_query(execution_model.label(), total_time, outcome.is_ok());
+
+        let (result, operators) = outcome?;
+        Ok((result, QueryProfile { model: execution_model.label(), total_time, operators }))
     }
 
     /// 分析查询特征
@@ -107,19 +149,45 @@ impl ExecutionEngine {
         let mut operations = Vec::new();
 
         for node in &plan.nodes {
-            match node {
-                PlanNode::TableScan { .. } => operations.push(OperationType::Scan),
-                PlanNode::IndexScan { .. } => operations.push(OperationType::IndexScan),
-                PlanNode::Join { .. } => operations.push(OperationType::Join),
-                PlanNode::Aggregate { .. } => operations.push(OperationType::Aggregate),
-                PlanNode::Sort { .. } => operations.push(OperationType::Sort),
-                _ => operations.push(OperationType::Other),
-            }
+            Self::collect_operations(node, &mut operations);
         }
 
         operations
     }
 
+    /// 递归收集计划树中的操作类型 (Filter/Aggregate 等节点的输入也要计入)
+    fn collect_operations(node: &PlanNode, operations: &mut Vec<OperationType>) {
+        match node {
+            PlanNode::TableScan { .. } => operations.push(OperationType::Scan),
+            PlanNode::IndexScan { .. } => operations.push(OperationType::IndexScan),
+            PlanNode::Filter { input, .. } => {
+                operations.push(OperationType::Filter);
+                Self::collect_operations(input, operations);
+            }
+            PlanNode::Project { input, .. } => {
+                operations.push(OperationType::Project);
+                Self::collect_operations(input, operations);
+            }
+            PlanNode::Join { left, right, .. } => {
+                operations.push(OperationType::Join);
+                Self::collect_operations(left, operations);
+                Self::collect_operations(right, operations);
+            }
+            PlanNode::Aggregate { input, .. } => {
+                operations.push(OperationType::Aggregate);
+                Self::collect_operations(input, operations);
+            }
+            PlanNode::Sort { input, .. } => {
+                operations.push(OperationType::Sort);
+                Self::collect_operations(input, operations);
+            }
+            PlanNode::Limit { input, .. } => {
+                operations.push(OperationType::Other);
+                Self::collect_operations(input, operations);
+            }
+        }
+    }
+
     fn analyze_parallelism(&self, plan: &OptimizedPlan) -> ParallelismRequirement {
         let node_count = plan.nodes.len();
         let has_large_operations = plan.nodes.iter().any(|node| {
@@ -152,6 +220,18 @@ pub enum ExecutionModel {
     Mpp,
 }
 
+impl ExecutionModel {
+    /// 指标中的模型标签
+    pub fn label(&self) -> &'static str {
+        match self {
+            ExecutionModel::Volcano => "volcano",
+            ExecutionModel::Pipeline => "pipeline",
+            ExecutionModel::Vectorized => "vectorized",
+            ExecutionModel::Mpp => "mpp",
+        }
+    }
+}
+
 /// 查询特征
 #[derive(Debug, Clone)]
 pub struct QueryFeatures {
@@ -174,6 +254,31 @@ impl QueryFeatures {
             parallelism_requirement: ParallelismRequirement::None,
         }
     }
+
+    /// 是否为 扫描 + 过滤/投影/聚合 形态的查询
+    ///
+    /// 这类查询没有连接和排序，数据沿一条流水线单向流动，最适合按列批量处理。
+    pub fn is_scan_filter_aggregate(&self) -> bool {
+        let has_scan = self
+            .operation_types
+            .iter()
+            .any(|op| matches!(op, OperationType::Scan | OperationType::IndexScan));
+        let has_batch_work = self
+            .operation_types
+            .iter()
+            .any(|op| matches!(op, OperationType::Filter | OperationType::Aggregate));
+        let only_streaming = self.operation_types.iter().all(|op| {
+            matches!(
+                op,
+                OperationType::Scan
+                    | OperationType::IndexScan
+                    | OperationType::Filter
+                    | OperationType::Project
+                    | OperationType::Aggregate
+            )
+        });
+        has_scan && has_batch_work && only_streaming
+    }
 }
 
 /// 查询复杂度
@@ -189,6 +294,8 @@ pub enum QueryComplexity {
 pub enum OperationType {
     Scan,
     IndexScan,
+    Filter,
+    Project,
     Join,
     Aggregate,
     Sort,
@@ -223,7 +330,18 @@ impl QueryResult {
         }
     }
 
+    /// 结果集大约占用的内存字节数
+    pub fn memory_size(&self) -> usize {
+        let row_overhead = std::mem::size_of::<Vec<String>>();
+        let cell_overhead = std::mem::size_of::<String>();
+        self.rows.iter().map(|row| row_overhead + row.iter().map(|v| cell_overhead + v.len()).sum::<usize>()).sum()
+    }
+
     pub fn merge(&mut self, other: QueryResult) {
+        // 尚无列布局时沿用对方的列
+        if self.columns.is_empty() {
+            self.columns = other.columns;
+        }
         // 合并行数据
         self.rows.extend(other.rows);
         // 更新影响的行数
@@ -245,6 +363,13 @@ impl ExecutionModelSelector {
 
     /// 根据查询特征选择最佳执行模型
     pub async fn select_model(&self, features: &QueryFeatures) -> Result<ExecutionModel> {
+        // 扫描-过滤-聚合查询默认走向量化执行，只有需要大规模并行时才交给 MPP
+        if features.is_scan_filter_aggregate()
+            && features.parallelism_requirement != ParallelismRequirement::High
+        {
+            return Ok(ExecutionModel::Vectorized);
+        }
+
         match (features.complexity.clone(), features.parallelism_requirement.clone()) {
             // 简单查询 -> 流水线执行
             (QueryComplexity::Simple, ParallelismRequirement::None) => {
@@ -522,72 +647,179 @@ impl VectorizedExecutor {
         let mut vectorized_operators = Vec::new();
 
         for node in plan.nodes {
-            let operator = match node {
-                PlanNode::TableScan { table, columns } => {
-                    VectorizedOperator::BatchScan(BatchScanOperator::new(table, columns))
-                }
-                PlanNode::IndexScan { table, index, columns } => {
-                    VectorizedOperator::BatchIndexScan(BatchIndexScanOperator::new(table, index, columns))
-                }
-                PlanNode::Join { left, right, join_type, condition: _ } => {
-                    VectorizedOperator::BatchJoin(BatchJoinOperator::new(
-                        *left,
-                        *right,
-                        format!("{:?}", join_type),
-                        "condition".to_string()
-                    ))
-                }
-                PlanNode::Aggregate { input, group_by, aggregates } => {
-                    VectorizedOperator::BatchAggregate(BatchAggregateOperator::new(
-                        *input,
-                        group_by,
-                        aggregates
-                    ))
-                }
-                PlanNode::Sort { input, order_by } => {
-                    VectorizedOperator::BatchSort(BatchSortOperator::new(*input, order_by))
-                }
-                _ => {
-                    warn!("Unsupported plan node in Vectorized model");
-                    continue;
-                }
-            };
-            vectorized_operators.push(operator);
+            match Self::build_operator(node) {
+                Some(operator) => vectorized_operators.push(operator),
+                None => warn!("Unsupported plan node in Vectorized model"),
+            }
         }
 
         Ok(VectorizedPlan { operators: vectorized_operators })
     }
 
+    /// 将计划节点递归转换为向量化算子树
+    fn build_operator(node: PlanNode) -> Option<VectorizedOperator> {
+        let operator = match node {
+            PlanNode::TableScan { table, columns } => {
+                VectorizedOperator::BatchScan(BatchScanOperator::new(table, columns))
+            }
+            PlanNode::IndexScan { table, index, columns } => {
+                VectorizedOperator::BatchIndexScan(BatchIndexScanOperator::new(table, index, columns))
+            }
+            PlanNode::Join { left, right, join_type, condition: _ } => {
+                VectorizedOperator::BatchJoin(BatchJoinOperator::new(
+                    *left,
+                    *right,
+                    format!("{:?}", join_type),
+                    "condition".to_string()
+                ))
+            }
+            PlanNode::Filter { input, predicate } => VectorizedOperator::Filter {
+                input: Box::new(Self::build_operator(*input)?),
+                predicate,
+            },
+            PlanNode::Project { input, columns } => VectorizedOperator::Project {
+                input: Box::new(Self::build_operator(*input)?),
+                columns,
+            },
+            PlanNode::Aggregate { input, group_by, aggregates } => {
+                let operator = BatchAggregateOperator::new((*input).clone(), group_by, aggregates);
+                VectorizedOperator::BatchAggregate {
+                    input: Box::new(Self::build_operator(*input)?),
+                    operator,
+                }
+            }
+            PlanNode::Sort { input, order_by } => {
+                VectorizedOperator::BatchSort(BatchSortOperator::new(*input, order_by))
+            }
+            PlanNode::Limit { input, limit, offset } => VectorizedOperator::Limit {
+                input: Box::new(Self::build_operator(*input)?),
+                limit,
+                offset,
+            },
+        };
+        Some(operator)
+    }
+
     async fn execute_vectorized_plan(&self, plan: VectorizedPlan) -> Result<QueryResult> {
+        Ok(self.execute_vectorized_profiled(plan).await?.0)
+    }
+
+    /// 执行向量化计划并返回各算子的运行时画像
+    async fn execute_vectorized_profiled(&self, plan: VectorizedPlan) -> Result<(QueryResult, Vec<OperatorProfile>)> {
         let mut result = QueryResult::new();
+        let mut profiles = Vec::with_capacity(plan.operators.len());
+
+        // 向量化执行：算子之间以定长列式向量交换数据，只在最外层转换为行格式
+        for operator in &plan.operators {
+            let mut profile = operator.profile();
+            let batches = self.execute_operator(operator, &mut profile).await?;
+            profiles.push(profile);
+            for batch in batches {
+                result = self.merge_batch_results(result, batch.into_query_result()).await?;
+            }
+        }
 
-        // 向量化执行：批量处理数据，利用 SIMD 优化
-        for operator in plan.operators {
-            match operator {
-                VectorizedOperator::BatchScan(batch_scan_op) => {
-                    let batch_result = batch_scan_op.execute_batch().await?;
-                    result = self.merge_batch_results(result, batch_result).await?;
-                }
+        Ok((result, profiles))
+    }
+
+    /// 执行计划并返回画像，供 EXPLAIN ANALYZE 使用
+    pub async fn execute_profiled(&self, plan: OptimizedPlan) -> Result<(QueryResult, Vec<OperatorProfile>)> {
+        let vectorized_plan = self.build_vectorized_plan(plan).await?;
+        self.execute_vectorized_profiled(vectorized_plan).await
+    }
+
+    /// 执行子算子，把其画像挂到父算子下
+    async fn execute_child(&self, input: &VectorizedOperator, parent: &mut OperatorProfile) -> Result<Vec<RecordBatch>> {
+        let mut child = input.profile();
+        let batches = self.execute_operator(input, &mut child).await?;
+        parent.add_child(child);
+        Ok(batches)
+    }
+
+    /// 执行一个向量化算子，返回其输出的全部向量
+    fn execute_operator<'a>(
+        &'a self,
+        operator: &'a VectorizedOperator,
+        profile: &'a mut OperatorProfile,
+    ) -> BoxFuture<'a, Result<Vec<RecordBatch>>> {
+        Box::pin(async move {
+            let started = Instant::now();
+            let output = match operator {
+                VectorizedOperator::BatchScan(batch_scan_op) => batch_scan_op.scan_batches(VECTOR_SIZE).await?,
+                // 以下算子尚未列式化，先把行格式结果切分为向量
                 VectorizedOperator::BatchIndexScan(batch_index_scan_op) => {
-                    let batch_result = batch_index_scan_op.execute_batch().await?;
-                    result = self.merge_batch_results(result, batch_result).await?;
+                    let rows = batch_index_scan_op.execute_batch().await?;
+                    profile.cpu(|| Self::to_vectors(rows))?
                 }
                 VectorizedOperator::BatchJoin(batch_join_op) => {
-                    let batch_result = batch_join_op.execute_batch().await?;
-                    result = self.merge_batch_results(result, batch_result).await?;
-                }
-                VectorizedOperator::BatchAggregate(batch_agg_op) => {
-                    let batch_result = batch_agg_op.execute_batch().await?;
-                    result = self.merge_batch_results(result, batch_result).await?;
+                    let rows = batch_join_op.execute_batch().await?;
+                    profile.cpu(|| Self::to_vectors(rows))?
                 }
                 VectorizedOperator::BatchSort(batch_sort_op) => {
-                    let batch_result = batch_sort_op.execute_batch().await?;
-                    result = self.merge_batch_results(result, batch_result).await?;
+                    let rows = batch_sort_op.execute_batch().await?;
+                    profile.cpu(|| Self::to_vectors(rows))?
                 }
+                VectorizedOperator::Filter { input, predicate } => {
+                    let batches = self.execute_child(input, profile).await?;
+                    profile.cpu(|| -> Result<Vec<RecordBatch>> {
+                        let Some(first) = batches.first() else { return Ok(batches) };
+                        // 谓词按输入模式编译一次，各向量共用
+                        let predicate = CompiledExpr::compile(predicate, &first.schema)?;
+                        batches.into_iter().map(|batch| predicate.filter(batch)).collect()
+                    })?
+                }
+                VectorizedOperator::Project { input, columns } => {
+                    let batches = self.execute_child(input, profile).await?;
+                    profile.cpu(|| -> Result<Vec<RecordBatch>> {
+                        if columns.is_empty() || columns.iter().any(|c| c == "*") {
+                            return Ok(batches);
+                        }
+                        let Some(first) = batches.first() else { return Ok(batches) };
+                        let indices = columns
+                            .iter()
+                            .map(|c| compiled_expr::bind_column(&first.schema, c))
+                            .collect::<Result<Vec<_>>>()?;
+                        Ok(batches.iter().map(|batch| batch.project(&indices)).collect())
+                    })?
+                }
+                VectorizedOperator::BatchAggregate { input, operator } => {
+                    let batches = self.execute_child(input, profile).await?;
+                    debug!("Vectorized aggregate over {} batches", batches.len());
+                    profile.cpu(|| operator.aggregate_batches(&batches).map(|batch| vec![batch]))?
+                }
+                VectorizedOperator::Limit { input, limit, offset } => {
+                    let batches = self.execute_child(input, profile).await?;
+                    profile.cpu(|| Self::apply_limit(batches, *limit as usize, *offset as usize))
+                }
+            };
+            profile.finish(&output, started.elapsed());
+            Ok(output)
+        })
+    }
+
+    fn to_vectors(result: QueryResult) -> Result<Vec<RecordBatch>> {
+        let batch = RecordBatch::from_query_result(&result)?;
+        Ok(vector_kernels::split_batch(&batch, VECTOR_SIZE))
+    }
+
+    /// 通过裁剪选择向量实现 LIMIT/OFFSET，不搬移数据
+    fn apply_limit(batches: Vec<RecordBatch>, limit: usize, offset: usize) -> Vec<RecordBatch> {
+        let mut skip = offset;
+        let mut remaining = limit;
+        let mut output = Vec::new();
+        for batch in batches {
+            if remaining == 0 {
+                break;
             }
+            let rows = batch.row_indices();
+            let start = skip.min(rows.len());
+            skip -= start;
+            let end = (start + remaining).min(rows.len());
+            remaining -= end - start;
+            let selection = rows[start..end].iter().map(|&i| i as u32).collect();
+            output.push(batch.with_selection(selection));
         }
-
-        Ok(result)
+        output
     }
 
     async fn merge_batch_results(&self, mut result: QueryResult, new_result: QueryResult) -> Result<QueryResult> {
@@ -602,14 +834,27 @@ impl VectorizedExecutor {
 }
 
 /// MPP 执行器
+///
+/// `num_nodes` 大于 1 时，连接和聚合任务的输入由各节点本地扫描产生，经 Exchange
+/// 按键哈希重分区 (或广播小表) 后在各节点上并行计算，协调节点只汇总结果。
 pub struct MppExecutor {
-    #[allow(dead_code)]
     memory_manager: Arc<MemoryManager>,
+    /// 参与执行的节点数
+    num_nodes: usize,
+    exchange_config: ExchangeConfig,
 }
 
 impl MppExecutor {
     pub fn new(memory_manager: Arc<MemoryManager>) -> Self {
-        Self { memory_manager }
+        Self::with_nodes(memory_manager, 1, ExchangeConfig::default())
+    }
+
+    pub fn with_nodes(memory_manager: Arc<MemoryManager>, num_nodes: usize, exchange_config: ExchangeConfig) -> Self {
+        Self {
+            memory_manager,
+            num_nodes: num_nodes.max(1),
+            exchange_config,
+        }
     }
 
     pub async fn execute(&self, plan: OptimizedPlan) -> Result<QueryResult> {
@@ -636,14 +881,17 @@ impl MppExecutor {
                 PlanNode::IndexScan { table, index, columns } => {
                     MppTask::ParallelIndexScan(ParallelIndexScanTask::new(i.to_string(), table, index, columns))
                 }
-                PlanNode::Join { left, right, join_type, condition: _ } => {
-                    MppTask::ParallelJoin(ParallelJoinTask::new(
+                PlanNode::Join { left, right, join_type, condition } => {
+                    let mut task = ParallelJoinTask::new(
                         i.to_string(),
                         *left,
                         *right,
                         format!("{:?}", join_type),
                         "condition".to_string()
-                    ))
+                    );
+                    let (left_keys, right_keys) = equi_join_keys(condition.as_ref());
+                    task.set_join_keys(left_keys, right_keys);
+                    MppTask::ParallelJoin(task)
                 }
                 PlanNode::Aggregate { input, group_by, aggregates } => {
                     MppTask::ParallelAggregate(ParallelAggregateTask::new(
@@ -684,11 +932,23 @@ impl MppExecutor {
                     task_results.push(task_result);
                 }
                 MppTask::ParallelJoin(parallel_join_task) => {
-                    let task_result = parallel_join_task.execute_parallel().await?;
+                    let task_result = match self.join_fragments(&parallel_join_task).await? {
+                        Some((left, right)) => parallel_join_task
+                            .execute_exchange(left, right, self.num_nodes, &self.exchange_config, &self.memory_manager)
+                            .await?
+                            .into_query_result(),
+                        None => parallel_join_task.execute_parallel().await?,
+                    };
                     task_results.push(task_result);
                 }
                 MppTask::ParallelAggregate(parallel_agg_task) => {
-                    let task_result = parallel_agg_task.execute_parallel().await?;
+                    let task_result = match self.scan_fragments(&parallel_agg_task.input).await? {
+                        Some(fragments) if self.num_nodes > 1 => parallel_agg_task
+                            .execute_exchange(fragments, self.num_nodes, &self.exchange_config, &self.memory_manager)
+                            .await?
+                            .into_query_result(),
+                        _ => parallel_agg_task.execute_parallel().await?,
+                    };
                     task_results.push(task_result);
                 }
                 MppTask::ParallelSort(parallel_sort_task) => {
@@ -706,6 +966,37 @@ impl MppExecutor {
         Ok(result)
     }
 
+    /// 连接两侧都是表扫描且有等值键时，返回两侧各节点的本地扫描输出
+    async fn join_fragments(&self, task: &ParallelJoinTask) -> Result<Option<(Vec<RecordBatch>, Vec<RecordBatch>)>> {
+        if self.num_nodes <= 1 || task.left_keys.is_empty() {
+            return Ok(None);
+        }
+        match (self.scan_fragments(&task.left).await?, self.scan_fragments(&task.right).await?) {
+            (Some(left), Some(right)) => Ok(Some((left, right))),
+            _ => Ok(None),
+        }
+    }
+
+    /// 每个节点扫描表中互不相交的一个分片，返回各节点的输出；输入不是表扫描时返回 None
+    ///
+    /// 表扫描一次，第 i 行归节点 `i % num_nodes`，各分片合起来恰好是整张表。
+    async fn scan_fragments(&self, input: &PlanNode) -> Result<Option<Vec<RecordBatch>>> {
+        let (table, columns) = match input {
+            PlanNode::TableScan { table, columns } => (table, columns),
+            _ => return Ok(None),
+        };
+        let task = ParallelScanTask::new("0".to_string(), table.clone(), columns.clone());
+        let scanned = RecordBatch::from_query_result(&task.execute_parallel().await?)?;
+        let rows = scanned.row_indices();
+        let fragments = (0..self.num_nodes)
+            .map(|node| {
+                let shard: Vec<usize> = rows.iter().copied().skip(node).step_by(self.num_nodes).collect();
+                scanned.take(&shard)
+            })
+            .collect();
+        Ok(Some(fragments))
+    }
+
     async fn merge_mpp_results(&self, mut result: QueryResult, new_result: QueryResult) -> Result<QueryResult> {
         // 合并 MPP 并行处理结果
         if result.columns.is_empty() {
@@ -717,6 +1008,31 @@ impl MppExecutor {
     }
 }
 
+/// 从连接条件中提取等值连接键 (AND 连接的 `a = b`)，列名去掉表限定符
+fn equi_join_keys(condition: Option<&ParsedExpression>) -> (Vec<String>, Vec<String>) {
+    fn collect(expr: &ParsedExpression, left: &mut Vec<String>, right: &mut Vec<String>) {
+        match expr {
+            ParsedExpression::BinaryOp { left: l, operator: ParsedOperator::And, right: r } => {
+                collect(l, left, right);
+                collect(r, left, right);
+            }
+            ParsedExpression::BinaryOp { left: l, operator: ParsedOperator::Equal, right: r } => {
+                if let (ParsedExpression::Column(a), ParsedExpression::Column(b)) = (l.as_ref(), r.as_ref()) {
+                    let unqualified = |name: &str| name.rsplit('.').next().unwrap_or(name).to_string();
+                    left.push(unqualified(a));
+                    right.push(unqualified(b));
+                }
+            }
+            _ => {}
+        }
+    }
+    let (mut left, mut right) = (Vec::new(), Vec::new());
+    if let Some(condition) = condition {
+        collect(condition, &mut left, &mut right);
+    }
+    (left, right)
+}
+
 // 火山模型相关类型
 #[derive(Debug)]
 pub struct VolcanoPlan {
@@ -758,8 +1074,47 @@ pub enum VectorizedOperator {
     BatchScan(BatchScanOperator),
     BatchIndexScan(BatchIndexScanOperator),
     BatchJoin(BatchJoinOperator),
-    BatchAggregate(BatchAggregateOperator),
+    BatchAggregate {
+        input: Box<VectorizedOperator>,
+        operator: BatchAggregateOperator,
+    },
     BatchSort(BatchSortOperator),
+    Filter {
+        input: Box<VectorizedOperator>,
+        predicate: ParsedExpression,
+    },
+    Project {
+        input: Box<VectorizedOperator>,
+        columns: Vec<String>,
+    },
+    Limit {
+        input: Box<VectorizedOperator>,
+        limit: u64,
+        offset: u64,
+    },
+}
+
+impl VectorizedOperator {
+    /// 该算子的空画像 (算子名与参数)
+    fn profile(&self) -> OperatorProfile {
+        match self {
+            VectorizedOperator::BatchScan(op) => OperatorProfile::new("BatchScan", op.table.clone()),
+            VectorizedOperator::BatchIndexScan(op) => {
+                OperatorProfile::new("BatchIndexScan", format!("{} using {}", op.table, op.index))
+            }
+            VectorizedOperator::BatchJoin(op) => OperatorProfile::new("BatchJoin", op.join_type.clone()),
+            VectorizedOperator::BatchAggregate { operator, .. } => OperatorProfile::new(
+                "BatchAggregate",
+                format!("group by [{}] {}", operator.group_by.join(", "), operator.aggregates.join(", ")),
+            ),
+            VectorizedOperator::BatchSort(op) => OperatorProfile::new("BatchSort", op.order_by.join(", ")),
+            VectorizedOperator::Filter { predicate, .. } => OperatorProfile::new("Filter", predicate.to_string()),
+            VectorizedOperator::Project { columns, .. } => OperatorProfile::new("Project", columns.join(", ")),
+            VectorizedOperator::Limit { limit, offset, .. } => {
+                OperatorProfile::new("Limit", format!("limit {} offset {}", limit, offset))
+            }
+        }
+    }
 }
 
 // MPP 模型相关类型
@@ -775,4 +1130,163 @@ pub enum MppTask {
     ParallelJoin(ParallelJoinTask),
     ParallelAggregate(ParallelAggregateTask),
     ParallelSort(ParallelSortTask),
-}
\ No newline at end of file
+}
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::parser::{ParsedOperator, ParsedValue};
+
+    fn scan_filter_aggregate_plan(group_by: Vec<String>) -> OptimizedPlan {
+        let scan = PlanNode::TableScan {
+            table: "users".to_string(),
+            columns: vec!["*".to_string()],
+        };
+        let filter = PlanNode::Filter {
+            input: Box::new(scan),
+            predicate: ParsedExpression::BinaryOp {
+                left: Box::new(ParsedExpression::Column("value".to_string())),
+                operator: ParsedOperator::GreaterThan,
+                right: Box::new(ParsedExpression::Literal(ParsedValue::Number("100".to_string()))),
+            },
+        };
+        OptimizedPlan {
+            nodes: vec![PlanNode::Aggregate {
+                input: Box::new(filter),
+                group_by,
+                aggregates: vec!["count".to_string(), "sum(value)".to_string()],
+            }],
+            estimated_cost: 1.0,
+            estimated_rows: 3,
+        }
+    }
+
+    #[tokio::test]
+    async fn test_scan_filter_aggregate_selects_vectorized() {
+        let engine = ExecutionEngine::new();
+        let features = engine.analyze_query_features(&scan_filter_aggregate_plan(Vec::new())).await.unwrap();
+        assert!(features.operation_types.contains(&OperationType::Filter));
+        let model = ExecutionModelSelector::new().select_model(&features).await.unwrap();
+        assert_eq!(model, ExecutionModel::Vectorized);
+
+        // 含连接的查询不走向量化默认路径
+        let mut features = features;
+        features.operation_types.push(OperationType::Join);
+        let model = ExecutionModelSelector::new().select_model(&features).await.unwrap();
+        assert_ne!(model, ExecutionModel::Vectorized);
+    }
+
+    #[tokio::test]
+    async fn test_vectorized_executor_filters_and_aggregates() {
+        let executor = VectorizedExecutor::new(Arc::new(MemoryManager::new()));
+
+        // 模拟表 value 为 100/200/300，过滤后剩 200 与 300
+        let result = executor.execute(scan_filter_aggregate_plan(Vec::new())).await.unwrap();
+        assert_eq!(result.columns, vec!["count", "sum(value)"]);
+        assert_eq!(result.rows, vec![vec!["2".to_string(), "500".to_string()]]);
+
+        let result = executor.execute(scan_filter_aggregate_plan(vec!["name".to_string()])).await.unwrap();
+        assert_eq!(result.columns, vec!["name", "count", "sum(value)"]);
+        assert_eq!(result.rows.len(), 2);
+        assert_eq!(result.rows[0], vec!["Bob".to_string(), "1".to_string(), "200".to_string()]);
+    }
+
+    #[tokio::test]
+    async fn test_explain_analyze_profiles_each_operator() {
+        let engine = ExecutionEngine::new();
+        let before = metrics::global().query_latency("vectorized").count;
+        let (result, profile) = engine.explain_analyze(scan_filter_aggregate_plan(Vec::new())).await.unwrap();
+        assert_eq!(result.rows, vec![vec!["2".to_string(), "500".to_string()]]);
+        assert_eq!(profile.model, "vectorized");
+        assert!(metrics::global().query_latency("vectorized").count > before);
+
+        // Aggregate <- Filter <- Scan：每层的输入行数等于子算子的输出行数
+        let aggregate = &profile.operators[0];
+        assert_eq!((aggregate.name.as_str(), aggregate.rows_in, aggregate.rows_out), ("BatchAggregate", 2, 1));
+        let filter = &aggregate.children[0];
+        assert_eq!((filter.name.as_str(), filter.rows_in, filter.rows_out), ("Filter", 3, 2));
+        assert_eq!(filter.children[0].name, "BatchScan");
+        assert!(aggregate.wall_time >= filter.wall_time);
+
+        let lines = profile.render();
+        assert_eq!(lines.len(), 4);
+        assert!(lines[1].starts_with("-> Filter"));
+        assert!(lines[2].starts_with("  -> BatchScan"));
+        assert!(lines[3].starts_with("Execution: model=vectorized"));
+    }
+
+    #[tokio::test]
+    async fn test_vectorized_aggregate_spans_multiple_vectors() {
+        let mut scan = BatchScanOperator::new("t".to_string(), vec!["*".to_string()]);
+        scan.set_row_count(VECTOR_SIZE * 2 + 10);
+        let batches = scan.scan_batches(VECTOR_SIZE).await.unwrap();
+        assert_eq!(batches.len(), 3);
+
+        let aggregate = BatchAggregateOperator::new(
+            PlanNode::TableScan { table: "t".to_string(), columns: Vec::new() },
+            vec!["name".to_string()],
+            vec!["count".to_string(), "max(id)".to_string()],
+        );
+        let result = aggregate.aggregate_batches(&batches).unwrap();
+        assert_eq!(result.num_rows(), 3);
+        let counts = result.column_by_name("count").unwrap();
+        let total: i64 = (0..3).map(|i| match counts.value(i) { common::Value::BigInt(c) => c, _ => 0 }).sum();
+        assert_eq!(total, (VECTOR_SIZE * 2 + 10) as i64);
+    }
+
+    fn mpp_executor(nodes: usize, broadcast_threshold_rows: usize) -> MppExecutor {
+        let config = ExchangeConfig { broadcast_threshold_rows, ..ExchangeConfig::default() };
+        MppExecutor::with_nodes(Arc::new(MemoryManager::new()), nodes, config)
+    }
+
+    fn scan(table: &str) -> PlanNode {
+        PlanNode::TableScan { table: table.to_string(), columns: vec!["*".to_string()] }
+    }
+
+    #[tokio::test]
+    async fn test_mpp_aggregate_repartitions_groups_across_nodes() {
+        // 表中为 (1, Alice, 100), (2, Bob, 200)，分散到 3 个节点后结果与单节点相同
+        let plan = OptimizedPlan {
+            nodes: vec![PlanNode::Aggregate {
+                input: Box::new(scan("users")),
+                group_by: vec!["name".to_string()],
+                aggregates: vec!["count".to_string(), "sum(value)".to_string()],
+            }],
+            estimated_cost: 1.0,
+            estimated_rows: 2,
+        };
+        let mut result = mpp_executor(3, 0).execute(plan).await.unwrap();
+        result.rows.sort();
+        assert_eq!(result.columns, vec!["name", "count", "sum(value)"]);
+        assert_eq!(
+            result.rows,
+            vec![
+                vec!["Alice".to_string(), "1".to_string(), "100".to_string()],
+                vec!["Bob".to_string(), "1".to_string(), "200".to_string()],
+            ]
+        );
+    }
+
+    #[tokio::test]
+    async fn test_mpp_join_uses_hash_or_broadcast_exchange() {
+        let plan = || OptimizedPlan {
+            nodes: vec![PlanNode::Join {
+                left: Box::new(scan("a")),
+                right: Box::new(scan("b")),
+                join_type: crate::optimizer::optimizer::JoinType::Inner,
+                condition: Some(ParsedExpression::BinaryOp {
+                    left: Box::new(ParsedExpression::Column("a.id".to_string())),
+                    operator: ParsedOperator::Equal,
+                    right: Box::new(ParsedExpression::Column("b.id".to_string())),
+                }),
+            }],
+            estimated_cost: 1.0,
+            estimated_rows: 2,
+        };
+        // 两侧的表都只有 id 1、2 两行，分散到 3 个节点后仍是每个 id 一行连接结果
+        for threshold in [0, usize::MAX] {
+            let result = mpp_executor(3, threshold).execute(plan()).await.unwrap();
+            assert_eq!(result.rows.len(), 2);
+            assert!(result.rows.iter().all(|r| r[0] == r[3]));
+        }
+    }
+}
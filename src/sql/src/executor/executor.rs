@@ -1,7 +1,7 @@
 use common::Result;
 use tracing::{debug, info};
-use std::collections::HashMap;
-use std::sync::{Arc, Mutex, RwLock};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, Mutex};
 use std::time::{Duration, Instant};
 use std::thread;
 use async_trait::async_trait;
@@ -9,8 +9,14 @@ use async_trait::async_trait;
 use crate::optimizer::{OptimizedPlan, PlanNode};
 use crate::storage::buffer_pool::{BufferPool, PageId};
 use crate::storage::cache_manager::CacheManager;
+pub use crate::storage::memory::{MemoryManager, MemoryStats};
+use crate::storage::memory::{MemoryBudget, QueryMemoryContext};
 use crate::storage::worker_pool::WorkerPool;
 use crate::executor::parallel_executor::{ParallelQueryExecutor, ParallelExecutorConfig};
+use crate::executor::storage_executor::StorageExecutor;
+use crate::executor::execution_models::QueryResult as ModelQueryResult;
+use crate::executor::profile::QueryProfile;
+use crate::metrics::{write_counter, write_gauge, MetricsSource};
 
 /// PostgreSQL 风格的 SQL 执行器
 pub struct Executor {
@@ -30,6 +36,8 @@ pub struct Executor {
     execution_stats: Arc<Mutex<ExecutionStats>>,
     /// 工作线程池
     worker_pool: Arc<WorkerPool>,
+    /// 下一个查询的编号，用于命名查询内存上下文
+    next_query_id: AtomicU64,
 }
 
 impl Default for Executor {
@@ -58,6 +66,7 @@ impl Executor {
             operator_factory,
             execution_stats,
             worker_pool,
+            next_query_id: AtomicU64::new(1),
         }
     }
 
@@ -65,21 +74,18 @@ impl Executor {
     pub async fn execute(&self, plan: OptimizedPlan) -> Result<QueryResult> {
         info!("Executing optimized query plan with {} nodes", plan.nodes.len());
 
-        let mut stats = self.execution_stats.lock().unwrap();
+        // 统计在本地累计，结束后再写回，执行期间 (含 await) 不持有锁
+        let mut stats = ExecutionStats::new();
         stats.start_execution();
 
-        // 创建执行上下文
-        let context = ExecutionContext {
-            buffer_pool: self.buffer_pool.clone(),
-            cache_manager: self.cache_manager.clone(),
-            memory_manager: self.memory_manager.clone(),
-            parallel_executor: self.parallel_executor.clone(),
-            operator_factory: self.operator_factory.clone(),
-            worker_pool: self.worker_pool.clone(),
-        };
+        // 创建执行上下文，查询期间的工作内存计入本查询的内存上下文
+        let context = self.query_context();
 
         // 使用并行查询执行器执行查询
-        let parallel_result = self.parallel_query_executor.execute_parallel(plan, &context).await?;
+        let outcome = self.parallel_query_executor.execute_parallel(plan, &context).await;
+        stats.end_execution();
+        crate::metrics::global().record_query("parallel", stats.execution_time(), outcome.is_ok());
+        let parallel_result = outcome?;
 
         // 转换为执行器期望的 QueryResult 类型
         let result = QueryResult {
@@ -89,12 +95,72 @@ impl Executor {
             last_insert_id: parallel_result.last_insert_id,
         };
 
-        stats.end_execution();
+        if let Some(query_memory) = &context.query_memory {
+            debug!("Query {} peak work memory: {} bytes", query_memory.query_id(), query_memory.peak());
+        }
         debug!("Query execution completed in {:?}", stats.execution_time());
+        *self.execution_stats.lock().unwrap() = stats;
 
         Ok(result)
     }
 
+    /// 执行计划并收集运行时画像 (EXPLAIN ANALYZE)
+    ///
+    /// 与 `execute` 使用同一个并行查询执行器、存储与查询内存上下文。
+    pub async fn explain_analyze(&self, plan: OptimizedPlan) -> Result<(ModelQueryResult, QueryProfile)> {
+        let context = self.query_context();
+        let started = Instant::now();
+        let outcome = self.parallel_query_executor.execute_profiled(plan, &context).await;
+        let total_time = started.elapsed();
+        crate::metrics::global().record_query("parallel", total_time, outcome.is_ok());
+        let (result, operators) = outcome?;
+        Ok((result, QueryProfile { model: "parallel", total_time, operators }))
+    }
+
+    /// 执行器各组件的统计 (并行执行、工作线程池、工作内存、缓冲池)，供 `/metrics` 导出
+    pub fn metrics_source(&self) -> Arc<dyn MetricsSource> {
+        Arc::new(ExecutorMetrics {
+            parallel_query_executor: self.parallel_query_executor.clone(),
+            memory_manager: self.memory_manager.clone(),
+            buffer_pool: self.buffer_pool.clone(),
+        })
+    }
+
+    /// 设置扫描所用的存储感知执行器，计划中的扫描流水线据此按 morsel 读取存储
+    pub fn set_storage_executor(&self, storage_executor: Arc<StorageExecutor>) {
+        self.parallel_query_executor.set_storage_executor(storage_executor);
+    }
+
+    /// 共享的缓存管理器
+    pub fn cache_manager(&self) -> Arc<CacheManager> {
+        self.cache_manager.clone()
+    }
+
+    /// 共享执行器资源的执行上下文
+    pub fn execution_context(&self) -> ExecutionContext {
+        ExecutionContext {
+            buffer_pool: self.buffer_pool.clone(),
+            cache_manager: self.cache_manager.clone(),
+            memory_manager: self.memory_manager.clone(),
+            parallel_executor: self.parallel_executor.clone(),
+            operator_factory: self.operator_factory.clone(),
+            worker_pool: self.worker_pool.clone(),
+            query_memory: None,
+        }
+    }
+
+    /// 为一个新查询创建执行上下文，附带独立的查询内存上下文
+    ///
+    /// 查询内的排序、TopN 等算子从 `ExecutionContext::memory_budget` 申请额度；上下文的
+    /// 最后一个引用释放 (查询结束或结果流被丢弃) 时未归还的额度一次性还给全局预算。
+    pub fn query_context(&self) -> ExecutionContext {
+        let query_id = self.next_query_id.fetch_add(1, Ordering::Relaxed);
+        let query_memory = self
+            .memory_manager
+            .query_context(format!("query-{}", query_id), self.memory_manager.work_memory_limit());
+        ExecutionContext { query_memory: Some(query_memory), ..self.execution_context() }
+    }
+
     /// 构建执行计划
     async fn build_execution_plan(
         &self,
@@ -162,6 +228,40 @@ impl Executor {
     }
 }
 
+/// `Executor::metrics_source` 导出的组件统计
+struct ExecutorMetrics {
+    parallel_query_executor: Arc<ParallelQueryExecutor>,
+    memory_manager: Arc<MemoryManager>,
+    buffer_pool: Arc<BufferPool>,
+}
+
+impl MetricsSource for ExecutorMetrics {
+    fn write_prometheus(&self, out: &mut String) {
+        let parallel = self.parallel_query_executor.get_stats();
+        write_counter(out, "sealdb_executor_queries_total", "Queries run by the parallel query executor.", parallel.total_queries);
+        write_counter(out, "sealdb_executor_queries_failed_total", "Failed parallel queries.", parallel.queries_failed);
+        write_counter(out, "sealdb_executor_queries_timed_out_total", "Timed out parallel queries.", parallel.queries_timed_out);
+        write_gauge(out, "sealdb_executor_parallelism", "Current degree of parallelism.", parallel.current_parallelism as f64);
+
+        let workers = self.parallel_query_executor.get_worker_pool_stats();
+        write_counter(out, "sealdb_worker_tasks_submitted_total", "Tasks submitted to the worker pool.", workers.tasks_submitted);
+        write_counter(out, "sealdb_worker_tasks_completed_total", "Tasks completed by the worker pool.", workers.tasks_completed);
+        write_gauge(out, "sealdb_worker_active", "Busy worker threads.", workers.active_workers as f64);
+        write_gauge(out, "sealdb_worker_idle", "Idle worker threads.", workers.idle_workers as f64);
+
+        let memory = self.memory_manager.get_stats();
+        write_gauge(out, "sealdb_work_memory_bytes", "Reserved work memory.", memory.work_memory_allocated as f64);
+        write_gauge(out, "sealdb_work_memory_limit_bytes", "Work memory budget.", memory.work_memory_limit as f64);
+        write_counter(out, "sealdb_memory_pool_hits_total", "Work memory buffers reused from the size-class pool.", memory.pool_hits);
+        write_counter(out, "sealdb_memory_pool_misses_total", "Work memory buffers allocated outside the pool.", memory.pool_misses);
+
+        let buffer = self.buffer_pool.get_stats();
+        write_counter(out, "sealdb_buffer_pool_hits_total", "Buffer pool page hits.", buffer.hit_count);
+        write_counter(out, "sealdb_buffer_pool_misses_total", "Buffer pool page misses.", buffer.miss_count);
+        write_counter(out, "sealdb_buffer_pool_evictions_total", "Buffer pool page evictions.", buffer.eviction_count);
+    }
+}
+
 /// 执行上下文
 #[derive(Clone)]
 pub struct ExecutionContext {
@@ -171,6 +271,18 @@ pub struct ExecutionContext {
     pub parallel_executor: Arc<ParallelExecutor>,
     pub operator_factory: Arc<OperatorFactory>,
     pub worker_pool: Arc<WorkerPool>,
+    /// 当前查询的内存上下文，为空时直接使用全局工作内存预算
+    pub query_memory: Option<Arc<QueryMemoryContext>>,
+}
+
+impl ExecutionContext {
+    /// 算子申请工作内存所用的预算：有查询内存上下文时计入查询，否则计入全局
+    pub fn memory_budget(&self) -> Arc<dyn MemoryBudget> {
+        match &self.query_memory {
+            Some(query_memory) => query_memory.clone(),
+            None => self.memory_manager.clone(),
+        }
+    }
 }
 
 impl Default for ExecutionContext {
@@ -182,6 +294,7 @@ impl Default for ExecutionContext {
             parallel_executor: Arc::new(ParallelExecutor::new()),
             operator_factory: Arc::new(OperatorFactory::new()),
             worker_pool: Arc::new(WorkerPool::new()),
+            query_memory: None,
         }
     }
 }
@@ -486,93 +599,6 @@ impl Operator for LimitOperator {
     }
 }
 
-/// PostgreSQL 风格的内存管理器
-#[derive(Debug)]
-pub struct MemoryManager {
-    /// 工作内存 (默认 4MB)
-    work_memory: usize,
-    /// 共享内存 (默认 128MB)
-    shared_memory: usize,
-    /// 内存池
-    #[allow(dead_code)]
-    memory_pool: RwLock<HashMap<String, Vec<u8>>>,
-    /// 内存使用统计
-    stats: Mutex<MemoryStats>,
-}
-
-impl MemoryManager {
-    pub fn new() -> Self {
-        Self {
-            work_memory: 4 * 1024 * 1024, // 4MB
-            shared_memory: 128 * 1024 * 1024, // 128MB
-            memory_pool: RwLock::new(HashMap::new()),
-            stats: Mutex::new(MemoryStats::new()),
-        }
-    }
-
-    /// 分配工作内存
-    pub fn allocate_work_memory(&self, size: usize) -> Result<Vec<u8>> {
-        let mut stats = self.stats.lock().unwrap();
-
-        if size > self.work_memory {
-            return Err(common::Error::Storage("Insufficient work memory".to_string()));
-        }
-
-        stats.work_memory_allocated += size;
-        stats.total_allocations += 1;
-
-        Ok(vec![0; size])
-    }
-
-    /// 分配共享内存
-    pub fn allocate_shared_memory(&self, size: usize) -> Result<Vec<u8>> {
-        let mut stats = self.stats.lock().unwrap();
-
-        if size > self.shared_memory {
-            return Err(common::Error::Storage("Insufficient shared memory".to_string()));
-        }
-
-        stats.shared_memory_allocated += size;
-        stats.total_allocations += 1;
-
-        Ok(vec![0; size])
-    }
-
-    /// 释放内存
-    pub fn free_memory(&self, data: Vec<u8>) {
-        let mut stats = self.stats.lock().unwrap();
-        stats.total_frees += 1;
-        stats.total_freed_bytes += data.len();
-    }
-
-    /// 获取内存统计
-    pub fn get_stats(&self) -> MemoryStats {
-        self.stats.lock().unwrap().clone()
-    }
-}
-
-/// 内存统计
-#[derive(Debug, Clone)]
-pub struct MemoryStats {
-    pub work_memory_allocated: usize,
-    pub shared_memory_allocated: usize,
-    pub total_allocations: u64,
-    pub total_frees: u64,
-    pub total_freed_bytes: usize,
-}
-
-impl MemoryStats {
-    pub fn new() -> Self {
-        Self {
-            work_memory_allocated: 0,
-            shared_memory_allocated: 0,
-            total_allocations: 0,
-            total_frees: 0,
-            total_freed_bytes: 0,
-        }
-    }
-}
-
 /// 并行执行器
 #[derive(Debug)]
 pub struct ParallelExecutor {
@@ -756,6 +782,27 @@ mod tests {
         assert_eq!(stats.total_allocations, 1);
     }
 
+    #[test]
+    fn test_each_query_gets_its_own_memory_context() {
+        let executor = Executor::new();
+        let first = executor.query_context();
+        let second = executor.query_context();
+        let (first_memory, second_memory) = (first.query_memory.clone().unwrap(), second.query_memory.clone().unwrap());
+        assert_ne!(first_memory.query_id(), second_memory.query_id());
+
+        // 额度计入各自的查询，上下文释放后全部还给全局预算
+        first.memory_budget().reserve_work_memory(1000).unwrap();
+        second.memory_budget().reserve_work_memory(300).unwrap();
+        assert_eq!((first_memory.used(), second_memory.used()), (1000, 300));
+        assert_eq!(executor.memory_manager.get_stats().work_memory_allocated, 1300);
+
+        drop((first, first_memory));
+        assert_eq!(executor.memory_manager.get_stats().work_memory_allocated, 300);
+        drop((second, second_memory));
+        assert_eq!(executor.memory_manager.get_stats().work_memory_allocated, 0);
+        assert!(executor.execution_context().query_memory.is_none());
+    }
+
     #[test]
     fn test_parallel_executor() {
         let parallel_executor = ParallelExecutor::new();
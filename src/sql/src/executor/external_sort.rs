@@ -0,0 +1,496 @@
+//! 外部归并排序
+//!
+//! 输入按工作内存预算攒成一段 (run)：段内用归一化排序键做稳定排序后，连同键一起
+//! 写成二进制落盘文件 (`executor::spill` 格式，键作为附加的 BINARY 列)。全部输入
+//! 结束后用败者树做 k 路归并；每个段由后台阻塞线程预读下一帧并通过有界通道交给
+//! 归并循环，归并时只比较键的字节序。段数超过归并扇入时先做多轮中间归并，
+//! 因此任意大小的排序只需要 `扇入 × 帧大小` 级别的内存。
+
+use common::{DataType, Error, Result, Value};
+use std::path::PathBuf;
+use tokio::sync::mpsc;
+use tracing::debug;
+
+use crate::executor::record_batch::{ColumnData, ColumnVector, Field, RecordBatch, Schema};
+use crate::executor::sort_key::{NormalizedKeys, SortColumn};
+use crate::executor::spill::SpillFile;
+
+/// 落盘段中排序键列的列名
+const SORT_KEY_COLUMN: &str = "__sort_key";
+/// 每个段预读的帧数
+const PREFETCH_FRAMES: usize = 2;
+
+/// 外部排序统计
+#[derive(Debug, Clone, Default, PartialEq)]
+pub struct ExternalSortStats {
+    /// 写出的初始段数
+    pub runs: usize,
+    /// 中间归并轮数 (不含最终归并)
+    pub merge_passes: usize,
+    /// 落盘的字节数
+    pub spilled_bytes: usize,
+}
+
+/// 外部排序器：先 `push` 全部输入，再用 `finish_stream` 逐帧读取有序结果
+#[derive(Debug)]
+pub struct ExternalSorter {
+    schema: Schema,
+    sort_columns: Vec<SortColumn>,
+    /// 单段允许占用的内存 (数据 + 键)
+    memory_budget: usize,
+    /// 段文件内每帧的行数，也是输出批的行数
+    frame_rows: usize,
+    /// 归并扇入
+    merge_fan_in: usize,
+    temp_dir: PathBuf,
+    buffered: Vec<RecordBatch>,
+    buffered_bytes: usize,
+    runs: Vec<SpillFile>,
+    stats: ExternalSortStats,
+}
+
+impl ExternalSorter {
+    pub fn new(schema: Schema, sort_columns: Vec<SortColumn>, memory_budget: usize, temp_dir: impl Into<PathBuf>) -> Self {
+        Self {
+            schema,
+            sort_columns,
+            memory_budget: memory_budget.max(1),
+            frame_rows: 1024,
+            merge_fan_in: 64,
+            temp_dir: temp_dir.into(),
+            buffered: Vec::new(),
+            buffered_bytes: 0,
+            runs: Vec::new(),
+            stats: ExternalSortStats::default(),
+        }
+    }
+
+    pub fn set_frame_rows(&mut self, frame_rows: usize) {
+        self.frame_rows = frame_rows.max(1);
+    }
+
+    pub fn set_merge_fan_in(&mut self, fan_in: usize) {
+        self.merge_fan_in = fan_in.max(2);
+    }
+
+    pub fn schema(&self) -> &Schema {
+        &self.schema
+    }
+
+    pub fn stats(&self) -> &ExternalSortStats {
+        &self.stats
+    }
+
+    /// 追加输入，缓冲区超出预算时排序并落盘为一个段
+    pub fn push(&mut self, batch: RecordBatch) -> Result<()> {
+        if batch.num_columns() != self.schema.fields.len() {
+            return Err(Error::Execution(format!(
+                "external sort expects {} columns, got {}",
+                self.schema.fields.len(),
+                batch.num_columns()
+            )));
+        }
+        // 按每行约 9 字节/列估算键的开销
+        self.buffered_bytes += batch.memory_size() + batch.num_rows() * self.sort_columns.len() * 9;
+        self.buffered.push(batch);
+        if self.buffered_bytes >= self.memory_budget {
+            self.spill_run()?;
+        }
+        Ok(())
+    }
+
+    /// 对缓冲区排序，返回附带键列的有序批
+    fn sort_buffered(&mut self) -> Result<RecordBatch> {
+        let batches = std::mem::take(&mut self.buffered);
+        self.buffered_bytes = 0;
+        let batch = match batches.len() {
+            1 => batches.into_iter().next().expect("one batch").compact(),
+            _ => RecordBatch::concat(self.schema.clone(), &batches)?,
+        };
+        let keys = NormalizedKeys::encode(&batch, &batch.row_indices(), &self.sort_columns);
+        let order = keys.sorted_indices();
+        let sorted = batch.take(&order);
+        let mut key_column = ColumnVector::with_capacity(DataType::Binary, order.len());
+        for &i in &order {
+            key_column.push_value(&Value::Binary(keys.key(i).to_vec()));
+        }
+        let mut columns = sorted.columns;
+        columns.push(key_column);
+        RecordBatch::try_new(self.run_schema(), columns)
+    }
+
+    fn run_schema(&self) -> Schema {
+        let mut fields = self.schema.fields.clone();
+        fields.push(Field::new(SORT_KEY_COLUMN, DataType::Binary));
+        Schema::new(fields)
+    }
+
+    fn spill_run(&mut self) -> Result<()> {
+        if self.buffered.iter().all(|b| b.is_empty()) {
+            self.buffered.clear();
+            self.buffered_bytes = 0;
+            return Ok(());
+        }
+        let sorted = self.sort_buffered()?;
+        let mut run = SpillFile::create(&self.temp_dir, "sort-run", self.run_schema())?;
+        let frame_rows = self.frame_rows;
+        let rows: Vec<usize> = (0..sorted.physical_rows()).collect();
+        for chunk in rows.chunks(frame_rows) {
+            run.append(&sorted.take(chunk))?;
+        }
+        run.finish()?;
+        debug!("External sort spilled run {} with {} rows", self.runs.len(), run.rows());
+        self.stats.spilled_bytes += run.bytes_written();
+        self.stats.runs += 1;
+        self.runs.push(run);
+        Ok(())
+    }
+
+    /// 结束输入并返回按帧交出有序结果的流
+    pub async fn finish_stream(mut self) -> Result<SortedStream> {
+        let data_columns: Vec<usize> = (0..self.schema.fields.len()).collect();
+        // 全部输入装得下内存时不落盘
+        if self.runs.is_empty() {
+            let output = match self.buffered.is_empty() {
+                true => SortedOutput::Done,
+                false => SortedOutput::InMemory { batch: self.sort_buffered()?.project(&data_columns), next_row: 0 },
+            };
+            return Ok(SortedStream { output, data_columns, frame_rows: self.frame_rows, stats: self.stats });
+        }
+        self.spill_run()?;
+
+        // 段数超过扇入时做中间归并，直到一轮可以归并完。每轮把相邻的段分组归并，
+        // 归并结果留在原位置，段号的先后仍是输入的先后，排序保持稳定
+        while self.runs.len() > self.merge_fan_in {
+            let mut remaining = std::mem::take(&mut self.runs).into_iter();
+            loop {
+                let group: Vec<SpillFile> = remaining.by_ref().take(self.merge_fan_in).collect();
+                if group.len() <= 1 {
+                    self.runs.extend(group);
+                    break;
+                }
+                let mut merged = SpillFile::create(&self.temp_dir, "sort-merge", self.run_schema())?;
+                let mut merger = RunMerger::open(group, self.frame_rows).await?.expect("group is not empty");
+                while let Some(frame) = merger.next_frame().await? {
+                    merged.append(&frame)?;
+                }
+                merged.finish()?;
+                self.stats.spilled_bytes += merged.bytes_written();
+                self.runs.push(merged);
+            }
+            self.stats.merge_passes += 1;
+        }
+
+        let output = match RunMerger::open(std::mem::take(&mut self.runs), self.frame_rows).await? {
+            Some(merger) => SortedOutput::Merging(merger),
+            None => SortedOutput::Done,
+        };
+        Ok(SortedStream { output, data_columns, frame_rows: self.frame_rows, stats: self.stats })
+    }
+
+    /// 结束输入并把有序结果收成一个批，仅用于结果确定较小的场景
+    pub async fn finish(self) -> Result<(RecordBatch, ExternalSortStats)> {
+        let schema = self.schema.clone();
+        let mut stream = self.finish_stream().await?;
+        let mut frames = Vec::new();
+        while let Some(frame) = stream.next_batch().await? {
+            frames.push(frame);
+        }
+        let result = match frames.len() {
+            0 => RecordBatch::empty(schema),
+            1 => frames.pop().expect("one frame"),
+            _ => RecordBatch::concat(schema, &frames)?,
+        };
+        Ok((result, stream.stats))
+    }
+}
+
+/// 外部排序的有序结果，按帧交出
+///
+/// 落盘排序时任何时刻只持有每个段的预读帧与一个输出帧，结果多大都不会整体留在内存里。
+pub struct SortedStream {
+    output: SortedOutput,
+    data_columns: Vec<usize>,
+    frame_rows: usize,
+    stats: ExternalSortStats,
+}
+
+enum SortedOutput {
+    /// 未落盘，已排序的批按帧切分
+    InMemory { batch: RecordBatch, next_row: usize },
+    Merging(RunMerger),
+    Done,
+}
+
+impl SortedStream {
+    pub fn stats(&self) -> &ExternalSortStats {
+        &self.stats
+    }
+
+    /// 下一帧有序结果，读完返回 `None`
+    pub async fn next_batch(&mut self) -> Result<Option<RecordBatch>> {
+        let frame = match &mut self.output {
+            SortedOutput::InMemory { batch, next_row } => {
+                let end = (*next_row + self.frame_rows).min(batch.physical_rows());
+                let rows: Vec<usize> = (*next_row..end).collect();
+                *next_row = end;
+                (!rows.is_empty()).then(|| batch.take(&rows))
+            }
+            SortedOutput::Merging(merger) => merger.next_frame().await?.map(|frame| frame.project(&self.data_columns)),
+            SortedOutput::Done => None,
+        };
+        if frame.is_none() {
+            // 尽早释放段文件与预读线程
+            self.output = SortedOutput::Done;
+        }
+        Ok(frame)
+    }
+}
+
+/// 段读取游标：后台线程预读帧，归并循环按行推进
+struct RunCursor {
+    receiver: mpsc::Receiver<Result<RecordBatch>>,
+    frame: Option<RecordBatch>,
+    row: usize,
+    key_column: usize,
+    /// 保持文件存活直到归并结束
+    _file: SpillFile,
+}
+
+impl RunCursor {
+    fn open(mut file: SpillFile) -> Result<Self> {
+        let mut reader = file.reader()?;
+        let key_column = file.schema().fields.len() - 1;
+        let (sender, receiver) = mpsc::channel(PREFETCH_FRAMES);
+        tokio::task::spawn_blocking(move || loop {
+            let next = reader.next_batch();
+            let done = !matches!(next, Ok(Some(_)));
+            let message = match next {
+                Ok(Some(batch)) => Ok(batch),
+                Ok(None) => break,
+                Err(e) => Err(e),
+            };
+            if sender.blocking_send(message).is_err() || done {
+                break;
+            }
+        });
+        Ok(Self { receiver, frame: None, row: 0, key_column, _file: file })
+    }
+
+    /// 定位到下一个可用行，段读完时返回 false
+    async fn advance(&mut self) -> Result<bool> {
+        loop {
+            if let Some(frame) = &self.frame {
+                if self.row < frame.physical_rows() {
+                    return Ok(true);
+                }
+            }
+            match self.receiver.recv().await {
+                Some(frame) => {
+                    self.frame = Some(frame?);
+                    self.row = 0;
+                }
+                None => {
+                    self.frame = None;
+                    return Ok(false);
+                }
+            }
+        }
+    }
+
+    fn key(&self) -> Option<&[u8]> {
+        let frame = self.frame.as_ref()?;
+        match &frame.column(self.key_column).data {
+            ColumnData::Binary(keys) => Some(keys[self.row].as_slice()),
+            _ => None,
+        }
+    }
+}
+
+/// 败者树：内部节点记录比赛的败者，`tree[0]` 为当前胜者
+///
+/// 每输出一行只需沿一条叶到根的路径重赛 log2(k) 次，比二叉堆的下沉少一半比较。
+struct LoserTree {
+    tree: Vec<usize>,
+    k: usize,
+}
+
+impl LoserTree {
+    /// `beats(a, b)`：a 是否应排在 b 之前。下标 k 为初始化用的哨兵，战胜所有人。
+    fn new(k: usize, beats: impl Fn(usize, usize) -> bool) -> Self {
+        let mut tree = LoserTree { tree: vec![k; k.max(1)], k };
+        for leaf in (0..k).rev() {
+            tree.replay(leaf, &beats);
+        }
+        tree
+    }
+
+    fn winner(&self) -> usize {
+        self.tree[0]
+    }
+
+    /// 叶子 leaf 的值变化后从叶到根重赛
+    fn replay(&mut self, leaf: usize, beats: &impl Fn(usize, usize) -> bool) {
+        let mut winner = leaf;
+        let mut node = (leaf + self.k) / 2;
+        while node > 0 {
+            let opponent = self.tree[node];
+            if opponent == self.k || (winner != self.k && beats(opponent, winner)) {
+                self.tree[node] = winner;
+                winner = opponent;
+            }
+            node /= 2;
+        }
+        self.tree[0] = winner;
+    }
+}
+
+/// 已读完的段视为无穷大；键相同时段号小的优先，保证排序稳定
+fn beats(cursors: &[RunCursor], a: usize, b: usize) -> bool {
+    match (cursors[a].key(), cursors[b].key()) {
+        (Some(x), Some(y)) => (x, a) < (y, b),
+        (Some(_), None) => true,
+        _ => false,
+    }
+}
+
+/// k 路归并若干有序段，每次产出 frame_rows 行一帧
+struct RunMerger {
+    schema: Schema,
+    cursors: Vec<RunCursor>,
+    tree: LoserTree,
+    frame_rows: usize,
+}
+
+impl RunMerger {
+    /// 没有段时返回 `None`
+    async fn open(runs: Vec<SpillFile>, frame_rows: usize) -> Result<Option<Self>> {
+        let schema = match runs.first() {
+            Some(run) => run.schema().clone(),
+            None => return Ok(None),
+        };
+        let mut cursors = Vec::with_capacity(runs.len());
+        for run in runs {
+            let mut cursor = RunCursor::open(run)?;
+            cursor.advance().await?;
+            cursors.push(cursor);
+        }
+        let tree = LoserTree::new(cursors.len(), |a, b| beats(&cursors, a, b));
+        Ok(Some(Self { schema, cursors, tree, frame_rows }))
+    }
+
+    async fn next_frame(&mut self) -> Result<Option<RecordBatch>> {
+        let mut builder: Vec<ColumnVector> =
+            self.schema.fields.iter().map(|f| ColumnVector::with_capacity(f.data_type.clone(), self.frame_rows)).collect();
+        let mut rows = 0;
+        while rows < self.frame_rows {
+            let winner = self.tree.winner();
+            if winner >= self.cursors.len() || self.cursors[winner].key().is_none() {
+                break;
+            }
+            {
+                let cursor = &self.cursors[winner];
+                let frame = cursor.frame.as_ref().expect("cursor with key has a frame");
+                for (column, source) in builder.iter_mut().zip(frame.columns.iter()) {
+                    column.append_from(source, cursor.row);
+                }
+            }
+            rows += 1;
+
+            self.cursors[winner].row += 1;
+            self.cursors[winner].advance().await?;
+            let cursors = &self.cursors;
+            self.tree.replay(winner, &|a, b| beats(cursors, a, b));
+        }
+        if rows == 0 {
+            return Ok(None);
+        }
+        Ok(Some(RecordBatch::try_new(self.schema.clone(), builder)?))
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::executor::sort_key::parse_order_by;
+
+    fn schema() -> Schema {
+        Schema::new(vec![Field::new("id", DataType::BigInt), Field::new("name", DataType::String)])
+    }
+
+    fn batch(ids: Vec<i64>) -> RecordBatch {
+        let names = ids.iter().map(|i| format!("n{}", i % 7)).collect();
+        RecordBatch::try_new(schema(), vec![ColumnVector::from_i64(ids), ColumnVector::from_strings(names)]).unwrap()
+    }
+
+    fn ids(batch: &RecordBatch) -> Vec<i64> {
+        match &batch.column(0).data {
+            ColumnData::Int64(v) => batch.row_indices().iter().map(|&i| v[i]).collect(),
+            _ => panic!("id column is BIGINT"),
+        }
+    }
+
+    #[test]
+    fn test_loser_tree_orders_leaves() {
+        let values = [5, 1, 4, 1, 3];
+        let tree = LoserTree::new(values.len(), |a, b| (values[a], a) < (values[b], b));
+        assert_eq!(tree.winner(), 1);
+    }
+
+    #[tokio::test]
+    async fn test_in_memory_sort_without_spill() {
+        let columns = parse_order_by(&["id DESC".to_string()], &schema()).unwrap();
+        let mut sorter = ExternalSorter::new(schema(), columns, 1 << 20, std::env::temp_dir());
+        sorter.push(batch(vec![3, 1, 2])).unwrap();
+        let (sorted, stats) = sorter.finish().await.unwrap();
+        assert_eq!(ids(&sorted), vec![3, 2, 1]);
+        assert_eq!(sorted.num_columns(), 2);
+        assert_eq!(stats.runs, 0);
+    }
+
+    #[tokio::test]
+    async fn test_spilled_runs_merge_with_multiple_passes() {
+        let columns = parse_order_by(&["id".to_string()], &schema()).unwrap();
+        // 预算很小：每个输入批都会变成一个段
+        let mut sorter = ExternalSorter::new(schema(), columns, 64, std::env::temp_dir());
+        sorter.set_frame_rows(7);
+        sorter.set_merge_fan_in(3);
+        let mut expected = Vec::new();
+        for chunk in 0..10i64 {
+            let values: Vec<i64> = (0..25).map(|i| (i * 37 + chunk * 11) % 101).collect();
+            expected.extend(values.iter().copied());
+            sorter.push(batch(values)).unwrap();
+        }
+        expected.sort();
+
+        let (sorted, stats) = sorter.finish().await.unwrap();
+        assert_eq!(ids(&sorted), expected);
+        assert_eq!(stats.runs, 10);
+        assert!(stats.merge_passes > 0);
+        assert!(stats.spilled_bytes > 0);
+    }
+
+    #[tokio::test]
+    async fn test_multi_pass_merge_is_stable() {
+        let columns = parse_order_by(&["id".to_string()], &schema()).unwrap();
+        let mut sorter = ExternalSorter::new(schema(), columns, 64, std::env::temp_dir());
+        sorter.set_frame_rows(4);
+        sorter.set_merge_fan_in(2);
+        // 只有 3 个不同的键，name 记录输入顺序
+        for chunk in 0..9 {
+            let ids: Vec<i64> = (0..10).map(|i| (i * 7) % 3).collect();
+            let names = (0..10).map(|i| format!("{:04}", chunk * 10 + i)).collect();
+            sorter.push(RecordBatch::try_new(schema(), vec![ColumnVector::from_i64(ids), ColumnVector::from_strings(names)]).unwrap()).unwrap();
+        }
+
+        let (sorted, stats) = sorter.finish().await.unwrap();
+        assert_eq!(stats.runs, 9);
+        assert!(stats.merge_passes >= 2);
+        let rows = sorted.into_query_result().rows;
+        assert_eq!(rows.len(), 90);
+        // 同键的行按输入顺序排列
+        for pair in rows.windows(2) {
+            assert!((&pair[0][0], &pair[0][1]) < (&pair[1][0], &pair[1][1]), "{:?}", pair);
+        }
+    }
+}
@@ -0,0 +1,846 @@
+//! 自适应两阶段哈希聚合
+//!
+//! 部分聚合阶段：输入按 morsel 切分，由 `MorselScheduler` 分给工作线程，每个线程
+//! 在自己的局部聚合表上聚合；局部表达到分组上限时整表输出为部分状态并清空。
+//! 采样 `adapt_after_rows` 行后如果分组数与行数之比高于 `passthrough_ratio`
+//! (几乎没有缩减)，该线程切换为直通模式，后续行不再查表，直接转成单行部分状态。
+//!
+//! 合并阶段：所有部分状态按分组键哈希的高位做基数分区，逐分区合并。分区的聚合表
+//! 增长时向 `MemoryBudget` 申请额度，申请失败则把已合并的分组 (仍是部分状态)
+//! 与分区中未处理的行一起落盘，之后用下一段哈希位继续分区合并。
+//!
+//! 部分聚合阶段的局部表同样向预算申请额度，申请失败时提前整表输出，
+//! 任何表输出、落盘或出错退出时都归还它占用的额度。
+//!
+//! 聚合表为线性探测的开放寻址表：槽位只保存分组号和哈希值，分组键按列类型存放在
+//! 列式 arena 中，累加器按 `分组号 * 聚合数 + 聚合下标` 内联在一个连续数组里。
+
+use common::{DataType, Error, Result};
+use std::path::PathBuf;
+use std::sync::Mutex;
+use tracing::{debug, warn};
+
+use crate::executor::hash_join::hash_keys;
+use crate::executor::morsel::MorselScheduler;
+use crate::executor::record_batch::{ColumnData, ColumnVector, Field, RecordBatch, Schema};
+use crate::executor::spill::SpillFile;
+use crate::storage::memory::{MemoryBudget, MemoryReservation};
+
+/// 每个聚合函数在部分状态中占用的列数：count、numeric_count、sum、min、max
+const STATE_COLUMNS: usize = 5;
+
+/// 合并阶段每次向内存管理器申请的最小额度
+const RESERVE_GRANULE: usize = 64 * 1024;
+
+/// 预算不足时局部表至少积累这么多分组才提前输出，避免逐行输出
+const MIN_FLUSH_GROUPS: usize = 1024;
+
+const EMPTY: u32 = u32::MAX;
+
+/// 聚合函数
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum AggregateKind {
+    /// `count`、`count(*)` 统计行数，`count(col)` 统计非 NULL 值个数
+    Count,
+    Sum,
+    Avg,
+    Min,
+    Max,
+}
+
+/// 一个聚合表达式
+#[derive(Debug, Clone, PartialEq)]
+pub struct AggregateSpec {
+    pub kind: AggregateKind,
+    /// 参数列下标，`None` 表示没有参数 (`count(*)`)
+    pub column: Option<usize>,
+    /// 输出列名
+    pub name: String,
+}
+
+impl AggregateSpec {
+    /// 解析 `sum(price)`、`count(*)` 形式的聚合表达式
+    ///
+    /// 只写函数名时沿用算子原有的约定，数值聚合以 `value` 列为参数，`count` 统计行数。
+    pub fn parse(expr: &str, schema: &Schema) -> Result<Self> {
+        let expr = expr.trim();
+        let (function, argument) = match expr.find('(') {
+            Some(open) if expr.ends_with(')') => (&expr[..open], Some(expr[open + 1..expr.len() - 1].trim())),
+            _ => (expr, None),
+        };
+        let function = function.trim().to_lowercase();
+        let kind = match function.as_str() {
+            "count" => AggregateKind::Count,
+            "sum" => AggregateKind::Sum,
+            "avg" => AggregateKind::Avg,
+            "min" => AggregateKind::Min,
+            "max" => AggregateKind::Max,
+            _ => return Err(Error::Execution(format!("unsupported aggregate function: {}", expr))),
+        };
+        let column = match argument {
+            Some("*") | Some("") => None,
+            Some(name) => Some(
+                schema
+                    .index_of(name)
+                    .ok_or_else(|| Error::Execution(format!("aggregate column not found: {}", name)))?,
+            ),
+            None if kind == AggregateKind::Count => None,
+            None => schema.index_of("value"),
+        };
+        Ok(Self { kind, column, name: expr.to_lowercase() })
+    }
+
+    fn output_type(&self) -> DataType {
+        match self.kind {
+            AggregateKind::Count => DataType::BigInt,
+            _ => DataType::Double,
+        }
+    }
+}
+
+/// 单个分组上一个聚合函数的累加器
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct Accumulator {
+    count: i64,
+    numeric_count: i64,
+    sum: f64,
+    min: f64,
+    max: f64,
+}
+
+impl Accumulator {
+    const EMPTY: Accumulator = Accumulator { count: 0, numeric_count: 0, sum: 0.0, min: f64::INFINITY, max: f64::NEG_INFINITY };
+
+    /// `present` 表示参数非 NULL (没有参数时恒为真)，`value` 为参数的数值
+    #[inline]
+    fn update(&mut self, present: bool, value: Option<f64>) {
+        self.count += present as i64;
+        if let Some(v) = value {
+            self.numeric_count += 1;
+            self.sum += v;
+            self.min = self.min.min(v);
+            self.max = self.max.max(v);
+        }
+    }
+
+    #[inline]
+    fn merge(&mut self, other: &Accumulator) {
+        self.count += other.count;
+        self.numeric_count += other.numeric_count;
+        self.sum += other.sum;
+        self.min = self.min.min(other.min);
+        self.max = self.max.max(other.max);
+    }
+
+    /// 计算最终值，没有数值输入时返回 0
+    fn finish(&self, kind: AggregateKind) -> f64 {
+        if kind == AggregateKind::Count {
+            return self.count as f64;
+        }
+        if self.numeric_count == 0 {
+            return 0.0;
+        }
+        match kind {
+            AggregateKind::Sum => self.sum,
+            AggregateKind::Avg => self.sum / self.numeric_count as f64,
+            AggregateKind::Min => self.min,
+            AggregateKind::Max => self.max,
+            AggregateKind::Count => unreachable!(),
+        }
+    }
+}
+
+/// 哈希聚合执行统计
+#[derive(Debug, Clone, Default, PartialEq)]
+pub struct HashAggStats {
+    pub input_rows: usize,
+    /// 部分聚合阶段输出的部分状态行数
+    pub partial_rows: usize,
+    /// 以直通方式输出的行数
+    pub passthrough_rows: usize,
+    /// 切换到直通模式的线程数
+    pub passthrough_workers: usize,
+    pub output_groups: usize,
+    /// 合并阶段落盘的分区数
+    pub spilled_partitions: usize,
+    pub spilled_rows: usize,
+    /// 最大分区递归深度
+    pub max_depth: u32,
+}
+
+// ---------------------------------------------------------------------------
+// 开放寻址聚合表
+// ---------------------------------------------------------------------------
+
+struct AggHashTable {
+    slots: Vec<u32>,
+    slot_hashes: Vec<u64>,
+    mask: usize,
+    /// 分组键 arena，第 i 列对应第 i 个分组键
+    keys: Vec<ColumnVector>,
+    /// 累加器，`分组号 * num_aggs + 聚合下标`
+    states: Vec<Accumulator>,
+    num_aggs: usize,
+    groups: usize,
+    /// 估算的内存占用
+    bytes: usize,
+}
+
+impl AggHashTable {
+    fn new(key_fields: &[Field], num_aggs: usize, capacity: usize) -> Self {
+        let slots = (capacity.max(8) * 2).next_power_of_two();
+        Self {
+            slots: vec![EMPTY; slots],
+            slot_hashes: vec![0; slots],
+            mask: slots - 1,
+            keys: key_fields.iter().map(|f| ColumnVector::with_capacity(f.data_type.clone(), capacity)).collect(),
+            states: Vec::with_capacity(capacity * num_aggs),
+            num_aggs,
+            groups: 0,
+            bytes: slots * 12,
+        }
+    }
+
+    /// 查找分组，不存在时插入；返回分组号
+    #[inline]
+    fn find_or_insert(&mut self, hash: u64, batch: &RecordBatch, row: usize, key_columns: &[usize]) -> usize {
+        let mut pos = hash as usize & self.mask;
+        loop {
+            let group = self.slots[pos];
+            if group == EMPTY {
+                break;
+            }
+            if self.slot_hashes[pos] == hash && self.keys_equal(group as usize, batch, row, key_columns) {
+                return group as usize;
+            }
+            pos = (pos + 1) & self.mask;
+        }
+
+        let group = self.groups;
+        self.slots[pos] = group as u32;
+        self.slot_hashes[pos] = hash;
+        for (key, &column) in self.keys.iter_mut().zip(key_columns) {
+            let source = batch.column(column);
+            key.append_from(source, row);
+            self.bytes += value_size(source, row);
+        }
+        self.states.extend(std::iter::repeat(Accumulator::EMPTY).take(self.num_aggs));
+        self.bytes += self.num_aggs * std::mem::size_of::<Accumulator>();
+        self.groups += 1;
+
+        // 负载因子超过 0.7 时扩容
+        if self.groups * 10 > self.slots.len() * 7 {
+            self.grow();
+        }
+        group
+    }
+
+    fn keys_equal(&self, group: usize, batch: &RecordBatch, row: usize, key_columns: &[usize]) -> bool {
+        self.keys.iter().zip(key_columns).all(|(key, &column)| key.eq_at(group, batch.column(column), row))
+    }
+
+    fn grow(&mut self) {
+        let capacity = self.slots.len() * 2;
+        let mut slots = vec![EMPTY; capacity];
+        let mut slot_hashes = vec![0; capacity];
+        let mask = capacity - 1;
+        for (slot, &group) in self.slots.iter().enumerate() {
+            if group == EMPTY {
+                continue;
+            }
+            let hash = self.slot_hashes[slot];
+            let mut pos = hash as usize & mask;
+            while slots[pos] != EMPTY {
+                pos = (pos + 1) & mask;
+            }
+            slots[pos] = group;
+            slot_hashes[pos] = hash;
+        }
+        self.bytes += (capacity - self.slots.len()) * 12;
+        self.slots = slots;
+        self.slot_hashes = slot_hashes;
+        self.mask = mask;
+    }
+
+    #[inline]
+    fn state_mut(&mut self, group: usize, aggregate: usize) -> &mut Accumulator {
+        &mut self.states[group * self.num_aggs + aggregate]
+    }
+
+    /// 以部分状态输出 (分组键列 + 每个聚合的状态列)
+    fn into_partial(self, schema: &Schema) -> Result<RecordBatch> {
+        let mut columns = self.keys;
+        columns.extend(state_columns(&self.states, self.num_aggs, self.groups));
+        RecordBatch::try_new(schema.clone(), columns)
+    }
+
+    /// 输出最终结果 (分组键列 + 每个聚合的结果列)
+    fn into_final(self, key_fields: &[Field], aggregates: &[AggregateSpec]) -> Result<RecordBatch> {
+        let mut fields = key_fields.to_vec();
+        let mut columns = self.keys;
+        for (a, aggregate) in aggregates.iter().enumerate() {
+            let states = (0..self.groups).map(|g| &self.states[g * self.num_aggs + a]);
+            let column = match aggregate.kind {
+                AggregateKind::Count => ColumnVector::from_i64(states.map(|s| s.count).collect()),
+                kind => ColumnVector::from_f64(states.map(|s| s.finish(kind)).collect()),
+            };
+            fields.push(Field::new(aggregate.name.clone(), aggregate.output_type()));
+            columns.push(column);
+        }
+        RecordBatch::try_new(Schema::new(fields), columns)
+    }
+}
+
+/// 一个值在分组键 arena 中大约占用的字节数
+fn value_size(column: &ColumnVector, row: usize) -> usize {
+    match &column.data {
+        ColumnData::Boolean(_) => 1,
+        ColumnData::Int32(_) | ColumnData::Float32(_) => 4,
+        ColumnData::Int64(_) | ColumnData::Float64(_) => 8,
+        ColumnData::Utf8(v) => v[row].len() + std::mem::size_of::<String>(),
+        ColumnData::Binary(v) => v[row].len() + std::mem::size_of::<Vec<u8>>(),
+    }
+}
+
+fn state_columns(states: &[Accumulator], num_aggs: usize, groups: usize) -> Vec<ColumnVector> {
+    let mut columns = Vec::with_capacity(num_aggs * STATE_COLUMNS);
+    for a in 0..num_aggs {
+        let state = |g: usize| &states[g * num_aggs + a];
+        columns.push(ColumnVector::from_i64((0..groups).map(|g| state(g).count).collect()));
+        columns.push(ColumnVector::from_i64((0..groups).map(|g| state(g).numeric_count).collect()));
+        columns.push(ColumnVector::from_f64((0..groups).map(|g| state(g).sum).collect()));
+        columns.push(ColumnVector::from_f64((0..groups).map(|g| state(g).min).collect()));
+        columns.push(ColumnVector::from_f64((0..groups).map(|g| state(g).max).collect()));
+    }
+    columns
+}
+
+/// 从部分状态批中读出一个累加器
+#[inline]
+fn read_state(batch: &RecordBatch, base: usize, row: usize) -> Accumulator {
+    let int = |c: usize| match &batch.column(c).data {
+        ColumnData::Int64(v) => v[row],
+        _ => 0,
+    };
+    let float = |c: usize, default: f64| match &batch.column(c).data {
+        ColumnData::Float64(v) => v[row],
+        _ => default,
+    };
+    Accumulator {
+        count: int(base),
+        numeric_count: int(base + 1),
+        sum: float(base + 2, 0.0),
+        min: float(base + 3, f64::INFINITY),
+        max: float(base + 4, f64::NEG_INFINITY),
+    }
+}
+
+// ---------------------------------------------------------------------------
+// 部分聚合
+// ---------------------------------------------------------------------------
+
+/// 单个工作线程的部分聚合状态，跨 morsel 复用
+struct PartialAggregator<'a> {
+    config: &'a AdaptiveHashAggregate,
+    key_fields: &'a [Field],
+    key_columns: &'a [usize],
+    aggregates: &'a [AggregateSpec],
+    schema: &'a Schema,
+    memory_manager: &'a dyn MemoryBudget,
+    table: AggHashTable,
+    /// 局部表当前占用的额度
+    reserved: usize,
+    outputs: Vec<RecordBatch>,
+    rows_seen: usize,
+    passthrough: bool,
+    passthrough_rows: usize,
+}
+
+impl<'a> PartialAggregator<'a> {
+    fn consume(&mut self, batch: &RecordBatch, hashes: &[u64], rows: &[usize]) -> Result<()> {
+        let mut passthrough_rows = Vec::new();
+        for &row in rows {
+            if self.passthrough {
+                passthrough_rows.push(row);
+                continue;
+            }
+            let group = self.table.find_or_insert(hashes[row], batch, row, self.key_columns);
+            for (a, aggregate) in self.aggregates.iter().enumerate() {
+                let (present, value) = argument(aggregate, batch, row);
+                self.table.state_mut(group, a).update(present, value);
+            }
+            self.rows_seen += 1;
+            self.reserve()?;
+
+            if self.rows_seen == self.config.adapt_after_rows
+                && self.table.groups as f64 >= self.config.passthrough_ratio * self.rows_seen as f64
+            {
+                debug!(
+                    "HashAgg: {} groups after {} rows, switching to pass-through",
+                    self.table.groups, self.rows_seen
+                );
+                self.passthrough = true;
+                self.flush()?;
+            } else if self.table.groups >= self.config.partial_max_groups {
+                self.flush()?;
+            }
+        }
+        if !passthrough_rows.is_empty() {
+            self.passthrough_rows += passthrough_rows.len();
+            self.outputs.push(self.passthrough_batch(batch, &passthrough_rows)?);
+        }
+        Ok(())
+    }
+
+    /// 为局部表的增长申请额度；申请失败且表已足够大时提前整表输出。
+    /// 很小的表超出预算也继续使用，合并阶段会按预算落盘
+    fn reserve(&mut self) -> Result<()> {
+        if self.table.bytes <= self.reserved {
+            return Ok(());
+        }
+        let request = (self.table.bytes - self.reserved).max(RESERVE_GRANULE);
+        if self.memory_manager.reserve_work_memory(request).is_ok() {
+            self.reserved += request;
+        } else if self.table.groups >= MIN_FLUSH_GROUPS {
+            debug!("HashAgg: partial table with {} groups exceeds the memory budget, flushing", self.table.groups);
+            self.flush()?;
+        }
+        Ok(())
+    }
+
+    /// 局部表整表输出为部分状态并清空，归还它占用的额度
+    fn flush(&mut self) -> Result<()> {
+        if self.table.groups == 0 {
+            return Ok(());
+        }
+        let capacity = self.config.partial_max_groups.min(self.config.adapt_after_rows.max(1024));
+        let table = std::mem::replace(
+            &mut self.table,
+            AggHashTable::new(self.key_fields, self.aggregates.len(), capacity),
+        );
+        self.memory_manager.release_work_memory(std::mem::take(&mut self.reserved));
+        self.outputs.push(table.into_partial(self.schema)?);
+        Ok(())
+    }
+
+    /// 每行直接转成一个单行部分状态
+    fn passthrough_batch(&self, batch: &RecordBatch, rows: &[usize]) -> Result<RecordBatch> {
+        let mut columns: Vec<ColumnVector> = self.key_columns.iter().map(|&c| batch.column(c).take(rows)).collect();
+        let mut states = Vec::with_capacity(rows.len() * self.aggregates.len());
+        for &row in rows {
+            for aggregate in self.aggregates {
+                let mut state = Accumulator::EMPTY;
+                let (present, value) = argument(aggregate, batch, row);
+                state.update(present, value);
+                states.push(state);
+            }
+        }
+        columns.extend(state_columns(&states, self.aggregates.len(), rows.len()));
+        RecordBatch::try_new(self.schema.clone(), columns)
+    }
+}
+
+impl Drop for PartialAggregator<'_> {
+    fn drop(&mut self) {
+        self.memory_manager.release_work_memory(std::mem::take(&mut self.reserved));
+    }
+}
+
+/// 聚合参数在一行上的值：是否非 NULL，以及数值
+#[inline]
+fn argument(aggregate: &AggregateSpec, batch: &RecordBatch, row: usize) -> (bool, Option<f64>) {
+    match aggregate.column {
+        Some(c) => {
+            let column = batch.column(c);
+            (!column.is_null(row), column.as_f64(row))
+        }
+        None => (true, None),
+    }
+}
+
+// ---------------------------------------------------------------------------
+// 两阶段聚合
+// ---------------------------------------------------------------------------
+
+/// 自适应两阶段哈希聚合
+#[derive(Debug, Clone)]
+pub struct AdaptiveHashAggregate {
+    /// 部分聚合的工作线程数
+    pub num_workers: usize,
+    /// 每个 morsel 的行数
+    pub morsel_rows: usize,
+    /// 每个线程局部聚合表的分组上限，达到后整表输出
+    pub partial_max_groups: usize,
+    /// 处理多少行后评估部分聚合的缩减效果
+    pub adapt_after_rows: usize,
+    /// 分组数与行数之比不低于该值时切换为直通
+    pub passthrough_ratio: f64,
+    /// 每层分区使用的哈希位数
+    pub radix_bits: u32,
+    /// 最大分区递归深度，达到后即使超出预算也在内存中合并
+    pub max_depth: u32,
+    /// 落盘目录
+    pub spill_dir: PathBuf,
+}
+
+impl Default for AdaptiveHashAggregate {
+    fn default() -> Self {
+        Self {
+            num_workers: std::thread::available_parallelism().map_or(1, |n| n.get()),
+            morsel_rows: 16 * 1024,
+            partial_max_groups: 16 * 1024,
+            adapt_after_rows: 16 * 1024,
+            passthrough_ratio: 0.8,
+            radix_bits: 4,
+            max_depth: 3,
+            spill_dir: std::env::temp_dir(),
+        }
+    }
+}
+
+impl AdaptiveHashAggregate {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// 执行聚合，返回结果批 (分组键列 + 每个聚合一列) 与执行统计
+    pub fn execute(
+        &self,
+        input: &RecordBatch,
+        key_columns: &[usize],
+        aggregates: &[AggregateSpec],
+        memory_manager: &dyn MemoryBudget,
+    ) -> Result<(RecordBatch, HashAggStats)> {
+        if self.radix_bits == 0 || self.radix_bits > 16 {
+            return Err(Error::Execution(format!("invalid radix bits {}", self.radix_bits)));
+        }
+        let key_fields: Vec<Field> = key_columns.iter().map(|&c| input.schema.fields[c].clone()).collect();
+        let partial_schema = Self::partial_schema(&key_fields, aggregates);
+        let mut stats = HashAggStats { input_rows: input.num_rows(), ..HashAggStats::default() };
+
+        // 1. 部分聚合：每个工作线程一张局部表
+        let hashes = hash_keys(input, key_columns);
+        let rows = input.row_indices();
+        let morsels: Vec<&[usize]> = rows.chunks(self.morsel_rows.max(1)).collect();
+        let workers = self.num_workers.max(1).min(morsels.len().max(1));
+        let local_capacity = self.partial_max_groups.min(self.adapt_after_rows.max(1024));
+        let locals: Vec<Mutex<PartialAggregator<'_>>> = (0..workers)
+            .map(|_| {
+                Mutex::new(PartialAggregator {
+                    config: self,
+                    key_fields: &key_fields,
+                    key_columns,
+                    aggregates,
+                    schema: &partial_schema,
+                    memory_manager,
+                    table: AggHashTable::new(&key_fields, aggregates.len(), local_capacity),
+                    reserved: 0,
+                    outputs: Vec::new(),
+                    rows_seen: 0,
+                    passthrough: false,
+                    passthrough_rows: 0,
+                })
+            })
+            .collect();
+        let scheduler = MorselScheduler::new(workers);
+        scheduler.run_with_workers(workers, morsels, |worker, morsel| {
+            locals[worker].lock().unwrap().consume(input, &hashes, morsel)
+        })?;
+
+        let mut partials = Vec::new();
+        for local in locals {
+            let mut local = local.into_inner().unwrap();
+            local.flush()?;
+            stats.passthrough_rows += local.passthrough_rows;
+            stats.passthrough_workers += local.passthrough as usize;
+            partials.append(&mut local.outputs);
+        }
+        let partial = match partials.len() {
+            0 => RecordBatch::empty(partial_schema.clone()),
+            1 => partials.pop().expect("one partial"),
+            _ => RecordBatch::concat(partial_schema.clone(), &partials)?,
+        };
+        stats.partial_rows = partial.num_rows();
+
+        // 2. 合并：按分组键分区，超出内存预算的分区落盘
+        let mut outputs = Vec::new();
+        self.merge_partitions(partial, 0, &key_fields, aggregates, memory_manager, &mut outputs, &mut stats)?;
+
+        let final_schema = Self::final_schema(&key_fields, aggregates);
+        let result = match outputs.len() {
+            0 => RecordBatch::empty(final_schema),
+            1 => outputs.pop().expect("one output"),
+            _ => RecordBatch::concat(final_schema, &outputs)?,
+        };
+        stats.output_groups = result.num_rows();
+        debug!("HashAgg: {:?}", stats);
+        Ok((result, stats))
+    }
+
+    fn partial_schema(key_fields: &[Field], aggregates: &[AggregateSpec]) -> Schema {
+        let mut fields = key_fields.to_vec();
+        for aggregate in aggregates {
+            fields.push(Field::new(format!("{}$count", aggregate.name), DataType::BigInt));
+            fields.push(Field::new(format!("{}$numeric_count", aggregate.name), DataType::BigInt));
+            fields.push(Field::new(format!("{}$sum", aggregate.name), DataType::Double));
+            fields.push(Field::new(format!("{}$min", aggregate.name), DataType::Double));
+            fields.push(Field::new(format!("{}$max", aggregate.name), DataType::Double));
+        }
+        Schema::new(fields)
+    }
+
+    fn final_schema(key_fields: &[Field], aggregates: &[AggregateSpec]) -> Schema {
+        let mut fields = key_fields.to_vec();
+        fields.extend(aggregates.iter().map(|a| Field::new(a.name.clone(), a.output_type())));
+        Schema::new(fields)
+    }
+
+    /// 按当前层的哈希位做基数分区，返回每个分区的行号
+    fn radix_partition(&self, hashes: &[u64], level: u32) -> Vec<Vec<usize>> {
+        let fanout = 1usize << self.radix_bits;
+        let shift = 64 - self.radix_bits * (level + 1);
+        let mask = fanout as u64 - 1;
+        let mut partitions: Vec<Vec<usize>> = vec![Vec::new(); fanout];
+        for (row, &h) in hashes.iter().enumerate() {
+            partitions[((h >> shift) & mask) as usize].push(row);
+        }
+        partitions
+    }
+
+    #[allow(clippy::too_many_arguments)]
+    fn merge_partitions(
+        &self,
+        partial: RecordBatch,
+        level: u32,
+        key_fields: &[Field],
+        aggregates: &[AggregateSpec],
+        memory_manager: &dyn MemoryBudget,
+        outputs: &mut Vec<RecordBatch>,
+        stats: &mut HashAggStats,
+    ) -> Result<()> {
+        stats.max_depth = stats.max_depth.max(level);
+        let partial = partial.compact();
+        let key_columns: Vec<usize> = (0..key_fields.len()).collect();
+        let hashes = hash_keys(&partial, &key_columns);
+        // 哈希位用完后不能再继续分区
+        let can_recurse = level < self.max_depth && self.radix_bits * (level + 2) <= 64;
+
+        let mut spilled = Vec::new();
+        let mut warned = false;
+        for rows in self.radix_partition(&hashes, level) {
+            if rows.is_empty() {
+                continue;
+            }
+            let mut table = AggHashTable::new(key_fields, aggregates.len(), rows.len().min(4096));
+            // 分区的额度随守卫归还，落盘或输出失败提前返回时也不会泄漏
+            let mut reservation = MemoryReservation::new(memory_manager, 0)?;
+            let mut spill_from = None;
+
+            for (i, &row) in rows.iter().enumerate() {
+                let group = table.find_or_insert(hashes[row], &partial, row, &key_columns);
+                for a in 0..aggregates.len() {
+                    let state = read_state(&partial, key_columns.len() + a * STATE_COLUMNS, row);
+                    table.state_mut(group, a).merge(&state);
+                }
+                if table.bytes <= reservation.size() {
+                    continue;
+                }
+                let request = (table.bytes - reservation.size()).max(RESERVE_GRANULE);
+                if reservation.try_grow(request).is_ok() {
+                    continue;
+                }
+                if can_recurse {
+                    spill_from = Some(i + 1);
+                    break;
+                } else if !warned {
+                    warn!(
+                        "Hash aggregate partition with {} rows exceeds the memory budget at depth {}, merging in memory",
+                        rows.len(),
+                        level
+                    );
+                    warned = true;
+                }
+            }
+
+            match spill_from {
+                Some(start) => {
+                    // 已合并的分组仍以部分状态写出，与未处理的行一起落盘
+                    let mut file = SpillFile::create(&self.spill_dir, "agg-partition", partial.schema.clone())?;
+                    file.append(&table.into_partial(&partial.schema)?)?;
+                    file.append(&partial.take(&rows[start..]))?;
+                    file.finish()?;
+                    stats.spilled_partitions += 1;
+                    stats.spilled_rows += file.rows();
+                    spilled.push(file);
+                }
+                None => outputs.push(table.into_final(key_fields, aggregates)?),
+            }
+        }
+
+        for mut file in spilled {
+            debug!("Reading back spilled hash aggregate partition with {} rows", file.rows());
+            let batch = file.read_all()?;
+            self.merge_partitions(batch, level + 1, key_fields, aggregates, memory_manager, outputs, stats)?;
+        }
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::storage::memory::MemoryManager;
+    use std::collections::HashMap;
+
+    fn input(rows: usize, groups: i64) -> RecordBatch {
+        RecordBatch::try_new(
+            Schema::new(vec![
+                Field::new("k", DataType::BigInt),
+                Field::new("name", DataType::String),
+                Field::new("value", DataType::BigInt),
+            ]),
+            vec![
+                ColumnVector::from_i64((0..rows as i64).map(|i| i % groups).collect()),
+                ColumnVector::from_strings((0..rows as i64).map(|i| format!("g{}", i % groups)).collect()),
+                ColumnVector::from_i64((0..rows as i64).collect()),
+            ],
+        )
+        .unwrap()
+    }
+
+    fn specs(batch: &RecordBatch) -> Vec<AggregateSpec> {
+        ["count", "sum(value)", "min(value)", "max(value)", "avg(value)"]
+            .iter()
+            .map(|a| AggregateSpec::parse(a, &batch.schema).unwrap())
+            .collect()
+    }
+
+    /// 按分组键收集结果：键 -> (count, sum, min, max, avg)
+    fn collect(result: &RecordBatch) -> HashMap<String, (i64, f64, f64, f64, f64)> {
+        (0..result.num_rows())
+            .map(|r| {
+                let count = match &result.column(1).data {
+                    ColumnData::Int64(v) => v[r],
+                    _ => panic!("count must be BIGINT"),
+                };
+                let f = |c: usize| result.column(c).as_f64(r).unwrap();
+                (result.column(0).format_value(r), (count, f(2), f(3), f(4), f(5)))
+            })
+            .collect()
+    }
+
+    fn check(result: &RecordBatch, rows: usize, groups: i64) {
+        let collected = collect(result);
+        assert_eq!(collected.len(), groups as usize);
+        for g in 0..groups {
+            let members: Vec<i64> = (0..rows as i64).filter(|i| i % groups == g).collect();
+            let sum: i64 = members.iter().sum();
+            let (count, s, min, max, avg) = collected[&g.to_string()];
+            assert_eq!(count, members.len() as i64);
+            assert_eq!(s, sum as f64);
+            assert_eq!(min, members[0] as f64);
+            assert_eq!(max, *members.last().unwrap() as f64);
+            assert!((avg - sum as f64 / members.len() as f64).abs() < 1e-9);
+        }
+    }
+
+    #[test]
+    fn test_parallel_partial_aggregation_merges_correctly() {
+        let batch = input(50_000, 37);
+        let aggregate = AdaptiveHashAggregate { num_workers: 4, morsel_rows: 1000, ..AdaptiveHashAggregate::default() };
+        let (result, stats) = aggregate.execute(&batch, &[0], &specs(&batch), &MemoryManager::new()).unwrap();
+        check(&result, 50_000, 37);
+        assert_eq!(stats.passthrough_rows, 0);
+        // 每个线程至多输出 37 个部分分组
+        assert!(stats.partial_rows <= 37 * 4);
+    }
+
+    #[test]
+    fn test_high_cardinality_switches_to_passthrough() {
+        let batch = input(20_000, 20_000);
+        let aggregate = AdaptiveHashAggregate {
+            num_workers: 1,
+            adapt_after_rows: 1000,
+            ..AdaptiveHashAggregate::default()
+        };
+        let (result, stats) = aggregate.execute(&batch, &[1], &specs(&batch), &MemoryManager::new()).unwrap();
+        assert_eq!(result.num_rows(), 20_000);
+        assert_eq!(stats.passthrough_workers, 1);
+        assert_eq!(stats.passthrough_rows, 19_000);
+    }
+
+    #[test]
+    fn test_merge_spills_when_budget_exhausted() {
+        let dir = std::env::temp_dir().join(format!("sealdb-agg-test-{}", std::process::id()));
+        std::fs::create_dir_all(&dir).unwrap();
+        let batch = input(40_000, 10_000);
+        let mut memory_manager = MemoryManager::new();
+        memory_manager.set_work_memory(64 * 1024);
+        let aggregate = AdaptiveHashAggregate {
+            num_workers: 2,
+            morsel_rows: 4096,
+            spill_dir: dir.clone(),
+            ..AdaptiveHashAggregate::default()
+        };
+        let (result, stats) = aggregate.execute(&batch, &[0], &specs(&batch), &memory_manager).unwrap();
+        check(&result, 40_000, 10_000);
+        assert!(stats.spilled_partitions > 0, "{:?}", stats);
+        assert_eq!(memory_manager.get_stats().work_memory_allocated, 0);
+        std::fs::remove_dir_all(&dir).ok();
+    }
+
+    #[test]
+    fn test_count_column_skips_nulls() {
+        let mut value = ColumnVector::with_capacity(DataType::BigInt, 4);
+        for text in ["1", "", "3", ""] {
+            value.push_str(text);
+        }
+        let batch = RecordBatch::try_new(
+            Schema::new(vec![Field::new("k", DataType::BigInt), Field::new("value", DataType::BigInt)]),
+            vec![ColumnVector::from_i64(vec![0; 4]), value],
+        )
+        .unwrap();
+        let specs: Vec<AggregateSpec> = ["count(*)", "count(value)", "count", "avg(value)"]
+            .iter()
+            .map(|a| AggregateSpec::parse(a, &batch.schema).unwrap())
+            .collect();
+        let (result, _) = AdaptiveHashAggregate::default().execute(&batch, &[0], &specs, &MemoryManager::new()).unwrap();
+        let counts: Vec<i64> = (1..=3)
+            .map(|c| match &result.column(c).data {
+                ColumnData::Int64(v) => v[0],
+                _ => panic!("count must be BIGINT"),
+            })
+            .collect();
+        assert_eq!(counts, vec![4, 2, 4]);
+        assert_eq!(result.column(4).as_f64(0), Some(2.0));
+    }
+
+    #[test]
+    fn test_partial_tables_are_held_to_the_budget() {
+        let batch = input(20_000, 5_000);
+        let mut memory_manager = MemoryManager::new();
+        memory_manager.set_work_memory(1024 * 1024);
+        let aggregate = AdaptiveHashAggregate {
+            num_workers: 1,
+            partial_max_groups: 1 << 20,
+            passthrough_ratio: 2.0,
+            ..AdaptiveHashAggregate::default()
+        };
+        let (result, stats) = aggregate.execute(&batch, &[0], &specs(&batch), &memory_manager).unwrap();
+        check(&result, 20_000, 5_000);
+        // 不受预算约束时单个局部表只输出 5000 个部分分组
+        assert!(stats.partial_rows > 5_000, "{:?}", stats);
+        assert_eq!(memory_manager.get_stats().work_memory_allocated, 0);
+    }
+
+    #[test]
+    fn test_parse_aggregate_spec() {
+        let batch = input(1, 1);
+        let count = AggregateSpec::parse("COUNT(*)", &batch.schema).unwrap();
+        assert_eq!((count.kind, count.column), (AggregateKind::Count, None));
+        let sum = AggregateSpec::parse("sum", &batch.schema).unwrap();
+        assert_eq!((sum.kind, sum.column), (AggregateKind::Sum, Some(2)));
+        assert!(AggregateSpec::parse("median(value)", &batch.schema).is_err());
+        assert!(AggregateSpec::parse("sum(missing)", &batch.schema).is_err());
+    }
+}
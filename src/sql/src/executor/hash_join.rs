@@ -0,0 +1,705 @@
+//! 基数分区哈希连接
+//!
+//! 连接键按列类型直接哈希 (数值统一按规范化的 f64 哈希)，再按哈希高位做基数分区：
+//! 每个分区的构建侧行被收集到一块连续的列式内存 (arena) 中，哈希表只保存
+//! `u32` 行偏移的链表，不为每行单独分配。探测侧先经过由构建侧键生成的布隆过滤器，
+//! 不可能匹配的行直接跳过分区与查表。
+//!
+//! 单个分区超出 `MemoryBudget` 工作内存预算 (或超过哈希表容量上限) 时，按
+//! grace 方式把该分区的两侧写入落盘文件，之后读回并用下一段哈希位继续分区，
+//! 直到装得下或达到最大递归深度。每层分区拆出后即释放上一层的整块输入，落盘的
+//! 分区写完即释放，不在内存中保留。内连接、左/右/全外连接、半连接与反连接
+//! 共用同一套分区与探测逻辑，只是输出阶段不同。
+
+use common::{Error, Result};
+use std::path::PathBuf;
+use tracing::{debug, warn};
+
+use crate::executor::record_batch::{normalized_f64_bits, ColumnData, ColumnVector, RecordBatch, Schema};
+use crate::executor::spill::SpillFile;
+use crate::storage::memory::{MemoryBudget, MemoryReservation};
+
+/// 连接类型
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum JoinKind {
+    Inner,
+    Left,
+    Right,
+    Full,
+    /// 左半连接：输出在右侧有匹配的左侧行
+    Semi,
+    /// 左反连接：输出在右侧没有匹配的左侧行
+    Anti,
+}
+
+impl JoinKind {
+    /// 从计划中的连接类型字符串解析 (如 "Inner"、"left"、"LeftSemi")
+    pub fn parse(join_type: &str) -> Option<Self> {
+        match join_type.to_lowercase().as_str() {
+            "inner" => Some(JoinKind::Inner),
+            "left" | "leftouter" | "left_outer" => Some(JoinKind::Left),
+            "right" | "rightouter" | "right_outer" => Some(JoinKind::Right),
+            "full" | "fullouter" | "full_outer" => Some(JoinKind::Full),
+            "semi" | "leftsemi" | "left_semi" => Some(JoinKind::Semi),
+            "anti" | "leftanti" | "left_anti" => Some(JoinKind::Anti),
+            _ => None,
+        }
+    }
+
+    fn emits_pairs(self) -> bool {
+        matches!(self, JoinKind::Inner | JoinKind::Left | JoinKind::Right | JoinKind::Full)
+    }
+
+    fn emits_unmatched_build(self) -> bool {
+        matches!(self, JoinKind::Left | JoinKind::Full | JoinKind::Anti)
+    }
+
+    fn emits_unmatched_probe(self) -> bool {
+        matches!(self, JoinKind::Right | JoinKind::Full)
+    }
+}
+
+// ---------------------------------------------------------------------------
+// 强类型键哈希
+// ---------------------------------------------------------------------------
+
+const HASH_SEED: u64 = 0x51_7c_c1_b7_27_22_0a_95;
+
+#[inline]
+fn mix64(mut x: u64) -> u64 {
+    // murmur3 fmix64
+    x ^= x >> 33;
+    x = x.wrapping_mul(0xff51_afd7_ed55_8ccd);
+    x ^= x >> 33;
+    x = x.wrapping_mul(0xc4ce_b9fe_1a85_ec53);
+    x ^ (x >> 33)
+}
+
+#[inline]
+fn combine(hash: u64, value: u64) -> u64 {
+    (hash.rotate_left(5) ^ value).wrapping_mul(0x9e37_79b9_7f4a_7c15)
+}
+
+fn hash_bytes(bytes: &[u8]) -> u64 {
+    let mut hash = HASH_SEED ^ bytes.len() as u64;
+    let chunks = bytes.chunks_exact(8);
+    let tail = chunks.remainder();
+    for chunk in chunks {
+        hash = combine(hash, u64::from_le_bytes(chunk.try_into().expect("chunk has 8 bytes")));
+    }
+    let mut last = 0u64;
+    for (i, &b) in tail.iter().enumerate() {
+        last |= (b as u64) << (i * 8);
+    }
+    mix64(combine(hash, last))
+}
+
+/// 按列计算所有物理行在连接键上的哈希值
+///
+/// 逐列而不是逐行计算，每列内是针对具体类型的紧凑循环。与 `ColumnVector::hash_at`
+/// 规则相同，所有数值按规范化的 f64 位模式哈希，保证 INT / BIGINT / DOUBLE 键在
+/// 连接比较下相等时落在同一分区与同一个桶。
+pub fn hash_keys(batch: &RecordBatch, key_columns: &[usize]) -> Vec<u64> {
+    let mut hashes = vec![HASH_SEED; batch.physical_rows()];
+    for &col in key_columns {
+        let column = batch.column(col);
+        match &column.data {
+            ColumnData::Int64(v) => hashes.iter_mut().zip(v).for_each(|(h, &x)| *h = combine(*h, mix64(normalized_f64_bits(x as f64)))),
+            ColumnData::Int32(v) => hashes.iter_mut().zip(v).for_each(|(h, &x)| *h = combine(*h, mix64(normalized_f64_bits(x as f64)))),
+            ColumnData::Float64(v) => hashes.iter_mut().zip(v).for_each(|(h, &x)| *h = combine(*h, mix64(normalized_f64_bits(x)))),
+            ColumnData::Float32(v) => hashes.iter_mut().zip(v).for_each(|(h, &x)| *h = combine(*h, mix64(normalized_f64_bits(x as f64)))),
+            ColumnData::Boolean(v) => hashes.iter_mut().zip(v).for_each(|(h, &x)| *h = combine(*h, mix64(x as u64))),
+            ColumnData::Utf8(v) => hashes.iter_mut().zip(v).for_each(|(h, x)| *h = combine(*h, hash_bytes(x.as_bytes()))),
+            ColumnData::Binary(v) => hashes.iter_mut().zip(v).for_each(|(h, x)| *h = combine(*h, hash_bytes(x))),
+        }
+    }
+    // 最后再混合一次，让基数分区使用的高位也分布均匀
+    hashes.iter_mut().for_each(|h| *h = mix64(*h));
+    hashes
+}
+
+// ---------------------------------------------------------------------------
+// 布隆过滤器
+// ---------------------------------------------------------------------------
+
+/// 基于连接键哈希的布隆过滤器，探测侧用来提前剔除不可能匹配的行
+#[derive(Debug, Clone)]
+pub struct BloomFilter {
+    bits: Vec<u64>,
+    mask: u64,
+}
+
+impl BloomFilter {
+    const HASHES: u64 = 3;
+
+    /// 按每个键约 10 位分配，3 个哈希函数时误判率约 1.7%
+    pub fn with_capacity(keys: usize) -> Self {
+        let num_bits = (keys.max(1) * 10).next_power_of_two().max(64);
+        Self { bits: vec![0; num_bits / 64], mask: num_bits as u64 - 1 }
+    }
+
+    #[inline]
+    fn positions(&self, hash: u64) -> impl Iterator<Item = u64> {
+        // 双重哈希：h1 + i * h2
+        let h1 = hash;
+        let h2 = hash.rotate_left(32) | 1;
+        let mask = self.mask;
+        (0..Self::HASHES).map(move |i| h1.wrapping_add(i.wrapping_mul(h2)) & mask)
+    }
+
+    pub fn insert(&mut self, hash: u64) {
+        for bit in self.positions(hash).collect::<Vec<_>>() {
+            self.bits[(bit / 64) as usize] |= 1 << (bit % 64);
+        }
+    }
+
+    #[inline]
+    pub fn may_contain(&self, hash: u64) -> bool {
+        self.positions(hash).all(|bit| self.bits[(bit / 64) as usize] & (1 << (bit % 64)) != 0)
+    }
+}
+
+// ---------------------------------------------------------------------------
+// 分区内的哈希表
+// ---------------------------------------------------------------------------
+
+const EMPTY: u32 = u32::MAX;
+
+/// 链式哈希表，行数据留在分区的列式 arena 中，这里只保存行偏移
+struct JoinHashTable {
+    heads: Vec<u32>,
+    next: Vec<u32>,
+    mask: u64,
+}
+
+impl JoinHashTable {
+    fn build(hashes: &[u64]) -> Self {
+        let buckets = hashes.len().max(1).next_power_of_two();
+        let mask = buckets as u64 - 1;
+        let mut heads = vec![EMPTY; buckets];
+        let mut next = vec![EMPTY; hashes.len()];
+        // 倒序插入，使链表按行号升序，输出顺序与构建侧一致
+        for (row, &hash) in hashes.iter().enumerate().rev() {
+            let bucket = (hash & mask) as usize;
+            next[row] = heads[bucket];
+            heads[bucket] = row as u32;
+        }
+        Self { heads, next, mask }
+    }
+
+    /// 估算哈希表本身占用的字节数
+    fn memory_size(rows: usize) -> usize {
+        rows.max(1).next_power_of_two() * 4 + rows * (4 + 8)
+    }
+
+    fn candidates(&self, hash: u64) -> impl Iterator<Item = usize> + '_ {
+        let mut cursor = self.heads[(hash & self.mask) as usize];
+        std::iter::from_fn(move || {
+            if cursor == EMPTY {
+                return None;
+            }
+            let row = cursor as usize;
+            cursor = self.next[row];
+            Some(row)
+        })
+    }
+}
+
+// ---------------------------------------------------------------------------
+// 分区连接
+// ---------------------------------------------------------------------------
+
+/// 连接执行统计
+#[derive(Debug, Clone, Default, PartialEq)]
+pub struct HashJoinStats {
+    /// 落盘的分区数
+    pub spilled_partitions: usize,
+    /// 落盘的行数 (两侧合计)
+    pub spilled_rows: usize,
+    /// 被布隆过滤器剔除的探测行数
+    pub bloom_filtered_rows: usize,
+    /// 最大分区递归深度
+    pub max_depth: u32,
+}
+
+/// 基数分区哈希连接，左侧为构建侧，右侧为探测侧
+#[derive(Debug, Clone)]
+pub struct PartitionedHashJoin {
+    pub kind: JoinKind,
+    /// 每层分区使用的哈希位数 (扇出为 2^radix_bits)
+    pub radix_bits: u32,
+    /// 单个内存哈希表允许的最大行数
+    pub max_table_rows: usize,
+    /// 是否在探测侧使用布隆过滤器
+    pub use_bloom_filter: bool,
+    /// 落盘目录
+    pub spill_dir: PathBuf,
+    /// 最大分区递归深度，达到后即使超出预算也在内存中处理
+    pub max_depth: u32,
+    /// 匹配结果缓冲的初始容量 (行数)
+    pub initial_capacity: usize,
+}
+
+/// 一侧输入 (已去除 NULL 键的行，并物化为连续内存)
+struct JoinSide {
+    batch: RecordBatch,
+    hashes: Vec<u64>,
+}
+
+impl JoinSide {
+    fn take(&self, rows: &[usize]) -> JoinSide {
+        JoinSide {
+            batch: self.batch.take(rows),
+            hashes: rows.iter().map(|&r| self.hashes[r]).collect(),
+        }
+    }
+
+    fn rows(&self) -> usize {
+        self.batch.physical_rows()
+    }
+}
+
+/// 输出收集器
+struct JoinOutput {
+    kind: JoinKind,
+    schema: Schema,
+    pieces: Vec<RecordBatch>,
+}
+
+impl JoinOutput {
+    fn push_pairs(&mut self, build: &RecordBatch, build_rows: &[usize], probe: &RecordBatch, probe_rows: &[usize]) -> Result<()> {
+        if build_rows.is_empty() {
+            return Ok(());
+        }
+        let mut columns: Vec<ColumnVector> = build.columns.iter().map(|c| c.take(build_rows)).collect();
+        columns.extend(probe.columns.iter().map(|c| c.take(probe_rows)));
+        self.pieces.push(RecordBatch::try_new(self.schema.clone(), columns)?);
+        Ok(())
+    }
+
+    /// 未匹配的构建侧行：外连接补 NULL，半/反连接只输出构建侧列
+    fn push_build_only(&mut self, build: &RecordBatch, rows: &[usize], probe_schema: &Schema) -> Result<()> {
+        if rows.is_empty() {
+            return Ok(());
+        }
+        let mut columns: Vec<ColumnVector> = build.columns.iter().map(|c| c.take(rows)).collect();
+        if self.kind.emits_pairs() {
+            let nulls = vec![None; rows.len()];
+            columns.extend(probe_schema.fields.iter().map(|f| ColumnVector::new(f.data_type.clone()).take_opt(&nulls)));
+        }
+        self.pieces.push(RecordBatch::try_new(self.schema.clone(), columns)?);
+        Ok(())
+    }
+
+    /// 未匹配的探测侧行：左侧补 NULL
+    fn push_probe_only(&mut self, probe: &RecordBatch, rows: &[usize], build_schema: &Schema) -> Result<()> {
+        if rows.is_empty() {
+            return Ok(());
+        }
+        let nulls = vec![None; rows.len()];
+        let mut columns: Vec<ColumnVector> = build_schema
+            .fields
+            .iter()
+            .map(|f| ColumnVector::new(f.data_type.clone()).take_opt(&nulls))
+            .collect();
+        columns.extend(probe.columns.iter().map(|c| c.take(rows)));
+        self.pieces.push(RecordBatch::try_new(self.schema.clone(), columns)?);
+        Ok(())
+    }
+}
+
+impl PartitionedHashJoin {
+    pub fn new(kind: JoinKind) -> Self {
+        Self {
+            kind,
+            radix_bits: 4,
+            max_table_rows: usize::MAX,
+            use_bloom_filter: true,
+            spill_dir: std::env::temp_dir(),
+            max_depth: 3,
+            initial_capacity: 0,
+        }
+    }
+
+    /// 执行连接，返回结果批与执行统计
+    pub fn execute(
+        &self,
+        build: &RecordBatch,
+        build_keys: &[usize],
+        probe: &RecordBatch,
+        probe_keys: &[usize],
+        memory_manager: &dyn MemoryBudget,
+    ) -> Result<(RecordBatch, HashJoinStats)> {
+        if build_keys.len() != probe_keys.len() || build_keys.is_empty() {
+            return Err(Error::Execution(format!(
+                "hash join needs the same non-zero number of keys on both sides, got {} and {}",
+                build_keys.len(),
+                probe_keys.len()
+            )));
+        }
+        if self.radix_bits == 0 || self.radix_bits > 16 {
+            return Err(Error::Execution(format!("invalid radix bits {}", self.radix_bits)));
+        }
+
+        let schema = match self.kind {
+            JoinKind::Semi | JoinKind::Anti => build.schema.clone(),
+            _ => build.schema.join(&probe.schema),
+        };
+        let mut output = JoinOutput { kind: self.kind, schema: schema.clone(), pieces: Vec::new() };
+        let mut stats = HashJoinStats::default();
+
+        // NULL 键永远不匹配，直接按未匹配行处理
+        let build_hashes = hash_keys(build, build_keys);
+        let (build_rows, build_null): (Vec<usize>, Vec<usize>) =
+            build.row_indices().into_iter().partition(|&r| !build.has_null(r, build_keys));
+        let probe_hashes = hash_keys(probe, probe_keys);
+        let (mut probe_rows, probe_null): (Vec<usize>, Vec<usize>) =
+            probe.row_indices().into_iter().partition(|&r| !probe.has_null(r, probe_keys));
+
+        if self.kind.emits_unmatched_build() {
+            output.push_build_only(build, &build_null, &probe.schema)?;
+        }
+        let mut probe_unmatched = probe_null;
+
+        if self.use_bloom_filter && !probe_rows.is_empty() {
+            let mut bloom = BloomFilter::with_capacity(build_rows.len());
+            for &r in &build_rows {
+                bloom.insert(build_hashes[r]);
+            }
+            let before = probe_rows.len();
+            let (kept, rejected): (Vec<usize>, Vec<usize>) =
+                probe_rows.into_iter().partition(|&r| bloom.may_contain(probe_hashes[r]));
+            probe_rows = kept;
+            stats.bloom_filtered_rows = before - probe_rows.len();
+            probe_unmatched.extend(rejected);
+        }
+        if self.kind.emits_unmatched_probe() {
+            probe_unmatched.sort_unstable();
+            output.push_probe_only(probe, &probe_unmatched, &build.schema)?;
+        }
+
+        let build_side = JoinSide { batch: build.take(&build_rows), hashes: build_rows.iter().map(|&r| build_hashes[r]).collect() };
+        let probe_side = JoinSide { batch: probe.take(&probe_rows), hashes: probe_rows.iter().map(|&r| probe_hashes[r]).collect() };
+        self.join_partitions(build_side, probe_side, build_keys, probe_keys, 0, memory_manager, &mut output, &mut stats)?;
+
+        let result = match output.pieces.len() {
+            0 => RecordBatch::empty(schema),
+            1 => output.pieces.pop().expect("one piece"),
+            _ => RecordBatch::concat(schema, &output.pieces)?,
+        };
+        Ok((result, stats))
+    }
+
+    /// 按当前层的哈希位做基数分区 (计数排序)，返回每个分区的行号
+    fn radix_partition(&self, hashes: &[u64], level: u32) -> Vec<Vec<usize>> {
+        let fanout = 1usize << self.radix_bits;
+        let shift = 64 - self.radix_bits * (level + 1);
+        let mask = fanout as u64 - 1;
+        let mut counts = vec![0usize; fanout];
+        for &h in hashes {
+            counts[((h >> shift) & mask) as usize] += 1;
+        }
+        let mut partitions: Vec<Vec<usize>> = counts.iter().map(|&c| Vec::with_capacity(c)).collect();
+        for (row, &h) in hashes.iter().enumerate() {
+            partitions[((h >> shift) & mask) as usize].push(row);
+        }
+        partitions
+    }
+
+    #[allow(clippy::too_many_arguments)]
+    fn join_partitions(
+        &self,
+        build: JoinSide,
+        probe: JoinSide,
+        build_keys: &[usize],
+        probe_keys: &[usize],
+        level: u32,
+        memory_manager: &dyn MemoryBudget,
+        output: &mut JoinOutput,
+        stats: &mut HashJoinStats,
+    ) -> Result<()> {
+        stats.max_depth = stats.max_depth.max(level);
+        let build_parts = self.radix_partition(&build.hashes, level);
+        let probe_parts = self.radix_partition(&probe.hashes, level);
+        // 哈希位用完后不能再继续分区
+        let can_recurse = level < self.max_depth && self.radix_bits * (level + 2) <= 64;
+
+        // 各分区物化为独立的连续列式 arena 后释放本层的整块输入，之后每个分区处理完
+        // (或写入落盘文件) 即释放
+        let build_schema = build.batch.schema.clone();
+        let mut parts = Vec::with_capacity(build_parts.len());
+        for (build_rows, probe_rows) in build_parts.iter().zip(probe_parts.iter()) {
+            if build_rows.is_empty() {
+                if self.kind.emits_unmatched_probe() {
+                    output.push_probe_only(&probe.batch, probe_rows, &build_schema)?;
+                }
+                continue;
+            }
+            if probe_rows.is_empty() && !self.kind.emits_unmatched_build() {
+                continue;
+            }
+            parts.push((build.take(build_rows), probe.take(probe_rows)));
+        }
+        drop(build);
+        drop(probe);
+
+        let mut spilled: Vec<(SpillFile, SpillFile)> = Vec::new();
+        for (build_part, probe_part) in parts {
+            let needed = build_part.batch.memory_size() + JoinHashTable::memory_size(build_part.rows());
+            let fits_table = build_part.rows() <= self.max_table_rows;
+            // 预留随本轮循环结束归还，连接失败提前返回时也不会泄漏
+            let reservation = if fits_table { MemoryReservation::new(memory_manager, needed).ok() } else { None };
+            let reserved = reservation.is_some();
+
+            if !reserved && can_recurse {
+                // grace 落盘：两侧分区写入临时文件，稍后用下一段哈希位继续分区
+                let mut build_file = SpillFile::create(&self.spill_dir, "join-build", build_part.batch.schema.clone())?;
+                build_file.append(&build_part.batch)?;
+                let mut probe_file = SpillFile::create(&self.spill_dir, "join-probe", probe_part.batch.schema.clone())?;
+                probe_file.append(&probe_part.batch)?;
+                build_file.finish()?;
+                probe_file.finish()?;
+                stats.spilled_partitions += 1;
+                stats.spilled_rows += build_part.rows() + probe_part.rows();
+                spilled.push((build_file, probe_file));
+                continue;
+            }
+            if !reserved {
+                warn!(
+                    "Hash join partition with {} rows exceeds the memory budget at depth {}, joining in memory",
+                    build_part.rows(),
+                    level
+                );
+            }
+
+            self.join_in_memory(&build_part, &probe_part, build_keys, probe_keys, output)?;
+        }
+
+        for (mut build_file, mut probe_file) in spilled {
+            debug!("Reading back spilled hash join partition with {} build rows", build_file.rows());
+            let build_batch = build_file.read_all()?;
+            let probe_batch = probe_file.read_all()?;
+            let build_side = JoinSide { hashes: hash_keys(&build_batch, build_keys), batch: build_batch };
+            let probe_side = JoinSide { hashes: hash_keys(&probe_batch, probe_keys), batch: probe_batch };
+            self.join_partitions(build_side, probe_side, build_keys, probe_keys, level + 1, memory_manager, output, stats)?;
+        }
+        Ok(())
+    }
+
+    fn join_in_memory(
+        &self,
+        build: &JoinSide,
+        probe: &JoinSide,
+        build_keys: &[usize],
+        probe_keys: &[usize],
+        output: &mut JoinOutput,
+    ) -> Result<()> {
+        let table = JoinHashTable::build(&build.hashes);
+        let mut build_matched = vec![false; build.rows()];
+        let capacity = self.initial_capacity.min(probe.rows());
+        let mut pair_build = Vec::with_capacity(capacity);
+        let mut pair_probe = Vec::with_capacity(capacity);
+        let mut probe_unmatched = Vec::new();
+        let emits_pairs = self.kind.emits_pairs();
+
+        for (row, &hash) in probe.hashes.iter().enumerate() {
+            let mut matched = false;
+            for candidate in table.candidates(hash) {
+                if build.hashes[candidate] != hash
+                    || !build.batch.rows_equal(candidate, build_keys, &probe.batch, row, probe_keys)
+                {
+                    continue;
+                }
+                matched = true;
+                build_matched[candidate] = true;
+                if emits_pairs {
+                    pair_build.push(candidate);
+                    pair_probe.push(row);
+                }
+            }
+            if !matched {
+                probe_unmatched.push(row);
+            }
+        }
+
+        if emits_pairs {
+            output.push_pairs(&build.batch, &pair_build, &probe.batch, &pair_probe)?;
+        }
+        match self.kind {
+            JoinKind::Semi => {
+                let rows: Vec<usize> = (0..build.rows()).filter(|&r| build_matched[r]).collect();
+                output.push_build_only(&build.batch, &rows, &probe.batch.schema)?;
+            }
+            JoinKind::Left | JoinKind::Full | JoinKind::Anti => {
+                let rows: Vec<usize> = (0..build.rows()).filter(|&r| !build_matched[r]).collect();
+                output.push_build_only(&build.batch, &rows, &probe.batch.schema)?;
+            }
+            _ => {}
+        }
+        if self.kind.emits_unmatched_probe() {
+            output.push_probe_only(&probe.batch, &probe_unmatched, &build.batch.schema)?;
+        }
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::storage::memory::MemoryManager;
+    use crate::executor::record_batch::Field;
+    use common::{DataType, Value};
+
+    fn left_batch() -> RecordBatch {
+        let mut id = ColumnVector::new(DataType::BigInt);
+        for v in [Some(1), Some(2), Some(3), None] {
+            match v {
+                Some(v) => id.push_value(&Value::BigInt(v)),
+                None => id.push_null(),
+            }
+        }
+        RecordBatch::try_new(
+            Schema::new(vec![Field::new("id", DataType::BigInt), Field::new("name", DataType::String)]),
+            vec![id, ColumnVector::from_strs(&["Alice", "Bob", "Charlie", "Nobody"])],
+        )
+        .unwrap()
+    }
+
+    fn right_batch() -> RecordBatch {
+        // 右侧键为 INT，验证与左侧 BIGINT 键的类型提升
+        RecordBatch::try_new(
+            Schema::new(vec![Field::new("id", DataType::Integer), Field::new("dept", DataType::String)]),
+            vec![ColumnVector::from_i32(vec![1, 2, 2, 4]), ColumnVector::from_strs(&["IT", "HR", "Ops", "Finance"])],
+        )
+        .unwrap()
+    }
+
+    fn run(kind: JoinKind, join: Option<PartitionedHashJoin>, memory: &MemoryManager) -> (Vec<Vec<String>>, HashJoinStats) {
+        let join = join.unwrap_or_else(|| PartitionedHashJoin::new(kind));
+        let (batch, stats) = join.execute(&left_batch(), &[0], &right_batch(), &[0], memory).unwrap();
+        let mut rows = batch.into_query_result().rows;
+        rows.sort();
+        (rows, stats)
+    }
+
+    fn row(values: &[&str]) -> Vec<String> {
+        values.iter().map(|v| v.to_string()).collect()
+    }
+
+    #[test]
+    fn test_join_kinds_share_one_implementation() {
+        let memory = MemoryManager::new();
+
+        let (rows, _) = run(JoinKind::Inner, None, &memory);
+        assert_eq!(rows, vec![row(&["1", "Alice", "1", "IT"]), row(&["2", "Bob", "2", "HR"]), row(&["2", "Bob", "2", "Ops"])]);
+
+        let (rows, _) = run(JoinKind::Left, None, &memory);
+        assert_eq!(rows.len(), 5);
+        assert!(rows.contains(&row(&["", "Nobody", "", ""])));
+        assert!(rows.contains(&row(&["3", "Charlie", "", ""])));
+
+        let (rows, _) = run(JoinKind::Right, None, &memory);
+        assert_eq!(rows.len(), 4);
+        assert!(rows.contains(&row(&["", "", "4", "Finance"])));
+
+        let (rows, _) = run(JoinKind::Full, None, &memory);
+        assert_eq!(rows.len(), 6);
+
+        let (rows, _) = run(JoinKind::Semi, None, &memory);
+        assert_eq!(rows, vec![row(&["1", "Alice"]), row(&["2", "Bob"])]);
+
+        let (rows, _) = run(JoinKind::Anti, None, &memory);
+        assert_eq!(rows, vec![row(&["", "Nobody"]), row(&["3", "Charlie"])]);
+
+        // 所有预留的工作内存都已归还
+        assert_eq!(memory.get_stats().work_memory_allocated, 0);
+    }
+
+    #[test]
+    fn test_bloom_filter_skips_probe_rows() {
+        let memory = MemoryManager::new();
+        let build = left_batch();
+        let mut bloom = BloomFilter::with_capacity(3);
+        for hash in hash_keys(&build, &[0]).into_iter().take(3) {
+            bloom.insert(hash);
+        }
+        // 挑一个确定不在过滤器中的键，与一个能匹配的键一起探测
+        let miss = (100..)
+            .find(|&id| {
+                let key = RecordBatch::try_new(
+                    Schema::new(vec![Field::new("id", DataType::Integer)]),
+                    vec![ColumnVector::from_i32(vec![id])],
+                )
+                .unwrap();
+                !bloom.may_contain(hash_keys(&key, &[0])[0])
+            })
+            .unwrap();
+        let probe = RecordBatch::try_new(
+            Schema::new(vec![Field::new("id", DataType::Integer), Field::new("dept", DataType::String)]),
+            vec![ColumnVector::from_i32(vec![1, miss]), ColumnVector::from_strs(&["IT", "Finance"])],
+        )
+        .unwrap();
+        let (batch, stats) = PartitionedHashJoin::new(JoinKind::Right).execute(&build, &[0], &probe, &[0], &memory).unwrap();
+        assert_eq!(stats.bloom_filtered_rows, 1);
+        // 被剔除的行仍作为未匹配行输出
+        let mut rows = batch.into_query_result().rows;
+        rows.sort();
+        assert_eq!(rows, vec![row(&["", "", &miss.to_string(), "Finance"]), row(&["1", "Alice", "1", "IT"])]);
+
+        let mut bloom = BloomFilter::with_capacity(1000);
+        for i in 0..1000u64 {
+            bloom.insert(mix64(i));
+        }
+        assert!((0..1000u64).all(|i| bloom.may_contain(mix64(i))));
+        let false_positives = (1000..11000u64).filter(|&i| bloom.may_contain(mix64(i))).count();
+        assert!(false_positives < 500, "false positives: {}", false_positives);
+    }
+
+    #[test]
+    fn test_spills_partitions_over_budget() {
+        let mut memory = MemoryManager::new();
+        // 预算小到放不下任何分区：先落盘，最深一层再在内存中完成
+        memory.set_work_memory(16);
+        let mut join = PartitionedHashJoin::new(JoinKind::Left);
+        join.radix_bits = 1;
+        join.max_depth = 2;
+        let (rows, stats) = run(JoinKind::Left, Some(join), &memory);
+        assert_eq!(rows.len(), 5);
+        assert!(stats.spilled_partitions > 0);
+        assert_eq!(stats.max_depth, 2);
+
+        // 容量上限同样会触发落盘
+        let memory = MemoryManager::new();
+        let mut join = PartitionedHashJoin::new(JoinKind::Inner);
+        join.radix_bits = 1;
+        join.max_table_rows = 0;
+        let (rows, stats) = run(JoinKind::Inner, Some(join), &memory);
+        assert_eq!(rows.len(), 3);
+        assert!(stats.spilled_rows > 0);
+    }
+
+    #[test]
+    fn test_numeric_keys_match_across_types() {
+        // DOUBLE 键与 INT / BIGINT 键相等时同样匹配，不因哈希不同落入不同分区
+        let build = left_batch();
+        let probe = RecordBatch::try_new(
+            Schema::new(vec![Field::new("id", DataType::Double)]),
+            vec![ColumnVector::from_f64(vec![2.0, 2.5, 3.0])],
+        )
+        .unwrap();
+        let memory = MemoryManager::new();
+        let (batch, _) = PartitionedHashJoin::new(JoinKind::Inner).execute(&build, &[0], &probe, &[0], &memory).unwrap();
+        let mut rows = batch.into_query_result().rows;
+        rows.sort();
+        assert_eq!(rows, vec![row(&["2", "Bob", "2"]), row(&["3", "Charlie", "3"])]);
+        assert_eq!(hash_keys(&build, &[0])[1], hash_keys(&probe, &[0])[0]);
+    }
+
+    #[test]
+    fn test_hash_keys_promote_integers() {
+        let left = left_batch();
+        let right = right_batch();
+        assert_eq!(hash_keys(&left, &[0])[0], hash_keys(&right, &[0])[0]);
+        assert_ne!(hash_keys(&left, &[0])[0], hash_keys(&left, &[0])[1]);
+    }
+}
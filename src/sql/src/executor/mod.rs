@@ -3,20 +3,39 @@
 //! 负责查询执行，包括各种执行模型和操作符
 
 pub mod execution_models;
+pub mod record_batch;
+pub mod vector_kernels;
+pub mod compiled_expr;
+pub mod profile;
+pub mod spill;
+pub mod hash_join;
+pub mod hash_agg;
+pub mod exchange;
+pub mod partial_agg;
+pub mod sort_key;
+pub mod external_sort;
+pub mod morsel;
 pub mod operators;
 pub mod executor;
 pub mod parallel_executor;
 pub mod storage_executor;
+pub mod result_stream;
 
 // 重新导出执行器相关类型
 pub use executor::Executor;
 pub use execution_models::ExecutionEngine;
 
 // 重新导出基础操作符 trait
-pub use operators::operator_trait::Operator;
+pub use operators::operator_trait::{Operator, ColumnarOperator};
+
+// 重新导出列式批类型
+pub use record_batch::{RecordBatch, ColumnVector, ColumnData, Bitmap, Schema, Field, RowHashIndex};
 
 // 重新导出存储感知执行器
 pub use storage_executor::{StorageExecutor, StorageOperationType};
+
+// 重新导出流式结果集
+pub use result_stream::{CancelHandle, LimitSource, MaterializedSource, ResultStream, RowSource, TopNSource};
 pub use storage::{StorageOperation, StorageOperationResult, EngineType};
 
 // 重新导出扫描操作符
@@ -48,6 +67,7 @@ pub use operators::aggregate_operators::{
 pub use operators::sort_operators::{
     SortOperator,
     ExternalSortOperator,
+    ExternalSortSource,
     TopNOperator,
 };
 
@@ -0,0 +1,383 @@
+//! Morsel 驱动的工作窃取调度器
+//!
+//! 扫描按键范围切分为小块 (morsel)，预先分配到每个工作线程的本地双端队列。
+//! 工作线程从自己队列的头部取 morsel，并在线程内把整条算子流水线运行到底，
+//! 数据在 morsel 生命周期内始终留在同一核心的缓存中；本地队列耗尽后再从其他
+//! 线程队列的尾部窃取，避免数据倾斜时多数核心空转，也不再依赖静态的 chunk_size。
+
+use common::{Error, Result};
+use std::collections::VecDeque;
+use std::sync::atomic::{AtomicBool, AtomicUsize, Ordering};
+use std::sync::Mutex;
+use std::thread;
+use std::time::{Duration, Instant};
+use storage::codec;
+use tracing::debug;
+
+/// 每个工作线程默认分到的 morsel 数；数量越多负载越均衡，调度开销也越大
+pub const DEFAULT_MORSELS_PER_WORKER: usize = 4;
+
+/// 左闭右开的键范围 `[start, end)`
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct KeyRange {
+    pub start: Vec<u8>,
+    pub end: Vec<u8>,
+}
+
+impl KeyRange {
+    pub fn new(start: Vec<u8>, end: Vec<u8>) -> Self {
+        Self { start, end }
+    }
+
+    /// 整张表的行键范围，与 `StorageHandler` 的行键布局 (`codec::record_prefix`) 一致
+    pub fn for_table(table: &str) -> Self {
+        let start = codec::record_prefix(table).to_vec();
+        let end = codec::prefix_end(&start).to_vec();
+        Self { start, end }
+    }
+
+    /// 与 `[start, end)` 的交集，为空时返回 None
+    pub fn intersect(&self, start: &[u8], end: &[u8]) -> Option<KeyRange> {
+        let start = self.start.as_slice().max(start);
+        let end = self.end.as_slice().min(end);
+        (start < end).then(|| KeyRange::new(start.to_vec(), end.to_vec()))
+    }
+
+    /// 按字典序把范围切成至多 `parts` 段，相邻段首尾相接、覆盖整个范围
+    ///
+    /// 去掉公共前缀后取其后 8 个字节作为大端整数线性插值，
+    /// 对键分布一无所知时这是代价最低的均分方式。
+    pub fn split(&self, parts: usize) -> Vec<KeyRange> {
+        if parts <= 1 || self.start >= self.end {
+            return vec![self.clone()];
+        }
+
+        let prefix_len = self
+            .start
+            .iter()
+            .zip(self.end.iter())
+            .take_while(|(a, b)| a == b)
+            .count();
+        let low = Self::suffix_value(&self.start[prefix_len..]);
+        let high = Self::suffix_value(&self.end[prefix_len..]);
+        if high <= low {
+            return vec![self.clone()];
+        }
+
+        let parts = parts.min((high - low) as usize).max(1);
+        let width = (high - low) as u128;
+        let mut ranges = Vec::with_capacity(parts);
+        let mut start = self.start.clone();
+        for i in 1..parts {
+            let point = low + (width * i as u128 / parts as u128) as u64;
+            let mut boundary = self.start[..prefix_len].to_vec();
+            boundary.extend_from_slice(&point.to_be_bytes());
+            ranges.push(KeyRange::new(start, boundary.clone()));
+            start = boundary;
+        }
+        ranges.push(KeyRange::new(start, self.end.clone()));
+        ranges
+    }
+
+    fn suffix_value(bytes: &[u8]) -> u64 {
+        let mut buf = [0u8; 8];
+        let n = bytes.len().min(8);
+        buf[..n].copy_from_slice(&bytes[..n]);
+        u64::from_be_bytes(buf)
+    }
+}
+
+/// 调度器累计统计
+#[derive(Debug, Clone, Default)]
+pub struct MorselSchedulerStats {
+    /// 调度的查询片段数
+    pub runs: u64,
+    /// 执行完成的 morsel 数
+    pub morsels_executed: u64,
+    /// 从其他线程队列窃取的 morsel 数
+    pub steals: u64,
+    /// 所有工作线程执行 morsel 的累计时间
+    pub busy_time: Duration,
+    /// 工作线程存活时间之和 (线程数 × 墙钟时间)
+    pub worker_time: Duration,
+    /// 最近一次调度的线程利用率
+    pub last_utilization: f64,
+}
+
+impl MorselSchedulerStats {
+    /// 累计线程利用率，1.0 表示所有线程从未空等
+    pub fn utilization(&self) -> f64 {
+        if self.worker_time.is_zero() {
+            return 0.0;
+        }
+        self.busy_time.as_secs_f64() / self.worker_time.as_secs_f64()
+    }
+}
+
+/// 单个工作线程一次调度的产出
+struct WorkerOutput<T> {
+    results: Vec<(usize, T)>,
+    executed: u64,
+    steals: u64,
+    busy_time: Duration,
+}
+
+/// 工作窃取调度器
+///
+/// morsel 与线程之间没有静态绑定，因此并行度可以在两次调度之间随时调整。
+#[derive(Debug)]
+pub struct MorselScheduler {
+    num_workers: AtomicUsize,
+    stats: Mutex<MorselSchedulerStats>,
+}
+
+impl MorselScheduler {
+    pub fn new(num_workers: usize) -> Self {
+        Self {
+            num_workers: AtomicUsize::new(num_workers.max(1)),
+            stats: Mutex::new(MorselSchedulerStats::default()),
+        }
+    }
+
+    pub fn num_workers(&self) -> usize {
+        self.num_workers.load(Ordering::Relaxed)
+    }
+
+    /// 调整后续调度使用的线程数
+    pub fn set_num_workers(&self, num_workers: usize) {
+        self.num_workers.store(num_workers.max(1), Ordering::Relaxed);
+    }
+
+    pub fn stats(&self) -> MorselSchedulerStats {
+        self.stats.lock().unwrap().clone()
+    }
+
+    /// 在工作线程上对每个 morsel 运行 `pipeline`，结果按 morsel 的输入顺序返回
+    ///
+    /// 任一 morsel 失败后其余线程不再领取新的 morsel，并返回第一个错误。
+    pub fn run<M, T, F>(&self, morsels: Vec<M>, pipeline: F) -> Result<Vec<T>>
+    where
+        M: Send,
+        T: Send,
+        F: Fn(usize, M) -> Result<T> + Sync,
+    {
+        self.run_with_workers(self.num_workers(), morsels, pipeline)
+    }
+
+    /// 与 `run` 相同，但本次调度最多使用 `max_workers` 个线程
+    pub fn run_with_workers<M, T, F>(&self, max_workers: usize, morsels: Vec<M>, pipeline: F) -> Result<Vec<T>>
+    where
+        M: Send,
+        T: Send,
+        F: Fn(usize, M) -> Result<T> + Sync,
+    {
+        let total = morsels.len();
+        let workers = max_workers.min(total).max(1);
+        let started = Instant::now();
+
+        let outputs = if workers == 1 {
+            // 单线程无需调度，直接在调用线程上运行
+            let mut output = WorkerOutput { results: Vec::with_capacity(total), executed: 0, steals: 0, busy_time: Duration::ZERO };
+            for (index, morsel) in morsels.into_iter().enumerate() {
+                output.results.push((index, pipeline(0, morsel)?));
+                output.executed += 1;
+            }
+            output.busy_time = started.elapsed();
+            vec![output]
+        } else {
+            self.run_on_workers(morsels, workers, &pipeline)?
+        };
+
+        let wall_time = started.elapsed();
+        let mut results: Vec<(usize, T)> = Vec::with_capacity(total);
+        {
+            let mut stats = self.stats.lock().unwrap();
+            let mut busy_time = Duration::ZERO;
+            stats.runs += 1;
+            for output in outputs {
+                stats.morsels_executed += output.executed;
+                stats.steals += output.steals;
+                busy_time += output.busy_time;
+                results.extend(output.results);
+            }
+            let worker_time = wall_time * workers as u32;
+            stats.busy_time += busy_time;
+            stats.worker_time += worker_time;
+            stats.last_utilization = if worker_time.is_zero() {
+                1.0
+            } else {
+                (busy_time.as_secs_f64() / worker_time.as_secs_f64()).min(1.0)
+            };
+        }
+
+        results.sort_unstable_by_key(|(index, _)| *index);
+        debug!("Morsel scheduler executed {} morsels on {} workers in {:?}", total, workers, wall_time);
+        Ok(results.into_iter().map(|(_, result)| result).collect())
+    }
+
+    fn run_on_workers<M, T, F>(&self, morsels: Vec<M>, workers: usize, pipeline: &F) -> Result<Vec<WorkerOutput<T>>>
+    where
+        M: Send,
+        T: Send,
+        F: Fn(usize, M) -> Result<T> + Sync,
+    {
+        // 相邻 morsel 分给同一线程，保持扫描的局部性；窃取时从队尾拿，远离队主正在处理的位置
+        let total = morsels.len();
+        let queues: Vec<Mutex<VecDeque<(usize, M)>>> =
+            (0..workers).map(|_| Mutex::new(VecDeque::new())).collect();
+        for (index, morsel) in morsels.into_iter().enumerate() {
+            queues[index * workers / total].lock().unwrap().push_back((index, morsel));
+        }
+
+        let aborted = AtomicBool::new(false);
+        let first_error: Mutex<Option<Error>> = Mutex::new(None);
+
+        let outputs = thread::scope(|scope| {
+            let handles: Vec<_> = (0..workers)
+                .map(|worker_id| {
+                    let queues = &queues;
+                    let aborted = &aborted;
+                    let first_error = &first_error;
+                    scope.spawn(move || {
+                        let mut output = WorkerOutput { results: Vec::new(), executed: 0, steals: 0, busy_time: Duration::ZERO };
+                        while !aborted.load(Ordering::Relaxed) {
+                            let local = queues[worker_id].lock().unwrap().pop_front();
+                            let (index, morsel) = match local {
+                                Some(item) => item,
+                                None => match Self::steal(queues, worker_id) {
+                                    Some(item) => {
+                                        output.steals += 1;
+                                        item
+                                    }
+                                    // 调度期间不会产生新 morsel，所有队列为空即可退出
+                                    None => break,
+                                },
+                            };
+
+                            let started = Instant::now();
+                            let result = pipeline(worker_id, morsel);
+                            output.busy_time += started.elapsed();
+                            match result {
+                                Ok(result) => {
+                                    output.results.push((index, result));
+                                    output.executed += 1;
+                                }
+                                Err(e) => {
+                                    aborted.store(true, Ordering::Relaxed);
+                                    first_error.lock().unwrap().get_or_insert(e);
+                                    break;
+                                }
+                            }
+                        }
+                        output
+                    })
+                })
+                .collect();
+
+            handles
+                .into_iter()
+                .map(|handle| handle.join().map_err(|_| Error::Execution("morsel worker panicked".to_string())))
+                .collect::<Result<Vec<_>>>()
+        })?;
+
+        if let Some(e) = first_error.into_inner().unwrap() {
+            return Err(e);
+        }
+        Ok(outputs)
+    }
+
+    /// 从剩余最多的队列尾部窃取一个 morsel
+    fn steal<M>(queues: &[Mutex<VecDeque<(usize, M)>>], thief: usize) -> Option<(usize, M)> {
+        loop {
+            let victim = (0..queues.len())
+                .filter(|&i| i != thief)
+                .map(|i| (i, queues[i].lock().unwrap().len()))
+                .filter(|&(_, len)| len > 0)
+                .max_by_key(|&(_, len)| len)?
+                .0;
+            // 挑选与窃取之间队列可能已被抽空，此时重新挑选
+            if let Some(item) = queues[victim].lock().unwrap().pop_back() {
+                return Some(item);
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::collections::HashSet;
+
+    #[test]
+    fn test_key_range_split_covers_range() {
+        let range = KeyRange::for_table("t");
+        let parts = range.split(8);
+        assert_eq!(parts.len(), 8);
+        assert_eq!(parts.first().unwrap().start, range.start);
+        assert_eq!(parts.last().unwrap().end, range.end);
+        for pair in parts.windows(2) {
+            assert_eq!(pair[0].end, pair[1].start);
+        }
+        for part in &parts {
+            assert!(part.start < part.end);
+        }
+        // 表的每一行恰好落在一个 morsel 里
+        for id in [0i64, 1, 1 << 20, i64::MAX] {
+            let key = codec::record_key("t", &[codec::Datum::Int(id)]).to_vec();
+            assert_eq!(parts.iter().filter(|p| p.start <= key && key < p.end).count(), 1);
+        }
+
+        // 范围过窄时不会切出空段
+        let narrow = KeyRange::new(b"a".to_vec(), b"b".to_vec());
+        assert!(narrow.split(4).iter().all(|r| r.start < r.end));
+        assert_eq!(KeyRange::new(b"b".to_vec(), b"a".to_vec()).split(4).len(), 1);
+    }
+
+    #[test]
+    fn test_scheduler_preserves_order_and_steals_on_skew() {
+        let scheduler = MorselScheduler::new(4);
+        // 第一个线程分到的 morsel 明显更慢，其余线程应当窃取它队列里的剩余部分
+        let morsels: Vec<usize> = (0..32).collect();
+        let results = scheduler
+            .run(morsels, |_, i| {
+                if i < 8 {
+                    thread::sleep(Duration::from_millis(5));
+                }
+                Ok(i * 2)
+            })
+            .unwrap();
+        assert_eq!(results, (0..32).map(|i| i * 2).collect::<Vec<_>>());
+
+        let stats = scheduler.stats();
+        assert_eq!(stats.runs, 1);
+        assert_eq!(stats.morsels_executed, 32);
+        assert!(stats.steals > 0);
+    }
+
+    #[test]
+    fn test_scheduler_runs_on_multiple_workers() {
+        let scheduler = MorselScheduler::new(3);
+        let seen = Mutex::new(HashSet::new());
+        scheduler
+            .run((0..12).collect(), |worker, _: usize| {
+                seen.lock().unwrap().insert(worker);
+                thread::sleep(Duration::from_millis(2));
+                Ok(())
+            })
+            .unwrap();
+        assert!(seen.lock().unwrap().len() > 1);
+    }
+
+    #[test]
+    fn test_scheduler_propagates_error() {
+        let scheduler = MorselScheduler::new(4);
+        let result = scheduler.run((0..16).collect(), |_, i: usize| {
+            if i == 5 {
+                Err(Error::Execution("boom".to_string()))
+            } else {
+                Ok(i)
+            }
+        });
+        assert!(matches!(result, Err(Error::Execution(msg)) if msg == "boom"));
+    }
+}
@@ -1,16 +1,19 @@
-use common::Result;
+use common::{DataType, Result};
 use std::sync::Arc;
 use std::collections::HashMap;
 use async_trait::async_trait;
 use tracing::{debug, info, warn};
+use std::path::PathBuf;
 use std::time::Duration;
 use tokio::time;
 
 use crate::executor::execution_models::QueryResult;
+use crate::executor::hash_agg::{AdaptiveHashAggregate, AggregateSpec};
+use crate::executor::record_batch::{ColumnVector, Field, RecordBatch, Schema};
 use crate::storage::buffer_pool::{BufferPool, PageId};
-use crate::storage::memory::MemoryManager;
+use crate::storage::memory::{MemoryBudget, MemoryManager, OperatorMemoryContext};
 use crate::storage::worker_pool::WorkerPool;
-use super::operator_trait::Operator;
+use super::operator_trait::{ColumnarOperator, Operator};
 
 /// 聚合操作符
 #[derive(Debug)]
@@ -41,7 +44,7 @@ impl AggregateOperator {
               self.group_by, self.aggregates);
 
         // 分配工作内存
-        let work_memory = self.memory_manager.allocate_work_memory(1024 * 1024)?;
+        let _work_memory = self.memory_manager.work_memory(1024 * 1024)?;
 
         let mut groups: HashMap<String, Vec<Vec<String>>> = HashMap::new();
 
@@ -58,9 +61,6 @@ impl AggregateOperator {
             result_rows.push(aggregated_row);
         }
 
-        // 释放工作内存
-        self.memory_manager.free_memory(work_memory);
-
         Ok(result_rows)
     }
 
@@ -208,15 +208,27 @@ impl Operator for AggregateOperator {
 }
 
 /// Hash聚合操作符
+///
+/// 基于 `AdaptiveHashAggregate`：各工作线程先做部分聚合 (缩减率过低时切换为直通)，
+/// 再按分组键分区合并，超出工作内存预算的分区落盘到 `spill_dir` 后再递归合并。
 #[derive(Debug)]
 pub struct HashAggOperator {
     pub input: crate::optimizer::PlanNode,
     pub group_by: Vec<String>,
     pub aggregates: Vec<String>,
     pub memory_manager: Arc<MemoryManager>,
+    /// 查询内的算子预算，设置后代替全局工作内存预算决定落盘
+    pub memory_context: Option<Arc<OperatorMemoryContext>>,
     pub buffer_pool: Arc<BufferPool>,
+    /// 每个线程局部聚合表的分组上限
     pub hash_table_size: usize,
     pub group_keys: Vec<String>,
+    /// 部分聚合的工作线程数
+    pub num_workers: usize,
+    /// 分组数与行数之比不低于该值时部分聚合切换为直通
+    pub passthrough_ratio: f64,
+    /// 分区落盘目录
+    pub spill_dir: String,
 }
 
 impl HashAggOperator {
@@ -227,14 +239,19 @@ impl HashAggOperator {
         memory_manager: Arc<MemoryManager>,
         buffer_pool: Arc<BufferPool>,
     ) -> Self {
+        let defaults = AdaptiveHashAggregate::default();
         Self {
             input,
             group_by,
             aggregates,
             memory_manager,
+            memory_context: None,
             buffer_pool,
             hash_table_size: 10000,
             group_keys: vec!["name".to_string()],
+            num_workers: defaults.num_workers,
+            passthrough_ratio: defaults.passthrough_ratio,
+            spill_dir: std::env::temp_dir().to_string_lossy().into_owned(),
         }
     }
 
@@ -246,173 +263,83 @@ impl HashAggOperator {
         self.group_keys = keys;
     }
 
-    async fn perform_hash_aggregation(&self, input_data: QueryResult) -> Result<Vec<Vec<String>>> {
-        info!("Performing hash aggregation with hash table size: {}", self.hash_table_size);
-
-        // 分配工作内存
-        let work_memory = self.memory_manager.allocate_work_memory(1024 * 1024)?;
-
-        // 使用哈希表进行分组
-        let mut hash_table: HashMap<String, Vec<Vec<String>>> = HashMap::new();
-
-        for row in &input_data.rows {
-            let group_key = self.extract_group_key(row, &input_data.columns)?;
-            hash_table.entry(group_key).or_insert_with(Vec::new).push(row.clone());
-        }
-
-        // 对每个分组进行聚合
-        let mut result_rows = Vec::new();
-        for (group_key, rows) in hash_table {
-            let aggregated_row = self.aggregate_group(&group_key, &rows, &input_data.columns)?;
-            result_rows.push(aggregated_row);
-        }
+    pub fn set_num_workers(&mut self, workers: usize) {
+        self.num_workers = workers;
+    }
 
-        // 释放工作内存
-        self.memory_manager.free_memory(work_memory);
+    pub fn set_passthrough_ratio(&mut self, ratio: f64) {
+        self.passthrough_ratio = ratio;
+    }
 
-        Ok(result_rows)
+    pub fn set_spill_dir(&mut self, spill_dir: String) {
+        self.spill_dir = spill_dir;
     }
 
-    fn extract_group_key(&self, row: &[String], columns: &[String]) -> Result<String> {
-        let mut key_parts = Vec::new();
+    pub fn set_memory_context(&mut self, context: Arc<OperatorMemoryContext>) {
+        self.memory_context = Some(context);
+    }
 
-        for group_key in &self.group_keys {
-            if let Some(col_index) = columns.iter().position(|c| c == group_key) {
-                if col_index < row.len() {
-                    key_parts.push(row[col_index].clone());
-                }
-            }
+    fn budget(&self) -> &dyn MemoryBudget {
+        match &self.memory_context {
+            Some(context) => context.as_ref(),
+            None => self.memory_manager.as_ref(),
         }
-
-        Ok(key_parts.join("|"))
     }
 
-    fn aggregate_group(&self, group_key: &str, rows: &[Vec<String>], columns: &[String]) -> Result<Vec<String>> {
-        let mut result_row = Vec::new();
+    /// 对输入批按 `group_keys` 做哈希聚合
+    pub async fn perform_hash_aggregation(&self, input_data: &RecordBatch) -> Result<RecordBatch> {
+        info!("Performing hash aggregation with hash table size: {}", self.hash_table_size);
 
-        // 添加分组键
-        for key_part in group_key.split('|') {
-            result_row.push(key_part.to_string());
-        }
+        let key_columns = input_data.resolve_columns(&self.group_keys)?;
+        let aggregates = self
+            .aggregates
+            .iter()
+            .map(|a| AggregateSpec::parse(a, &input_data.schema))
+            .collect::<Result<Vec<_>>>()?;
 
-        // 计算聚合函数
-        for aggregate in &self.aggregates {
-            let aggregate_value = self.calculate_aggregate(aggregate, rows, columns)?;
-            result_row.push(aggregate_value);
-        }
-
-        Ok(result_row)
-    }
+        let mut aggregate = AdaptiveHashAggregate::default();
+        aggregate.num_workers = self.num_workers;
+        aggregate.partial_max_groups = self.hash_table_size.max(1);
+        aggregate.passthrough_ratio = self.passthrough_ratio;
+        aggregate.spill_dir = PathBuf::from(&self.spill_dir);
 
-    fn calculate_aggregate(&self, aggregate: &str, rows: &[Vec<String>], columns: &[String]) -> Result<String> {
-        if rows.is_empty() {
-            return Ok("0".to_string());
-        }
+        let (aggregated, stats) = aggregate.execute(input_data, &key_columns, &aggregates, self.budget())?;
+        debug!("Hash aggregate stats: {:?}", stats);
 
-        match aggregate.to_lowercase().as_str() {
-            "count" => Ok(rows.len().to_string()),
-            "sum" => {
-                let mut sum = 0.0;
-                for row in rows {
-                    if let Some(col_index) = columns.iter().position(|c| c == "value") {
-                        if col_index < row.len() {
-                            if let Ok(val) = row[col_index].parse::<f64>() {
-                                sum += val;
-                            }
-                        }
-                    }
-                }
-                Ok(sum.to_string())
-            }
-            "avg" => {
-                let mut sum = 0.0;
-                let mut count = 0;
-                for row in rows {
-                    if let Some(col_index) = columns.iter().position(|c| c == "value") {
-                        if col_index < row.len() {
-                            if let Ok(val) = row[col_index].parse::<f64>() {
-                                sum += val;
-                                count += 1;
-                            }
-                        }
-                    }
-                }
-                if count > 0 {
-                    Ok((sum / count as f64).to_string())
-                } else {
-                    Ok("0".to_string())
-                }
-            }
-            "max" => {
-                let mut max_val = f64::NEG_INFINITY;
-                for row in rows {
-                    if let Some(col_index) = columns.iter().position(|c| c == "value") {
-                        if col_index < row.len() {
-                            if let Ok(val) = row[col_index].parse::<f64>() {
-                                max_val = max_val.max(val);
-                            }
-                        }
-                    }
-                }
-                if max_val == f64::NEG_INFINITY {
-                    Ok("0".to_string())
-                } else {
-                    Ok(max_val.to_string())
-                }
-            }
-            "min" => {
-                let mut min_val = f64::INFINITY;
-                for row in rows {
-                    if let Some(col_index) = columns.iter().position(|c| c == "value") {
-                        if col_index < row.len() {
-                            if let Ok(val) = row[col_index].parse::<f64>() {
-                                min_val = min_val.min(val);
-                            }
-                        }
-                    }
-                }
-                if min_val == f64::INFINITY {
-                    Ok("0".to_string())
-                } else {
-                    Ok(min_val.to_string())
-                }
-            }
-            _ => {
-                warn!("Unknown aggregate function: {}", aggregate);
-                Ok("0".to_string())
-            }
-        }
+        Ok(aggregated)
     }
 }
 
 #[async_trait]
-impl Operator for HashAggOperator {
-    async fn execute(&self) -> Result<QueryResult> {
+impl ColumnarOperator for HashAggOperator {
+    async fn execute_columnar(&self) -> Result<RecordBatch> {
         debug!("Executing hash aggregate operation");
 
         // 模拟输入数据
-        let input_data = QueryResult {
-            columns: vec!["id".to_string(), "name".to_string(), "value".to_string()],
-            rows: vec![
-                vec!["1".to_string(), "Alice".to_string(), "100".to_string()],
-                vec!["2".to_string(), "Bob".to_string(), "200".to_string()],
-                vec!["3".to_string(), "Alice".to_string(), "150".to_string()],
-                vec!["4".to_string(), "Charlie".to_string(), "300".to_string()],
-                vec!["5".to_string(), "Bob".to_string(), "250".to_string()],
+        let input_data = RecordBatch::try_new(
+            Schema::new(vec![
+                Field::new("id", DataType::BigInt),
+                Field::new("name", DataType::String),
+                Field::new("value", DataType::BigInt),
+            ]),
+            vec![
+                ColumnVector::from_i64(vec![1, 2, 3, 4, 5]),
+                ColumnVector::from_strs(&["Alice", "Bob", "Alice", "Charlie", "Bob"]),
+                ColumnVector::from_i64(vec![100, 200, 150, 300, 250]),
             ],
-            affected_rows: 5,
-            last_insert_id: None,
-        };
+        )?;
 
-        let aggregated_rows = self.perform_hash_aggregation(input_data).await?;
+        let aggregated = self.perform_hash_aggregation(&input_data).await?;
 
-        let mut result = QueryResult::new();
-        result.columns = vec!["name".to_string(), "count".to_string(), "sum".to_string(), "avg".to_string()];
-        result.rows = aggregated_rows;
-        result.affected_rows = result.rows.len() as u64;
+        info!("Hash aggregation completed, returned {} rows", aggregated.num_rows());
+        Ok(aggregated)
+    }
+}
 
-        info!("Hash aggregation completed, returned {} rows", result.affected_rows);
-        Ok(result)
+#[async_trait]
+impl Operator for HashAggOperator {
+    async fn execute(&self) -> Result<QueryResult> {
+        Ok(self.execute_columnar().await?.into_query_result())
     }
 }
 
@@ -459,7 +386,7 @@ impl GroupAggOperator {
         info!("Performing group aggregation with batch size: {}", self.batch_size);
 
         // 分配工作内存
-        let work_memory = self.memory_manager.allocate_work_memory(1024 * 1024)?;
+        let _work_memory = self.memory_manager.work_memory(1024 * 1024)?;
 
         // 对数据进行排序
         let sorted_data = self.sort_data(input_data.rows, &input_data.columns)?;
@@ -489,9 +416,6 @@ impl GroupAggOperator {
             result_rows.push(aggregated_row);
         }
 
-        // 释放工作内存
-        self.memory_manager.free_memory(work_memory);
-
         Ok(result_rows)
     }
 
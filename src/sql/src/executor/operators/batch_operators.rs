@@ -1,4 +1,4 @@
-use common::Result;
+use common::{DataType, Result};
 use std::sync::Arc;
 use std::collections::HashMap;
 use async_trait::async_trait;
@@ -7,6 +7,8 @@ use std::time::Duration;
 use tokio::time;
 
 use crate::executor::execution_models::QueryResult;
+use crate::executor::record_batch::{ColumnVector, Field, RecordBatch, Schema};
+use crate::executor::vector_kernels::{self, f64_values};
 use crate::storage::buffer_pool::{BufferPool, PageId};
 use crate::storage::memory::MemoryManager;
 use crate::storage::worker_pool::WorkerPool;
@@ -17,11 +19,57 @@ use super::operator_trait::Operator;
 pub struct BatchScanOperator {
     pub table: String,
     pub columns: Vec<String>,
+    /// 模拟表的行数
+    pub row_count: usize,
 }
 
 impl BatchScanOperator {
     pub fn new(table: String, columns: Vec<String>) -> Self {
-        Self { table, columns }
+        Self { table, columns, row_count: 3 }
+    }
+
+    pub fn set_row_count(&mut self, row_count: usize) {
+        self.row_count = row_count;
+    }
+
+    /// 以定长列式向量输出扫描结果，每个批不超过 batch_size 行
+    ///
+    /// 即使表为空也至少返回一个空批，保证下游算子拿得到输出模式。
+    pub async fn scan_batches(&self, batch_size: usize) -> Result<Vec<RecordBatch>> {
+        info!("Executing vectorized scan on table: {}", self.table);
+
+        const NAMES: [&str; 3] = ["Alice", "Bob", "Charlie"];
+        let all_fields = vec![
+            Field::new("id", DataType::BigInt),
+            Field::new("name", DataType::String),
+            Field::new("value", DataType::BigInt),
+        ];
+        let schema = Schema::new(all_fields);
+        let projection: Vec<usize> = self.columns.iter().filter_map(|c| schema.index_of(c)).collect();
+
+        let batch_size = batch_size.max(1);
+        let mut batches = Vec::with_capacity(self.row_count / batch_size + 1);
+        let mut start = 0;
+        loop {
+            let end = (start + batch_size).min(self.row_count);
+            // 模拟数据：id 从 1 开始，value = id * 100
+            let ids: Vec<i64> = (start as i64 + 1..=end as i64).collect();
+            let names: Vec<String> = (start..end).map(|i| NAMES[i % NAMES.len()].to_string()).collect();
+            let values: Vec<i64> = ids.iter().map(|id| id * 100).collect();
+            let batch = RecordBatch::try_new(
+                schema.clone(),
+                vec![ColumnVector::from_i64(ids), ColumnVector::from_strings(names), ColumnVector::from_i64(values)],
+            )?;
+            // 未指定已知列 (如 `*`) 时输出全部列
+            batches.push(if projection.is_empty() { batch } else { batch.project(&projection) });
+            start = end;
+            if start >= self.row_count {
+                break;
+            }
+        }
+
+        debug!("Vectorized scan produced {} batches", batches.len());
+        Ok(batches)
     }
 
     pub async fn execute_batch(&self) -> Result<QueryResult> {
@@ -142,6 +190,85 @@ impl BatchAggregateOperator {
         }
     }
 
+    /// 对一组输入向量做分组聚合
+    ///
+    /// 无分组键时直接在稠密数值切片上调用求和/极值内核；有分组键时先为整批
+    /// 计算分组号，再按聚合函数逐列累加，避免逐行分派聚合类型。
+    /// 聚合函数写作 `sum(col)` 或 `sum` (后者沿用其他聚合算子的约定作用于 value 列)。
+    pub fn aggregate_batches(&self, batches: &[RecordBatch]) -> Result<RecordBatch> {
+        let specs: Vec<AggregateSpec> = self.aggregates.iter().map(|a| AggregateSpec::parse(a)).collect();
+        let mut accumulators: Vec<AggregateAccumulator> = specs.iter().map(|_| AggregateAccumulator::default()).collect();
+
+        let mut key_fields: Vec<Field> = Vec::new();
+        let mut group_keys: Vec<ColumnVector> = Vec::new();
+        let mut hash_table: HashMap<u64, Vec<usize>> = HashMap::new();
+        let mut group_count = if self.group_by.is_empty() { 1 } else { 0 };
+
+        for batch in batches {
+            let key_columns = batch.resolve_columns(&self.group_by)?;
+            if group_keys.is_empty() && !key_columns.is_empty() {
+                key_fields = key_columns.iter().map(|&c| batch.schema.fields[c].clone()).collect();
+                group_keys = key_fields.iter().map(|f| ColumnVector::new(f.data_type.clone())).collect();
+            }
+            let rows = batch.row_indices();
+
+            // 为批中每个可见行计算分组号
+            let group_ids: Option<Vec<usize>> = if key_columns.is_empty() {
+                None
+            } else {
+                let mut ids = Vec::with_capacity(rows.len());
+                for &row in &rows {
+                    let hash = batch.hash_row(row, &key_columns);
+                    let candidates = hash_table.entry(hash).or_default();
+                    let found = candidates.iter().copied().find(|&g| {
+                        key_columns.iter().zip(group_keys.iter()).all(|(&c, keys)| batch.column(c).eq_at(row, keys, g))
+                    });
+                    let group = match found {
+                        Some(group) => group,
+                        None => {
+                            for (&c, keys) in key_columns.iter().zip(group_keys.iter_mut()) {
+                                keys.append_from(batch.column(c), row);
+                            }
+                            candidates.push(group_count);
+                            group_count += 1;
+                            group_count - 1
+                        }
+                    };
+                    ids.push(group);
+                }
+                Some(ids)
+            };
+
+            for (spec, accumulator) in specs.iter().zip(accumulators.iter_mut()) {
+                accumulator.resize(group_count);
+                let column = match &spec.column {
+                    Some(name) => batch.column_by_name(name),
+                    None => None,
+                };
+                match &group_ids {
+                    None => accumulator.update_single(batch, &rows, column),
+                    Some(ids) => accumulator.update_grouped(&rows, ids, column),
+                }
+            }
+        }
+
+        let mut fields = key_fields;
+        let mut columns = group_keys;
+        if fields.is_empty() && !self.group_by.is_empty() {
+            // 没有任何输入批时无法得知分组键类型，按字符串输出空结果
+            fields = self.group_by.iter().map(|g| Field::new(g.clone(), DataType::String)).collect();
+            columns = fields.iter().map(|f| ColumnVector::new(f.data_type.clone())).collect();
+        }
+        for (spec, accumulator) in specs.iter().zip(accumulators.iter_mut()) {
+            accumulator.resize(group_count);
+            let (field, column) = accumulator.finish(spec);
+            fields.push(field);
+            columns.push(column);
+        }
+
+        RecordBatch::try_new(Schema::new(fields), columns)
+    }
+
     pub async fn execute_batch(&self) -> Result<QueryResult> {
         info!("Executing batch aggregate with group by: {:?}, aggregates: {:?}",
               self.group_by, self.aggregates);
@@ -162,6 +289,120 @@ impl BatchAggregateOperator {
     }
 }
 
+/// 聚合函数描述
+#[derive(Debug, Clone)]
+pub(crate) struct AggregateSpec {
+    /// 输出列名
+    pub(crate) name: String,
+    pub(crate) function: String,
+    /// 参数列，`count(*)` 为 None
+    pub(crate) column: Option<String>,
+}
+
+impl AggregateSpec {
+    pub(crate) fn parse(aggregate: &str) -> Self {
+        let name = aggregate.trim().to_lowercase();
+        let (function, argument) = match (name.find('('), name.rfind(')')) {
+            (Some(open), Some(close)) if open < close => {
+                (name[..open].trim().to_string(), name[open + 1..close].trim().to_string())
+            }
+            _ => (name.clone(), "value".to_string()),
+        };
+        let column = if argument == "*" || (function == "count" && !name.contains('(')) {
+            None
+        } else {
+            Some(argument)
+        };
+        Self { name, function, column }
+    }
+}
+
+/// 按分组号存放的聚合累加器 (列式布局)
+#[derive(Debug, Default)]
+struct AggregateAccumulator {
+    count: Vec<i64>,
+    numeric_count: Vec<i64>,
+    sum: Vec<f64>,
+    min: Vec<f64>,
+    max: Vec<f64>,
+}
+
+impl AggregateAccumulator {
+    fn resize(&mut self, groups: usize) {
+        self.count.resize(groups, 0);
+        self.numeric_count.resize(groups, 0);
+        self.sum.resize(groups, 0.0);
+        self.min.resize(groups, f64::INFINITY);
+        self.max.resize(groups, f64::NEG_INFINITY);
+    }
+
+    /// 无分组键：先收集稠密的非 NULL 数值，再调用向量化内核
+    fn update_single(&mut self, batch: &RecordBatch, rows: &[usize], column: Option<&ColumnVector>) {
+        self.count[0] += rows.len() as i64;
+        let Some(column) = column else { return };
+        let Some(values) = f64_values(column) else { return };
+        let dense: Vec<f64>;
+        let slice: &[f64] = if batch.selection.is_none() && column.null_count() == 0 {
+            &values
+        } else {
+            dense = rows.iter().filter(|&&r| !column.is_null(r)).map(|&r| values[r]).collect();
+            &dense
+        };
+        self.numeric_count[0] += slice.len() as i64;
+        self.sum[0] += vector_kernels::sum_f64(slice);
+        self.min[0] = self.min[0].min(vector_kernels::min_f64(slice));
+        self.max[0] = self.max[0].max(vector_kernels::max_f64(slice));
+    }
+
+    /// 有分组键：按预先算好的分组号逐列累加
+    fn update_grouped(&mut self, rows: &[usize], group_ids: &[usize], column: Option<&ColumnVector>) {
+        for &group in group_ids {
+            self.count[group] += 1;
+        }
+        let Some(column) = column else { return };
+        let Some(values) = f64_values(column) else { return };
+        for (&row, &group) in rows.iter().zip(group_ids.iter()) {
+            if column.is_null(row) {
+                continue;
+            }
+            let v = values[row];
+            self.numeric_count[group] += 1;
+            self.sum[group] += v;
+            self.min[group] = self.min[group].min(v);
+            self.max[group] = self.max[group].max(v);
+        }
+    }
+
+    /// 生成输出列，与 HashAggOperator 一致：没有数值输入的分组输出 0
+    fn finish(&self, spec: &AggregateSpec) -> (Field, ColumnVector) {
+        if spec.function == "count" {
+            let counts = match spec.column {
+                Some(_) => self.numeric_count.clone(),
+                None => self.count.clone(),
+            };
+            return (Field::new(spec.name.clone(), DataType::BigInt), ColumnVector::from_i64(counts));
+        }
+        let values = (0..self.count.len())
+            .map(|g| {
+                if self.numeric_count[g] == 0 {
+                    return 0.0;
+                }
+                match spec.function.as_str() {
+                    "sum" => self.sum[g],
+                    "avg" => self.sum[g] / self.numeric_count[g] as f64,
+                    "min" => self.min[g],
+                    "max" => self.max[g],
+                    _ => 0.0,
+                }
+            })
+            .collect();
+        if !matches!(spec.function.as_str(), "sum" | "avg" | "min" | "max") {
+            warn!("Unknown aggregate function: {}", spec.name);
+        }
+        (Field::new(spec.name.clone(), DataType::Double), ColumnVector::from_f64(values))
+    }
+}
+
 /// 批处理排序操作符
 #[derive(Debug)]
 pub struct BatchSortOperator {
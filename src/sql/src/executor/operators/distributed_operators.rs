@@ -7,10 +7,14 @@ use std::time::Duration;
 use tokio::time;
 
 use crate::executor::execution_models::QueryResult;
+use crate::executor::partial_agg::{AggregateSplit, PartialAggregates};
+use crate::executor::record_batch::RecordBatch;
 use crate::storage::buffer_pool::{BufferPool, PageId};
-use crate::storage::memory::MemoryManager;
+use crate::storage::memory::{MemoryBudget, MemoryManager};
 use crate::storage::worker_pool::WorkerPool;
 use super::operator_trait::Operator;
+use super::sort_operators::top_n_batch;
+use storage::index::{ZonePredicate, ZoneSynopsis};
 
 /// 分片扫描操作符
 #[derive(Debug)]
@@ -21,6 +25,12 @@ pub struct ShardScanOperator {
     pub memory_manager: Arc<MemoryManager>,
     pub shard_info: ShardInfo,
     pub shard_nodes: Vec<ShardNode>,
+    /// 下推到分片的 TopN：ORDER BY 列表与行数
+    pub top_n: Option<(Vec<String>, usize)>,
+    /// 用于跳过分片范围的谓词 (AND 关系)
+    pub zone_predicates: Vec<ZonePredicate>,
+    /// 分片范围 (start_key, end_key) 的区间摘要，没有摘要的范围总会被扫描
+    pub range_synopses: HashMap<(String, String), ZoneSynopsis>,
 }
 
 #[derive(Debug)]
@@ -56,9 +66,35 @@ impl ShardScanOperator {
                 shard_strategy: "Hash".to_string(),
             },
             shard_nodes: Vec::new(),
+            top_n: None,
+            zone_predicates: Vec::new(),
+            range_synopses: HashMap::new(),
         }
     }
 
+    pub fn set_zone_predicates(&mut self, predicates: Vec<ZonePredicate>) {
+        self.zone_predicates = predicates;
+    }
+
+    /// 登记分片范围的区间摘要，通常由分片节点随数据一起维护并上报
+    pub fn add_range_synopsis(&mut self, start_key: String, end_key: String, synopsis: ZoneSynopsis) {
+        self.range_synopses.insert((start_key, end_key), synopsis);
+    }
+
+    /// 去掉摘要表明不可能有匹配行的范围
+    fn prune_ranges(&self, ranges: &[(String, String)]) -> Vec<(String, String)> {
+        ranges
+            .iter()
+            .filter(|range| self.range_synopses.get(*range).map_or(true, |synopsis| synopsis.may_match(&self.zone_predicates)))
+            .cloned()
+            .collect()
+    }
+
+    /// 下推 `ORDER BY ... LIMIT`：每个分片只返回自己的前 limit 行，协调节点再取一次
+    pub fn set_top_n(&mut self, order_by: Vec<String>, limit: usize) {
+        self.top_n = Some((order_by, limit));
+    }
+
     pub fn set_shard_info(&mut self, shard_key: String, num_shards: usize, strategy: String) {
         self.shard_info = ShardInfo {
             shard_key,
@@ -81,7 +117,7 @@ impl ShardScanOperator {
               self.shard_info.num_shards, self.shard_info.shard_strategy);
 
         // 分配工作内存
-        let work_memory = self.memory_manager.allocate_work_memory(1024 * 1024)?;
+        let _work_memory = self.memory_manager.work_memory(1024 * 1024)?;
 
         let mut all_rows = Vec::new();
 
@@ -91,11 +127,23 @@ impl ShardScanOperator {
             let node_id = node.node_id.clone();
             let host = node.host.clone();
             let port = node.port;
-            let ranges = node.shard_ranges.clone();
+            let ranges = self.prune_ranges(&node.shard_ranges);
+            if ranges.len() < node.shard_ranges.len() {
+                debug!("Zone map skipped {} of {} ranges on {}", node.shard_ranges.len() - ranges.len(), node.shard_ranges.len(), node.node_id);
+            }
+            if ranges.is_empty() {
+                continue;
+            }
             let columns = self.columns.clone();
+            let top_n = self.top_n.clone();
+            let memory_manager = self.memory_manager.clone();
 
             let task = async move {
-                Self::scan_shard_node(node_id, host, port, ranges, columns)
+                let rows = Self::scan_shard_node(node_id, host, port, ranges, columns.clone())?;
+                match &top_n {
+                    Some((order_by, limit)) => Self::top_n_rows(&columns, rows, order_by, *limit, &memory_manager),
+                    None => Ok(rows),
+                }
             };
             scan_tasks.push(task);
         }
@@ -110,12 +158,29 @@ impl ShardScanOperator {
             }
         }
 
-        // 释放工作内存
-        self.memory_manager.free_memory(work_memory);
+        // 各分片的前 limit 行合并后再取一次前 limit 行
+        if let Some((order_by, limit)) = &self.top_n {
+            debug!("Merging {} top-{} rows from {} shards", all_rows.len(), limit, self.shard_nodes.len());
+            all_rows = Self::top_n_rows(&self.columns, all_rows, order_by, *limit, &self.memory_manager)?;
+        }
 
         Ok(all_rows)
     }
 
+    fn top_n_rows(
+        columns: &[String],
+        rows: Vec<Vec<String>>,
+        order_by: &[String],
+        limit: usize,
+        memory_manager: &dyn MemoryBudget,
+    ) -> Result<Vec<Vec<String>>> {
+        let mut result = QueryResult::new();
+        result.columns = columns.to_vec();
+        result.rows = rows;
+        let batch = RecordBatch::from_query_result(&result)?;
+        Ok(top_n_batch(&batch, order_by, limit, memory_manager)?.into_query_result().rows)
+    }
+
     fn scan_shard_node(
         node_id: String,
         host: String,
@@ -211,6 +276,9 @@ impl Clone for ShardScanOperator {
                 shard_strategy: self.shard_info.shard_strategy.clone(),
             },
             shard_nodes: self.shard_nodes.clone(),
+            top_n: self.top_n.clone(),
+            zone_predicates: self.zone_predicates.clone(),
+            range_synopses: self.range_synopses.clone(),
         }
     }
 }
@@ -272,42 +340,48 @@ impl DistributedAggOperator {
         info!("Performing distributed aggregation with {} partitions", self.num_partitions);
 
         // 分配工作内存
-        let work_memory = self.memory_manager.allocate_work_memory(1024 * 1024)?;
+        let _work_memory = self.memory_manager.work_memory(1024 * 1024)?;
 
-        // 将数据分区
+        // 将数据分区，每个分区对应一个分片
         let partitions = self.partition_data(input_data.rows, &input_data.columns)?;
 
-        // 并行处理每个分区
-        let mut agg_tasks = Vec::new();
-        for partition in partitions {
-            let group_by = self.group_by.clone();
-            let aggregates = self.aggregates.clone();
-            let columns = input_data.columns.clone();
-
-            let task = async move {
-                Self::aggregate_partition(partition, group_by, aggregates, columns)
-            };
-            agg_tasks.push(task);
-        }
-
-        // 等待所有聚合任务完成
-        let mut partition_results = Vec::new();
-        for task_result in futures::future::join_all(agg_tasks).await {
-            match task_result {
-                Ok(result) => partition_results.push(result),
-                Err(e) => {
-                    warn!("Distributed aggregation task failed: {:?}", e);
-                }
+        let result = match AggregateSplit::plan(&self.group_by, &self.aggregates) {
+            Some(split) => self.split_aggregation(&split, partitions, &input_data.columns).await,
+            None => {
+                // 含不可分解的聚合：原始行汇聚到协调节点后统一聚合
+                debug!("Aggregates {:?} are not decomposable, gathering raw rows", self.aggregates);
+                let rows = partitions.into_iter().flatten().collect();
+                Self::aggregate_partition(rows, self.group_by.clone(), self.aggregates.clone(), input_data.columns.clone())
             }
-        }
+        };
 
-        // 合并分区结果
-        let merged_rows = self.merge_partition_results(partition_results, &input_data.columns)?;
+        result
+    }
 
-        // 释放工作内存
-        self.memory_manager.free_memory(work_memory);
+    /// 每个分片计算部分聚合，协调节点只接收并合并编码后的部分状态
+    async fn split_aggregation(
+        &self,
+        split: &AggregateSplit,
+        partitions: Vec<Vec<Vec<String>>>,
+        columns: &[String],
+    ) -> Result<Vec<Vec<String>>> {
+        let shard_tasks = partitions.into_iter().map(|partition| {
+            let split = split.clone();
+            let columns = columns.to_vec();
+            async move { split.partial(&columns, &partition).encode() }
+        });
+        let frames = futures::future::join_all(shard_tasks).await;
+        debug!(
+            "Received {} bytes of partial aggregates from {} shards",
+            frames.iter().map(|f| f.len()).sum::<usize>(),
+            frames.len()
+        );
 
-        Ok(merged_rows)
+        let partials = frames
+            .iter()
+            .map(|frame| PartialAggregates::decode(frame, split.calls.len()))
+            .collect::<Result<Vec<_>>>()?;
+        split.merge(&partials)
     }
 
     fn partition_data(&self, rows: Vec<Vec<String>>, columns: &[String]) -> Result<Vec<Vec<Vec<String>>>> {
@@ -489,138 +563,6 @@ impl DistributedAggOperator {
             }
         }
     }
-
-    fn merge_partition_results(&self, partition_results: Vec<Vec<Vec<String>>>, columns: &[String]) -> Result<Vec<Vec<String>>> {
-        let mut merged_groups: HashMap<String, Vec<Vec<String>>> = HashMap::new();
-
-        // 合并所有分区的结果
-        for partition_result in partition_results {
-            for row in partition_result {
-                let group_key = self.extract_group_key(&row, columns)?;
-                merged_groups.entry(group_key).or_insert_with(Vec::new).push(row);
-            }
-        }
-
-        // 对合并后的分组进行最终聚合
-        let mut final_results = Vec::new();
-        for (group_key, rows) in merged_groups {
-            let aggregated_row = self.aggregate_group(&group_key, &rows, columns)?;
-            final_results.push(aggregated_row);
-        }
-
-        Ok(final_results)
-    }
-
-    fn extract_group_key(&self, row: &[String], columns: &[String]) -> Result<String> {
-        let mut key_parts = Vec::new();
-
-        for group_key in &self.group_by {
-            if let Some(col_index) = columns.iter().position(|c| c == group_key) {
-                if col_index < row.len() {
-                    key_parts.push(row[col_index].clone());
-                }
-            }
-        }
-
-        Ok(key_parts.join("|"))
-    }
-
-    fn aggregate_group(&self, group_key: &str, rows: &[Vec<String>], columns: &[String]) -> Result<Vec<String>> {
-        let mut result_row = Vec::new();
-
-        // 添加分组键
-        for key_part in group_key.split('|') {
-            result_row.push(key_part.to_string());
-        }
-
-        // 计算聚合函数
-        for aggregate in &self.aggregates {
-            let aggregate_value = self.calculate_aggregate(aggregate, rows, columns)?;
-            result_row.push(aggregate_value);
-        }
-
-        Ok(result_row)
-    }
-
-    fn calculate_aggregate(&self, aggregate: &str, rows: &[Vec<String>], columns: &[String]) -> Result<String> {
-        if rows.is_empty() {
-            return Ok("0".to_string());
-        }
-
-        match aggregate.to_lowercase().as_str() {
-            "count" => Ok(rows.len().to_string()),
-            "sum" => {
-                let mut sum = 0.0;
-                for row in rows {
-                    if let Some(col_index) = columns.iter().position(|c| c == "value") {
-                        if col_index < row.len() {
-                            if let Ok(val) = row[col_index].parse::<f64>() {
-                                sum += val;
-                            }
-                        }
-                    }
-                }
-                Ok(sum.to_string())
-            }
-            "avg" => {
-                let mut sum = 0.0;
-                let mut count = 0;
-                for row in rows {
-                    if let Some(col_index) = columns.iter().position(|c| c == "value") {
-                        if col_index < row.len() {
-                            if let Ok(val) = row[col_index].parse::<f64>() {
-                                sum += val;
-                                count += 1;
-                            }
-                        }
-                    }
-                }
-                if count > 0 {
-                    Ok((sum / count as f64).to_string())
-                } else {
-                    Ok("0".to_string())
-                }
-            }
-            "max" => {
-                let mut max_val = f64::NEG_INFINITY;
-                for row in rows {
-                    if let Some(col_index) = columns.iter().position(|c| c == "value") {
-                        if col_index < row.len() {
-                            if let Ok(val) = row[col_index].parse::<f64>() {
-                                max_val = max_val.max(val);
-                            }
-                        }
-                    }
-                }
-                if max_val == f64::NEG_INFINITY {
-                    Ok("0".to_string())
-                } else {
-                    Ok(max_val.to_string())
-                }
-            }
-            "min" => {
-                let mut min_val = f64::INFINITY;
-                for row in rows {
-                    if let Some(col_index) = columns.iter().position(|c| c == "value") {
-                        if col_index < row.len() {
-                            if let Ok(val) = row[col_index].parse::<f64>() {
-                                min_val = min_val.min(val);
-                            }
-                        }
-                    }
-                }
-                if min_val == f64::INFINITY {
-                    Ok("0".to_string())
-                } else {
-                    Ok(min_val.to_string())
-                }
-            }
-            _ => {
-                warn!("Unknown aggregate function: {}", aggregate);
-                Ok("0".to_string())
-            }
-        }
-    }
 }
 
 #[async_trait]
@@ -645,11 +587,92 @@ impl Operator for DistributedAggOperator {
         let aggregated_rows = self.perform_distributed_aggregation(input_data).await?;
 
         let mut result = QueryResult::new();
-        result.columns = vec!["name".to_string(), "count".to_string(), "sum".to_string(), "avg".to_string()];
+        result.columns = self.group_by.iter().chain(&self.aggregates).cloned().collect();
         result.rows = aggregated_rows;
         result.affected_rows = result.rows.len() as u64;
 
         info!("Distributed aggregation completed, returned {} rows", result.affected_rows);
         Ok(result)
     }
-}
\ No newline at end of file
+}
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::optimizer::PlanNode;
+
+    fn shard_scan() -> ShardScanOperator {
+        let mut scan = ShardScanOperator::new(
+            "t".to_string(),
+            vec!["id".to_string(), "name".to_string()],
+            Arc::new(BufferPool::new()),
+            Arc::new(MemoryManager::new()),
+        );
+        scan.add_shard_node("n1".to_string(), "h1".to_string(), 1, vec![("0".to_string(), "40".to_string())]);
+        scan.add_shard_node("n2".to_string(), "h2".to_string(), 1, vec![("40".to_string(), "100".to_string())]);
+        scan
+    }
+
+    #[tokio::test]
+    async fn test_shard_scan_pushes_down_top_n() {
+        let mut scan = shard_scan();
+        scan.set_top_n(vec!["id DESC".to_string()], 3);
+        let rows = scan.perform_shard_scan().await.unwrap();
+        let ids: Vec<&str> = rows.iter().map(|r| r[0].as_str()).collect();
+        assert_eq!(ids, vec!["99", "98", "97"]);
+
+        assert_eq!(shard_scan().perform_shard_scan().await.unwrap().len(), 100);
+    }
+
+    #[tokio::test]
+    async fn test_shard_scan_skips_ranges_by_zone_map() {
+        use storage::codec::{encode_row_with_ids, Datum, RowView};
+        use storage::index::{ZoneCmp, ZoneMapConfig};
+
+        let config = ZoneMapConfig { columns: vec![0], ..ZoneMapConfig::default() };
+        let mut synopsis = ZoneSynopsis::new(&config);
+        for id in 0..40 {
+            let row = encode_row_with_ids(&[(0, Datum::Int(id))]);
+            synopsis.observe(&id.to_be_bytes(), &RowView::new(&row).unwrap()).unwrap();
+        }
+
+        let mut scan = shard_scan();
+        scan.add_range_synopsis("0".to_string(), "40".to_string(), synopsis);
+        scan.set_zone_predicates(vec![ZonePredicate::Compare { column_id: 0, op: ZoneCmp::Ge, value: Datum::Int(50) }]);
+        let rows = scan.perform_shard_scan().await.unwrap();
+        assert_eq!(rows.len(), 60);
+        assert!(rows.iter().all(|row| row[0].parse::<i64>().unwrap() >= 40));
+
+        // 摘要无法排除的谓词不跳过任何范围
+        scan.set_zone_predicates(vec![ZonePredicate::Compare { column_id: 0, op: ZoneCmp::Lt, value: Datum::Int(10) }]);
+        assert_eq!(scan.perform_shard_scan().await.unwrap().len(), 100);
+    }
+
+    #[tokio::test]
+    async fn test_distributed_aggregate_merges_partial_states() {
+        let mut op = DistributedAggOperator::new(
+            PlanNode::TableScan { table: "t".to_string(), columns: vec![] },
+            vec!["name".to_string()],
+            vec!["count".to_string(), "sum".to_string(), "avg(value)".to_string(), "max".to_string()],
+            Arc::new(MemoryManager::new()),
+            Arc::new(BufferPool::new()),
+            Arc::new(WorkerPool::new()),
+        );
+        // 按 id 分区，同一分组分散在多个分片上，依赖协调节点合并部分状态
+        op.set_partition_keys(vec!["id".to_string()]);
+        let mut result = op.execute().await.unwrap();
+        result.rows.sort();
+        assert_eq!(result.columns, vec!["name", "count", "sum", "avg(value)", "max"]);
+        assert_eq!(
+            result.rows,
+            vec![
+                vec!["Alice", "2", "250", "125", "150"],
+                vec!["Bob", "2", "450", "225", "250"],
+                vec!["Charlie", "1", "300", "300", "300"],
+            ]
+        );
+
+        // 不可分解的聚合退回到汇聚原始行
+        op.aggregates = vec!["count(distinct value)".to_string()];
+        assert_eq!(op.execute().await.unwrap().rows.len(), 3);
+    }
+}
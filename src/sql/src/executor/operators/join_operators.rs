@@ -1,16 +1,18 @@
-use common::Result;
+use common::{DataType, Result};
 use std::sync::Arc;
-use std::collections::HashMap;
+use std::path::PathBuf;
 use async_trait::async_trait;
 use tracing::{debug, info, warn};
 use std::time::Duration;
 use tokio::time;
 
 use crate::executor::execution_models::QueryResult;
+use crate::executor::hash_join::{JoinKind, PartitionedHashJoin};
+use crate::executor::record_batch::{ColumnVector, Field, RecordBatch, Schema};
 use crate::storage::buffer_pool::{BufferPool, PageId};
-use crate::storage::memory::MemoryManager;
+use crate::storage::memory::{MemoryBudget, MemoryManager, OperatorMemoryContext};
 use crate::storage::worker_pool::WorkerPool;
-use super::operator_trait::Operator;
+use super::operator_trait::{ColumnarOperator, Operator};
 
 /// 连接操作符
 #[derive(Debug)]
@@ -43,7 +45,7 @@ impl JoinOperator {
         info!("Performing {} join with condition: {}", self.join_type, self.condition);
 
         // 分配工作内存
-        let work_memory = self.memory_manager.allocate_work_memory(1024 * 1024)?;
+        let _work_memory = self.memory_manager.work_memory(1024 * 1024)?;
 
         let join_rows = match self.join_type.to_lowercase().as_str() {
             "inner" => self.inner_join(&left_data, &right_data).await?,
@@ -56,9 +58,6 @@ impl JoinOperator {
             }
         };
 
-        // 释放工作内存
-        self.memory_manager.free_memory(work_memory);
-
         Ok(join_rows)
     }
 
@@ -255,7 +254,7 @@ impl NestedLoopJoinOperator {
         info!("Performing nested loop join with batch size: {}", self.batch_size);
 
         // 分配工作内存
-        let work_memory = self.memory_manager.allocate_work_memory(1024 * 1024)?;
+        let _work_memory = self.memory_manager.work_memory(1024 * 1024)?;
 
         let mut join_rows = Vec::new();
 
@@ -272,9 +271,6 @@ impl NestedLoopJoinOperator {
             }
         }
 
-        // 释放工作内存
-        self.memory_manager.free_memory(work_memory);
-
         Ok(join_rows)
     }
 
@@ -331,6 +327,9 @@ impl Operator for NestedLoopJoinOperator {
 }
 
 /// Hash连接操作符
+///
+/// 基于 `PartitionedHashJoin`：左侧为构建侧，按哈希高位基数分区，超出工作内存
+/// 预算的分区落盘到 `spill_dir` 后再递归处理。
 #[derive(Debug)]
 pub struct HashJoinOperator {
     pub left: crate::optimizer::PlanNode,
@@ -338,9 +337,18 @@ pub struct HashJoinOperator {
     pub join_type: String,
     pub condition: String,
     pub memory_manager: Arc<MemoryManager>,
+    /// 查询内的算子预算，设置后代替全局工作内存预算决定落盘
+    pub memory_context: Option<Arc<OperatorMemoryContext>>,
     pub buffer_pool: Arc<BufferPool>,
+    /// 哈希表的初始容量 (行数)
     pub hash_table_size: usize,
     pub join_keys: Vec<String>,
+    /// 每层基数分区使用的哈希位数
+    pub radix_bits: u32,
+    /// 是否在探测侧使用布隆过滤器
+    pub use_bloom_filter: bool,
+    /// 分区落盘目录
+    pub spill_dir: String,
 }
 
 impl HashJoinOperator {
@@ -358,9 +366,13 @@ impl HashJoinOperator {
             join_type,
             condition,
             memory_manager,
+            memory_context: None,
             buffer_pool,
             hash_table_size: 10000,
             join_keys: vec!["id".to_string()],
+            radix_bits: 4,
+            use_bloom_filter: true,
+            spill_dir: std::env::temp_dir().to_string_lossy().into_owned(),
         }
     }
 
@@ -372,94 +384,97 @@ impl HashJoinOperator {
         self.join_keys = keys;
     }
 
-    async fn perform_hash_join(&self, left_data: QueryResult, right_data: QueryResult) -> Result<Vec<Vec<String>>> {
-        info!("Performing hash join with hash table size: {}", self.hash_table_size);
-
-        // 分配工作内存
-        let work_memory = self.memory_manager.allocate_work_memory(1024 * 1024)?;
+    pub fn set_radix_bits(&mut self, radix_bits: u32) {
+        self.radix_bits = radix_bits;
+    }
 
-        // 构建左表的哈希表
-        let mut hash_table: HashMap<String, Vec<Vec<String>>> = HashMap::new();
+    pub fn set_use_bloom_filter(&mut self, enabled: bool) {
+        self.use_bloom_filter = enabled;
+    }
 
-        for left_row in &left_data.rows {
-            let join_key = self.extract_join_key(left_row, &left_data.columns)?;
-            hash_table.entry(join_key).or_insert_with(Vec::new).push(left_row.clone());
-        }
+    pub fn set_spill_dir(&mut self, spill_dir: String) {
+        self.spill_dir = spill_dir;
+    }
 
-        // 探测右表
-        let mut join_rows = Vec::new();
+    pub fn set_memory_context(&mut self, context: Arc<OperatorMemoryContext>) {
+        self.memory_context = Some(context);
+    }
 
-        for right_row in &right_data.rows {
-            let join_key = self.extract_join_key(right_row, &right_data.columns)?;
-            if let Some(left_rows) = hash_table.get(&join_key) {
-                for left_row in left_rows {
-                    let mut joined_row = left_row.clone();
-                    joined_row.extend(right_row.clone());
-                    join_rows.push(joined_row);
-                }
-            }
+    fn budget(&self) -> &dyn MemoryBudget {
+        match &self.memory_context {
+            Some(context) => context.as_ref(),
+            None => self.memory_manager.as_ref(),
         }
+    }
 
-        // 释放工作内存
-        self.memory_manager.free_memory(work_memory);
+    /// 以左批为构建侧、右批为探测侧执行哈希连接
+    pub async fn perform_hash_join(&self, left_data: &RecordBatch, right_data: &RecordBatch) -> Result<RecordBatch> {
+        info!("Performing {} hash join with hash table size: {}", self.join_type, self.hash_table_size);
 
-        Ok(join_rows)
-    }
+        let kind = JoinKind::parse(&self.join_type).unwrap_or_else(|| {
+            warn!("Unknown join type: {}, falling back to inner join", self.join_type);
+            JoinKind::Inner
+        });
+        let left_keys = left_data.resolve_columns(&self.join_keys)?;
+        let right_keys = right_data.resolve_columns(&self.join_keys)?;
 
-    fn extract_join_key(&self, row: &[String], columns: &[String]) -> Result<String> {
-        let mut key_parts = Vec::new();
+        let mut join = PartitionedHashJoin::new(kind);
+        join.radix_bits = self.radix_bits;
+        join.initial_capacity = self.hash_table_size;
+        join.use_bloom_filter = self.use_bloom_filter;
+        join.spill_dir = PathBuf::from(&self.spill_dir);
 
-        for join_key in &self.join_keys {
-            if let Some(col_index) = columns.iter().position(|c| c == join_key) {
-                if col_index < row.len() {
-                    key_parts.push(row[col_index].clone());
-                }
-            }
-        }
+        let (joined, stats) = join.execute(left_data, &left_keys, right_data, &right_keys, self.budget())?;
+        debug!("Hash join stats: {:?}", stats);
 
-        Ok(key_parts.join("|"))
+        Ok(joined)
     }
 }
 
 #[async_trait]
-impl Operator for HashJoinOperator {
-    async fn execute(&self) -> Result<QueryResult> {
+impl ColumnarOperator for HashJoinOperator {
+    async fn execute_columnar(&self) -> Result<RecordBatch> {
         debug!("Executing hash join operation");
 
         // 模拟左表数据
-        let left_data = QueryResult {
-            columns: vec!["id".to_string(), "name".to_string(), "value".to_string()],
-            rows: vec![
-                vec!["1".to_string(), "Alice".to_string(), "100".to_string()],
-                vec!["2".to_string(), "Bob".to_string(), "200".to_string()],
-                vec!["3".to_string(), "Charlie".to_string(), "300".to_string()],
+        let left_data = RecordBatch::try_new(
+            Schema::new(vec![
+                Field::new("id", DataType::BigInt),
+                Field::new("name", DataType::String),
+                Field::new("value", DataType::BigInt),
+            ]),
+            vec![
+                ColumnVector::from_i64(vec![1, 2, 3]),
+                ColumnVector::from_strs(&["Alice", "Bob", "Charlie"]),
+                ColumnVector::from_i64(vec![100, 200, 300]),
             ],
-            affected_rows: 3,
-            last_insert_id: None,
-        };
+        )?;
 
         // 模拟右表数据
-        let right_data = QueryResult {
-            columns: vec!["id".to_string(), "dept".to_string(), "salary".to_string()],
-            rows: vec![
-                vec!["1".to_string(), "IT".to_string(), "5000".to_string()],
-                vec!["2".to_string(), "HR".to_string(), "4000".to_string()],
-                vec!["4".to_string(), "Finance".to_string(), "6000".to_string()],
+        let right_data = RecordBatch::try_new(
+            Schema::new(vec![
+                Field::new("id", DataType::BigInt),
+                Field::new("dept", DataType::String),
+                Field::new("salary", DataType::BigInt),
+            ]),
+            vec![
+                ColumnVector::from_i64(vec![1, 2, 4]),
+                ColumnVector::from_strs(&["IT", "HR", "Finance"]),
+                ColumnVector::from_i64(vec![5000, 4000, 6000]),
             ],
-            affected_rows: 3,
-            last_insert_id: None,
-        };
+        )?;
 
-        let join_rows = self.perform_hash_join(left_data, right_data).await?;
+        let joined = self.perform_hash_join(&left_data, &right_data).await?;
 
-        let mut result = QueryResult::new();
-        result.columns = vec!["id".to_string(), "name".to_string(), "value".to_string(), 
-                             "id".to_string(), "dept".to_string(), "salary".to_string()];
-        result.rows = join_rows;
-        result.affected_rows = result.rows.len() as u64;
+        info!("Hash join completed, returned {} rows", joined.num_rows());
+        Ok(joined)
+    }
+}
 
-        info!("Hash join completed, returned {} rows", result.affected_rows);
-        Ok(result)
+#[async_trait]
+impl Operator for HashJoinOperator {
+    async fn execute(&self) -> Result<QueryResult> {
+        Ok(self.execute_columnar().await?.into_query_result())
     }
 }
 
@@ -503,7 +518,7 @@ impl MergeJoinOperator {
         info!("Performing merge join with sort keys: {:?}", self.sort_keys);
 
         // 分配工作内存
-        let work_memory = self.memory_manager.allocate_work_memory(1024 * 1024)?;
+        let _work_memory = self.memory_manager.work_memory(1024 * 1024)?;
 
         // 对两个表进行排序
         let sorted_left = self.sort_data(left_data.rows, &left_data.columns)?;
@@ -531,9 +546,6 @@ impl MergeJoinOperator {
             }
         }
 
-        // 释放工作内存
-        self.memory_manager.free_memory(work_memory);
-
         Ok(join_rows)
     }
 
@@ -9,7 +9,7 @@ pub mod parallel_operators;
 pub mod distributed_operators;
 
 // 重新导出基础操作符 trait
-pub use operator_trait::Operator;
+pub use operator_trait::{Operator, ColumnarOperator};
 
 // 重新导出扫描操作符
 pub use scan_operators::{
@@ -40,6 +40,7 @@ pub use aggregate_operators::{
 pub use sort_operators::{
     SortOperator,
     ExternalSortOperator,
+    ExternalSortSource,
     TopNOperator,
 };
 
@@ -1,9 +1,18 @@
 use common::Result;
 use async_trait::async_trait;
 use crate::executor::execution_models::QueryResult;
+use crate::executor::record_batch::RecordBatch;
 
 /// 基础操作符 trait
 #[async_trait]
 pub trait Operator {
     async fn execute(&self) -> Result<QueryResult>;
-} 
\ No newline at end of file
+}
+
+/// 列式操作符 trait
+///
+/// 以强类型的 `RecordBatch` 产出结果，`Operator::execute` 只在客户端边界做格式转换。
+#[async_trait]
+pub trait ColumnarOperator {
+    async fn execute_columnar(&self) -> Result<RecordBatch>;
+}
@@ -6,9 +6,13 @@ use tracing::{debug, info, warn};
 use std::time::Duration;
 use tokio::time;
 
+use crate::executor::exchange::{exchange_batches, ExchangeConfig, ExchangeMode};
 use crate::executor::execution_models::QueryResult;
+use crate::executor::hash_agg::{AdaptiveHashAggregate, AggregateSpec};
+use crate::executor::hash_join::{JoinKind, PartitionedHashJoin};
+use crate::executor::record_batch::RecordBatch;
 use crate::storage::buffer_pool::{BufferPool, PageId};
-use crate::storage::memory::MemoryManager;
+use crate::storage::memory::{MemoryBudget, MemoryManager};
 use crate::storage::worker_pool::WorkerPool;
 use super::operator_trait::Operator;
 
@@ -35,7 +39,11 @@ impl ParallelScanTask {
         ];
 
         let mut result = QueryResult::new();
-        result.columns = self.columns.clone();
+        result.columns = if self.columns.is_empty() || self.columns == ["*"] {
+            vec!["id".to_string(), "name".to_string(), "value".to_string()]
+        } else {
+            self.columns.clone()
+        };
         result.rows = rows;
         result.affected_rows = result.rows.len() as u64;
 
@@ -86,6 +94,9 @@ pub struct ParallelJoinTask {
     pub right: crate::optimizer::PlanNode,
     pub join_type: String,
     pub condition: String,
+    /// 等值连接键，按位置一一对应
+    pub left_keys: Vec<String>,
+    pub right_keys: Vec<String>,
 }
 
 impl ParallelJoinTask {
@@ -102,9 +113,71 @@ impl ParallelJoinTask {
             right,
             join_type,
             condition,
+            left_keys: Vec::new(),
+            right_keys: Vec::new(),
         }
     }
 
+    pub fn set_join_keys(&mut self, left_keys: Vec<String>, right_keys: Vec<String>) {
+        self.left_keys = left_keys;
+        self.right_keys = right_keys;
+    }
+
+    /// 在 `nodes` 个节点上执行分区连接
+    ///
+    /// `left_fragments`/`right_fragments` 为各节点本地扫描的输出。内连接且左侧
+    /// (构建侧) 足够小时把左侧广播到所有节点，右侧留在本地；否则两侧都按连接键
+    /// 哈希重分区，相同键的行落到同一节点，各节点独立连接后汇总。
+    pub async fn execute_exchange(
+        &self,
+        left_fragments: Vec<RecordBatch>,
+        right_fragments: Vec<RecordBatch>,
+        nodes: usize,
+        config: &ExchangeConfig,
+        memory_manager: &dyn MemoryBudget,
+    ) -> Result<RecordBatch> {
+        let (left_schema, right_schema) = match (left_fragments.first(), right_fragments.first()) {
+            (Some(l), Some(r)) => (l.schema.clone(), r.schema.clone()),
+            _ => return Err(common::Error::Execution(format!("join task {} has no input fragments", self.task_id))),
+        };
+        let left_keys = left_fragments[0].resolve_columns(&self.left_keys)?;
+        let right_keys = right_fragments[0].resolve_columns(&self.right_keys)?;
+        let kind = JoinKind::parse(&self.join_type).unwrap_or_else(|| {
+            warn!("Unknown join type: {}, falling back to inner join", self.join_type);
+            JoinKind::Inner
+        });
+
+        let build_rows: usize = left_fragments.iter().map(|b| b.num_rows()).sum();
+        let (left_parts, right_parts) = if kind == JoinKind::Inner && build_rows <= config.broadcast_threshold_rows {
+            info!("Join task {}: broadcasting {} build rows to {} nodes", self.task_id, build_rows, nodes);
+            let inputs = left_fragments.into_iter().map(|b| vec![b]).collect();
+            let (left, _) = exchange_batches(ExchangeMode::Broadcast, left_schema, inputs, nodes, config).await?;
+            let mut right = right_fragments;
+            right.resize_with(nodes, || RecordBatch::empty(right_schema.clone()));
+            (left, right)
+        } else {
+            let left_inputs = left_fragments.into_iter().map(|b| vec![b]).collect();
+            let right_inputs = right_fragments.into_iter().map(|b| vec![b]).collect();
+            let left_mode = ExchangeMode::Hash { key_columns: left_keys.clone() };
+            let right_mode = ExchangeMode::Hash { key_columns: right_keys.clone() };
+            let (left, right) = tokio::try_join!(
+                exchange_batches(left_mode, left_schema, left_inputs, nodes, config),
+                exchange_batches(right_mode, right_schema, right_inputs, nodes, config),
+            )?;
+            (left.0, right.0)
+        };
+
+        let join = PartitionedHashJoin::new(kind);
+        let mut pieces = Vec::with_capacity(nodes);
+        for (left, right) in left_parts.iter().zip(&right_parts) {
+            let (joined, stats) = join.execute(left, &left_keys, right, &right_keys, memory_manager)?;
+            debug!("Join task {} partition stats: {:?}", self.task_id, stats);
+            pieces.push(joined);
+        }
+        let schema = pieces[0].schema.clone();
+        RecordBatch::concat(schema, &pieces)
+    }
+
     pub async fn execute_parallel(&self) -> Result<QueryResult> {
         info!("Executing parallel join task: {} with type: {}", self.task_id, self.join_type);
 
@@ -149,6 +222,48 @@ impl ParallelAggregateTask {
         }
     }
 
+    /// 在 `nodes` 个节点上执行分区聚合
+    ///
+    /// 各节点本地扫描的输出按分组键哈希重分区，同一分组只落到一个节点，
+    /// 各节点独立聚合后的结果互不重叠，直接汇总即可。
+    pub async fn execute_exchange(
+        &self,
+        fragments: Vec<RecordBatch>,
+        nodes: usize,
+        config: &ExchangeConfig,
+        memory_manager: &dyn MemoryBudget,
+    ) -> Result<RecordBatch> {
+        let schema = match fragments.first() {
+            Some(fragment) => fragment.schema.clone(),
+            None => return Err(common::Error::Execution(format!("aggregate task {} has no input fragments", self.task_id))),
+        };
+        let key_columns = fragments[0].resolve_columns(&self.group_by)?;
+        let aggregates = self
+            .aggregates
+            .iter()
+            .map(|a| AggregateSpec::parse(a, &schema))
+            .collect::<Result<Vec<_>>>()?;
+
+        // 没有分组键时所有行都属于同一分组，直接汇聚到一个节点
+        let (mode, receivers) = if key_columns.is_empty() {
+            (ExchangeMode::Gather, 1)
+        } else {
+            (ExchangeMode::Hash { key_columns: key_columns.clone() }, nodes)
+        };
+        let inputs = fragments.into_iter().map(|b| vec![b]).collect();
+        let (partitions, stats) = exchange_batches(mode, schema, inputs, receivers, config).await?;
+        debug!("Aggregate task {} exchange stats: {:?}", self.task_id, stats);
+
+        let aggregate = AdaptiveHashAggregate::default();
+        let mut pieces = Vec::with_capacity(partitions.len());
+        for partition in &partitions {
+            let (aggregated, _) = aggregate.execute(partition, &key_columns, &aggregates, memory_manager)?;
+            pieces.push(aggregated);
+        }
+        let schema = pieces[0].schema.clone();
+        RecordBatch::concat(schema, &pieces)
+    }
+
     pub async fn execute_parallel(&self) -> Result<QueryResult> {
         info!("Executing parallel aggregate task: {} with group by: {:?}",
               self.task_id, self.group_by);
@@ -243,7 +358,7 @@ impl ParallelScanOperator {
               self.num_workers, self.chunk_size);
 
         // 分配工作内存
-        let work_memory = self.memory_manager.allocate_work_memory(1024 * 1024)?;
+        let _work_memory = self.memory_manager.work_memory(1024 * 1024)?;
 
         // 计算每个工作线程处理的页面范围
         let total_pages = 100; // 假设总共有100个页面
@@ -278,9 +393,6 @@ impl ParallelScanOperator {
             }
         }
 
-        // 释放工作内存
-        self.memory_manager.free_memory(work_memory);
-
         Ok(all_rows)
     }
 
@@ -395,7 +507,7 @@ impl ParallelSortOperator {
               self.num_workers, self.chunk_size);
 
         // 分配工作内存
-        let work_memory = self.memory_manager.allocate_work_memory(1024 * 1024)?;
+        let _work_memory = self.memory_manager.work_memory(1024 * 1024)?;
 
         // 将数据分割成块
         let chunks = self.split_into_chunks(&input_data.rows)?;
@@ -431,9 +543,6 @@ impl ParallelSortOperator {
         // 合并排序后的块
         let merged_rows = self.merge_sorted_chunks(sorted_chunks, &input_data.columns)?;
 
-        // 释放工作内存
-        self.memory_manager.free_memory(work_memory);
-
         Ok(merged_rows)
     }
 
@@ -1,4 +1,4 @@
-use common::Result;
+use common::{DataType, Result, Value};
 use std::sync::Arc;
 use std::collections::HashMap;
 use async_trait::async_trait;
@@ -7,10 +7,15 @@ use std::time::Duration;
 use tokio::time;
 
 use crate::executor::execution_models::QueryResult;
+use crate::parser::{ParsedExpression, ParsedOperator, ParsedValue};
+use crate::executor::record_batch::{ColumnVector, Field, RecordBatch, Schema};
 use crate::storage::buffer_pool::{BufferPool, PageId};
 use crate::storage::memory::MemoryManager;
+use crate::storage::StorageHandler;
+use crate::executor::storage_executor::StorageExecutor;
+use ::storage::index::{RoaringBitmap, ZonePredicate};
 use crate::storage::worker_pool::WorkerPool;
-use super::operator_trait::Operator;
+use super::operator_trait::{ColumnarOperator, Operator};
 
 /// 扫描操作符
 #[derive(Debug)]
@@ -26,36 +31,47 @@ impl ScanOperator {
         Self { table, columns, buffer_pool, memory_manager }
     }
 
+    /// 输出模式，id 列为整数，其余按字符串处理
+    fn output_schema(&self) -> Schema {
+        Schema::new(
+            self.columns
+                .iter()
+                .map(|column| {
+                    let data_type = match column.as_str() {
+                        "id" => DataType::BigInt,
+                        _ => DataType::String,
+                    };
+                    Field::new(column.clone(), data_type)
+                })
+                .collect(),
+        )
+    }
+
     /// 执行表扫描
-    async fn scan_table(&self) -> Result<Vec<Vec<String>>> {
+    async fn scan_table(&self) -> Result<RecordBatch> {
         info!("Scanning table: {} with columns: {:?}", self.table, self.columns);
 
         // 分配工作内存用于存储扫描结果
-        let work_memory = self.memory_manager.allocate_work_memory(1024 * 1024)?; // 1MB
+        let _work_memory = self.memory_manager.work_memory(1024 * 1024)?; // 1MB
 
-        // 模拟从磁盘读取数据
-        let mut rows = Vec::new();
+        let schema = self.output_schema();
+        let mut columns: Vec<ColumnVector> = schema
+            .fields
+            .iter()
+            .map(|field| ColumnVector::new(field.data_type.clone()))
+            .collect();
 
-        // 模拟读取多个页面
+        // 模拟读取多个页面，直接解码到列向量中
         for page_id in 0..10 {
             let page = self.buffer_pool.get_buffer(PageId(page_id))?;
-
-            // 模拟从页面中解析行数据
-            let page_rows = self.parse_page_data(&page.data)?;
-            rows.extend(page_rows);
+            self.parse_page_data(&page.data(), &mut columns)?;
         }
 
-        // 释放工作内存
-        self.memory_manager.free_memory(work_memory);
-
-        Ok(rows)
+        RecordBatch::try_new(schema, columns)
     }
 
     /// 解析页面数据
-    fn parse_page_data(&self, data: &[u8]) -> Result<Vec<Vec<String>>> {
-        // 模拟解析页面数据为行
-        let mut rows = Vec::new();
-
+    fn parse_page_data(&self, data: &[u8], columns: &mut [ColumnVector]) -> Result<()> {
         // 假设每行数据大小为100字节
         let row_size = 100;
         let num_rows = data.len() / row_size;
@@ -64,49 +80,46 @@ impl ScanOperator {
             let start = i * row_size;
             let end = start + row_size;
             if end <= data.len() {
-                let row_data = &data[start..end];
-                let row = self.parse_row_data(row_data)?;
-                rows.push(row);
+                self.parse_row_data(&data[start..end], columns)?;
             }
         }
 
-        Ok(rows)
+        Ok(())
     }
 
     /// 解析行数据
-    fn parse_row_data(&self, data: &[u8]) -> Result<Vec<String>> {
-        // 模拟解析行数据为列值
-        let mut row = Vec::new();
-
-        for column in &self.columns {
-            // 模拟根据列名生成值
+    fn parse_row_data(&self, data: &[u8], columns: &mut [ColumnVector]) -> Result<()> {
+        // 模拟根据列名生成值
+        for (column, vector) in self.columns.iter().zip(columns.iter_mut()) {
             let value = match column.as_str() {
-                "id" => format!("{}", data.len()),
-                "name" => format!("row_{}", data.len()),
-                "value" => format!("val_{}", data.len()),
-                _ => format!("col_{}", column),
+                "id" => Value::BigInt(data.len() as i64),
+                "name" => Value::String(format!("row_{}", data.len())),
+                "value" => Value::String(format!("val_{}", data.len())),
+                _ => Value::String(format!("col_{}", column)),
             };
-            row.push(value);
+            vector.push_value(&value);
         }
 
-        Ok(row)
+        Ok(())
     }
 }
 
 #[async_trait]
-impl Operator for ScanOperator {
-    async fn execute(&self) -> Result<QueryResult> {
+impl ColumnarOperator for ScanOperator {
+    async fn execute_columnar(&self) -> Result<RecordBatch> {
         debug!("Executing scan operation on table: {}", self.table);
 
-        let rows = self.scan_table().await?;
+        let batch = self.scan_table().await?;
 
-        let mut result = QueryResult::new();
-        result.columns = self.columns.clone();
-        result.rows = rows;
-        result.affected_rows = result.rows.len() as u64;
+        info!("Scan completed, returned {} rows", batch.num_rows());
+        Ok(batch)
+    }
+}
 
-        info!("Scan completed, returned {} rows", result.affected_rows);
-        Ok(result)
+#[async_trait]
+impl Operator for ScanOperator {
+    async fn execute(&self) -> Result<QueryResult> {
+        Ok(self.execute_columnar().await?.into_query_result())
     }
 }
 
@@ -148,7 +161,7 @@ impl IndexScanOperator {
               self.index, self.table, self.index_conditions);
 
         // 分配工作内存
-        let work_memory = self.memory_manager.allocate_work_memory(1024 * 1024)?;
+        let _work_memory = self.memory_manager.work_memory(1024 * 1024)?;
 
         // 模拟从索引读取数据
         let mut rows = Vec::new();
@@ -156,16 +169,13 @@ impl IndexScanOperator {
         // 模拟读取索引页面
         for page_id in 0..5 {
             let page = self.buffer_pool.get_buffer(PageId(page_id))?;
-            let page_rows = self.parse_page_data(&page.data)?;
+            let page_rows = self.parse_page_data(&page.data())?;
             rows.extend(page_rows);
         }
 
         // 应用索引条件
         let filtered_rows = self.apply_index_conditions(rows)?;
 
-        // 释放工作内存
-        self.memory_manager.free_memory(work_memory);
-
         Ok(filtered_rows)
     }
 
@@ -247,7 +257,8 @@ impl Operator for IndexScanOperator {
 }
 
 /// 顺序扫描操作符
-#[derive(Debug)]
+///
+/// 关联存储执行器后从存储层读取，并先用区间摘要跳过不可能匹配 `zone_predicates` 的区间。
 pub struct SeqScanOperator {
     pub table: String,
     pub columns: Vec<String>,
@@ -255,6 +266,21 @@ pub struct SeqScanOperator {
     pub memory_manager: Arc<MemoryManager>,
     pub start_page: u32,
     pub end_page: u32,
+    pub zone_predicates: Vec<ZonePredicate>,
+    storage: Option<Arc<StorageExecutor>>,
+}
+
+impl std::fmt::Debug for SeqScanOperator {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("SeqScanOperator")
+            .field("table", &self.table)
+            .field("columns", &self.columns)
+            .field("start_page", &self.start_page)
+            .field("end_page", &self.end_page)
+            .field("zone_predicates", &self.zone_predicates)
+            .field("has_storage", &self.storage.is_some())
+            .finish()
+    }
 }
 
 impl SeqScanOperator {
@@ -271,6 +297,8 @@ impl SeqScanOperator {
             memory_manager,
             start_page: 0,
             end_page: 1000,
+            zone_predicates: Vec::new(),
+            storage: None,
         }
     }
 
@@ -279,26 +307,47 @@ impl SeqScanOperator {
         self.end_page = end_page;
     }
 
-    async fn perform_seq_scan(&self) -> Result<Vec<Vec<String>>> {
+    /// 关联存储执行器，改为从它的存储处理器扫描
+    pub fn with_storage(mut self, storage: Arc<StorageExecutor>) -> Self {
+        self.storage = Some(storage);
+        self
+    }
+
+    /// 用于跳过区间的谓词 (AND 关系)，过滤本身仍由上层完成
+    pub fn set_zone_predicates(&mut self, predicates: Vec<ZonePredicate>) {
+        self.zone_predicates = predicates;
+    }
+
+    async fn perform_seq_scan(&self) -> Result<QueryResult> {
+        if let Some(storage) = &self.storage {
+            info!("Performing sequential scan on table: {} with {} zone predicates",
+                  self.table, self.zone_predicates.len());
+            return storage
+                .storage_handler()
+                .scan_table_pruned(&self.table, &self.columns, &self.zone_predicates, None, None)
+                .await;
+        }
+
         info!("Performing sequential scan on table: {} from page {} to {}",
               self.table, self.start_page, self.end_page);
 
         // 分配工作内存
-        let work_memory = self.memory_manager.allocate_work_memory(1024 * 1024)?;
+        let _work_memory = self.memory_manager.work_memory(1024 * 1024)?;
 
         let mut rows = Vec::new();
 
         // 按顺序扫描指定范围的页面
         for page_id in self.start_page..self.end_page {
             let page = self.buffer_pool.get_buffer(PageId(page_id as usize))?;
-            let page_rows = self.parse_page_data(&page.data)?;
+            let page_rows = self.parse_page_data(&page.data())?;
             rows.extend(page_rows);
         }
 
-        // 释放工作内存
-        self.memory_manager.free_memory(work_memory);
-
-        Ok(rows)
+        let mut result = QueryResult::new();
+        result.columns = self.columns.clone();
+        result.rows = rows;
+        result.affected_rows = result.rows.len() as u64;
+        Ok(result)
     }
 
     fn parse_page_data(&self, data: &[u8]) -> Result<Vec<Vec<String>>> {
@@ -341,12 +390,7 @@ impl Operator for SeqScanOperator {
     async fn execute(&self) -> Result<QueryResult> {
         debug!("Executing sequential scan operation on table: {}", self.table);
 
-        let rows = self.perform_seq_scan().await?;
-
-        let mut result = QueryResult::new();
-        result.columns = self.columns.clone();
-        result.rows = rows;
-        result.affected_rows = result.rows.len() as u64;
+        let result = self.perform_seq_scan().await?;
 
         info!("Sequential scan completed, returned {} rows", result.affected_rows);
         Ok(result)
@@ -397,7 +441,7 @@ impl EnhancedIndexScanOperator {
               self.table, self.index_name, self.index_type);
 
         // 分配工作内存
-        let work_memory = self.memory_manager.allocate_work_memory(1024 * 1024)?;
+        let _work_memory = self.memory_manager.work_memory(1024 * 1024)?;
 
         let rows = match self.index_type.as_str() {
             "B-tree" => self.b_tree_scan().await?,
@@ -412,9 +456,6 @@ impl EnhancedIndexScanOperator {
         // 应用索引条件
         let filtered_rows = self.apply_index_conditions(rows)?;
 
-        // 释放工作内存
-        self.memory_manager.free_memory(work_memory);
-
         Ok(filtered_rows)
     }
 
@@ -425,7 +466,7 @@ impl EnhancedIndexScanOperator {
         // 模拟B-tree索引扫描
         for page_id in 0..3 {
             let page = self.buffer_pool.get_buffer(PageId(page_id))?;
-            let page_rows = self.parse_page_data(&page.data)?;
+            let page_rows = self.parse_page_data(&page.data())?;
             rows.extend(page_rows);
         }
 
@@ -439,7 +480,7 @@ impl EnhancedIndexScanOperator {
         // 模拟Hash索引扫描
         for page_id in 3..6 {
             let page = self.buffer_pool.get_buffer(PageId(page_id))?;
-            let page_rows = self.parse_page_data(&page.data)?;
+            let page_rows = self.parse_page_data(&page.data())?;
             rows.extend(page_rows);
         }
 
@@ -453,7 +494,7 @@ impl EnhancedIndexScanOperator {
         // 模拟Bitmap索引扫描
         for page_id in 6..9 {
             let page = self.buffer_pool.get_buffer(PageId(page_id))?;
-            let page_rows = self.parse_page_data(&page.data)?;
+            let page_rows = self.parse_page_data(&page.data())?;
             rows.extend(page_rows);
         }
 
@@ -539,22 +580,104 @@ impl Operator for EnhancedIndexScanOperator {
 }
 
 /// Bitmap扫描操作符
-#[derive(Debug)]
+///
+/// 条件按顺序在存储层的 Roaring 位图索引上求值，只读取命中的行。
 pub struct BitmapScanOperator {
     pub table: String,
     pub columns: Vec<String>,
     pub buffer_pool: Arc<BufferPool>,
     pub memory_manager: Arc<MemoryManager>,
     pub bitmap_conditions: Vec<BitmapCondition>,
+    storage: Option<Arc<StorageExecutor>>,
 }
 
-#[derive(Debug)]
+impl std::fmt::Debug for BitmapScanOperator {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("BitmapScanOperator")
+            .field("table", &self.table)
+            .field("columns", &self.columns)
+            .field("bitmap_conditions", &self.bitmap_conditions)
+            .field("has_storage", &self.storage.is_some())
+            .finish()
+    }
+}
+
+/// 位图条件：`column` 取值属于 `values`，与之前的结果按 `operation` 合并
+///
+/// 第一个条件给出初始集合 (NOT 取其在存活行中的补集)，之后的 AND 求交、OR 求并、
+/// NOT 求差，即按从左到右的顺序求值。
+#[derive(Debug, Clone, PartialEq)]
 pub struct BitmapCondition {
     pub column: String,
     pub values: Vec<String>,
     pub operation: String, // AND, OR, NOT
 }
 
+impl BitmapCondition {
+    fn new(column: &str, value: String, operation: &str) -> Self {
+        Self { column: column.to_string(), values: vec![value], operation: operation.to_string() }
+    }
+
+    /// 把过滤谓词翻译为按顺序求值的位图条件
+    ///
+    /// 只接受左深的 `col = lit` / `col != lit` 组合 (`(a = 1 AND b != 2) OR c = 3`)，
+    /// 其余形式返回 None。
+    pub fn from_predicate(predicate: &ParsedExpression) -> Option<Vec<BitmapCondition>> {
+        match predicate {
+            ParsedExpression::BinaryOp { left, operator: operator @ (ParsedOperator::And | ParsedOperator::Or), right } => {
+                let mut conditions = Self::from_predicate(left)?;
+                let (column, value, negated) = Self::comparison(right)?;
+                let operation = match (operator, negated) {
+                    (ParsedOperator::And, false) => "AND",
+                    (ParsedOperator::And, true) => "NOT",
+                    (ParsedOperator::Or, false) => "OR",
+                    // a OR NOT b 无法在左深的顺序求值中表达
+                    _ => return None,
+                };
+                // 同一列上连续的 OR 合并为一次多值查找
+                match conditions.last_mut() {
+                    Some(last) if operation == "OR" && last.operation == "OR" && last.column == column => {
+                        last.values.push(value)
+                    }
+                    _ => conditions.push(Self::new(column, value, operation)),
+                }
+                Some(conditions)
+            }
+            _ => {
+                let (column, value, negated) = Self::comparison(predicate)?;
+                Some(vec![Self::new(column, value, if negated { "NOT" } else { "OR" })])
+            }
+        }
+    }
+
+    /// `col = lit` / `lit = col` / `col != lit`，返回 (列, 取值文本, 是否取反)
+    fn comparison(expr: &ParsedExpression) -> Option<(&str, String, bool)> {
+        let ParsedExpression::BinaryOp { left, operator, right } = expr else { return None };
+        let negated = match operator {
+            ParsedOperator::Equal => false,
+            ParsedOperator::NotEqual => true,
+            _ => return None,
+        };
+        let (column, literal) = match (left.as_ref(), right.as_ref()) {
+            (ParsedExpression::Column(column), ParsedExpression::Literal(literal))
+            | (ParsedExpression::Literal(literal), ParsedExpression::Column(column)) => (column, literal),
+            _ => return None,
+        };
+        Some((column.as_str(), Self::literal_text(literal)?, negated))
+    }
+
+    /// 字面量在索引中的文本形式；只接受与存储层文本一一对应的字面量，
+    /// 否则索引可能漏掉匹配的行
+    fn literal_text(literal: &ParsedValue) -> Option<String> {
+        match literal {
+            ParsedValue::String(text) => Some(text.clone()),
+            ParsedValue::Boolean(value) => Some(value.to_string()),
+            ParsedValue::Number(text) => text.parse::<i64>().ok().filter(|v| v.to_string() == *text).map(|v| v.to_string()),
+            ParsedValue::Null => None,
+        }
+    }
+}
+
 impl BitmapScanOperator {
     pub fn new(
         table: String,
@@ -568,9 +691,16 @@ impl BitmapScanOperator {
             buffer_pool,
             memory_manager,
             bitmap_conditions: Vec::new(),
+            storage: None,
         }
     }
 
+    /// 关联存储执行器，位图与行数据都从它的存储处理器读取
+    pub fn with_storage(mut self, storage: Arc<StorageExecutor>) -> Self {
+        self.storage = Some(storage);
+        self
+    }
+
     pub fn add_bitmap_condition(&mut self, column: String, values: Vec<String>, operation: String) {
         self.bitmap_conditions.push(BitmapCondition {
             column,
@@ -579,152 +709,63 @@ impl BitmapScanOperator {
         });
     }
 
-    async fn perform_bitmap_scan(&self) -> Result<Vec<Vec<String>>> {
+    fn storage(&self) -> Result<&StorageHandler> {
+        self.storage.as_deref().map(StorageExecutor::storage_handler).ok_or_else(|| {
+            common::Error::Execution(format!("bitmap scan on {} has no storage handler", self.table))
+        })
+    }
+
+    async fn perform_bitmap_scan(&self) -> Result<QueryResult> {
         info!("Performing bitmap scan on table: {} with {} conditions",
               self.table, self.bitmap_conditions.len());
 
         // 分配工作内存
-        let work_memory = self.memory_manager.allocate_work_memory(1024 * 1024)?;
+        let _work_memory = self.memory_manager.work_memory(1024 * 1024)?;
 
-        // 构建位图
         let bitmap = self.build_bitmap().await?;
-
-        // 应用位图条件
-        let filtered_bitmap = self.apply_bitmap_conditions(bitmap).await?;
-
-        // 根据位图获取数据
-        let rows = self.fetch_data_by_bitmap(filtered_bitmap).await?;
-
-        // 释放工作内存
-        self.memory_manager.free_memory(work_memory);
-
-        Ok(rows)
+        debug!("Bitmap scan on {} matched {} rows", self.table, bitmap.len());
+        self.storage()?.fetch_rows_by_bitmap(&self.table, &bitmap, &self.columns, None).await
     }
 
-    async fn build_bitmap(&self) -> Result<Vec<bool>> {
-        // 模拟构建位图
-        let bitmap_size = 1000; // 假设有1000行数据
-        let mut bitmap = vec![true; bitmap_size];
-
-        // 模拟一些位图操作
-        for i in 0..bitmap_size {
-            bitmap[i] = i % 3 != 0; // 模拟过滤条件
-        }
-
-        Ok(bitmap)
-    }
+    /// 按条件顺序合并各索引的位图
+    async fn build_bitmap(&self) -> Result<RoaringBitmap> {
+        let storage = self.storage()?;
+        let mut conditions = self.bitmap_conditions.iter();
+        let Some(first) = conditions.next() else {
+            return storage.bitmap_live_rows(&self.table, None).await;
+        };
 
-    async fn apply_bitmap_conditions(&self, mut bitmap: Vec<bool>) -> Result<Vec<bool>> {
-        for condition in &self.bitmap_conditions {
-            match condition.operation.as_str() {
-                "AND" => bitmap = self.apply_and_condition(bitmap, condition).await?,
-                "OR" => bitmap = self.apply_or_condition(bitmap, condition).await?,
-                "NOT" => bitmap = self.apply_not_condition(bitmap, condition).await?,
-                _ => warn!("Unknown bitmap operation: {}", condition.operation),
-            }
+        let matched = storage.bitmap_lookup(&self.table, &first.column, &first.values, None).await?;
+        let mut bitmap = match first.operation.as_str() {
+            "NOT" => storage.bitmap_live_rows(&self.table, None).await?.and_not(&matched),
+            _ => matched,
+        };
+        for condition in conditions {
+            bitmap = self.apply_bitmap_condition(storage, bitmap, condition).await?;
         }
-
         Ok(bitmap)
     }
 
-    async fn apply_and_condition(&self, bitmap: Vec<bool>, condition: &BitmapCondition) -> Result<Vec<bool>> {
-        let mut result = bitmap;
-        for i in 0..result.len() {
-            if self.check_condition_match(i, condition)? {
-                result[i] = result[i] && true;
-            } else {
-                result[i] = false;
-            }
-        }
-        Ok(result)
-    }
-
-    async fn apply_or_condition(&self, bitmap: Vec<bool>, condition: &BitmapCondition) -> Result<Vec<bool>> {
-        let mut result = bitmap;
-        for i in 0..result.len() {
-            if self.check_condition_match(i, condition)? {
-                result[i] = result[i] || true;
-            }
+    async fn apply_bitmap_condition(
+        &self,
+        storage: &StorageHandler,
+        bitmap: RoaringBitmap,
+        condition: &BitmapCondition,
+    ) -> Result<RoaringBitmap> {
+        // AND / NOT 只会缩小结果，结果已为空时不必再查索引
+        if bitmap.is_empty() && condition.operation != "OR" {
+            return Ok(bitmap);
         }
-        Ok(result)
-    }
-
-    async fn apply_not_condition(&self, bitmap: Vec<bool>, condition: &BitmapCondition) -> Result<Vec<bool>> {
-        let mut result = bitmap;
-        for i in 0..result.len() {
-            if self.check_condition_match(i, condition)? {
-                result[i] = !result[i];
-            }
-        }
-        Ok(result)
-    }
-
-    fn check_condition_match(&self, row_index: usize, condition: &BitmapCondition) -> Result<bool> {
-        // 模拟检查条件匹配
-        Ok(row_index % 2 == 0)
-    }
-
-    async fn fetch_data_by_bitmap(&self, bitmap: Vec<bool>) -> Result<Vec<Vec<String>>> {
-        let mut rows = Vec::new();
-
-        for (i, &is_selected) in bitmap.iter().enumerate() {
-            if is_selected {
-                let row = self.generate_row(i);
-                rows.push(row);
-            }
-        }
-
-        Ok(rows)
-    }
-
-    fn generate_row(&self, row_index: usize) -> Vec<String> {
-        let mut row = Vec::new();
-
-        for column in &self.columns {
-            let value = match column.as_str() {
-                "id" => format!("{}", row_index),
-                "name" => format!("bitmap_row_{}", row_index),
-                "value" => format!("bitmap_val_{}", row_index),
-                _ => format!("bitmap_col_{}", column),
-            };
-            row.push(value);
-        }
-
-        row
-    }
-
-    fn parse_page_data(&self, data: &[u8]) -> Result<Vec<Vec<String>>> {
-        let mut rows = Vec::new();
-        let row_size = 100;
-        let num_rows = data.len() / row_size;
-
-        for i in 0..num_rows {
-            let start = i * row_size;
-            let end = start + row_size;
-            if end <= data.len() {
-                let row_data = &data[start..end];
-                let row = self.parse_row_data(row_data)?;
-                rows.push(row);
+        let matched = storage.bitmap_lookup(&self.table, &condition.column, &condition.values, None).await?;
+        Ok(match condition.operation.as_str() {
+            "AND" => bitmap.and(&matched),
+            "OR" => bitmap.or(&matched),
+            "NOT" => bitmap.and_not(&matched),
+            other => {
+                warn!("Unknown bitmap operation: {}", other);
+                bitmap
             }
-        }
-
-        Ok(rows)
-    }
-
-    fn parse_row_data(&self, data: &[u8]) -> Result<Vec<String>> {
-        let mut row = Vec::new();
-
-        for column in &self.columns {
-            let value = match column.as_str() {
-                "id" => format!("{}", data.len()),
-                "name" => format!("bitmap_row_{}", data.len()),
-                "value" => format!("bitmap_val_{}", data.len()),
-                _ => format!("bitmap_col_{}", column),
-            };
-            row.push(value);
-        }
-
-        Ok(row)
+        })
     }
 }
 
@@ -733,14 +774,66 @@ impl Operator for BitmapScanOperator {
     async fn execute(&self) -> Result<QueryResult> {
         debug!("Executing bitmap scan operation on table: {}", self.table);
 
-        let rows = self.perform_bitmap_scan().await?;
-
-        let mut result = QueryResult::new();
-        result.columns = self.columns.clone();
-        result.rows = rows;
-        result.affected_rows = result.rows.len() as u64;
+        let result = self.perform_bitmap_scan().await?;
 
         info!("Bitmap scan completed, returned {} rows", result.affected_rows);
         Ok(result)
     }
-}
\ No newline at end of file
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::parser::ParsedValue;
+
+    fn eq(column: &str, value: ParsedValue, operator: ParsedOperator) -> ParsedExpression {
+        ParsedExpression::BinaryOp {
+            left: Box::new(ParsedExpression::Column(column.to_string())),
+            operator,
+            right: Box::new(ParsedExpression::Literal(value)),
+        }
+    }
+
+    fn op(left: ParsedExpression, operator: ParsedOperator, right: ParsedExpression) -> ParsedExpression {
+        ParsedExpression::BinaryOp { left: Box::new(left), operator, right: Box::new(right) }
+    }
+
+    #[test]
+    fn test_bitmap_conditions_from_predicate() {
+        let status = |v: &str| eq("status", ParsedValue::String(v.to_string()), ParsedOperator::Equal);
+        // (status = 'a' OR status = 'b') AND region != 'us' AND tenant = 7
+        let predicate = op(
+            op(
+                op(status("a"), ParsedOperator::Or, status("b")),
+                ParsedOperator::And,
+                eq("region", ParsedValue::String("us".to_string()), ParsedOperator::NotEqual),
+            ),
+            ParsedOperator::And,
+            eq("tenant", ParsedValue::Number("7".to_string()), ParsedOperator::Equal),
+        );
+        let conditions = BitmapCondition::from_predicate(&predicate).unwrap();
+        assert_eq!(conditions, vec![
+            BitmapCondition { column: "status".into(), values: vec!["a".into(), "b".into()], operation: "OR".into() },
+            BitmapCondition::new("region", "us".into(), "NOT"),
+            BitmapCondition::new("tenant", "7".into(), "AND"),
+        ]);
+
+        // 非左深、范围比较、非整数数字、OR NOT 都不能走位图
+        assert!(BitmapCondition::from_predicate(&op(status("a"), ParsedOperator::Or, op(status("b"), ParsedOperator::And, status("c")))).is_none());
+        assert!(BitmapCondition::from_predicate(&eq("tenant", ParsedValue::Number("7".into()), ParsedOperator::GreaterThan)).is_none());
+        assert!(BitmapCondition::from_predicate(&eq("tenant", ParsedValue::Number("7.0".into()), ParsedOperator::Equal)).is_none());
+        assert!(BitmapCondition::from_predicate(&op(status("a"), ParsedOperator::Or, eq("region", ParsedValue::String("us".into()), ParsedOperator::NotEqual))).is_none());
+    }
+
+    #[tokio::test]
+    async fn test_bitmap_scan_requires_storage() {
+        let mut operator = BitmapScanOperator::new(
+            "orders".to_string(),
+            vec!["status".to_string()],
+            Arc::new(BufferPool::new()),
+            Arc::new(MemoryManager::new()),
+        );
+        operator.add_bitmap_condition("status".to_string(), vec!["a".to_string()], "AND".to_string());
+        assert!(matches!(operator.execute().await, Err(common::Error::Execution(_))));
+    }
+}
@@ -1,4 +1,4 @@
-use common::Result;
+use common::{DataType, Result};
 use std::sync::Arc;
 use std::collections::HashMap;
 use std::collections::HashSet;
@@ -8,10 +8,41 @@ use std::time::Duration;
 use tokio::time;
 
 use crate::executor::execution_models::QueryResult;
+use crate::executor::record_batch::{ColumnVector, Field, RecordBatch, RowHashIndex, Schema};
 use crate::storage::buffer_pool::{BufferPool, PageId};
 use crate::storage::memory::MemoryManager;
 use crate::storage::worker_pool::WorkerPool;
-use super::operator_trait::Operator;
+use super::operator_trait::{ColumnarOperator, Operator};
+
+/// 集合操作共用的模拟输入
+fn sample_inputs() -> Result<(RecordBatch, RecordBatch)> {
+    let schema = Schema::new(vec![
+        Field::new("id", DataType::BigInt),
+        Field::new("name", DataType::String),
+        Field::new("value", DataType::BigInt),
+    ]);
+
+    // 模拟左表数据
+    let left = RecordBatch::try_new(schema.clone(), vec![
+        ColumnVector::from_i64(vec![1, 2, 3]),
+        ColumnVector::from_strs(&["Alice", "Bob", "Charlie"]),
+        ColumnVector::from_i64(vec![100, 200, 300]),
+    ])?;
+
+    // 模拟右表数据
+    let right = RecordBatch::try_new(schema, vec![
+        ColumnVector::from_i64(vec![3, 4, 5]),
+        ColumnVector::from_strs(&["Charlie", "David", "Eve"]),
+        ColumnVector::from_i64(vec![300, 400, 500]),
+    ])?;
+
+    Ok((left, right))
+}
+
+/// 所有列的下标，集合操作按整行比较
+fn all_columns(batch: &RecordBatch) -> Vec<usize> {
+    (0..batch.num_columns()).collect()
+}
 
 /// Union操作符
 #[derive(Debug)]
@@ -43,85 +74,53 @@ impl UnionOperator {
         self.distinct = distinct;
     }
 
-    async fn perform_union(&self, left_data: QueryResult, right_data: QueryResult) -> Result<Vec<Vec<String>>> {
+    async fn perform_union(&self, left_data: &RecordBatch, right_data: &RecordBatch) -> Result<RecordBatch> {
         info!("Performing union operation with distinct: {}", self.distinct);
 
         // 分配工作内存
-        let work_memory = self.memory_manager.allocate_work_memory(1024 * 1024)?;
-
-        let mut union_rows = Vec::new();
-
-        // 添加左表数据
-        union_rows.extend(left_data.rows);
+        let _work_memory = self.memory_manager.work_memory(1024 * 1024)?;
 
-        // 添加右表数据
-        union_rows.extend(right_data.rows);
+        // 添加左表和右表数据
+        let mut union_batch = left_data.clone().compact();
+        union_batch.append(right_data)?;
 
-        // 如果需要去重
+        // 如果需要去重，按强类型整行哈希保留首次出现的行
         if self.distinct {
-            let mut seen = HashSet::new();
+            let keys = all_columns(&union_batch);
+            let mut seen = RowHashIndex::with_capacity(keys.clone(), union_batch.num_rows());
             let mut distinct_rows = Vec::new();
 
-            for row in union_rows {
-                let row_key = self.create_row_key(&row);
-                if !seen.contains(&row_key) {
-                    seen.insert(row_key);
+            for row in union_batch.row_indices() {
+                if !seen.contains(&union_batch, &union_batch, row, &keys) {
+                    seen.insert(&union_batch, row);
                     distinct_rows.push(row);
                 }
             }
 
-            union_rows = distinct_rows;
+            union_batch = union_batch.take(&distinct_rows);
         }
 
-        // 释放工作内存
-        self.memory_manager.free_memory(work_memory);
-
-        Ok(union_rows)
+        Ok(union_batch)
     }
+}
 
-    fn create_row_key(&self, row: &[String]) -> String {
-        row.join("|")
+#[async_trait]
+impl ColumnarOperator for UnionOperator {
+    async fn execute_columnar(&self) -> Result<RecordBatch> {
+        debug!("Executing union operation");
+
+        let (left_data, right_data) = sample_inputs()?;
+        let union_batch = self.perform_union(&left_data, &right_data).await?;
+
+        info!("Union completed, returned {} rows", union_batch.num_rows());
+        Ok(union_batch)
     }
 }
 
 #[async_trait]
 impl Operator for UnionOperator {
     async fn execute(&self) -> Result<QueryResult> {
-        debug!("Executing union operation");
-
-        // 模拟左表数据
-        let left_data = QueryResult {
-            columns: vec!["id".to_string(), "name".to_string(), "value".to_string()],
-            rows: vec![
-                vec!["1".to_string(), "Alice".to_string(), "100".to_string()],
-                vec!["2".to_string(), "Bob".to_string(), "200".to_string()],
-                vec!["3".to_string(), "Charlie".to_string(), "300".to_string()],
-            ],
-            affected_rows: 3,
-            last_insert_id: None,
-        };
-
-        // 模拟右表数据
-        let right_data = QueryResult {
-            columns: vec!["id".to_string(), "name".to_string(), "value".to_string()],
-            rows: vec![
-                vec!["3".to_string(), "Charlie".to_string(), "300".to_string()],
-                vec!["4".to_string(), "David".to_string(), "400".to_string()],
-                vec!["5".to_string(), "Eve".to_string(), "500".to_string()],
-            ],
-            affected_rows: 3,
-            last_insert_id: None,
-        };
-
-        let union_rows = self.perform_union(left_data, right_data).await?;
-
-        let mut result = QueryResult::new();
-        result.columns = vec!["id".to_string(), "name".to_string(), "value".to_string()];
-        result.rows = union_rows;
-        result.affected_rows = result.rows.len() as u64;
-
-        info!("Union completed, returned {} rows", result.affected_rows);
-        Ok(result)
+        Ok(self.execute_columnar().await?.into_query_result())
     }
 }
 
@@ -149,77 +148,44 @@ impl IntersectOperator {
         }
     }
 
-    async fn perform_intersect(&self, left_data: QueryResult, right_data: QueryResult) -> Result<Vec<Vec<String>>> {
+    async fn perform_intersect(&self, left_data: &RecordBatch, right_data: &RecordBatch) -> Result<RecordBatch> {
         info!("Performing intersect operation");
 
         // 分配工作内存
-        let work_memory = self.memory_manager.allocate_work_memory(1024 * 1024)?;
+        let _work_memory = self.memory_manager.work_memory(1024 * 1024)?;
 
-        // 构建右表的哈希集合
-        let mut right_set = HashSet::new();
-        for row in &right_data.rows {
-            let row_key = self.create_row_key(row);
-            right_set.insert(row_key);
-        }
+        // 构建右表的行哈希索引
+        let right_set = RowHashIndex::build(right_data, all_columns(right_data), right_data.num_rows());
 
         // 查找交集
-        let mut intersect_rows = Vec::new();
-        for row in &left_data.rows {
-            let row_key = self.create_row_key(row);
-            if right_set.contains(&row_key) {
-                intersect_rows.push(row.clone());
-            }
-        }
+        let left_keys = all_columns(left_data);
+        let intersect_rows: Vec<usize> = left_data
+            .row_indices()
+            .into_iter()
+            .filter(|&row| right_set.contains(right_data, left_data, row, &left_keys))
+            .collect();
+
+        Ok(left_data.take(&intersect_rows))
+    }
+}
 
-        // 释放工作内存
-        self.memory_manager.free_memory(work_memory);
+#[async_trait]
+impl ColumnarOperator for IntersectOperator {
+    async fn execute_columnar(&self) -> Result<RecordBatch> {
+        debug!("Executing intersect operation");
 
-        Ok(intersect_rows)
-    }
+        let (left_data, right_data) = sample_inputs()?;
+        let intersect_batch = self.perform_intersect(&left_data, &right_data).await?;
 
-    fn create_row_key(&self, row: &[String]) -> String {
-        row.join("|")
+        info!("Intersect completed, returned {} rows", intersect_batch.num_rows());
+        Ok(intersect_batch)
     }
 }
 
 #[async_trait]
 impl Operator for IntersectOperator {
     async fn execute(&self) -> Result<QueryResult> {
-        debug!("Executing intersect operation");
-
-        // 模拟左表数据
-        let left_data = QueryResult {
-            columns: vec!["id".to_string(), "name".to_string(), "value".to_string()],
-            rows: vec![
-                vec!["1".to_string(), "Alice".to_string(), "100".to_string()],
-                vec!["2".to_string(), "Bob".to_string(), "200".to_string()],
-                vec!["3".to_string(), "Charlie".to_string(), "300".to_string()],
-            ],
-            affected_rows: 3,
-            last_insert_id: None,
-        };
-
-        // 模拟右表数据
-        let right_data = QueryResult {
-            columns: vec!["id".to_string(), "name".to_string(), "value".to_string()],
-            rows: vec![
-                vec!["3".to_string(), "Charlie".to_string(), "300".to_string()],
-                vec!["4".to_string(), "David".to_string(), "400".to_string()],
-                vec!["5".to_string(), "Eve".to_string(), "500".to_string()],
-            ],
-            affected_rows: 3,
-            last_insert_id: None,
-        };
-
-        let intersect_rows = self.perform_intersect(left_data, right_data).await?;
-
-        let mut result = QueryResult::new();
-        result.columns = vec!["id".to_string(), "name".to_string(), "value".to_string()];
-        result.rows = intersect_rows;
-        result.affected_rows = result.rows.len() as u64;
-
-        info!("Intersect completed, returned {} rows", result.affected_rows);
-        Ok(result)
+        Ok(self.execute_columnar().await?.into_query_result())
     }
 }
 
@@ -247,76 +213,43 @@ impl ExceptOperator {
         }
     }
 
-    async fn perform_except(&self, left_data: QueryResult, right_data: QueryResult) -> Result<Vec<Vec<String>>> {
+    async fn perform_except(&self, left_data: &RecordBatch, right_data: &RecordBatch) -> Result<RecordBatch> {
         info!("Performing except operation");
 
         // 分配工作内存
-        let work_memory = self.memory_manager.allocate_work_memory(1024 * 1024)?;
+        let _work_memory = self.memory_manager.work_memory(1024 * 1024)?;
 
-        // 构建右表的哈希集合
-        let mut right_set = HashSet::new();
-        for row in &right_data.rows {
-            let row_key = self.create_row_key(row);
-            right_set.insert(row_key);
-        }
+        // 构建右表的行哈希索引
+        let right_set = RowHashIndex::build(right_data, all_columns(right_data), right_data.num_rows());
 
         // 查找差集
-        let mut except_rows = Vec::new();
-        for row in &left_data.rows {
-            let row_key = self.create_row_key(row);
-            if !right_set.contains(&row_key) {
-                except_rows.push(row.clone());
-            }
-        }
+        let left_keys = all_columns(left_data);
+        let except_rows: Vec<usize> = left_data
+            .row_indices()
+            .into_iter()
+            .filter(|&row| !right_set.contains(right_data, left_data, row, &left_keys))
+            .collect();
+
+        Ok(left_data.take(&except_rows))
+    }
+}
 
-        // 释放工作内存
-        self.memory_manager.free_memory(work_memory);
+#[async_trait]
+impl ColumnarOperator for ExceptOperator {
+    async fn execute_columnar(&self) -> Result<RecordBatch> {
+        debug!("Executing except operation");
 
-        Ok(except_rows)
-    }
+        let (left_data, right_data) = sample_inputs()?;
+        let except_batch = self.perform_except(&left_data, &right_data).await?;
 
-    fn create_row_key(&self, row: &[String]) -> String {
-        row.join("|")
+        info!("Except completed, returned {} rows", except_batch.num_rows());
+        Ok(except_batch)
     }
 }
 
 #[async_trait]
 impl Operator for ExceptOperator {
     async fn execute(&self) -> Result<QueryResult> {
-        debug!("Executing except operation");
-
-        // 模拟左表数据
-        let left_data = QueryResult {
-            columns: vec!["id".to_string(), "name".to_string(), "value".to_string()],
-            rows: vec![
-                vec!["1".to_string(), "Alice".to_string(), "100".to_string()],
-                vec!["2".to_string(), "Bob".to_string(), "200".to_string()],
-                vec!["3".to_string(), "Charlie".to_string(), "300".to_string()],
-            ],
-            affected_rows: 3,
-            last_insert_id: None,
-        };
-
-        // 模拟右表数据
-        let right_data = QueryResult {
-            columns: vec!["id".to_string(), "name".to_string(), "value".to_string()],
-            rows: vec![
-                vec!["3".to_string(), "Charlie".to_string(), "300".to_string()],
-                vec!["4".to_string(), "David".to_string(), "400".to_string()],
-                vec!["5".to_string(), "Eve".to_string(), "500".to_string()],
-            ],
-            affected_rows: 3,
-            last_insert_id: None,
-        };
-
-        let except_rows = self.perform_except(left_data, right_data).await?;
-
-        let mut result = QueryResult::new();
-        result.columns = vec!["id".to_string(), "name".to_string(), "value".to_string()];
-        result.rows = except_rows;
-        result.affected_rows = result.rows.len() as u64;
-
-        info!("Except completed, returned {} rows", result.affected_rows);
-        Ok(result)
+        Ok(self.execute_columnar().await?.into_query_result())
     }
-}
\ No newline at end of file
+}
@@ -1,4 +1,4 @@
-use common::Result;
+use common::{DataType, Result};
 use std::sync::Arc;
 use std::collections::HashMap;
 use async_trait::async_trait;
@@ -7,12 +7,17 @@ use std::time::Duration;
 use tokio::time;
 use std::collections::BinaryHeap;
 use std::cmp::Ordering;
+use std::path::PathBuf;
 
 use crate::executor::execution_models::QueryResult;
+use crate::executor::external_sort::{ExternalSortStats, ExternalSorter, SortedStream};
+use crate::executor::result_stream::{MaterializedSource, RowSource};
+use crate::executor::record_batch::{infer_data_type, ColumnVector, Field, RecordBatch, Schema};
+use crate::executor::sort_key::{parse_order_by, NormalizedKeys, SortColumn};
 use crate::storage::buffer_pool::{BufferPool, PageId};
-use crate::storage::memory::MemoryManager;
+use crate::storage::memory::{MemoryBudget, MemoryManager, MemoryReservation, OperatorMemoryContext};
 use crate::storage::worker_pool::WorkerPool;
-use super::operator_trait::Operator;
+use super::operator_trait::{ColumnarOperator, Operator};
 
 /// 排序操作符
 #[derive(Debug)]
@@ -31,71 +36,98 @@ impl SortOperator {
         }
     }
 
-    async fn perform_sort(&self, input_data: QueryResult) -> Result<Vec<Vec<String>>> {
+    /// 对输入批按 `order_by` 排序
+    pub async fn perform_sort(&self, input_data: &RecordBatch) -> Result<RecordBatch> {
         info!("Performing sort with order by: {:?}", self.order_by);
 
         // 分配工作内存
-        let work_memory = self.memory_manager.allocate_work_memory(1024 * 1024)?;
-
-        let mut sorted_rows = input_data.rows.clone();
-        sorted_rows.sort_by(|a, b| {
-            for order_col in &self.order_by {
-                if let Some(col_index) = input_data.columns.iter().position(|c| c == order_col) {
-                    if col_index < a.len() && col_index < b.len() {
-                        let cmp = a[col_index].cmp(&b[col_index]);
-                        if cmp != Ordering::Equal {
-                            return cmp;
-                        }
-                    }
+        let _work_memory = self.memory_manager.work_memory(1024 * 1024)?;
+
+        // 只对行号排序，比较直接作用于强类型列，最后一次性按行号收集
+        let sort_columns: Vec<&ColumnVector> = self
+            .order_by
+            .iter()
+            .filter_map(|order_col| input_data.column_by_name(order_col))
+            .collect();
+        let mut indices = input_data.row_indices();
+        indices.sort_by(|&a, &b| {
+            for column in &sort_columns {
+                let cmp = column.compare(a, column, b);
+                if cmp != Ordering::Equal {
+                    return cmp;
                 }
             }
             Ordering::Equal
         });
+        let sorted = input_data.take(&indices);
 
-        // 释放工作内存
-        self.memory_manager.free_memory(work_memory);
-
-        Ok(sorted_rows)
+        Ok(sorted)
     }
 }
 
 #[async_trait]
-impl Operator for SortOperator {
-    async fn execute(&self) -> Result<QueryResult> {
+impl ColumnarOperator for SortOperator {
+    async fn execute_columnar(&self) -> Result<RecordBatch> {
         debug!("Executing sort operation");
 
         // 模拟输入数据
-        let input_data = QueryResult {
-            columns: vec!["id".to_string(), "name".to_string(), "value".to_string()],
-            rows: vec![
-                vec!["3".to_string(), "Charlie".to_string(), "300".to_string()],
-                vec!["1".to_string(), "Alice".to_string(), "100".to_string()],
-                vec!["5".to_string(), "Eve".to_string(), "500".to_string()],
-                vec!["2".to_string(), "Bob".to_string(), "200".to_string()],
-                vec!["4".to_string(), "David".to_string(), "400".to_string()],
+        let input_data = RecordBatch::try_new(
+            Schema::new(vec![
+                Field::new("id", DataType::BigInt),
+                Field::new("name", DataType::String),
+                Field::new("value", DataType::BigInt),
+            ]),
+            vec![
+                ColumnVector::from_i64(vec![3, 1, 5, 2, 4]),
+                ColumnVector::from_strs(&["Charlie", "Alice", "Eve", "Bob", "David"]),
+                ColumnVector::from_i64(vec![300, 100, 500, 200, 400]),
             ],
-            affected_rows: 5,
-            last_insert_id: None,
-        };
+        )?;
 
-        let sorted_rows = self.perform_sort(input_data).await?;
+        let sorted = self.perform_sort(&input_data).await?;
 
-        let mut result = QueryResult::new();
-        result.columns = vec!["id".to_string(), "name".to_string(), "value".to_string()];
-        result.rows = sorted_rows;
-        result.affected_rows = result.rows.len() as u64;
+        info!("Sort completed, returned {} rows", sorted.num_rows());
+        Ok(sorted)
+    }
+}
 
-        info!("Sort completed, returned {} rows", result.affected_rows);
-        Ok(result)
+#[async_trait]
+impl Operator for SortOperator {
+    async fn execute(&self) -> Result<QueryResult> {
+        Ok(self.execute_columnar().await?.into_query_result())
     }
 }
 
+/// 排序算子共用的模拟输入数据
+fn mock_input() -> Result<RecordBatch> {
+    RecordBatch::try_new(
+        Schema::new(vec![
+            Field::new("id", DataType::BigInt),
+            Field::new("name", DataType::String),
+            Field::new("value", DataType::BigInt),
+        ]),
+        vec![
+            ColumnVector::from_i64(vec![3, 1, 5, 2, 4]),
+            ColumnVector::from_strs(&["Charlie", "Alice", "Eve", "Bob", "David"]),
+            ColumnVector::from_i64(vec![300, 100, 500, 200, 400]),
+        ],
+    )
+}
+
+/// 外部排序的最小段缓冲
+const MIN_SORT_MEMORY: usize = 64 * 1024;
+
 /// 外部排序操作符
+///
+/// 按 `max_memory` 攒段、用归一化键排序后写成二进制段文件 (位于 `temp_dir`)，
+/// 最后以败者树 k 路归并，段文件每帧 `chunk_size` 行。设置了算子内存上下文时，
+/// 段缓冲取 `max_memory` 与上下文剩余额度中的较小者。
 #[derive(Debug)]
 pub struct ExternalSortOperator {
     pub input: crate::optimizer::PlanNode,
     pub order_by: Vec<String>,
     pub memory_manager: Arc<MemoryManager>,
+    pub memory_context: Option<Arc<OperatorMemoryContext>>,
     pub buffer_pool: Arc<BufferPool>,
     pub temp_dir: String,
     pub chunk_size: usize,
@@ -113,8 +145,9 @@ impl ExternalSortOperator {
             input,
             order_by,
             memory_manager,
+            memory_context: None,
             buffer_pool,
-            temp_dir: "/tmp".to_string(),
+            temp_dir: std::env::temp_dir().to_string_lossy().into_owned(),
             chunk_size: 1000,
             max_memory: 1024 * 1024, // 1MB
         }
@@ -132,160 +165,286 @@ impl ExternalSortOperator {
         self.max_memory = max_memory;
     }
 
-    async fn perform_external_sort(&self, input_data: QueryResult) -> Result<Vec<Vec<String>>> {
-        info!("Performing external sort with chunk size: {}, max memory: {}",
-              self.chunk_size, self.max_memory);
+    /// 从查询内存上下文中分配的算子预算
+    pub fn set_memory_context(&mut self, context: Arc<OperatorMemoryContext>) {
+        self.memory_context = Some(context);
+    }
 
-        // 分配工作内存
-        let work_memory = self.memory_manager.allocate_work_memory(self.max_memory)?;
+    fn budget(&self) -> Arc<dyn MemoryBudget> {
+        match &self.memory_context {
+            Some(context) => context.clone(),
+            None => self.memory_manager.clone(),
+        }
+    }
 
-        // 将数据分割成块
-        let chunks = self.split_into_chunks(&input_data.rows)?;
+    /// 对输入做外部排序，返回逐帧交出结果的流
+    pub fn sort_stream(&self, input: Box<dyn RowSource>) -> Result<ExternalSortSource> {
+        info!("Performing external sort with chunk size: {}, max memory: {}",
+              self.chunk_size, self.max_memory);
+        ExternalSortSource::new(input, self.order_by.clone(), self.budget(), self.max_memory, &self.temp_dir, self.chunk_size)
+    }
+}
 
-        // 对每个块进行排序
-        let mut sorted_chunks = Vec::new();
-        for chunk in chunks {
-            let sorted_chunk = self.sort_chunk(&chunk, &input_data.columns)?;
-            sorted_chunks.push(sorted_chunk);
-        }
+/// 流式外部排序
+///
+/// 第一次取数时逐块读完输入、超出预算的部分落盘成段，之后每次只归并出一帧交给消费者。
+/// 输出保留输入的原始文本，只有附加的排序键列带类型。键的类型取自输入的 schema；输入
+/// 没有 schema 时逐块推断，之后的块与已推断的类型冲突时放宽 (BIGINT → DOUBLE → 文本)
+/// 并把已经读入的数据按新类型重新排序，结果与读完全部输入再推断类型时相同。
+/// 工作内存在创建时预留，丢弃时归还。
+pub struct ExternalSortSource {
+    columns: Vec<String>,
+    input: Option<Box<dyn RowSource>>,
+    order_by: Vec<String>,
+    budget: Arc<dyn MemoryBudget>,
+    memory: usize,
+    temp_dir: PathBuf,
+    frame_rows: usize,
+    output: Option<SortedStream>,
+    stats: ExternalSortStats,
+}
 
-        // 合并排序后的块
-        let merged_rows = self.merge_sorted_chunks(sorted_chunks, &input_data.columns)?;
+/// 排序输入的键布局：原始文本列之后附加每个排序键的带类型列
+struct SortLayout {
+    /// 排序键对应的输入列
+    key_columns: Vec<usize>,
+    descending: Vec<bool>,
+    /// 键列类型，`None` 表示到目前为止只见过空值
+    key_types: Vec<Option<DataType>>,
+    /// 类型取自输入 schema 时不再放宽
+    fixed: bool,
+}
 
-        // 释放工作内存
-        self.memory_manager.free_memory(work_memory);
+impl SortLayout {
+    fn width(&self) -> usize {
+        self.key_columns.len()
+    }
 
-        Ok(merged_rows)
+    fn schema(&self, columns: &[String]) -> Schema {
+        let mut fields: Vec<Field> = columns.iter().map(|name| Field::new(name.clone(), DataType::String)).collect();
+        fields.extend(
+            self.key_types
+                .iter()
+                .enumerate()
+                .map(|(i, data_type)| Field::new(format!("__order_key_{i}"), data_type.clone().unwrap_or(DataType::String))),
+        );
+        Schema::new(fields)
     }
 
-    fn split_into_chunks(&self, rows: &[Vec<String>]) -> Result<Vec<Vec<Vec<String>>>> {
-        let mut chunks = Vec::new();
-        let mut current_chunk = Vec::new();
+    fn sort_columns(&self, data_columns: usize) -> Vec<SortColumn> {
+        self.descending
+            .iter()
+            .enumerate()
+            .map(|(i, &descending)| SortColumn { column: data_columns + i, descending })
+            .collect()
+    }
 
-        for row in rows {
-            current_chunk.push(row.clone());
-            if current_chunk.len() >= self.chunk_size {
-                chunks.push(current_chunk.clone());
-                current_chunk.clear();
-            }
+    /// 按一块新输入放宽键类型，类型有变化时返回 true
+    fn widen(&mut self, rows: &[Vec<String>]) -> bool {
+        if self.fixed {
+            return false;
         }
-
-        if !current_chunk.is_empty() {
-            chunks.push(current_chunk);
+        let mut changed = false;
+        for (key_type, &column) in self.key_types.iter_mut().zip(&self.key_columns) {
+            let mut values = rows.iter().filter_map(|row| row.get(column)).filter(|value| !value.is_empty()).peekable();
+            if values.peek().is_none() {
+                continue;
+            }
+            let widened = match (key_type.take(), infer_data_type(values)) {
+                (None, inferred) => inferred,
+                (Some(current), inferred) if current == inferred => current,
+                (Some(DataType::BigInt), DataType::Double) | (Some(DataType::Double), DataType::BigInt) => DataType::Double,
+                _ => DataType::String,
+            };
+            changed |= key_type.as_ref() != Some(&widened);
+            *key_type = Some(widened);
         }
-
-        Ok(chunks)
+        changed
     }
 
-    fn sort_chunk(&self, chunk: &[Vec<String>], columns: &[String]) -> Result<Vec<Vec<String>>> {
-        let mut sorted_chunk = chunk.to_vec();
-        sorted_chunk.sort_by(|a, b| {
-            for order_col in &self.order_by {
-                if let Some(col_index) = columns.iter().position(|c| c == order_col) {
-                    if col_index < a.len() && col_index < b.len() {
-                        let cmp = a[col_index].cmp(&b[col_index]);
-                        if cmp != Ordering::Equal {
-                            return cmp;
-                        }
-                    }
+    /// 原始文本列加带类型的键列
+    fn batch(&self, schema: &Schema, rows: &[Vec<String>]) -> Result<RecordBatch> {
+        let data_columns = schema.fields.len() - self.width();
+        let mut columns: Vec<ColumnVector> =
+            schema.fields.iter().map(|f| ColumnVector::with_capacity(f.data_type.clone(), rows.len())).collect();
+        for row in rows {
+            for (column, vector) in columns.iter_mut().enumerate() {
+                let source = match column.checked_sub(data_columns) {
+                    Some(key) => self.key_columns[key],
+                    None => column,
+                };
+                match row.get(source) {
+                    Some(text) => vector.push_str(text),
+                    None => vector.push_null(),
                 }
             }
-            Ordering::Equal
-        });
-        Ok(sorted_chunk)
+        }
+        RecordBatch::try_new(schema.clone(), columns)
     }
+}
 
-    fn merge_sorted_chunks(&self, chunks: Vec<Vec<Vec<String>>>, columns: &[String]) -> Result<Vec<Vec<String>>> {
-        if chunks.is_empty() {
-            return Ok(Vec::new());
-        }
+impl ExternalSortSource {
+    /// 预留 `max_memory` 与剩余预算中较小者作为段缓冲
+    pub fn new(
+        input: Box<dyn RowSource>,
+        order_by: Vec<String>,
+        budget: Arc<dyn MemoryBudget>,
+        max_memory: usize,
+        temp_dir: impl Into<PathBuf>,
+        frame_rows: usize,
+    ) -> Result<Self> {
+        let memory = max_memory.min(budget.available_work_memory().max(MIN_SORT_MEMORY));
+        budget.reserve_work_memory(memory)?;
+        Ok(Self {
+            columns: input.columns().to_vec(),
+            input: Some(input),
+            order_by,
+            budget,
+            memory,
+            temp_dir: temp_dir.into(),
+            frame_rows,
+            output: None,
+            stats: ExternalSortStats::default(),
+        })
+    }
 
-        if chunks.len() == 1 {
-            return Ok(chunks[0].clone());
-        }
+    /// 排序统计，输入读完之后才有意义
+    pub fn stats(&self) -> &ExternalSortStats {
+        &self.stats
+    }
 
-        // 简单的两两合并策略
-        let mut merged = chunks[0].clone();
-        for chunk in &chunks[1..] {
-            merged = self.merge_two_sorted_chunks(&merged, chunk, columns)?;
-        }
+    fn layout(&self, input_schema: Option<Schema>) -> Result<SortLayout> {
+        let names = Schema::new(self.columns.iter().map(|name| Field::new(name.clone(), DataType::String)).collect());
+        let sort_columns = parse_order_by(&self.order_by, &names)?;
+        let key_columns: Vec<usize> = sort_columns.iter().map(|c| c.column).collect();
+        let key_types = match &input_schema {
+            Some(schema) => key_columns.iter().map(|&c| schema.fields.get(c).map(|f| f.data_type.clone())).collect(),
+            None => vec![None; key_columns.len()],
+        };
+        Ok(SortLayout {
+            key_columns,
+            descending: sort_columns.iter().map(|c| c.descending).collect(),
+            key_types,
+            fixed: input_schema.is_some(),
+        })
+    }
 
-        Ok(merged)
+    fn sorter(&self, layout: &SortLayout) -> ExternalSorter {
+        let mut sorter = ExternalSorter::new(
+            layout.schema(&self.columns),
+            layout.sort_columns(self.columns.len()),
+            self.memory,
+            &self.temp_dir,
+        );
+        sorter.set_frame_rows(self.frame_rows);
+        sorter
     }
 
-    fn merge_two_sorted_chunks(&self, chunk1: &[Vec<String>], chunk2: &[Vec<String>], columns: &[String]) -> Result<Vec<Vec<String>>> {
-        let mut merged = Vec::new();
-        let mut i = 0;
-        let mut j = 0;
+    /// 键类型放宽后，把已读入的数据取出来按新的键重新排序
+    async fn resort(&mut self, sorter: ExternalSorter, layout: &SortLayout) -> Result<ExternalSorter> {
+        let data_columns: Vec<usize> = (0..self.columns.len()).collect();
+        let mut previous = sorter.finish_stream().await?;
+        let mut resorted = self.sorter(layout);
+        while let Some(frame) = previous.next_batch().await? {
+            let rows = frame.project(&data_columns).into_query_result().rows;
+            resorted.push(layout.batch(resorted.schema(), &rows)?)?;
+        }
+        add_stats(&mut self.stats, previous.stats());
+        Ok(resorted)
+    }
 
-        while i < chunk1.len() && j < chunk2.len() {
-            let cmp = self.compare_rows(&chunk1[i], &chunk2[j], columns);
-            if cmp == Ordering::Less || cmp == Ordering::Equal {
-                merged.push(chunk1[i].clone());
-                i += 1;
-            } else {
-                merged.push(chunk2[j].clone());
-                j += 1;
+    async fn sort_input(&mut self, mut input: Box<dyn RowSource>) -> Result<Option<SortedStream>> {
+        let mut layout = self.layout(input.schema())?;
+        let mut sorter = self.sorter(&layout);
+        let mut pushed = false;
+        while let Some(rows) = input.next_rows().await? {
+            if rows.is_empty() {
+                continue;
+            }
+            if layout.widen(&rows) {
+                sorter = match pushed {
+                    true => self.resort(sorter, &layout).await?,
+                    false => self.sorter(&layout),
+                };
             }
+            sorter.push(layout.batch(sorter.schema(), &rows)?)?;
+            pushed = true;
         }
+        // 输入读完即丢弃，释放上游的扫描
+        drop(input);
 
-        // 添加剩余的行
-        while i < chunk1.len() {
-            merged.push(chunk1[i].clone());
-            i += 1;
+        if !pushed {
+            return Ok(None);
         }
-
-        while j < chunk2.len() {
-            merged.push(chunk2[j].clone());
-            j += 1;
+        let stream = sorter.finish_stream().await?;
+        add_stats(&mut self.stats, stream.stats());
+        if self.stats.runs > 0 {
+            debug!("External sort spilled {} runs ({} bytes), {} intermediate merge passes",
+                   self.stats.runs, self.stats.spilled_bytes, self.stats.merge_passes);
         }
+        Ok(Some(stream))
+    }
+}
+
+fn add_stats(total: &mut ExternalSortStats, stats: &ExternalSortStats) {
+    total.runs += stats.runs;
+    total.merge_passes += stats.merge_passes;
+    total.spilled_bytes += stats.spilled_bytes;
+}
 
-        Ok(merged)
+#[async_trait]
+impl RowSource for ExternalSortSource {
+    fn columns(&self) -> &[String] {
+        &self.columns
     }
 
-    fn compare_rows(&self, a: &[String], b: &[String], columns: &[String]) -> Ordering {
-        for order_col in &self.order_by {
-            if let Some(col_index) = columns.iter().position(|c| c == order_col) {
-                if col_index < a.len() && col_index < b.len() {
-                    let cmp = a[col_index].cmp(&b[col_index]);
-                    if cmp != Ordering::Equal {
-                        return cmp;
-                    }
-                }
+    async fn next_rows(&mut self) -> Result<Option<Vec<Vec<String>>>> {
+        if let Some(input) = self.input.take() {
+            self.output = self.sort_input(input).await?;
+        }
+        let Some(output) = self.output.as_mut() else { return Ok(None) };
+        match output.next_batch().await? {
+            Some(frame) => {
+                let data_columns: Vec<usize> = (0..self.columns.len()).collect();
+                Ok(Some(frame.project(&data_columns).into_query_result().rows))
+            }
+            None => {
+                self.output = None;
+                Ok(None)
             }
         }
-        Ordering::Equal
+    }
+}
+
+impl Drop for ExternalSortSource {
+    fn drop(&mut self) {
+        self.budget.release_work_memory(self.memory);
     }
 }
 
 #[async_trait]
-impl Operator for ExternalSortOperator {
-    async fn execute(&self) -> Result<QueryResult> {
+impl ColumnarOperator for ExternalSortOperator {
+    async fn execute_columnar(&self) -> Result<RecordBatch> {
         debug!("Executing external sort operation");
 
-        // 模拟输入数据
-        let input_data = QueryResult {
-            columns: vec!["id".to_string(), "name".to_string(), "value".to_string()],
-            rows: vec![
-                vec!["3".to_string(), "Charlie".to_string(), "300".to_string()],
-                vec!["1".to_string(), "Alice".to_string(), "100".to_string()],
-                vec!["5".to_string(), "Eve".to_string(), "500".to_string()],
-                vec!["2".to_string(), "Bob".to_string(), "200".to_string()],
-                vec!["4".to_string(), "David".to_string(), "400".to_string()],
-            ],
-            affected_rows: 5,
-            last_insert_id: None,
-        };
-
-        let sorted_rows = self.perform_external_sort(input_data).await?;
+        let input = mock_input()?;
+        let schema = input.schema.clone();
+        let mut sorted = self.sort_stream(Box::new(MaterializedSource::new(input.into_query_result(), self.chunk_size)))?;
+        let mut rows = Vec::new();
+        while let Some(chunk) = sorted.next_rows().await? {
+            rows.extend(chunk);
+        }
+        let sorted = RecordBatch::from_rows(schema, &rows)?;
 
-        let mut result = QueryResult::new();
-        result.columns = vec!["id".to_string(), "name".to_string(), "value".to_string()];
-        result.rows = sorted_rows;
-        result.affected_rows = result.rows.len() as u64;
+        info!("External sort completed, returned {} rows", sorted.num_rows());
+        Ok(sorted)
+    }
+}
 
-        info!("External sort completed, returned {} rows", result.affected_rows);
-        Ok(result)
+#[async_trait]
+impl Operator for ExternalSortOperator {
+    async fn execute(&self) -> Result<QueryResult> {
+        Ok(self.execute_columnar().await?.into_query_result())
     }
 }
 
@@ -316,114 +475,167 @@ impl TopNOperator {
         }
     }
 
-    async fn perform_top_n_sort(&self, input_data: QueryResult) -> Result<Vec<Vec<String>>> {
+    /// 取排序后的前 limit 行，与外部排序共用归一化键
+    pub fn top_n(&self, input_data: &RecordBatch) -> Result<RecordBatch> {
         info!("Performing top {} sort with order by: {:?}", self.limit, self.order_by);
+        top_n_batch(input_data, &self.order_by, self.limit, &self.memory_manager)
+    }
+}
 
-        // 分配工作内存
-        let work_memory = self.memory_manager.allocate_work_memory(1024 * 1024)?;
-
-        // 使用最小堆来维护前N个元素
-        let mut heap = BinaryHeap::new();
-
-        for row in &input_data.rows {
-            let sort_key = self.extract_sort_key(row, &input_data.columns)?;
-            let heap_item = HeapItem {
-                sort_key,
-                row: row.clone(),
-            };
-
-            heap.push(heap_item);
-
-            // 保持堆的大小为limit
-            if heap.len() > self.limit {
-                heap.pop();
-            }
-        }
-
-        // 从堆中提取结果
-        let mut result_rows = Vec::new();
-        while let Some(item) = heap.pop() {
-            result_rows.push(item.row);
+/// 按 `order_by` 取批中排序后的前 `limit` 行
+///
+/// 分片扫描下推 TopN 时每个分片先各自取前 limit 行，协调节点再对合并结果取一次。
+pub fn top_n_batch(
+    input_data: &RecordBatch,
+    order_by: &[String],
+    limit: usize,
+    memory_manager: &dyn MemoryBudget,
+) -> Result<RecordBatch> {
+    let sort_columns = parse_order_by(order_by, &input_data.schema)?;
+    let rows = input_data.row_indices();
+    let keys = NormalizedKeys::encode(input_data, &rows, &sort_columns);
+    let _reservation = MemoryReservation::new(memory_manager, keys.memory_size())?;
+
+    // 最大堆保存当前最小的 limit 个键，堆顶是其中最大的，新键更小时替换堆顶；
+    // 键相同时按输入顺序，保证与完整排序结果一致
+    let mut heap: BinaryHeap<HeapItem> = BinaryHeap::with_capacity(limit + 1);
+    for index in 0..keys.len() {
+        let item = HeapItem { key: keys.key(index), index };
+        if heap.len() < limit {
+            heap.push(item);
+        } else if heap.peek().map_or(false, |top| item < *top) {
+            heap.pop();
+            heap.push(item);
         }
-
-        // 反转结果以保持正确的顺序
-        result_rows.reverse();
-
-        // 释放工作内存
-        self.memory_manager.free_memory(work_memory);
-
-        Ok(result_rows)
     }
+    let top: Vec<usize> = heap.into_sorted_vec().into_iter().map(|item| rows[item.index]).collect();
+    Ok(input_data.take(&top))
+}
 
-    fn extract_sort_key(&self, row: &[String], columns: &[String]) -> Result<String> {
-        let mut key_parts = Vec::new();
+#[derive(Debug, PartialEq, Eq, PartialOrd, Ord)]
+struct HeapItem<'a> {
+    key: &'a [u8],
+    index: usize,
+}
 
-        for order_col in &self.order_by {
-            if let Some(col_index) = columns.iter().position(|c| c == order_col) {
-                if col_index < row.len() {
-                    key_parts.push(row[col_index].clone());
-                }
-            }
-        }
+#[async_trait]
+impl ColumnarOperator for TopNOperator {
+    async fn execute_columnar(&self) -> Result<RecordBatch> {
+        debug!("Executing top {} operation", self.limit);
 
-        Ok(key_parts.join("|"))
-    }
-}
+        let top = self.top_n(&mock_input()?)?;
 
-#[derive(Debug)]
-struct HeapItem {
-    sort_key: String,
-    row: Vec<String>,
+        info!("Top {} operation completed, returned {} rows", self.limit, top.num_rows());
+        Ok(top)
+    }
 }
 
-impl PartialEq for HeapItem {
-    fn eq(&self, other: &Self) -> bool {
-        self.sort_key == other.sort_key
+#[async_trait]
+impl Operator for TopNOperator {
+    async fn execute(&self) -> Result<QueryResult> {
+        Ok(self.execute_columnar().await?.into_query_result())
     }
 }
 
-impl Eq for HeapItem {}
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::optimizer::PlanNode;
 
-impl PartialOrd for HeapItem {
-    fn partial_cmp(&self, other: &Self) -> Option<Ordering> {
-        Some(self.cmp(other))
+    fn plan() -> PlanNode {
+        PlanNode::TableScan { table: "t".to_string(), columns: vec![] }
     }
-}
 
-impl Ord for HeapItem {
-    fn cmp(&self, other: &Self) -> Ordering {
-        // 使用逆序比较，因为BinaryHeap是最大堆
-        other.sort_key.cmp(&self.sort_key)
+    fn ids(batch: &RecordBatch) -> Vec<String> {
+        (0..batch.num_rows()).map(|i| batch.column(0).format_value(i)).collect()
     }
-}
 
-#[async_trait]
-impl Operator for TopNOperator {
-    async fn execute(&self) -> Result<QueryResult> {
-        debug!("Executing top {} operation", self.limit);
+    #[tokio::test]
+    async fn test_external_sort_spills_and_merges() {
+        let memory = Arc::new(MemoryManager::new());
+        let mut op = ExternalSortOperator::new(plan(), vec!["value DESC".to_string()], memory.clone(), Arc::new(BufferPool::new()));
+        op.set_max_memory(256);
+        op.set_chunk_size(4);
+
+        let mut input = QueryResult::new();
+        input.columns = mock_input().unwrap().into_query_result().columns;
+        input.rows = (0..8).flat_map(|_| mock_input().unwrap().into_query_result().rows).collect();
+        let mut sorted = op.sort_stream(Box::new(MaterializedSource::new(input, 5))).unwrap();
+        // 结果按帧逐块交出，每块不超过 chunk_size 行
+        let mut values = Vec::new();
+        while let Some(chunk) = sorted.next_rows().await.unwrap() {
+            assert!(chunk.len() <= 4);
+            values.extend(chunk.into_iter().map(|row| row[2].clone()));
+        }
+        assert!(sorted.stats().runs > 1);
+        assert_eq!(values.len(), 40);
+        let mut expected = values.clone();
+        expected.sort_by(|a, b| b.parse::<i64>().unwrap().cmp(&a.parse::<i64>().unwrap()));
+        assert_eq!(values, expected);
+        drop(sorted);
+        assert_eq!(memory.get_stats().work_memory_allocated, 0);
+    }
 
-        // 模拟输入数据
-        let input_data = QueryResult {
-            columns: vec!["id".to_string(), "name".to_string(), "value".to_string()],
-            rows: vec![
-                vec!["3".to_string(), "Charlie".to_string(), "300".to_string()],
-                vec!["1".to_string(), "Alice".to_string(), "100".to_string()],
-                vec!["5".to_string(), "Eve".to_string(), "500".to_string()],
-                vec!["2".to_string(), "Bob".to_string(), "200".to_string()],
-                vec!["4".to_string(), "David".to_string(), "400".to_string()],
-            ],
-            affected_rows: 5,
-            last_insert_id: None,
-        };
+    #[tokio::test]
+    async fn test_external_sort_widens_conflicting_key_types() {
+        // 每块 2 行：先是整数，再出现小数，最后出现文本；键类型逐步放宽为文本，
+        // 已落盘的段按新类型重新排序，输出保留原始文本
+        let mut input = QueryResult::new();
+        input.columns = vec!["id".to_string(), "v".to_string()];
+        input.rows = ["10", "9", "1.50", "2", "abc", "-1"]
+            .iter()
+            .enumerate()
+            .map(|(i, v)| vec![i.to_string(), v.to_string()])
+            .collect();
+        let memory = Arc::new(MemoryManager::new());
+        let mut op = ExternalSortOperator::new(plan(), vec!["v".to_string()], memory.clone(), Arc::new(BufferPool::new()));
+        op.set_max_memory(1);
+        op.set_chunk_size(4);
+        let mut sorted = op.sort_stream(Box::new(MaterializedSource::new(input.clone(), 2))).unwrap();
+        let mut values = Vec::new();
+        while let Some(chunk) = sorted.next_rows().await.unwrap() {
+            values.extend(chunk.into_iter().map(|row| row[1].clone()));
+        }
+        assert!(sorted.stats().runs > 1);
+        assert_eq!(values, vec!["-1", "1.50", "10", "2", "9", "abc"]);
+
+        // 只有数值时按数值排序，小数保留原样
+        input.rows.truncate(4);
+        sorted = op.sort_stream(Box::new(MaterializedSource::new(input, 2))).unwrap();
+        let mut values = Vec::new();
+        while let Some(chunk) = sorted.next_rows().await.unwrap() {
+            values.extend(chunk.into_iter().map(|row| row[1].clone()));
+        }
+        assert_eq!(values, vec!["1.50", "2", "9", "10"]);
+        drop(sorted);
+        assert_eq!(memory.get_stats().work_memory_allocated, 0);
+    }
 
-        let top_rows = self.perform_top_n_sort(input_data).await?;
+    #[tokio::test]
+    async fn test_top_n_keeps_smallest_in_order() {
+        let memory = Arc::new(MemoryManager::new());
+        let op = TopNOperator::new(plan(), vec!["id".to_string()], 3, memory, Arc::new(BufferPool::new()));
+        let top = op.execute_columnar().await.unwrap();
+        assert_eq!(ids(&top), vec!["1", "2", "3"]);
 
-        let mut result = QueryResult::new();
-        result.columns = vec!["id".to_string(), "name".to_string(), "value".to_string()];
-        result.rows = top_rows;
-        result.affected_rows = result.rows.len() as u64;
+        let external = ExternalSortOperator::new(plan(), vec!["id".to_string()], Arc::new(MemoryManager::new()), Arc::new(BufferPool::new()));
+        let sorted = external.execute_columnar().await.unwrap();
+        assert_eq!(ids(&sorted)[..3], ids(&top)[..]);
+    }
 
-        info!("Top {} operation completed, returned {} rows", self.limit, result.affected_rows);
-        Ok(result)
+    #[tokio::test]
+    async fn test_external_sort_respects_operator_budget() {
+        let memory = Arc::new(MemoryManager::new());
+        let query = memory.query_context("q", 1024 * 1024);
+        let context = query.operator("sort", Some(128 * 1024));
+        let mut op = ExternalSortOperator::new(plan(), vec!["id".to_string()], memory.clone(), Arc::new(BufferPool::new()));
+        op.set_memory_context(context.clone());
+
+        let sorted = op.execute_columnar().await.unwrap();
+        assert_eq!(sorted.num_rows(), 5);
+        // 段缓冲被压到算子额度以内，结束后全部归还
+        assert_eq!(context.peak(), 128 * 1024);
+        assert_eq!(context.used(), 0);
+        assert_eq!(memory.get_stats().work_memory_allocated, 0);
     }
-}
\ No newline at end of file
+}
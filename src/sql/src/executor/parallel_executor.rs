@@ -1,3 +1,4 @@
+use async_trait::async_trait;
 use common::Result;
 use std::sync::{Arc, Mutex, RwLock};
 use std::collections::HashMap;
@@ -5,12 +6,29 @@ use std::time::{Duration, Instant};
 use tokio::sync::Semaphore;
 use crate::storage::worker_pool::{WorkerPool, WorkerPoolConfig, TaskInfo, TaskPriority, TaskType};
 use crate::optimizer::{OptimizedPlan, PlanNode};
+use crate::parser::ParsedExpression;
 use crate::executor::{executor::ExecutionContext, execution_models::QueryResult};
+use crate::executor::compiled_expr::{bind_column, CompiledExpr};
+use crate::executor::morsel::{KeyRange, MorselScheduler, MorselSchedulerStats, DEFAULT_MORSELS_PER_WORKER};
+use crate::executor::profile::OperatorProfile;
+use crate::executor::record_batch::{Field, RecordBatch, Schema};
+use crate::executor::result_stream::{LimitSource, MaterializedSource, RowSource, DEFAULT_RESULT_CHUNK_ROWS};
+use crate::executor::storage_executor::{open_top_n, StorageExecutor};
+use crate::executor::operators::operator_trait::Operator;
+use crate::executor::operators::scan_operators::{BitmapCondition, BitmapScanOperator, SeqScanOperator};
+use crate::storage::bitmap_index::BITMAP_INDEX_PREFIX;
+use crate::storage::handler::TableScanStream;
+use crate::storage::pushdown::to_zone_predicates;
+use crate::storage::table_catalog::TableCatalog;
+use storage::index::ZonePredicate;
+use common::DataType;
 
 /// 并行查询执行器
 pub struct ParallelQueryExecutor {
     /// 工作线程池
     worker_pool: Arc<WorkerPool>,
+    /// morsel 工作窃取调度器
+    scheduler: Arc<MorselScheduler>,
     /// 并行度控制信号量
     parallelism_semaphore: Arc<Semaphore>,
     /// 当前并行度
@@ -19,6 +37,8 @@ pub struct ParallelQueryExecutor {
     execution_stats: Arc<Mutex<ParallelExecutionStats>>,
     /// 配置
     config: Arc<RwLock<ParallelExecutorConfig>>,
+    /// 扫描所用的存储感知执行器，未设置时扫描没有数据源
+    storage_executor: RwLock<Option<Arc<StorageExecutor>>>,
 }
 
 /// 并行执行器配置
@@ -40,6 +60,8 @@ pub struct ParallelExecutorConfig {
     pub enable_task_priority: bool,
     /// 查询超时时间（秒）
     pub query_timeout_seconds: u64,
+    /// 每个工作线程分到的扫描 morsel 数
+    pub morsels_per_worker: usize,
 }
 
 impl Default for ParallelExecutorConfig {
@@ -57,6 +79,7 @@ impl Default for ParallelExecutorConfig {
             memory_usage_threshold: 0.8,
             enable_task_priority: true,
             query_timeout_seconds: 300,
+            morsels_per_worker: DEFAULT_MORSELS_PER_WORKER,
         }
     }
 }
@@ -91,35 +114,7 @@ impl ParallelExecutionStats {
 
 impl ParallelQueryExecutor {
     pub fn new() -> Self {
-        let config = ParallelExecutorConfig::default();
-        let worker_pool_config = WorkerPoolConfig {
-            min_worker_threads: 2,
-            max_worker_threads: config.max_parallelism,
-            initial_worker_threads: config.default_parallelism,
-            task_queue_size: 1000,
-            enable_thread_monitoring: true,
-            thread_idle_timeout_seconds: 300,
-            enable_task_priority: config.enable_task_priority,
-            max_parallelism: config.max_parallelism,
-            enable_dynamic_adjustment: config.enable_dynamic_adjustment,
-            adjustment_check_interval_seconds: config.adjustment_check_interval_seconds,
-            cpu_usage_threshold: config.cpu_usage_threshold,
-            memory_usage_threshold: config.memory_usage_threshold,
-        };
-
-        let worker_pool = Arc::new(WorkerPool::with_config(worker_pool_config));
-        let parallelism_semaphore = Arc::new(Semaphore::new(config.default_parallelism));
-        let current_parallelism = Arc::new(Mutex::new(config.default_parallelism));
-        let execution_stats = Arc::new(Mutex::new(ParallelExecutionStats::new()));
-        let config = Arc::new(RwLock::new(config));
-
-        Self {
-            worker_pool,
-            parallelism_semaphore,
-            current_parallelism,
-            execution_stats,
-            config,
-        }
+        Self::with_config(ParallelExecutorConfig::default())
     }
 
     pub fn with_config(config: ParallelExecutorConfig) -> Self {
@@ -139,6 +134,7 @@ impl ParallelQueryExecutor {
         };
 
         let worker_pool = Arc::new(WorkerPool::with_config(worker_pool_config));
+        let scheduler = Arc::new(MorselScheduler::new(config.default_parallelism));
         let parallelism_semaphore = Arc::new(Semaphore::new(config.default_parallelism));
         let current_parallelism = Arc::new(Mutex::new(config.default_parallelism));
         let execution_stats = Arc::new(Mutex::new(ParallelExecutionStats::new()));
@@ -146,13 +142,20 @@ impl ParallelQueryExecutor {
 
         Self {
             worker_pool,
+            scheduler,
             parallelism_semaphore,
             current_parallelism,
             execution_stats,
             config,
+            storage_executor: RwLock::new(None),
         }
     }
 
+    /// 设置扫描所用的存储感知执行器
+    pub fn set_storage_executor(&self, storage_executor: Arc<StorageExecutor>) {
+        *self.storage_executor.write().unwrap() = Some(storage_executor);
+    }
+
     /// 并行执行查询计划
     pub async fn execute_parallel(&self, plan: OptimizedPlan, context: &ExecutionContext) -> Result<QueryResult> {
         let start_time = Instant::now();
@@ -278,31 +281,43 @@ impl ParallelQueryExecutor {
     }
 
     /// 并行执行
+    ///
+    /// 计划中的扫描按键范围切分为 morsel，交给工作窃取调度器；
+    /// 每个 morsel 在领取它的工作线程内跑完整条流水线，线程之间只交换最终结果。
     async fn execute_with_parallelism(&self, plan: OptimizedPlan, context: &ExecutionContext, parallelism: usize) -> Result<QueryResult> {
         // 获取并行度许可
         let _permit = self.parallelism_semaphore.clone().acquire_owned().await
             .map_err(|e| common::Error::Storage(e.to_string()))?;
 
-        // 将节点分组
-        let node_groups = self.group_nodes_for_parallel_execution(plan.nodes, parallelism);
-
-        // 并行执行每个组
-        let mut tasks = Vec::new();
-        for group in node_groups {
-            let context = context.clone();
-            let task = move || {
-                // 这里应该实现实际的节点执行逻辑
-                // 暂时返回空结果
-                QueryResult::new()
-            };
-            tasks.push(task);
+        let workers = parallelism.max(1).min(self.scheduler.num_workers());
+        let morsels_per_worker = self.config.read().unwrap().morsels_per_worker.max(1);
+        let morsels = Self::plan_scan_morsels(&plan.nodes, workers * morsels_per_worker);
+        let storage = self.storage_executor.read().unwrap().clone();
+        let Some(storage) = storage.filter(|_| !morsels.is_empty()) else {
+            // 计划中没有可切分的扫描，或没有可读的存储
+            return self.execute_sequential(plan, context).await;
+        };
+        let morsels = Self::prune_morsels(&storage, &plan.nodes, morsels).await;
+
+        // 走位图索引的流水线只读命中的行，不切分 morsel
+        let mut final_result = QueryResult::new();
+        for node in plan.nodes.iter().filter(|node| Self::pipeline_bitmap_scan(node).is_some()) {
+            final_result.merge(self.execute_node(node.clone(), context).await?);
         }
 
-        // 使用工作线程池并行执行
-        let results = self.worker_pool.execute_parallel(tasks)?;
+        let nodes = Arc::new(plan.nodes);
+        let scheduler = self.scheduler.clone();
+        let runtime = tokio::runtime::Handle::current();
+        let context = context.clone();
+        let results = tokio::task::spawn_blocking(move || {
+            scheduler.run_with_workers(workers, morsels, |_, morsel| {
+                Self::run_pipeline(&nodes[morsel.node], &morsel, &storage, &runtime, &context)
+            })
+        })
+        .await
+        .map_err(|e| common::Error::Execution(format!("morsel scheduling failed: {}", e)))??;
 
         // 合并结果
-        let mut final_result = QueryResult::new();
         for result in results {
             final_result.merge(result);
         }
@@ -310,6 +325,352 @@ impl ParallelQueryExecutor {
         Ok(final_result)
     }
 
+    /// 把计划中每条以扫描为叶子的流水线切分为键范围 morsel
+    fn plan_scan_morsels(nodes: &[PlanNode], morsels_per_scan: usize) -> Vec<ScanMorsel> {
+        let mut morsels = Vec::new();
+        for (index, node) in nodes.iter().enumerate() {
+            if Self::pipeline_bitmap_scan(node).is_some() {
+                continue;
+            }
+            let Some((table, columns)) = Self::pipeline_scan(node) else { continue };
+            for range in KeyRange::for_table(table).split(morsels_per_scan) {
+                morsels.push(ScanMorsel { node: index, table: table.clone(), columns: columns.clone(), range });
+            }
+        }
+        morsels
+    }
+
+    /// 用区间摘要裁掉 morsel 中不可能有匹配行的键范围
+    ///
+    /// 一个 morsel 可能被切成几段，也可能整个被去掉；流水线没有可用的区间谓词时原样保留。
+    async fn prune_morsels(storage: &StorageExecutor, nodes: &[PlanNode], morsels: Vec<ScanMorsel>) -> Vec<ScanMorsel> {
+        let handler = storage.storage_handler();
+        let mut candidates: HashMap<usize, Option<Vec<(storage::Key, storage::Key)>>> = HashMap::new();
+        let mut pruned = Vec::with_capacity(morsels.len());
+        for morsel in morsels {
+            if !candidates.contains_key(&morsel.node) {
+                let predicates = Self::pipeline_zone_predicates(&nodes[morsel.node], &morsel.table, handler.table_catalog());
+                let ranges = match predicates.is_empty() {
+                    true => None,
+                    false => Some(handler.zone_candidate_ranges(&morsel.table, &predicates).await),
+                };
+                candidates.insert(morsel.node, ranges);
+            }
+            let Some(ranges) = &candidates[&morsel.node] else {
+                pruned.push(morsel);
+                continue;
+            };
+            for (start, end) in ranges {
+                if let Some(range) = morsel.range.intersect(start, end) {
+                    pruned.push(ScanMorsel { range, ..morsel.clone() });
+                }
+            }
+        }
+        pruned
+    }
+
+    /// 流水线中各过滤条件可用区间摘要判断的部分，列 ID 取自表结构目录
+    fn pipeline_zone_predicates(node: &PlanNode, table: &str, catalog: &TableCatalog) -> Vec<ZonePredicate> {
+        match node {
+            PlanNode::Filter { input, predicate } => {
+                let mut predicates = Self::pipeline_zone_predicates(input, table, catalog);
+                predicates.extend(to_zone_predicates(predicate, &|name| catalog.column(table, name).map(|c| c.column_id)));
+                predicates
+            }
+            PlanNode::Project { input, .. } => Self::pipeline_zone_predicates(input, table, catalog),
+            _ => Vec::new(),
+        }
+    }
+
+    /// 流水线叶子上的扫描：只穿过逐行处理的过滤与投影，遇到其他算子返回 `None`
+    fn pipeline_scan(node: &PlanNode) -> Option<(&String, &Vec<String>)> {
+        match node {
+            PlanNode::TableScan { table, columns } => Some((table, columns)),
+            PlanNode::IndexScan { table, columns, .. } => Some((table, columns)),
+            PlanNode::Filter { input, .. } | PlanNode::Project { input, .. } => Self::pipeline_scan(input),
+            _ => None,
+        }
+    }
+
+    /// 流水线叶子上的位图索引扫描：`IndexScan` 由 `IndexSelectionRule` 换入，
+    /// 紧邻其上的过滤条件即索引条件，返回 (表, 列, 条件)
+    fn pipeline_bitmap_scan(node: &PlanNode) -> Option<(&String, &Vec<String>, &ParsedExpression)> {
+        match node {
+            PlanNode::Filter { input, predicate } => match input.as_ref() {
+                PlanNode::IndexScan { table, index, columns } if index.starts_with(BITMAP_INDEX_PREFIX) => {
+                    Some((table, columns, predicate))
+                }
+                other => Self::pipeline_bitmap_scan(other),
+            },
+            PlanNode::Project { input, .. } => Self::pipeline_bitmap_scan(input),
+            _ => None,
+        }
+    }
+
+    /// 用 BitmapScanOperator 读出位图条件命中的行；条件无法翻译为位图运算时返回 `None`
+    async fn bitmap_scan(
+        storage: &Arc<StorageExecutor>,
+        table: &str,
+        columns: &[String],
+        predicate: &ParsedExpression,
+        context: &ExecutionContext,
+    ) -> Result<Option<QueryResult>> {
+        let Some(conditions) = BitmapCondition::from_predicate(predicate) else {
+            return Ok(None);
+        };
+        let mut scan = BitmapScanOperator::new(
+            table.to_string(),
+            columns.to_vec(),
+            context.buffer_pool.clone(),
+            context.memory_manager.clone(),
+        )
+        .with_storage(storage.clone());
+        for condition in conditions {
+            scan.add_bitmap_condition(condition.column, condition.values, condition.operation);
+        }
+        scan.execute().await.map(Some)
+    }
+
+    /// 在当前工作线程内对单个 morsel 运行扫描之上的流水线
+    ///
+    /// 工作线程不在运行时内，存储读取通过运行时句柄同步等待。
+    fn run_pipeline(
+        node: &PlanNode,
+        morsel: &ScanMorsel,
+        storage: &StorageExecutor,
+        runtime: &tokio::runtime::Handle,
+        context: &ExecutionContext,
+    ) -> Result<QueryResult> {
+        let scanned = runtime.block_on(Self::scan_morsel(storage, morsel, context))?;
+        Self::apply_pipeline(node, scanned)
+    }
+
+    /// 读出 morsel 键范围内的全部行
+    async fn scan_morsel(storage: &StorageExecutor, morsel: &ScanMorsel, context: &ExecutionContext) -> Result<QueryResult> {
+        let mut scan = storage.open_range_scan(&morsel.table, &morsel.range, &morsel.columns, context).await?;
+        let mut result = QueryResult::new();
+        result.columns = scan.columns().to_vec();
+        while let Some(rows) = scan.next_rows().await? {
+            result.rows.extend(rows);
+        }
+        Ok(result)
+    }
+
+    /// 在扫描出的行上自底向上执行流水线中的过滤与投影
+    fn apply_pipeline(node: &PlanNode, scanned: QueryResult) -> Result<QueryResult> {
+        match node {
+            PlanNode::TableScan { .. } | PlanNode::IndexScan { .. } => Ok(scanned),
+            PlanNode::Filter { input, predicate } if Self::evaluated_by_index(input, predicate) => {
+                Self::apply_pipeline(input, scanned)
+            }
+            PlanNode::Filter { input, predicate } => Self::filter_rows(Self::apply_pipeline(input, scanned)?, predicate),
+            PlanNode::Project { input, columns } => Self::project_rows(Self::apply_pipeline(input, scanned)?, columns),
+            other => Err(common::Error::Execution(format!("{:?} cannot run inside a scan pipeline", other))),
+        }
+    }
+
+    /// 按流执行 LIMIT (流水线) 与 LIMIT (排序 (流水线))，输入不是以扫描为叶子的流水线时返回 `None`
+    ///
+    /// 排序之上的 LIMIT 改为 TopN，只保留前 limit + offset 行；LIMIT 凑满后丢弃上游，
+    /// 表扫描流随之取消存储层的预读，不再读后面的页。
+    async fn execute_limit(storage: &Arc<StorageExecutor>, node: &PlanNode, context: &ExecutionContext) -> Result<Option<QueryResult>> {
+        let PlanNode::Limit { input, limit, offset } = node else {
+            return Ok(None);
+        };
+        let keep = limit.saturating_add(*offset);
+        let source = match input.as_ref() {
+            PlanNode::Sort { input, order_by } => {
+                let Some(pipeline) = Self::open_pipeline(storage, input, None, context).await? else {
+                    return Ok(None);
+                };
+                open_top_n(pipeline, order_by, usize::try_from(keep).unwrap_or(usize::MAX), context)?
+            }
+            pipeline => match Self::open_pipeline(storage, pipeline, Some(keep), context).await? {
+                Some(pipeline) => pipeline,
+                None => return Ok(None),
+            },
+        };
+        let mut limited = LimitSource::new(source, *limit, *offset);
+        let mut result = QueryResult::new();
+        result.columns = limited.columns().to_vec();
+        while let Some(rows) = limited.next_rows().await? {
+            result.rows.extend(rows);
+        }
+        Ok(Some(result))
+    }
+
+    /// 以扫描为叶子的流水线的流式结果源，不是这样的流水线时返回 `None`
+    ///
+    /// `limit` 为上层要的行数，流水线中没有过滤时直接交给存储层的扫描；
+    /// 走位图索引的流水线只读命中的行，物化后按块交出。
+    async fn open_pipeline(
+        storage: &Arc<StorageExecutor>,
+        node: &PlanNode,
+        limit: Option<u64>,
+        context: &ExecutionContext,
+    ) -> Result<Option<Box<dyn RowSource>>> {
+        if let Some((table, columns, predicate)) = Self::pipeline_bitmap_scan(node) {
+            if let Some(scanned) = Self::bitmap_scan(storage, table, columns, predicate, context).await? {
+                let result = Self::apply_pipeline(node, scanned)?;
+                return Ok(Some(Box::new(MaterializedSource::new(result, DEFAULT_RESULT_CHUNK_ROWS))));
+            }
+        }
+        let Some((table, columns)) = Self::pipeline_scan(node) else {
+            return Ok(None);
+        };
+        let scan_limit = limit
+            .filter(|_| !Self::pipeline_filters(node))
+            .map(|limit| u32::try_from(limit).unwrap_or(u32::MAX));
+        let scan = storage.open_table_scan(table, columns, scan_limit, context).await?;
+        Ok(Some(Box::new(PipelineSource::new(node.clone(), scan))))
+    }
+
+    /// 流水线中是否有过滤，有过滤时扫描出的行数与输出行数不同
+    fn pipeline_filters(node: &PlanNode) -> bool {
+        match node {
+            PlanNode::Filter { .. } => true,
+            PlanNode::Project { input, .. } => Self::pipeline_filters(input),
+            _ => false,
+        }
+    }
+
+    /// 紧邻位图索引扫描且能翻译为位图运算的过滤条件已由索引求值，条件列可以不在投影中
+    fn evaluated_by_index(input: &PlanNode, predicate: &ParsedExpression) -> bool {
+        matches!(input, PlanNode::IndexScan { index, .. } if index.starts_with(BITMAP_INDEX_PREFIX))
+            && BitmapCondition::from_predicate(predicate).is_some()
+    }
+
+    fn filter_rows(input: QueryResult, predicate: &ParsedExpression) -> Result<QueryResult> {
+        let batch = RecordBatch::from_query_result(&input)?;
+        let predicate = CompiledExpr::compile(predicate, &batch.schema)?;
+        let mut result = predicate.filter(batch)?.into_query_result();
+        result.affected_rows = input.affected_rows;
+        Ok(result)
+    }
+
+    fn project_rows(mut input: QueryResult, columns: &[String]) -> Result<QueryResult> {
+        if columns.iter().any(|c| c == "*") {
+            return Ok(input);
+        }
+        let schema = Schema::new(input.columns.iter().map(|c| Field::new(c.clone(), DataType::String)).collect());
+        let indices = columns.iter().map(|c| bind_column(&schema, c)).collect::<Result<Vec<_>>>()?;
+        for row in &mut input.rows {
+            *row = indices.iter().map(|&i| row.get(i).cloned().unwrap_or_default()).collect();
+        }
+        input.columns = columns.to_vec();
+        Ok(input)
+    }
+
+    /// 执行计划并收集各节点的运行时画像 (EXPLAIN ANALYZE)
+    ///
+    /// 节点按 `execute_node` 的路径逐个执行，不切分 morsel：整体下推的片段记为一个
+    /// `Pushdown` 算子，按流执行的 LIMIT 记为一个 `Limit` 算子，其余流水线逐层记录扫描、
+    /// 过滤与投影；不在这条路径上执行的节点只记录名称。
+    pub async fn execute_profiled(&self, plan: OptimizedPlan, context: &ExecutionContext) -> Result<(QueryResult, Vec<OperatorProfile>)> {
+        let mut result = QueryResult::new();
+        let mut profiles = Vec::with_capacity(plan.nodes.len());
+        for node in &plan.nodes {
+            let (node_result, profile) = self.profile_node(node, context).await?;
+            result.merge(node_result);
+            profiles.push(profile);
+        }
+        Ok((result, profiles))
+    }
+
+    async fn profile_node(&self, node: &PlanNode, context: &ExecutionContext) -> Result<(QueryResult, OperatorProfile)> {
+        let started = Instant::now();
+        let storage = self.storage_executor.read().unwrap().clone();
+        if let (Some(storage), PlanNode::Limit { input, limit, offset }) = (&storage, node) {
+            let (name, result) = match storage.execute_pushdown(node, context).await? {
+                Some(result) => ("Pushdown", Some(result)),
+                None => ("Limit", Self::execute_limit(storage, node, context).await?),
+            };
+            if let Some(result) = result {
+                let detail = format!("{} {} offset {} <- {}", Self::node_name(node), limit, offset, Self::node_name(input));
+                let mut profile = OperatorProfile::new(name, detail);
+                profile.finish_result(&result, 1, started.elapsed());
+                return Ok((result, profile));
+            }
+        }
+        let scan = Self::pipeline_scan(node);
+        let (Some(storage), Some((table, columns))) = (storage, scan) else {
+            let mut profile = OperatorProfile::new(Self::node_name(node), "");
+            profile.wall_time = started.elapsed();
+            return Ok((QueryResult::new(), profile));
+        };
+
+        if let Some((table, columns, predicate)) = Self::pipeline_bitmap_scan(node) {
+            if let Some(scanned) = Self::bitmap_scan(&storage, table, columns, predicate, context).await? {
+                let mut scan_profile = OperatorProfile::new("", table.clone());
+                scan_profile.finish_result(&scanned, 1, started.elapsed());
+                return Self::profile_pipeline(node, scanned, scan_profile);
+            }
+        }
+
+        if let Some(result) = storage.execute_pushdown(node, context).await? {
+            let mut profile = OperatorProfile::new("Pushdown", format!("{} <- {}", Self::node_name(node), table));
+            profile.finish_result(&result, 1, started.elapsed());
+            return Ok((result, profile));
+        }
+
+        let handler = storage.storage_handler();
+        let predicates = Self::pipeline_zone_predicates(node, table, handler.table_catalog());
+        let mut scanned = QueryResult::new();
+        let mut chunks = 0;
+        for (start, end) in handler.zone_candidate_ranges(table, &predicates).await {
+            let range = KeyRange::new(start.to_vec(), end.to_vec());
+            let mut stream = storage.open_range_scan(table, &range, columns, context).await?;
+            scanned.columns = stream.columns().to_vec();
+            while let Some(rows) = stream.next_rows().await? {
+                scanned.rows.extend(rows);
+                chunks += 1;
+            }
+        }
+        let mut scan_profile = OperatorProfile::new("", table.clone());
+        scan_profile.finish_result(&scanned, chunks, started.elapsed());
+        Self::profile_pipeline(node, scanned, scan_profile)
+    }
+
+    /// `apply_pipeline` 的插桩版本，返回最上层算子的画像
+    fn profile_pipeline(node: &PlanNode, scanned: QueryResult, mut scan: OperatorProfile) -> Result<(QueryResult, OperatorProfile)> {
+        let (input, detail) = match node {
+            PlanNode::Filter { input, predicate } if Self::evaluated_by_index(input, predicate) => {
+                return Self::profile_pipeline(input, scanned, scan);
+            }
+            PlanNode::Filter { input, predicate } => (input, predicate.to_string()),
+            PlanNode::Project { input, columns } => (input, columns.join(", ")),
+            _ => {
+                scan.name = Self::node_name(node).to_string();
+                return Ok((scanned, scan));
+            }
+        };
+        let (input_rows, child) = Self::profile_pipeline(input, scanned, scan)?;
+        let started = Instant::now();
+        let mut profile = OperatorProfile::new(Self::node_name(node), detail);
+        let child_wall = child.wall_time;
+        profile.add_child(child);
+        let output = profile.cpu(|| match node {
+            PlanNode::Filter { predicate, .. } => Self::filter_rows(input_rows, predicate),
+            PlanNode::Project { columns, .. } => Self::project_rows(input_rows, columns),
+            _ => unreachable!("only filters and projections wrap a scan pipeline"),
+        })?;
+        profile.finish_result(&output, 1, child_wall + started.elapsed());
+        Ok((output, profile))
+    }
+
+    fn node_name(node: &PlanNode) -> &'static str {
+        match node {
+            PlanNode::TableScan { .. } => "TableScan",
+            PlanNode::IndexScan { .. } => "IndexScan",
+            PlanNode::Filter { .. } => "Filter",
+            PlanNode::Project { .. } => "Project",
+            PlanNode::Join { .. } => "Join",
+            PlanNode::Aggregate { .. } => "Aggregate",
+            PlanNode::Sort { .. } => "Sort",
+            PlanNode::Limit { .. } => "Limit",
+        }
+    }
+
     /// 混合执行（部分并行，部分顺序）
     async fn execute_mixed(&self, plan: OptimizedPlan, context: &ExecutionContext, sequential_parts: Vec<usize>, parallel_parts: Vec<usize>) -> Result<QueryResult> {
         let mut result = QueryResult::new();
@@ -346,10 +707,38 @@ impl ParallelQueryExecutor {
     }
 
     /// 执行单个节点
+    ///
+    /// 走位图索引的流水线只读出命中的行；能整体下推的片段交给存储端执行；LIMIT 及其下的
+    /// 排序按流执行，凑满所需的行即停止扫描；其余以扫描为叶子的流水线由 SeqScanOperator
+    /// 读取 (按过滤条件跳过区间) 后在本地执行。其他节点由算子执行路径处理，这里返回空结果。
     async fn execute_node(&self, node: PlanNode, context: &ExecutionContext) -> Result<QueryResult> {
-        // 这里应该实现具体的节点执行逻辑
-        // 暂时返回空结果
-        Ok(QueryResult::new())
+        let Some(storage) = self.storage_executor.read().unwrap().clone() else {
+            return Ok(QueryResult::new());
+        };
+        if let Some((table, columns, predicate)) = Self::pipeline_bitmap_scan(&node) {
+            if let Some(scanned) = Self::bitmap_scan(&storage, table, columns, predicate, context).await? {
+                return Self::apply_pipeline(&node, scanned);
+            }
+        }
+        if let Some(result) = storage.execute_pushdown(&node, context).await? {
+            return Ok(result);
+        }
+        if let Some(result) = Self::execute_limit(&storage, &node, context).await? {
+            return Ok(result);
+        }
+        let Some((table, columns)) = Self::pipeline_scan(&node) else {
+            return Ok(QueryResult::new());
+        };
+        let mut scan = SeqScanOperator::new(
+            table.clone(),
+            columns.clone(),
+            context.buffer_pool.clone(),
+            context.memory_manager.clone(),
+        )
+        .with_storage(storage.clone());
+        scan.set_zone_predicates(Self::pipeline_zone_predicates(&node, table, storage.storage_handler().table_catalog()));
+        let scanned = scan.execute().await?;
+        Self::apply_pipeline(&node, scanned)
     }
 
     /// 将节点分组用于并行执行
@@ -378,6 +767,7 @@ impl ParallelQueryExecutor {
             let mut current = self.current_parallelism.lock().unwrap();
             *current = new_parallelism;
         }
+        self.scheduler.set_num_workers(new_parallelism);
 
         // 更新统计信息
         {
@@ -396,6 +786,11 @@ impl ParallelQueryExecutor {
         self.execution_stats.lock().unwrap().clone()
     }
 
+    /// 获取 morsel 调度统计
+    pub fn get_scheduler_stats(&self) -> MorselSchedulerStats {
+        self.scheduler.stats()
+    }
+
     /// 获取工作线程池统计
     pub fn get_worker_pool_stats(&self) -> crate::storage::worker_pool::WorkerPoolStats {
         self.worker_pool.get_stats()
@@ -407,19 +802,104 @@ impl ParallelQueryExecutor {
     }
 
     /// 动态调整并行度
+    ///
+    /// 依据最近一次 morsel 调度的线程利用率：利用率低说明线程在空等，减半并行度；
+    /// 利用率接近饱和时再放大，上限为配置的最大并行度。
     pub fn adjust_parallelism_dynamically(&self) -> Result<()> {
-        let config = self.config.read().unwrap();
-        if !config.enable_dynamic_adjustment {
+        let (max_parallelism, threshold) = {
+            let config = self.config.read().unwrap();
+            if !config.enable_dynamic_adjustment {
+                return Ok(());
+            }
+            (config.max_parallelism, config.cpu_usage_threshold)
+        };
+
+        let stats = self.scheduler.stats();
+        if stats.runs == 0 {
             return Ok(());
         }
 
-        // TODO: 实现基于系统负载的动态调整
-        // 这里可以根据 CPU 使用率、内存使用率等指标调整并行度
+        let current = self.scheduler.num_workers();
+        let target = if stats.last_utilization < threshold / 2.0 {
+            (current / 2).max(1)
+        } else if stats.last_utilization >= threshold {
+            (current * 2).min(max_parallelism)
+        } else {
+            current
+        };
 
+        if target != current {
+            self.adjust_parallelism(target)?;
+        }
         Ok(())
     }
 }
 
+/// 扫描 morsel：一张表的一段键范围
+#[derive(Debug, Clone)]
+struct ScanMorsel {
+    /// 所属流水线在计划节点中的下标
+    node: usize,
+    table: String,
+    columns: Vec<String>,
+    range: KeyRange,
+}
+
+/// 逐块执行的扫描流水线：每从表扫描流读到一块，就在这一块上执行过滤与投影
+struct PipelineSource {
+    node: PlanNode,
+    scan: TableScanStream,
+    columns: Vec<String>,
+    schema: Option<Schema>,
+}
+
+impl PipelineSource {
+    fn new(node: PlanNode, scan: TableScanStream) -> Self {
+        let columns = Self::output_columns(&node).unwrap_or_else(|| scan.columns().to_vec());
+        // 输出列是扫描列的子集，类型沿用扫描按表定义给出的类型
+        let schema = scan.schema().and_then(|schema| {
+            columns
+                .iter()
+                .map(|c| bind_column(&schema, c).map(|i| Field::new(c.clone(), schema.fields[i].data_type.clone())))
+                .collect::<Result<Vec<_>>>()
+                .ok()
+                .map(Schema::new)
+        });
+        Self { node, scan, columns, schema }
+    }
+
+    /// 最上层投影的列，没有投影或投影 `*` 时返回 `None`，即扫描列
+    fn output_columns(node: &PlanNode) -> Option<Vec<String>> {
+        match node {
+            PlanNode::Project { columns, .. } if !columns.iter().any(|c| c == "*") => Some(columns.clone()),
+            PlanNode::Project { input, .. } | PlanNode::Filter { input, .. } => Self::output_columns(input),
+            _ => None,
+        }
+    }
+}
+
+#[async_trait]
+impl RowSource for PipelineSource {
+    fn columns(&self) -> &[String] {
+        &self.columns
+    }
+
+    fn schema(&self) -> Option<Schema> {
+        self.schema.clone()
+    }
+
+    async fn next_rows(&mut self) -> Result<Option<Vec<Vec<String>>>> {
+        while let Some(rows) = self.scan.next_rows().await? {
+            let scanned = QueryResult { columns: self.scan.columns().to_vec(), rows, ..QueryResult::new() };
+            let output = ParallelQueryExecutor::apply_pipeline(&self.node, scanned)?;
+            if !output.rows.is_empty() {
+                return Ok(Some(output.rows));
+            }
+        }
+        Ok(None)
+    }
+}
+
 /// 并行策略
 #[derive(Debug, Clone)]
 pub enum ParallelStrategy {
@@ -479,6 +959,332 @@ mod tests {
         assert!(result.is_err());
     }
 
+    #[test]
+    fn test_plan_scan_morsels() {
+        let nodes = vec![
+            PlanNode::TableScan { table: "t1".to_string(), columns: vec!["id".to_string()] },
+            PlanNode::TableScan { table: "t2".to_string(), columns: vec![] },
+        ];
+        let morsels = ParallelQueryExecutor::plan_scan_morsels(&nodes, 8);
+        assert_eq!(morsels.len(), 16);
+        assert!(morsels[..8].iter().all(|m| m.table == "t1" && m.columns == vec!["id".to_string()]));
+        assert_eq!(morsels[0].range.start, KeyRange::for_table("t1").start);
+        assert_eq!(morsels[7].range.end, KeyRange::for_table("t1").end);
+    }
+
+    #[tokio::test(flavor = "multi_thread", worker_threads = 2)]
+    async fn test_morsel_pipelines_read_their_key_ranges() {
+        use crate::parser::{ParsedExpression, ParsedOperator, ParsedValue};
+        use storage::codec::{self, Datum};
+
+        let storage = Arc::new(StorageExecutor::new());
+        let context = ExecutionContext::default();
+        for (key, score) in [("a", "10"), ("c", "30"), ("m", "20"), ("x", "40")] {
+            storage.execute_insert("scores", key, score, &context).await.unwrap();
+        }
+        let executor = ParallelQueryExecutor::new();
+        executor.set_storage_executor(storage.clone());
+
+        let scan = PlanNode::TableScan { table: "scores".to_string(), columns: vec!["score".to_string()] };
+        let filter = PlanNode::Filter {
+            input: Box::new(scan.clone()),
+            predicate: ParsedExpression::BinaryOp {
+                left: Box::new(ParsedExpression::Column("score".to_string())),
+                operator: ParsedOperator::GreaterThan,
+                right: Box::new(ParsedExpression::Literal(ParsedValue::Number("15".to_string()))),
+            },
+        };
+
+        // 在行键 "m" 处切成两个 morsel，每个只读到自己范围内的行
+        let table = KeyRange::for_table("scores");
+        let boundary = codec::record_key("scores", &[Datum::Bytes(b"m".to_vec())]).to_vec();
+        let morsels = vec![
+            ScanMorsel { node: 0, table: "scores".to_string(), columns: vec!["score".to_string()], range: KeyRange::new(table.start.clone(), boundary.clone()) },
+            ScanMorsel { node: 0, table: "scores".to_string(), columns: vec!["score".to_string()], range: KeyRange::new(boundary, table.end.clone()) },
+        ];
+        let runtime = tokio::runtime::Handle::current();
+        let (pipeline, pipeline_storage, pipeline_context) = (filter.clone(), storage.clone(), context.clone());
+        let results = tokio::task::spawn_blocking(move || {
+            morsels
+                .iter()
+                .map(|m| ParallelQueryExecutor::run_pipeline(&pipeline, m, &pipeline_storage, &runtime, &pipeline_context).unwrap())
+                .collect::<Vec<_>>()
+        })
+        .await
+        .unwrap();
+        assert_eq!(results[0].columns, vec!["score".to_string()]);
+        assert_eq!(results[0].rows, vec![vec!["30".to_string()]]);
+        assert_eq!(results[1].rows, vec![vec!["20".to_string()], vec!["40".to_string()]]);
+
+        // 经 morsel 调度执行整个计划：过滤流水线与全表扫描的行都被读出
+        let plan = OptimizedPlan { nodes: vec![filter.clone(), scan], estimated_cost: 2.0, estimated_rows: 7 };
+        let result = executor.execute_parallel(plan, &context).await.unwrap();
+        let mut values: Vec<i64> = result.rows.iter().map(|row| row[0].parse().unwrap()).collect();
+        values.sort_unstable();
+        assert_eq!(values, vec![10, 20, 20, 30, 30, 40, 40]);
+        assert!(executor.get_scheduler_stats().runs > 0);
+
+        // 插桩执行读同一份存储：过滤的输入行数等于扫描的输出行数
+        let plan = OptimizedPlan { nodes: vec![filter], estimated_cost: 1.0, estimated_rows: 3 };
+        let (profiled, profiles) = executor.execute_profiled(plan, &context).await.unwrap();
+        assert_eq!(profiled.rows.len(), 3);
+        let filter = &profiles[0];
+        assert_eq!((filter.name.as_str(), filter.rows_in, filter.rows_out), ("Filter", 4, 3));
+        assert_eq!((filter.children[0].name.as_str(), filter.children[0].rows_out), ("TableScan", 4));
+        assert_eq!(filter.peak_memory_bytes, filter.children[0].output_bytes + filter.output_bytes);
+        assert!(filter.wall_time >= filter.children[0].wall_time);
+    }
+
+    #[tokio::test]
+    async fn test_scan_pipelines_push_down_by_table_column_ids() {
+        use crate::parser::{ParsedExpression, ParsedOperator, ParsedValue};
+        use crate::storage::table_catalog::{TableCatalog, TableColumn};
+        use storage::codec::Datum;
+
+        let catalog = Arc::new(TableCatalog::new());
+        catalog.register("emp", vec![
+            TableColumn::new("id", 1, DataType::BigInt),
+            TableColumn::new("dept", 2, DataType::String),
+            TableColumn::new("salary", 3, DataType::Double),
+        ]);
+        let mut storage = StorageExecutor::new();
+        storage.set_table_catalog(catalog);
+        let storage = Arc::new(storage);
+        for (id, dept, salary) in [(1, "it", 100.0), (2, "it", 300.0), (3, "hr", 200.0)] {
+            let columns = [(1, Datum::Int(id)), (2, Datum::Bytes(dept.as_bytes().to_vec())), (3, Datum::Float(salary))];
+            storage.storage_handler().insert_record("emp", &[Datum::Int(id)], &columns, None).await.unwrap();
+        }
+        let executor = ParallelQueryExecutor::new();
+        executor.set_storage_executor(storage.clone());
+
+        // SELECT salary, id FROM emp WHERE salary > 150：列顺序与表定义不同
+        let node = PlanNode::Filter {
+            input: Box::new(PlanNode::TableScan {
+                table: "emp".to_string(),
+                columns: vec!["salary".to_string(), "id".to_string()],
+            }),
+            predicate: ParsedExpression::BinaryOp {
+                left: Box::new(ParsedExpression::Column("salary".to_string())),
+                operator: ParsedOperator::GreaterThan,
+                right: Box::new(ParsedExpression::Literal(ParsedValue::Number("150".to_string()))),
+            },
+        };
+        let context = ExecutionContext::default();
+        let pushed = storage.execute_pushdown(&node, &context).await.unwrap().expect("plan should push down");
+        let plan = OptimizedPlan { nodes: vec![node], estimated_cost: 1.0, estimated_rows: 2 };
+        let result = executor.execute_parallel(plan, &context).await.unwrap();
+        assert_eq!(result.columns, vec!["salary".to_string(), "id".to_string()]);
+        assert_eq!(result.rows, vec![vec!["300".to_string(), "2".to_string()], vec!["200".to_string(), "3".to_string()]]);
+        assert_eq!(result.rows, pushed.rows);
+    }
+
+    #[tokio::test]
+    async fn test_bitmap_index_scans_read_matching_rows() {
+        use crate::parser::{ParsedExpression, ParsedOperator, ParsedValue};
+        use crate::planner::rbo::{IndexSelectionRule, OptimizationRule};
+        use crate::storage::table_catalog::{TableCatalog, TableColumn};
+        use storage::codec::{self, Datum};
+        use storage::{StorageContext, StorageOptions, Value};
+
+        let catalog = Arc::new(TableCatalog::new());
+        catalog.register("bitmap_orders", vec![
+            TableColumn::new("id", 1, DataType::BigInt),
+            TableColumn::new("status", 2, DataType::String),
+            TableColumn::new("amount", 3, DataType::BigInt),
+        ]);
+        let mut storage = StorageExecutor::new();
+        storage.set_table_catalog(catalog);
+        let storage = Arc::new(storage);
+        let handler = storage.storage_handler();
+        let row = |id: i64, status: &str, amount: i64| {
+            vec![(1, Datum::Int(id)), (2, Datum::Bytes(status.as_bytes().to_vec())), (3, Datum::Int(amount))]
+        };
+        for (id, status, amount) in [(1, "active", 10), (2, "closed", 20), (3, "active", 30), (4, "pending", 40)] {
+            handler.insert_record("bitmap_orders", &[Datum::Int(id)], &row(id, status, amount), None).await.unwrap();
+        }
+        handler.create_bitmap_index("bitmap_orders", "by_status", "status", 2, None).await.unwrap();
+
+        // 绕过索引维护直接写入的行：全表扫描能读到，位图扫描读不到
+        let engine = handler.get_engine(None).await.unwrap();
+        let key = codec::record_key("bitmap_orders", &[Datum::Int(5)]);
+        let value = Value::from(codec::encode_row_with_ids(&row(5, "active", 50)));
+        engine.put(&key, &value, &StorageContext::default(), &StorageOptions::default()).await.unwrap();
+
+        let executor = ParallelQueryExecutor::new();
+        executor.set_storage_executor(storage.clone());
+        let filter = PlanNode::Filter {
+            input: Box::new(PlanNode::TableScan {
+                table: "bitmap_orders".to_string(),
+                columns: vec!["amount".to_string(), "id".to_string()],
+            }),
+            predicate: ParsedExpression::BinaryOp {
+                left: Box::new(ParsedExpression::Column("status".to_string())),
+                operator: ParsedOperator::Equal,
+                right: Box::new(ParsedExpression::Literal(ParsedValue::String("active".to_string()))),
+            },
+        };
+        let plan = OptimizedPlan { nodes: vec![filter], estimated_cost: 1.0, estimated_rows: 2 };
+        let plan = IndexSelectionRule::new(handler.bitmap_catalog().clone()).apply(plan).await.unwrap();
+        let PlanNode::Filter { input, .. } = &plan.nodes[0] else { panic!("expected filter") };
+        assert!(matches!(input.as_ref(), PlanNode::IndexScan { .. }));
+
+        // 过滤条件所在的列不在投影中，由位图求值，行按投影的列 ID 解码
+        let context = ExecutionContext::default();
+        let result = executor.execute_parallel(plan.clone(), &context).await.unwrap();
+        assert_eq!(result.columns, vec!["amount".to_string(), "id".to_string()]);
+        assert_eq!(result.rows, vec![vec!["10".to_string(), "1".to_string()], vec!["30".to_string(), "3".to_string()]]);
+
+        let (profiled, profiles) = executor.execute_profiled(plan, &context).await.unwrap();
+        assert_eq!(profiled.rows, result.rows);
+        assert_eq!((profiles[0].name.as_str(), profiles[0].rows_out), ("IndexScan", 2));
+    }
+
+    #[tokio::test(flavor = "multi_thread", worker_threads = 2)]
+    async fn test_zone_maps_prune_scans_on_every_path() {
+        use crate::parser::{ParsedExpression, ParsedOperator, ParsedValue};
+        use crate::storage::table_catalog::{TableCatalog, TableColumn};
+        use storage::codec::{self, Datum};
+        use storage::index::ZoneMapConfig;
+        use storage::{StorageContext, StorageOptions, Value};
+
+        let catalog = Arc::new(TableCatalog::new());
+        catalog.register("events", vec![
+            TableColumn::new("id", 1, DataType::BigInt),
+            TableColumn::new("ts", 2, DataType::BigInt),
+        ]);
+        let mut storage = StorageExecutor::new();
+        storage.set_table_catalog(catalog);
+        let storage = Arc::new(storage);
+        let handler = storage.storage_handler();
+        let row = |id: i64, ts: i64| vec![(1, Datum::Int(id)), (2, Datum::Int(ts))];
+        // 追加写入，ts 随主键递增
+        for id in 0..40 {
+            handler.insert_record("events", &[Datum::Int(id)], &row(id, id), None).await.unwrap();
+        }
+        let executor = ParallelQueryExecutor::new();
+        executor.set_storage_executor(storage.clone());
+
+        let filter = |column: &str| PlanNode::Filter {
+            input: Box::new(PlanNode::TableScan { table: "events".to_string(), columns: vec!["id".to_string(), "ts".to_string()] }),
+            predicate: ParsedExpression::BinaryOp {
+                left: Box::new(ParsedExpression::Column(column.to_string())),
+                operator: ParsedOperator::GreaterThanOrEqual,
+                right: Box::new(ParsedExpression::Literal(ParsedValue::Number("35".to_string()))),
+            },
+        };
+        // 限定列名无法按结果列下推，走 SeqScanOperator；不限定的整段下推
+        let (pushed, scanned) = (filter("ts"), filter("events.ts"));
+        let context = ExecutionContext::default();
+        let run = |nodes: Vec<PlanNode>| {
+            let plan = OptimizedPlan { nodes, estimated_cost: 1.0, estimated_rows: 5 };
+            executor.execute_parallel(plan, &context)
+        };
+        let expected = run(vec![pushed.clone()]).await.unwrap();
+        assert_eq!(expected.rows.len(), 5);
+        assert_eq!(run(vec![scanned.clone()]).await.unwrap().rows, expected.rows);
+
+        let config = ZoneMapConfig { rows_per_zone: 10, columns: vec![2], ..ZoneMapConfig::default() };
+        assert_eq!(handler.enable_zone_map("events", config, None).await.unwrap(), 4);
+        // 绕过摘要维护写入首个区间的一行：只有不跳过区间的扫描才读得到
+        let key = codec::record_key("events", &[Datum::Int(5)]);
+        let value = Value::from(codec::encode_row_with_ids(&row(5, 100)));
+        let engine = handler.get_engine(None).await.unwrap();
+        engine.put(&key, &value, &StorageContext::default(), &StorageOptions::default()).await.unwrap();
+
+        let sorted = |mut rows: Vec<Vec<String>>| {
+            rows.sort_by_key(|row| row[0].parse::<i64>().unwrap());
+            rows
+        };
+        let pushed_result = run(vec![pushed.clone()]).await.unwrap();
+        assert_eq!(pushed_result.columns, expected.columns);
+        assert_eq!(pushed_result.rows, expected.rows);
+        assert_eq!(run(vec![scanned.clone()]).await.unwrap().rows, expected.rows);
+
+        // morsel 只覆盖可能匹配的区间
+        let parallel = run(vec![scanned.clone(), pushed]).await.unwrap();
+        let twice: Vec<_> = expected.rows.iter().flat_map(|row| [row.clone(), row.clone()]).collect();
+        assert_eq!(sorted(parallel.rows), twice);
+
+        let plan = OptimizedPlan { nodes: vec![scanned], estimated_cost: 1.0, estimated_rows: 5 };
+        let (profiled, profiles) = executor.execute_profiled(plan, &context).await.unwrap();
+        assert_eq!(profiled.rows, expected.rows);
+        assert_eq!(profiles[0].children[0].rows_out, 10);
+    }
+
+    #[tokio::test]
+    async fn test_limit_stops_the_storage_scan() {
+        use crate::parser::{ParsedExpression, ParsedOperator, ParsedValue};
+        use storage::engine::scan::DEFAULT_SCAN_PAGE_SIZE;
+
+        let storage = Arc::new(StorageExecutor::new());
+        let context = ExecutionContext::default();
+        let pages = 8;
+        for i in 0..pages * DEFAULT_SCAN_PAGE_SIZE as u64 {
+            storage.execute_insert("events", &format!("{:06}", i), &i.to_string(), &context).await.unwrap();
+        }
+        let executor = ParallelQueryExecutor::new();
+        executor.set_storage_executor(storage.clone());
+        let engine = storage.storage_handler().get_engine(None).await.unwrap();
+        // 内存引擎每读一页记一次操作
+        async fn pages_read(engine: &Arc<dyn storage::StorageEngine>, run: impl std::future::Future<Output = QueryResult>) -> (QueryResult, u64) {
+            let before = engine.get_stats().await.unwrap().total_operations;
+            let result = run.await;
+            (result, engine.get_stats().await.unwrap().total_operations - before)
+        }
+        let run = |node: PlanNode| {
+            let plan = OptimizedPlan { nodes: vec![node], estimated_cost: 1.0, estimated_rows: 1 };
+            let (executor, context) = (&executor, &context);
+            async move { executor.execute_parallel(plan, context).await.unwrap() }
+        };
+        let values = |result: &QueryResult| result.rows.iter().map(|row| row[0].parse().unwrap()).collect::<Vec<u64>>();
+
+        let scan = PlanNode::TableScan { table: "events".to_string(), columns: vec!["value".to_string()] };
+        let (full, full_pages) = pages_read(&engine, run(scan.clone())).await;
+        assert_eq!(full.rows.len() as u64, pages * DEFAULT_SCAN_PAGE_SIZE as u64);
+        assert!(full_pages >= pages);
+
+        // LIMIT 直接在扫描上：limit + offset 交给存储层，只读一页
+        let limit = PlanNode::Limit { input: Box::new(scan.clone()), limit: 5, offset: 2 };
+        let (limited, limited_pages) = pages_read(&engine, run(limit)).await;
+        assert_eq!(values(&limited), vec![2, 3, 4, 5, 6]);
+        assert_eq!(limited_pages, 1);
+
+        // 过滤之上的 LIMIT 凑满后丢弃扫描流，至多多读预读的几页
+        let filter = PlanNode::Filter {
+            input: Box::new(scan),
+            predicate: ParsedExpression::BinaryOp {
+                left: Box::new(ParsedExpression::Column("value".to_string())),
+                operator: ParsedOperator::GreaterThanOrEqual,
+                right: Box::new(ParsedExpression::Literal(ParsedValue::Number("1500".to_string()))),
+            },
+        };
+        let limit = PlanNode::Limit { input: Box::new(filter), limit: 3, offset: 0 };
+        let (limited, limited_pages) = pages_read(&engine, run(limit.clone())).await;
+        assert_eq!(values(&limited), vec![1500, 1501, 1502]);
+        assert!(limited_pages < pages, "read {} of {} pages", limited_pages, pages);
+
+        // EXPLAIN ANALYZE 走同一条路径
+        let plan = OptimizedPlan { nodes: vec![limit], estimated_cost: 1.0, estimated_rows: 3 };
+        let (profiled, profiles) = executor.execute_profiled(plan, &context).await.unwrap();
+        assert_eq!(profiled.rows, limited.rows);
+        assert_eq!((profiles[0].name.as_str(), profiles[0].rows_out), ("Limit", 3));
+    }
+
+    #[test]
+    fn test_adjust_parallelism_dynamically_follows_utilization() {
+        let executor = ParallelQueryExecutor::with_config(ParallelExecutorConfig {
+            max_parallelism: 8,
+            default_parallelism: 4,
+            ..ParallelExecutorConfig::default()
+        });
+
+        // 只有一个 morsel 时其余线程不会被启动，利用率很高，应当放大并行度
+        executor.scheduler.run(vec![()], |_, _| Ok(())).unwrap();
+        executor.adjust_parallelism_dynamically().unwrap();
+        assert_eq!(executor.scheduler.num_workers(), 8);
+        assert_eq!(executor.get_stats().current_parallelism, 8);
+    }
+
     #[test]
     fn test_group_nodes_for_parallel_execution() {
         let executor = ParallelQueryExecutor::new();
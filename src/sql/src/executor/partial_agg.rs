@@ -0,0 +1,421 @@
+//! 可分解聚合的部分/最终拆分
+//!
+//! 分片并行查询中，COUNT/SUM/MIN/MAX/AVG 以及近似去重 (HyperLogLog) 都可以先在
+//! 每个分片上按分组计算部分状态，再由协调节点合并，网络上传输的是每个分组的一份
+//! 状态而不是原始行。`AggregateSplit::plan` 判断一组聚合能否拆分，不能拆分
+//! (如精确 `count(distinct ...)`) 时返回 None，由调用方退回到汇聚原始行。
+//!
+//! 部分结果的传输格式：
+//!
+//! ```text
+//! u32 分组数 | 每个分组: u32 键个数 + (u32 长度 + UTF-8) * 键个数 + 每个聚合的状态
+//! 状态: u8 标记 + 负载 (COUNT: i64; SUM/AVG: f64 + i64; MIN/MAX: u8 是否有值 + f64;
+//!       近似去重: u32 寄存器数 + 寄存器)
+//! ```
+
+use common::{Error, Result};
+use std::collections::HashMap;
+
+use crate::optimizer::HyperLogLog;
+
+const STATE_COUNT: u8 = 1;
+const STATE_SUM: u8 = 2;
+const STATE_MIN: u8 = 3;
+const STATE_MAX: u8 = 4;
+const STATE_DISTINCT: u8 = 5;
+
+/// 可分解的聚合函数
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum PartialAggregateFunction {
+    Count,
+    Sum,
+    Avg,
+    Min,
+    Max,
+    /// `approx_count_distinct(col)` / `ndv(col)`
+    ApproxCountDistinct,
+}
+
+/// 一个可分解的聚合调用
+#[derive(Debug, Clone, PartialEq)]
+pub struct AggregateCall {
+    pub function: PartialAggregateFunction,
+    /// 参数列，省略时数值聚合沿用 `value` 列
+    pub argument: Option<String>,
+}
+
+impl AggregateCall {
+    /// 解析聚合表达式，不可分解或无法识别时返回 None
+    pub fn parse(expr: &str) -> Option<Self> {
+        let expr = expr.trim().to_lowercase();
+        let (name, argument) = match expr.find('(') {
+            Some(open) if expr.ends_with(')') => (expr[..open].trim().to_string(), Some(expr[open + 1..expr.len() - 1].trim().to_string())),
+            _ => (expr.clone(), None),
+        };
+        // count(distinct x) 只能精确合并原始值，不做拆分
+        if argument.as_deref().map_or(false, |a| a.starts_with("distinct ")) {
+            return None;
+        }
+        let argument = argument.filter(|a| !a.is_empty() && a != "*");
+        let function = match name.as_str() {
+            "count" => PartialAggregateFunction::Count,
+            "sum" => PartialAggregateFunction::Sum,
+            "avg" => PartialAggregateFunction::Avg,
+            "min" => PartialAggregateFunction::Min,
+            "max" => PartialAggregateFunction::Max,
+            "approx_count_distinct" | "ndv" if argument.is_some() => PartialAggregateFunction::ApproxCountDistinct,
+            _ => return None,
+        };
+        let argument = match function {
+            PartialAggregateFunction::Count | PartialAggregateFunction::ApproxCountDistinct => argument,
+            _ => argument.or_else(|| Some("value".to_string())),
+        };
+        Some(Self { function, argument })
+    }
+
+    fn new_state(&self) -> PartialState {
+        match self.function {
+            PartialAggregateFunction::Count => PartialState::Count(0),
+            PartialAggregateFunction::Sum | PartialAggregateFunction::Avg => PartialState::Sum { sum: 0.0, count: 0 },
+            PartialAggregateFunction::Min => PartialState::Min(None),
+            PartialAggregateFunction::Max => PartialState::Max(None),
+            PartialAggregateFunction::ApproxCountDistinct => PartialState::Distinct(HyperLogLog::new()),
+        }
+    }
+}
+
+/// 单个分组上一个聚合的部分状态
+#[derive(Debug, Clone)]
+pub enum PartialState {
+    Count(i64),
+    /// SUM 与 AVG 共用：数值和与参与的数值个数
+    Sum { sum: f64, count: i64 },
+    Min(Option<f64>),
+    Max(Option<f64>),
+    Distinct(HyperLogLog),
+}
+
+impl PartialState {
+    /// `value` 为参数的值，参数为 NULL 或不存在时为 None
+    fn update(&mut self, value: Option<&str>) {
+        match self {
+            PartialState::Count(n) => *n += value.is_some() as i64,
+            PartialState::Distinct(hll) => {
+                if let Some(v) = value {
+                    hll.add(v);
+                }
+            }
+            _ => {
+                let Some(v) = value.and_then(|v| v.parse::<f64>().ok()) else { return };
+                match self {
+                    PartialState::Sum { sum, count } => {
+                        *sum += v;
+                        *count += 1;
+                    }
+                    PartialState::Min(m) => *m = Some(m.map_or(v, |m| m.min(v))),
+                    PartialState::Max(m) => *m = Some(m.map_or(v, |m| m.max(v))),
+                    _ => unreachable!(),
+                }
+            }
+        }
+    }
+
+    fn merge(&mut self, other: &PartialState) -> Result<()> {
+        match (self, other) {
+            (PartialState::Count(a), PartialState::Count(b)) => *a += b,
+            (PartialState::Sum { sum, count }, PartialState::Sum { sum: s, count: c }) => {
+                *sum += s;
+                *count += c;
+            }
+            (PartialState::Min(a), PartialState::Min(b)) => *a = merge_option(*a, *b, f64::min),
+            (PartialState::Max(a), PartialState::Max(b)) => *a = merge_option(*a, *b, f64::max),
+            (PartialState::Distinct(a), PartialState::Distinct(b)) => a.merge(b),
+            (a, b) => {
+                return Err(Error::Execution(format!("cannot merge partial states {:?} and {:?}", a, b)));
+            }
+        }
+        Ok(())
+    }
+
+    /// 最终值，与 `DistributedAggOperator` 原有输出一致：没有数值输入时为 0
+    fn finish(&self, function: PartialAggregateFunction) -> String {
+        match self {
+            PartialState::Count(n) => n.to_string(),
+            PartialState::Sum { sum, count } => match function {
+                PartialAggregateFunction::Avg if *count > 0 => (sum / *count as f64).to_string(),
+                PartialAggregateFunction::Avg => "0".to_string(),
+                _ => sum.to_string(),
+            },
+            PartialState::Min(m) | PartialState::Max(m) => m.map_or_else(|| "0".to_string(), |v| v.to_string()),
+            PartialState::Distinct(hll) => hll.estimate().to_string(),
+        }
+    }
+
+    fn encode(&self, out: &mut Vec<u8>) {
+        match self {
+            PartialState::Count(n) => {
+                out.push(STATE_COUNT);
+                out.extend_from_slice(&n.to_le_bytes());
+            }
+            PartialState::Sum { sum, count } => {
+                out.push(STATE_SUM);
+                out.extend_from_slice(&sum.to_le_bytes());
+                out.extend_from_slice(&count.to_le_bytes());
+            }
+            PartialState::Min(m) | PartialState::Max(m) => {
+                out.push(if matches!(self, PartialState::Min(_)) { STATE_MIN } else { STATE_MAX });
+                out.push(m.is_some() as u8);
+                out.extend_from_slice(&m.unwrap_or(0.0).to_le_bytes());
+            }
+            PartialState::Distinct(hll) => {
+                out.push(STATE_DISTINCT);
+                out.extend_from_slice(&(hll.registers().len() as u32).to_le_bytes());
+                out.extend_from_slice(hll.registers());
+            }
+        }
+    }
+
+    fn decode(input: &mut &[u8]) -> Result<Self> {
+        Ok(match take_u8(input)? {
+            STATE_COUNT => PartialState::Count(i64::from_le_bytes(take_array(input)?)),
+            STATE_SUM => PartialState::Sum {
+                sum: f64::from_le_bytes(take_array(input)?),
+                count: i64::from_le_bytes(take_array(input)?),
+            },
+            tag @ (STATE_MIN | STATE_MAX) => {
+                let present = take_u8(input)? != 0;
+                let value = f64::from_le_bytes(take_array(input)?);
+                let value = present.then_some(value);
+                if tag == STATE_MIN { PartialState::Min(value) } else { PartialState::Max(value) }
+            }
+            STATE_DISTINCT => {
+                let len = u32::from_le_bytes(take_array(input)?) as usize;
+                PartialState::Distinct(HyperLogLog::from_registers(take_bytes(input, len)?.to_vec())?)
+            }
+            tag => return Err(Error::Deserialization(format!("unknown partial aggregate state {}", tag))),
+        })
+    }
+}
+
+fn merge_option(a: Option<f64>, b: Option<f64>, f: fn(f64, f64) -> f64) -> Option<f64> {
+    match (a, b) {
+        (Some(a), Some(b)) => Some(f(a, b)),
+        (a, None) => a,
+        (None, b) => b,
+    }
+}
+
+/// 一个分片的部分聚合结果
+#[derive(Debug, Clone, Default)]
+pub struct PartialAggregates {
+    pub groups: Vec<(Vec<String>, Vec<PartialState>)>,
+}
+
+impl PartialAggregates {
+    pub fn encode(&self) -> Vec<u8> {
+        let mut out = Vec::new();
+        out.extend_from_slice(&(self.groups.len() as u32).to_le_bytes());
+        for (key, states) in &self.groups {
+            out.extend_from_slice(&(key.len() as u32).to_le_bytes());
+            for part in key {
+                out.extend_from_slice(&(part.len() as u32).to_le_bytes());
+                out.extend_from_slice(part.as_bytes());
+            }
+            for state in states {
+                state.encode(&mut out);
+            }
+        }
+        out
+    }
+
+    /// 解码，`num_aggregates` 为每个分组的状态个数
+    pub fn decode(mut input: &[u8], num_aggregates: usize) -> Result<Self> {
+        let input = &mut input;
+        let num_groups = u32::from_le_bytes(take_array(input)?) as usize;
+        let mut groups = Vec::with_capacity(num_groups.min(1 << 20));
+        for _ in 0..num_groups {
+            let key_len = u32::from_le_bytes(take_array(input)?) as usize;
+            let mut key = Vec::with_capacity(key_len.min(64));
+            for _ in 0..key_len {
+                let len = u32::from_le_bytes(take_array(input)?) as usize;
+                let bytes = take_bytes(input, len)?;
+                key.push(String::from_utf8(bytes.to_vec()).map_err(|e| Error::Deserialization(e.to_string()))?);
+            }
+            let states = (0..num_aggregates).map(|_| PartialState::decode(input)).collect::<Result<Vec<_>>>()?;
+            groups.push((key, states));
+        }
+        if !input.is_empty() {
+            return Err(Error::Deserialization(format!("{} trailing bytes after partial aggregates", input.len())));
+        }
+        Ok(Self { groups })
+    }
+}
+
+/// 结果行中的 NULL：客户端格式输出为空串，也接受字面的 `NULL`
+fn is_null(value: &str) -> bool {
+    value.is_empty() || value.eq_ignore_ascii_case("null")
+}
+
+fn take_bytes<'a>(input: &mut &'a [u8], len: usize) -> Result<&'a [u8]> {
+    if input.len() < len {
+        return Err(Error::Deserialization("truncated partial aggregate frame".to_string()));
+    }
+    let (head, tail) = input.split_at(len);
+    *input = tail;
+    Ok(head)
+}
+
+fn take_array<const N: usize>(input: &mut &[u8]) -> Result<[u8; N]> {
+    let mut array = [0u8; N];
+    array.copy_from_slice(take_bytes(input, N)?);
+    Ok(array)
+}
+
+fn take_u8(input: &mut &[u8]) -> Result<u8> {
+    Ok(take_bytes(input, 1)?[0])
+}
+
+/// 拆分后的聚合：分片上计算部分状态，协调节点合并
+#[derive(Debug, Clone)]
+pub struct AggregateSplit {
+    pub group_by: Vec<String>,
+    pub calls: Vec<AggregateCall>,
+}
+
+impl AggregateSplit {
+    /// 所有聚合都可分解时返回拆分方案
+    pub fn plan(group_by: &[String], aggregates: &[String]) -> Option<Self> {
+        let calls = aggregates.iter().map(|a| AggregateCall::parse(a)).collect::<Option<Vec<_>>>()?;
+        Some(Self { group_by: group_by.to_vec(), calls })
+    }
+
+    /// 在一个分片的行上计算部分聚合
+    pub fn partial(&self, columns: &[String], rows: &[Vec<String>]) -> PartialAggregates {
+        let position = |name: &str| columns.iter().position(|c| c == name);
+        let key_columns: Vec<Option<usize>> = self.group_by.iter().map(|g| position(g)).collect();
+        let arguments: Vec<Option<usize>> =
+            self.calls.iter().map(|c| c.argument.as_deref().and_then(position)).collect();
+
+        let mut index: HashMap<Vec<String>, usize> = HashMap::new();
+        let mut groups: Vec<(Vec<String>, Vec<PartialState>)> = Vec::new();
+        for row in rows {
+            let key: Vec<String> = key_columns
+                .iter()
+                .filter_map(|c| c.and_then(|c| row.get(c)).cloned())
+                .collect();
+            let group = *index.entry(key.clone()).or_insert_with(|| {
+                groups.push((key, self.calls.iter().map(|c| c.new_state()).collect()));
+                groups.len() - 1
+            });
+            for ((state, call), argument) in groups[group].1.iter_mut().zip(&self.calls).zip(&arguments) {
+                match (state, &call.argument) {
+                    // count(*) 统计行数，count(col) 只统计非 NULL 值
+                    (PartialState::Count(n), None) => *n += 1,
+                    (state, _) => state.update(argument.and_then(|c| row.get(c)).map(String::as_str).filter(|v| !is_null(v))),
+                }
+            }
+        }
+        PartialAggregates { groups }
+    }
+
+    /// 合并所有分片的部分结果，输出 分组键 + 每个聚合一列
+    pub fn merge(&self, partials: &[PartialAggregates]) -> Result<Vec<Vec<String>>> {
+        let mut index: HashMap<&[String], usize> = HashMap::new();
+        let mut merged: Vec<(&[String], Vec<PartialState>)> = Vec::new();
+        for partial in partials {
+            for (key, states) in &partial.groups {
+                if states.len() != self.calls.len() {
+                    return Err(Error::Execution(format!(
+                        "partial aggregate has {} states, expected {}",
+                        states.len(),
+                        self.calls.len()
+                    )));
+                }
+                match index.get(key.as_slice()) {
+                    Some(&g) => {
+                        for (mine, theirs) in merged[g].1.iter_mut().zip(states) {
+                            mine.merge(theirs)?;
+                        }
+                    }
+                    None => {
+                        index.insert(key.as_slice(), merged.len());
+                        merged.push((key.as_slice(), states.clone()));
+                    }
+                }
+            }
+        }
+        Ok(merged
+            .into_iter()
+            .map(|(key, states)| {
+                let mut row = key.to_vec();
+                row.extend(states.iter().zip(&self.calls).map(|(s, c)| s.finish(c.function)));
+                row
+            })
+            .collect())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn rows(data: &[(&str, &str)]) -> Vec<Vec<String>> {
+        data.iter().map(|(k, v)| vec![k.to_string(), v.to_string()]).collect()
+    }
+
+    #[test]
+    fn test_split_merge_matches_single_node() {
+        let columns = vec!["name".to_string(), "value".to_string()];
+        let aggregates: Vec<String> = ["count", "sum", "avg(value)", "min(value)", "max", "ndv(value)"]
+            .iter()
+            .map(|s| s.to_string())
+            .collect();
+        let split = AggregateSplit::plan(&["name".to_string()], &aggregates).unwrap();
+
+        let shard1 = rows(&[("a", "1"), ("b", "10"), ("a", "3")]);
+        let shard2 = rows(&[("a", "5"), ("b", "x"), ("c", "7")]);
+        let partials: Vec<PartialAggregates> = [&shard1, &shard2]
+            .iter()
+            .map(|r| PartialAggregates::decode(&split.partial(&columns, r).encode(), aggregates.len()).unwrap())
+            .collect();
+
+        let mut merged = split.merge(&partials).unwrap();
+        merged.sort();
+        let single = {
+            let all: Vec<Vec<String>> = shard1.iter().chain(&shard2).cloned().collect();
+            let mut rows = split.merge(&[split.partial(&columns, &all)]).unwrap();
+            rows.sort();
+            rows
+        };
+        assert_eq!(merged, single);
+        assert_eq!(merged[0], vec!["a", "3", "9", "3", "1", "5", "3"]);
+        // b 的 "x" 不是数值：计入 count，不计入 sum/avg
+        assert_eq!(merged[1], vec!["b", "2", "10", "10", "10", "10", "2"]);
+    }
+
+    #[test]
+    fn test_count_column_skips_nulls() {
+        let columns = vec!["name".to_string(), "value".to_string()];
+        let aggregates: Vec<String> = ["count(*)", "count(value)", "sum(value)"].iter().map(|s| s.to_string()).collect();
+        let split = AggregateSplit::plan(&["name".to_string()], &aggregates).unwrap();
+        let shard = rows(&[("a", "1"), ("a", ""), ("a", "NULL"), ("a", "x")]);
+        let merged = split.merge(&[split.partial(&columns, &shard)]).unwrap();
+        assert_eq!(merged, vec![vec!["a", "4", "2", "1"]]);
+    }
+
+    #[test]
+    fn test_non_decomposable_aggregates_are_not_split() {
+        let group_by = vec!["name".to_string()];
+        assert!(AggregateSplit::plan(&group_by, &["count(distinct id)".to_string()]).is_none());
+        assert!(AggregateSplit::plan(&group_by, &["median(value)".to_string()]).is_none());
+        assert!(AggregateSplit::plan(&group_by, &["count(*)".to_string(), "sum(id)".to_string()]).is_some());
+    }
+
+    #[test]
+    fn test_decode_rejects_truncated_input() {
+        let split = AggregateSplit::plan(&[], &["sum".to_string()]).unwrap();
+        let encoded = split.partial(&["value".to_string()], &[vec!["1".to_string()]]).encode();
+        assert!(PartialAggregates::decode(&encoded[..encoded.len() - 1], 1).is_err());
+        assert!(PartialAggregates::decode(&encoded, 1).is_ok());
+    }
+}
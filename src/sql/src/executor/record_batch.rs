@@ -0,0 +1,1066 @@
+//! 列式批数据 (RecordBatch)
+//!
+//! 算子之间以列式批交换数据：每列是基于 `common::types::DataType` 的强类型向量，
+//! 附带有效位图 (validity bitmap) 标记 NULL，批上可挂选择向量 (selection vector)
+//! 以避免过滤时的数据搬移。只有在客户端边界才转换回 `QueryResult` 的字符串行格式。
+
+use common::{DataType, Result, Value};
+use std::cmp::Ordering;
+use std::collections::HashMap;
+use std::hash::{Hash, Hasher};
+
+use crate::executor::execution_models::QueryResult;
+
+/// 有效位图，置位表示该行非 NULL
+#[derive(Debug, Clone, PartialEq)]
+pub struct Bitmap {
+    bits: Vec<u64>,
+    len: usize,
+}
+
+impl Bitmap {
+    /// 创建空位图
+    pub fn new() -> Self {
+        Self { bits: Vec::new(), len: 0 }
+    }
+
+    /// 创建长度为 len、所有位都置位的位图
+    pub fn new_set(len: usize) -> Self {
+        let mut bits = vec![u64::MAX; (len + 63) / 64];
+        if len % 64 != 0 {
+            if let Some(last) = bits.last_mut() {
+                *last = (1u64 << (len % 64)) - 1;
+            }
+        }
+        Self { bits, len }
+    }
+
+    /// 创建长度为 len、所有位都清零的位图
+    pub fn new_unset(len: usize) -> Self {
+        Self { bits: vec![0; (len + 63) / 64], len }
+    }
+
+    pub fn with_capacity(capacity: usize) -> Self {
+        Self { bits: Vec::with_capacity((capacity + 63) / 64), len: 0 }
+    }
+
+    /// 由布尔切片按 64 位字打包
+    pub fn from_bools(values: &[bool]) -> Self {
+        let bits = values
+            .chunks(64)
+            .map(|chunk| chunk.iter().enumerate().fold(0u64, |word, (i, &b)| word | ((b as u64) << i)))
+            .collect();
+        Self { bits, len: values.len() }
+    }
+
+    /// 由底层 64 位字重建位图 (用于从磁盘格式恢复)
+    pub fn from_words(bits: Vec<u64>, len: usize) -> Self {
+        debug_assert_eq!(bits.len(), (len + 63) / 64);
+        Self { bits, len }
+    }
+
+    /// 展开为布尔向量，供按元素计算的内核使用
+    pub fn to_bools(&self) -> Vec<bool> {
+        (0..self.len).map(|i| self.get(i)).collect()
+    }
+
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len == 0
+    }
+
+    #[inline]
+    pub fn get(&self, index: usize) -> bool {
+        debug_assert!(index < self.len);
+        self.bits[index / 64] & (1u64 << (index % 64)) != 0
+    }
+
+    #[inline]
+    pub fn set(&mut self, index: usize, value: bool) {
+        debug_assert!(index < self.len);
+        let mask = 1u64 << (index % 64);
+        if value {
+            self.bits[index / 64] |= mask;
+        } else {
+            self.bits[index / 64] &= !mask;
+        }
+    }
+
+    pub fn push(&mut self, value: bool) {
+        if self.len % 64 == 0 {
+            self.bits.push(0);
+        }
+        self.len += 1;
+        self.set(self.len - 1, value);
+    }
+
+    /// 置位的数量
+    pub fn count_set(&self) -> usize {
+        self.bits.iter().map(|word| word.count_ones() as usize).sum()
+    }
+
+    /// 所有位是否都置位 (即整列没有 NULL)
+    pub fn all_set(&self) -> bool {
+        self.count_set() == self.len
+    }
+
+    /// 按位与，两者长度必须相同
+    pub fn and(&self, other: &Bitmap) -> Bitmap {
+        debug_assert_eq!(self.len, other.len);
+        let bits = self.bits.iter().zip(other.bits.iter()).map(|(a, b)| a & b).collect();
+        Bitmap { bits, len: self.len }
+    }
+
+    /// 按位或，两者长度必须相同
+    pub fn or(&self, other: &Bitmap) -> Bitmap {
+        debug_assert_eq!(self.len, other.len);
+        let bits = self.bits.iter().zip(other.bits.iter()).map(|(a, b)| a | b).collect();
+        Bitmap { bits, len: self.len }
+    }
+
+    /// 底层 64 位字，供批量内核按字处理
+    pub fn words(&self) -> &[u64] {
+        &self.bits
+    }
+
+    /// 迭代所有置位的下标
+    pub fn iter_set(&self) -> impl Iterator<Item = usize> + '_ {
+        (0..self.len).filter(move |&i| self.get(i))
+    }
+}
+
+impl Default for Bitmap {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// 强类型列数据
+#[derive(Debug, Clone, PartialEq)]
+pub enum ColumnData {
+    Boolean(Vec<bool>),
+    Int32(Vec<i32>),
+    Int64(Vec<i64>),
+    Float32(Vec<f32>),
+    Float64(Vec<f64>),
+    Utf8(Vec<String>),
+    Binary(Vec<Vec<u8>>),
+}
+
+impl ColumnData {
+    /// 根据逻辑类型创建空的物理列
+    pub fn with_capacity(data_type: &DataType, capacity: usize) -> Self {
+        match data_type {
+            DataType::Boolean => ColumnData::Boolean(Vec::with_capacity(capacity)),
+            DataType::Integer => ColumnData::Int32(Vec::with_capacity(capacity)),
+            DataType::BigInt | DataType::Timestamp | DataType::Date => {
+                ColumnData::Int64(Vec::with_capacity(capacity))
+            }
+            DataType::Float => ColumnData::Float32(Vec::with_capacity(capacity)),
+            DataType::Double => ColumnData::Float64(Vec::with_capacity(capacity)),
+            DataType::Binary => ColumnData::Binary(Vec::with_capacity(capacity)),
+            DataType::Null | DataType::String | DataType::Decimal { .. } => {
+                ColumnData::Utf8(Vec::with_capacity(capacity))
+            }
+        }
+    }
+
+    pub fn len(&self) -> usize {
+        match self {
+            ColumnData::Boolean(v) => v.len(),
+            ColumnData::Int32(v) => v.len(),
+            ColumnData::Int64(v) => v.len(),
+            ColumnData::Float32(v) => v.len(),
+            ColumnData::Float64(v) => v.len(),
+            ColumnData::Utf8(v) => v.len(),
+            ColumnData::Binary(v) => v.len(),
+        }
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// 追加一个占位值 (配合有效位图表示 NULL)
+    fn push_default(&mut self) {
+        match self {
+            ColumnData::Boolean(v) => v.push(false),
+            ColumnData::Int32(v) => v.push(0),
+            ColumnData::Int64(v) => v.push(0),
+            ColumnData::Float32(v) => v.push(0.0),
+            ColumnData::Float64(v) => v.push(0.0),
+            ColumnData::Utf8(v) => v.push(String::new()),
+            ColumnData::Binary(v) => v.push(Vec::new()),
+        }
+    }
+
+    /// 按下标收集
+    fn take(&self, indices: &[usize]) -> ColumnData {
+        match self {
+            ColumnData::Boolean(v) => ColumnData::Boolean(indices.iter().map(|&i| v[i]).collect()),
+            ColumnData::Int32(v) => ColumnData::Int32(indices.iter().map(|&i| v[i]).collect()),
+            ColumnData::Int64(v) => ColumnData::Int64(indices.iter().map(|&i| v[i]).collect()),
+            ColumnData::Float32(v) => ColumnData::Float32(indices.iter().map(|&i| v[i]).collect()),
+            ColumnData::Float64(v) => ColumnData::Float64(indices.iter().map(|&i| v[i]).collect()),
+            ColumnData::Utf8(v) => ColumnData::Utf8(indices.iter().map(|&i| v[i].clone()).collect()),
+            ColumnData::Binary(v) => ColumnData::Binary(indices.iter().map(|&i| v[i].clone()).collect()),
+        }
+    }
+}
+
+/// 列向量：强类型数据 + 有效位图
+#[derive(Debug, Clone, PartialEq)]
+pub struct ColumnVector {
+    pub data_type: DataType,
+    pub data: ColumnData,
+    pub validity: Bitmap,
+}
+
+impl ColumnVector {
+    pub fn new(data_type: DataType) -> Self {
+        Self::with_capacity(data_type, 0)
+    }
+
+    pub fn with_capacity(data_type: DataType, capacity: usize) -> Self {
+        let data = ColumnData::with_capacity(&data_type, capacity);
+        Self { data_type, data, validity: Bitmap::with_capacity(capacity) }
+    }
+
+    pub fn from_i64(values: Vec<i64>) -> Self {
+        let validity = Bitmap::new_set(values.len());
+        Self { data_type: DataType::BigInt, data: ColumnData::Int64(values), validity }
+    }
+
+    pub fn from_i32(values: Vec<i32>) -> Self {
+        let validity = Bitmap::new_set(values.len());
+        Self { data_type: DataType::Integer, data: ColumnData::Int32(values), validity }
+    }
+
+    pub fn from_f64(values: Vec<f64>) -> Self {
+        let validity = Bitmap::new_set(values.len());
+        Self { data_type: DataType::Double, data: ColumnData::Float64(values), validity }
+    }
+
+    pub fn from_bool(values: Vec<bool>) -> Self {
+        let validity = Bitmap::new_set(values.len());
+        Self { data_type: DataType::Boolean, data: ColumnData::Boolean(values), validity }
+    }
+
+    pub fn from_strings(values: Vec<String>) -> Self {
+        let validity = Bitmap::new_set(values.len());
+        Self { data_type: DataType::String, data: ColumnData::Utf8(values), validity }
+    }
+
+    pub fn from_strs(values: &[&str]) -> Self {
+        Self::from_strings(values.iter().map(|s| s.to_string()).collect())
+    }
+
+    pub fn len(&self) -> usize {
+        self.data.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    #[inline]
+    pub fn is_null(&self, index: usize) -> bool {
+        !self.validity.get(index)
+    }
+
+    pub fn null_count(&self) -> usize {
+        self.len() - self.validity.count_set()
+    }
+
+    pub fn push_null(&mut self) {
+        self.data.push_default();
+        self.validity.push(false);
+    }
+
+    /// 追加一个值，类型不匹配时按 NULL 处理
+    pub fn push_value(&mut self, value: &Value) {
+        let pushed = match (&mut self.data, value) {
+            (_, Value::Null) => false,
+            (ColumnData::Boolean(v), Value::Boolean(b)) => { v.push(*b); true }
+            (ColumnData::Int32(v), Value::Integer(i)) => { v.push(*i); true }
+            (ColumnData::Int64(v), Value::BigInt(i))
+            | (ColumnData::Int64(v), Value::Timestamp(i))
+            | (ColumnData::Int64(v), Value::Date(i)) => { v.push(*i); true }
+            (ColumnData::Int64(v), Value::Integer(i)) => { v.push(*i as i64); true }
+            (ColumnData::Float32(v), Value::Float(f)) => { v.push(*f); true }
+            (ColumnData::Float64(v), Value::Double(f)) => { v.push(*f); true }
+            (ColumnData::Float64(v), Value::Float(f)) => { v.push(*f as f64); true }
+            (ColumnData::Float64(v), Value::BigInt(i)) => { v.push(*i as f64); true }
+            (ColumnData::Float64(v), Value::Integer(i)) => { v.push(*i as f64); true }
+            (ColumnData::Utf8(v), Value::String(s)) | (ColumnData::Utf8(v), Value::Decimal(s)) => {
+                v.push(s.clone());
+                true
+            }
+            (ColumnData::Binary(v), Value::Binary(b)) => { v.push(b.clone()); true }
+            _ => false,
+        };
+        if pushed {
+            self.validity.push(true);
+        } else {
+            self.push_null();
+        }
+    }
+
+    /// 从字符串解析并追加一个值，空串或解析失败按 NULL 处理 (字符串列除外)
+    pub fn push_str(&mut self, text: &str) {
+        let pushed = match &mut self.data {
+            ColumnData::Utf8(v) => { v.push(text.to_string()); true }
+            ColumnData::Boolean(v) => match text.to_lowercase().as_str() {
+                "true" | "1" => { v.push(true); true }
+                "false" | "0" => { v.push(false); true }
+                _ => false,
+            },
+            ColumnData::Int32(v) => text.parse::<i32>().map(|x| v.push(x)).is_ok(),
+            ColumnData::Int64(v) => text.parse::<i64>().map(|x| v.push(x)).is_ok(),
+            ColumnData::Float32(v) => text.parse::<f32>().map(|x| v.push(x)).is_ok(),
+            ColumnData::Float64(v) => text.parse::<f64>().map(|x| v.push(x)).is_ok(),
+            ColumnData::Binary(v) => { v.push(text.as_bytes().to_vec()); true }
+        };
+        if pushed {
+            self.validity.push(true);
+        } else {
+            self.push_null();
+        }
+    }
+
+    /// 读取一个值
+    pub fn value(&self, index: usize) -> Value {
+        if self.is_null(index) {
+            return Value::Null;
+        }
+        match (&self.data, &self.data_type) {
+            (ColumnData::Int64(v), DataType::Timestamp) => Value::Timestamp(v[index]),
+            (ColumnData::Int64(v), DataType::Date) => Value::Date(v[index]),
+            (ColumnData::Utf8(v), DataType::Decimal { .. }) => Value::Decimal(v[index].clone()),
+            (ColumnData::Boolean(v), _) => Value::Boolean(v[index]),
+            (ColumnData::Int32(v), _) => Value::Integer(v[index]),
+            (ColumnData::Int64(v), _) => Value::BigInt(v[index]),
+            (ColumnData::Float32(v), _) => Value::Float(v[index]),
+            (ColumnData::Float64(v), _) => Value::Double(v[index]),
+            (ColumnData::Utf8(v), _) => Value::String(v[index].clone()),
+            (ColumnData::Binary(v), _) => Value::Binary(v[index].clone()),
+        }
+    }
+
+    /// 以客户端结果格式输出一个值，NULL 输出为空串
+    pub fn format_value(&self, index: usize) -> String {
+        if self.is_null(index) {
+            return String::new();
+        }
+        match &self.data {
+            ColumnData::Boolean(v) => v[index].to_string(),
+            ColumnData::Int32(v) => v[index].to_string(),
+            ColumnData::Int64(v) => v[index].to_string(),
+            ColumnData::Float32(v) => v[index].to_string(),
+            ColumnData::Float64(v) => v[index].to_string(),
+            ColumnData::Utf8(v) => v[index].clone(),
+            ColumnData::Binary(v) => String::from_utf8_lossy(&v[index]).into_owned(),
+        }
+    }
+
+    /// 按下标收集生成新列
+    pub fn take(&self, indices: &[usize]) -> ColumnVector {
+        let mut validity = Bitmap::with_capacity(indices.len());
+        for &i in indices {
+            validity.push(self.validity.get(i));
+        }
+        ColumnVector { data_type: self.data_type.clone(), data: self.data.take(indices), validity }
+    }
+
+    /// 按可选下标收集，`None` 生成 NULL (用于外连接补空)
+    pub fn take_opt(&self, indices: &[Option<usize>]) -> ColumnVector {
+        let mut out = ColumnVector::with_capacity(self.data_type.clone(), indices.len());
+        for index in indices {
+            match index {
+                Some(i) => out.append_from(self, *i),
+                None => out.push_null(),
+            }
+        }
+        out
+    }
+
+    /// 从同类型的列复制一个值
+    pub fn append_from(&mut self, other: &ColumnVector, index: usize) {
+        if other.is_null(index) {
+            self.push_null();
+            return;
+        }
+        match (&mut self.data, &other.data) {
+            (ColumnData::Boolean(a), ColumnData::Boolean(b)) => a.push(b[index]),
+            (ColumnData::Int32(a), ColumnData::Int32(b)) => a.push(b[index]),
+            (ColumnData::Int64(a), ColumnData::Int64(b)) => a.push(b[index]),
+            (ColumnData::Float32(a), ColumnData::Float32(b)) => a.push(b[index]),
+            (ColumnData::Float64(a), ColumnData::Float64(b)) => a.push(b[index]),
+            (ColumnData::Utf8(a), ColumnData::Utf8(b)) => a.push(b[index].clone()),
+            (ColumnData::Binary(a), ColumnData::Binary(b)) => a.push(b[index].clone()),
+            _ => {
+                self.push_value(&other.value(index));
+                return;
+            }
+        }
+        self.validity.push(true);
+    }
+
+    /// 追加另一列的全部数据
+    pub fn extend(&mut self, other: &ColumnVector) {
+        for i in 0..other.len() {
+            self.append_from(other, i);
+        }
+    }
+
+    /// 比较两列中的两个值，NULL 排在最前
+    ///
+    /// 不同类型的值按类别排序：布尔 < 数值 < 文本。数值类别内整数与浮点按精确值比较
+    /// (不经 f64 舍入)，-0.0 与 0.0 相等，NaN 彼此相等且大于其他数值；文本类别内
+    /// Utf8 与 Binary 按字节比较。这样定义的是一个全序，相等关系满足传递性。
+    pub fn compare(&self, index: usize, other: &ColumnVector, other_index: usize) -> Ordering {
+        match (self.is_null(index), other.is_null(other_index)) {
+            (true, true) => return Ordering::Equal,
+            (true, false) => return Ordering::Less,
+            (false, true) => return Ordering::Greater,
+            _ => {}
+        }
+        match (&self.data, &other.data) {
+            (ColumnData::Int32(a), ColumnData::Int32(b)) => a[index].cmp(&b[other_index]),
+            (ColumnData::Int64(a), ColumnData::Int64(b)) => a[index].cmp(&b[other_index]),
+            (ColumnData::Utf8(a), ColumnData::Utf8(b)) => a[index].cmp(&b[other_index]),
+            _ => self.scalar(index).cmp(&other.scalar(other_index)),
+        }
+    }
+
+    /// 判断两列中的两个值是否相等 (NULL 与 NULL 视为相等，供分组/去重使用)
+    pub fn eq_at(&self, index: usize, other: &ColumnVector, other_index: usize) -> bool {
+        self.compare(index, other, other_index) == Ordering::Equal
+    }
+
+    /// 将一个值写入哈希器
+    ///
+    /// 与 `compare` 保持一致：`compare` 判为相等的值哈希相同。数值统一按规范化的
+    /// f64 哈希 (整数与等值的浮点相同)，文本按字节哈希。
+    pub fn hash_at<H: Hasher>(&self, index: usize, state: &mut H) {
+        if self.is_null(index) {
+            0u8.hash(state);
+            return;
+        }
+        match self.scalar(index) {
+            Scalar::Boolean(v) => {
+                1u8.hash(state);
+                v.hash(state);
+            }
+            Scalar::Int(v) => {
+                2u8.hash(state);
+                normalized_f64_bits(v as f64).hash(state);
+            }
+            Scalar::Float(v) => {
+                2u8.hash(state);
+                normalized_f64_bits(v).hash(state);
+            }
+            Scalar::Bytes(v) => {
+                3u8.hash(state);
+                v.hash(state);
+            }
+        }
+    }
+
+    /// 非 NULL 值按比较类别取出
+    fn scalar(&self, index: usize) -> Scalar<'_> {
+        match &self.data {
+            ColumnData::Boolean(v) => Scalar::Boolean(v[index]),
+            ColumnData::Int32(v) => Scalar::Int(v[index] as i64),
+            ColumnData::Int64(v) => Scalar::Int(v[index]),
+            ColumnData::Float32(v) => Scalar::Float(v[index] as f64),
+            ColumnData::Float64(v) => Scalar::Float(v[index]),
+            ColumnData::Utf8(v) => Scalar::Bytes(v[index].as_bytes()),
+            ColumnData::Binary(v) => Scalar::Bytes(&v[index]),
+        }
+    }
+
+    /// 估算列占用的内存字节数
+    pub fn memory_size(&self) -> usize {
+        let data = match &self.data {
+            ColumnData::Boolean(v) => v.len(),
+            ColumnData::Int32(v) => v.len() * 4,
+            ColumnData::Int64(v) => v.len() * 8,
+            ColumnData::Float32(v) => v.len() * 4,
+            ColumnData::Float64(v) => v.len() * 8,
+            ColumnData::Utf8(v) => v.iter().map(|s| s.len() + std::mem::size_of::<String>()).sum(),
+            ColumnData::Binary(v) => v.iter().map(|b| b.len() + std::mem::size_of::<Vec<u8>>()).sum(),
+        };
+        data + self.validity.words().len() * 8
+    }
+
+    /// 以 f64 读取数值列的值
+    pub fn as_f64(&self, index: usize) -> Option<f64> {
+        if self.is_null(index) {
+            return None;
+        }
+        match &self.data {
+            ColumnData::Int32(v) => Some(v[index] as f64),
+            ColumnData::Int64(v) => Some(v[index] as f64),
+            ColumnData::Float32(v) => Some(v[index] as f64),
+            ColumnData::Float64(v) => Some(v[index]),
+            ColumnData::Utf8(v) => v[index].parse::<f64>().ok(),
+            _ => None,
+        }
+    }
+}
+
+/// `compare` 使用的值类别，变体顺序即类别顺序
+#[derive(Clone, Copy)]
+enum Scalar<'a> {
+    Boolean(bool),
+    Int(i64),
+    Float(f64),
+    Bytes(&'a [u8]),
+}
+
+impl Scalar<'_> {
+    fn rank(&self) -> u8 {
+        match self {
+            Scalar::Boolean(_) => 0,
+            Scalar::Int(_) | Scalar::Float(_) => 1,
+            Scalar::Bytes(_) => 2,
+        }
+    }
+
+    fn cmp(&self, other: &Scalar<'_>) -> Ordering {
+        match (*self, *other) {
+            (Scalar::Boolean(a), Scalar::Boolean(b)) => a.cmp(&b),
+            (Scalar::Int(a), Scalar::Int(b)) => a.cmp(&b),
+            (Scalar::Float(a), Scalar::Float(b)) => normalize_f64(a).total_cmp(&normalize_f64(b)),
+            (Scalar::Int(a), Scalar::Float(b)) => cmp_int_float(a, b),
+            (Scalar::Float(a), Scalar::Int(b)) => cmp_int_float(b, a).reverse(),
+            (Scalar::Bytes(a), Scalar::Bytes(b)) => a.cmp(b),
+            _ => self.rank().cmp(&other.rank()),
+        }
+    }
+}
+
+/// -0.0 归一为 0.0，所有 NaN 归一为同一个 NaN
+#[inline]
+pub fn normalize_f64(value: f64) -> f64 {
+    if value == 0.0 {
+        0.0
+    } else if value.is_nan() {
+        f64::NAN
+    } else {
+        value
+    }
+}
+
+/// 规范化后的 f64 位模式，相等的数值 (含整数) 位模式相同
+#[inline]
+pub fn normalized_f64_bits(value: f64) -> u64 {
+    normalize_f64(value).to_bits()
+}
+
+/// 整数与浮点按精确值比较：先比较舍入后的 f64，舍入后相等时浮点必为整数值，再按 i128 比较
+fn cmp_int_float(int: i64, float: f64) -> Ordering {
+    if float.is_nan() {
+        return Ordering::Less;
+    }
+    match (int as f64).partial_cmp(&float) {
+        Some(Ordering::Equal) | None => (int as i128).cmp(&(float as i128)),
+        Some(ordering) => ordering,
+    }
+}
+
+/// 字段定义
+#[derive(Debug, Clone, PartialEq)]
+pub struct Field {
+    pub name: String,
+    pub data_type: DataType,
+    pub nullable: bool,
+}
+
+impl Field {
+    pub fn new(name: impl Into<String>, data_type: DataType) -> Self {
+        Self { name: name.into(), data_type, nullable: true }
+    }
+}
+
+/// 批的模式
+#[derive(Debug, Clone, PartialEq, Default)]
+pub struct Schema {
+    pub fields: Vec<Field>,
+}
+
+impl Schema {
+    pub fn new(fields: Vec<Field>) -> Self {
+        Self { fields }
+    }
+
+    /// 按列名查找第一个匹配的字段下标
+    pub fn index_of(&self, name: &str) -> Option<usize> {
+        self.fields.iter().position(|f| f.name == name)
+    }
+
+    pub fn column_names(&self) -> Vec<String> {
+        self.fields.iter().map(|f| f.name.clone()).collect()
+    }
+
+    /// 拼接两个模式 (用于连接输出)
+    pub fn join(&self, other: &Schema) -> Schema {
+        let mut fields = self.fields.clone();
+        fields.extend(other.fields.iter().cloned());
+        Schema { fields }
+    }
+}
+
+/// 列式批
+#[derive(Debug, Clone, PartialEq)]
+pub struct RecordBatch {
+    pub schema: Schema,
+    pub columns: Vec<ColumnVector>,
+    /// 选择向量：存在时只有其中列出的物理行是可见的
+    pub selection: Option<Vec<u32>>,
+    num_rows: usize,
+}
+
+impl RecordBatch {
+    /// 创建批，要求列数与模式一致且所有列等长
+    pub fn try_new(schema: Schema, columns: Vec<ColumnVector>) -> Result<Self> {
+        if schema.fields.len() != columns.len() {
+            return Err(common::Error::Execution(format!(
+                "RecordBatch schema has {} fields but {} columns were given",
+                schema.fields.len(),
+                columns.len()
+            )));
+        }
+        let num_rows = columns.first().map(|c| c.len()).unwrap_or(0);
+        if let Some(bad) = columns.iter().position(|c| c.len() != num_rows) {
+            return Err(common::Error::Execution(format!(
+                "RecordBatch column '{}' has {} rows, expected {}",
+                schema.fields[bad].name,
+                columns[bad].len(),
+                num_rows
+            )));
+        }
+        Ok(Self { schema, columns, selection: None, num_rows })
+    }
+
+    /// 创建指定模式的空批
+    pub fn empty(schema: Schema) -> Self {
+        let columns = schema.fields.iter().map(|f| ColumnVector::new(f.data_type.clone())).collect();
+        Self { schema, columns, selection: None, num_rows: 0 }
+    }
+
+    /// 按模式从字符串行构建批
+    pub fn from_rows(schema: Schema, rows: &[Vec<String>]) -> Result<Self> {
+        let mut columns: Vec<ColumnVector> = schema
+            .fields
+            .iter()
+            .map(|f| ColumnVector::with_capacity(f.data_type.clone(), rows.len()))
+            .collect();
+        for row in rows {
+            for (col_index, column) in columns.iter_mut().enumerate() {
+                match row.get(col_index) {
+                    Some(text) => column.push_str(text),
+                    None => column.push_null(),
+                }
+            }
+        }
+        Self::try_new(schema, columns)
+    }
+
+    /// 从字符串行格式的结果构建批，按列内容推断类型
+    pub fn from_query_result(result: &QueryResult) -> Result<Self> {
+        let fields = result
+            .columns
+            .iter()
+            .enumerate()
+            .map(|(i, name)| Field::new(name.clone(), infer_data_type(result.rows.iter().filter_map(|r| r.get(i)))))
+            .collect();
+        Self::from_rows(Schema::new(fields), &result.rows)
+    }
+
+    /// 物理行数 (忽略选择向量)
+    pub fn physical_rows(&self) -> usize {
+        self.num_rows
+    }
+
+    /// 逻辑行数 (考虑选择向量)
+    pub fn num_rows(&self) -> usize {
+        match &self.selection {
+            Some(sel) => sel.len(),
+            None => self.num_rows,
+        }
+    }
+
+    pub fn num_columns(&self) -> usize {
+        self.columns.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.num_rows() == 0
+    }
+
+    pub fn column(&self, index: usize) -> &ColumnVector {
+        &self.columns[index]
+    }
+
+    pub fn column_by_name(&self, name: &str) -> Option<&ColumnVector> {
+        self.schema.index_of(name).map(|i| &self.columns[i])
+    }
+
+    /// 估算批占用的内存字节数 (数据 + 有效位图)，供算子向 MemoryManager 申请额度
+    pub fn memory_size(&self) -> usize {
+        self.columns.iter().map(|c| c.memory_size()).sum::<usize>()
+            + self.selection.as_ref().map(|s| s.len() * 4).unwrap_or(0)
+    }
+
+    /// 可见的物理行下标
+    pub fn row_indices(&self) -> Vec<usize> {
+        match &self.selection {
+            Some(sel) => sel.iter().map(|&i| i as usize).collect(),
+            None => (0..self.num_rows).collect(),
+        }
+    }
+
+    /// 设置选择向量 (下标为物理行号)
+    pub fn with_selection(mut self, selection: Vec<u32>) -> Self {
+        self.selection = Some(selection);
+        self
+    }
+
+    /// 按物理行下标收集生成新批，结果不带选择向量
+    pub fn take(&self, indices: &[usize]) -> RecordBatch {
+        let columns = self.columns.iter().map(|c| c.take(indices)).collect();
+        RecordBatch { schema: self.schema.clone(), columns, selection: None, num_rows: indices.len() }
+    }
+
+    /// 物化选择向量
+    pub fn compact(self) -> RecordBatch {
+        match &self.selection {
+            Some(_) => self.take(&self.row_indices()),
+            None => self,
+        }
+    }
+
+    /// 只保留指定列
+    pub fn project(&self, column_indices: &[usize]) -> RecordBatch {
+        let fields = column_indices.iter().map(|&i| self.schema.fields[i].clone()).collect();
+        let columns = column_indices.iter().map(|&i| self.columns[i].clone()).collect();
+        RecordBatch {
+            schema: Schema::new(fields),
+            columns,
+            selection: self.selection.clone(),
+            num_rows: self.num_rows,
+        }
+    }
+
+    /// 纵向拼接多个同模式的批
+    pub fn concat(schema: Schema, batches: &[RecordBatch]) -> Result<RecordBatch> {
+        let mut out = RecordBatch::empty(schema);
+        for batch in batches {
+            out.append(batch)?;
+        }
+        Ok(out)
+    }
+
+    /// 追加另一个批的可见行
+    pub fn append(&mut self, other: &RecordBatch) -> Result<()> {
+        if other.num_columns() != self.num_columns() {
+            return Err(common::Error::Execution(format!(
+                "cannot append batch with {} columns to batch with {} columns",
+                other.num_columns(),
+                self.num_columns()
+            )));
+        }
+        if self.selection.is_some() {
+            *self = std::mem::replace(self, RecordBatch::empty(Schema::new(Vec::new()))).compact();
+        }
+        let indices = other.row_indices();
+        for (column, other_column) in self.columns.iter_mut().zip(other.columns.iter()) {
+            for &i in &indices {
+                column.append_from(other_column, i);
+            }
+        }
+        self.num_rows += indices.len();
+        Ok(())
+    }
+
+    /// 计算一行在若干列上的哈希值
+    pub fn hash_row(&self, row: usize, key_columns: &[usize]) -> u64 {
+        let mut hasher = std::collections::hash_map::DefaultHasher::new();
+        for &col in key_columns {
+            self.columns[col].hash_at(row, &mut hasher);
+        }
+        hasher.finish()
+    }
+
+    /// 若干列中是否存在 NULL (SQL 中 NULL 键不参与等值连接)
+    pub fn has_null(&self, row: usize, key_columns: &[usize]) -> bool {
+        key_columns.iter().any(|&col| self.columns[col].is_null(row))
+    }
+
+    /// 按列名解析列下标，找不到时报错
+    pub fn resolve_columns(&self, names: &[String]) -> Result<Vec<usize>> {
+        names
+            .iter()
+            .map(|name| {
+                self.schema
+                    .index_of(name)
+                    .ok_or_else(|| common::Error::Execution(format!("column '{}' not found in batch", name)))
+            })
+            .collect()
+    }
+
+    /// 比较两行在若干列上是否相等
+    pub fn rows_equal(&self, row: usize, key_columns: &[usize], other: &RecordBatch, other_row: usize, other_key_columns: &[usize]) -> bool {
+        key_columns
+            .iter()
+            .zip(other_key_columns.iter())
+            .all(|(&a, &b)| self.columns[a].eq_at(row, &other.columns[b], other_row))
+    }
+
+    /// 转换为客户端使用的字符串行格式
+    pub fn into_query_result(self) -> QueryResult {
+        let indices = self.row_indices();
+        let mut rows = Vec::with_capacity(indices.len());
+        for &i in &indices {
+            rows.push(self.columns.iter().map(|c| c.format_value(i)).collect());
+        }
+        let mut result = QueryResult::new();
+        result.columns = self.schema.column_names();
+        result.rows = rows;
+        result.affected_rows = result.rows.len() as u64;
+        result
+    }
+}
+
+impl From<RecordBatch> for QueryResult {
+    fn from(batch: RecordBatch) -> Self {
+        batch.into_query_result()
+    }
+}
+
+/// 基于强类型键的行哈希索引，供连接、聚合与集合算子复用
+///
+/// 只保存构建侧的物理行号，命中后再用 `rows_equal` 校验以排除哈希冲突。
+#[derive(Debug, Default)]
+pub struct RowHashIndex {
+    buckets: HashMap<u64, Vec<usize>>,
+    key_columns: Vec<usize>,
+}
+
+impl RowHashIndex {
+    pub fn with_capacity(key_columns: Vec<usize>, capacity: usize) -> Self {
+        Self { buckets: HashMap::with_capacity(capacity), key_columns }
+    }
+
+    /// 为批中所有可见行建立索引
+    pub fn build(batch: &RecordBatch, key_columns: Vec<usize>, capacity: usize) -> Self {
+        let mut index = Self::with_capacity(key_columns, capacity.min(batch.num_rows()));
+        for row in batch.row_indices() {
+            index.insert(batch, row);
+        }
+        index
+    }
+
+    pub fn key_columns(&self) -> &[usize] {
+        &self.key_columns
+    }
+
+    pub fn insert(&mut self, batch: &RecordBatch, row: usize) {
+        let hash = batch.hash_row(row, &self.key_columns);
+        self.buckets.entry(hash).or_default().push(row);
+    }
+
+    /// 查找构建侧中与探测行键相等的所有行
+    pub fn probe<'a>(
+        &'a self,
+        build: &'a RecordBatch,
+        probe: &'a RecordBatch,
+        row: usize,
+        probe_keys: &'a [usize],
+    ) -> impl Iterator<Item = usize> + 'a {
+        let hash = probe.hash_row(row, probe_keys);
+        self.buckets
+            .get(&hash)
+            .into_iter()
+            .flatten()
+            .copied()
+            .filter(move |&candidate| build.rows_equal(candidate, &self.key_columns, probe, row, probe_keys))
+    }
+
+    pub fn contains(&self, build: &RecordBatch, probe: &RecordBatch, row: usize, probe_keys: &[usize]) -> bool {
+        self.probe(build, probe, row, probe_keys).next().is_some()
+    }
+}
+
+/// 根据字符串样本推断列类型：全部是整数为 BigInt，全部是数值为 Double，否则为 String
+pub fn infer_data_type<'a>(values: impl Iterator<Item = &'a String>) -> DataType {
+    let mut all_int = true;
+    let mut all_numeric = true;
+    let mut seen = false;
+    for value in values {
+        if value.is_empty() {
+            continue;
+        }
+        seen = true;
+        if value.parse::<i64>().is_err() {
+            all_int = false;
+            if value.parse::<f64>().is_err() {
+                all_numeric = false;
+                break;
+            }
+        }
+    }
+    match (seen, all_int, all_numeric) {
+        (false, _, _) => DataType::String,
+        (true, true, _) => DataType::BigInt,
+        (true, false, true) => DataType::Double,
+        _ => DataType::String,
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn sample_batch() -> RecordBatch {
+        let schema = Schema::new(vec![
+            Field::new("id", DataType::BigInt),
+            Field::new("name", DataType::String),
+            Field::new("value", DataType::Double),
+        ]);
+        RecordBatch::try_new(schema, vec![
+            ColumnVector::from_i64(vec![3, 1, 2]),
+            ColumnVector::from_strs(&["Charlie", "Alice", "Bob"]),
+            ColumnVector::from_f64(vec![300.0, 100.0, 200.5]),
+        ]).unwrap()
+    }
+
+    #[test]
+    fn test_bitmap_basic() {
+        let mut bitmap = Bitmap::new_set(70);
+        assert_eq!(bitmap.count_set(), 70);
+        bitmap.set(65, false);
+        assert!(!bitmap.get(65));
+        assert_eq!(bitmap.count_set(), 69);
+        bitmap.push(false);
+        assert_eq!(bitmap.len(), 71);
+        assert!(!bitmap.all_set());
+    }
+
+    #[test]
+    fn test_try_new_rejects_mismatched_lengths() {
+        let schema = Schema::new(vec![Field::new("a", DataType::BigInt), Field::new("b", DataType::BigInt)]);
+        let result = RecordBatch::try_new(schema, vec![ColumnVector::from_i64(vec![1, 2]), ColumnVector::from_i64(vec![1])]);
+        assert!(result.is_err());
+    }
+
+    #[test]
+    fn test_selection_and_conversion() {
+        let batch = sample_batch().with_selection(vec![0, 2]);
+        assert_eq!(batch.num_rows(), 2);
+        let result: QueryResult = batch.into();
+        assert_eq!(result.columns, vec!["id", "name", "value"]);
+        assert_eq!(result.rows, vec![
+            vec!["3".to_string(), "Charlie".to_string(), "300".to_string()],
+            vec!["2".to_string(), "Bob".to_string(), "200.5".to_string()],
+        ]);
+        assert_eq!(result.affected_rows, 2);
+    }
+
+    #[test]
+    fn test_from_query_result_infers_types() {
+        let mut result = QueryResult::new();
+        result.columns = vec!["id".to_string(), "name".to_string()];
+        result.rows = vec![
+            vec!["1".to_string(), "Alice".to_string()],
+            vec!["".to_string(), "Bob".to_string()],
+        ];
+        let batch = RecordBatch::from_query_result(&result).unwrap();
+        assert_eq!(batch.schema.fields[0].data_type, DataType::BigInt);
+        assert_eq!(batch.schema.fields[1].data_type, DataType::String);
+        assert!(batch.column(0).is_null(1));
+        assert_eq!(batch.into_query_result().rows, result.rows);
+    }
+
+    #[test]
+    fn test_typed_compare_and_hash() {
+        let batch = sample_batch();
+        let ids = batch.column(0);
+        assert_eq!(ids.compare(1, ids, 2), Ordering::Less);
+
+        let narrow = ColumnVector::from_i32(vec![1]);
+        let mut a = std::collections::hash_map::DefaultHasher::new();
+        let mut b = std::collections::hash_map::DefaultHasher::new();
+        ids.hash_at(1, &mut a);
+        narrow.hash_at(0, &mut b);
+        assert_eq!(a.finish(), b.finish());
+        assert!(ids.eq_at(1, &narrow, 0));
+
+        // compare 判为相等的跨类型值哈希也相同
+        let hash = |column: &ColumnVector| {
+            let mut hasher = std::collections::hash_map::DefaultHasher::new();
+            column.hash_at(0, &mut hasher);
+            hasher.finish()
+        };
+        let equal_pairs = [
+            (ColumnVector::from_i64(vec![2]), ColumnVector::from_f64(vec![2.0])),
+            (ColumnVector::from_i32(vec![0]), ColumnVector::from_f64(vec![-0.0])),
+            (ColumnVector::from_f64(vec![0.0]), ColumnVector::from_f64(vec![-0.0])),
+            (ColumnVector::from_strs(&["a"]), {
+                let mut bytes = ColumnVector::new(DataType::Binary);
+                bytes.push_value(&Value::Binary(b"a".to_vec()));
+                bytes
+            }),
+        ];
+        for (left, right) in &equal_pairs {
+            assert!(left.eq_at(0, right, 0));
+            assert_eq!(hash(left), hash(right));
+        }
+
+        // 整数与浮点按精确值比较，不因 f64 舍入把不同的整数判为相等
+        let big = ColumnVector::from_i64(vec![1 << 53, (1 << 53) + 1]);
+        let rounded = ColumnVector::from_f64(vec![(1u64 << 53) as f64]);
+        assert!(big.eq_at(0, &rounded, 0));
+        assert_eq!(big.compare(1, &rounded, 0), Ordering::Greater);
+        assert_eq!(rounded.compare(0, &big, 1), Ordering::Less);
+
+        // 类别全序：布尔 < 数值 < 文本，数值文本不等于数值，相等关系因此可传递
+        let text = ColumnVector::from_strings(vec!["2".to_string(), "2.0".to_string()]);
+        let two = ColumnVector::from_i64(vec![2]);
+        let flag = ColumnVector::from_bool(vec![true]);
+        assert!(!two.eq_at(0, &text, 0));
+        assert_eq!(two.compare(0, &text, 1), Ordering::Less);
+        assert_eq!(flag.compare(0, &two, 0), Ordering::Less);
+        assert_eq!(text.compare(0, &text, 1), Ordering::Less);
+    }
+
+    #[test]
+    fn test_row_hash_index_probe() {
+        let build = sample_batch();
+        let probe = RecordBatch::try_new(
+            Schema::new(vec![Field::new("id", DataType::Integer)]),
+            vec![ColumnVector::from_i32(vec![2, 7])],
+        ).unwrap();
+        let index = RowHashIndex::build(&build, vec![0], 16);
+        assert_eq!(index.probe(&build, &probe, 0, &[0]).collect::<Vec<_>>(), vec![2]);
+        assert!(!index.contains(&build, &probe, 1, &[0]));
+    }
+
+    #[test]
+    fn test_take_opt_and_append() {
+        let batch = sample_batch();
+        let padded = batch.column(1).take_opt(&[Some(1), None]);
+        assert_eq!(padded.format_value(0), "Alice");
+        assert!(padded.is_null(1));
+
+        let mut merged = batch.clone().with_selection(vec![1]);
+        merged.append(&batch).unwrap();
+        assert_eq!(merged.num_rows(), 4);
+        assert_eq!(merged.column(0).value(0), Value::BigInt(1));
+    }
+}
@@ -0,0 +1,387 @@
+//! 流式结果集
+//!
+//! 结果按块从根算子拉取：消费者 (服务端协议层) 每取一块，算子链才向下游要一块，
+//! 存储层的预读受有界通道约束，因此客户端读得慢时整条链路都会停下 (背压)。
+//! LIMIT 凑满后立即丢弃上游，丢弃表扫描流会取消存储层的后台预读；客户端取消时
+//! 同样丢弃整条算子链。
+
+use async_trait::async_trait;
+use common::Result;
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::Arc;
+use tokio::sync::Notify;
+
+use crate::executor::execution_models::QueryResult;
+use crate::executor::operators::sort_operators::top_n_batch;
+use crate::executor::record_batch::{RecordBatch, Schema};
+use crate::storage::handler::TableScanStream;
+use crate::storage::memory::MemoryBudget;
+
+/// 物化结果切块时每块的行数
+pub const DEFAULT_RESULT_CHUNK_ROWS: usize = 1024;
+
+/// 按块产出行的算子
+#[async_trait]
+pub trait RowSource: Send {
+    /// 输出列
+    fn columns(&self) -> &[String];
+
+    /// 输出列的类型，数据源知道时返回 (如按表定义扫描)，否则由消费者自行推断
+    fn schema(&self) -> Option<Schema> {
+        None
+    }
+
+    /// 读取下一块行，结束返回 `None`
+    async fn next_rows(&mut self) -> Result<Option<Vec<Vec<String>>>>;
+}
+
+#[async_trait]
+impl RowSource for TableScanStream {
+    fn columns(&self) -> &[String] {
+        TableScanStream::columns(self)
+    }
+
+    fn schema(&self) -> Option<Schema> {
+        TableScanStream::schema(self)
+    }
+
+    async fn next_rows(&mut self) -> Result<Option<Vec<Vec<String>>>> {
+        TableScanStream::next_rows(self).await
+    }
+}
+
+/// 已物化的结果，按块交出
+pub struct MaterializedSource {
+    columns: Vec<String>,
+    rows: std::vec::IntoIter<Vec<String>>,
+    chunk_rows: usize,
+}
+
+impl MaterializedSource {
+    pub fn new(result: QueryResult, chunk_rows: usize) -> Self {
+        Self {
+            columns: result.columns,
+            rows: result.rows.into_iter(),
+            chunk_rows: chunk_rows.max(1),
+        }
+    }
+}
+
+#[async_trait]
+impl RowSource for MaterializedSource {
+    fn columns(&self) -> &[String] {
+        &self.columns
+    }
+
+    async fn next_rows(&mut self) -> Result<Option<Vec<Vec<String>>>> {
+        let chunk: Vec<Vec<String>> = self.rows.by_ref().take(self.chunk_rows).collect();
+        Ok((!chunk.is_empty()).then_some(chunk))
+    }
+}
+
+/// LIMIT / OFFSET：凑满后丢弃上游，不再向下游拉取
+pub struct LimitSource {
+    columns: Vec<String>,
+    schema: Option<Schema>,
+    input: Option<Box<dyn RowSource>>,
+    offset: u64,
+    remaining: u64,
+}
+
+impl LimitSource {
+    pub fn new(input: Box<dyn RowSource>, limit: u64, offset: u64) -> Self {
+        Self {
+            columns: input.columns().to_vec(),
+            schema: input.schema(),
+            input: (limit > 0).then_some(input),
+            offset,
+            remaining: limit,
+        }
+    }
+}
+
+#[async_trait]
+impl RowSource for LimitSource {
+    fn columns(&self) -> &[String] {
+        &self.columns
+    }
+
+    fn schema(&self) -> Option<Schema> {
+        self.schema.clone()
+    }
+
+    async fn next_rows(&mut self) -> Result<Option<Vec<Vec<String>>>> {
+        while let Some(input) = self.input.as_mut() {
+            let Some(mut rows) = input.next_rows().await? else {
+                self.input = None;
+                break;
+            };
+            let skipped = self.offset.min(rows.len() as u64);
+            self.offset -= skipped;
+            rows.drain(..skipped as usize);
+            if rows.len() as u64 >= self.remaining {
+                rows.truncate(self.remaining as usize);
+                self.remaining = 0;
+                self.input = None;
+            } else {
+                self.remaining -= rows.len() as u64;
+            }
+            if !rows.is_empty() {
+                return Ok(Some(rows));
+            }
+        }
+        Ok(None)
+    }
+}
+
+/// 流式 TopN：逐块合并，任何时刻只保留前 limit 行与当前一块
+///
+/// 每块都按同一个 `schema` 解析，已丢弃的行不会因为后面的块改变列类型而需要重新比较；
+/// 输入没有声明列类型时应改用外部排序，由它边读边放宽键类型。
+pub struct TopNSource {
+    columns: Vec<String>,
+    schema: Schema,
+    input: Option<Box<dyn RowSource>>,
+    order_by: Vec<String>,
+    limit: usize,
+    budget: Arc<dyn MemoryBudget>,
+}
+
+impl TopNSource {
+    pub fn new(
+        input: Box<dyn RowSource>,
+        schema: Schema,
+        order_by: Vec<String>,
+        limit: usize,
+        budget: Arc<dyn MemoryBudget>,
+    ) -> Self {
+        Self {
+            columns: input.columns().to_vec(),
+            schema,
+            input: (limit > 0).then_some(input),
+            order_by,
+            limit,
+            budget,
+        }
+    }
+}
+
+#[async_trait]
+impl RowSource for TopNSource {
+    fn columns(&self) -> &[String] {
+        &self.columns
+    }
+
+    fn schema(&self) -> Option<Schema> {
+        Some(self.schema.clone())
+    }
+
+    async fn next_rows(&mut self) -> Result<Option<Vec<Vec<String>>>> {
+        let Some(mut input) = self.input.take() else { return Ok(None) };
+        let mut top: Option<RecordBatch> = None;
+        while let Some(rows) = input.next_rows().await? {
+            let chunk = RecordBatch::from_rows(self.schema.clone(), &rows)?;
+            let merged = match top.take() {
+                Some(top) => RecordBatch::concat(self.schema.clone(), &[top, chunk])?,
+                None => chunk,
+            };
+            top = Some(top_n_batch(&merged, &self.order_by, self.limit, self.budget.as_ref())?);
+        }
+        Ok(top.map(|top| top.into_query_result().rows).filter(|rows| !rows.is_empty()))
+    }
+}
+
+/// 取消句柄，可在其他任务中取消正在传输的结果集
+#[derive(Debug, Clone, Default)]
+pub struct CancelHandle {
+    state: Arc<CancelState>,
+}
+
+#[derive(Debug, Default)]
+struct CancelState {
+    cancelled: AtomicBool,
+    notify: Notify,
+}
+
+impl CancelHandle {
+    pub fn cancel(&self) {
+        self.state.cancelled.store(true, Ordering::Release);
+        self.state.notify.notify_waiters();
+    }
+
+    pub fn is_cancelled(&self) -> bool {
+        self.state.cancelled.load(Ordering::Acquire)
+    }
+
+    /// 等到被取消
+    pub async fn cancelled(&self) {
+        loop {
+            // 先登记再检查标志，避免错过检查与等待之间的取消
+            let notified = self.state.notify.notified();
+            if self.is_cancelled() {
+                return;
+            }
+            notified.await;
+        }
+    }
+}
+
+/// 拉取式结果集
+pub struct ResultStream {
+    columns: Vec<String>,
+    source: Option<Box<dyn RowSource>>,
+    cancel: CancelHandle,
+    affected_rows: u64,
+    rows_returned: u64,
+}
+
+impl ResultStream {
+    pub fn new(source: Box<dyn RowSource>) -> Self {
+        Self {
+            columns: source.columns().to_vec(),
+            source: Some(source),
+            cancel: CancelHandle::default(),
+            affected_rows: 0,
+            rows_returned: 0,
+        }
+    }
+
+    /// 包装已物化的结果 (写入语句、无法流式执行的计划)
+    pub fn from_result(result: QueryResult) -> Self {
+        let affected_rows = result.affected_rows;
+        let mut stream = Self::new(Box::new(MaterializedSource::new(result, DEFAULT_RESULT_CHUNK_ROWS)));
+        stream.affected_rows = affected_rows;
+        stream
+    }
+
+    pub fn columns(&self) -> &[String] {
+        &self.columns
+    }
+
+    pub fn affected_rows(&self) -> u64 {
+        self.affected_rows
+    }
+
+    /// 已交给消费者的行数
+    pub fn rows_returned(&self) -> u64 {
+        self.rows_returned
+    }
+
+    pub fn cancel_handle(&self) -> CancelHandle {
+        self.cancel.clone()
+    }
+
+    /// 换用调用方事先创建的取消句柄，使得结果集创建之前 (规划期间) 的取消同样生效
+    pub fn with_cancel_handle(mut self, cancel: CancelHandle) -> Self {
+        self.cancel = cancel;
+        self
+    }
+
+    /// 读取下一块行；被取消时丢弃算子链并返回错误
+    pub async fn next_rows(&mut self) -> Result<Option<Vec<Vec<String>>>> {
+        let Some(source) = self.source.as_mut() else { return Ok(None) };
+        let next = tokio::select! {
+            biased;
+            _ = self.cancel.cancelled() => None,
+            next = source.next_rows() => Some(next),
+        };
+        match next {
+            None => {
+                self.source = None;
+                Err(common::Error::Execution("query cancelled".to_string()))
+            }
+            Some(Ok(Some(rows))) => {
+                self.rows_returned += rows.len() as u64;
+                Ok(Some(rows))
+            }
+            Some(other) => {
+                self.source = None;
+                other
+            }
+        }
+    }
+
+    /// 读完剩余结果并物化，仅用于结果集确定较小的场景
+    pub async fn collect(mut self) -> Result<QueryResult> {
+        let mut rows = Vec::new();
+        while let Some(chunk) = self.next_rows().await? {
+            rows.extend(chunk);
+        }
+        Ok(QueryResult { columns: self.columns, rows, affected_rows: self.affected_rows, last_insert_id: None })
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::atomic::AtomicUsize;
+    use crate::executor::record_batch::Field;
+    use crate::storage::memory::MemoryManager;
+    use common::DataType;
+
+    /// 每块 10 行的无限数据源，记录被拉取的块数
+    struct CountingSource {
+        columns: Vec<String>,
+        next: u64,
+        pulls: Arc<AtomicUsize>,
+    }
+
+    #[async_trait]
+    impl RowSource for CountingSource {
+        fn columns(&self) -> &[String] {
+            &self.columns
+        }
+
+        async fn next_rows(&mut self) -> Result<Option<Vec<Vec<String>>>> {
+            self.pulls.fetch_add(1, Ordering::Relaxed);
+            let rows = (self.next..self.next + 10).map(|i| vec![i.to_string(), ((i * 7) % 100).to_string()]).collect();
+            self.next += 10;
+            tokio::task::yield_now().await;
+            Ok(Some(rows))
+        }
+    }
+
+    fn counting() -> (Box<dyn RowSource>, Arc<AtomicUsize>) {
+        let pulls = Arc::new(AtomicUsize::new(0));
+        let source = CountingSource { columns: vec!["id".to_string(), "v".to_string()], next: 0, pulls: pulls.clone() };
+        (Box::new(source), pulls)
+    }
+
+    #[tokio::test]
+    async fn test_limit_stops_pulling_upstream() {
+        let (source, pulls) = counting();
+        let stream = ResultStream::new(Box::new(LimitSource::new(source, 15, 12)));
+        let result = stream.collect().await.unwrap();
+        let ids: Vec<&str> = result.rows.iter().map(|row| row[0].as_str()).collect();
+        assert_eq!(ids.first(), Some(&"12"));
+        assert_eq!(ids.last(), Some(&"26"));
+        assert_eq!(ids.len(), 15);
+        // 上游无限，只拉取了凑满 offset + limit 所需的 3 块
+        assert_eq!(pulls.load(Ordering::Relaxed), 3);
+
+        let (source, pulls) = counting();
+        assert!(ResultStream::new(Box::new(LimitSource::new(source, 0, 0))).collect().await.unwrap().rows.is_empty());
+        assert_eq!(pulls.load(Ordering::Relaxed), 0);
+    }
+
+    #[tokio::test]
+    async fn test_top_n_merges_chunks_and_cancel_drops_source() {
+        let (source, _) = counting();
+        let limited = Box::new(LimitSource::new(source, 100, 0));
+        let schema = Schema::new(vec![Field::new("id", DataType::BigInt), Field::new("v", DataType::BigInt)]);
+        let top = TopNSource::new(limited, schema, vec!["v DESC".to_string(), "id".to_string()], 3, Arc::new(MemoryManager::new()));
+        let result = ResultStream::new(Box::new(top)).collect().await.unwrap();
+        let values: Vec<&str> = result.rows.iter().map(|row| row[1].as_str()).collect();
+        assert_eq!(values, vec!["99", "98", "97"]);
+
+        let (source, pulls) = counting();
+        let mut stream = ResultStream::new(source);
+        let cancel = stream.cancel_handle();
+        assert_eq!(stream.next_rows().await.unwrap().unwrap().len(), 10);
+        cancel.cancel();
+        assert!(stream.next_rows().await.is_err());
+        assert!(stream.next_rows().await.unwrap().is_none());
+        assert_eq!(pulls.load(Ordering::Relaxed), 1);
+        assert_eq!(stream.rows_returned(), 10);
+    }
+}
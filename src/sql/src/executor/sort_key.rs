@@ -0,0 +1,199 @@
+//! 归一化排序键
+//!
+//! 把一行在若干排序列上的值编码为一段字节串，使字节串的字典序与 SQL 排序语义
+//! 一致，排序与归并时只需 `memcmp`，不再逐列按类型分派比较：
+//!
+//! - 每列先写一个标记字节：NULL 为 0x00，非 NULL 为 0x01 (NULL 视为最小值)
+//! - 整数 (含 DATE/TIMESTAMP) 提升为 i64，翻转符号位后按大端写出
+//! - 浮点数按 IEEE 754 位模式变换为全序后大端写出 (与 `f64::total_cmp` 一致)
+//! - 字符串/二进制中的 0x00 转义为 0x00 0xFF，并以 0x00 0x00 结尾，保证无前缀冲突
+//! - 降序列把该列编码的所有字节取反
+//!
+//! 外部排序与 TopN 共用这里的编码。
+
+use common::{Error, Result};
+
+use crate::executor::record_batch::{ColumnData, RecordBatch, Schema};
+
+/// 单个排序列
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct SortColumn {
+    /// 列下标
+    pub column: usize,
+    pub descending: bool,
+}
+
+/// 解析 ORDER BY 列表，支持 `col`、`col ASC`、`col DESC`
+pub fn parse_order_by(order_by: &[String], schema: &Schema) -> Result<Vec<SortColumn>> {
+    order_by
+        .iter()
+        .map(|item| {
+            let mut parts = item.split_whitespace();
+            let name = parts.next().unwrap_or_default();
+            let descending = match parts.next().map(|d| d.to_lowercase()) {
+                None => false,
+                Some(d) if d == "asc" => false,
+                Some(d) if d == "desc" => true,
+                Some(d) => {
+                    return Err(Error::Execution(format!("invalid sort direction '{}' in '{}'", d, item)));
+                }
+            };
+            let column = schema
+                .index_of(name)
+                .ok_or_else(|| Error::Execution(format!("sort column '{}' not found", name)))?;
+            Ok(SortColumn { column, descending })
+        })
+        .collect()
+}
+
+/// 一批行的归一化键，全部存放在一块连续缓冲区中
+#[derive(Debug, Clone, Default)]
+pub struct NormalizedKeys {
+    data: Vec<u8>,
+    offsets: Vec<u32>,
+}
+
+impl NormalizedKeys {
+    /// 为批的指定物理行编码排序键
+    pub fn encode(batch: &RecordBatch, rows: &[usize], sort_columns: &[SortColumn]) -> Self {
+        let mut keys = NormalizedKeys {
+            data: Vec::with_capacity(rows.len() * sort_columns.len() * 9),
+            offsets: Vec::with_capacity(rows.len() + 1),
+        };
+        keys.offsets.push(0);
+        for &row in rows {
+            encode_row(batch, row, sort_columns, &mut keys.data);
+            keys.offsets.push(keys.data.len() as u32);
+        }
+        keys
+    }
+
+    pub fn len(&self) -> usize {
+        self.offsets.len() - 1
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    #[inline]
+    pub fn key(&self, index: usize) -> &[u8] {
+        &self.data[self.offsets[index] as usize..self.offsets[index + 1] as usize]
+    }
+
+    /// 键占用的字节数
+    pub fn memory_size(&self) -> usize {
+        self.data.len() + self.offsets.len() * 4
+    }
+
+    /// 返回按键升序排列的下标 (稳定排序，相等的键保持输入顺序)
+    pub fn sorted_indices(&self) -> Vec<usize> {
+        let mut indices: Vec<usize> = (0..self.len()).collect();
+        indices.sort_by(|&a, &b| self.key(a).cmp(self.key(b)));
+        indices
+    }
+}
+
+/// 把一行的排序键追加到 out
+pub fn encode_row(batch: &RecordBatch, row: usize, sort_columns: &[SortColumn], out: &mut Vec<u8>) {
+    for sort_column in sort_columns {
+        let start = out.len();
+        let column = batch.column(sort_column.column);
+        if column.is_null(row) {
+            out.push(0x00);
+        } else {
+            out.push(0x01);
+            match &column.data {
+                ColumnData::Boolean(v) => out.push(v[row] as u8),
+                ColumnData::Int32(v) => encode_i64(v[row] as i64, out),
+                ColumnData::Int64(v) => encode_i64(v[row], out),
+                ColumnData::Float32(v) => encode_f64(v[row] as f64, out),
+                ColumnData::Float64(v) => encode_f64(v[row], out),
+                ColumnData::Utf8(v) => encode_bytes(v[row].as_bytes(), out),
+                ColumnData::Binary(v) => encode_bytes(&v[row], out),
+            }
+        }
+        if sort_column.descending {
+            out[start..].iter_mut().for_each(|b| *b = !*b);
+        }
+    }
+}
+
+#[inline]
+fn encode_i64(value: i64, out: &mut Vec<u8>) {
+    out.extend_from_slice(&((value as u64) ^ (1 << 63)).to_be_bytes());
+}
+
+#[inline]
+fn encode_f64(value: f64, out: &mut Vec<u8>) {
+    let bits = value.to_bits();
+    let ordered = if bits >> 63 == 1 { !bits } else { bits ^ (1 << 63) };
+    out.extend_from_slice(&ordered.to_be_bytes());
+}
+
+fn encode_bytes(bytes: &[u8], out: &mut Vec<u8>) {
+    for &b in bytes {
+        out.push(b);
+        if b == 0x00 {
+            out.push(0xFF);
+        }
+    }
+    out.extend_from_slice(&[0x00, 0x00]);
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::executor::record_batch::{ColumnVector, Field};
+    use common::{DataType, Value};
+
+    fn batch() -> RecordBatch {
+        let mut score = ColumnVector::new(DataType::Double);
+        for v in [Some(-1.5), None, Some(2.0), Some(-0.0), Some(10.0)] {
+            match v {
+                Some(v) => score.push_value(&Value::Double(v)),
+                None => score.push_null(),
+            }
+        }
+        RecordBatch::try_new(
+            Schema::new(vec![
+                Field::new("id", DataType::BigInt),
+                Field::new("name", DataType::String),
+                Field::new("score", DataType::Double),
+            ]),
+            vec![
+                ColumnVector::from_i64(vec![-5, 3, 3, 100, 0]),
+                ColumnVector::from_strs(&["b", "a\0z", "a", "", "ab"]),
+                score,
+            ],
+        )
+        .unwrap()
+    }
+
+    fn order(batch: &RecordBatch, order_by: &[&str]) -> Vec<usize> {
+        let order_by: Vec<String> = order_by.iter().map(|s| s.to_string()).collect();
+        let columns = parse_order_by(&order_by, &batch.schema).unwrap();
+        NormalizedKeys::encode(batch, &batch.row_indices(), &columns).sorted_indices()
+    }
+
+    #[test]
+    fn test_keys_match_typed_order() {
+        let batch = batch();
+        assert_eq!(order(&batch, &["id"]), vec![0, 4, 1, 2, 3]);
+        assert_eq!(order(&batch, &["id DESC"]), vec![3, 1, 2, 4, 0]);
+        // 含 0x00 的字符串与前缀关系
+        assert_eq!(order(&batch, &["name"]), vec![3, 2, 1, 4, 0]);
+        // NULL 最小，降序时排在最后
+        assert_eq!(order(&batch, &["score"]), vec![1, 0, 3, 2, 4]);
+        assert_eq!(order(&batch, &["score desc"]), vec![4, 2, 3, 0, 1]);
+        // 多列：id 相同时按 name 降序
+        assert_eq!(order(&batch, &["id", "name DESC"]), vec![0, 4, 1, 2, 3]);
+    }
+
+    #[test]
+    fn test_parse_order_by_errors() {
+        let batch = batch();
+        assert!(parse_order_by(&["missing".to_string()], &batch.schema).is_err());
+        assert!(parse_order_by(&["id sideways".to_string()], &batch.schema).is_err());
+    }
+}
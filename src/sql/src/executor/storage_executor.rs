@@ -4,13 +4,47 @@
 
 
 use common::Result;
+use std::sync::Arc;
 use tracing::{debug, info};
 
 use crate::executor::execution_models::QueryResult;
 use crate::executor::executor::ExecutionContext;
-use crate::storage::handler::StorageHandler;
+use crate::executor::morsel::KeyRange;
+use crate::executor::operators::sort_operators::ExternalSortSource;
+use crate::executor::result_stream::{LimitSource, RowSource, TopNSource, DEFAULT_RESULT_CHUNK_ROWS};
+use crate::storage::cache_manager::CacheManager;
+use crate::optimizer::PlanNode;
+use crate::storage::handler::{StorageHandler, TableScanStream};
+use crate::storage::pushdown::CoprocessorPlan;
+use crate::storage::table_catalog::TableCatalog;
 use storage::EngineType;
 
+/// 流式排序的段缓冲上限
+const STREAM_SORT_MEMORY: usize = 4 * 1024 * 1024;
+
+/// 排序之上的 LIMIT 所需的前 `keep` 行
+///
+/// 输入声明了列类型 (按表定义扫描) 时用流式 TopN，只保留前 keep 行；否则列类型要边读边推断，
+/// 改用外部排序，由外层的 LIMIT 截断。
+pub(crate) fn open_top_n(
+    input: Box<dyn RowSource>,
+    order_by: &[String],
+    keep: usize,
+    context: &ExecutionContext,
+) -> Result<Box<dyn RowSource>> {
+    Ok(match input.schema() {
+        Some(schema) => Box::new(TopNSource::new(input, schema, order_by.to_vec(), keep, context.memory_budget())),
+        None => Box::new(ExternalSortSource::new(
+            input,
+            order_by.to_vec(),
+            context.memory_budget(),
+            STREAM_SORT_MEMORY,
+            std::env::temp_dir(),
+            DEFAULT_RESULT_CHUNK_ROWS,
+        )?),
+    })
+}
+
 /// 存储感知的执行器
 pub struct StorageExecutor {
     storage_handler: StorageHandler,
@@ -20,8 +54,10 @@ pub struct StorageExecutor {
 impl StorageExecutor {
     /// 创建新的存储感知执行器
     pub fn new() -> Self {
+        let mut storage_handler = StorageHandler::new();
+        storage_handler.set_default_engine(EngineType::Memory);
         Self {
-            storage_handler: StorageHandler::new(),
+            storage_handler,
             default_engine_type: EngineType::Memory, // 默认使用内存引擎
         }
     }
@@ -32,6 +68,21 @@ impl StorageExecutor {
         self.storage_handler.set_default_engine(engine_type);
     }
 
+    /// 使用独立的表结构目录 (默认使用进程级目录)
+    pub fn set_table_catalog(&mut self, catalog: Arc<TableCatalog>) {
+        self.storage_handler.set_table_catalog(catalog);
+    }
+
+    /// 底层的存储处理器
+    pub fn storage_handler(&self) -> &StorageHandler {
+        &self.storage_handler
+    }
+
+    /// 关联缓存管理器，写入会使对应表的结果缓存失效
+    pub fn set_cache_manager(&mut self, cache_manager: Arc<CacheManager>) {
+        self.storage_handler.set_cache_manager(cache_manager);
+    }
+
     /// 注册存储引擎
     pub async fn register_storage_engine(&self, engine_type: EngineType, config: storage::StorageConfig) -> Result<()> {
         self.storage_handler.register_engine(engine_type, config).await
@@ -53,6 +104,99 @@ impl StorageExecutor {
         debug!("表扫描完成: {} 行", result.rows.len());
         Ok(result)
     }
+    /// 打开流式表扫描，供需要逐页消费的算子使用，扫描走执行器的默认引擎
+    /// 打开流式表扫描，供需要逐页消费的算子使用
+    pub async fn open_table_scan(
+        &self,
+        table_name: &str,
+        columns: &[String],
+        limit: Option<u32>,
+        _context: &ExecutionContext,
+    ) -> Result<TableScanStream> {
+        let engine_type = self.default_engine_type;
+        self.storage_handler.scan_table_stream(table_name, columns, limit, Some(engine_type)).await
+    }
+
+    /// 打开表中一段行键范围的流式扫描，并行执行器按 morsel 调用
+    pub async fn open_range_scan(
+        &self,
+        table_name: &str,
+        range: &KeyRange,
+        columns: &[String],
+        _context: &ExecutionContext,
+    ) -> Result<TableScanStream> {
+        let engine_type = self.default_engine_type;
+        self.storage_handler
+            .scan_range_stream(table_name, range.start.clone().into(), range.end.clone().into(), columns, Some(engine_type))
+            .await
+    }
+
+    /// 为计划打开流式结果源，计划无法流式执行时返回 `None`
+    ///
+    /// 支持表扫描、排序 (表扫描)、LIMIT (表扫描) 与 LIMIT (排序 (表扫描))。LIMIT 直接在
+    /// 表扫描上时把 limit + offset 也交给存储层的流式扫描；排序之上的 LIMIT 改为流式 TopN；
+    /// 单独的排序走外部排序，超出预算的部分落盘，结果逐帧交出。排序与 TopN 的额度
+    /// 来自 `context.memory_budget()`，由结果源持有到流结束。
+    pub async fn open_plan_stream(
+        &self,
+        node: &PlanNode,
+        context: &ExecutionContext,
+    ) -> Result<Option<Box<dyn RowSource>>> {
+        let source: Box<dyn RowSource> = match node {
+            PlanNode::TableScan { table, columns } => Box::new(self.open_table_scan(table, columns, None, context).await?),
+            PlanNode::Limit { input, limit, offset } => {
+                let keep = limit.saturating_add(*offset);
+                let input: Box<dyn RowSource> = match input.as_ref() {
+                    PlanNode::TableScan { table, columns } => {
+                        let scan_limit = u32::try_from(keep).unwrap_or(u32::MAX);
+                        Box::new(self.open_table_scan(table, columns, Some(scan_limit), context).await?)
+                    }
+                    PlanNode::Sort { input, order_by } => {
+                        let PlanNode::TableScan { table, columns } = input.as_ref() else { return Ok(None) };
+                        let scan = self.open_table_scan(table, columns, None, context).await?;
+                        let keep = usize::try_from(keep).unwrap_or(usize::MAX);
+                        open_top_n(Box::new(scan), order_by, keep, context)?
+                    }
+                    _ => return Ok(None),
+                };
+                Box::new(LimitSource::new(input, *limit, *offset))
+            }
+            PlanNode::Sort { input, order_by } => {
+                let PlanNode::TableScan { table, columns } = input.as_ref() else { return Ok(None) };
+                let scan = self.open_table_scan(table, columns, None, context).await?;
+                Box::new(ExternalSortSource::new(
+                    Box::new(scan),
+                    order_by.clone(),
+                    context.memory_budget(),
+                    STREAM_SORT_MEMORY,
+                    std::env::temp_dir(),
+                    DEFAULT_RESULT_CHUNK_ROWS,
+                )?)
+            }
+            _ => return Ok(None),
+        };
+        Ok(Some(source))
+    }
+
+    /// 尝试把以表扫描为叶子的计划片段下推到存储端执行
+    ///
+    /// 片段中含有无法下推的算子或表达式时返回 `None`，由调用方按常规路径执行。
+    pub async fn execute_pushdown(
+        &self,
+        node: &PlanNode,
+        _context: &ExecutionContext,
+    ) -> Result<Option<QueryResult>> {
+        let Some(plan) = CoprocessorPlan::from_plan(node, self.storage_handler.table_catalog()) else {
+            return Ok(None);
+        };
+        info!("下推执行: {}", plan.table);
+
+        let engine_type = self.default_engine_type;
+        let result = self.storage_handler.scan_table_with_pushdown(&plan, Some(engine_type)).await?;
+
+        debug!("下推执行完成: {} 行", result.rows.len());
+        Ok(Some(result))
+    }
 
     /// 执行点查询
     pub async fn execute_point_query(
@@ -236,4 +380,40 @@ pub struct StorageOperationResult {
     pub success: bool,
     pub affected_rows: u64,
     pub error: Option<String>,
-}
\ No newline at end of file
+}
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::storage::table_catalog::TableColumn;
+    use common::DataType;
+    use storage::codec::Datum;
+
+    async fn drain(mut source: Box<dyn RowSource>) -> Vec<Vec<String>> {
+        let mut rows = Vec::new();
+        while let Some(chunk) = source.next_rows().await.unwrap() {
+            rows.extend(chunk);
+        }
+        rows
+    }
+
+    #[tokio::test]
+    async fn test_top_n_compares_by_table_column_types() {
+        let catalog = Arc::new(TableCatalog::new());
+        catalog.register("codes", vec![TableColumn::new("id", 1, DataType::BigInt), TableColumn::new("code", 2, DataType::String)]);
+        let mut storage = StorageExecutor::new();
+        storage.set_table_catalog(catalog);
+        for (id, code) in [(1, "9"), (2, "10"), (3, "100")] {
+            let columns = [(1, Datum::Int(id)), (2, Datum::Bytes(code.as_bytes().to_vec()))];
+            storage.storage_handler().insert_record("codes", &[Datum::Int(id)], &columns, None).await.unwrap();
+        }
+
+        // code 是字符串列，即使值都像数字也按字典序比较
+        let context = ExecutionContext::default();
+        let scan = PlanNode::TableScan { table: "codes".to_string(), columns: vec!["code".to_string()] };
+        let sort = PlanNode::Sort { input: Box::new(scan), order_by: vec!["code".to_string()] };
+        let node = PlanNode::Limit { input: Box::new(sort), limit: 2, offset: 0 };
+        let source = storage.open_plan_stream(&node, &context).await.unwrap().unwrap();
+        assert_eq!(source.schema().unwrap().fields[0].data_type, DataType::String);
+        assert_eq!(drain(source).await, vec![vec!["10".to_string()], vec!["100".to_string()]]);
+    }
+}
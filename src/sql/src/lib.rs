@@ -9,6 +9,7 @@ pub mod executor;
 pub mod storage;
 pub mod distributed;
 pub mod config;
+pub mod metrics;
 
 // 重新导出主要类型
 pub use parser::{SqlParser, ParsedStatement, ParsedExpression};
@@ -21,8 +22,15 @@ pub use distributed::{DistributedExecutor, NodeManager};
 pub use config::*;
 
 use common::Result;
+use std::sync::Arc;
 use tracing::{debug, info, warn};
 
+use optimizer::plan_cache::{self, PreparedStatement};
+use optimizer::StatisticsManager;
+use parser::ParsedValue;
+use executor::{ResultStream, StorageExecutor};
+use storage::cache_manager::CacheManager;
+
 /// SealDB SQL 引擎
 ///
 /// 协调整个 SQL 处理流程：解析 -> 规划 -> 优化 -> 执行
@@ -31,22 +39,133 @@ pub struct SqlEngine {
     planner: RuleBasedPlanner,
     optimizer: Optimizer,
     executor: Executor,
+    /// 按执行模型分派的执行引擎，EXPLAIN ANALYZE 通过它收集算子画像
+    /// 计划缓存 (与执行器共享)
+    cache_manager: Arc<CacheManager>,
+    /// 统计信息，版本变化时缓存的计划失效
+    statistics: Arc<tokio::sync::RwLock<StatisticsManager>>,
+    /// 存储感知执行器，设置后可流式执行的计划直接从存储层逐页拉取
+    storage_executor: Option<Arc<StorageExecutor>>,
+    /// 后台自动 ANALYZE 任务，设置存储感知执行器后启动
+    auto_analyze: Option<tokio::task::JoinHandle<()>>,
 }
 
 impl SqlEngine {
     /// 创建新的 SQL 引擎实例
     pub fn new() -> Self {
+        let executor = Executor::new();
         Self {
             parser: SqlParser::new(),
             planner: RuleBasedPlanner::new(),
             optimizer: Optimizer::new(),
-            executor: Executor::new(),
+            cache_manager: executor.cache_manager(),
+            executor,
+            statistics: Arc::new(tokio::sync::RwLock::new(StatisticsManager::new())),
+            storage_executor: None,
+            auto_analyze: None,
         }
     }
 
-        /// 执行 SQL 查询
+    /// 设置存储感知执行器，`execute_query_stream` 据此流式执行扫描类计划
     ///
-    /// 完整的处理流程：
+    /// 执行器与引擎共用缓存管理器，经它写入的表会使引擎中依赖该表的结果缓存失效；
+    /// 查询执行器的并行扫描也经它读取存储。在 tokio 运行时中调用时，以默认配置
+    /// 启动后台自动 ANALYZE，从该执行器采样。
+    pub fn set_storage_executor(&mut self, mut storage_executor: StorageExecutor) {
+        storage_executor.set_cache_manager(self.cache_manager.clone());
+        let storage_executor = Arc::new(storage_executor);
+        self.executor.set_storage_executor(storage_executor.clone());
+        self.storage_executor = Some(storage_executor);
+        if tokio::runtime::Handle::try_current().is_ok() {
+            self.start_auto_analyze(optimizer::AutoAnalyzeConfig::default());
+        }
+    }
+
+    /// 以给定配置 (重新) 启动后台自动 ANALYZE；未设置存储感知执行器时不启动
+    pub fn start_auto_analyze(&mut self, config: optimizer::AutoAnalyzeConfig) -> bool {
+        let Some(storage_executor) = self.storage_executor.clone() else {
+            return false;
+        };
+        if let Some(previous) = self.auto_analyze.take() {
+            previous.abort();
+        }
+        let source: Arc<dyn optimizer::AnalyzeSource> = storage_executor;
+        self.auto_analyze = Some(optimizer::AutoAnalyzer::spawn(self.statistics.clone(), source, config));
+        true
+    }
+
+    /// 已设置的存储感知执行器
+    pub fn storage_executor(&self) -> Option<&Arc<StorageExecutor>> {
+        self.storage_executor.as_ref()
+    }
+
+    /// `/metrics` 导出的组件指标：执行器各组件的统计与缓存计数
+    pub fn metrics_sources(&self) -> Vec<Arc<dyn metrics::MetricsSource>> {
+        vec![self.executor.metrics_source(), self.cache_manager.clone()]
+    }
+
+    /// 计划缓存所在的缓存管理器
+    pub fn cache_manager(&self) -> &Arc<CacheManager> {
+        &self.cache_manager
+    }
+
+    /// 分析表统计信息；统计显著漂移时依赖该表的缓存计划会失效
+    pub async fn analyze_table(&self, table_name: &str) -> Result<()> {
+        self.statistics.write().await.analyze_table(table_name).await
+    }
+
+    /// 从数据源采样分析表的指定列
+    pub async fn analyze_table_columns(
+        &self,
+        source: &dyn optimizer::AnalyzeSource,
+        table_name: &str,
+        columns: &[String],
+    ) -> Result<()> {
+        let config = optimizer::AnalyzeConfig::default();
+        // 扫描期间不持有写锁
+        let modified_at_start = self.statistics.read().await.modified_rows(table_name);
+        let analysis = optimizer::analyze::analyze_table(source, table_name, columns, &config).await?;
+        self.statistics.write().await.apply_analysis(columns, analysis, modified_at_start).await;
+        Ok(())
+    }
+
+    /// 更新表统计信息
+    pub async fn update_table_statistics(&self, table_name: &str, stats: optimizer::TableStatistics) {
+        self.statistics.write().await.update_table_statistics(table_name, stats).await;
+    }
+
+    /// 查找统计版本仍然有效的缓存计划
+    async fn lookup_plan(&self, key: &str) -> Option<OptimizedPlan> {
+        let statistics = self.statistics.read().await;
+        self.cache_manager
+            .get_current_plan(key, |table| statistics.table_epoch(table))
+            .map(|cached| cached.plan)
+    }
+
+    /// 优化语句并以当前统计版本缓存计划
+    async fn optimize_and_cache(&self, key: &str, stmt: ParsedStatement) -> Result<OptimizedPlan> {
+        let plan = {
+            let statistics = self.statistics.read().await;
+            self.optimizer.optimize_with_statistics(stmt, &statistics).await?
+        };
+        let table_epochs = {
+            let statistics = self.statistics.read().await;
+            plan_cache::plan_tables(&plan)
+                .into_iter()
+                .map(|table| {
+                    let epoch = statistics.table_epoch(&table);
+                    (table, epoch)
+                })
+                .collect()
+        };
+        self.cache_manager.cache_plan_with_epochs(key, plan.clone(), table_epochs)?;
+        Ok(plan)
+    }
+
+    /// 执行 SQL 查询
+    ///
+    /// 先按 SQL 指纹查计划缓存，命中时直接把字面量绑定到计划模板，跳过解析和优化。
+    /// 未命中时的完整处理流程：
     /// 1. 解析 SQL 语句
     /// 2. 基于规则的优化 (RBO)
     /// 3. 基于成本的优化 (CBO)
@@ -54,6 +173,66 @@ impl SqlEngine {
     pub async fn execute_query(&self, sql: &str) -> Result<QueryResult> {
         info!("开始执行 SQL 查询: {}", sql);
 
+        if let Some(query) = strip_explain_analyze(sql) {
+            return self.explain_analyze(query).await;
+        }
+
+        let plan = self.resolve_plan(sql).await?;
+        info!("=== 步骤 4: 执行查询计划 ===");
+        self.execute_plan(plan, sql).await
+    }
+
+    /// 执行 SQL 查询并以流的形式返回结果
+    ///
+    /// 配置了存储感知执行器且计划可以流式执行时 (表扫描、LIMIT、排序之上的 LIMIT)，
+    /// 结果随消费逐块从存储层拉取，首行不必等整个结果集；LIMIT 凑满或调用方取消后
+    /// 存储层扫描随之停止。其余计划先物化再按块交出。
+    pub async fn execute_query_stream(&self, sql: &str) -> Result<ResultStream> {
+        info!("开始流式执行 SQL 查询: {}", sql);
+
+        if let Some(query) = strip_explain_analyze(sql) {
+            let result = self.explain_analyze(query).await?;
+            return Ok(ResultStream::from_result(executor::execution_models::QueryResult {
+                columns: result.columns,
+                rows: result.rows,
+                affected_rows: 0,
+                last_insert_id: None,
+            }));
+        }
+
+        let plan = self.resolve_plan(sql).await?;
+        if let (Some(storage_executor), [root]) = (&self.storage_executor, plan.nodes.as_slice()) {
+            let context = self.executor.query_context();
+            if let Some(source) = storage_executor.open_plan_stream(root, &context).await? {
+                debug!("流式执行计划: {:?}", root);
+                return Ok(ResultStream::new(source));
+            }
+        }
+
+        let executor_result = self.run_plan(plan, sql).await?;
+        Ok(ResultStream::from_result(executor::execution_models::QueryResult {
+            columns: executor_result.columns,
+            rows: executor_result.rows,
+            affected_rows: executor_result.affected_rows,
+            last_insert_id: executor_result.last_insert_id,
+        }))
+    }
+
+    /// 取得 SQL 的优化计划：先查计划缓存，未命中时解析、优化并缓存
+    async fn resolve_plan(&self, sql: &str) -> Result<OptimizedPlan> {
+        let fingerprint = plan_cache::fingerprint_sql(sql);
+        let parameterized_key = fingerprint.cache_key();
+        let exact_key = format!("sql-exact:{}", sql.trim());
+
+        let cached_plan = match self.lookup_plan(&parameterized_key).await {
+            Some(plan) => Some(plan_cache::bind_plan(&plan, &fingerprint.literals)?),
+            None => self.lookup_plan(&exact_key).await,
+        };
+        if let Some(plan) = cached_plan {
+            debug!("计划缓存命中: {}", fingerprint.normalized);
+            return Ok(plan);
+        }
+
         // 1. 解析 SQL 语句
         info!("=== 步骤 1: SQL 解析 ===");
         let parsed_stmt = self.parser.parse(sql).map_err(|e| common::Error::Internal(e.to_string()))?;
@@ -72,13 +251,60 @@ impl SqlEngine {
         debug!("RBO 优化后计划: {:?}", rbo_plan);
 
         // 3. 基于成本的优化 (CBO)
+        // 语句树中的字面量序列与文本中的完全相同时才缓存参数化的计划模板，命中时按文本
+        // 字面量绑定；否则 (例如有字面量没有进入语句树) 只能按原始文本缓存
         info!("=== 步骤 3: 基于成本的优化 (CBO) ===");
-        let optimized_plan = self.optimizer.optimize(parsed_stmt).await?;
+        let (template, literals) = plan_cache::parameterize_statement(parsed_stmt.clone());
+        let optimized_plan = if fingerprint.placeholders == 0 && literals == fingerprint.literals {
+            let plan = self.optimize_and_cache(&parameterized_key, template).await?;
+            plan_cache::bind_plan(&plan, &literals)?
+        } else {
+            self.optimize_and_cache(&exact_key, parsed_stmt).await?
+        };
         debug!("CBO 优化后计划: {:?}", optimized_plan);
+        Ok(optimized_plan)
+    }
 
-        // 4. 执行查询计划
-        info!("=== 步骤 4: 执行查询计划 ===");
-        let executor_result = self.executor.execute(optimized_plan).await?;
+    /// 预编译语句：解析、优化一次，之后通过 `execute_prepared` 绑定参数执行
+    ///
+    /// 参数用 `?` 或 `$n` 占位。
+    pub async fn prepare(&self, sql: &str) -> Result<PreparedStatement> {
+        info!("预编译 SQL 语句: {}", sql);
+        let fingerprint = plan_cache::fingerprint_sql(sql);
+        let statement = self.parser.parse(sql).map_err(|e| common::Error::Internal(e.to_string()))?;
+        let cache_key = format!("prepared:{}", sql.trim());
+        self.optimize_and_cache(&cache_key, statement.clone()).await?;
+
+        Ok(PreparedStatement {
+            sql: sql.to_string(),
+            cache_key,
+            statement,
+            parameter_count: fingerprint.placeholders,
+        })
+    }
+
+    /// 绑定参数并执行预编译语句；计划被淘汰或统计漂移时从保存的语句重新优化
+    pub async fn execute_prepared(&self, prepared: &PreparedStatement, parameters: &[ParsedValue]) -> Result<QueryResult> {
+        if parameters.len() != prepared.parameter_count {
+            return Err(common::Error::Execution(format!(
+                "prepared statement expects {} parameters, got {}",
+                prepared.parameter_count,
+                parameters.len()
+            )));
+        }
+        let plan = match self.lookup_plan(&prepared.cache_key).await {
+            Some(plan) => plan,
+            None => {
+                debug!("预编译语句的计划失效，重新优化: {}", prepared.sql);
+                self.optimize_and_cache(&prepared.cache_key, prepared.statement.clone()).await?
+            }
+        };
+        let plan = plan_cache::bind_plan(&plan, parameters)?;
+        self.execute_plan(plan, &prepared.sql).await
+    }
+
+    async fn execute_plan(&self, plan: OptimizedPlan, sql: &str) -> Result<QueryResult> {
+        let executor_result = self.run_plan(plan, sql).await?;
 
         // 转换为我们的 QueryResult 类型
         let result = QueryResult::new(
@@ -92,6 +318,29 @@ impl SqlEngine {
         Ok(result)
     }
 
+    async fn run_plan(&self, plan: OptimizedPlan, sql: &str) -> Result<executor::executor::QueryResult> {
+        let executor_result = self.executor.execute(plan).await?;
+
+        // 写入语句累计修改行数，后台自动 ANALYZE 据此决定是否刷新统计信息；
+        // 写入计划中的表名是规划时的占位名，目标表从语句本身取
+        if executor_result.affected_rows > 0 {
+            if let Some(table) = write_target(sql) {
+                self.statistics.write().await.record_modifications(&table, executor_result.affected_rows as u64);
+            }
+        }
+        Ok(executor_result)
+    }
+
+    /// 执行查询并返回各算子的运行时画像 (EXPLAIN ANALYZE)，结果集为单列 `QUERY PLAN`
+    ///
+    /// 计划与 `execute_query` 相同，在同一个执行器上执行。
+    pub async fn explain_analyze(&self, sql: &str) -> Result<QueryResult> {
+        let plan = self.resolve_plan(sql).await?;
+        let (_, profile) = self.executor.explain_analyze(plan).await?;
+        let (columns, rows) = profile.into_rows();
+        Ok(QueryResult::new(rows, columns, profile.total_time.as_millis() as u64))
+    }
+
     /// 只进行解析和规划，不执行
     pub async fn plan_query(&self, sql: &str) -> Result<QueryPlan> {
         info!("开始规划 SQL 查询: {}", sql);
@@ -123,13 +372,54 @@ impl SqlEngine {
         debug!("解析结果: {:?}", parsed_stmt);
 
         // 2. 基于成本的优化 (CBO)
-        let optimized_plan = self.optimizer.optimize(parsed_stmt).await?;
+        let optimized_plan = {
+            let statistics = self.statistics.read().await;
+            self.optimizer.optimize_with_statistics(parsed_stmt, &statistics).await?
+        };
         debug!("优化结果: {:?}", optimized_plan);
 
         Ok(optimized_plan)
     }
 }
 
+/// `EXPLAIN ANALYZE <query>` 返回其中的查询语句
+fn strip_explain_analyze(sql: &str) -> Option<&str> {
+    fn keyword<'a>(input: &'a str, word: &str) -> Option<&'a str> {
+        let input = input.trim_start();
+        let (head, rest) = input.split_at(input.find(char::is_whitespace)?);
+        head.eq_ignore_ascii_case(word).then(|| rest.trim_start())
+    }
+    keyword(keyword(sql, "explain")?, "analyze")
+}
+
+/// 写入语句 (`INSERT INTO t`、`UPDATE t`、`DELETE FROM t`) 的目标表
+fn write_target(sql: &str) -> Option<String> {
+    let mut words = sql.split_whitespace();
+    let first = words.next()?;
+    let table = if first.eq_ignore_ascii_case("update") {
+        words.next()?
+    } else if first.eq_ignore_ascii_case("insert") || first.eq_ignore_ascii_case("delete") {
+        let into = if first.eq_ignore_ascii_case("insert") { "into" } else { "from" };
+        if !words.next()?.eq_ignore_ascii_case(into) {
+            return None;
+        }
+        words.next()?
+    } else {
+        return None;
+    };
+    // `INSERT INTO t(a, b)` 的列清单可能紧跟表名
+    let table = table.split('(').next().unwrap_or(table).trim_matches(|c| c == '`' || c == '"');
+    (!table.is_empty()).then(|| table.to_string())
+}
+
+impl Drop for SqlEngine {
+    fn drop(&mut self) {
+        if let Some(auto_analyze) = self.auto_analyze.take() {
+            auto_analyze.abort();
+        }
+    }
+}
+
 /// 查询结果
 #[derive(Debug, Clone)]
 pub struct QueryResult {
@@ -161,6 +451,99 @@ pub use optimizer::optimizer::OptimizedPlan;
 mod tests {
     use super::*;
 
+    #[tokio::test]
+    async fn test_execute_query_reuses_cached_plan() {
+        let engine = SqlEngine::new();
+        engine.execute_query("SELECT id, name FROM users").await.unwrap();
+        // 大小写与空白不同的同一语句命中缓存
+        engine.execute_query("select id,  name\nfrom users").await.unwrap();
+
+        let stats = engine.cache_manager().get_stats();
+        assert_eq!(stats.plan_cache_hits, 1);
+        assert_eq!(stats.plan_cache_entries, 1);
+    }
+
+    #[tokio::test]
+    async fn test_explain_analyze_returns_profile_rows() {
+        let mut engine = SqlEngine::new();
+        engine.set_storage_executor(StorageExecutor::new());
+        let sql = "SELECT id, name FROM users";
+        // 解析器尚未记录表名，扫描的是计划中的占位表
+        let plan = engine.resolve_plan(sql).await.unwrap();
+        let optimizer::PlanNode::TableScan { table, .. } = &plan.nodes[0] else { panic!("unexpected plan {:?}", plan.nodes) };
+        let context = executor::executor::ExecutionContext::default();
+        for (key, name) in [("1", "alice"), ("2", "bob"), ("3", "carol")] {
+            engine.storage_executor().unwrap().execute_insert(table, key, name, &context).await.unwrap();
+        }
+
+        let before = metrics::global().query_latency("parallel").count;
+        let result = engine.execute_query(&format!("explain  ANALYZE {}", sql)).await.unwrap();
+        assert_eq!(result.columns, vec!["QUERY PLAN"]);
+        // 画像来自执行普通查询的同一个执行器与存储
+        assert!(result.rows[0][0].starts_with(&format!("TableScan ({})  rows_in=0 rows_out=3", table)));
+        assert!(result.rows.last().unwrap()[0].starts_with("Execution: model=parallel"));
+        assert!(metrics::global().query_latency("parallel").count > before);
+        assert_eq!(strip_explain_analyze("EXPLAIN SELECT 1"), None);
+    }
+
+    #[test]
+    fn test_write_target_uses_statement_table() {
+        assert_eq!(write_target("INSERT INTO orders(id, kind) VALUES (1, 2)").as_deref(), Some("orders"));
+        assert_eq!(write_target("update `orders` SET kind = 3").as_deref(), Some("orders"));
+        assert_eq!(write_target("DELETE FROM orders WHERE id = 1").as_deref(), Some("orders"));
+        assert_eq!(write_target("SELECT * FROM orders"), None);
+    }
+
+    #[tokio::test]
+    async fn test_prepared_statement_and_stats_drift() {
+        let engine = SqlEngine::new();
+        let prepared = engine.prepare("SELECT id FROM users WHERE id = ?").await.unwrap();
+        assert_eq!(prepared.parameter_count, 1);
+
+        let param = [ParsedValue::Number("1".to_string())];
+        engine.execute_prepared(&prepared, &param).await.unwrap();
+        assert!(engine.execute_prepared(&prepared, &[]).await.is_err());
+        assert_eq!(engine.cache_manager().get_stats().plan_cache_hits, 1);
+
+        // 统计信息漂移后计划失效并重新优化
+        for table in plan_cache::plan_tables(&engine.optimize_query(&prepared.sql).await.unwrap()) {
+            engine.analyze_table(&table).await.unwrap();
+        }
+        engine.execute_prepared(&prepared, &param).await.unwrap();
+        let stats = engine.cache_manager().get_stats();
+        assert_eq!(stats.plan_cache_invalidations, 1);
+        engine.execute_prepared(&prepared, &param).await.unwrap();
+        assert_eq!(engine.cache_manager().get_stats().plan_cache_hits, 2);
+    }
+
+    #[tokio::test]
+    async fn test_stream_matches_materialized_result() {
+        let engine = SqlEngine::new();
+        let sql = "SELECT id, name FROM users";
+        let materialized = engine.execute_query(sql).await.unwrap();
+        let streamed = engine.execute_query_stream(sql).await.unwrap().collect().await.unwrap();
+        assert_eq!(streamed.columns, materialized.columns);
+        assert_eq!(streamed.rows, materialized.rows);
+
+        let explain = engine.execute_query_stream("EXPLAIN ANALYZE SELECT id FROM users").await.unwrap();
+        assert_eq!(explain.columns(), ["QUERY PLAN"]);
+    }
+
+    #[tokio::test]
+    async fn test_storage_writes_invalidate_engine_result_cache() {
+        let mut engine = SqlEngine::new();
+        engine.set_storage_executor(StorageExecutor::new());
+        assert!(engine.auto_analyze.is_some());
+        let cached = executor::execution_models::QueryResult::new();
+        engine.cache_manager().cache_result_for_tables("users-all", cached, &["users".to_string()]).unwrap();
+        assert!(engine.cache_manager().get_cached_result("users-all").is_some());
+
+        let storage_executor = engine.storage_executor().unwrap();
+        let context = executor::executor::ExecutionContext::default();
+        storage_executor.execute_insert("users", "1", "alice", &context).await.unwrap();
+        assert!(engine.cache_manager().get_cached_result("users-all").is_none());
+    }
+
     #[tokio::test]
     async fn test_sql_engine_creation() {
         let engine = SqlEngine::new();
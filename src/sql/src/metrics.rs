@@ -0,0 +1,418 @@
+//! 引擎指标与 Prometheus 导出
+//!
+//! 热路径上的计数全部是无锁的：直方图按线程分条 (每个线程固定写自己的条带，
+//! 条带按缓存行对齐)，导出时再把各条带相加。标签集合在编译期确定 (执行模型、
+//! 存储引擎 × 操作)，记录时只做数组下标，不查表也不分配。
+//!
+//! 执行器、缓存等组件各自维护的统计通过 `MetricsSource` 接入，导出时追加在引擎级
+//! 指标之后。`serve_metrics` 在给定端口上提供 `GET /metrics`，服务端在
+//! `ServerConfig::http_port` 上启动它，与 `monitoring/prometheus.yml` 中 `sealdb`
+//! 任务的抓取地址对应。
+
+use std::cell::Cell;
+use std::fmt::Write as _;
+use std::sync::atomic::{AtomicU64, AtomicUsize, Ordering};
+use std::sync::{Arc, OnceLock};
+use std::time::Duration;
+
+use ::storage::EngineType;
+use tokio::io::{AsyncReadExt, AsyncWriteExt};
+use tokio::net::TcpListener;
+use tracing::{debug, warn};
+
+use crate::storage::cache_manager::CacheManager;
+
+/// 延迟直方图的桶上界 (秒)
+pub const LATENCY_BUCKETS: [f64; 14] = [
+    0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 5.0,
+];
+
+const STRIPES: usize = 16;
+const BUCKETS: usize = LATENCY_BUCKETS.len() + 1;
+
+thread_local! {
+    /// 当前线程写入的条带
+    static STRIPE: Cell<usize> = const { Cell::new(usize::MAX) };
+}
+
+static NEXT_STRIPE: AtomicUsize = AtomicUsize::new(0);
+
+fn stripe_index() -> usize {
+    STRIPE.with(|stripe| {
+        let mut index = stripe.get();
+        if index == usize::MAX {
+            index = NEXT_STRIPE.fetch_add(1, Ordering::Relaxed) % STRIPES;
+            stripe.set(index);
+        }
+        index
+    })
+}
+
+#[repr(align(64))]
+#[derive(Default)]
+struct Stripe {
+    buckets: [AtomicU64; BUCKETS],
+    sum_nanos: AtomicU64,
+}
+
+/// 按线程分条的延迟直方图
+pub struct Histogram {
+    stripes: Box<[Stripe]>,
+}
+
+impl Default for Histogram {
+    fn default() -> Self {
+        Self { stripes: (0..STRIPES).map(|_| Stripe::default()).collect() }
+    }
+}
+
+impl std::fmt::Debug for Histogram {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        let snapshot = self.snapshot();
+        f.debug_struct("Histogram").field("count", &snapshot.count).field("sum", &snapshot.sum).finish()
+    }
+}
+
+/// 直方图快照：各桶 (非累计) 计数、总数与总和 (秒)
+#[derive(Debug, Clone, PartialEq)]
+pub struct HistogramSnapshot {
+    pub buckets: Vec<u64>,
+    pub count: u64,
+    pub sum: f64,
+}
+
+impl Histogram {
+    pub fn observe(&self, elapsed: Duration) {
+        let seconds = elapsed.as_secs_f64();
+        let bucket = LATENCY_BUCKETS.iter().position(|&bound| seconds <= bound).unwrap_or(LATENCY_BUCKETS.len());
+        let stripe = &self.stripes[stripe_index()];
+        stripe.buckets[bucket].fetch_add(1, Ordering::Relaxed);
+        stripe.sum_nanos.fetch_add(elapsed.as_nanos().min(u64::MAX as u128) as u64, Ordering::Relaxed);
+    }
+
+    pub fn snapshot(&self) -> HistogramSnapshot {
+        let mut buckets = vec![0u64; BUCKETS];
+        let mut sum_nanos = 0u64;
+        for stripe in self.stripes.iter() {
+            for (total, bucket) in buckets.iter_mut().zip(stripe.buckets.iter()) {
+                *total += bucket.load(Ordering::Relaxed);
+            }
+            sum_nanos = sum_nanos.wrapping_add(stripe.sum_nanos.load(Ordering::Relaxed));
+        }
+        HistogramSnapshot {
+            count: buckets.iter().sum(),
+            buckets,
+            sum: sum_nanos as f64 / 1e9,
+        }
+    }
+}
+
+/// 查询延迟的执行模型标签，`parallel` 为 `Executor` 的并行查询路径
+pub const QUERY_MODELS: [&str; 5] = ["volcano", "pipeline", "vectorized", "mpp", "parallel"];
+
+/// 存储引擎标签
+pub const STORAGE_ENGINES: [&str; 5] = ["tikv", "rocksdb", "mysql", "postgresql", "memory"];
+
+/// 存储 RPC 的操作标签
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum StorageOp {
+    Get,
+    Put,
+    Delete,
+    Scan,
+    Coprocessor,
+}
+
+impl StorageOp {
+    pub const ALL: [StorageOp; 5] = [StorageOp::Get, StorageOp::Put, StorageOp::Delete, StorageOp::Scan, StorageOp::Coprocessor];
+
+    pub fn label(self) -> &'static str {
+        match self {
+            StorageOp::Get => "get",
+            StorageOp::Put => "put",
+            StorageOp::Delete => "delete",
+            StorageOp::Scan => "scan",
+            StorageOp::Coprocessor => "coprocessor",
+        }
+    }
+}
+
+fn engine_index(engine: EngineType) -> usize {
+    match engine {
+        EngineType::TiKV => 0,
+        EngineType::RocksDB => 1,
+        EngineType::MySQL => 2,
+        EngineType::PostgreSQL => 3,
+        EngineType::Memory => 4,
+    }
+}
+
+/// 引擎级指标
+#[derive(Debug, Default)]
+pub struct EngineMetrics {
+    query_latency: [Histogram; QUERY_MODELS.len()],
+    query_errors: [AtomicU64; QUERY_MODELS.len()],
+    storage_latency: [[Histogram; StorageOp::ALL.len()]; STORAGE_ENGINES.len()],
+    storage_errors: [[AtomicU64; StorageOp::ALL.len()]; STORAGE_ENGINES.len()],
+    spilled_bytes: AtomicU64,
+}
+
+impl EngineMetrics {
+    fn model_index(model: &str) -> usize {
+        QUERY_MODELS.iter().position(|&m| m == model).unwrap_or(QUERY_MODELS.len() - 1)
+    }
+
+    /// 记录一次查询的执行时间
+    pub fn record_query(&self, model: &str, elapsed: Duration, ok: bool) {
+        let index = Self::model_index(model);
+        self.query_latency[index].observe(elapsed);
+        if !ok {
+            self.query_errors[index].fetch_add(1, Ordering::Relaxed);
+        }
+    }
+
+    /// 记录一次存储 RPC 的耗时
+    pub fn record_storage(&self, engine: EngineType, op: StorageOp, elapsed: Duration, ok: bool) {
+        let (engine, op) = (engine_index(engine), op as usize);
+        self.storage_latency[engine][op].observe(elapsed);
+        if !ok {
+            self.storage_errors[engine][op].fetch_add(1, Ordering::Relaxed);
+        }
+    }
+
+    pub fn add_spilled_bytes(&self, bytes: u64) {
+        self.spilled_bytes.fetch_add(bytes, Ordering::Relaxed);
+    }
+
+    pub fn query_latency(&self, model: &str) -> HistogramSnapshot {
+        self.query_latency[Self::model_index(model)].snapshot()
+    }
+
+    pub fn storage_latency(&self, engine: EngineType, op: StorageOp) -> HistogramSnapshot {
+        self.storage_latency[engine_index(engine)][op as usize].snapshot()
+    }
+
+    /// 以 Prometheus 文本格式导出；给出缓存管理器时附带缓存计数与命中率
+    pub fn render_prometheus(&self, cache: Option<&CacheManager>) -> String {
+        let mut out = String::new();
+
+        out.push_str("# HELP sealdb_query_duration_seconds Query execution latency by execution model.\n");
+        out.push_str("# TYPE sealdb_query_duration_seconds histogram\n");
+        for (model, histogram) in QUERY_MODELS.iter().zip(self.query_latency.iter()) {
+            write_histogram(&mut out, "sealdb_query_duration_seconds", &format!("model=\"{}\"", model), &histogram.snapshot());
+        }
+        out.push_str("# HELP sealdb_query_errors_total Failed queries by execution model.\n");
+        out.push_str("# TYPE sealdb_query_errors_total counter\n");
+        for (model, errors) in QUERY_MODELS.iter().zip(self.query_errors.iter()) {
+            let _ = writeln!(out, "sealdb_query_errors_total{{model=\"{}\"}} {}", model, errors.load(Ordering::Relaxed));
+        }
+
+        out.push_str("# HELP sealdb_storage_rpc_duration_seconds Storage engine request latency.\n");
+        out.push_str("# TYPE sealdb_storage_rpc_duration_seconds histogram\n");
+        for (engine, histograms) in STORAGE_ENGINES.iter().zip(self.storage_latency.iter()) {
+            for (op, histogram) in StorageOp::ALL.iter().zip(histograms.iter()) {
+                let snapshot = histogram.snapshot();
+                // 未使用的引擎不导出，避免产生大量全零序列
+                if snapshot.count > 0 {
+                    let labels = format!("engine=\"{}\",op=\"{}\"", engine, op.label());
+                    write_histogram(&mut out, "sealdb_storage_rpc_duration_seconds", &labels, &snapshot);
+                }
+            }
+        }
+        out.push_str("# HELP sealdb_storage_rpc_errors_total Failed storage engine requests.\n");
+        out.push_str("# TYPE sealdb_storage_rpc_errors_total counter\n");
+        for (engine, errors) in STORAGE_ENGINES.iter().zip(self.storage_errors.iter()) {
+            for (op, errors) in StorageOp::ALL.iter().zip(errors.iter()) {
+                let errors = errors.load(Ordering::Relaxed);
+                if errors > 0 {
+                    let _ = writeln!(out, "sealdb_storage_rpc_errors_total{{engine=\"{}\",op=\"{}\"}} {}", engine, op.label(), errors);
+                }
+            }
+        }
+
+        out.push_str("# HELP sealdb_spilled_bytes_total Bytes written to spill files by sort, join and aggregation.\n");
+        out.push_str("# TYPE sealdb_spilled_bytes_total counter\n");
+        let _ = writeln!(out, "sealdb_spilled_bytes_total {}", self.spilled_bytes.load(Ordering::Relaxed));
+
+        if let Some(cache) = cache {
+            write_cache_metrics(&mut out, cache);
+        }
+        out
+    }
+}
+
+/// 随 `/metrics` 导出的一组组件指标
+pub trait MetricsSource: Send + Sync {
+    /// 以 Prometheus 文本格式追加指标
+    fn write_prometheus(&self, out: &mut String);
+}
+
+impl MetricsSource for CacheManager {
+    fn write_prometheus(&self, out: &mut String) {
+        write_cache_metrics(out, self);
+    }
+}
+
+/// 引擎级指标加上各组件的指标
+pub fn render_all(sources: &[Arc<dyn MetricsSource>]) -> String {
+    let mut out = global().render_prometheus(None);
+    for source in sources {
+        source.write_prometheus(&mut out);
+    }
+    out
+}
+
+/// 追加一个无标签的计数器
+pub fn write_counter(out: &mut String, name: &str, help: &str, value: u64) {
+    let _ = writeln!(out, "# HELP {} {}\n# TYPE {} counter\n{} {}", name, help, name, name, value);
+}
+
+/// 追加一个无标签的仪表
+pub fn write_gauge(out: &mut String, name: &str, help: &str, value: f64) {
+    let _ = writeln!(out, "# HELP {} {}\n# TYPE {} gauge\n{} {}", name, help, name, name, value);
+}
+
+fn write_histogram(out: &mut String, name: &str, labels: &str, snapshot: &HistogramSnapshot) {
+    let mut cumulative = 0;
+    for (bound, count) in LATENCY_BUCKETS.iter().zip(snapshot.buckets.iter()) {
+        cumulative += count;
+        let _ = writeln!(out, "{}_bucket{{{},le=\"{}\"}} {}", name, labels, bound, cumulative);
+    }
+    let _ = writeln!(out, "{}_bucket{{{},le=\"+Inf\"}} {}", name, labels, snapshot.count);
+    let _ = writeln!(out, "{}_sum{{{}}} {}", name, labels, snapshot.sum);
+    let _ = writeln!(out, "{}_count{{{}}} {}", name, labels, snapshot.count);
+}
+
+fn write_cache_metrics(out: &mut String, cache: &CacheManager) {
+    let metrics = cache.metrics();
+    let mut last_name = "";
+    for metric in &metrics {
+        if metric.name != last_name {
+            let kind = if metric.name.ends_with("_total") { "counter" } else { "gauge" };
+            let _ = writeln!(out, "# TYPE {} {}", metric.name, kind);
+            last_name = metric.name;
+        }
+        let _ = writeln!(out, "{}{{cache=\"{}\"}} {}", metric.name, metric.cache, metric.value);
+    }
+
+    out.push_str("# HELP sealdb_cache_hit_ratio Cache hits over lookups since start.\n");
+    out.push_str("# TYPE sealdb_cache_hit_ratio gauge\n");
+    for cache_type in ["plan", "result"] {
+        let value = |name: &str| {
+            metrics
+                .iter()
+                .find(|m| m.name == name && m.cache == cache_type)
+                .map(|m| m.value)
+                .unwrap_or(0)
+        };
+        let (hits, misses) = (value("sealdb_cache_hits_total"), value("sealdb_cache_misses_total"));
+        let ratio = if hits + misses == 0 { 0.0 } else { hits as f64 / (hits + misses) as f64 };
+        let _ = writeln!(out, "sealdb_cache_hit_ratio{{cache=\"{}\"}} {}", cache_type, ratio);
+    }
+}
+
+/// 进程级指标
+pub fn global() -> &'static EngineMetrics {
+    static METRICS: OnceLock<EngineMetrics> = OnceLock::new();
+    METRICS.get_or_init(EngineMetrics::default)
+}
+
+/// 在 `listener` 上提供 `GET /metrics`，直到监听出错
+pub async fn serve_metrics(listener: TcpListener, sources: Vec<Arc<dyn MetricsSource>>) -> common::Result<()> {
+    let sources: Arc<[Arc<dyn MetricsSource>]> = sources.into();
+    loop {
+        let (mut stream, peer) = listener
+            .accept()
+            .await
+            .map_err(|e| common::Error::Network(format!("metrics listener failed: {}", e)))?;
+        let sources = sources.clone();
+        tokio::spawn(async move {
+            let mut request = [0u8; 1024];
+            let read = match stream.read(&mut request).await {
+                Ok(read) => read,
+                Err(e) => {
+                    debug!("metrics request from {} failed: {}", peer, e);
+                    return;
+                }
+            };
+            let request_line = String::from_utf8_lossy(&request[..read]);
+            let response = if request_line.starts_with("GET /metrics") {
+                let body = render_all(&sources);
+                format!(
+                    "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: {}\r\nConnection: close\r\n\r\n{}",
+                    body.len(),
+                    body
+                )
+            } else {
+                "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n".to_string()
+            };
+            if let Err(e) = stream.write_all(response.as_bytes()).await {
+                warn!("failed to write metrics response to {}: {}", peer, e);
+            }
+            let _ = stream.shutdown().await;
+        });
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_histogram_merges_stripes() {
+        let histogram = Arc::new(Histogram::default());
+        let handles: Vec<_> = (0..4)
+            .map(|_| {
+                let histogram = histogram.clone();
+                std::thread::spawn(move || {
+                    for _ in 0..100 {
+                        histogram.observe(Duration::from_micros(200));
+                    }
+                    histogram.observe(Duration::from_secs(10));
+                })
+            })
+            .collect();
+        for handle in handles {
+            handle.join().unwrap();
+        }
+        let snapshot = histogram.snapshot();
+        assert_eq!(snapshot.count, 404);
+        assert_eq!(snapshot.buckets[1], 400);
+        assert_eq!(snapshot.buckets[LATENCY_BUCKETS.len()], 4);
+        assert!((snapshot.sum - 40.08).abs() < 1e-6);
+    }
+
+    #[test]
+    fn test_prometheus_exposition() {
+        let metrics = EngineMetrics::default();
+        metrics.record_query("vectorized", Duration::from_millis(2), true);
+        metrics.record_query("vectorized", Duration::from_millis(30), false);
+        metrics.record_storage(EngineType::Memory, StorageOp::Get, Duration::from_micros(50), true);
+        let cache = CacheManager::new();
+        let text = metrics.render_prometheus(Some(&cache));
+
+        assert!(text.contains("sealdb_query_duration_seconds_bucket{model=\"vectorized\",le=\"0.0025\"} 1\n"));
+        assert!(text.contains("sealdb_query_duration_seconds_count{model=\"vectorized\"} 2\n"));
+        assert!(text.contains("sealdb_query_errors_total{model=\"vectorized\"} 1\n"));
+        assert!(text.contains("sealdb_storage_rpc_duration_seconds_count{engine=\"memory\",op=\"get\"} 1\n"));
+        assert!(!text.contains("engine=\"tikv\""));
+        assert!(text.contains("sealdb_cache_hit_ratio{cache=\"plan\"} 0\n"));
+    }
+
+    #[tokio::test]
+    async fn test_metrics_endpoint() {
+        let listener = TcpListener::bind("127.0.0.1:0").await.unwrap();
+        let addr = listener.local_addr().unwrap();
+        let sources: Vec<Arc<dyn MetricsSource>> = vec![Arc::new(CacheManager::new())];
+        let server = tokio::spawn(serve_metrics(listener, sources));
+
+        let mut stream = tokio::net::TcpStream::connect(addr).await.unwrap();
+        stream.write_all(b"GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n").await.unwrap();
+        let mut response = String::new();
+        stream.read_to_string(&mut response).await.unwrap();
+        assert!(response.starts_with("HTTP/1.1 200 OK"));
+        assert!(response.contains("# TYPE sealdb_query_duration_seconds histogram"));
+        assert!(response.contains("sealdb_cache_hit_ratio{cache=\"plan\"} 0\n"));
+        server.abort();
+    }
+}
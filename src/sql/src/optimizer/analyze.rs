@@ -0,0 +1,595 @@
+//! 采样 ANALYZE
+//!
+//! 对表做一次流式扫描：每列用 HyperLogLog 估计不同值个数，用蓄水池采样保留
+//! 固定大小的样本，扫描结束后在样本上构建最常见值 (MCV) 列表和等深直方图。
+//! 内存占用只与样本大小和列数有关，与表大小无关。
+//!
+//! `AutoAnalyzer` 在后台定期检查各表自上次分析以来的修改行数，超过阈值的表
+//! 重新分析，分析结果通过 `StatisticsManager::apply_analysis` 生效。
+
+use async_trait::async_trait;
+use chrono::Utc;
+use common::{Error, Result};
+use std::collections::hash_map::DefaultHasher;
+use std::hash::{Hash, Hasher};
+use std::sync::Arc;
+use std::time::Duration;
+use tokio::sync::RwLock;
+use tokio::task::JoinHandle;
+use tracing::{debug, info, warn};
+
+use super::statistics::{compare_values, ColumnStatistics, StatisticsManager, TableStatistics};
+use crate::executor::StorageExecutor;
+use crate::parser::ParsedValue;
+use crate::storage::{StorageHandler, TableScanStream};
+
+/// 默认每列样本行数
+pub const DEFAULT_SAMPLE_SIZE: usize = 30_000;
+
+/// 默认直方图桶数
+pub const DEFAULT_HISTOGRAM_BUCKETS: usize = 100;
+
+/// 默认 MCV 列表长度
+pub const DEFAULT_MCV_COUNT: usize = 20;
+
+/// HyperLogLog 寄存器位数，4096 个寄存器，标准误差约 1.6%
+const HLL_PRECISION: u32 = 12;
+
+/// ANALYZE 配置
+#[derive(Debug, Clone)]
+pub struct AnalyzeConfig {
+    pub sample_size: usize,
+    pub histogram_buckets: usize,
+    pub mcv_count: usize,
+}
+
+impl Default for AnalyzeConfig {
+    fn default() -> Self {
+        Self {
+            sample_size: DEFAULT_SAMPLE_SIZE,
+            histogram_buckets: DEFAULT_HISTOGRAM_BUCKETS,
+            mcv_count: DEFAULT_MCV_COUNT,
+        }
+    }
+}
+
+/// 蓄水池采样 (Algorithm R)，任意长度的输入流上等概率保留 `capacity` 个元素
+#[derive(Debug, Clone)]
+pub struct ReservoirSampler<T> {
+    capacity: usize,
+    seen: u64,
+    samples: Vec<T>,
+    rng: u64,
+}
+
+impl<T> ReservoirSampler<T> {
+    pub fn new(capacity: usize) -> Self {
+        Self {
+            capacity,
+            seen: 0,
+            samples: Vec::with_capacity(capacity.min(4096)),
+            rng: 0x9E37_79B9_7F4A_7C15,
+        }
+    }
+
+    pub fn add(&mut self, item: T) {
+        self.seen += 1;
+        if self.samples.len() < self.capacity {
+            self.samples.push(item);
+            return;
+        }
+        let slot = self.next_random() % self.seen;
+        if (slot as usize) < self.capacity {
+            self.samples[slot as usize] = item;
+        }
+    }
+
+    /// 已经看到的元素个数
+    pub fn seen(&self) -> u64 {
+        self.seen
+    }
+
+    pub fn into_samples(self) -> Vec<T> {
+        self.samples
+    }
+
+    fn next_random(&mut self) -> u64 {
+        // splitmix64
+        self.rng = self.rng.wrapping_add(0x9E37_79B9_7F4A_7C15);
+        let mut z = self.rng;
+        z = (z ^ (z >> 30)).wrapping_mul(0xBF58_476D_1CE4_E5B9);
+        z = (z ^ (z >> 27)).wrapping_mul(0x94D0_49BB_1331_11EB);
+        z ^ (z >> 31)
+    }
+}
+
+/// HyperLogLog 不同值个数估计
+#[derive(Debug, Clone)]
+pub struct HyperLogLog {
+    registers: Vec<u8>,
+}
+
+impl HyperLogLog {
+    pub fn new() -> Self {
+        Self {
+            registers: vec![0; 1 << HLL_PRECISION],
+        }
+    }
+
+    pub fn add<T: Hash + ?Sized>(&mut self, value: &T) {
+        let mut hasher = DefaultHasher::new();
+        value.hash(&mut hasher);
+        let hash = hasher.finish();
+
+        let index = (hash >> (64 - HLL_PRECISION)) as usize;
+        let rest = hash << HLL_PRECISION;
+        let rank = (rest.leading_zeros().min(64 - HLL_PRECISION) + 1) as u8;
+        if rank > self.registers[index] {
+            self.registers[index] = rank;
+        }
+    }
+
+    /// 从寄存器恢复草图，用于跨节点传输
+    pub fn from_registers(registers: Vec<u8>) -> Result<Self> {
+        if registers.len() != 1 << HLL_PRECISION {
+            return Err(Error::Deserialization(format!(
+                "HyperLogLog needs {} registers, got {}",
+                1 << HLL_PRECISION,
+                registers.len()
+            )));
+        }
+        Ok(Self { registers })
+    }
+
+    pub fn registers(&self) -> &[u8] {
+        &self.registers
+    }
+
+    /// 合并另一个草图，用于增量或分区并行的统计
+    pub fn merge(&mut self, other: &HyperLogLog) {
+        for (mine, theirs) in self.registers.iter_mut().zip(&other.registers) {
+            *mine = (*mine).max(*theirs);
+        }
+    }
+
+    pub fn estimate(&self) -> u64 {
+        let m = self.registers.len() as f64;
+        let alpha = 0.7213 / (1.0 + 1.079 / m);
+        let sum: f64 = self.registers.iter().map(|&r| 2f64.powi(-(r as i32))).sum();
+        let raw = alpha * m * m / sum;
+
+        // 小基数时退化为线性计数
+        let zeros = self.registers.iter().filter(|&&r| r == 0).count();
+        let estimate = if raw <= 2.5 * m && zeros > 0 {
+            m * (m / zeros as f64).ln()
+        } else {
+            raw
+        };
+        estimate.round() as u64
+    }
+}
+
+impl Default for HyperLogLog {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// 单列的流式分析状态
+#[derive(Debug, Clone)]
+pub struct ColumnAnalyzer {
+    column_name: String,
+    rows: u64,
+    null_count: u64,
+    total_width: u64,
+    ndv: HyperLogLog,
+    sampler: ReservoirSampler<String>,
+}
+
+impl ColumnAnalyzer {
+    pub fn new(column_name: &str, sample_size: usize) -> Self {
+        Self {
+            column_name: column_name.to_string(),
+            rows: 0,
+            null_count: 0,
+            total_width: 0,
+            ndv: HyperLogLog::new(),
+            sampler: ReservoirSampler::new(sample_size),
+        }
+    }
+
+    /// 处理一个文本值，`NULL` 计为空值
+    pub fn add(&mut self, value: &str) {
+        self.rows += 1;
+        if value == "NULL" {
+            self.null_count += 1;
+            return;
+        }
+        self.total_width += value.len() as u64;
+        self.ndv.add(value);
+        self.sampler.add(value.to_string());
+    }
+
+    /// 在样本上构建 MCV 与等深直方图
+    pub fn finish(self, table_name: &str, config: &AnalyzeConfig) -> ColumnStatistics {
+        let non_null = self.rows - self.null_count;
+        let sample_scale = if self.sampler.seen() > 0 {
+            non_null as f64 / self.rows.max(1) as f64
+        } else {
+            0.0
+        };
+        let samples = self.sampler.into_samples();
+        let sample_len = samples.len();
+        let distinct_count = self.ndv.estimate();
+
+        let mut values: Vec<ParsedValue> = samples.into_iter().map(|s| text_to_value(&s)).collect();
+        values.sort_by(compare_values);
+
+        // 样本中的频数
+        let mut counts: Vec<(ParsedValue, usize)> = Vec::new();
+        for value in values.iter() {
+            match counts.last_mut() {
+                Some((last, count)) if last == value => *count += 1,
+                _ => counts.push((value.clone(), 1)),
+            }
+        }
+
+        // 出现频率明显高于平均值的才进入 MCV 列表；样本覆盖全部不同值时全部记录
+        let avg_count = sample_len as f64 / counts.len().max(1) as f64;
+        let mut candidates: Vec<&(ParsedValue, usize)> = counts
+            .iter()
+            .filter(|(_, count)| *count > 1 && (counts.len() <= config.mcv_count || *count as f64 > 1.25 * avg_count))
+            .collect();
+        candidates.sort_by(|a, b| b.1.cmp(&a.1));
+        candidates.truncate(config.mcv_count);
+
+        let most_common_values: Vec<ParsedValue> = candidates.iter().map(|(value, _)| value.clone()).collect();
+        let most_common_frequencies: Vec<f64> = candidates
+            .iter()
+            .map(|(_, count)| *count as f64 / sample_len.max(1) as f64 * sample_scale)
+            .collect();
+
+        // 直方图只覆盖 MCV 之外的值
+        let remaining: Vec<&ParsedValue> = values.iter().filter(|value| !most_common_values.contains(value)).collect();
+        let histogram_bounds = equi_depth_bounds(&remaining, config.histogram_buckets);
+
+        debug!(
+            "ANALYZE {}.{}: {} rows, {} nulls, ndv {}, {} mcv, {} histogram bounds",
+            table_name, self.column_name, self.rows, self.null_count, distinct_count,
+            most_common_values.len(), histogram_bounds.len()
+        );
+
+        ColumnStatistics {
+            table_name: table_name.to_string(),
+            column_name: self.column_name,
+            null_count: self.null_count,
+            distinct_count: distinct_count.min(non_null),
+            most_common_values,
+            most_common_frequencies,
+            histogram_bounds,
+            correlation: 0.0,
+            avg_width: if non_null > 0 { self.total_width as f64 / non_null as f64 } else { 0.0 },
+        }
+    }
+}
+
+/// 等深直方图边界：`buckets` 个桶需要 `buckets + 1` 个边界，每个桶内样本数相同
+fn equi_depth_bounds(sorted: &[&ParsedValue], buckets: usize) -> Vec<ParsedValue> {
+    if sorted.len() < 2 || buckets == 0 {
+        return Vec::new();
+    }
+    let buckets = buckets.min(sorted.len() - 1);
+    let mut bounds: Vec<ParsedValue> = (0..=buckets)
+        .map(|i| sorted[i * (sorted.len() - 1) / buckets].clone())
+        .collect();
+    bounds.dedup();
+    bounds
+}
+
+/// 把扫描得到的文本值还原为带类型的值
+pub fn text_to_value(text: &str) -> ParsedValue {
+    match text {
+        "NULL" => ParsedValue::Null,
+        "true" => ParsedValue::Boolean(true),
+        "false" => ParsedValue::Boolean(false),
+        _ if text.parse::<f64>().is_ok() => ParsedValue::Number(text.to_string()),
+        _ => ParsedValue::String(text.to_string()),
+    }
+}
+
+/// 一次 ANALYZE 的结果
+#[derive(Debug, Clone)]
+pub struct TableAnalysis {
+    pub table: TableStatistics,
+    pub columns: Vec<ColumnStatistics>,
+}
+
+/// 表的流式分析状态
+pub struct TableAnalyzer {
+    table_name: String,
+    config: AnalyzeConfig,
+    columns: Vec<ColumnAnalyzer>,
+    rows: u64,
+    total_width: u64,
+}
+
+impl TableAnalyzer {
+    pub fn new(table_name: &str, columns: &[String], config: AnalyzeConfig) -> Self {
+        Self {
+            table_name: table_name.to_string(),
+            columns: columns.iter().map(|name| ColumnAnalyzer::new(name, config.sample_size)).collect(),
+            config,
+            rows: 0,
+            total_width: 0,
+        }
+    }
+
+    /// 处理一行，按位置对应列；缺失的列计为 NULL
+    pub fn add_row(&mut self, row: &[String]) {
+        self.rows += 1;
+        self.total_width += row.iter().map(|value| value.len() as u64).sum::<u64>();
+        for (i, column) in self.columns.iter_mut().enumerate() {
+            column.add(row.get(i).map_or("NULL", String::as_str));
+        }
+    }
+
+    /// 消费整个扫描流
+    pub async fn consume(&mut self, stream: &mut TableScanStream) -> Result<()> {
+        while let Some(rows) = stream.next_rows().await? {
+            for row in &rows {
+                self.add_row(row);
+            }
+        }
+        Ok(())
+    }
+
+    pub fn finish(self) -> TableAnalysis {
+        let avg_row_size = if self.rows > 0 { self.total_width as f64 / self.rows as f64 } else { 0.0 };
+        let table = TableStatistics {
+            table_name: self.table_name.clone(),
+            row_count: self.rows,
+            page_count: ((self.rows as f64 * avg_row_size) / 8192.0).ceil() as u64,
+            avg_row_size,
+            last_analyzed: Utc::now(),
+            sample_size: self.rows.min(self.config.sample_size as u64),
+            correlation: 0.0,
+        };
+        let columns = self
+            .columns
+            .into_iter()
+            .map(|column| column.finish(&self.table_name, &self.config))
+            .collect();
+        TableAnalysis { table, columns }
+    }
+}
+
+/// ANALYZE 的数据来源
+#[async_trait]
+pub trait AnalyzeSource: Send + Sync {
+    async fn open_scan(&self, table_name: &str, columns: &[String]) -> Result<TableScanStream>;
+}
+
+#[async_trait]
+impl AnalyzeSource for StorageHandler {
+    async fn open_scan(&self, table_name: &str, columns: &[String]) -> Result<TableScanStream> {
+        self.scan_table_stream(table_name, columns, None, None).await
+    }
+}
+
+#[async_trait]
+impl AnalyzeSource for StorageExecutor {
+    async fn open_scan(&self, table_name: &str, columns: &[String]) -> Result<TableScanStream> {
+        self.storage_handler().open_scan(table_name, columns).await
+    }
+}
+
+/// 对一张表执行 ANALYZE
+pub async fn analyze_table(
+    source: &dyn AnalyzeSource,
+    table_name: &str,
+    columns: &[String],
+    config: &AnalyzeConfig,
+) -> Result<TableAnalysis> {
+    let mut stream = source.open_scan(table_name, columns).await?;
+    let mut analyzer = TableAnalyzer::new(table_name, columns, config.clone());
+    analyzer.consume(&mut stream).await?;
+    Ok(analyzer.finish())
+}
+
+/// 后台增量刷新配置
+#[derive(Debug, Clone)]
+pub struct AutoAnalyzeConfig {
+    /// 检查间隔
+    pub interval: Duration,
+    /// 修改行数超过上次行数的该比例时重新分析
+    pub modified_ratio: f64,
+    /// 修改行数的下限，避免小表频繁分析
+    pub min_modified_rows: u64,
+    pub analyze: AnalyzeConfig,
+}
+
+impl Default for AutoAnalyzeConfig {
+    fn default() -> Self {
+        Self {
+            interval: Duration::from_secs(60),
+            modified_ratio: 0.1,
+            min_modified_rows: 500,
+            analyze: AnalyzeConfig::default(),
+        }
+    }
+}
+
+/// 后台自动 ANALYZE
+pub struct AutoAnalyzer;
+
+impl AutoAnalyzer {
+    /// 执行一轮检查，返回重新分析的表
+    pub async fn run_once(
+        statistics: &RwLock<StatisticsManager>,
+        source: &dyn AnalyzeSource,
+        config: &AutoAnalyzeConfig,
+    ) -> Vec<String> {
+        let due: Vec<(String, Vec<String>, u64)> = {
+            let statistics = statistics.read().await;
+            statistics
+                .tables_needing_refresh(config.modified_ratio, config.min_modified_rows)
+                .into_iter()
+                .map(|table| {
+                    let columns = statistics.analyzed_columns(&table).to_vec();
+                    let modified = statistics.modified_rows(&table);
+                    (table, columns, modified)
+                })
+                .collect()
+        };
+
+        let mut refreshed = Vec::new();
+        for (table, columns, modified) in due {
+            // 扫描期间不持有锁，查询仍可读取旧统计，写入继续累计修改行数
+            match analyze_table(source, &table, &columns, &config.analyze).await {
+                Ok(analysis) => {
+                    statistics.write().await.apply_analysis(&columns, analysis, modified).await;
+                    refreshed.push(table);
+                }
+                Err(e) => warn!("Auto analyze of {} failed: {}", table, e),
+            }
+        }
+        refreshed
+    }
+
+    /// 启动后台任务
+    pub fn spawn(
+        statistics: Arc<RwLock<StatisticsManager>>,
+        source: Arc<dyn AnalyzeSource>,
+        config: AutoAnalyzeConfig,
+    ) -> JoinHandle<()> {
+        info!("Starting auto analyze every {:?}", config.interval);
+        tokio::spawn(async move {
+            let mut interval = tokio::time::interval(config.interval);
+            loop {
+                interval.tick().await;
+                let refreshed = Self::run_once(&statistics, source.as_ref(), &config).await;
+                if !refreshed.is_empty() {
+                    info!("Auto analyze refreshed {:?}", refreshed);
+                }
+            }
+        })
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_hyperloglog_accuracy() {
+        let mut hll = HyperLogLog::new();
+        for i in 0..50_000 {
+            hll.add(&i);
+            hll.add(&i);
+        }
+        let estimate = hll.estimate() as f64;
+        assert!((estimate - 50_000.0).abs() / 50_000.0 < 0.05, "estimate {estimate}");
+
+        let mut small = HyperLogLog::new();
+        for i in 0..10 {
+            small.add(&i);
+        }
+        assert_eq!(small.estimate(), 10);
+    }
+
+    #[test]
+    fn test_reservoir_keeps_uniform_sample() {
+        let mut sampler = ReservoirSampler::new(1000);
+        for i in 0..100_000u32 {
+            sampler.add(i);
+        }
+        let samples = sampler.into_samples();
+        assert_eq!(samples.len(), 1000);
+        let low = samples.iter().filter(|&&v| v < 50_000).count();
+        assert!((400..600).contains(&low), "low half {low}");
+    }
+
+    #[test]
+    fn test_column_analysis_builds_mcv_and_histogram() {
+        let mut analyzer = TableAnalyzer::new("t", &["id".to_string(), "status".to_string()], AnalyzeConfig::default());
+        for i in 0..10_000 {
+            let status = match i % 10 {
+                0..=6 => "active",
+                7 | 8 => "idle",
+                _ => "NULL",
+            };
+            analyzer.add_row(&[i.to_string(), status.to_string()]);
+        }
+        let analysis = analyzer.finish();
+        assert_eq!(analysis.table.row_count, 10_000);
+
+        let id = &analysis.columns[0];
+        assert!(id.most_common_values.is_empty());
+        assert_eq!(id.histogram_bounds.first(), Some(&ParsedValue::Number("0".to_string())));
+        assert_eq!(id.histogram_bounds.last(), Some(&ParsedValue::Number("9999".to_string())));
+        assert!((id.distinct_count as f64 - 10_000.0).abs() < 500.0);
+
+        let status = &analysis.columns[1];
+        assert_eq!(status.null_count, 1000);
+        assert_eq!(status.distinct_count, 2);
+        assert_eq!(status.most_common_values[0], ParsedValue::String("active".to_string()));
+        assert!((status.most_common_frequencies[0] - 0.7).abs() < 1e-9);
+    }
+
+    struct EngineSource {
+        engine: Arc<dyn storage::StorageEngine>,
+    }
+
+    #[async_trait]
+    impl AnalyzeSource for EngineSource {
+        async fn open_scan(&self, table_name: &str, columns: &[String]) -> Result<TableScanStream> {
+            Ok(TableScanStream::open(self.engine.clone(), table_name, columns, None))
+        }
+    }
+
+    #[tokio::test]
+    async fn test_auto_analyze_refreshes_modified_tables() {
+        use storage::codec::{self, Datum};
+        use storage::{StorageContext, StorageEngine, StorageOptions};
+
+        let mut engine = storage::MemoryEngine::new();
+        engine.initialize(&storage::StorageConfig::default()).await.unwrap();
+        for i in 0..2000i64 {
+            let key = codec::record_key("orders", &[Datum::Int(i)]);
+            let row = storage::Value::from(codec::encode_row(&[Datum::Int(i), Datum::Int(i % 4)]));
+            engine.put(&key, &row, &StorageContext::default(), &StorageOptions::default()).await.unwrap();
+        }
+        let source = EngineSource { engine: Arc::new(engine) };
+
+        let columns = vec!["id".to_string(), "kind".to_string()];
+        let statistics = RwLock::new(StatisticsManager::new());
+        statistics
+            .write()
+            .await
+            .analyze_table_from(&source, "orders", &columns, &AnalyzeConfig::default())
+            .await
+            .unwrap();
+        assert_eq!(statistics.read().await.get_table_statistics("orders").await.unwrap().row_count, 2000);
+
+        let config = AutoAnalyzeConfig { min_modified_rows: 100, ..AutoAnalyzeConfig::default() };
+        statistics.write().await.record_modifications("orders", 150);
+        assert!(AutoAnalyzer::run_once(&statistics, &source, &config).await.is_empty());
+
+        statistics.write().await.record_modifications("orders", 100);
+        assert_eq!(AutoAnalyzer::run_once(&statistics, &source, &config).await, vec!["orders".to_string()]);
+        assert_eq!(statistics.read().await.modified_rows("orders"), 0);
+
+        // 扫描期间的写入在刷新后仍然计入修改行数
+        statistics.write().await.record_modifications("orders", 50);
+        let modified_at_start = statistics.read().await.modified_rows("orders");
+        let analysis = analyze_table(&source, "orders", &columns, &config.analyze).await.unwrap();
+        statistics.write().await.record_modifications("orders", 30);
+        statistics.write().await.apply_analysis(&columns, analysis, modified_at_start).await;
+        assert_eq!(statistics.read().await.modified_rows("orders"), 30);
+
+        let statistics = statistics.read().await;
+        let kind = statistics.column_statistics("orders", "kind").unwrap();
+        assert_eq!(kind.distinct_count, 4);
+        assert!((kind.equality_selectivity(&ParsedValue::Number("1".to_string()), 2000) - 0.25).abs() < 1e-9);
+    }
+}
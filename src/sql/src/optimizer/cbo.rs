@@ -6,6 +6,9 @@ use common::Result;
 use tracing::{debug, info};
 
 use crate::parser::{ParsedExpression, ParsedValue};
+use super::join_order::{JoinOrderConfig, JoinReorderer};
+use super::statistics::StatisticsManager as CollectedStatistics;
+use crate::config::CboConfig;
 
 /// 基于成本的优化器 (CBO)
 pub struct CostBasedOptimizer {
@@ -13,6 +16,8 @@ pub struct CostBasedOptimizer {
     statistics_manager: StatisticsManager,
     max_plans_per_group: usize,
     max_search_depth: usize,
+    enable_join_reordering: bool,
+    join_reorderer: JoinReorderer,
 }
 
 impl Default for CostBasedOptimizer {
@@ -28,16 +33,47 @@ impl CostBasedOptimizer {
             statistics_manager: StatisticsManager::new(),
             max_plans_per_group: 100,
             max_search_depth: 10,
+            enable_join_reordering: true,
+            join_reorderer: JoinReorderer::default(),
         }
     }
 
-    /// 执行基于成本的优化
+    /// 按配置创建
+    pub fn with_config(config: &CboConfig) -> Self {
+        Self {
+            max_plans_per_group: config.max_plans_per_group,
+            max_search_depth: config.max_search_depth,
+            enable_join_reordering: config.enable_join_reordering,
+            join_reorderer: JoinReorderer::new(JoinOrderConfig {
+                dp_threshold: config.join_reorder_dp_threshold,
+            }),
+            ..Self::new()
+        }
+    }
+
+    /// 执行基于成本的优化，没有收集到的统计信息使用默认估计
     pub async fn optimize(&self, plan: OptimizedPlan) -> Result<OptimizedPlan> {
+        self.optimize_with_statistics(plan, &CollectedStatistics::new()).await
+    }
+
+    /// 基于收集到的统计信息执行基于成本的优化
+    pub async fn optimize_with_statistics(
+        &self,
+        plan: OptimizedPlan,
+        statistics: &CollectedStatistics,
+    ) -> Result<OptimizedPlan> {
         info!("CBO: 开始基于成本的优化");
         debug!("CBO: 输入计划: {:#?}", plan);
         info!("CBO: 输入计划节点数: {}", plan.nodes.len());
         info!("CBO: 输入计划估计成本: {:.2}", plan.estimated_cost);
 
+        // 0. 连接顺序由 DP 枚举直接确定，作为其余候选的基础
+        let plan = if self.enable_join_reordering {
+            self.reorder_joins(plan, statistics).await?
+        } else {
+            plan
+        };
+
         // 1. 生成候选计划
         info!("CBO: 生成候选计划");
         let candidates = self.generate_candidates(&plan).await?;
@@ -67,17 +103,12 @@ impl CostBasedOptimizer {
     async fn generate_candidates(&self, plan: &OptimizedPlan) -> Result<Vec<OptimizedPlan>> {
         let mut candidates = vec![plan.clone()];
 
-        // 1. 生成连接重排序候选
-        if let Some(join_candidates) = self.generate_join_orders(plan).await? {
-            candidates.extend(join_candidates);
-        }
-
-        // 2. 生成索引选择候选
+        // 1. 生成索引选择候选
         if let Some(index_candidates) = self.generate_index_plans(plan).await? {
             candidates.extend(index_candidates);
         }
 
-        // 3. 生成聚合优化候选
+        // 2. 生成聚合优化候选
         if let Some(agg_candidates) = self.generate_aggregation_plans(plan).await? {
             candidates.extend(agg_candidates);
         }
@@ -85,13 +116,13 @@ impl CostBasedOptimizer {
         Ok(candidates)
     }
 
-    /// 生成连接重排序候选
-    async fn generate_join_orders(
-        &self,
-        _plan: &OptimizedPlan,
-    ) -> Result<Option<Vec<OptimizedPlan>>> {
-        // 简化实现：暂时返回 None
-        Ok(None)
+    /// 重排计划中各连接块的顺序
+    async fn reorder_joins(&self, plan: OptimizedPlan, statistics: &CollectedStatistics) -> Result<OptimizedPlan> {
+        let mut nodes = Vec::with_capacity(plan.nodes.len());
+        for node in plan.nodes {
+            nodes.push(self.join_reorderer.reorder(node, statistics).await?);
+        }
+        Ok(OptimizedPlan { nodes, ..plan })
     }
 
     /// 生成索引选择候选
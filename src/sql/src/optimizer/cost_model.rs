@@ -3,7 +3,8 @@
 //! 借鉴 PostgreSQL 和 TiDB 的成本模型实现
 
 use common::Result;
-use crate::parser::{ParsedExpression, ParsedOperator};
+use crate::parser::{ParsedExpression, ParsedOperator, ParsedValue};
+use super::statistics::{ColumnStatistics, StatisticsManager};
 
 /// 成本模型（借鉴 PostgreSQL 的 cost model）
 #[derive(Debug, Clone)]
@@ -95,6 +96,145 @@ impl CostModel {
     }
 }
 
+impl CostModel {
+    /// 基于列统计信息估算单表谓词选择性
+    ///
+    /// 等值使用 MCV 与不同值个数，范围使用等深直方图，AND/OR 按独立性假设组合；
+    /// 缺少统计信息的部分退回 `estimate_selectivity` 的固定值。
+    pub async fn estimate_selectivity_with_stats(
+        &self,
+        predicate: &ParsedExpression,
+        statistics: &StatisticsManager,
+        table_name: &str,
+    ) -> Result<f64> {
+        let row_count = statistics.get_table_statistics(table_name).await.map_or(0, |stats| stats.row_count);
+        match self.selectivity_from_stats(predicate, statistics, table_name, row_count) {
+            Some(selectivity) => Ok(selectivity),
+            None => self.estimate_selectivity(predicate).await,
+        }
+    }
+
+    fn selectivity_from_stats(
+        &self,
+        predicate: &ParsedExpression,
+        statistics: &StatisticsManager,
+        table_name: &str,
+        row_count: u64,
+    ) -> Option<f64> {
+        let ParsedExpression::BinaryOp { left, operator, right } = predicate else {
+            return None;
+        };
+        match operator {
+            ParsedOperator::And | ParsedOperator::Or => {
+                let fallback = |expr: &ParsedExpression| {
+                    self.selectivity_from_stats(expr, statistics, table_name, row_count)
+                        .unwrap_or_else(|| Self::default_selectivity(expr))
+                };
+                let l = fallback(left);
+                let r = fallback(right);
+                Some(if *operator == ParsedOperator::And { l * r } else { l + r - l * r })
+            }
+            _ => {
+                // 字面量在左侧时翻转比较方向
+                let (column, value, operator) = match (left.as_ref(), right.as_ref()) {
+                    (ParsedExpression::Column(c), ParsedExpression::Literal(v)) => (c, v, operator.clone()),
+                    (ParsedExpression::Literal(v), ParsedExpression::Column(c)) => (c, v, Self::flip(operator)?),
+                    _ => return None,
+                };
+                let stats = Self::lookup_column(statistics, table_name, column)?;
+                Self::comparison_selectivity(stats, &operator, value, row_count)
+            }
+        }
+    }
+
+    fn comparison_selectivity(
+        stats: &ColumnStatistics,
+        operator: &ParsedOperator,
+        value: &ParsedValue,
+        row_count: u64,
+    ) -> Option<f64> {
+        let selectivity = match operator {
+            ParsedOperator::Equal => stats.equality_selectivity(value, row_count),
+            ParsedOperator::NotEqual => {
+                (stats.non_null_fraction(row_count) - stats.equality_selectivity(value, row_count)).max(0.0)
+            }
+            ParsedOperator::LessThan => stats.range_selectivity(None, Some((value, false)), row_count),
+            ParsedOperator::LessThanOrEqual => stats.range_selectivity(None, Some((value, true)), row_count),
+            ParsedOperator::GreaterThan => stats.range_selectivity(Some((value, false)), None, row_count),
+            ParsedOperator::GreaterThanOrEqual => stats.range_selectivity(Some((value, true)), None, row_count),
+            _ => return None,
+        };
+        Some(selectivity)
+    }
+
+    /// 基于两侧列的不同值个数估算等值连接选择性：1 / max(ndv_left, ndv_right)
+    pub async fn estimate_join_selectivity_with_stats(
+        &self,
+        condition: &ParsedExpression,
+        statistics: &StatisticsManager,
+        left_table: &str,
+        right_table: &str,
+    ) -> Result<f64> {
+        if let ParsedExpression::BinaryOp { left, operator: ParsedOperator::Equal, right } = condition {
+            if let (ParsedExpression::Column(l), ParsedExpression::Column(r)) = (left.as_ref(), right.as_ref()) {
+                let left_stats = Self::lookup_column(statistics, left_table, l)
+                    .or_else(|| Self::lookup_column(statistics, right_table, l));
+                let right_stats = Self::lookup_column(statistics, right_table, r)
+                    .or_else(|| Self::lookup_column(statistics, left_table, r));
+                let ndv = left_stats
+                    .into_iter()
+                    .chain(right_stats)
+                    .map(|stats| stats.distinct_count)
+                    .max()
+                    .unwrap_or(0);
+                if ndv > 0 {
+                    return Ok(1.0 / ndv as f64);
+                }
+            }
+        }
+        self.estimate_join_selectivity(condition).await
+    }
+
+    /// 列名可能带表名限定 (`t.c`)，限定的表名与当前表不符时不使用统计信息
+    fn lookup_column<'a>(
+        statistics: &'a StatisticsManager,
+        table_name: &str,
+        column: &str,
+    ) -> Option<&'a ColumnStatistics> {
+        match column.rsplit_once('.') {
+            Some((qualifier, name)) if qualifier == table_name => statistics.column_statistics(table_name, name),
+            Some(_) => None,
+            None => statistics.column_statistics(table_name, column),
+        }
+    }
+
+    fn flip(operator: &ParsedOperator) -> Option<ParsedOperator> {
+        Some(match operator {
+            ParsedOperator::Equal => ParsedOperator::Equal,
+            ParsedOperator::NotEqual => ParsedOperator::NotEqual,
+            ParsedOperator::LessThan => ParsedOperator::GreaterThan,
+            ParsedOperator::LessThanOrEqual => ParsedOperator::GreaterThanOrEqual,
+            ParsedOperator::GreaterThan => ParsedOperator::LessThan,
+            ParsedOperator::GreaterThanOrEqual => ParsedOperator::LessThanOrEqual,
+            _ => return None,
+        })
+    }
+
+    /// 与 `estimate_selectivity` 相同的固定值，用于组合谓词中缺少统计信息的一侧
+    fn default_selectivity(predicate: &ParsedExpression) -> f64 {
+        match predicate {
+            ParsedExpression::BinaryOp { operator, .. } => match operator {
+                ParsedOperator::Equal => 0.1,
+                ParsedOperator::LessThan | ParsedOperator::LessThanOrEqual => 0.3,
+                ParsedOperator::GreaterThan | ParsedOperator::GreaterThanOrEqual => 0.3,
+                ParsedOperator::NotEqual => 0.9,
+                _ => 0.5,
+            },
+            _ => 0.5,
+        }
+    }
+}
+
 /// 成本估算结果
 #[derive(Debug, Clone)]
 pub struct CostEstimate {
@@ -165,4 +305,81 @@ mod tests {
         let selectivity = cost_model.estimate_selectivity(&equal_predicate).await.unwrap();
         assert_eq!(selectivity, 0.1);
     }
-} 
\ No newline at end of file
+
+    fn column_stats(table: &str, column: &str) -> ColumnStatistics {
+        ColumnStatistics {
+            table_name: table.to_string(),
+            column_name: column.to_string(),
+            null_count: 0,
+            distinct_count: 100,
+            most_common_values: vec![ParsedValue::Number("7".to_string())],
+            most_common_frequencies: vec![0.5],
+            histogram_bounds: (0..=10).map(|i| ParsedValue::Number((i * 10).to_string())).collect(),
+            correlation: 0.0,
+            avg_width: 8.0,
+        }
+    }
+
+    fn compare(column: &str, operator: ParsedOperator, value: &str) -> ParsedExpression {
+        ParsedExpression::BinaryOp {
+            left: Box::new(ParsedExpression::Column(column.to_string())),
+            operator,
+            right: Box::new(ParsedExpression::Literal(ParsedValue::Number(value.to_string()))),
+        }
+    }
+
+    #[tokio::test]
+    async fn test_selectivity_with_statistics() {
+        let cost_model = CostModel::new();
+        let mut statistics = StatisticsManager::new();
+        statistics.update_column_statistics("t.a", column_stats("t", "a")).await;
+
+        let mcv = cost_model
+            .estimate_selectivity_with_stats(&compare("a", ParsedOperator::Equal, "7"), &statistics, "t")
+            .await
+            .unwrap();
+        assert!((mcv - 0.5).abs() < 1e-9);
+
+        // 非 MCV 值平分剩余的 0.5
+        let other = cost_model
+            .estimate_selectivity_with_stats(&compare("t.a", ParsedOperator::Equal, "42"), &statistics, "t")
+            .await
+            .unwrap();
+        assert!((other - 0.5 / 99.0).abs() < 1e-9);
+
+        // 7 < 25 计入 MCV，直方图部分 25 / 100
+        let range = cost_model
+            .estimate_selectivity_with_stats(&compare("a", ParsedOperator::LessThan, "25"), &statistics, "t")
+            .await
+            .unwrap();
+        assert!((range - (0.5 + 0.5 * 0.25)).abs() < 1e-9);
+
+        // 没有统计信息的列退回固定值
+        let unknown = cost_model
+            .estimate_selectivity_with_stats(&compare("b", ParsedOperator::Equal, "1"), &statistics, "t")
+            .await
+            .unwrap();
+        assert_eq!(unknown, 0.1);
+    }
+
+    #[tokio::test]
+    async fn test_join_selectivity_with_statistics() {
+        let cost_model = CostModel::new();
+        let mut statistics = StatisticsManager::new();
+        statistics.update_column_statistics("t.a", column_stats("t", "a")).await;
+        let mut wide = column_stats("u", "a");
+        wide.distinct_count = 400;
+        statistics.update_column_statistics("u.a", wide).await;
+
+        let condition = ParsedExpression::BinaryOp {
+            left: Box::new(ParsedExpression::Column("t.a".to_string())),
+            operator: ParsedOperator::Equal,
+            right: Box::new(ParsedExpression::Column("u.a".to_string())),
+        };
+        let selectivity = cost_model
+            .estimate_join_selectivity_with_stats(&condition, &statistics, "t", "u")
+            .await
+            .unwrap();
+        assert!((selectivity - 1.0 / 400.0).abs() < 1e-12);
+    }
+}
@@ -0,0 +1,936 @@
+//! 连接顺序枚举
+//!
+//! 把计划中连续的内连接 (以及直接位于其上的过滤条件) 展平为连接图：叶子为关系，
+//! 条件按 AND 拆分后的每个谓词是一条边，边连接的关系由谓词引用的列确定。
+//!
+//! 关系数不超过 `dp_threshold` 且连接图连通时，用 DPccp 只枚举连通子图与其连通
+//! 补集的组合，得到 C_out (所有中间结果行数之和) 最小的 bushy 连接树；否则退回
+//! 贪心算法 (GOO)，每次合并结果行数最小的一对，优先合并有谓词相连的一对，
+//! 优化时间随表数多项式增长。
+//!
+//! 引用三个及以上关系的谓词 (超边) 在枚举时按团处理，谓词本身放在其引用的关系
+//! 全部到齐的最低连接上求值。哈希连接以左侧为构建侧，每个连接把行数较少的一侧放在左边。
+//!
+//! 连接输出按叶子从左到右拼接各关系的列，重排改变了叶子顺序时在连接块上方加一个投影，
+//! 恢复原来的列顺序。投影需要每个关系的输出列名，`*` 通过表结构目录展开；
+//! 有关系的列无法确定时保持原来的连接顺序，只下推谓词。
+
+use common::Result;
+use std::collections::HashMap;
+use std::sync::Arc;
+use tracing::debug;
+
+use super::cost_model::CostModel;
+use super::optimizer::{JoinType, PlanNode};
+use super::statistics::StatisticsManager;
+use crate::parser::{ParsedExpression, ParsedOperator};
+use crate::storage::TableCatalog;
+
+/// 默认使用动态规划的最大关系数
+pub const DEFAULT_DP_THRESHOLD: usize = 12;
+
+/// 关系用 u64 位图表示，超过该数量的连接保持原顺序
+const MAX_RELATIONS: usize = 64;
+
+/// 没有统计信息的表的默认行数
+const DEFAULT_TABLE_ROWS: f64 = 1000.0;
+
+/// 连接顺序枚举配置
+#[derive(Debug, Clone)]
+pub struct JoinOrderConfig {
+    /// 关系数超过该值时使用贪心算法
+    pub dp_threshold: usize,
+}
+
+impl Default for JoinOrderConfig {
+    fn default() -> Self {
+        Self {
+            dp_threshold: DEFAULT_DP_THRESHOLD,
+        }
+    }
+}
+
+/// 连接图中的关系
+struct Relation {
+    node: Option<PlanNode>,
+    tables: Vec<String>,
+    rows: f64,
+}
+
+/// 连接谓词
+struct JoinPredicate {
+    expr: ParsedExpression,
+    /// 引用的关系
+    mask: u64,
+    selectivity: f64,
+    /// 引用的列都能定位到关系时才参与连通性
+    resolved: bool,
+}
+
+/// 连接树
+#[derive(Debug, Clone)]
+enum JoinTree {
+    Leaf(usize),
+    Join(Box<JoinTree>, Box<JoinTree>),
+}
+
+impl JoinTree {
+    /// 叶子关系从左到右的顺序
+    fn leaves(&self, out: &mut Vec<usize>) {
+        match self {
+            JoinTree::Leaf(i) => out.push(*i),
+            JoinTree::Join(left, right) => {
+                left.leaves(out);
+                right.leaves(out);
+            }
+        }
+    }
+}
+
+/// 关系子集上的最优计划
+#[derive(Debug, Clone)]
+struct SubPlan {
+    tree: JoinTree,
+    rows: f64,
+    cost: f64,
+}
+
+struct JoinGraph {
+    relations: Vec<Relation>,
+    predicates: Vec<JoinPredicate>,
+    neighbors: Vec<u64>,
+}
+
+impl JoinGraph {
+    fn full_mask(&self) -> u64 {
+        low_mask(self.relations.len() - 1)
+    }
+
+    /// 与 `set` 相邻且不在 `set` 中的关系
+    fn neighborhood(&self, set: u64) -> u64 {
+        bits(set).fold(0, |acc, i| acc | self.neighbors[i]) & !set
+    }
+
+    fn is_connected(&self) -> bool {
+        let full = self.full_mask();
+        let mut reached = 1u64;
+        loop {
+            let next = reached | self.neighborhood(reached);
+            if next == reached {
+                return reached == full;
+            }
+            reached = next;
+        }
+    }
+
+    /// 关系子集的连接结果行数，只与子集有关而与连接顺序无关
+    fn rows(&self, set: u64) -> f64 {
+        let base: f64 = bits(set).map(|i| self.relations[i].rows).product();
+        let selectivity: f64 = self
+            .predicates
+            .iter()
+            .filter(|p| p.mask.count_ones() >= 2 && p.mask & set == p.mask)
+            .map(|p| p.selectivity)
+            .product();
+        (base * selectivity).max(1.0)
+    }
+
+    fn leaf(&self, i: usize) -> SubPlan {
+        SubPlan {
+            tree: JoinTree::Leaf(i),
+            rows: self.relations[i].rows,
+            cost: 0.0,
+        }
+    }
+
+    /// 连接两个子计划，行数较少的一侧作为左侧 (构建侧)
+    fn join(&self, left: &SubPlan, right: &SubPlan, set: u64) -> SubPlan {
+        let rows = self.rows(set);
+        let (build, probe) = if left.rows <= right.rows { (left, right) } else { (right, left) };
+        SubPlan {
+            tree: JoinTree::Join(Box::new(build.tree.clone()), Box::new(probe.tree.clone())),
+            rows,
+            cost: left.cost + right.cost + rows,
+        }
+    }
+}
+
+/// DPccp 枚举状态
+struct DpCcp<'a> {
+    graph: &'a JoinGraph,
+    best: HashMap<u64, SubPlan>,
+    pairs: usize,
+}
+
+impl<'a> DpCcp<'a> {
+    fn solve(graph: &'a JoinGraph) -> (Option<SubPlan>, usize) {
+        let n = graph.relations.len();
+        let mut dp = Self {
+            graph,
+            best: (0..n).map(|i| (1u64 << i, graph.leaf(i))).collect(),
+            pairs: 0,
+        };
+        for i in (0..n).rev() {
+            dp.emit_csg(1 << i);
+            dp.enumerate_csg_rec(1 << i, low_mask(i));
+        }
+        let full = graph.full_mask();
+        (dp.best.remove(&full), dp.pairs)
+    }
+
+    fn enumerate_csg_rec(&mut self, set: u64, excluded: u64) {
+        let neighbors = self.graph.neighborhood(set) & !excluded;
+        if neighbors == 0 {
+            return;
+        }
+        for subset in subsets(neighbors) {
+            self.emit_csg(set | subset);
+        }
+        for subset in subsets(neighbors) {
+            self.enumerate_csg_rec(set | subset, excluded | neighbors);
+        }
+    }
+
+    /// 为连通子图 `s1` 枚举所有连通补集
+    fn emit_csg(&mut self, s1: u64) {
+        let min = s1.trailing_zeros() as usize;
+        let excluded = s1 | low_mask(min);
+        let neighbors = self.graph.neighborhood(s1) & !excluded;
+        for i in bits(neighbors).rev() {
+            let s2 = 1u64 << i;
+            self.emit_pair(s1, s2);
+            self.enumerate_cmp_rec(s1, s2, excluded | (low_mask(i) & neighbors));
+        }
+    }
+
+    fn enumerate_cmp_rec(&mut self, s1: u64, s2: u64, excluded: u64) {
+        let neighbors = self.graph.neighborhood(s2) & !excluded;
+        if neighbors == 0 {
+            return;
+        }
+        for subset in subsets(neighbors) {
+            self.emit_pair(s1, s2 | subset);
+        }
+        for subset in subsets(neighbors) {
+            self.enumerate_cmp_rec(s1, s2 | subset, excluded | neighbors);
+        }
+    }
+
+    fn emit_pair(&mut self, s1: u64, s2: u64) {
+        let (Some(left), Some(right)) = (self.best.get(&s1), self.best.get(&s2)) else {
+            return;
+        };
+        self.pairs += 1;
+        let set = s1 | s2;
+        let candidate = self.graph.join(left, right, set);
+        match self.best.get(&set) {
+            Some(existing) if existing.cost <= candidate.cost => {}
+            _ => {
+                self.best.insert(set, candidate);
+            }
+        }
+    }
+}
+
+/// 贪心连接排序 (GOO)
+fn greedy(graph: &JoinGraph) -> SubPlan {
+    let mut parts: Vec<(u64, SubPlan)> = (0..graph.relations.len()).map(|i| (1u64 << i, graph.leaf(i))).collect();
+    while parts.len() > 1 {
+        let mut choice: Option<(usize, usize, bool, f64)> = None;
+        for a in 0..parts.len() {
+            for b in (a + 1)..parts.len() {
+                let connected = graph.neighborhood(parts[a].0) & parts[b].0 != 0;
+                let rows = graph.rows(parts[a].0 | parts[b].0);
+                let better = match choice {
+                    None => true,
+                    Some((_, _, best_connected, best_rows)) => {
+                        (connected && !best_connected) || (connected == best_connected && rows < best_rows)
+                    }
+                };
+                if better {
+                    choice = Some((a, b, connected, rows));
+                }
+            }
+        }
+        let (a, b, _, _) = choice.expect("at least two parts");
+        let (mask_b, plan_b) = parts.swap_remove(b);
+        let (mask_a, plan_a) = &parts[a];
+        let set = mask_a | mask_b;
+        let joined = graph.join(plan_a, &plan_b, set);
+        parts[a] = (set, joined);
+    }
+    parts.pop().expect("non-empty join graph").1
+}
+
+/// 基于连接选择性的连接重排序
+#[derive(Debug, Clone)]
+pub struct JoinReorderer {
+    config: JoinOrderConfig,
+    cost_model: CostModel,
+    /// 展开 `*` 得到关系的输出列，重排后据此恢复列顺序
+    table_catalog: Arc<TableCatalog>,
+}
+
+impl Default for JoinReorderer {
+    fn default() -> Self {
+        Self::new(JoinOrderConfig::default())
+    }
+}
+
+impl JoinReorderer {
+    pub fn new(config: JoinOrderConfig) -> Self {
+        Self {
+            config,
+            cost_model: CostModel::new(),
+            table_catalog: TableCatalog::global(),
+        }
+    }
+
+    /// 使用指定的表结构目录展开 `*`
+    pub fn with_table_catalog(mut self, catalog: Arc<TableCatalog>) -> Self {
+        self.table_catalog = catalog;
+        self
+    }
+
+    /// 重排计划树中所有连续内连接的顺序
+    pub async fn reorder(&self, node: PlanNode, statistics: &StatisticsManager) -> Result<PlanNode> {
+        let is_join_block = match &node {
+            PlanNode::Join { join_type: JoinType::Inner, .. } => true,
+            PlanNode::Filter { input, .. } => matches!(input.as_ref(), PlanNode::Join { join_type: JoinType::Inner, .. }),
+            _ => false,
+        };
+        if is_join_block && count_relations(&node) <= MAX_RELATIONS {
+            return self.reorder_block(node, statistics).await;
+        }
+
+        Ok(match node {
+            PlanNode::Filter { input, predicate } => PlanNode::Filter {
+                input: Box::new(Box::pin(self.reorder(*input, statistics)).await?),
+                predicate,
+            },
+            PlanNode::Project { input, columns } => PlanNode::Project {
+                input: Box::new(Box::pin(self.reorder(*input, statistics)).await?),
+                columns,
+            },
+            PlanNode::Join { left, right, join_type, condition } => PlanNode::Join {
+                left: Box::new(Box::pin(self.reorder(*left, statistics)).await?),
+                right: Box::new(Box::pin(self.reorder(*right, statistics)).await?),
+                join_type,
+                condition,
+            },
+            PlanNode::Aggregate { input, group_by, aggregates } => PlanNode::Aggregate {
+                input: Box::new(Box::pin(self.reorder(*input, statistics)).await?),
+                group_by,
+                aggregates,
+            },
+            PlanNode::Sort { input, order_by } => PlanNode::Sort {
+                input: Box::new(Box::pin(self.reorder(*input, statistics)).await?),
+                order_by,
+            },
+            PlanNode::Limit { input, limit, offset } => PlanNode::Limit {
+                input: Box::new(Box::pin(self.reorder(*input, statistics)).await?),
+                limit,
+                offset,
+            },
+            leaf @ (PlanNode::TableScan { .. } | PlanNode::IndexScan { .. }) => leaf,
+        })
+    }
+
+    async fn reorder_block(&self, node: PlanNode, statistics: &StatisticsManager) -> Result<PlanNode> {
+        let mut leaves = Vec::new();
+        let mut conjuncts = Vec::new();
+        flatten_join_block(node, &mut leaves, &mut conjuncts);
+
+        let mut relations = Vec::with_capacity(leaves.len());
+        let mut output_columns = Some(Vec::new());
+        for leaf in leaves {
+            let leaf = Box::pin(self.reorder(leaf, statistics)).await?;
+            output_columns = output_columns.zip(self.output_columns(&leaf)).map(|(mut all, columns)| {
+                all.extend(columns);
+                all
+            });
+            let mut tables = Vec::new();
+            collect_tables(&leaf, &mut tables);
+            let rows = Box::pin(self.estimate_rows(&leaf, statistics)).await?;
+            relations.push(Relation { node: Some(leaf), tables, rows });
+        }
+
+        let graph = self.build_graph(relations, conjuncts, statistics).await?;
+        let n = graph.relations.len();
+        let plan = if n <= self.config.dp_threshold && graph.is_connected() {
+            let (plan, pairs) = DpCcp::solve(&graph);
+            debug!("JoinReorder: DPccp over {} relations, {} csg-cmp pairs", n, pairs);
+            plan.unwrap_or_else(|| greedy(&graph))
+        } else {
+            debug!("JoinReorder: greedy ordering for {} relations", n);
+            greedy(&graph)
+        };
+        debug!("JoinReorder: estimated rows {:.0}, C_out {:.0}", plan.rows, plan.cost);
+
+        let mut order = Vec::with_capacity(n);
+        plan.tree.leaves(&mut order);
+        if order.iter().copied().eq(0..n) {
+            return Ok(graph.into_plan(&plan.tree));
+        }
+        match output_columns {
+            Some(columns) => Ok(PlanNode::Project { input: Box::new(graph.into_plan(&plan.tree)), columns }),
+            None => {
+                debug!("JoinReorder: output columns unknown, keeping the original join order");
+                let original = (1..n).fold(JoinTree::Leaf(0), |left, i| {
+                    JoinTree::Join(Box::new(left), Box::new(JoinTree::Leaf(i)))
+                });
+                Ok(graph.into_plan(&original))
+            }
+        }
+    }
+
+    /// 子计划的输出列，扫描的列名带上表名限定；无法确定时返回 None
+    fn output_columns(&self, node: &PlanNode) -> Option<Vec<String>> {
+        match node {
+            PlanNode::TableScan { table, columns } | PlanNode::IndexScan { table, columns, .. } => {
+                let names = if columns.is_empty() || columns.iter().any(|c| c == "*") {
+                    self.table_catalog.columns(table)?.into_iter().map(|c| c.name).collect()
+                } else {
+                    columns.clone()
+                };
+                Some(
+                    names
+                        .into_iter()
+                        .map(|name| if name.contains('.') { name } else { format!("{}.{}", table, name) })
+                        .collect(),
+                )
+            }
+            PlanNode::Project { input, columns } => {
+                if columns.is_empty() || columns.iter().any(|c| c == "*") {
+                    self.output_columns(input)
+                } else {
+                    Some(columns.clone())
+                }
+            }
+            PlanNode::Aggregate { group_by, aggregates, .. } => {
+                Some(group_by.iter().chain(aggregates).cloned().collect())
+            }
+            PlanNode::Join { left, right, .. } => {
+                let mut columns = self.output_columns(left)?;
+                columns.extend(self.output_columns(right)?);
+                Some(columns)
+            }
+            PlanNode::Filter { input, .. } | PlanNode::Sort { input, .. } | PlanNode::Limit { input, .. } => {
+                self.output_columns(input)
+            }
+        }
+    }
+
+    async fn build_graph(
+        &self,
+        mut relations: Vec<Relation>,
+        conjuncts: Vec<ParsedExpression>,
+        statistics: &StatisticsManager,
+    ) -> Result<JoinGraph> {
+        let full = low_mask(relations.len() - 1);
+        let mut predicates = Vec::with_capacity(conjuncts.len());
+
+        for expr in conjuncts {
+            let mut columns = Vec::new();
+            collect_columns(&expr, &mut columns);
+            let mut mask = 0u64;
+            let mut resolved = !columns.is_empty();
+            for column in &columns {
+                match resolve_column(&relations, column, statistics) {
+                    Some(i) => mask |= 1 << i,
+                    None => resolved = false,
+                }
+            }
+            if !resolved {
+                // 无法定位的谓词放在最顶层的连接上
+                mask = full;
+            }
+
+            let selectivity = match mask.count_ones() {
+                1 => {
+                    let i = mask.trailing_zeros() as usize;
+                    let selectivity = match relations[i].tables.as_slice() {
+                        [table] => self.cost_model.estimate_selectivity_with_stats(&expr, statistics, table).await?,
+                        _ => self.cost_model.estimate_selectivity(&expr).await?,
+                    };
+                    relations[i].rows = (relations[i].rows * selectivity).max(1.0);
+                    selectivity
+                }
+                2 if resolved => {
+                    let mut members = bits(mask);
+                    let (a, b) = (members.next().unwrap_or(0), members.next().unwrap_or(0));
+                    let left = relations[a].tables.first().map_or("", String::as_str);
+                    let right = relations[b].tables.first().map_or("", String::as_str);
+                    self.cost_model.estimate_join_selectivity_with_stats(&expr, statistics, left, right).await?
+                }
+                _ => self.cost_model.estimate_join_selectivity(&expr).await?,
+            };
+            predicates.push(JoinPredicate { expr, mask, selectivity, resolved });
+        }
+
+        let mut neighbors = vec![0u64; relations.len()];
+        for predicate in predicates.iter().filter(|p| p.resolved && p.mask.count_ones() >= 2) {
+            for i in bits(predicate.mask) {
+                neighbors[i] |= predicate.mask & !(1 << i);
+            }
+        }
+
+        Ok(JoinGraph { relations, predicates, neighbors })
+    }
+
+    /// 估算子计划输出行数
+    async fn estimate_rows(&self, node: &PlanNode, statistics: &StatisticsManager) -> Result<f64> {
+        let rows = match node {
+            PlanNode::TableScan { table, .. } | PlanNode::IndexScan { table, .. } => statistics
+                .get_table_statistics(table)
+                .await
+                .map_or(DEFAULT_TABLE_ROWS, |stats| stats.row_count as f64),
+            PlanNode::Filter { input, predicate } => {
+                let rows = Box::pin(self.estimate_rows(input, statistics)).await?;
+                let mut tables = Vec::new();
+                collect_tables(input, &mut tables);
+                let selectivity = match tables.as_slice() {
+                    [table] => self.cost_model.estimate_selectivity_with_stats(predicate, statistics, table).await?,
+                    _ => self.cost_model.estimate_selectivity(predicate).await?,
+                };
+                rows * selectivity
+            }
+            PlanNode::Join { left, right, join_type, condition } => {
+                let left = Box::pin(self.estimate_rows(left, statistics)).await?;
+                let right = Box::pin(self.estimate_rows(right, statistics)).await?;
+                let selectivity = match condition {
+                    Some(condition) => self.cost_model.estimate_join_selectivity(condition).await?,
+                    None => 1.0,
+                };
+                let inner = left * right * selectivity;
+                match join_type {
+                    JoinType::Inner => inner,
+                    JoinType::Left => inner.max(left),
+                    JoinType::Right => inner.max(right),
+                    JoinType::Full => inner.max(left + right),
+                }
+            }
+            PlanNode::Aggregate { input, group_by, .. } => {
+                if group_by.is_empty() {
+                    1.0
+                } else {
+                    Box::pin(self.estimate_rows(input, statistics)).await? * 0.1
+                }
+            }
+            PlanNode::Limit { input, limit, .. } => {
+                Box::pin(self.estimate_rows(input, statistics)).await?.min(*limit as f64)
+            }
+            PlanNode::Project { input, .. } | PlanNode::Sort { input, .. } => {
+                Box::pin(self.estimate_rows(input, statistics)).await?
+            }
+        };
+        Ok(rows.max(1.0))
+    }
+}
+
+impl JoinGraph {
+    /// 按连接树重建计划，每个谓词放在能求值的最低节点上
+    fn into_plan(mut self, tree: &JoinTree) -> PlanNode {
+        let mut placed = vec![false; self.predicates.len()];
+        let (node, _) = self.build_node(tree, &mut placed);
+        node
+    }
+
+    fn build_node(&mut self, tree: &JoinTree, placed: &mut [bool]) -> (PlanNode, u64) {
+        match tree {
+            JoinTree::Leaf(i) => {
+                let mask = 1u64 << i;
+                let node = self.relations[*i].node.take().expect("relation used once");
+                let filters = self.take_predicates(placed, |p| p.mask == mask);
+                let node = match combine(filters) {
+                    Some(predicate) => PlanNode::Filter { input: Box::new(node), predicate },
+                    None => node,
+                };
+                (node, mask)
+            }
+            JoinTree::Join(left, right) => {
+                let (left, left_mask) = self.build_node(left, placed);
+                let (right, right_mask) = self.build_node(right, placed);
+                let set = left_mask | right_mask;
+                let condition = combine(self.take_predicates(placed, |p| p.mask & set == p.mask));
+                let node = PlanNode::Join {
+                    left: Box::new(left),
+                    right: Box::new(right),
+                    join_type: JoinType::Inner,
+                    condition,
+                };
+                (node, set)
+            }
+        }
+    }
+
+    fn take_predicates(&self, placed: &mut [bool], applicable: impl Fn(&JoinPredicate) -> bool) -> Vec<ParsedExpression> {
+        let mut taken = Vec::new();
+        for (i, predicate) in self.predicates.iter().enumerate() {
+            if !placed[i] && applicable(predicate) {
+                placed[i] = true;
+                taken.push(predicate.expr.clone());
+            }
+        }
+        taken
+    }
+}
+
+/// 展平连续的内连接及其上的过滤条件
+fn flatten_join_block(node: PlanNode, leaves: &mut Vec<PlanNode>, conjuncts: &mut Vec<ParsedExpression>) {
+    match node {
+        PlanNode::Join { left, right, join_type: JoinType::Inner, condition } => {
+            flatten_join_block(*left, leaves, conjuncts);
+            flatten_join_block(*right, leaves, conjuncts);
+            if let Some(condition) = condition {
+                split_conjuncts(condition, conjuncts);
+            }
+        }
+        PlanNode::Filter { input, predicate } if matches!(input.as_ref(), PlanNode::Join { join_type: JoinType::Inner, .. }) => {
+            flatten_join_block(*input, leaves, conjuncts);
+            split_conjuncts(predicate, conjuncts);
+        }
+        other => leaves.push(other),
+    }
+}
+
+fn count_relations(node: &PlanNode) -> usize {
+    match node {
+        PlanNode::Join { left, right, join_type: JoinType::Inner, .. } => count_relations(left) + count_relations(right),
+        PlanNode::Filter { input, .. } if matches!(input.as_ref(), PlanNode::Join { join_type: JoinType::Inner, .. }) => {
+            count_relations(input)
+        }
+        _ => 1,
+    }
+}
+
+fn split_conjuncts(expr: ParsedExpression, out: &mut Vec<ParsedExpression>) {
+    match expr {
+        ParsedExpression::BinaryOp { left, operator: ParsedOperator::And, right } => {
+            split_conjuncts(*left, out);
+            split_conjuncts(*right, out);
+        }
+        other => out.push(other),
+    }
+}
+
+fn combine(predicates: Vec<ParsedExpression>) -> Option<ParsedExpression> {
+    predicates.into_iter().reduce(|left, right| ParsedExpression::BinaryOp {
+        left: Box::new(left),
+        operator: ParsedOperator::And,
+        right: Box::new(right),
+    })
+}
+
+fn collect_tables(node: &PlanNode, out: &mut Vec<String>) {
+    match node {
+        PlanNode::TableScan { table, .. } | PlanNode::IndexScan { table, .. } => out.push(table.clone()),
+        PlanNode::Join { left, right, .. } => {
+            collect_tables(left, out);
+            collect_tables(right, out);
+        }
+        PlanNode::Filter { input, .. }
+        | PlanNode::Project { input, .. }
+        | PlanNode::Aggregate { input, .. }
+        | PlanNode::Sort { input, .. }
+        | PlanNode::Limit { input, .. } => collect_tables(input, out),
+    }
+}
+
+fn collect_columns<'a>(expr: &'a ParsedExpression, out: &mut Vec<&'a str>) {
+    match expr {
+        ParsedExpression::Column(name) => out.push(name),
+        ParsedExpression::BinaryOp { left, right, .. } => {
+            collect_columns(left, out);
+            collect_columns(right, out);
+        }
+        ParsedExpression::Function { arguments, .. } => arguments.iter().for_each(|arg| collect_columns(arg, out)),
+        ParsedExpression::Literal(_) | ParsedExpression::Parameter(_) => {}
+    }
+}
+
+/// 定位列所属的关系：带表名限定的按表名，否则按哪张表有该列的统计信息
+fn resolve_column(relations: &[Relation], column: &str, statistics: &StatisticsManager) -> Option<usize> {
+    if let Some((qualifier, _)) = column.rsplit_once('.') {
+        return relations.iter().position(|r| r.tables.iter().any(|t| t == qualifier));
+    }
+    let mut owners = relations
+        .iter()
+        .enumerate()
+        .filter(|(_, r)| r.tables.iter().any(|t| statistics.column_statistics(t, column).is_some()));
+    match (owners.next(), owners.next()) {
+        (Some((i, _)), None) => Some(i),
+        _ => None,
+    }
+}
+
+/// 下标 0..=i 的位
+fn low_mask(i: usize) -> u64 {
+    if i >= 63 { u64::MAX } else { (1u64 << (i + 1)) - 1 }
+}
+
+/// 位图中为 1 的下标
+fn bits(mask: u64) -> impl DoubleEndedIterator<Item = usize> {
+    (0..64usize).filter(move |i| mask & (1u64 << i) != 0)
+}
+
+/// `mask` 的全部非空子集
+fn subsets(mask: u64) -> impl Iterator<Item = u64> {
+    let mut subset = 0u64;
+    std::iter::from_fn(move || {
+        subset = subset.wrapping_sub(mask) & mask;
+        (subset != 0).then_some(subset)
+    })
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::optimizer::statistics::TableStatistics;
+    use crate::parser::ParsedValue;
+    use crate::storage::TableColumn;
+    use chrono::Utc;
+    use common::DataType;
+
+    fn scan(table: &str) -> PlanNode {
+        PlanNode::TableScan { table: table.to_string(), columns: vec!["*".to_string()] }
+    }
+
+    fn eq(left: &str, right: &str) -> ParsedExpression {
+        ParsedExpression::BinaryOp {
+            left: Box::new(ParsedExpression::Column(left.to_string())),
+            operator: ParsedOperator::Equal,
+            right: Box::new(ParsedExpression::Column(right.to_string())),
+        }
+    }
+
+    fn cross(left: PlanNode, right: PlanNode) -> PlanNode {
+        PlanNode::Join { left: Box::new(left), right: Box::new(right), join_type: JoinType::Inner, condition: None }
+    }
+
+    /// 每张表两列 `id`、`v` 的目录，使 `*` 可以展开
+    fn catalog(tables: &[&str]) -> Arc<TableCatalog> {
+        let catalog = TableCatalog::new();
+        for table in tables {
+            catalog.register(table, vec![TableColumn::new("id", 1, DataType::BigInt), TableColumn::new("v", 2, DataType::BigInt)]);
+        }
+        Arc::new(catalog)
+    }
+
+    async fn statistics(rows: &[(&str, u64)]) -> StatisticsManager {
+        let mut statistics = StatisticsManager::new();
+        for (table, row_count) in rows {
+            statistics
+                .update_table_statistics(
+                    table,
+                    TableStatistics {
+                        table_name: table.to_string(),
+                        row_count: *row_count,
+                        page_count: 1,
+                        avg_row_size: 100.0,
+                        last_analyzed: Utc::now(),
+                        sample_size: 0,
+                        correlation: 0.0,
+                    },
+                )
+                .await;
+        }
+        statistics
+    }
+
+    /// 连接树中叶子表从左到右的顺序
+    fn join_order(node: &PlanNode, out: &mut Vec<String>) {
+        match node {
+            PlanNode::Join { left, right, .. } => {
+                join_order(left, out);
+                join_order(right, out);
+            }
+            PlanNode::Filter { input, .. } | PlanNode::Project { input, .. } => join_order(input, out),
+            PlanNode::TableScan { table, .. } => out.push(table.clone()),
+            _ => {}
+        }
+    }
+
+    fn count_conditions(node: &PlanNode) -> usize {
+        match node {
+            PlanNode::Join { left, right, condition, .. } => {
+                let mut conjuncts = Vec::new();
+                if let Some(condition) = condition {
+                    split_conjuncts(condition.clone(), &mut conjuncts);
+                }
+                conjuncts.len() + count_conditions(left) + count_conditions(right)
+            }
+            PlanNode::Filter { input, predicate } => {
+                let mut conjuncts = Vec::new();
+                split_conjuncts(predicate.clone(), &mut conjuncts);
+                conjuncts.len() + count_conditions(input)
+            }
+            PlanNode::Project { input, .. } => count_conditions(input),
+            _ => 0,
+        }
+    }
+
+    /// 星型查询：FROM 中的顺序先做两个维表的笛卡尔积，重排后每一步都沿谓词连接
+    #[tokio::test]
+    async fn test_reorder_avoids_cross_products() {
+        let statistics = statistics(&[("fact", 1_000_000), ("d1", 100), ("d2", 1000), ("d3", 10)]).await;
+        let plan = PlanNode::Filter {
+            input: Box::new(cross(cross(cross(scan("d1"), scan("d2")), scan("d3")), scan("fact"))),
+            predicate: combine(vec![eq("fact.d1_id", "d1.id"), eq("fact.d2_id", "d2.id"), eq("fact.d3_id", "d3.id")]).unwrap(),
+        };
+
+        let reorderer = JoinReorderer::default().with_table_catalog(catalog(&["fact", "d1", "d2", "d3"]));
+        let reordered = reorderer.reorder(plan, &statistics).await.unwrap();
+        fn check_no_cross(node: &PlanNode) {
+            match node {
+                PlanNode::Join { left, right, condition, .. } => {
+                    assert!(condition.is_some(), "cross product in {:?}", node);
+                    check_no_cross(left);
+                    check_no_cross(right);
+                }
+                PlanNode::Project { input, .. } => check_no_cross(input),
+                _ => {}
+            }
+        }
+        check_no_cross(&reordered);
+        assert_eq!(count_conditions(&reordered), 3);
+    }
+
+    #[tokio::test]
+    async fn test_single_table_predicates_become_leaf_filters() {
+        let statistics = statistics(&[("a", 1000), ("b", 1000)]).await;
+        let filter = ParsedExpression::BinaryOp {
+            left: Box::new(ParsedExpression::Column("a.x".to_string())),
+            operator: ParsedOperator::Equal,
+            right: Box::new(ParsedExpression::Literal(ParsedValue::Number("1".to_string()))),
+        };
+        let plan = PlanNode::Filter {
+            input: Box::new(cross(scan("a"), scan("b"))),
+            predicate: combine(vec![eq("a.id", "b.a_id"), filter]).unwrap(),
+        };
+
+        let reordered = JoinReorderer::default().reorder(plan, &statistics).await.unwrap();
+        // a 经过过滤后更小，作为构建侧放在左边
+        let PlanNode::Join { left, condition, .. } = &reordered else { panic!("expected join, got {:?}", reordered) };
+        assert!(matches!(left.as_ref(), PlanNode::Filter { .. }));
+        assert!(condition.is_some());
+    }
+
+    /// 与在全部子集上穷举的 DPsub 比较，DPccp 应找到同样的最优代价
+    #[test]
+    fn test_dpccp_matches_exhaustive_search() {
+        let mut seed = 7u64;
+        let mut random = move || {
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            seed
+        };
+        for _ in 0..20 {
+            let n = 3 + (random() % 6) as usize;
+            let relations = (0..n)
+                .map(|i| Relation { node: Some(scan(&format!("t{i}"))), tables: vec![format!("t{i}")], rows: (10 + random() % 10_000) as f64 })
+                .collect();
+            // 先连成一条链保证连通，再随机加边
+            let mut predicates = Vec::new();
+            for i in 1..n {
+                let j = (random() % i as u64) as usize;
+                predicates.push((1u64 << i) | (1u64 << j));
+            }
+            for _ in 0..n {
+                let (i, j) = ((random() % n as u64) as usize, (random() % n as u64) as usize);
+                if i != j {
+                    predicates.push((1u64 << i) | (1u64 << j));
+                }
+            }
+            let mut graph = JoinGraph { relations, predicates: Vec::new(), neighbors: vec![0; n] };
+            for mask in predicates {
+                for i in bits(mask) {
+                    graph.neighbors[i] |= mask & !(1 << i);
+                }
+                graph.predicates.push(JoinPredicate {
+                    expr: ParsedExpression::Literal(ParsedValue::Boolean(true)),
+                    mask,
+                    selectivity: 1.0 / (1 + random() % 500) as f64,
+                    resolved: true,
+                });
+            }
+
+            let (plan, _) = DpCcp::solve(&graph);
+            let dp_cost = plan.unwrap().cost;
+
+            // DPsub：按子集大小递增，对每个连通子集尝试所有连通的二分
+            let full = graph.full_mask();
+            let mut best: HashMap<u64, f64> = (0..n).map(|i| (1u64 << i, 0.0)).collect();
+            let mut sets: Vec<u64> = (1..=full).collect();
+            sets.sort_by_key(|s| s.count_ones());
+            for set in sets.into_iter().filter(|s| s.count_ones() >= 2) {
+                for s1 in subsets(set).filter(|&s1| s1 != set) {
+                    let s2 = set & !s1;
+                    if graph.neighborhood(s1) & s2 == 0 {
+                        continue;
+                    }
+                    if let (Some(&c1), Some(&c2)) = (best.get(&s1), best.get(&s2)) {
+                        let cost = c1 + c2 + graph.rows(set);
+                        let entry = best.entry(set).or_insert(f64::MAX);
+                        if cost < *entry {
+                            *entry = cost;
+                        }
+                    }
+                }
+            }
+            let exhaustive = best[&full];
+            assert!((dp_cost - exhaustive).abs() <= exhaustive * 1e-9, "dp {dp_cost} vs exhaustive {exhaustive}");
+        }
+    }
+
+    #[tokio::test]
+    async fn test_greedy_fallback_above_threshold() {
+        let tables: Vec<String> = (0..8).map(|i| format!("t{i}")).collect();
+        let rows: Vec<(&str, u64)> = tables.iter().enumerate().map(|(i, t)| (t.as_str(), 100 * (i as u64 + 1))).collect();
+        let statistics = statistics(&rows).await;
+
+        let mut plan = scan(&tables[0]);
+        for table in &tables[1..] {
+            plan = cross(plan, scan(table));
+        }
+        let chain: Vec<ParsedExpression> = (1..tables.len())
+            .map(|i| eq(&format!("t{}.id", i - 1), &format!("t{}.id", i)))
+            .collect();
+        let plan = PlanNode::Filter { input: Box::new(plan), predicate: combine(chain).unwrap() };
+
+        let names: Vec<&str> = tables.iter().map(String::as_str).collect();
+        let reorderer = JoinReorderer::new(JoinOrderConfig { dp_threshold: 4 }).with_table_catalog(catalog(&names));
+        let reordered = reorderer.reorder(plan, &statistics).await.unwrap();
+        let mut order = Vec::new();
+        join_order(&reordered, &mut order);
+        order.sort();
+        assert_eq!(order, tables);
+        assert_eq!(count_conditions(&reordered), tables.len() - 1);
+    }
+
+    /// 重排改变叶子顺序后，上方的投影恢复 FROM 中的列顺序
+    #[tokio::test]
+    async fn test_reorder_keeps_output_column_order() {
+        let statistics = statistics(&[("big", 1_000_000), ("small", 10)]).await;
+        let plan = PlanNode::Filter {
+            input: Box::new(cross(scan("big"), scan("small"))),
+            predicate: eq("big.small_id", "small.id"),
+        };
+
+        let reorderer = JoinReorderer::default().with_table_catalog(catalog(&["big", "small"]));
+        let reordered = reorderer.reorder(plan.clone(), &statistics).await.unwrap();
+        let PlanNode::Project { input, columns } = &reordered else { panic!("expected projection, got {:?}", reordered) };
+        assert_eq!(columns, &["big.id", "big.v", "small.id", "small.v"]);
+        let mut order = Vec::new();
+        join_order(input, &mut order);
+        assert_eq!(order, ["small", "big"]);
+
+        // 列无法展开时不改变连接顺序
+        let unchanged = JoinReorderer::default().with_table_catalog(Arc::new(TableCatalog::new())).reorder(plan, &statistics).await.unwrap();
+        let mut order = Vec::new();
+        join_order(&unchanged, &mut order);
+        assert_eq!(order, ["big", "small"]);
+        assert_eq!(count_conditions(&unchanged), 1);
+    }
+}
@@ -5,9 +5,15 @@
 pub mod optimizer;
 pub mod cbo;
 pub mod cost_model;
+pub mod join_order;
 pub mod statistics;
+pub mod analyze;
+pub mod plan_cache;
 
 pub use optimizer::*;
 pub use cbo::*;
 pub use cost_model::{CostModel, CostEstimate};
-pub use statistics::{StatisticsManager, StatisticsCollector, TableStatistics, ColumnStatistics, IndexStatistics};
\ No newline at end of file
+pub use join_order::{JoinOrderConfig, JoinReorderer};
+pub use statistics::{StatisticsManager, StatisticsCollector, TableStatistics, ColumnStatistics, IndexStatistics};
+pub use analyze::{AnalyzeConfig, AnalyzeSource, AutoAnalyzeConfig, AutoAnalyzer, HyperLogLog, ReservoirSampler, TableAnalysis};
+pub use plan_cache::{PreparedStatement, SqlFingerprint, fingerprint_sql, parameterize_statement, bind_plan};
@@ -8,6 +8,7 @@ use tracing::{debug, info};
 use crate::parser::{ParsedExpression, ParsedStatement};
 use crate::planner::rbo::RuleBasedOptimizer;
 use crate::optimizer::cbo::CostBasedOptimizer;
+use crate::optimizer::statistics::StatisticsManager;
 
 /// 查询优化器
 pub struct Optimizer {
@@ -29,8 +30,17 @@ impl Optimizer {
         }
     }
 
-    /// 优化查询
+    /// 优化查询，没有收集到的统计信息使用默认估计
     pub async fn optimize(&self, stmt: ParsedStatement) -> Result<OptimizedPlan> {
+        self.optimize_with_statistics(stmt, &StatisticsManager::new()).await
+    }
+
+    /// 基于收集到的统计信息优化查询
+    pub async fn optimize_with_statistics(
+        &self,
+        stmt: ParsedStatement,
+        statistics: &StatisticsManager,
+    ) -> Result<OptimizedPlan> {
         info!("开始查询优化");
         debug!("原始SQL语句类型: {:?}", std::mem::discriminant(&stmt));
 
@@ -44,7 +54,7 @@ impl Optimizer {
 
         // 2. 基于成本的优化 (CBO)
         info!("=== 开始基于成本的优化 (CBO) ===");
-        let final_plan = self.cbo.optimize(rbo_optimized).await?;
+        let final_plan = self.cbo.optimize_with_statistics(rbo_optimized, statistics).await?;
         debug!("CBO优化完成，最终执行计划: {:#?}", final_plan);
         info!("CBO优化后计划节点数: {}", final_plan.nodes.len());
         info!("CBO优化后估计成本: {:.2}", final_plan.estimated_cost);
@@ -71,12 +81,19 @@ impl OptimizedPlan {
             ParsedStatement::Select(select) => {
                 let mut plan_nodes = Vec::new();
 
-                // 为每个表创建扫描节点
-                for table in select.from {
-                    plan_nodes.push(PlanNode::TableScan {
-                        table: table.name,
-                        columns: select.columns.iter().map(|c| c.name.clone()).collect(),
-                    });
+                // 为每个表创建扫描节点，多表按 FROM 中的顺序组成内连接，由连接重排序决定最终顺序
+                let columns: Vec<String> = select.columns.iter().map(|c| c.name.clone()).collect();
+                let scans = select.from.into_iter().map(|table| PlanNode::TableScan {
+                    table: table.name,
+                    columns: columns.clone(),
+                });
+                if let Some(tree) = scans.reduce(|left, right| PlanNode::Join {
+                    left: Box::new(left),
+                    right: Box::new(right),
+                    join_type: JoinType::Inner,
+                    condition: None,
+                }) {
+                    plan_nodes.push(tree);
                 }
 
                 // 如果有 WHERE 条件，添加过滤节点
@@ -0,0 +1,375 @@
+//! 计划缓存与预编译语句
+//!
+//! OLTP 负载里绝大多数语句只是字面量不同。这里提供两层复用：
+//!
+//! - SQL 指纹：词法扫描把数字/字符串/TRUE/FALSE/NULL 字面量替换为 `?`、合并空白并
+//!   统一大小写，字面量按出现顺序收集起来，命中缓存时无需解析就能得到参数值。
+//!   LIMIT / OFFSET 的值不进入计划参数，原样留在指纹里
+//! - 语句参数化：把 `ParsedStatement` 中的字面量替换为 `ParsedExpression::Parameter`，
+//!   优化得到的计划模板在执行前由 [`bind_plan`] 绑定参数
+//!
+//! 计划记录所依赖表的统计版本 (`StatisticsManager::table_epoch`)，统计信息显著漂移后
+//! 缓存的计划会失效并重新优化。
+
+use common::{Error, Result};
+
+use crate::optimizer::optimizer::{OptimizedPlan, PlanNode};
+use crate::parser::{ParsedExpression, ParsedInsertSource, ParsedSelect, ParsedStatement, ParsedValue};
+
+/// SQL 文本指纹
+#[derive(Debug, Clone, PartialEq)]
+pub struct SqlFingerprint {
+    /// 字面量替换为 `?` 后的规范化文本
+    pub normalized: String,
+    /// 按出现顺序收集的字面量
+    pub literals: Vec<ParsedValue>,
+    /// 文本中 `?` / `$n` 占位符的个数
+    pub placeholders: usize,
+}
+
+impl SqlFingerprint {
+    /// 参数化计划在缓存中的键
+    pub fn cache_key(&self) -> String {
+        format!("sql:{}", self.normalized)
+    }
+}
+
+/// 计算 SQL 指纹
+pub fn fingerprint_sql(sql: &str) -> SqlFingerprint {
+    let mut normalized = String::with_capacity(sql.len());
+    let mut literals = Vec::new();
+    let mut placeholders = 0;
+    let mut chars = sql.chars().peekable();
+    let mut pending_space = false;
+    // 前一个字符是否属于标识符，用于区分 `t1` 与数字字面量
+    let mut in_identifier = false;
+    // 前一个关键字或标识符 (小写)，LIMIT / OFFSET 之后的数字原样保留
+    let mut previous_word = String::new();
+
+    while let Some(c) = chars.next() {
+        if c.is_whitespace() {
+            pending_space = !normalized.is_empty();
+            in_identifier = false;
+            continue;
+        }
+        if pending_space {
+            normalized.push(' ');
+            pending_space = false;
+        }
+
+        match c {
+            '\'' => {
+                let mut text = String::new();
+                while let Some(next) = chars.next() {
+                    if next == '\'' {
+                        // '' 是转义的单引号
+                        if chars.peek() == Some(&'\'') {
+                            chars.next();
+                            text.push('\'');
+                            continue;
+                        }
+                        break;
+                    }
+                    text.push(next);
+                }
+                literals.push(ParsedValue::String(text));
+                normalized.push('?');
+                in_identifier = false;
+            }
+            '"' | '`' => {
+                // 带引号的标识符原样保留
+                normalized.push(c);
+                for next in chars.by_ref() {
+                    normalized.push(next);
+                    if next == c {
+                        break;
+                    }
+                }
+                in_identifier = true;
+            }
+            '?' => {
+                placeholders += 1;
+                normalized.push('?');
+                in_identifier = false;
+            }
+            '$' if chars.peek().map_or(false, |d| d.is_ascii_digit()) => {
+                while chars.peek().map_or(false, |d| d.is_ascii_digit()) {
+                    chars.next();
+                }
+                placeholders += 1;
+                normalized.push('?');
+                in_identifier = false;
+            }
+            c if c.is_ascii_digit() && !in_identifier => {
+                let mut number = String::from(c);
+                while let Some(&next) = chars.peek() {
+                    let exponent_sign = (next == '-' || next == '+') && number.ends_with(['e', 'E']);
+                    if next.is_ascii_digit() || next == '.' || next == 'e' || next == 'E' || exponent_sign {
+                        number.push(next);
+                        chars.next();
+                    } else {
+                        break;
+                    }
+                }
+                if matches!(previous_word.as_str(), "limit" | "offset") {
+                    normalized.push_str(&number);
+                } else {
+                    literals.push(ParsedValue::Number(number));
+                    normalized.push('?');
+                }
+                in_identifier = false;
+            }
+            c if (c.is_alphabetic() || c == '_') && !in_identifier => {
+                let mut word: String = c.to_lowercase().collect();
+                while let Some(&next) = chars.peek() {
+                    if !(next.is_alphanumeric() || next == '_') {
+                        break;
+                    }
+                    word.extend(next.to_lowercase());
+                    chars.next();
+                }
+                match word.as_str() {
+                    "true" | "false" => {
+                        literals.push(ParsedValue::Boolean(word == "true"));
+                        normalized.push('?');
+                    }
+                    "null" => {
+                        literals.push(ParsedValue::Null);
+                        normalized.push('?');
+                    }
+                    _ => normalized.push_str(&word),
+                }
+                in_identifier = true;
+                previous_word = word;
+                continue;
+            }
+            c => {
+                normalized.extend(c.to_lowercase());
+                in_identifier = c.is_alphanumeric() || c == '_';
+            }
+        }
+        // LIMIT 与数字之间只能隔着空白
+        previous_word.clear();
+    }
+
+    SqlFingerprint { normalized, literals, placeholders }
+}
+
+/// 把语句中的字面量替换为参数占位符，返回参数化后的语句与按顺序收集的字面量
+pub fn parameterize_statement(stmt: ParsedStatement) -> (ParsedStatement, Vec<ParsedValue>) {
+    let mut literals = Vec::new();
+    let stmt = match stmt {
+        ParsedStatement::Select(select) => ParsedStatement::Select(parameterize_select(select, &mut literals)),
+        ParsedStatement::Insert(mut insert) => {
+            insert.source = match insert.source {
+                ParsedInsertSource::Values(rows) => ParsedInsertSource::Values(
+                    rows.into_iter()
+                        .map(|row| row.into_iter().map(|e| parameterize_expression(e, &mut literals)).collect())
+                        .collect(),
+                ),
+                ParsedInsertSource::Select(select) => ParsedInsertSource::Select(parameterize_select(select, &mut literals)),
+            };
+            ParsedStatement::Insert(insert)
+        }
+        ParsedStatement::Update(mut update) => {
+            for assignment in &mut update.assignments {
+                let value = std::mem::replace(&mut assignment.value, ParsedExpression::Literal(ParsedValue::Null));
+                assignment.value = parameterize_expression(value, &mut literals);
+            }
+            update.where_clause = update.where_clause.map(|e| parameterize_expression(e, &mut literals));
+            ParsedStatement::Update(update)
+        }
+        ParsedStatement::Delete(mut delete) => {
+            delete.where_clause = delete.where_clause.map(|e| parameterize_expression(e, &mut literals));
+            ParsedStatement::Delete(delete)
+        }
+        other => other,
+    };
+    (stmt, literals)
+}
+
+fn parameterize_select(mut select: ParsedSelect, literals: &mut Vec<ParsedValue>) -> ParsedSelect {
+    select.where_clause = select.where_clause.map(|e| parameterize_expression(e, literals));
+    select.group_by = select.group_by.into_iter().map(|e| parameterize_expression(e, literals)).collect();
+    for order_by in &mut select.order_by {
+        let expression = std::mem::replace(&mut order_by.expression, ParsedExpression::Literal(ParsedValue::Null));
+        order_by.expression = parameterize_expression(expression, literals);
+    }
+    select
+}
+
+fn parameterize_expression(expr: ParsedExpression, literals: &mut Vec<ParsedValue>) -> ParsedExpression {
+    match expr {
+        ParsedExpression::Literal(value) => {
+            literals.push(value);
+            ParsedExpression::Parameter(literals.len() - 1)
+        }
+        ParsedExpression::BinaryOp { left, operator, right } => {
+            let left = parameterize_expression(*left, literals);
+            let right = parameterize_expression(*right, literals);
+            ParsedExpression::BinaryOp { left: Box::new(left), operator, right: Box::new(right) }
+        }
+        ParsedExpression::Function { name, arguments } => ParsedExpression::Function {
+            name,
+            arguments: arguments.into_iter().map(|a| parameterize_expression(a, literals)).collect(),
+        },
+        other => other,
+    }
+}
+
+/// 把参数值绑定到计划模板中，返回可执行的计划
+pub fn bind_plan(plan: &OptimizedPlan, parameters: &[ParsedValue]) -> Result<OptimizedPlan> {
+    let nodes = plan.nodes.iter().map(|node| bind_node(node, parameters)).collect::<Result<Vec<_>>>()?;
+    Ok(OptimizedPlan { nodes, estimated_cost: plan.estimated_cost, estimated_rows: plan.estimated_rows })
+}
+
+fn bind_node(node: &PlanNode, parameters: &[ParsedValue]) -> Result<PlanNode> {
+    let bind_input = |input: &PlanNode| bind_node(input, parameters).map(Box::new);
+    Ok(match node {
+        PlanNode::TableScan { .. } | PlanNode::IndexScan { .. } => node.clone(),
+        PlanNode::Filter { input, predicate } => PlanNode::Filter {
+            input: bind_input(input)?,
+            predicate: bind_expression(predicate, parameters)?,
+        },
+        PlanNode::Project { input, columns } => PlanNode::Project { input: bind_input(input)?, columns: columns.clone() },
+        PlanNode::Join { left, right, join_type, condition } => PlanNode::Join {
+            left: bind_input(left)?,
+            right: bind_input(right)?,
+            join_type: join_type.clone(),
+            condition: condition.as_ref().map(|c| bind_expression(c, parameters)).transpose()?,
+        },
+        PlanNode::Aggregate { input, group_by, aggregates } => PlanNode::Aggregate {
+            input: bind_input(input)?,
+            group_by: group_by.clone(),
+            aggregates: aggregates.clone(),
+        },
+        PlanNode::Sort { input, order_by } => PlanNode::Sort { input: bind_input(input)?, order_by: order_by.clone() },
+        PlanNode::Limit { input, limit, offset } => PlanNode::Limit { input: bind_input(input)?, limit: *limit, offset: *offset },
+    })
+}
+
+fn bind_expression(expr: &ParsedExpression, parameters: &[ParsedValue]) -> Result<ParsedExpression> {
+    Ok(match expr {
+        ParsedExpression::Parameter(index) => {
+            let value = parameters
+                .get(*index)
+                .ok_or_else(|| Error::Execution(format!("no value bound for parameter ${}", index + 1)))?;
+            ParsedExpression::Literal(value.clone())
+        }
+        ParsedExpression::BinaryOp { left, operator, right } => ParsedExpression::BinaryOp {
+            left: Box::new(bind_expression(left, parameters)?),
+            operator: *operator,
+            right: Box::new(bind_expression(right, parameters)?),
+        },
+        ParsedExpression::Function { name, arguments } => ParsedExpression::Function {
+            name: name.clone(),
+            arguments: arguments.iter().map(|a| bind_expression(a, parameters)).collect::<Result<Vec<_>>>()?,
+        },
+        other => other.clone(),
+    })
+}
+
+/// 计划扫描的表 (去重，按首次出现顺序)
+pub fn plan_tables(plan: &OptimizedPlan) -> Vec<String> {
+    fn collect(node: &PlanNode, tables: &mut Vec<String>) {
+        match node {
+            PlanNode::TableScan { table, .. } | PlanNode::IndexScan { table, .. } => {
+                if !tables.contains(table) {
+                    tables.push(table.clone());
+                }
+            }
+            PlanNode::Filter { input, .. }
+            | PlanNode::Project { input, .. }
+            | PlanNode::Aggregate { input, .. }
+            | PlanNode::Sort { input, .. }
+            | PlanNode::Limit { input, .. } => collect(input, tables),
+            PlanNode::Join { left, right, .. } => {
+                collect(left, tables);
+                collect(right, tables);
+            }
+        }
+    }
+    let mut tables = Vec::new();
+    for node in &plan.nodes {
+        collect(node, &mut tables);
+    }
+    tables
+}
+
+/// 预编译语句
+///
+/// 只保存解析后的语句和计划缓存的键；计划本身放在共享的计划缓存里，被淘汰或因
+/// 统计漂移失效时由已保存的语句重新优化，执行路径上不再解析 SQL。
+#[derive(Debug, Clone)]
+pub struct PreparedStatement {
+    pub sql: String,
+    pub cache_key: String,
+    pub statement: ParsedStatement,
+    /// 执行时需要绑定的参数个数
+    pub parameter_count: usize,
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::parser::{ParsedColumn, ParsedOperator, ParsedTable};
+
+    #[test]
+    fn test_fingerprint_normalizes_literals() {
+        let a = fingerprint_sql("SELECT name FROM t1 WHERE id = 42 AND name = 'O''Brien'");
+        let b = fingerprint_sql("select  name from t1\n where id = 7 and name = 'x'");
+        assert_eq!(a.normalized, "select name from t1 where id = ? and name = ?");
+        assert_eq!(a.normalized, b.normalized);
+        assert_eq!(
+            a.literals,
+            vec![ParsedValue::Number("42".to_string()), ParsedValue::String("O'Brien".to_string())]
+        );
+        assert_eq!(a.placeholders, 0);
+
+        let prepared = fingerprint_sql("SELECT * FROM users WHERE id = $1 OR age > ?");
+        assert_eq!(prepared.placeholders, 2);
+        assert!(prepared.literals.is_empty());
+        assert_eq!(fingerprint_sql("SELECT 1.5e-3").literals, vec![ParsedValue::Number("1.5e-3".to_string())]);
+
+        // TRUE/FALSE/NULL 是字面量；LIMIT / OFFSET 的值留在指纹里，不同的值不共用计划
+        let flagged = fingerprint_sql("SELECT * FROM t WHERE flag = TRUE AND note <> null LIMIT 10 OFFSET 5");
+        assert_eq!(flagged.normalized, "select * from t where flag = ? and note <> ? limit 10 offset 5");
+        assert_eq!(flagged.literals, vec![ParsedValue::Boolean(true), ParsedValue::Null]);
+        assert_ne!(flagged.cache_key(), fingerprint_sql("SELECT * FROM t WHERE flag = true AND note <> NULL LIMIT 20 OFFSET 5").cache_key());
+        assert_eq!(fingerprint_sql("SELECT truth, null_count FROM t").literals, vec![]);
+    }
+
+    #[test]
+    fn test_parameterize_and_bind_round_trip() {
+        let predicate = ParsedExpression::BinaryOp {
+            left: Box::new(ParsedExpression::Column("age".to_string())),
+            operator: ParsedOperator::GreaterThan,
+            right: Box::new(ParsedExpression::Literal(ParsedValue::Number("18".to_string()))),
+        };
+        let stmt = ParsedStatement::Select(ParsedSelect {
+            columns: vec![ParsedColumn { name: "id".to_string(), alias: None }],
+            from: vec![ParsedTable { name: "users".to_string(), alias: None }],
+            where_clause: Some(predicate),
+            group_by: vec![],
+            order_by: vec![],
+            limit: None,
+            offset: None,
+        });
+
+        let (template, literals) = parameterize_statement(stmt);
+        assert_eq!(literals, vec![ParsedValue::Number("18".to_string())]);
+        let plan = OptimizedPlan::from_statement(template);
+        assert_eq!(plan_tables(&plan), vec!["users".to_string()]);
+        match &plan.nodes[0] {
+            PlanNode::Filter { predicate, .. } => assert_eq!(predicate.to_string(), "(age > $1)"),
+            other => panic!("unexpected plan node {:?}", other),
+        }
+
+        let bound = bind_plan(&plan, &[ParsedValue::Number("65".to_string())]).unwrap();
+        match &bound.nodes[0] {
+            PlanNode::Filter { predicate, .. } => assert_eq!(predicate.to_string(), "(age > 65)"),
+            other => panic!("unexpected plan node {:?}", other),
+        }
+        assert!(bind_plan(&plan, &[]).is_err());
+    }
+}
@@ -3,9 +3,15 @@
 //! 借鉴 PostgreSQL 的统计信息实现
 
 use common::Result;
+use std::cmp::Ordering;
 use std::collections::HashMap;
+use std::sync::Arc;
 use chrono::{DateTime, Utc};
 use crate::parser::ParsedValue;
+use super::analyze::{self, AnalyzeConfig, AnalyzeSource, TableAnalysis};
+
+/// 行数相对变化超过该比例视为统计信息显著漂移
+pub const DEFAULT_STATS_DRIFT_THRESHOLD: f64 = 0.2;
 
 /// 统计信息管理器
 #[derive(Debug, Clone)]
@@ -13,6 +19,13 @@ pub struct StatisticsManager {
     table_stats: HashMap<String, TableStatistics>,
     column_stats: HashMap<String, ColumnStatistics>,
     index_stats: HashMap<String, IndexStatistics>,
+    /// 每张表的统计版本，统计信息显著漂移时递增，缓存的计划据此失效
+    table_epochs: HashMap<String, u64>,
+    drift_threshold: f64,
+    /// 自上次 ANALYZE 以来每张表的修改行数
+    modified_rows: HashMap<String, u64>,
+    /// 每张表上次 ANALYZE 的列，后台刷新时沿用
+    analyzed_columns: HashMap<String, Vec<String>>,
 }
 
 impl StatisticsManager {
@@ -21,14 +34,39 @@ impl StatisticsManager {
             table_stats: HashMap::new(),
             column_stats: HashMap::new(),
             index_stats: HashMap::new(),
+            table_epochs: HashMap::new(),
+            drift_threshold: DEFAULT_STATS_DRIFT_THRESHOLD,
+            modified_rows: HashMap::new(),
+            analyzed_columns: HashMap::new(),
         }
     }
 
+    pub fn set_drift_threshold(&mut self, threshold: f64) {
+        self.drift_threshold = threshold;
+    }
+
     /// 更新表统计信息
+    ///
+    /// 首次收集或行数相对变化超过漂移阈值时递增该表的统计版本。
     pub async fn update_table_statistics(&mut self, table_name: &str, stats: TableStatistics) {
+        let drifted = match self.table_stats.get(table_name) {
+            Some(old) => {
+                let base = old.row_count.max(1) as f64;
+                (stats.row_count as f64 - old.row_count as f64).abs() / base > self.drift_threshold
+            }
+            None => true,
+        };
+        if drifted {
+            *self.table_epochs.entry(table_name.to_string()).or_insert(0) += 1;
+        }
         self.table_stats.insert(table_name.to_string(), stats);
     }
 
+    /// 表的统计版本，从未收集过统计信息的表为 0
+    pub fn table_epoch(&self, table_name: &str) -> u64 {
+        self.table_epochs.get(table_name).copied().unwrap_or(0)
+    }
+
     /// 更新列统计信息
     pub async fn update_column_statistics(&mut self, column_name: &str, stats: ColumnStatistics) {
         self.column_stats.insert(column_name.to_string(), stats);
@@ -54,6 +92,71 @@ impl StatisticsManager {
         self.index_stats.get(index_name)
     }
 
+    /// 按表名和列名获取列统计信息
+    pub fn column_statistics(&self, table_name: &str, column_name: &str) -> Option<&ColumnStatistics> {
+        self.column_stats.get(&format!("{}.{}", table_name, column_name))
+    }
+
+    /// 记录写入造成的修改行数，供后台刷新判断
+    pub fn record_modifications(&mut self, table_name: &str, rows: u64) {
+        *self.modified_rows.entry(table_name.to_string()).or_insert(0) += rows;
+    }
+
+    /// 自上次 ANALYZE 以来的修改行数
+    pub fn modified_rows(&self, table_name: &str) -> u64 {
+        self.modified_rows.get(table_name).copied().unwrap_or(0)
+    }
+
+    /// 修改行数超过 `ratio * row_count` 且不少于 `min_rows` 的表
+    pub fn tables_needing_refresh(&self, ratio: f64, min_rows: u64) -> Vec<String> {
+        let mut tables: Vec<String> = self
+            .modified_rows
+            .iter()
+            .filter(|(table, &modified)| {
+                let row_count = self.table_stats.get(*table).map_or(0, |stats| stats.row_count);
+                modified >= min_rows && modified as f64 >= ratio * row_count as f64
+            })
+            .map(|(table, _)| table.clone())
+            .collect();
+        tables.sort();
+        tables
+    }
+
+    /// 上次 ANALYZE 覆盖的列
+    pub fn analyzed_columns(&self, table_name: &str) -> &[String] {
+        self.analyzed_columns.get(table_name).map_or(&[], Vec::as_slice)
+    }
+
+    /// 应用一次 ANALYZE 的结果
+    ///
+    /// `modified_at_start` 是开始扫描时的修改行数。扫描期间不持有锁，这段时间的写入
+    /// 不在样本里，因此只扣除开始时的计数，不直接清零。
+    pub async fn apply_analysis(&mut self, columns: &[String], analysis: TableAnalysis, modified_at_start: u64) {
+        let table_name = analysis.table.table_name.clone();
+        self.update_table_statistics(&table_name, analysis.table).await;
+        for stats in analysis.columns {
+            let key = format!("{}.{}", table_name, stats.column_name);
+            self.update_column_statistics(&key, stats).await;
+        }
+        let remaining = self.modified_rows(&table_name).saturating_sub(modified_at_start);
+        self.modified_rows.insert(table_name.clone(), remaining);
+        self.analyzed_columns.insert(table_name, columns.to_vec());
+    }
+
+    /// 从数据源采样分析表及其列
+    pub async fn analyze_table_from(
+        &mut self,
+        source: &dyn AnalyzeSource,
+        table_name: &str,
+        columns: &[String],
+        config: &AnalyzeConfig,
+    ) -> Result<()> {
+        let modified_at_start = self.modified_rows(table_name);
+        let analysis = analyze::analyze_table(source, table_name, columns, config).await?;
+        self.apply_analysis(columns, analysis, modified_at_start).await;
+        Ok(())
+    }
+
     /// 分析表统计信息
     pub async fn analyze_table(&mut self, table_name: &str) -> Result<()> {
         // 模拟分析表统计信息
@@ -144,6 +247,128 @@ pub struct ColumnStatistics {
     pub avg_width: f64,
 }
 
+impl ColumnStatistics {
+    /// 非空值所占比例
+    pub fn non_null_fraction(&self, row_count: u64) -> f64 {
+        if row_count == 0 {
+            return 1.0;
+        }
+        (1.0 - self.null_count as f64 / row_count as f64).clamp(0.0, 1.0)
+    }
+
+    fn mcv_total(&self) -> f64 {
+        self.most_common_frequencies.iter().sum()
+    }
+
+    /// `col = value` 的选择性
+    ///
+    /// 命中 MCV 时直接使用其频率；否则把 MCV 之外的剩余比例平均分给其余不同值。
+    pub fn equality_selectivity(&self, value: &ParsedValue, row_count: u64) -> f64 {
+        if *value == ParsedValue::Null {
+            return 0.0;
+        }
+        if let Some(i) = self.most_common_values.iter().position(|mcv| mcv == value) {
+            return self.most_common_frequencies.get(i).copied().unwrap_or(0.0);
+        }
+        let others = self.distinct_count.saturating_sub(self.most_common_values.len() as u64).max(1);
+        let remaining = (self.non_null_fraction(row_count) - self.mcv_total()).max(0.0);
+        (remaining / others as f64).clamp(0.0, 1.0)
+    }
+
+    /// `col < value`（`inclusive` 时为 `<=`）的选择性
+    ///
+    /// MCV 部分逐个比较累加，其余部分按值在等深直方图中的位置线性插值。
+    pub fn less_than_selectivity(&self, value: &ParsedValue, inclusive: bool, row_count: u64) -> f64 {
+        let matches = |candidate: &ParsedValue| match compare_values(candidate, value) {
+            Ordering::Less => true,
+            Ordering::Equal => inclusive,
+            Ordering::Greater => false,
+        };
+        let mcv: f64 = self
+            .most_common_values
+            .iter()
+            .zip(&self.most_common_frequencies)
+            .filter(|(candidate, _)| matches(candidate))
+            .map(|(_, freq)| freq)
+            .sum();
+
+        let remaining = (self.non_null_fraction(row_count) - self.mcv_total()).max(0.0);
+        let histogram = match self.histogram_fraction(value) {
+            Some(fraction) => fraction,
+            // 没有直方图时退回默认范围选择性
+            None => 1.0 / 3.0,
+        };
+        (mcv + remaining * histogram).clamp(0.0, 1.0)
+    }
+
+    /// `low <= col <= high` 的选择性（边界是否包含由调用方分别给出）
+    pub fn range_selectivity(
+        &self,
+        low: Option<(&ParsedValue, bool)>,
+        high: Option<(&ParsedValue, bool)>,
+        row_count: u64,
+    ) -> f64 {
+        let non_null = self.non_null_fraction(row_count);
+        let upper = high.map_or(non_null, |(value, inclusive)| self.less_than_selectivity(value, inclusive, row_count));
+        let lower = low.map_or(0.0, |(value, inclusive)| self.less_than_selectivity(value, !inclusive, row_count));
+        (upper - lower).clamp(0.0, 1.0)
+    }
+
+    /// 直方图中小于 `value` 的比例，直方图为空时返回 `None`
+    fn histogram_fraction(&self, value: &ParsedValue) -> Option<f64> {
+        let bounds = &self.histogram_bounds;
+        if bounds.len() < 2 {
+            return None;
+        }
+        if compare_values(value, &bounds[0]) != Ordering::Greater {
+            return Some(0.0);
+        }
+        if compare_values(value, &bounds[bounds.len() - 1]) != Ordering::Less {
+            return Some(1.0);
+        }
+        // 第一个大于等于 value 的边界
+        let upper = bounds.partition_point(|bound| compare_values(bound, value) == Ordering::Less);
+        let lower = upper - 1;
+        let within = match (numeric(&bounds[lower]), numeric(&bounds[upper]), numeric(value)) {
+            (Some(lo), Some(hi), Some(v)) if hi > lo => (v - lo) / (hi - lo),
+            _ => 0.5,
+        };
+        let buckets = (bounds.len() - 1) as f64;
+        Some((lower as f64 + within) / buckets)
+    }
+}
+
+fn numeric(value: &ParsedValue) -> Option<f64> {
+    match value {
+        ParsedValue::Number(n) => n.parse().ok(),
+        _ => None,
+    }
+}
+
+/// 统计信息中值的全序：NULL 最小，数值按大小比较，其余按文本比较
+pub fn compare_values(a: &ParsedValue, b: &ParsedValue) -> Ordering {
+    match (a, b) {
+        (ParsedValue::Null, ParsedValue::Null) => Ordering::Equal,
+        (ParsedValue::Null, _) => Ordering::Less,
+        (_, ParsedValue::Null) => Ordering::Greater,
+        (ParsedValue::Number(x), ParsedValue::Number(y)) => match (x.parse::<f64>(), y.parse::<f64>()) {
+            (Ok(x), Ok(y)) => x.partial_cmp(&y).unwrap_or(Ordering::Equal),
+            _ => x.cmp(y),
+        },
+        (ParsedValue::Boolean(x), ParsedValue::Boolean(y)) => x.cmp(y),
+        _ => value_text(a).cmp(&value_text(b)),
+    }
+}
+
+fn value_text(value: &ParsedValue) -> String {
+    match value {
+        ParsedValue::Number(n) => n.clone(),
+        ParsedValue::String(s) => s.clone(),
+        ParsedValue::Boolean(b) => b.to_string(),
+        ParsedValue::Null => String::new(),
+    }
+}
+
 /// 索引统计信息
 #[derive(Debug, Clone)]
 pub struct IndexStatistics {
@@ -158,17 +383,39 @@ pub struct IndexStatistics {
 }
 
 /// 统计信息收集器
+///
+/// 设置了数据源时通过采样扫描收集真实统计信息，否则使用估计值。
 pub struct StatisticsCollector {
     manager: StatisticsManager,
+    source: Option<Arc<dyn AnalyzeSource>>,
+    config: AnalyzeConfig,
 }
 
 impl StatisticsCollector {
     pub fn new(manager: StatisticsManager) -> Self {
-        Self { manager }
+        Self { manager, source: None, config: AnalyzeConfig::default() }
+    }
+
+    /// 使用数据源进行采样 ANALYZE
+    pub fn with_source(manager: StatisticsManager, source: Arc<dyn AnalyzeSource>, config: AnalyzeConfig) -> Self {
+        Self { manager, source: Some(source), config }
+    }
+
+    pub fn manager(&self) -> &StatisticsManager {
+        &self.manager
+    }
+
+    pub fn into_manager(self) -> StatisticsManager {
+        self.manager
     }
 
     /// 收集表统计信息
     pub async fn collect_table_statistics(&mut self, table_name: &str) -> Result<()> {
+        if let Some(source) = self.source.clone() {
+            let columns = self.manager.analyzed_columns(table_name).to_vec();
+            return self.manager.analyze_table_from(source.as_ref(), table_name, &columns, &self.config).await;
+        }
+
         // 模拟收集表统计信息
         let row_count = self.estimate_row_count(table_name).await?;
         let page_count = self.estimate_page_count(table_name, row_count).await?;
@@ -191,6 +438,14 @@ impl StatisticsCollector {
 
     /// 收集列统计信息
     pub async fn collect_column_statistics(&mut self, table_name: &str, column_name: &str) -> Result<()> {
+        if let Some(source) = self.source.clone() {
+            let mut columns = self.manager.analyzed_columns(table_name).to_vec();
+            if !columns.iter().any(|c| c == column_name) {
+                columns.push(column_name.to_string());
+            }
+            return self.manager.analyze_table_from(source.as_ref(), table_name, &columns, &self.config).await;
+        }
+
         // 模拟收集列统计信息
         let null_count = self.count_null_values(table_name, column_name).await?;
         let distinct_count = self.count_distinct_values(table_name, column_name).await?;
@@ -353,4 +608,23 @@ mod tests {
         // 测试收集索引统计信息
         collector.collect_index_statistics("idx_users_id", "users").await.unwrap();
     }
-} 
\ No newline at end of file
+
+    #[tokio::test]
+    async fn test_table_epoch_tracks_significant_drift() {
+        let mut manager = StatisticsManager::new();
+        assert_eq!(manager.table_epoch("users"), 0);
+
+        manager.analyze_table("users").await.unwrap();
+        assert_eq!(manager.table_epoch("users"), 1);
+
+        let mut stats = manager.get_table_statistics("users").await.unwrap().clone();
+        // 10% 的变化不算漂移
+        stats.row_count = 11000;
+        manager.update_table_statistics("users", stats.clone()).await;
+        assert_eq!(manager.table_epoch("users"), 1);
+
+        stats.row_count = 20000;
+        manager.update_table_statistics("users", stats).await;
+        assert_eq!(manager.table_epoch("users"), 2);
+    }
+}
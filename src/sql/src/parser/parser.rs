@@ -184,6 +184,8 @@ pub enum ParsedExpression {
         name: String,
         arguments: Vec<ParsedExpression>,
     },
+    /// 预编译语句的参数占位符 (从 0 开始编号)，执行前由 `bind_plan` 替换为字面量
+    Parameter(usize),
 }
 
 /// 解析后的值
@@ -280,6 +282,7 @@ impl std::fmt::Display for ParsedExpression {
                 let args = arguments.iter().map(|arg| arg.to_string()).collect::<Vec<_>>().join(", ");
                 write!(f, "{name}({args})")
             }
+            ParsedExpression::Parameter(index) => write!(f, "${}", index + 1),
         }
     }
 }
@@ -31,7 +31,7 @@ impl RuleBasedPlanner {
         planner.register_rule(Box::new(PredicatePushdownRule));
         planner.register_rule(Box::new(ColumnPruningRule));
         planner.register_rule(Box::new(JoinReorderRule));
-        planner.register_rule(Box::new(IndexSelectionRule));
+        planner.register_rule(Box::new(IndexSelectionRule::default()));
         planner.register_rule(Box::new(OrderByOptimizationRule));
         planner.register_rule(Box::new(GroupByOptimizationRule));
         planner.register_rule(Box::new(DistinctOptimizationRule));
@@ -30,7 +30,7 @@ impl RuleBasedOptimizer {
         optimizer.register_rule(Box::new(PredicatePushdownRule));
         optimizer.register_rule(Box::new(ColumnPruningRule));
         optimizer.register_rule(Box::new(JoinReorderRule));
-        optimizer.register_rule(Box::new(IndexSelectionRule));
+        optimizer.register_rule(Box::new(IndexSelectionRule::default()));
         optimizer.register_rule(Box::new(OrderByOptimizationRule));
         optimizer.register_rule(Box::new(GroupByOptimizationRule));
         optimizer.register_rule(Box::new(DistinctOptimizationRule));
@@ -148,25 +148,30 @@ impl ConstantFoldingRule {
     }
 
     async fn fold_expression(&self, expr: ParsedExpression) -> Result<ParsedExpression> {
+        Ok(self.fold(expr))
+    }
+
+    /// 折叠表达式中两侧均为数值常量的算术运算 (也供表达式编译使用)
+    pub fn fold(&self, expr: ParsedExpression) -> ParsedExpression {
         match expr {
             ParsedExpression::BinaryOp { left, operator, right } => {
-                let folded_left = Box::pin(self.fold_expression(*left)).await?;
-                let folded_right = Box::pin(self.fold_expression(*right)).await?;
+                let folded_left = self.fold(*left);
+                let folded_right = self.fold(*right);
 
                 // 尝试常量求值
                 if let (ParsedExpression::Literal(left_val), ParsedExpression::Literal(right_val)) = (&folded_left, &folded_right) {
                     if let Some(result) = self.evaluate_binary_op(left_val, operator, right_val) {
-                        return Ok(ParsedExpression::Literal(result));
+                        return ParsedExpression::Literal(result);
                     }
                 }
 
-                Ok(ParsedExpression::BinaryOp {
+                ParsedExpression::BinaryOp {
                     left: Box::new(folded_left),
                     operator,
                     right: Box::new(folded_right),
-                })
+                }
             }
-            _ => Ok(expr),
+            _ => expr,
         }
     }
 
@@ -514,8 +519,19 @@ impl PredicatePushdownRule {
 
 // 其他优化规则的结构定义（简化实现）
 pub struct ColumnPruningRule;
+/// 连接重排序规则
+///
+/// 规则阶段没有统计信息，各表按默认行数估计，主要作用是让每一步连接都沿着
+/// 连接谓词进行、避免笛卡尔积；CBO 阶段会基于收集到的统计信息重新排序。
 pub struct JoinReorderRule;
-pub struct IndexSelectionRule;
+/// 索引选择规则
+///
+/// 表扫描上的过滤条件能完整翻译为位图条件、且涉及的列都建有位图索引时，把表扫描换成
+/// 位图索引扫描 (`index` 为 `bitmap:` 加逗号分隔的索引名)。Filter 保留在上方，
+/// 索引只需返回匹配行的超集。
+pub struct IndexSelectionRule {
+    catalog: Arc<BitmapIndexCatalog>,
+}
 pub struct OrderByOptimizationRule;
 pub struct GroupByOptimizationRule;
 pub struct DistinctOptimizationRule;
@@ -531,13 +547,97 @@ impl OptimizationRule for ColumnPruningRule {
 #[async_trait]
 impl OptimizationRule for JoinReorderRule {
     fn name(&self) -> &str { "JoinReorder" }
-    async fn apply(&self, plan: OptimizedPlan) -> Result<OptimizedPlan> { Ok(plan) }
+
+    async fn apply(&self, plan: OptimizedPlan) -> Result<OptimizedPlan> {
+        let reorderer = JoinReorderer::default();
+        let statistics = StatisticsManager::new();
+        let mut optimized_nodes = Vec::new();
+
+        for node in plan.nodes {
+            optimized_nodes.push(reorderer.reorder(node, &statistics).await?);
+        }
+
+        Ok(OptimizedPlan {
+            nodes: optimized_nodes,
+            estimated_cost: plan.estimated_cost,
+            estimated_rows: plan.estimated_rows,
+        })
+    }
+}
+
+impl Default for IndexSelectionRule {
+    fn default() -> Self {
+        Self::new(BitmapIndexCatalog::global())
+    }
+}
+
+impl IndexSelectionRule {
+    pub fn new(catalog: Arc<BitmapIndexCatalog>) -> Self {
+        Self { catalog }
+    }
+
+    fn select_indexes(&self, node: PlanNode) -> PlanNode {
+        match node {
+            PlanNode::Filter { input, predicate } => {
+                let input = match *input {
+                    PlanNode::TableScan { table, columns } => match self.bitmap_index_for(&table, &predicate) {
+                        Some(index) => {
+                            debug!("IndexSelection: {} 的过滤条件改走位图索引 {}", table, index);
+                            PlanNode::IndexScan { table, index, columns }
+                        }
+                        None => PlanNode::TableScan { table, columns },
+                    },
+                    other => self.select_indexes(other),
+                };
+                PlanNode::Filter { input: Box::new(input), predicate }
+            }
+            PlanNode::Project { input, columns } => {
+                PlanNode::Project { input: Box::new(self.select_indexes(*input)), columns }
+            }
+            PlanNode::Join { left, right, join_type, condition } => PlanNode::Join {
+                left: Box::new(self.select_indexes(*left)),
+                right: Box::new(self.select_indexes(*right)),
+                join_type,
+                condition,
+            },
+            PlanNode::Aggregate { input, group_by, aggregates } => {
+                PlanNode::Aggregate { input: Box::new(self.select_indexes(*input)), group_by, aggregates }
+            }
+            PlanNode::Sort { input, order_by } => {
+                PlanNode::Sort { input: Box::new(self.select_indexes(*input)), order_by }
+            }
+            PlanNode::Limit { input, limit, offset } => {
+                PlanNode::Limit { input: Box::new(self.select_indexes(*input)), limit, offset }
+            }
+            leaf @ (PlanNode::TableScan { .. } | PlanNode::IndexScan { .. }) => leaf,
+        }
+    }
+
+    /// 谓词涉及的每一列都有位图索引时返回所用的索引
+    fn bitmap_index_for(&self, table: &str, predicate: &ParsedExpression) -> Option<String> {
+        let conditions = BitmapCondition::from_predicate(predicate)?;
+        let mut names: Vec<String> = Vec::new();
+        for condition in &conditions {
+            let index = self.catalog.index_for_column(table, &condition.column)?;
+            if !names.contains(&index.name) {
+                names.push(index.name);
+            }
+        }
+        Some(format!("{}{}", BITMAP_INDEX_PREFIX, names.join(",")))
+    }
 }
 
 #[async_trait]
 impl OptimizationRule for IndexSelectionRule {
     fn name(&self) -> &str { "IndexSelection" }
-    async fn apply(&self, plan: OptimizedPlan) -> Result<OptimizedPlan> { Ok(plan) }
+
+    async fn apply(&self, plan: OptimizedPlan) -> Result<OptimizedPlan> {
+        Ok(OptimizedPlan {
+            nodes: plan.nodes.into_iter().map(|node| self.select_indexes(node)).collect(),
+            estimated_cost: plan.estimated_cost,
+            estimated_rows: plan.estimated_rows,
+        })
+    }
 }
 
 #[async_trait]
@@ -571,4 +671,57 @@ impl OptimizationRule for UnionOptimizationRule {
 }
 
 // 从 optimizer 模块导入必要的类型
-use crate::optimizer::optimizer::{OptimizedPlan, PlanNode};
\ No newline at end of file
+use crate::optimizer::optimizer::{OptimizedPlan, PlanNode};
+use crate::optimizer::join_order::JoinReorderer;
+use crate::optimizer::statistics::StatisticsManager;
+use crate::executor::BitmapCondition;
+use crate::storage::bitmap_index::{BitmapIndexCatalog, BITMAP_INDEX_PREFIX};
+use std::sync::Arc;
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::storage::bitmap_index::BitmapIndexDef;
+
+    fn filter(predicate: ParsedExpression) -> PlanNode {
+        PlanNode::Filter {
+            input: Box::new(PlanNode::TableScan { table: "orders".to_string(), columns: vec!["id".to_string()] }),
+            predicate,
+        }
+    }
+
+    fn eq(column: &str, value: &str) -> ParsedExpression {
+        ParsedExpression::BinaryOp {
+            left: Box::new(ParsedExpression::Column(column.to_string())),
+            operator: ParsedOperator::Equal,
+            right: Box::new(ParsedExpression::Literal(ParsedValue::String(value.to_string()))),
+        }
+    }
+
+    #[tokio::test]
+    async fn test_index_selection_uses_bitmap_indexes() {
+        let catalog = Arc::new(BitmapIndexCatalog::new());
+        for (name, column, column_id) in [("by_status", "status", 1), ("by_region", "region", 2)] {
+            catalog.register("orders", BitmapIndexDef { name: name.to_string(), column: column.to_string(), column_id });
+        }
+        let rule = IndexSelectionRule::new(catalog);
+        let and = |left, right| ParsedExpression::BinaryOp { left: Box::new(left), operator: ParsedOperator::And, right: Box::new(right) };
+
+        let plan = OptimizedPlan {
+            nodes: vec![
+                PlanNode::Limit { input: Box::new(filter(and(eq("status", "active"), eq("region", "eu")))), limit: 10, offset: 0 },
+                // tenant 没有索引，保持表扫描
+                filter(and(eq("status", "active"), eq("tenant", "t1"))),
+            ],
+            estimated_cost: 0.0,
+            estimated_rows: 0,
+        };
+        let plan = rule.apply(plan).await.unwrap();
+
+        let PlanNode::Limit { input, .. } = &plan.nodes[0] else { panic!("expected limit") };
+        let PlanNode::Filter { input, .. } = input.as_ref() else { panic!("expected filter") };
+        assert!(matches!(input.as_ref(), PlanNode::IndexScan { index, .. } if index == "bitmap:by_status,by_region"));
+        let PlanNode::Filter { input, .. } = &plan.nodes[1] else { panic!("expected filter") };
+        assert!(matches!(input.as_ref(), PlanNode::TableScan { .. }));
+    }
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+//! 位图索引目录
+//!
+//! 记录每张表上建立了哪些位图索引 (索引名、列名、列 ID)。StorageHandler 据此在写入时
+//! 维护索引，IndexSelectionRule 据此判断过滤条件能否改走位图扫描。
+
+use std::collections::HashMap;
+use std::sync::{Arc, OnceLock, RwLock};
+
+use storage::index::{BitmapIndex, BitmapIndexSet};
+
+/// 位图索引扫描的 `IndexScan::index` 前缀，其后是逗号分隔的索引名
+pub const BITMAP_INDEX_PREFIX: &str = "bitmap:";
+
+/// 一个位图索引的定义
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct BitmapIndexDef {
+    pub name: String,
+    pub column: String,
+    pub column_id: u32,
+}
+
+/// 表名 -> 该表上的位图索引
+#[derive(Debug, Default)]
+pub struct BitmapIndexCatalog {
+    tables: RwLock<HashMap<String, Vec<BitmapIndexDef>>>,
+}
+
+impl BitmapIndexCatalog {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// 进程级目录，未显式指定目录的 StorageHandler 与优化规则共用
+    pub fn global() -> Arc<BitmapIndexCatalog> {
+        static CATALOG: OnceLock<Arc<BitmapIndexCatalog>> = OnceLock::new();
+        CATALOG.get_or_init(|| Arc::new(BitmapIndexCatalog::new())).clone()
+    }
+
+    /// 注册索引；同名索引被覆盖
+    pub fn register(&self, table: &str, def: BitmapIndexDef) {
+        let mut tables = self.tables.write().unwrap();
+        let indexes = tables.entry(table.to_string()).or_default();
+        indexes.retain(|existing| existing.name != def.name);
+        indexes.push(def);
+    }
+
+    /// 删除索引，返回它是否存在
+    pub fn remove(&self, table: &str, name: &str) -> bool {
+        let mut tables = self.tables.write().unwrap();
+        let Some(indexes) = tables.get_mut(table) else { return false };
+        let before = indexes.len();
+        indexes.retain(|existing| existing.name != name);
+        let removed = indexes.len() != before;
+        if indexes.is_empty() {
+            tables.remove(table);
+        }
+        removed
+    }
+
+    pub fn has_indexes(&self, table: &str) -> bool {
+        self.tables.read().unwrap().contains_key(table)
+    }
+
+    /// 列上的位图索引
+    pub fn index_for_column(&self, table: &str, column: &str) -> Option<BitmapIndexDef> {
+        let tables = self.tables.read().unwrap();
+        tables.get(table)?.iter().find(|def| def.column == column).cloned()
+    }
+
+    /// 表上全部索引构成的维护集合，表上没有索引时返回 None
+    pub fn index_set(&self, table: &str) -> Option<BitmapIndexSet> {
+        let tables = self.tables.read().unwrap();
+        let indexes = tables.get(table)?;
+        let indexes = indexes.iter().map(|def| BitmapIndex::new(def.name.clone(), def.column_id)).collect();
+        Some(BitmapIndexSet::new(table, indexes))
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn def(name: &str, column: &str, column_id: u32) -> BitmapIndexDef {
+        BitmapIndexDef { name: name.to_string(), column: column.to_string(), column_id }
+    }
+
+    #[test]
+    fn test_register_lookup_and_remove() {
+        let catalog = BitmapIndexCatalog::new();
+        assert!(catalog.index_set("orders").is_none());
+
+        catalog.register("orders", def("by_status", "status", 1));
+        catalog.register("orders", def("by_region", "region", 2));
+        // 同名重建覆盖旧定义
+        catalog.register("orders", def("by_status", "status", 3));
+
+        assert_eq!(catalog.index_for_column("orders", "status"), Some(def("by_status", "status", 3)));
+        assert_eq!(catalog.index_for_column("orders", "tenant"), None);
+        let set = catalog.index_set("orders").unwrap();
+        assert_eq!(set.indexes().len(), 2);
+
+        assert!(catalog.remove("orders", "by_status"));
+        assert!(!catalog.remove("orders", "by_status"));
+        assert!(catalog.remove("orders", "by_region"));
+        assert!(!catalog.has_indexes("orders"));
+    }
+}
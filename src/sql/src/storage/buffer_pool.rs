@@ -1,98 +1,209 @@
-use common::Result;
-use std::collections::{HashMap, VecDeque};
-use std::sync::{Mutex, RwLock};
-use std::time::Instant;
+use common::{Error, Result};
+use std::collections::HashMap;
+use std::sync::atomic::{AtomicBool, AtomicU32, AtomicU64, AtomicUsize, Ordering};
+use std::sync::{RwLock, RwLockReadGuard, RwLockWriteGuard};
+
+/// 页表分片数，必须是 2 的幂
+const PAGE_TABLE_SHARDS: usize = 64;
+/// 空闲帧的页号标记
+const INVALID_PAGE: usize = usize::MAX;
 
 /// PostgreSQL 风格的缓冲池
+///
+/// 固定数量的帧 (frame) 加分片页表：命中时只取页所在分片的读锁并原子地增加帧的
+/// pin 计数，调用方拿到的是 pin 住的 [`PageGuard`] 而不是页的拷贝，guard 释放时
+/// 自动 unpin。未命中时用 CLOCK 扫描淘汰：跳过被 pin 的帧，引用位置位的帧清位后
+/// 给第二次机会。统计信息全部是原子计数器。
 #[derive(Debug)]
 pub struct BufferPool {
     /// 缓冲池大小 (默认 1GB)
-    #[allow(dead_code)]
     pool_size: usize,
     /// 缓冲区大小 (默认 8KB)
     buffer_size: usize,
-    /// 缓冲区映射
-    buffers: RwLock<HashMap<BufferId, Buffer>>,
+    /// 帧数组，帧数 = pool_size / buffer_size
+    frames: Vec<Frame>,
+    /// 分片页表：页号 -> 帧下标
+    page_table: Vec<RwLock<HashMap<PageId, usize>>>,
+    /// CLOCK 指针
+    clock_hand: AtomicUsize,
     /// 统计信息
-    stats: Mutex<BufferStats>,
-    /// 空闲缓冲区
-    #[allow(dead_code)]
-    free_buffers: Mutex<VecDeque<BufferId>>,
+    stats: AtomicBufferStats,
+}
+
+/// 缓冲帧，页数据在首次装载时才分配
+#[derive(Debug)]
+struct Frame {
+    page_id: AtomicUsize,
+    pin_count: AtomicU32,
+    /// CLOCK 引用位
+    referenced: AtomicBool,
+    dirty: AtomicBool,
+    data: RwLock<Vec<u8>>,
+}
+
+impl Frame {
+    fn new() -> Self {
+        Self {
+            page_id: AtomicUsize::new(INVALID_PAGE),
+            pin_count: AtomicU32::new(0),
+            referenced: AtomicBool::new(false),
+            dirty: AtomicBool::new(false),
+            data: RwLock::new(Vec::new()),
+        }
+    }
+}
+
+#[derive(Debug, Default)]
+struct AtomicBufferStats {
+    access_count: AtomicU64,
+    hit_count: AtomicU64,
+    miss_count: AtomicU64,
+    flush_count: AtomicU64,
+    eviction_count: AtomicU64,
 }
 
 impl BufferPool {
     pub fn new() -> Self {
         let pool_size = 1024 * 1024 * 1024; // 1GB
         let buffer_size = 8 * 1024; // 8KB
-        let buffer_count = pool_size / buffer_size;
-
-        let mut free_buffers = VecDeque::new();
-        for i in 0..buffer_count {
-            free_buffers.push_back(BufferId(i));
-        }
+        Self::with_size(pool_size, buffer_size)
+    }
 
+    /// 按总大小和页大小创建缓冲池，至少保留一个帧
+    pub fn with_size(pool_size: usize, buffer_size: usize) -> Self {
+        let buffer_count = (pool_size / buffer_size.max(1)).max(1);
         Self {
             pool_size,
             buffer_size,
-            buffers: RwLock::new(HashMap::new()),
-            free_buffers: Mutex::new(free_buffers),
-            stats: Mutex::new(BufferStats::new()),
+            frames: (0..buffer_count).map(|_| Frame::new()).collect(),
+            page_table: (0..PAGE_TABLE_SHARDS).map(|_| RwLock::new(HashMap::new())).collect(),
+            clock_hand: AtomicUsize::new(0),
+            stats: AtomicBufferStats::default(),
         }
     }
 
-    /// 获取缓冲区
-    pub fn get_buffer(&self, page_id: PageId) -> Result<Buffer> {
-        let mut stats = self.stats.lock().unwrap();
-        stats.access_count += 1;
+    /// 帧数
+    pub fn capacity(&self) -> usize {
+        self.frames.len()
+    }
 
-        // 检查缓存
-        {
-            let buffers = self.buffers.read().unwrap();
-            if let Some(buffer) = buffers.get(&BufferId(page_id.0)) {
-                stats.hit_count += 1;
-                return Ok(buffer.clone());
-            }
-        }
+    fn shard(&self, page_id: PageId) -> &RwLock<HashMap<PageId, usize>> {
+        // 页号通常是连续的，乘法散列后取高位打散到各分片
+        let hash = (page_id.0 as u64).wrapping_mul(0x9E37_79B9_7F4A_7C15);
+        &self.page_table[(hash >> 58) as usize & (PAGE_TABLE_SHARDS - 1)]
+    }
 
-        // 缓存未命中，需要从磁盘读取
-        stats.miss_count += 1;
-        let buffer = self.load_from_disk(page_id)?;
+    /// 获取页面，返回 pin 住该页所在帧的 guard
+    pub fn get_buffer(&self, page_id: PageId) -> Result<PageGuard<'_>> {
+        self.stats.access_count.fetch_add(1, Ordering::Relaxed);
 
-        // 将缓冲区加入缓存
-        {
-            let mut buffers = self.buffers.write().unwrap();
-            buffers.insert(BufferId(page_id.0), buffer.clone());
+        // 命中路径：分片读锁下 pin 帧，淘汰方需要同一分片的写锁才能摘除映射
+        if let Some(guard) = self.try_pin(page_id) {
+            self.stats.hit_count.fetch_add(1, Ordering::Relaxed);
+            return Ok(guard);
         }
 
-        Ok(buffer)
+        // 缓存未命中：先在不持有目标分片锁的情况下取得一个帧
+        let frame_index = self.claim_frame()?;
+        let frame = &self.frames[frame_index];
+        self.load_from_disk(page_id, frame);
+
+        let mut shard = self.shard(page_id).write().unwrap();
+        if let Some(&existing) = shard.get(&page_id) {
+            // 并发装载了同一页，归还刚取得的帧并使用已有的帧
+            self.frames[existing].pin_count.fetch_add(1, Ordering::AcqRel);
+            self.frames[existing].referenced.store(true, Ordering::Relaxed);
+            drop(shard);
+            frame.page_id.store(INVALID_PAGE, Ordering::Release);
+            frame.pin_count.store(0, Ordering::Release);
+            self.stats.hit_count.fetch_add(1, Ordering::Relaxed);
+            return Ok(PageGuard { pool: self, frame: existing, page_id });
+        }
+        frame.page_id.store(page_id.0, Ordering::Release);
+        shard.insert(page_id, frame_index);
+        self.stats.miss_count.fetch_add(1, Ordering::Relaxed);
+
+        Ok(PageGuard { pool: self, frame: frame_index, page_id })
     }
 
-    /// 从磁盘加载页面
-    fn load_from_disk(&self, page_id: PageId) -> Result<Buffer> {
-        // 模拟从磁盘读取
-        let data = vec![0u8; self.buffer_size];
-        let buffer = Buffer {
-            id: BufferId(page_id.0),
-            page_id,
-            data,
-            dirty: false,
-            access_count: 1,
-            last_access: Instant::now(),
-        };
+    fn try_pin(&self, page_id: PageId) -> Option<PageGuard<'_>> {
+        let shard = self.shard(page_id).read().unwrap();
+        let &frame_index = shard.get(&page_id)?;
+        let frame = &self.frames[frame_index];
+        frame.pin_count.fetch_add(1, Ordering::AcqRel);
+        frame.referenced.store(true, Ordering::Relaxed);
+        Some(PageGuard { pool: self, frame: frame_index, page_id })
+    }
+
+    /// CLOCK 扫描取得一个可用帧，返回时该帧已被 pin 且不在页表中
+    fn claim_frame(&self) -> Result<usize> {
+        let frame_count = self.frames.len();
+        // 两圈足以清掉所有引用位；仍找不到说明所有帧都被 pin 住
+        for _ in 0..frame_count * 2 + 1 {
+            let index = self.clock_hand.fetch_add(1, Ordering::Relaxed) % frame_count;
+            let frame = &self.frames[index];
+            if frame.pin_count.load(Ordering::Acquire) != 0 {
+                continue;
+            }
+            if frame.referenced.swap(false, Ordering::Relaxed) {
+                continue;
+            }
+
+            let old_page = frame.page_id.load(Ordering::Acquire);
+            if old_page == INVALID_PAGE {
+                if frame.pin_count.compare_exchange(0, 1, Ordering::AcqRel, Ordering::Relaxed).is_ok() {
+                    if frame.page_id.load(Ordering::Acquire) == INVALID_PAGE {
+                        return Ok(index);
+                    }
+                    frame.pin_count.fetch_sub(1, Ordering::AcqRel);
+                }
+                continue;
+            }
 
-        Ok(buffer)
+            // 持有旧页分片的写锁时，命中路径无法再 pin 这个帧
+            let old_page = PageId(old_page);
+            let mut shard = self.shard(old_page).write().unwrap();
+            if shard.get(&old_page) != Some(&index) {
+                continue;
+            }
+            if frame.pin_count.compare_exchange(0, 1, Ordering::AcqRel, Ordering::Relaxed).is_err() {
+                continue;
+            }
+            shard.remove(&old_page);
+            drop(shard);
+
+            if frame.dirty.swap(false, Ordering::AcqRel) {
+                // 模拟写回磁盘
+                self.stats.flush_count.fetch_add(1, Ordering::Relaxed);
+            }
+            frame.page_id.store(INVALID_PAGE, Ordering::Release);
+            self.stats.eviction_count.fetch_add(1, Ordering::Relaxed);
+            return Ok(index);
+        }
+        Err(Error::Storage(format!("Buffer pool exhausted: all {} frames are pinned", frame_count)))
+    }
+
+    /// 从磁盘加载页面到帧中，调用方持有该帧唯一的 pin
+    fn load_from_disk(&self, _page_id: PageId, frame: &Frame) {
+        // 模拟从磁盘读取
+        let mut data = frame.data.write().unwrap();
+        data.clear();
+        data.resize(self.buffer_size, 0);
+        frame.dirty.store(false, Ordering::Release);
+        frame.referenced.store(true, Ordering::Relaxed);
     }
 
     /// 刷新脏缓冲区
     pub fn flush_dirty_buffers(&self) -> Result<()> {
-        let mut buffers = self.buffers.write().unwrap();
-        let mut stats = self.stats.lock().unwrap();
-
-        for buffer in buffers.values_mut() {
-            if buffer.dirty {
+        for frame in &self.frames {
+            if frame.page_id.load(Ordering::Acquire) == INVALID_PAGE {
+                continue;
+            }
+            // 持有读锁期间写者无法修改页内容
+            let _data = frame.data.read().unwrap();
+            if frame.dirty.swap(false, Ordering::AcqRel) {
                 // 模拟写入磁盘
-                buffer.dirty = false;
-                stats.flush_count += 1;
+                self.stats.flush_count.fetch_add(1, Ordering::Relaxed);
             }
         }
 
@@ -101,11 +212,17 @@ impl BufferPool {
 
     /// 获取统计信息
     pub fn get_stats(&self) -> BufferStats {
-        self.stats.lock().unwrap().clone()
+        BufferStats {
+            access_count: self.stats.access_count.load(Ordering::Relaxed),
+            hit_count: self.stats.hit_count.load(Ordering::Relaxed),
+            miss_count: self.stats.miss_count.load(Ordering::Relaxed),
+            flush_count: self.stats.flush_count.load(Ordering::Relaxed),
+            eviction_count: self.stats.eviction_count.load(Ordering::Relaxed),
+        }
     }
 }
 
-/// 缓冲区 ID
+/// 缓冲区 ID (帧下标)
 #[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
 pub struct BufferId(usize);
 
@@ -113,15 +230,44 @@ pub struct BufferId(usize);
 #[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
 pub struct PageId(pub usize);
 
-/// 缓冲区
-#[derive(Debug, Clone)]
-pub struct Buffer {
-    pub id: BufferId,
-    pub page_id: PageId,
-    pub data: Vec<u8>,
-    pub dirty: bool,
-    pub access_count: u64,
-    pub last_access: Instant,
+/// pin 住缓冲帧的页面句柄，drop 时 unpin
+#[derive(Debug)]
+pub struct PageGuard<'a> {
+    pool: &'a BufferPool,
+    frame: usize,
+    page_id: PageId,
+}
+
+impl<'a> PageGuard<'a> {
+    pub fn id(&self) -> BufferId {
+        BufferId(self.frame)
+    }
+
+    pub fn page_id(&self) -> PageId {
+        self.page_id
+    }
+
+    /// 只读访问页数据
+    pub fn data(&self) -> RwLockReadGuard<'_, Vec<u8>> {
+        self.pool.frames[self.frame].data.read().unwrap()
+    }
+
+    /// 可写访问页数据，并把页标记为脏
+    pub fn data_mut(&self) -> RwLockWriteGuard<'_, Vec<u8>> {
+        let frame = &self.pool.frames[self.frame];
+        frame.dirty.store(true, Ordering::Release);
+        frame.data.write().unwrap()
+    }
+
+    pub fn is_dirty(&self) -> bool {
+        self.pool.frames[self.frame].dirty.load(Ordering::Acquire)
+    }
+}
+
+impl Drop for PageGuard<'_> {
+    fn drop(&mut self) {
+        self.pool.frames[self.frame].pin_count.fetch_sub(1, Ordering::AcqRel);
+    }
 }
 
 /// 缓冲区统计
@@ -131,6 +277,7 @@ pub struct BufferStats {
     pub hit_count: u64,
     pub miss_count: u64,
     pub flush_count: u64,
+    pub eviction_count: u64,
 }
 
 impl BufferStats {
@@ -140,6 +287,7 @@ impl BufferStats {
             hit_count: 0,
             miss_count: 0,
             flush_count: 0,
+            eviction_count: 0,
         }
     }
 
@@ -155,6 +303,7 @@ impl BufferStats {
 #[cfg(test)]
 mod tests {
     use super::*;
+    use std::sync::Arc;
 
     #[test]
     fn test_buffer_pool_new() {
@@ -169,8 +318,8 @@ mod tests {
         let page_id = PageId(1);
 
         let buffer = buffer_pool.get_buffer(page_id).unwrap();
-        assert_eq!(buffer.page_id, page_id);
-        assert_eq!(buffer.data.len(), 8 * 1024);
+        assert_eq!(buffer.page_id(), page_id);
+        assert_eq!(buffer.data().len(), 8 * 1024);
 
         let stats = buffer_pool.get_stats();
         assert_eq!(stats.access_count, 1);
@@ -199,11 +348,72 @@ mod tests {
         let page_id = PageId(1);
 
         let buffer = buffer_pool.get_buffer(page_id).unwrap();
-        // 模拟标记为脏
-        // 注意：这里我们无法直接修改 buffer，因为它是只读的
-        // 在实际实现中，我们需要提供方法来标记缓冲区为脏
+        buffer.data_mut()[0] = 1;
+        assert!(buffer.is_dirty());
 
         let result = buffer_pool.flush_dirty_buffers();
         assert!(result.is_ok());
+        assert!(!buffer.is_dirty());
+        assert_eq!(buffer_pool.get_stats().flush_count, 1);
+    }
+
+    #[test]
+    fn test_clock_eviction_bounds_frames() {
+        let buffer_pool = BufferPool::with_size(4 * 1024, 1024);
+        assert_eq!(buffer_pool.capacity(), 4);
+
+        for page in 0..16 {
+            let guard = buffer_pool.get_buffer(PageId(page)).unwrap();
+            assert_eq!(guard.page_id(), PageId(page));
+        }
+        let stats = buffer_pool.get_stats();
+        assert_eq!(stats.miss_count, 16);
+        assert_eq!(stats.eviction_count, 12);
+
+        // 脏页被淘汰时写回
+        buffer_pool.get_buffer(PageId(100)).unwrap().data_mut()[0] = 7;
+        for page in 200..208 {
+            buffer_pool.get_buffer(PageId(page)).unwrap();
+        }
+        assert_eq!(buffer_pool.get_stats().flush_count, 1);
     }
-}
\ No newline at end of file
+
+    #[test]
+    fn test_pinned_frames_are_not_evicted() {
+        let buffer_pool = BufferPool::with_size(2 * 1024, 1024);
+        let first = buffer_pool.get_buffer(PageId(1)).unwrap();
+        first.data_mut()[0] = 42;
+        let second = buffer_pool.get_buffer(PageId(2)).unwrap();
+
+        // 两个帧都被 pin 住，再装载新页会失败
+        assert!(buffer_pool.get_buffer(PageId(3)).is_err());
+
+        drop(second);
+        let third = buffer_pool.get_buffer(PageId(3)).unwrap();
+        assert_eq!(third.page_id(), PageId(3));
+        assert_eq!(first.data()[0], 42);
+    }
+
+    #[test]
+    fn test_concurrent_access() {
+        let buffer_pool = Arc::new(BufferPool::with_size(32 * 1024, 1024));
+        let handles: Vec<_> = (0..8)
+            .map(|t| {
+                let pool = buffer_pool.clone();
+                std::thread::spawn(move || {
+                    for i in 0..500 {
+                        let page = PageId((i * 7 + t) % 64);
+                        let guard = pool.get_buffer(page).unwrap();
+                        assert_eq!(guard.page_id(), page);
+                    }
+                })
+            })
+            .collect();
+        for handle in handles {
+            handle.join().unwrap();
+        }
+        let stats = buffer_pool.get_stats();
+        assert_eq!(stats.access_count, 4000);
+        assert_eq!(stats.hit_count + stats.miss_count, 4000);
+    }
+}
@@ -1,110 +1,160 @@
 use common::Result;
 use std::collections::HashMap;
-use std::sync::{Mutex, RwLock};
-use std::time::Instant;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::RwLock;
+use std::time::{Duration, Instant};
 
+use crate::config::CacheConfig;
 use crate::optimizer::OptimizedPlan;
 use crate::executor::execution_models::QueryResult;
+use crate::storage::sharded_cache::ShardedCache;
 
 /// PostgreSQL 风格的缓存管理器
+///
+/// 计划、结果、表统计三类缓存各有独立的字节预算，底层是分片的 W-TinyLFU 缓存
+/// (`storage::sharded_cache`)，查找只锁键所在的分片。结果缓存条目记录所依赖表的
+/// 版本号，表上有写入时 `invalidate_table` 递增版本，旧条目在下次读取时失效。
 pub struct CacheManager {
     /// 查询计划缓存
-    plan_cache: RwLock<HashMap<String, CachedPlan>>,
+    plan_cache: ShardedCache<CachedPlan>,
     /// 结果集缓存
-    result_cache: RwLock<HashMap<String, CachedResult>>,
+    result_cache: ShardedCache<CachedResult>,
     /// 统计信息缓存
-    stats_cache: RwLock<HashMap<String, TableStats>>,
-    /// 缓存统计
-    stats: Mutex<CacheStats>,
+    stats_cache: ShardedCache<TableStats>,
+    /// 表版本号，用于结果缓存失效
+    table_versions: RwLock<HashMap<String, u64>>,
+    /// 因表版本变化而失效的结果缓存读取次数
+    stale_results: AtomicU64,
+    /// 因统计信息漂移而失效的计划缓存读取次数
+    stale_plans: AtomicU64,
 }
 
 impl CacheManager {
     pub fn new() -> Self {
+        Self::with_config(&CacheConfig::default())
+    }
+
+    pub fn with_config(config: &CacheConfig) -> Self {
+        let budget = |enabled: bool, bytes: usize| if enabled { bytes } else { 0 };
+        let mut plan_cache = ShardedCache::new(budget(config.enable_query_plan_cache, config.query_plan_cache_bytes));
+        let mut result_cache = ShardedCache::new(budget(config.enable_result_cache, config.result_cache_bytes));
+        let ttl = Some(Duration::from_secs(config.cache_ttl_seconds)).filter(|ttl| !ttl.is_zero());
+        plan_cache.set_ttl(ttl);
+        result_cache.set_ttl(ttl);
         Self {
-            plan_cache: RwLock::new(HashMap::new()),
-            result_cache: RwLock::new(HashMap::new()),
-            stats_cache: RwLock::new(HashMap::new()),
-            stats: Mutex::new(CacheStats::new()),
+            plan_cache,
+            result_cache,
+            stats_cache: ShardedCache::new(config.table_stats_cache_bytes),
+            table_versions: RwLock::new(HashMap::new()),
+            stale_results: AtomicU64::new(0),
+            stale_plans: AtomicU64::new(0),
         }
     }
 
     /// 缓存查询计划
     pub fn cache_plan(&self, sql: &str, plan: OptimizedPlan) -> Result<()> {
-        let mut stats = self.stats.lock().unwrap();
-        stats.plan_cache_entries += 1;
+        self.cache_plan_with_epochs(sql, plan, Vec::new())
+    }
 
+    /// 缓存查询计划，并记录生成计划时依赖表的统计版本
+    pub fn cache_plan_with_epochs(&self, key: &str, plan: OptimizedPlan, table_epochs: Vec<(String, u64)>) -> Result<()> {
+        let charge = key.len() + plan_size(&plan);
         let cached_plan = CachedPlan {
             plan,
             created_at: Instant::now(),
             access_count: 0,
+            table_epochs,
         };
-
-        let mut cache = self.plan_cache.write().unwrap();
-        cache.insert(sql.to_string(), cached_plan);
+        self.plan_cache.insert(key, cached_plan, charge);
 
         Ok(())
     }
 
+    /// 获取统计版本仍然有效的缓存计划，版本已变化的条目被移除并记为失效
+    pub fn get_current_plan(&self, key: &str, current_epoch: impl Fn(&str) -> u64) -> Option<CachedPlan> {
+        let cached_plan = self.plan_cache.get_with(key, |cached_plan| {
+            cached_plan.access_count += 1;
+            cached_plan.clone()
+        })?;
+        if cached_plan.table_epochs.iter().any(|(table, epoch)| current_epoch(table) != *epoch) {
+            self.plan_cache.remove(key);
+            self.stale_plans.fetch_add(1, Ordering::Relaxed);
+            return None;
+        }
+        Some(cached_plan)
+    }
+
     /// 获取缓存的查询计划
     pub fn get_cached_plan(&self, sql: &str) -> Option<OptimizedPlan> {
-        let mut stats = self.stats.lock().unwrap();
-        stats.plan_cache_lookups += 1;
-
-        let mut cache = self.plan_cache.write().unwrap();
-        if let Some(cached_plan) = cache.get_mut(sql) {
+        self.plan_cache.get_with(sql, |cached_plan| {
             cached_plan.access_count += 1;
-            stats.plan_cache_hits += 1;
-            Some(cached_plan.plan.clone())
-        } else {
-            stats.plan_cache_misses += 1;
-            None
-        }
+            cached_plan.plan.clone()
+        })
     }
 
     /// 缓存查询结果
     pub fn cache_result(&self, key: &str, result: QueryResult) -> Result<()> {
-        let mut stats = self.stats.lock().unwrap();
-        stats.result_cache_entries += 1;
+        self.cache_result_for_tables(key, result, &[])
+    }
 
+    /// 缓存依赖指定表的查询结果，这些表上的写入会使该条目失效
+    pub fn cache_result_for_tables(&self, key: &str, result: QueryResult, tables: &[String]) -> Result<()> {
+        let table_versions = {
+            let versions = self.table_versions.read().unwrap();
+            tables
+                .iter()
+                .map(|table| (table.clone(), versions.get(table).copied().unwrap_or(0)))
+                .collect()
+        };
+        let charge = key.len() + result_size(&result);
         let cached_result = CachedResult {
             result,
             created_at: Instant::now(),
             access_count: 0,
+            table_versions,
         };
-
-        let mut cache = self.result_cache.write().unwrap();
-        cache.insert(key.to_string(), cached_result);
+        self.result_cache.insert(key, cached_result, charge);
 
         Ok(())
     }
 
     /// 获取缓存的查询结果
     pub fn get_cached_result(&self, key: &str) -> Option<QueryResult> {
-        let mut stats = self.stats.lock().unwrap();
-        stats.result_cache_lookups += 1;
-
-        let mut cache = self.result_cache.write().unwrap();
-        if let Some(cached_result) = cache.get_mut(key) {
+        let (result, table_versions) = self.result_cache.get_with(key, |cached_result| {
             cached_result.access_count += 1;
-            stats.result_cache_hits += 1;
-            Some(cached_result.result.clone())
-        } else {
-            stats.result_cache_misses += 1;
-            None
+            (cached_result.result.clone(), cached_result.table_versions.clone())
+        })?;
+
+        let stale = {
+            let versions = self.table_versions.read().unwrap();
+            table_versions
+                .iter()
+                .any(|(table, version)| versions.get(table).copied().unwrap_or(0) != *version)
+        };
+        if stale {
+            self.result_cache.remove(key);
+            self.stale_results.fetch_add(1, Ordering::Relaxed);
+            return None;
         }
+        Some(result)
+    }
+
+    /// 表上发生写入，使依赖该表的结果缓存失效
+    pub fn invalidate_table(&self, table_name: &str) {
+        let mut versions = self.table_versions.write().unwrap();
+        *versions.entry(table_name.to_string()).or_insert(0) += 1;
     }
 
     /// 缓存表统计信息
     pub fn cache_table_stats(&self, table_name: &str, stats: TableStats) -> Result<()> {
-        let mut cache = self.stats_cache.write().unwrap();
-        cache.insert(table_name.to_string(), stats);
+        let charge = table_name.len() + std::mem::size_of::<TableStats>();
+        self.stats_cache.insert(table_name, stats, charge);
         Ok(())
     }
 
     /// 获取缓存的表统计信息
     pub fn get_cached_table_stats(&self, table_name: &str) -> Option<TableStats> {
-        let cache = self.stats_cache.read().unwrap();
-        cache.get(table_name).cloned()
+        self.stats_cache.get(table_name)
     }
 
     /// 清理过期缓存
@@ -112,61 +162,96 @@ impl CacheManager {
         let now = Instant::now();
 
         // 清理过期的查询计划缓存
-        {
-            let mut cache = self.plan_cache.write().unwrap();
-            cache.retain(|_, cached_plan| {
-                now.duration_since(cached_plan.created_at) < max_age
-            });
-        }
+        self.plan_cache.retain(|_, cached_plan, _| now.duration_since(cached_plan.created_at) < max_age);
 
         // 清理过期的结果缓存
-        {
-            let mut cache = self.result_cache.write().unwrap();
-            cache.retain(|_, cached_result| {
-                now.duration_since(cached_result.created_at) < max_age
-            });
-        }
+        self.result_cache.retain(|_, cached_result, _| now.duration_since(cached_result.created_at) < max_age);
 
         // 清理过期的统计信息缓存
-        {
-            let mut cache = self.stats_cache.write().unwrap();
-            cache.retain(|_, table_stats| {
-                now.duration_since(table_stats.last_analyzed) < max_age
-            });
-        }
+        self.stats_cache.retain(|_, table_stats, _| now.duration_since(table_stats.last_analyzed) < max_age);
 
         Ok(())
     }
 
     /// 获取缓存统计
     pub fn get_stats(&self) -> CacheStats {
-        self.stats.lock().unwrap().clone()
+        let load = |counter: &AtomicU64| counter.load(Ordering::Relaxed);
+        let plan = self.plan_cache.counters();
+        let result = self.result_cache.counters();
+        let stale = load(&self.stale_results);
+        let stale_plans = load(&self.stale_plans);
+        CacheStats {
+            plan_cache_entries: self.plan_cache.len() as u64,
+            plan_cache_lookups: load(&plan.lookups),
+            plan_cache_hits: load(&plan.hits) - stale_plans,
+            plan_cache_misses: load(&plan.misses) + stale_plans,
+            plan_cache_evictions: load(&plan.evictions),
+            plan_cache_invalidations: stale_plans,
+            plan_cache_bytes: self.plan_cache.bytes() as u64,
+            result_cache_entries: self.result_cache.len() as u64,
+            result_cache_lookups: load(&result.lookups),
+            result_cache_hits: load(&result.hits) - stale,
+            result_cache_misses: load(&result.misses) + stale,
+            result_cache_evictions: load(&result.evictions),
+            result_cache_invalidations: stale,
+            result_cache_bytes: self.result_cache.bytes() as u64,
+        }
+    }
+
+    /// 以指标形式导出缓存计数：`(指标名, 缓存类型, 值)`
+    pub fn metrics(&self) -> Vec<CacheMetric> {
+        let stats = self.get_stats();
+        let metric = |name, cache, value| CacheMetric { name, cache, value };
+        vec![
+            metric("sealdb_cache_hits_total", "plan", stats.plan_cache_hits),
+            metric("sealdb_cache_misses_total", "plan", stats.plan_cache_misses),
+            metric("sealdb_cache_evictions_total", "plan", stats.plan_cache_evictions),
+            metric("sealdb_cache_invalidations_total", "plan", stats.plan_cache_invalidations),
+            metric("sealdb_cache_entries", "plan", stats.plan_cache_entries),
+            metric("sealdb_cache_bytes", "plan", stats.plan_cache_bytes),
+            metric("sealdb_cache_hits_total", "result", stats.result_cache_hits),
+            metric("sealdb_cache_misses_total", "result", stats.result_cache_misses),
+            metric("sealdb_cache_evictions_total", "result", stats.result_cache_evictions),
+            metric("sealdb_cache_invalidations_total", "result", stats.result_cache_invalidations),
+            metric("sealdb_cache_entries", "result", stats.result_cache_entries),
+            metric("sealdb_cache_bytes", "result", stats.result_cache_bytes),
+        ]
     }
 
     /// 清空所有缓存
     pub fn clear_all_cache(&self) -> Result<()> {
-        {
-            let mut cache = self.plan_cache.write().unwrap();
-            cache.clear();
-        }
-        {
-            let mut cache = self.result_cache.write().unwrap();
-            cache.clear();
-        }
-        {
-            let mut cache = self.stats_cache.write().unwrap();
-            cache.clear();
-        }
+        self.plan_cache.clear();
+        self.result_cache.clear();
+        self.stats_cache.clear();
         Ok(())
     }
 }
 
+/// 计划占用字节的估算：按调试格式的长度计
+fn plan_size(plan: &OptimizedPlan) -> usize {
+    std::mem::size_of::<CachedPlan>() + format!("{:?}", plan.nodes).len()
+}
+
+/// 结果集占用字节的估算：字符串内容加每个字符串的头部
+fn result_size(result: &QueryResult) -> usize {
+    let string_size = |s: &String| s.len() + std::mem::size_of::<String>();
+    std::mem::size_of::<CachedResult>()
+        + result.columns.iter().map(string_size).sum::<usize>()
+        + result
+            .rows
+            .iter()
+            .map(|row| std::mem::size_of::<Vec<String>>() + row.iter().map(string_size).sum::<usize>())
+            .sum::<usize>()
+}
+
 /// 缓存的查询计划
 #[derive(Debug, Clone)]
 pub struct CachedPlan {
     pub plan: OptimizedPlan,
     pub created_at: Instant,
     pub access_count: u64,
+    /// 生成计划时所依赖表的统计版本
+    pub table_epochs: Vec<(String, u64)>,
 }
 
 /// 缓存的查询结果
@@ -175,6 +260,8 @@ pub struct CachedResult {
     pub result: QueryResult,
     pub created_at: Instant,
     pub access_count: u64,
+    /// 缓存时依赖表的版本号
+    pub table_versions: Vec<(String, u64)>,
 }
 
 /// 表统计信息
@@ -204,10 +291,16 @@ pub struct CacheStats {
     pub plan_cache_lookups: u64,
     pub plan_cache_hits: u64,
     pub plan_cache_misses: u64,
+    pub plan_cache_evictions: u64,
+    pub plan_cache_invalidations: u64,
+    pub plan_cache_bytes: u64,
     pub result_cache_entries: u64,
     pub result_cache_lookups: u64,
     pub result_cache_hits: u64,
     pub result_cache_misses: u64,
+    pub result_cache_evictions: u64,
+    pub result_cache_invalidations: u64,
+    pub result_cache_bytes: u64,
 }
 
 impl CacheStats {
@@ -217,10 +310,16 @@ impl CacheStats {
             plan_cache_lookups: 0,
             plan_cache_hits: 0,
             plan_cache_misses: 0,
+            plan_cache_evictions: 0,
+            plan_cache_invalidations: 0,
+            plan_cache_bytes: 0,
             result_cache_entries: 0,
             result_cache_lookups: 0,
             result_cache_hits: 0,
             result_cache_misses: 0,
+            result_cache_evictions: 0,
+            result_cache_invalidations: 0,
+            result_cache_bytes: 0,
         }
     }
 
@@ -241,6 +340,15 @@ impl CacheStats {
     }
 }
 
+/// 导出的缓存指标
+#[derive(Debug, Clone, PartialEq)]
+pub struct CacheMetric {
+    pub name: &'static str,
+    /// 缓存类型标签 (plan/result)
+    pub cache: &'static str,
+    pub value: u64,
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -382,4 +490,50 @@ mod tests {
         let stats = cache_manager.get_stats();
         assert_eq!(stats.plan_cache_hit_rate(), 0.5); // 1命中，1未命中
     }
-}
\ No newline at end of file
+
+    #[test]
+    fn test_write_invalidates_dependent_results() {
+        let cache_manager = CacheManager::new();
+        let result = QueryResult {
+            columns: vec!["id".to_string()],
+            rows: vec![vec!["1".to_string()]],
+            affected_rows: 0,
+            last_insert_id: None,
+        };
+        cache_manager.cache_result_for_tables("q_users", result.clone(), &["users".to_string()]).unwrap();
+        cache_manager.cache_result_for_tables("q_orders", result, &["orders".to_string()]).unwrap();
+        assert!(cache_manager.get_cached_result("q_users").is_some());
+
+        cache_manager.invalidate_table("users");
+        assert!(cache_manager.get_cached_result("q_users").is_none());
+        assert!(cache_manager.get_cached_result("q_orders").is_some());
+
+        let stats = cache_manager.get_stats();
+        assert_eq!(stats.result_cache_invalidations, 1);
+        assert_eq!(stats.result_cache_hits, 2);
+        assert_eq!(stats.result_cache_misses, 1);
+        assert_eq!(stats.result_cache_entries, 1);
+    }
+
+    #[test]
+    fn test_result_cache_respects_byte_budget() {
+        let config = CacheConfig { result_cache_bytes: 64 * 1024, ..CacheConfig::default() };
+        let cache_manager = CacheManager::with_config(&config);
+        for i in 0..2000 {
+            let result = QueryResult {
+                columns: vec!["payload".to_string()],
+                rows: vec![vec!["x".repeat(200)]],
+                affected_rows: 0,
+                last_insert_id: None,
+            };
+            cache_manager.cache_result(&format!("q{}", i), result).unwrap();
+        }
+        let stats = cache_manager.get_stats();
+        assert!(stats.result_cache_bytes <= 64 * 1024);
+        assert!(stats.result_cache_evictions > 0);
+        assert!(cache_manager
+            .metrics()
+            .iter()
+            .any(|m| m.name == "sealdb_cache_evictions_total" && m.cache == "result" && m.value > 0));
+    }
+}
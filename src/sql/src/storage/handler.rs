@@ -3,15 +3,36 @@
 //! 作为 SQL 引擎与存储层之间的桥梁
 
 use ::common::Result;
+use std::collections::HashMap;
+use std::sync::{Arc, Mutex};
+use std::time::Instant;
 
 use crate::executor::execution_models::QueryResult;
+use crate::executor::record_batch::{Field, Schema};
+use crate::metrics::{self, StorageOp};
+use crate::storage::bitmap_index::{BitmapIndexCatalog, BitmapIndexDef};
+use crate::storage::table_catalog::{TableCatalog, TableColumn};
+use crate::storage::cache_manager::CacheManager;
+use crate::storage::pushdown::CoprocessorPlan;
 use storage::*;
+use storage::codec::{self, Datum, DatumRef, RowView};
+use storage::index::{BitmapIndexSet, RoaringBitmap, ZoneMap, ZoneMapConfig, ZonePredicate};
 use storage::{StorageEngine, StorageEngineFactory};
 
 /// 存储处理器
 pub struct StorageHandler {
     factory: StorageEngineFactory,
     default_engine_type: EngineType,
+    /// 写入时需要失效结果缓存的缓存管理器
+    cache_manager: Option<Arc<CacheManager>>,
+    /// 位图索引目录
+    bitmap_catalog: Arc<BitmapIndexCatalog>,
+    /// 表结构目录，列名据此解析为行内列 ID
+    table_catalog: Arc<TableCatalog>,
+    /// 有位图索引的表的写锁：索引维护是读-改-写，同一张表上的写入需要串行
+    index_write_locks: Mutex<HashMap<String, Arc<tokio::sync::Mutex<()>>>>,
+    /// 启用了区间摘要的表；摘要锁在写入期间持有，摘要按写入顺序持久化
+    zone_maps: Mutex<HashMap<String, Arc<tokio::sync::Mutex<ZoneMap>>>>,
 }
 
 impl StorageHandler {
@@ -20,9 +41,61 @@ impl StorageHandler {
         Self {
             factory: StorageEngineFactory::new(),
             default_engine_type: EngineType::TiKV,
+            cache_manager: None,
+            bitmap_catalog: BitmapIndexCatalog::global(),
+            table_catalog: TableCatalog::global(),
+            index_write_locks: Mutex::new(HashMap::new()),
+            zone_maps: Mutex::new(HashMap::new()),
         }
     }
 
+    /// 使用独立的位图索引目录 (默认使用进程级目录)
+    pub fn set_bitmap_catalog(&mut self, catalog: Arc<BitmapIndexCatalog>) {
+        self.bitmap_catalog = catalog;
+    }
+
+    pub fn bitmap_catalog(&self) -> &Arc<BitmapIndexCatalog> {
+        &self.bitmap_catalog
+    }
+
+    /// 使用独立的表结构目录 (默认使用进程级目录)
+    pub fn set_table_catalog(&mut self, catalog: Arc<TableCatalog>) {
+        self.table_catalog = catalog;
+    }
+
+    pub fn table_catalog(&self) -> &Arc<TableCatalog> {
+        &self.table_catalog
+    }
+
+    /// 登记表的列定义，之后的下推与列投影按其中的列 ID 读取行
+    pub fn register_table(&self, table_name: &str, columns: Vec<TableColumn>) {
+        self.table_catalog.register(table_name, columns);
+    }
+
+    /// 表上有位图索引时返回索引集合与该表的写锁
+    async fn lock_indexed_table(&self, table_name: &str) -> Option<(BitmapIndexSet, tokio::sync::OwnedMutexGuard<()>)> {
+        let set = self.bitmap_catalog.index_set(table_name)?;
+        let lock = self.index_write_locks.lock().unwrap().entry(table_name.to_string()).or_default().clone();
+        Some((set, lock.lock_owned().await))
+    }
+
+    /// 关联缓存管理器，写入成功后使该表的结果缓存失效
+    pub fn set_cache_manager(&mut self, cache_manager: Arc<CacheManager>) {
+        self.cache_manager = Some(cache_manager);
+    }
+
+    fn invalidate_cached_results(&self, table_name: &str) {
+        if let Some(cache_manager) = &self.cache_manager {
+            cache_manager.invalidate_table(table_name);
+        }
+    }
+
+    /// 记录一次存储请求的耗时
+    fn record_rpc<T, E>(&self, engine_type: Option<EngineType>, op: StorageOp, started: Instant, result: &std::result::Result<T, E>) {
+        let engine_type = engine_type.unwrap_or(self.default_engine_type);
+        metrics::global().record_storage(engine_type, op, started.elapsed(), result.is_ok());
+    }
+
     /// 设置默认存储引擎
     pub fn set_default_engine(&mut self, engine_type: EngineType) {
         self.default_engine_type = engine_type;
@@ -34,12 +107,14 @@ impl StorageHandler {
     }
 
     /// 获取存储引擎
-    pub async fn get_engine(&self, engine_type: Option<EngineType>) -> Result<Box<dyn StorageEngine>> {
+    pub async fn get_engine(&self, engine_type: Option<EngineType>) -> Result<Arc<dyn StorageEngine>> {
         let engine_type = engine_type.unwrap_or(self.default_engine_type);
         self.factory.get_engine(engine_type).await
     }
 
     /// 执行表扫描
+    ///
+    /// 通过分页流式扫描读取整张表，`limit` 为 `None` 时不截断。
     pub async fn scan_table(
         &self,
         table_name: &str,
@@ -47,31 +122,104 @@ impl StorageHandler {
         limit: Option<u32>,
         engine_type: Option<EngineType>,
     ) -> Result<QueryResult> {
-        let engine = self.get_engine(engine_type).await?;
-        let context = StorageContext::default();
-        let options = StorageOptions::default();
-
-        // 构建扫描范围
-        let start_key = self.build_table_prefix(table_name);
-        let mut end_key = self.build_table_prefix(table_name);
-        end_key.extend_from_slice(b"\xff");
+        let started = Instant::now();
+        let mut stream = self.scan_table_stream(table_name, columns, limit, engine_type).await?;
 
-        // 执行扫描
-        let scan_result = engine.scan(&start_key, &end_key, limit.unwrap_or(1000), &context, &options).await
-            .map_err(|e| ::common::Error::Storage(e.to_string()))?;
-
-        // 转换为查询结果
-        let rows = self.convert_key_values_to_rows(scan_result.value, columns);
+        let mut rows = Vec::new();
+        let scanned = async {
+            while let Some(page) = stream.next_rows().await? {
+                rows.extend(page);
+            }
+            Ok::<_, ::common::Error>(())
+        }
+        .await;
+        self.record_rpc(engine_type, StorageOp::Scan, started, &scanned);
+        scanned?;
 
         let row_count = rows.len();
         Ok(QueryResult {
             rows,
-            columns: columns.to_vec(),
+            columns: stream.columns().to_vec(),
             affected_rows: row_count as u64,
             last_insert_id: None,
         })
     }
 
+    /// 打开表的流式扫描，调用方逐页消费，内存占用与表大小无关
+    pub async fn scan_table_stream(
+        &self,
+        table_name: &str,
+        columns: &[String],
+        limit: Option<u32>,
+        engine_type: Option<EngineType>,
+    ) -> Result<TableScanStream> {
+        let engine = self.get_engine(engine_type).await?;
+        Ok(self.bind_scan(TableScanStream::open(engine, table_name, columns, limit), table_name))
+    }
+
+    /// 打开表中一段行键范围 `[start_key, end_key)` 的流式扫描，供按键范围切分的并行扫描使用
+    pub async fn scan_range_stream(
+        &self,
+        table_name: &str,
+        start_key: Key,
+        end_key: Key,
+        columns: &[String],
+        engine_type: Option<EngineType>,
+    ) -> Result<TableScanStream> {
+        let engine = self.get_engine(engine_type).await?;
+        Ok(self.bind_scan(TableScanStream::open_range(engine, start_key, end_key, columns, None), table_name))
+    }
+
+    /// 扫描输出的列名：表已登记时空或 `*` 展开为全部列，其余情况原样输出
+    fn output_columns(&self, table_name: &str, columns: &[String]) -> Vec<String> {
+        match self.table_catalog.resolve(table_name, columns) {
+            Some(resolved) if columns.is_empty() || columns.iter().any(|c| c == "*") => {
+                resolved.into_iter().map(|c| c.name).collect()
+            }
+            _ => columns.to_vec(),
+        }
+    }
+
+    /// 表已登记时按列 ID 解码扫描出的行；未登记的表按行内顺序解码整行
+    fn bind_scan(&self, stream: TableScanStream, table_name: &str) -> TableScanStream {
+        match self.table_catalog.resolve(table_name, stream.columns()) {
+            Some(resolved) => stream.bind(&resolved),
+            None => stream,
+        }
+    }
+
+    /// 把过滤、投影和部分聚合下推到存储引擎执行，只取回程序的输出
+    ///
+    /// 表有区间摘要时只把可能满足 `plan.zone_predicates` 的行键范围发给存储端，
+    /// 每个范围一个请求，各范围的输出由 `CoprocessorPlan::finish` 合并。
+    pub async fn scan_table_with_pushdown(
+        &self,
+        plan: &CoprocessorPlan,
+        engine_type: Option<EngineType>,
+    ) -> Result<QueryResult> {
+        let engine = self.get_engine(engine_type).await?;
+        let context = StorageContext::default();
+        let options = StorageOptions::default();
+
+        let ranges = self.zone_candidate_ranges(&plan.table, &plan.zone_predicates).await;
+        let mut responses = Vec::with_capacity(ranges.len());
+        for (start_key, end_key) in ranges {
+            let request = CoprocessorRequest::new(start_key, end_key, &plan.program)
+                .map_err(|e| ::common::Error::Serialization(e.to_string()))?;
+            let started = Instant::now();
+            let response = engine.coprocessor(&request, &context, &options).await;
+            self.record_rpc(engine_type, StorageOp::Coprocessor, started, &response);
+            let response = response.map_err(|e| ::common::Error::Storage(e.to_string()))?;
+
+            tracing::debug!(
+                "Coprocessor on {}: scanned {} rows / {} bytes, returned {} bytes",
+                plan.table, response.value.scanned_rows, response.value.scanned_bytes, response.value.returned_bytes
+            );
+            responses.push(response.value);
+        }
+        plan.finish(responses)
+    }
+
     /// 执行点查询
     pub async fn point_query(
         &self,
@@ -87,12 +235,14 @@ impl StorageHandler {
         let key = self.build_row_key(table_name, key_value);
 
         // 执行点查询
-        let get_result = engine.get(&key, &context, &options).await
-            .map_err(|e| ::common::Error::Storage(e.to_string()))?;
+        let started = Instant::now();
+        let get_result = engine.get(&key, &context, &options).await;
+        self.record_rpc(engine_type, StorageOp::Get, started, &get_result);
+        let get_result = get_result.map_err(|e| ::common::Error::Storage(e.to_string()))?;
 
         if let Some(value) = get_result.value.as_ref() {
             // 解析值并转换为行
-            let row = self.parse_value_to_row(&value);
+            let row = Self::parse_value_to_row(&value, None)?;
             Ok(QueryResult {
                 rows: vec![row],
                 columns: vec!["value".to_string()],
@@ -118,16 +268,14 @@ impl StorageHandler {
         engine_type: Option<EngineType>,
     ) -> Result<u64> {
         let engine = self.get_engine(engine_type).await?;
-        let context = StorageContext::default();
-        let options = StorageOptions::default();
 
         // 构建键
         let storage_key = self.build_row_key(table_name, key);
-        let storage_value = value.as_bytes().to_vec();
+        let storage_value = Value::from(codec::encode_row(&[Datum::Bytes(value.as_bytes().to_vec())]));
 
         // 执行插入
-        engine.put(&storage_key, &storage_value, &context, &options).await
-            .map_err(|e| ::common::Error::Storage(e.to_string()))?;
+        self.put_indexed(engine.as_ref(), table_name, &storage_key, &storage_value, engine_type).await?;
+        self.invalidate_cached_results(table_name);
         Ok(1)
     }
 
@@ -145,32 +293,379 @@ impl StorageHandler {
         // 构建键
         let storage_key = self.build_row_key(table_name, key);
 
+        // 有位图索引时先读出旧行，删除后从索引中移除
+        let indexed = self.lock_indexed_table(table_name).await;
+        let old_value = match &indexed {
+            Some(_) => self.get_value(engine.as_ref(), &storage_key, engine_type).await?,
+            None => None,
+        };
+
         // 执行删除
-        engine.delete(&storage_key, &context, &options).await
-            .map_err(|e| ::common::Error::Storage(e.to_string()))?;
+        let started = Instant::now();
+        let delete_result = engine.delete(&storage_key, &context, &options).await;
+        self.record_rpc(engine_type, StorageOp::Delete, started, &delete_result);
+        delete_result.map_err(|e| ::common::Error::Storage(e.to_string()))?;
+
+        if let (Some((set, _guard)), Some(old_value)) = (&indexed, &old_value) {
+            set.on_delete(engine.as_ref(), &storage_key, old_value)
+                .await
+                .map_err(|e| ::common::Error::Storage(e.to_string()))?;
+        }
+        self.invalidate_cached_results(table_name);
         Ok(1)
     }
 
-    /// 构建表前缀
-    fn build_table_prefix(&self, table_name: &str) -> Vec<u8> {
-        format!("table:{}:", table_name).into_bytes()
+    /// 按列 ID 写入一行，主键按 memcomparable 编码，复合主键上的范围扫描按字节有序
+    pub async fn insert_record(
+        &self,
+        table_name: &str,
+        primary_key: &[Datum],
+        columns: &[(u32, Datum)],
+        engine_type: Option<EngineType>,
+    ) -> Result<u64> {
+        let engine = self.get_engine(engine_type).await?;
+
+        let storage_key = codec::record_key(table_name, primary_key);
+        let storage_value = Value::from(codec::encode_row_with_ids(columns));
+
+        self.put_indexed(engine.as_ref(), table_name, &storage_key, &storage_value, engine_type).await?;
+        self.invalidate_cached_results(table_name);
+        Ok(1)
+    }
+
+    /// 写入一行；表上有位图索引时读出被覆盖的旧行并随写入维护索引
+    async fn put_indexed(
+        &self,
+        engine: &dyn StorageEngine,
+        table_name: &str,
+        storage_key: &Key,
+        storage_value: &Value,
+        engine_type: Option<EngineType>,
+    ) -> Result<()> {
+        let indexed = self.lock_indexed_table(table_name).await;
+        let old_value = match &indexed {
+            Some(_) => self.get_value(engine, storage_key, engine_type).await?,
+            None => None,
+        };
+
+        // 区间摘要与行在同一个批量写里落盘，摘要不会落后于它覆盖的数据
+        let zone_map = self.zone_map(table_name);
+        let mut zone_map = match &zone_map {
+            Some(zone_map) => Some(zone_map.lock().await),
+            None => None,
+        };
+        let (context, options) = (StorageContext::default(), StorageOptions::default());
+        let started = Instant::now();
+        let put_result = match zone_map.as_mut() {
+            Some(zone_map) => {
+                let zone = zone_map.observe(storage_key, storage_value).map_err(|e| ::common::Error::Storage(e.to_string()))?;
+                engine.batch_put(&[zone, (storage_key.clone(), storage_value.clone())], &context, &options).await
+            }
+            None => engine.put(storage_key, storage_value, &context, &options).await,
+        };
+        self.record_rpc(engine_type, StorageOp::Put, started, &put_result);
+        put_result.map_err(|e| ::common::Error::Storage(e.to_string()))?;
+        drop(zone_map);
+
+        if let Some((set, _guard)) = &indexed {
+            set.on_insert(engine, storage_key, old_value.as_deref(), storage_value)
+                .await
+                .map_err(|e| ::common::Error::Storage(e.to_string()))?;
+        }
+        Ok(())
+    }
+
+    async fn get_value(&self, engine: &dyn StorageEngine, key: &Key, engine_type: Option<EngineType>) -> Result<Option<Value>> {
+        let started = Instant::now();
+        let get_result = engine.get(key, &StorageContext::default(), &StorageOptions::default()).await;
+        self.record_rpc(engine_type, StorageOp::Get, started, &get_result);
+        Ok(get_result.map_err(|e| ::common::Error::Storage(e.to_string()))?.value)
+    }
+
+    /// 在表的一列上建立位图索引，并为表中已有的行建立索引项
+    pub async fn create_bitmap_index(
+        &self,
+        table_name: &str,
+        index_name: &str,
+        column: &str,
+        column_id: u32,
+        engine_type: Option<EngineType>,
+    ) -> Result<u64> {
+        let engine = self.get_engine(engine_type).await?;
+        self.bitmap_catalog.register(table_name, BitmapIndexDef {
+            name: index_name.to_string(),
+            column: column.to_string(),
+            column_id,
+        });
+        let (_, _guard) = self.lock_indexed_table(table_name).await.expect("index registered above");
+
+        // 只重建新索引，已有索引的行号映射保持不变
+        let set = BitmapIndexSet::new(table_name, vec![storage::index::BitmapIndex::new(index_name, column_id)]);
+        set.rebuild(engine.as_ref()).await.map_err(|e| ::common::Error::Storage(e.to_string()))
+    }
+
+    /// 列取值为 `values` 中任意一个的行号集合
+    pub async fn bitmap_lookup(
+        &self,
+        table_name: &str,
+        column: &str,
+        values: &[String],
+        engine_type: Option<EngineType>,
+    ) -> Result<RoaringBitmap> {
+        let (set, index) = self.bitmap_index_for(table_name, column)?;
+        let engine = self.get_engine(engine_type).await?;
+        let values: Vec<&[u8]> = values.iter().map(|value| value.as_bytes()).collect();
+        let started = Instant::now();
+        let lookup = set.lookup(engine.as_ref(), &index.name, &values).await;
+        self.record_rpc(engine_type, StorageOp::Get, started, &lookup);
+        lookup.map_err(|e| ::common::Error::Storage(e.to_string()))
+    }
+
+    /// 表上全部存活的行号，作为 NOT 条件的全集
+    pub async fn bitmap_live_rows(&self, table_name: &str, engine_type: Option<EngineType>) -> Result<RoaringBitmap> {
+        let set = self.bitmap_catalog.index_set(table_name).ok_or_else(|| {
+            ::common::Error::Execution(format!("table {} has no bitmap index", table_name))
+        })?;
+        let engine = self.get_engine(engine_type).await?;
+        set.live_rows(engine.as_ref()).await.map_err(|e| ::common::Error::Storage(e.to_string()))
+    }
+
+    /// 按位图读取行：行号先批量解析为行键，再批量读取行
+    ///
+    /// 表已登记时按 `columns` 的列 ID 解码 (空或 `*` 表示全部列)，与表扫描的输出一致；
+    /// 未登记的表按行内顺序解码整行。
+    pub async fn fetch_rows_by_bitmap(
+        &self,
+        table_name: &str,
+        rows: &RoaringBitmap,
+        columns: &[String],
+        engine_type: Option<EngineType>,
+    ) -> Result<QueryResult> {
+        let set = self.bitmap_catalog.index_set(table_name).ok_or_else(|| {
+            ::common::Error::Execution(format!("table {} has no bitmap index", table_name))
+        })?;
+        let mut result = QueryResult::new();
+        result.columns = self.output_columns(table_name, columns);
+        let column_ids: Option<Vec<u32>> = self
+            .table_catalog
+            .resolve(table_name, columns)
+            .map(|resolved| resolved.iter().map(|c| c.column_id).collect());
+
+        let engine = self.get_engine(engine_type).await?;
+        let keys = set.record_keys(engine.as_ref(), rows).await.map_err(|e| ::common::Error::Storage(e.to_string()))?;
+        if keys.is_empty() {
+            return Ok(result);
+        }
+
+        let started = Instant::now();
+        let fetched = engine.batch_get(&keys, &StorageContext::default(), &StorageOptions::default()).await;
+        self.record_rpc(engine_type, StorageOp::Get, started, &fetched);
+        let fetched = fetched.map_err(|e| ::common::Error::Storage(e.to_string()))?.value;
+        result.rows = keys
+            .iter()
+            .filter_map(|key| fetched.get(key).cloned().flatten())
+            .map(|value| Self::parse_value_to_row(&value, column_ids.as_deref()))
+            .collect::<Result<_>>()?;
+        result.affected_rows = result.rows.len() as u64;
+        Ok(result)
+    }
+
+    fn zone_map(&self, table_name: &str) -> Option<Arc<tokio::sync::Mutex<ZoneMap>>> {
+        self.zone_maps.lock().unwrap().get(table_name).cloned()
+    }
+
+    /// 为表启用区间摘要：按现有数据重建摘要，返回区间数
+    ///
+    /// 摘要只由本处理器上启用摘要之后的写入维护，每次启用都要重建，剪枝才不会漏行。
+    pub async fn enable_zone_map(
+        &self,
+        table_name: &str,
+        config: ZoneMapConfig,
+        engine_type: Option<EngineType>,
+    ) -> Result<usize> {
+        let engine = self.get_engine(engine_type).await?;
+        let zone_map = ZoneMap::open(engine.as_ref(), table_name, config)
+            .await
+            .map_err(|e| ::common::Error::Storage(e.to_string()))?;
+        let zones = zone_map.zone_count();
+        self.zone_maps.lock().unwrap().insert(table_name.to_string(), Arc::new(tokio::sync::Mutex::new(zone_map)));
+        Ok(zones)
+    }
+
+    /// 需要扫描的行键范围；表没有区间摘要时为整张表
+    pub async fn zone_candidate_ranges(&self, table_name: &str, predicates: &[ZonePredicate]) -> Vec<(Key, Key)> {
+        match self.zone_map(table_name) {
+            Some(zone_map) => zone_map.lock().await.candidate_ranges(predicates),
+            None => vec![Self::table_range(table_name)],
+        }
+    }
+
+    /// 表扫描，先用区间摘要跳过不可能满足 `predicates` 的区间
+    ///
+    /// 返回的行是满足谓词的行的超集，过滤仍由上层完成。
+    pub async fn scan_table_pruned(
+        &self,
+        table_name: &str,
+        columns: &[String],
+        predicates: &[ZonePredicate],
+        limit: Option<u32>,
+        engine_type: Option<EngineType>,
+    ) -> Result<QueryResult> {
+        let ranges = self.zone_candidate_ranges(table_name, predicates).await;
+        tracing::debug!("Zone map on {}: scanning {} key ranges", table_name, ranges.len());
+
+        let engine = self.get_engine(engine_type).await?;
+        let started = Instant::now();
+        let mut result = QueryResult::new();
+        result.columns = self.output_columns(table_name, columns);
+        let scanned = async {
+            for (start_key, end_key) in ranges {
+                let remaining = limit.map(|limit| limit.saturating_sub(result.rows.len() as u32));
+                if remaining == Some(0) {
+                    break;
+                }
+                let stream = TableScanStream::open_range(engine.clone(), start_key, end_key, columns, remaining);
+                let mut stream = self.bind_scan(stream, table_name);
+                while let Some(page) = stream.next_rows().await? {
+                    result.rows.extend(page);
+                }
+            }
+            Ok::<_, ::common::Error>(())
+        }
+        .await;
+        self.record_rpc(engine_type, StorageOp::Scan, started, &scanned);
+        scanned?;
+
+        result.affected_rows = result.rows.len() as u64;
+        Ok(result)
+    }
+
+    fn bitmap_index_for(&self, table_name: &str, column: &str) -> Result<(BitmapIndexSet, BitmapIndexDef)> {
+        let missing = || ::common::Error::Execution(format!("no bitmap index on {}.{}", table_name, column));
+        let index = self.bitmap_catalog.index_for_column(table_name, column).ok_or_else(missing)?;
+        let set = self.bitmap_catalog.index_set(table_name).ok_or_else(missing)?;
+        Ok((set, index))
+    }
+
+    /// 表的行键范围 `[start, end)`
+    fn table_range(table_name: &str) -> (Key, Key) {
+        let start_key = codec::record_prefix(table_name);
+        let end_key = codec::prefix_end(&start_key);
+        (start_key, end_key)
     }
 
-    /// 构建行键
-    fn build_row_key(&self, table_name: &str, key: &str) -> Vec<u8> {
-        format!("{}:{}", table_name, key).into_bytes()
+    /// 构建行键，字符串主键作为单个字节串列编码
+    fn build_row_key(&self, table_name: &str, key: &str) -> Key {
+        codec::record_key(table_name, &[Datum::Bytes(key.as_bytes().to_vec())])
     }
 
     /// 将键值对转换为行数据
-    fn convert_key_values_to_rows(&self, key_values: Vec<KeyValue>, _columns: &[String]) -> Vec<Vec<String>> {
+    fn convert_key_values_to_rows(key_values: Vec<KeyValue>, column_ids: Option<&[u32]>) -> Result<Vec<Vec<String>>> {
         key_values.into_iter()
-            .map(|(_, value)| self.parse_value_to_row(&value))
+            .map(|(_, value)| Self::parse_value_to_row(&value, column_ids))
             .collect()
     }
 
-    /// 解析值到行数据
-    fn parse_value_to_row(&self, value: &[u8]) -> Vec<String> {
-        vec![String::from_utf8_lossy(value).to_string()]
+    /// 解析值到行数据；给出列 ID 时只解码这些列
+    ///
+    /// 列值借用存储层返回的缓冲 (`DatumRef`)，每列只在生成文本时复制一次。
+    fn parse_value_to_row(value: &[u8], column_ids: Option<&[u32]>) -> Result<Vec<String>> {
+        let view = RowView::new(value).map_err(|e| ::common::Error::Deserialization(e.to_string()))?;
+        let text = |datum: std::result::Result<DatumRef<'_>, StorageError>| {
+            datum.map(|datum| datum.to_text()).map_err(|e| ::common::Error::Deserialization(e.to_string()))
+        };
+        match column_ids {
+            Some(column_ids) => column_ids.iter().map(|&id| text(view.get_ref(id))).collect(),
+            None => (0..view.len()).map(|index| text(view.datum_ref_at(index))).collect(),
+        }
+    }
+}
+
+/// 表扫描流
+///
+/// 包装存储层的分页扫描，按页把键值对解码为行；后台预读受有界通道约束。
+pub struct TableScanStream {
+    inner: ScanStream,
+    columns: Vec<String>,
+    /// 投影列 ID，None 表示解码整行
+    column_ids: Option<Vec<u32>>,
+    /// 按表定义绑定后的列类型，未登记的表为 None
+    schema: Option<Schema>,
+}
+
+impl TableScanStream {
+    /// 在给定引擎上打开表的流式扫描
+    pub fn open(engine: Arc<dyn StorageEngine>, table_name: &str, columns: &[String], limit: Option<u32>) -> Self {
+        // 构建扫描范围
+        let (start_key, end_key) = StorageHandler::table_range(table_name);
+        Self::open_range(engine, start_key, end_key, columns, limit)
+    }
+
+    /// 扫描表的一段行键范围 `[start_key, end_key)`
+    pub fn open_range(
+        engine: Arc<dyn StorageEngine>,
+        start_key: Key,
+        end_key: Key,
+        columns: &[String],
+        limit: Option<u32>,
+    ) -> Self {
+        let stream_options = ScanStreamOptions {
+            limit: limit.map(u64::from),
+            ..ScanStreamOptions::default()
+        };
+        let inner = engine.scan_stream(
+            start_key,
+            end_key,
+            stream_options,
+            StorageContext::default(),
+            StorageOptions::default(),
+        );
+
+        Self {
+            inner,
+            columns: columns.to_vec(),
+            column_ids: None,
+            schema: None,
+        }
+    }
+
+    /// 只解码指定列 ID，行中其余列跳过不解码
+    pub fn project(mut self, column_ids: Vec<u32>) -> Self {
+        self.column_ids = Some(column_ids);
+        self
+    }
+
+    /// 按表定义中的列解码，列类型也取自表定义；扫描未指定列 (或为 `*`) 时输出列取列定义的名字
+    pub fn bind(mut self, columns: &[TableColumn]) -> Self {
+        if self.columns.is_empty() || self.columns.iter().any(|c| c == "*") {
+            self.columns = columns.iter().map(|c| c.name.clone()).collect();
+        }
+        let fields = self.columns.iter().zip(columns).map(|(name, c)| Field::new(name.clone(), c.data_type.clone()));
+        self.schema = Some(Schema::new(fields.collect()));
+        self.project(columns.iter().map(|c| c.column_id).collect())
+    }
+
+    /// 读取下一页行数据，扫描结束返回 `None`
+    pub async fn next_rows(&mut self) -> Result<Option<Vec<Vec<String>>>> {
+        let page = self.inner.next_page().await
+            .map_err(|e| ::common::Error::Storage(e.to_string()))?;
+        page.map(|pairs| StorageHandler::convert_key_values_to_rows(pairs, self.column_ids.as_deref()))
+            .transpose()
+    }
+
+    /// 输出列
+    pub fn columns(&self) -> &[String] {
+        &self.columns
+    }
+
+    /// 输出列的类型，扫描按表定义绑定时才有
+    pub fn schema(&self) -> Option<Schema> {
+        self.schema.clone()
+    }
+
+    /// 已读取的行数
+    pub fn rows_read(&self) -> u64 {
+        self.inner.pairs_read()
     }
 }
 
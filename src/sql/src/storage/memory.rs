@@ -1,6 +1,172 @@
+//! 内存管理
+//!
+//! - `MemoryManager`：全局工作内存/共享内存预算。`allocate_*` 返回的缓冲来自按
+//!   2 的幂分级的缓冲池 (`SizeClassPool`)，`free_memory` 归还后可被下一个算子复用，
+//!   避免每个算子都向系统分配并清零整块内存。
+//! - `QueryMemoryContext`：单个查询的内存上下文，持有查询级预算和一个 bump arena
+//!   (`Arena`)；算子的临时数据从 arena 分配，查询结束时随上下文一次性释放。
+//! - `OperatorMemoryContext`：查询内算子级预算。预留时依次检查 算子 → 查询 → 全局
+//!   三级额度，任一级不足即失败，排序、连接、聚合据此决定落盘。
+//!
+//! 三者都实现 `MemoryBudget`，需要申请工作内存的算子只依赖这个 trait。预留通过
+//! `MemoryReservation` / `WorkMemory` 守卫持有，离开作用域 (包括 `?` 提前返回) 时归还。
+
 use common::Result;
 use std::collections::HashMap;
-use std::sync::{Mutex, RwLock};
+use std::ops::{Deref, DerefMut};
+use std::sync::atomic::{AtomicU64, AtomicUsize, Ordering};
+use std::sync::{Arc, Mutex, MutexGuard, RwLock};
+
+/// 工作内存预算
+pub trait MemoryBudget: Send + Sync {
+    /// 预留工作内存 (只记账不分配)，超出预算时返回错误
+    fn reserve_work_memory(&self, size: usize) -> Result<()>;
+
+    /// 归还通过 `reserve_work_memory` 预留的工作内存
+    fn release_work_memory(&self, size: usize);
+
+    /// 当前还可以预留的字节数
+    fn available_work_memory(&self) -> usize;
+}
+
+impl<T: MemoryBudget + ?Sized> MemoryBudget for Arc<T> {
+    fn reserve_work_memory(&self, size: usize) -> Result<()> {
+        (**self).reserve_work_memory(size)
+    }
+
+    fn release_work_memory(&self, size: usize) {
+        (**self).release_work_memory(size)
+    }
+
+    fn available_work_memory(&self) -> usize {
+        (**self).available_work_memory()
+    }
+}
+
+/// 工作内存预留守卫，析构时把额度还给预算
+#[must_use = "预留在守卫析构时立即归还"]
+pub struct MemoryReservation<'a> {
+    budget: &'a dyn MemoryBudget,
+    size: usize,
+}
+
+impl<'a> MemoryReservation<'a> {
+    /// 从预算中预留 `size` 字节，额度不足时返回错误
+    pub fn new(budget: &'a dyn MemoryBudget, size: usize) -> Result<Self> {
+        budget.reserve_work_memory(size)?;
+        Ok(Self { budget, size })
+    }
+
+    pub fn size(&self) -> usize {
+        self.size
+    }
+
+    /// 追加预留 `additional` 字节，额度不足时返回错误且已有预留不变
+    pub fn try_grow(&mut self, additional: usize) -> Result<()> {
+        self.budget.reserve_work_memory(additional)?;
+        self.size += additional;
+        Ok(())
+    }
+}
+
+impl Drop for MemoryReservation<'_> {
+    fn drop(&mut self) {
+        self.budget.release_work_memory(self.size);
+    }
+}
+
+fn insufficient(what: &str, requested: usize, available: usize) -> common::Error {
+    common::Error::Other(format!(
+        "Insufficient {} memory: requested {} bytes, {} available",
+        what, requested, available
+    ))
+}
+
+// ============================================================================
+// 分级缓冲池
+// ============================================================================
+
+/// 最小的缓冲级别 (4KB)
+const MIN_CLASS_SHIFT: u32 = 12;
+/// 最大的缓冲级别 (4MB)，更大的请求直接分配
+const MAX_CLASS_SHIFT: u32 = 22;
+/// 每个级别最多缓存的空闲缓冲数
+const MAX_FREE_PER_CLASS: usize = 8;
+
+/// 按 2 的幂分级的缓冲池
+#[derive(Debug)]
+pub struct SizeClassPool {
+    classes: Vec<Mutex<Vec<Vec<u8>>>>,
+    hits: AtomicU64,
+    misses: AtomicU64,
+}
+
+impl SizeClassPool {
+    pub fn new() -> Self {
+        Self {
+            classes: (MIN_CLASS_SHIFT..=MAX_CLASS_SHIFT).map(|_| Mutex::new(Vec::new())).collect(),
+            hits: AtomicU64::new(0),
+            misses: AtomicU64::new(0),
+        }
+    }
+
+    fn class_of(capacity: usize) -> Option<usize> {
+        let shift = capacity.max(1).next_power_of_two().trailing_zeros().max(MIN_CLASS_SHIFT);
+        (shift <= MAX_CLASS_SHIFT).then(|| (shift - MIN_CLASS_SHIFT) as usize)
+    }
+
+    /// 取一个长度为 `size`、内容清零的缓冲
+    pub fn acquire(&self, size: usize) -> Vec<u8> {
+        let Some(class) = Self::class_of(size) else {
+            self.misses.fetch_add(1, Ordering::Relaxed);
+            return vec![0; size];
+        };
+        let recycled = self.classes[class].lock().unwrap().pop();
+        match recycled {
+            Some(mut buffer) => {
+                self.hits.fetch_add(1, Ordering::Relaxed);
+                buffer.clear();
+                buffer.resize(size, 0);
+                buffer
+            }
+            None => {
+                self.misses.fetch_add(1, Ordering::Relaxed);
+                let mut buffer = Vec::with_capacity(1 << (class as u32 + MIN_CLASS_SHIFT));
+                buffer.resize(size, 0);
+                buffer
+            }
+        }
+    }
+
+    /// 归还缓冲；容量不是整级别或该级别已满时直接释放
+    pub fn release(&self, buffer: Vec<u8>) {
+        let capacity = buffer.capacity();
+        if !capacity.is_power_of_two() {
+            return;
+        }
+        if let Some(class) = Self::class_of(capacity) {
+            let mut free = self.classes[class].lock().unwrap();
+            if free.len() < MAX_FREE_PER_CLASS {
+                free.push(buffer);
+            }
+        }
+    }
+
+    /// (命中次数, 未命中次数)
+    pub fn hit_stats(&self) -> (u64, u64) {
+        (self.hits.load(Ordering::Relaxed), self.misses.load(Ordering::Relaxed))
+    }
+}
+
+impl Default for SizeClassPool {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+// ============================================================================
+// 全局内存管理器
+// ============================================================================
 
 /// 内存管理器
 #[derive(Debug)]
@@ -12,6 +178,8 @@ pub struct MemoryManager {
     /// 内存池
     #[allow(dead_code)]
     memory_pool: RwLock<HashMap<String, Vec<u8>>>,
+    /// 分级缓冲池
+    buffer_pool: SizeClassPool,
     /// 内存使用统计
     stats: Mutex<MemoryStats>,
 }
@@ -22,50 +190,108 @@ impl MemoryManager {
             work_memory: 4 * 1024 * 1024, // 4MB
             shared_memory: 128 * 1024 * 1024, // 128MB
             memory_pool: RwLock::new(HashMap::new()),
+            buffer_pool: SizeClassPool::new(),
             stats: Mutex::new(MemoryStats::new()),
         }
     }
 
-    /// 分配工作内存
+    /// 分配工作内存，用完后通过 `free_memory` 归还
     pub fn allocate_work_memory(&self, size: usize) -> Result<Vec<u8>> {
+        {
+            let mut stats = self.stats.lock().unwrap();
+
+            if stats.work_memory_allocated + size > self.work_memory {
+                return Err(insufficient("work", size, self.work_memory - stats.work_memory_allocated));
+            }
+
+            stats.work_memory_allocated += size;
+            stats.total_allocations += 1;
+        }
+
+        Ok(self.buffer_pool.acquire(size))
+    }
+
+    /// 分配工作内存，缓冲在守卫析构时归还缓冲池
+    pub fn work_memory(&self, size: usize) -> Result<WorkMemory<'_>> {
+        let buffer = self.allocate_work_memory(size)?;
+        Ok(WorkMemory { manager: self, buffer })
+    }
+
+    /// 预留工作内存 (只记账不分配)，超出预算时返回错误
+    ///
+    /// 供哈希连接、排序等自带数据结构的算子在物化大块数据前申请额度，
+    /// 用完后必须调用 `release_work_memory` 归还。
+    pub fn reserve_work_memory(&self, size: usize) -> Result<()> {
         let mut stats = self.stats.lock().unwrap();
-        
+
         if stats.work_memory_allocated + size > self.work_memory {
-            return Err(common::Error::Other("Insufficient work memory".to_string()));
+            return Err(insufficient("work", size, self.work_memory - stats.work_memory_allocated));
         }
-        
-        let data = vec![0u8; size];
+
         stats.work_memory_allocated += size;
         stats.total_allocations += 1;
-        
-        Ok(data)
+
+        Ok(())
     }
 
-    /// 分配共享内存
-    pub fn allocate_shared_memory(&self, size: usize) -> Result<Vec<u8>> {
+    /// 归还通过 `reserve_work_memory` 预留的工作内存
+    pub fn release_work_memory(&self, size: usize) {
         let mut stats = self.stats.lock().unwrap();
-        
-        if stats.shared_memory_allocated + size > self.shared_memory {
-            return Err(common::Error::Other("Insufficient shared memory".to_string()));
+        stats.work_memory_allocated = stats.work_memory_allocated.saturating_sub(size);
+        stats.total_frees += 1;
+        stats.total_freed_bytes += size;
+    }
+
+    /// 工作内存预算
+    pub fn work_memory_limit(&self) -> usize {
+        self.work_memory
+    }
+
+    /// 分配共享内存，用完后通过 `free_shared_memory` 归还
+    pub fn allocate_shared_memory(&self, size: usize) -> Result<Vec<u8>> {
+        {
+            let mut stats = self.stats.lock().unwrap();
+
+            if stats.shared_memory_allocated + size > self.shared_memory {
+                return Err(insufficient("shared", size, self.shared_memory - stats.shared_memory_allocated));
+            }
+
+            stats.shared_memory_allocated += size;
+            stats.total_allocations += 1;
         }
-        
-        let data = vec![0u8; size];
-        stats.shared_memory_allocated += size;
-        stats.total_allocations += 1;
-        
-        Ok(data)
+
+        Ok(self.buffer_pool.acquire(size))
     }
 
-    /// 释放内存
+    /// 释放 `allocate_work_memory` 分配的内存，缓冲回到缓冲池
     pub fn free_memory(&self, data: Vec<u8>) {
-        let mut stats = self.stats.lock().unwrap();
-        stats.total_frees += 1;
-        stats.total_freed_bytes += data.len();
+        {
+            let mut stats = self.stats.lock().unwrap();
+            stats.work_memory_allocated = stats.work_memory_allocated.saturating_sub(data.len());
+            stats.total_frees += 1;
+            stats.total_freed_bytes += data.len();
+        }
+        self.buffer_pool.release(data);
+    }
+
+    /// 释放 `allocate_shared_memory` 分配的内存
+    pub fn free_shared_memory(&self, data: Vec<u8>) {
+        {
+            let mut stats = self.stats.lock().unwrap();
+            stats.shared_memory_allocated = stats.shared_memory_allocated.saturating_sub(data.len());
+            stats.total_frees += 1;
+            stats.total_freed_bytes += data.len();
+        }
+        self.buffer_pool.release(data);
     }
 
     /// 获取内存统计信息
     pub fn get_stats(&self) -> MemoryStats {
-        self.stats.lock().unwrap().clone()
+        let mut stats = self.stats.lock().unwrap().clone();
+        stats.work_memory_limit = self.work_memory;
+        stats.shared_memory_limit = self.shared_memory;
+        (stats.pool_hits, stats.pool_misses) = self.buffer_pool.hit_stats();
+        stats
     }
 
     /// 设置工作内存大小
@@ -77,6 +303,66 @@ impl MemoryManager {
     pub fn set_shared_memory(&mut self, size: usize) {
         self.shared_memory = size;
     }
+
+    /// 为一个查询创建内存上下文，查询预留的工作内存不超过 `limit`
+    pub fn query_context(self: &Arc<Self>, query_id: impl Into<String>, limit: usize) -> Arc<QueryMemoryContext> {
+        Arc::new(QueryMemoryContext {
+            query_id: query_id.into(),
+            limit,
+            used: AtomicUsize::new(0),
+            peak: AtomicUsize::new(0),
+            parent: self.clone(),
+            arena: Mutex::new(Arena::new(DEFAULT_ARENA_CHUNK)),
+            operators: Mutex::new(Vec::new()),
+        })
+    }
+}
+
+/// `MemoryManager::work_memory` 分配的缓冲，析构时通过 `free_memory` 归还
+#[must_use = "缓冲在守卫析构时立即归还"]
+pub struct WorkMemory<'a> {
+    manager: &'a MemoryManager,
+    buffer: Vec<u8>,
+}
+
+impl Deref for WorkMemory<'_> {
+    type Target = [u8];
+
+    fn deref(&self) -> &[u8] {
+        &self.buffer
+    }
+}
+
+impl DerefMut for WorkMemory<'_> {
+    fn deref_mut(&mut self) -> &mut [u8] {
+        &mut self.buffer
+    }
+}
+
+impl Drop for WorkMemory<'_> {
+    fn drop(&mut self) {
+        self.manager.free_memory(std::mem::take(&mut self.buffer));
+    }
+}
+
+impl Default for MemoryManager {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl MemoryBudget for MemoryManager {
+    fn reserve_work_memory(&self, size: usize) -> Result<()> {
+        MemoryManager::reserve_work_memory(self, size)
+    }
+
+    fn release_work_memory(&self, size: usize) {
+        MemoryManager::release_work_memory(self, size)
+    }
+
+    fn available_work_memory(&self) -> usize {
+        self.work_memory.saturating_sub(self.stats.lock().unwrap().work_memory_allocated)
+    }
 }
 
 /// 内存统计信息
@@ -87,6 +373,11 @@ pub struct MemoryStats {
     pub total_allocations: u64,
     pub total_frees: u64,
     pub total_freed_bytes: usize,
+    pub work_memory_limit: usize,
+    pub shared_memory_limit: usize,
+    /// 缓冲池命中/未命中次数
+    pub pool_hits: u64,
+    pub pool_misses: u64,
 }
 
 impl MemoryStats {
@@ -97,20 +388,429 @@ impl MemoryStats {
             total_allocations: 0,
             total_frees: 0,
             total_freed_bytes: 0,
+            work_memory_limit: 0,
+            shared_memory_limit: 0,
+            pool_hits: 0,
+            pool_misses: 0,
         }
     }
 
     /// 获取工作内存使用率
     pub fn work_memory_usage(&self) -> f64 {
-        // 这里需要访问 MemoryManager 的 work_memory 字段
-        // 暂时返回 0.0
-        0.0
+        match self.work_memory_limit {
+            0 => 0.0,
+            limit => self.work_memory_allocated as f64 / limit as f64,
+        }
     }
 
     /// 获取共享内存使用率
     pub fn shared_memory_usage(&self) -> f64 {
-        // 这里需要访问 MemoryManager 的 shared_memory 字段
-        // 暂时返回 0.0
-        0.0
+        match self.shared_memory_limit {
+            0 => 0.0,
+            limit => self.shared_memory_allocated as f64 / limit as f64,
+        }
+    }
+}
+
+// ============================================================================
+// Bump arena
+// ============================================================================
+
+/// 查询 arena 每块的默认大小
+const DEFAULT_ARENA_CHUNK: usize = 64 * 1024;
+
+/// arena 中一段内存的位置
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct ArenaSpan {
+    chunk: u32,
+    offset: u32,
+    len: u32,
+}
+
+impl ArenaSpan {
+    pub fn len(&self) -> usize {
+        self.len as usize
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len == 0
     }
-} 
\ No newline at end of file
+}
+
+/// Bump arena：按块顺序分配，不单独释放，整体 `reset` 或析构时一次性回收
+#[derive(Debug)]
+pub struct Arena {
+    chunks: Vec<Vec<u8>>,
+    chunk_size: usize,
+    /// 当前块已用字节数
+    used: usize,
+}
+
+impl Arena {
+    pub fn new(chunk_size: usize) -> Self {
+        Self {
+            chunks: Vec::new(),
+            chunk_size: chunk_size.max(64),
+            used: 0,
+        }
+    }
+
+    /// 分配 `size` 字节，返回位置与本次新分配的块大小 (未新建块时为 0)
+    fn alloc_span(&mut self, size: usize) -> (ArenaSpan, usize) {
+        let mut grown = 0;
+        let need_chunk = match self.chunks.last() {
+            Some(chunk) => self.used + size > chunk.len(),
+            None => true,
+        };
+        if need_chunk {
+            // 超过块大小的请求单独成块
+            let chunk_size = self.chunk_size.max(size);
+            self.chunks.push(vec![0; chunk_size]);
+            self.used = 0;
+            grown = chunk_size;
+        }
+        let span = ArenaSpan {
+            chunk: (self.chunks.len() - 1) as u32,
+            offset: self.used as u32,
+            len: size as u32,
+        };
+        self.used += size;
+        (span, grown)
+    }
+
+    /// 分配 `size` 字节的临时空间
+    pub fn alloc(&mut self, size: usize) -> ArenaSpan {
+        self.alloc_span(size).0
+    }
+
+    /// 把 `bytes` 复制进 arena
+    pub fn alloc_copy(&mut self, bytes: &[u8]) -> ArenaSpan {
+        let span = self.alloc(bytes.len());
+        self.get_mut(span).copy_from_slice(bytes);
+        span
+    }
+
+    pub fn get(&self, span: ArenaSpan) -> &[u8] {
+        let start = span.offset as usize;
+        &self.chunks[span.chunk as usize][start..start + span.len as usize]
+    }
+
+    pub fn get_mut(&mut self, span: ArenaSpan) -> &mut [u8] {
+        let start = span.offset as usize;
+        &mut self.chunks[span.chunk as usize][start..start + span.len as usize]
+    }
+
+    /// arena 占用的字节数
+    pub fn allocated_bytes(&self) -> usize {
+        self.chunks.iter().map(|c| c.len()).sum()
+    }
+
+    /// 释放全部块，之前返回的位置全部失效
+    pub fn reset(&mut self) -> usize {
+        let freed = self.allocated_bytes();
+        self.chunks.clear();
+        self.used = 0;
+        freed
+    }
+}
+
+// ============================================================================
+// 查询 / 算子内存上下文
+// ============================================================================
+
+/// 按上限原子地增加计数，超出上限时不修改并返回 false
+fn try_add(counter: &AtomicUsize, peak: &AtomicUsize, size: usize, limit: usize) -> bool {
+    let mut current = counter.load(Ordering::Relaxed);
+    loop {
+        let Some(next) = current.checked_add(size).filter(|&n| n <= limit) else { return false };
+        match counter.compare_exchange_weak(current, next, Ordering::AcqRel, Ordering::Relaxed) {
+            Ok(_) => {
+                peak.fetch_max(next, Ordering::Relaxed);
+                return true;
+            }
+            Err(actual) => current = actual,
+        }
+    }
+}
+
+fn sub(counter: &AtomicUsize, size: usize) {
+    let _ = counter.fetch_update(Ordering::AcqRel, Ordering::Relaxed, |c| Some(c.saturating_sub(size)));
+}
+
+/// 单个查询的内存上下文
+#[derive(Debug)]
+pub struct QueryMemoryContext {
+    query_id: String,
+    limit: usize,
+    used: AtomicUsize,
+    peak: AtomicUsize,
+    parent: Arc<MemoryManager>,
+    arena: Mutex<Arena>,
+    /// 各算子的用量计数，算子上下文析构后仍保留供统计
+    operators: Mutex<Vec<Arc<OperatorUsage>>>,
+}
+
+impl QueryMemoryContext {
+    pub fn query_id(&self) -> &str {
+        &self.query_id
+    }
+
+    pub fn limit(&self) -> usize {
+        self.limit
+    }
+
+    pub fn used(&self) -> usize {
+        self.used.load(Ordering::Acquire)
+    }
+
+    pub fn peak(&self) -> usize {
+        self.peak.load(Ordering::Relaxed)
+    }
+
+    /// 为查询中的一个算子创建子预算，`limit` 为空时只受查询预算约束
+    pub fn operator(self: &Arc<Self>, name: impl Into<String>, limit: Option<usize>) -> Arc<OperatorMemoryContext> {
+        let usage = Arc::new(OperatorUsage {
+            name: name.into(),
+            limit: limit.unwrap_or(self.limit).min(self.limit),
+            used: AtomicUsize::new(0),
+            peak: AtomicUsize::new(0),
+        });
+        self.operators.lock().unwrap().push(usage.clone());
+        Arc::new(OperatorMemoryContext { usage, query: self.clone() })
+    }
+
+    /// 查询 arena，分配的临时数据在查询结束时随上下文一起释放
+    pub fn arena(&self) -> MutexGuard<'_, Arena> {
+        self.arena.lock().unwrap()
+    }
+
+    /// 从 arena 分配并计入查询预算
+    pub fn arena_alloc(&self, size: usize) -> Result<ArenaSpan> {
+        let mut arena = self.arena.lock().unwrap();
+        let fits = match arena.chunks.last() {
+            Some(chunk) => arena.used + size <= chunk.len(),
+            None => false,
+        };
+        if !fits {
+            self.reserve_work_memory(arena.chunk_size.max(size))?;
+        }
+        Ok(arena.alloc_span(size).0)
+    }
+
+    /// 各算子的使用情况：(名称, 当前字节数, 峰值字节数)
+    pub fn operator_usage(&self) -> Vec<(String, usize, usize)> {
+        self.operators
+            .lock()
+            .unwrap()
+            .iter()
+            .map(|o| (o.name.clone(), o.used.load(Ordering::Acquire), o.peak.load(Ordering::Relaxed)))
+            .collect()
+    }
+}
+
+impl MemoryBudget for QueryMemoryContext {
+    fn reserve_work_memory(&self, size: usize) -> Result<()> {
+        if !try_add(&self.used, &self.peak, size, self.limit) {
+            return Err(insufficient(&format!("query {}", self.query_id), size, self.available_work_memory()));
+        }
+        if let Err(e) = self.parent.reserve_work_memory(size) {
+            sub(&self.used, size);
+            return Err(e);
+        }
+        Ok(())
+    }
+
+    fn release_work_memory(&self, size: usize) {
+        sub(&self.used, size);
+        self.parent.release_work_memory(size);
+    }
+
+    fn available_work_memory(&self) -> usize {
+        let local = self.limit.saturating_sub(self.used());
+        local.min(MemoryBudget::available_work_memory(&*self.parent))
+    }
+}
+
+impl Drop for QueryMemoryContext {
+    fn drop(&mut self) {
+        // 查询结束：arena 与未归还的预留一次性还给全局预算
+        let outstanding = *self.used.get_mut();
+        if outstanding > 0 {
+            self.parent.release_work_memory(outstanding);
+        }
+    }
+}
+
+#[derive(Debug)]
+struct OperatorUsage {
+    name: String,
+    limit: usize,
+    used: AtomicUsize,
+    peak: AtomicUsize,
+}
+
+/// 查询内单个算子的内存预算
+#[derive(Debug)]
+pub struct OperatorMemoryContext {
+    usage: Arc<OperatorUsage>,
+    query: Arc<QueryMemoryContext>,
+}
+
+impl OperatorMemoryContext {
+    pub fn name(&self) -> &str {
+        &self.usage.name
+    }
+
+    pub fn limit(&self) -> usize {
+        self.usage.limit
+    }
+
+    pub fn used(&self) -> usize {
+        self.usage.used.load(Ordering::Acquire)
+    }
+
+    pub fn peak(&self) -> usize {
+        self.usage.peak.load(Ordering::Relaxed)
+    }
+
+    pub fn query(&self) -> &Arc<QueryMemoryContext> {
+        &self.query
+    }
+}
+
+impl MemoryBudget for OperatorMemoryContext {
+    fn reserve_work_memory(&self, size: usize) -> Result<()> {
+        let usage = &self.usage;
+        if !try_add(&usage.used, &usage.peak, size, usage.limit) {
+            return Err(insufficient(&format!("operator {}", usage.name), size, self.available_work_memory()));
+        }
+        if let Err(e) = self.query.reserve_work_memory(size) {
+            sub(&usage.used, size);
+            return Err(e);
+        }
+        Ok(())
+    }
+
+    fn release_work_memory(&self, size: usize) {
+        sub(&self.usage.used, size);
+        self.query.release_work_memory(size);
+    }
+
+    fn available_work_memory(&self) -> usize {
+        self.usage.limit.saturating_sub(self.used()).min(self.query.available_work_memory())
+    }
+}
+
+impl Drop for OperatorMemoryContext {
+    fn drop(&mut self) {
+        // 算子结束时未归还的预留还给查询
+        let outstanding = self.usage.used.swap(0, Ordering::AcqRel);
+        if outstanding > 0 {
+            self.query.release_work_memory(outstanding);
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_work_memory_is_pooled_and_accounted() {
+        let manager = MemoryManager::new();
+        let buffer = manager.allocate_work_memory(100_000).unwrap();
+        assert_eq!(buffer.len(), 100_000);
+        assert_eq!(manager.get_stats().work_memory_allocated, 100_000);
+        manager.free_memory(buffer);
+        assert_eq!(manager.get_stats().work_memory_allocated, 0);
+
+        // 同级别的下一次分配复用缓冲且内容已清零
+        let buffer = manager.allocate_work_memory(90_000).unwrap();
+        assert!(buffer.iter().all(|&b| b == 0));
+        let stats = manager.get_stats();
+        assert_eq!((stats.pool_hits, stats.pool_misses), (1, 1));
+        manager.free_memory(buffer);
+
+        // 重复分配释放不再耗尽预算
+        for _ in 0..16 {
+            let buffer = manager.allocate_work_memory(1024 * 1024).unwrap();
+            manager.free_memory(buffer);
+        }
+    }
+
+    #[test]
+    fn test_hierarchical_budget() {
+        let manager = Arc::new(MemoryManager::new());
+        let query = manager.query_context("q1", 1000);
+        let join = query.operator("join", Some(600));
+        let sort = query.operator("sort", None);
+
+        join.reserve_work_memory(600).unwrap();
+        // 算子级额度用完
+        assert!(join.reserve_work_memory(1).is_err());
+        // 查询级额度只剩 400
+        assert_eq!(sort.available_work_memory(), 400);
+        assert!(sort.reserve_work_memory(500).is_err());
+        sort.reserve_work_memory(400).unwrap();
+        assert_eq!(manager.get_stats().work_memory_allocated, 1000);
+
+        join.release_work_memory(600);
+        assert_eq!(query.used(), 400);
+        assert_eq!(query.operator_usage()[0], ("join".to_string(), 0, 600));
+
+        // 算子结束时未归还的预留还给查询，查询结束时全部释放
+        drop(sort);
+        assert_eq!(query.used(), 0);
+        drop(join);
+        drop(query);
+        assert_eq!(manager.get_stats().work_memory_allocated, 0);
+    }
+
+    #[test]
+    fn test_guards_release_on_early_return() {
+        fn fail_after_reserving(manager: &MemoryManager, budget: &dyn MemoryBudget) -> Result<()> {
+            let _buffer = manager.work_memory(4096)?;
+            let mut reservation = MemoryReservation::new(budget, 1000)?;
+            reservation.try_grow(500)?;
+            assert_eq!(reservation.size(), 1500);
+            Err(common::Error::Execution("operator failed".to_string()))?;
+            Ok(())
+        }
+
+        let manager = Arc::new(MemoryManager::new());
+        let query = manager.query_context("q", 1024 * 1024);
+        assert!(fail_after_reserving(&manager, query.as_ref()).is_err());
+        assert_eq!(query.used(), 0);
+        assert_eq!(manager.get_stats().work_memory_allocated, 0);
+
+        // 追加预留失败时已有预留不变，析构时照常归还
+        let mut reservation = MemoryReservation::new(query.as_ref(), 1000).unwrap();
+        assert!(reservation.try_grow(2 * 1024 * 1024).is_err());
+        assert_eq!((reservation.size(), query.used()), (1000, 1000));
+        drop(reservation);
+        assert_eq!(query.used(), 0);
+    }
+
+    #[test]
+    fn test_arena_allocations_are_charged_to_query() {
+        let manager = Arc::new(MemoryManager::new());
+        let query = manager.query_context("q2", 1024 * 1024);
+        let a = query.arena_alloc(100).unwrap();
+        let b = query.arena_alloc(200).unwrap();
+        assert_eq!(query.used(), DEFAULT_ARENA_CHUNK);
+        {
+            let mut arena = query.arena();
+            arena.get_mut(a).fill(7);
+            let c = arena.alloc_copy(b"hello");
+            assert_eq!(arena.get(c), b"hello");
+            assert_eq!(arena.get(a), &[7u8; 100][..]);
+            assert_eq!(arena.get(b).len(), 200);
+        }
+        // 超过块大小的请求单独成块
+        query.arena_alloc(DEFAULT_ARENA_CHUNK * 2).unwrap();
+        assert_eq!(query.used(), DEFAULT_ARENA_CHUNK * 3);
+        assert!(query.arena_alloc(1024 * 1024).is_err());
+        drop(query);
+        assert_eq!(manager.get_stats().work_memory_allocated, 0);
+    }
+}
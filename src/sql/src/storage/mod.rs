@@ -5,7 +5,14 @@
 pub mod worker_pool;
 pub mod buffer_pool;
 pub mod cache_manager;
+pub mod sharded_cache;
 pub mod memory;
 pub mod handler;
+pub mod bitmap_index;
+pub mod table_catalog;
+pub mod pushdown;
 
-pub use handler::StorageHandler;
\ No newline at end of file
+pub use bitmap_index::{BitmapIndexCatalog, BitmapIndexDef};
+pub use handler::{StorageHandler, TableScanStream};
+pub use pushdown::CoprocessorPlan;
+pub use table_catalog::{TableCatalog, TableColumn};
\ No newline at end of file
@@ -0,0 +1,438 @@
+//! 协处理器下推规划
+//!
+//! 把 `TableScan` 之上的过滤、投影、LIMIT 和可分解聚合翻译为存储层的
+//! `CoprocessorProgram`。列名按表结构目录解析为行内列 ID，与列在 SELECT 列表中的
+//! 位置无关；表未登记、引用了未知列或含有无法下推的表达式 (函数、未绑定参数等) 时
+//! 整段保留在 SQL 层执行。
+//! 过滤条件中的简单比较还会翻译为区间摘要谓词，用于扫描前跳过不可能匹配的区间。
+
+use common::Result;
+use storage::coprocessor::{
+    merge_partial_aggregates, CopAggregate, CopAggregateFunction, CopBinaryOp, CopExpr, CoprocessorProgram,
+    CoprocessorResponse, Datum, PartialAggregate,
+};
+use storage::index::{ZoneCmp, ZonePredicate};
+
+use crate::executor::execution_models::QueryResult;
+use crate::executor::operators::batch_operators::AggregateSpec;
+use crate::optimizer::PlanNode;
+use crate::parser::parser::{ParsedExpression, ParsedOperator, ParsedValue};
+use crate::storage::table_catalog::TableCatalog;
+
+/// 最终输出列如何由部分聚合状态得到
+#[derive(Debug, Clone, PartialEq)]
+enum FinalColumn {
+    /// 直接取第 n 个聚合状态
+    State(usize),
+    /// AVG = SUM / COUNT
+    Average { sum: usize, count: usize },
+}
+
+/// 一段可下推的计划
+#[derive(Debug, Clone)]
+pub struct CoprocessorPlan {
+    pub table: String,
+    pub program: CoprocessorProgram,
+    /// 结果列名
+    pub output_columns: Vec<String>,
+    /// 聚合前每个结果列的行内列 ID
+    column_ids: Vec<usize>,
+    /// 下推 LIMIT 时由 SQL 层丢弃的前缀行数
+    offset: u64,
+    /// 聚合时每个输出聚合列的还原方式
+    final_columns: Vec<FinalColumn>,
+    /// 过滤条件中可用区间摘要判断的部分，扫描前据此跳过区间
+    pub zone_predicates: Vec<ZonePredicate>,
+}
+
+impl CoprocessorPlan {
+    /// 尝试把以 `TableScan` 为叶子的计划片段编译为协处理器程序，列 ID 取自 `catalog`
+    pub fn from_plan(node: &PlanNode, catalog: &TableCatalog) -> Option<Self> {
+        let mut plan = Self::build(node, catalog)?;
+        // 存储端按列 ID 解码，输出列总是显式投影，顺序与结果列一致
+        if plan.program.aggregate.is_none() {
+            plan.program.projection = Some(plan.column_ids.clone());
+        }
+        Some(plan)
+    }
+
+    fn build(node: &PlanNode, catalog: &TableCatalog) -> Option<Self> {
+        match node {
+            PlanNode::TableScan { table, columns } => Self::scan(table, columns, catalog),
+            PlanNode::Filter { input, predicate } => {
+                let mut plan = Self::build(input, catalog)?;
+                if plan.program.aggregate.is_some() || plan.program.limit.is_some() {
+                    return None;
+                }
+                // 存储端先按列 ID 求值过滤条件再投影，过滤位于投影之上也不影响列 ID
+                let filter = to_cop_expr(predicate, &|name| plan.resolve(name))?;
+                let zone_predicates = to_zone_predicates(predicate, &|name| plan.resolve(name).map(|id| id as u32));
+                plan.zone_predicates.extend(zone_predicates);
+                plan.program.filter = Some(match plan.program.filter.take() {
+                    Some(existing) => CopExpr::binary(CopBinaryOp::And, existing, filter),
+                    None => filter,
+                });
+                Some(plan)
+            }
+            PlanNode::Project { input, columns } => {
+                let mut plan = Self::build(input, catalog)?;
+                if plan.program.aggregate.is_some() || plan.program.limit.is_some() {
+                    return None;
+                }
+                plan.column_ids = columns.iter().map(|column| plan.resolve(column)).collect::<Option<Vec<_>>>()?;
+                plan.output_columns = columns.clone();
+                Some(plan)
+            }
+            PlanNode::Limit { input, limit, offset } => {
+                let mut plan = Self::build(input, catalog)?;
+                if plan.program.aggregate.is_some() || plan.program.limit.is_some() {
+                    return None;
+                }
+                plan.program.limit = Some(limit.saturating_add(*offset));
+                plan.offset = *offset;
+                Some(plan)
+            }
+            PlanNode::Aggregate { input, group_by, aggregates } => {
+                let plan = Self::build(input, catalog)?;
+                if plan.program.aggregate.is_some() || plan.program.limit.is_some() {
+                    return None;
+                }
+                plan.with_aggregate(group_by, aggregates)
+            }
+            _ => None,
+        }
+    }
+
+    fn scan(table: &str, columns: &[String], catalog: &TableCatalog) -> Option<Self> {
+        // 表未登记或列不存在时无法把列名落到行内列 ID
+        let resolved = catalog.resolve(table, columns)?;
+        let output_columns = if columns.is_empty() || columns.iter().any(|c| c == "*") {
+            resolved.iter().map(|c| c.name.clone()).collect()
+        } else {
+            columns.to_vec()
+        };
+        Some(Self {
+            table: table.to_string(),
+            program: CoprocessorProgram::default(),
+            output_columns,
+            column_ids: resolved.iter().map(|c| c.column_id as usize).collect(),
+            offset: 0,
+            final_columns: Vec::new(),
+            zone_predicates: Vec::new(),
+        })
+    }
+
+    /// 当前结果列名对应的行内列 ID
+    fn resolve(&self, name: &str) -> Option<usize> {
+        column_index(&self.output_columns, name).map(|index| self.column_ids[index])
+    }
+
+    fn with_aggregate(mut self, group_by: &[String], aggregates: &[String]) -> Option<Self> {
+        let resolve = |name: &str| self.resolve(name);
+
+        let group_indices = group_by.iter().map(|c| resolve(c)).collect::<Option<Vec<_>>>()?;
+        let mut states = Vec::new();
+        let mut final_columns = Vec::new();
+        let mut push_state = |function, column: Option<usize>| {
+            states.push(CopAggregate { function, column });
+            states.len() - 1
+        };
+
+        for aggregate in aggregates {
+            let spec = AggregateSpec::parse(aggregate);
+            let column = match &spec.column {
+                Some(name) => Some(resolve(name)?),
+                None => None,
+            };
+            let final_column = match spec.function.as_str() {
+                "count" => FinalColumn::State(push_state(CopAggregateFunction::Count, column)),
+                "sum" => FinalColumn::State(push_state(CopAggregateFunction::Sum, column)),
+                "min" => FinalColumn::State(push_state(CopAggregateFunction::Min, column)),
+                "max" => FinalColumn::State(push_state(CopAggregateFunction::Max, column)),
+                "avg" => FinalColumn::Average {
+                    sum: push_state(CopAggregateFunction::Sum, column),
+                    count: push_state(CopAggregateFunction::Count, column),
+                },
+                _ => return None,
+            };
+            final_columns.push(final_column);
+        }
+
+        self.program.aggregate = Some(PartialAggregate { group_by: group_indices, aggregates: states });
+        self.output_columns = group_by.iter().cloned().chain(aggregates.iter().cloned()).collect();
+        self.final_columns = final_columns;
+        Some(self)
+    }
+
+    /// 把存储端 (可能来自多个区域) 的响应还原为最终查询结果
+    pub fn finish(&self, responses: Vec<CoprocessorResponse>) -> Result<QueryResult> {
+        let rows: Vec<Vec<Datum>> = responses.into_iter().flat_map(|response| response.rows).collect();
+
+        let rows: Vec<Vec<Datum>> = match &self.program.aggregate {
+            Some(aggregate) => {
+                let key_len = aggregate.group_by.len();
+                merge_partial_aggregates(aggregate, rows)
+                    .into_iter()
+                    .map(|row| {
+                        let mut output: Vec<Datum> = row[..key_len].to_vec();
+                        for column in &self.final_columns {
+                            output.push(match column {
+                                FinalColumn::State(i) => row[key_len + i].clone(),
+                                FinalColumn::Average { sum, count } => {
+                                    match (row[key_len + sum].as_f64(), row[key_len + count].as_f64()) {
+                                        (Some(sum), Some(count)) if count > 0.0 => Datum::Float(sum / count),
+                                        _ => Datum::Null,
+                                    }
+                                }
+                            });
+                        }
+                        output
+                    })
+                    .collect()
+            }
+            None => {
+                let limit = self.program.limit.map_or(usize::MAX, |l| l.saturating_sub(self.offset) as usize);
+                rows.into_iter().skip(self.offset as usize).take(limit).collect()
+            }
+        };
+
+        let rows: Vec<Vec<String>> = rows
+            .into_iter()
+            .map(|row| row.iter().map(Datum::to_text).collect())
+            .collect();
+        let mut result = QueryResult::new();
+        result.columns = self.output_columns.clone();
+        result.affected_rows = rows.len() as u64;
+        result.rows = rows;
+        Ok(result)
+    }
+}
+
+fn column_index(columns: &[String], name: &str) -> Option<usize> {
+    columns.iter().position(|c| c.eq_ignore_ascii_case(name))
+}
+
+/// 把 SQL 表达式翻译为下推表达式，列名经 `resolve` 解析为行内列 ID，遇到无法下推的部分返回 None
+pub fn to_cop_expr(expr: &ParsedExpression, resolve: &dyn Fn(&str) -> Option<usize>) -> Option<CopExpr> {
+    match expr {
+        ParsedExpression::Column(name) => resolve(name).map(CopExpr::Column),
+        ParsedExpression::Literal(value) => literal_datum(value).map(CopExpr::Literal),
+        ParsedExpression::BinaryOp { left, operator, right } => {
+            let op = match operator {
+                ParsedOperator::Add => CopBinaryOp::Add,
+                ParsedOperator::Subtract => CopBinaryOp::Sub,
+                ParsedOperator::Multiply => CopBinaryOp::Mul,
+                ParsedOperator::Divide => CopBinaryOp::Div,
+                ParsedOperator::Equal => CopBinaryOp::Eq,
+                ParsedOperator::NotEqual => CopBinaryOp::Ne,
+                ParsedOperator::LessThan => CopBinaryOp::Lt,
+                ParsedOperator::LessThanOrEqual => CopBinaryOp::Le,
+                ParsedOperator::GreaterThan => CopBinaryOp::Gt,
+                ParsedOperator::GreaterThanOrEqual => CopBinaryOp::Ge,
+                ParsedOperator::And => CopBinaryOp::And,
+                ParsedOperator::Or => CopBinaryOp::Or,
+            };
+            Some(CopExpr::binary(op, to_cop_expr(left, resolve)?, to_cop_expr(right, resolve)?))
+        }
+        ParsedExpression::Function { .. } | ParsedExpression::Parameter(_) => None,
+    }
+}
+
+fn literal_datum(value: &ParsedValue) -> Option<Datum> {
+    Some(match value {
+        ParsedValue::Number(n) => match n.parse::<i64>() {
+            Ok(v) => Datum::Int(v),
+            Err(_) => Datum::Float(n.parse().ok()?),
+        },
+        ParsedValue::String(s) => Datum::Bytes(s.as_bytes().to_vec()),
+        ParsedValue::Boolean(b) => Datum::Bool(*b),
+        ParsedValue::Null => Datum::Null,
+    })
+}
+
+/// 从过滤条件中取出可用区间摘要判断的比较
+///
+/// 只看 AND 连接的 `列 比较 字面量`，其余部分 (OR、函数、!= 等) 被忽略；
+/// 丢掉合取项只会让跳过变少，不影响结果。列名经 `resolve` 解析为行内列 ID，
+/// 无法解析的列同样被忽略。
+pub fn to_zone_predicates(expr: &ParsedExpression, resolve: &dyn Fn(&str) -> Option<u32>) -> Vec<ZonePredicate> {
+    let mut predicates = Vec::new();
+    collect_zone_predicates(expr, resolve, &mut predicates);
+    predicates
+}
+
+fn collect_zone_predicates(expr: &ParsedExpression, resolve: &dyn Fn(&str) -> Option<u32>, out: &mut Vec<ZonePredicate>) {
+    let ParsedExpression::BinaryOp { left, operator, right } = expr else { return };
+    if *operator == ParsedOperator::And {
+        collect_zone_predicates(left, resolve, out);
+        collect_zone_predicates(right, resolve, out);
+        return;
+    }
+    let (column, value, flipped) = match (left.as_ref(), right.as_ref()) {
+        (ParsedExpression::Column(column), ParsedExpression::Literal(value)) => (column, value, false),
+        (ParsedExpression::Literal(value), ParsedExpression::Column(column)) => (column, value, true),
+        _ => return,
+    };
+    let op = match (operator, flipped) {
+        (ParsedOperator::Equal, _) => ZoneCmp::Eq,
+        (ParsedOperator::LessThan, false) | (ParsedOperator::GreaterThan, true) => ZoneCmp::Lt,
+        (ParsedOperator::LessThanOrEqual, false) | (ParsedOperator::GreaterThanOrEqual, true) => ZoneCmp::Le,
+        (ParsedOperator::GreaterThan, false) | (ParsedOperator::LessThan, true) => ZoneCmp::Gt,
+        (ParsedOperator::GreaterThanOrEqual, false) | (ParsedOperator::LessThanOrEqual, true) => ZoneCmp::Ge,
+        _ => return,
+    };
+    if let (Some(column_id), Some(value)) = (resolve(column), literal_datum(value)) {
+        out.push(ZonePredicate::Compare { column_id, op, value });
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::storage::table_catalog::TableColumn;
+    use common::DataType;
+    use storage::coprocessor::{encode_row, CoprocessorEvaluator};
+
+    fn catalog() -> TableCatalog {
+        let catalog = TableCatalog::new();
+        catalog.register("emp", vec![
+            TableColumn::new("id", 0, DataType::BigInt),
+            TableColumn::new("dept", 1, DataType::String),
+            TableColumn::new("salary", 2, DataType::Double),
+        ]);
+        catalog
+    }
+
+    fn scan() -> PlanNode {
+        PlanNode::TableScan {
+            table: "emp".to_string(),
+            columns: vec!["id".to_string(), "dept".to_string(), "salary".to_string()],
+        }
+    }
+
+    fn gt(column: &str, value: &str) -> ParsedExpression {
+        ParsedExpression::BinaryOp {
+            left: Box::new(ParsedExpression::Column(column.to_string())),
+            operator: ParsedOperator::GreaterThan,
+            right: Box::new(ParsedExpression::Literal(ParsedValue::Number(value.to_string()))),
+        }
+    }
+
+    fn run(plan: &CoprocessorPlan, rows: &[(i64, &str, f64)]) -> QueryResult {
+        let mut evaluator = CoprocessorEvaluator::new(plan.program.clone());
+        for (id, dept, salary) in rows {
+            let value = encode_row(&[Datum::Int(*id), Datum::Bytes(dept.as_bytes().to_vec()), Datum::Float(*salary)]);
+            if !evaluator.feed(id.to_string().as_bytes(), &value).unwrap() {
+                break;
+            }
+        }
+        plan.finish(vec![evaluator.finish()]).unwrap()
+    }
+
+    const ROWS: [(i64, &str, f64); 4] = [(1, "it", 100.0), (2, "it", 300.0), (3, "hr", 200.0), (4, "hr", 50.0)];
+
+    #[test]
+    fn test_filter_project_limit_pushdown() {
+        let node = PlanNode::Limit {
+            input: Box::new(PlanNode::Project {
+                input: Box::new(PlanNode::Filter { input: Box::new(scan()), predicate: gt("salary", "80") }),
+                columns: vec!["id".to_string()],
+            }),
+            limit: 1,
+            offset: 1,
+        };
+        let plan = CoprocessorPlan::from_plan(&node, &catalog()).unwrap();
+        assert_eq!(plan.program.projection, Some(vec![0]));
+        assert_eq!(plan.program.limit, Some(2));
+
+        let result = run(&plan, &ROWS);
+        assert_eq!(result.columns, vec!["id".to_string()]);
+        assert_eq!(result.rows, vec![vec!["2".to_string()]]);
+    }
+
+    #[test]
+    fn test_columns_resolve_to_table_column_ids() {
+        // SELECT 列表的顺序与表定义不同，程序仍按表定义的列 ID 读取
+        let node = PlanNode::Filter {
+            input: Box::new(PlanNode::TableScan {
+                table: "emp".to_string(),
+                columns: vec!["salary".to_string(), "id".to_string()],
+            }),
+            predicate: gt("salary", "150"),
+        };
+        let plan = CoprocessorPlan::from_plan(&node, &catalog()).unwrap();
+        assert_eq!(plan.program.projection, Some(vec![2, 0]));
+
+        let result = run(&plan, &ROWS);
+        assert_eq!(result.columns, vec!["salary".to_string(), "id".to_string()]);
+        assert_eq!(result.rows, vec![vec!["300".to_string(), "2".to_string()], vec!["200".to_string(), "3".to_string()]]);
+
+        // 不带列名的扫描展开为表定义的全部列
+        let all = CoprocessorPlan::from_plan(&PlanNode::TableScan { table: "emp".to_string(), columns: vec![] }, &catalog()).unwrap();
+        assert_eq!(all.output_columns, vec!["id".to_string(), "dept".to_string(), "salary".to_string()]);
+    }
+
+    #[test]
+    fn test_aggregate_pushdown_with_avg() {
+        let node = PlanNode::Aggregate {
+            input: Box::new(scan()),
+            group_by: vec!["dept".to_string()],
+            aggregates: vec!["COUNT(*)".to_string(), "AVG(salary)".to_string()],
+        };
+        let plan = CoprocessorPlan::from_plan(&node, &catalog()).unwrap();
+        let result = run(&plan, &ROWS);
+        assert_eq!(
+            result.rows,
+            vec![
+                vec!["it".to_string(), "2".to_string(), "200".to_string()],
+                vec!["hr".to_string(), "2".to_string(), "125".to_string()],
+            ]
+        );
+    }
+
+    #[test]
+    fn test_unsupported_plans_stay_in_sql_layer() {
+        let function = ParsedExpression::Function { name: "upper".to_string(), arguments: vec![] };
+        let node = PlanNode::Filter { input: Box::new(scan()), predicate: function };
+        assert!(CoprocessorPlan::from_plan(&node, &catalog()).is_none());
+
+        let star = PlanNode::TableScan { table: "t".to_string(), columns: vec!["*".to_string()] };
+        assert!(CoprocessorPlan::from_plan(&star, &catalog()).is_none());
+        assert!(CoprocessorPlan::from_plan(&PlanNode::Filter { input: Box::new(scan()), predicate: gt("missing", "1") }, &catalog()).is_none());
+    }
+
+    #[test]
+    fn test_zone_predicates_from_filter() {
+        let catalog = catalog();
+        let resolve = |name: &str| catalog.column("emp", name).map(|c| c.column_id);
+        let binary = |left, operator, right| ParsedExpression::BinaryOp { left: Box::new(left), operator, right: Box::new(right) };
+        // salary > 80 AND 'it' = dept AND (id = 1 OR id = 2) AND 100 >= id
+        let predicate = binary(
+            binary(
+                binary(
+                    gt("salary", "80"),
+                    ParsedOperator::And,
+                    binary(ParsedExpression::Literal(ParsedValue::String("it".into())), ParsedOperator::Equal, ParsedExpression::Column("dept".into())),
+                ),
+                ParsedOperator::And,
+                binary(gt("id", "1"), ParsedOperator::Or, gt("id", "2")),
+            ),
+            ParsedOperator::And,
+            binary(ParsedExpression::Literal(ParsedValue::Number("100".into())), ParsedOperator::GreaterThanOrEqual, ParsedExpression::Column("id".into())),
+        );
+        assert_eq!(to_zone_predicates(&predicate, &resolve), vec![
+            ZonePredicate::Compare { column_id: 2, op: ZoneCmp::Gt, value: Datum::Int(80) },
+            ZonePredicate::Compare { column_id: 1, op: ZoneCmp::Eq, value: Datum::Bytes(b"it".to_vec()) },
+            ZonePredicate::Compare { column_id: 0, op: ZoneCmp::Le, value: Datum::Int(100) },
+        ]);
+        assert!(to_zone_predicates(&gt("missing", "1"), &resolve).is_empty());
+
+        // 下推计划带上过滤条件里的区间谓词，列 ID 取自表结构而不是 SELECT 列表
+        let node = PlanNode::Filter {
+            input: Box::new(PlanNode::TableScan { table: "emp".to_string(), columns: vec!["salary".to_string()] }),
+            predicate: gt("salary", "80"),
+        };
+        let plan = CoprocessorPlan::from_plan(&node, &catalog).unwrap();
+        assert_eq!(plan.zone_predicates, vec![ZonePredicate::Compare { column_id: 2, op: ZoneCmp::Gt, value: Datum::Int(80) }]);
+    }
+}
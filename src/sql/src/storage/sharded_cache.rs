@@ -0,0 +1,497 @@
+//! 分片 W-TinyLFU 缓存
+//!
+//! 每个分片独立加锁，按字节预算 (而不是条目数) 计费。分片内部分为三段：
+//!
+//! - 窗口段 (window LRU, 约 1%)：新条目先进入这里，吸收突发访问
+//! - 试用段 (probation) 与保护段 (protected, 占主区 80%)：组成分段 LRU
+//!
+//! 窗口段溢出时，被挤出的候选条目要与主区的淘汰对象比较访问频率 (Count-Min
+//! Sketch 估计)，只有更“热”才会被接纳，这样一次性的查询不会冲掉热点条目。
+
+use std::collections::hash_map::DefaultHasher;
+use std::collections::HashMap;
+use std::hash::{Hash, Hasher};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::Mutex;
+use std::time::{Duration, Instant};
+
+/// 默认分片数
+pub const DEFAULT_SHARDS: usize = 16;
+
+const NIL: usize = usize::MAX;
+
+/// 缓存计数器
+#[derive(Debug, Default)]
+pub struct CacheCounters {
+    pub lookups: AtomicU64,
+    pub hits: AtomicU64,
+    pub misses: AtomicU64,
+    pub inserts: AtomicU64,
+    pub evictions: AtomicU64,
+    /// 未通过 TinyLFU 准入而被拒绝的条目
+    pub rejections: AtomicU64,
+}
+
+impl CacheCounters {
+    fn bump(counter: &AtomicU64) {
+        counter.fetch_add(1, Ordering::Relaxed);
+    }
+}
+
+/// 4 行 Count-Min Sketch，4 位饱和计数器，计数总量达到阈值后整体减半以实现老化
+#[derive(Debug)]
+struct FrequencySketch {
+    counters: Vec<u8>,
+    mask: usize,
+    additions: usize,
+    reset_at: usize,
+}
+
+impl FrequencySketch {
+    fn new(width: usize) -> Self {
+        let width = width.max(16).next_power_of_two();
+        Self { counters: vec![0; width * 4], mask: width - 1, additions: 0, reset_at: width * 10 }
+    }
+
+    fn slots(&self, hash: u64) -> [usize; 4] {
+        let width = self.mask + 1;
+        let (h1, h2) = (hash as usize, (hash >> 32) as usize | 1);
+        [0, 1, 2, 3].map(|row| row * width + (h1.wrapping_add(row.wrapping_mul(h2)) & self.mask))
+    }
+
+    fn increment(&mut self, hash: u64) {
+        for slot in self.slots(hash) {
+            if self.counters[slot] < 15 {
+                self.counters[slot] += 1;
+            }
+        }
+        self.additions += 1;
+        if self.additions >= self.reset_at {
+            self.counters.iter_mut().for_each(|c| *c >>= 1);
+            self.additions /= 2;
+        }
+    }
+
+    fn frequency(&self, hash: u64) -> u8 {
+        self.slots(hash).iter().map(|&slot| self.counters[slot]).min().unwrap_or(0)
+    }
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum Segment {
+    Window,
+    Probation,
+    Protected,
+}
+
+#[derive(Debug)]
+struct Node<V> {
+    key: String,
+    hash: u64,
+    value: V,
+    charge: usize,
+    inserted_at: Instant,
+    segment: Segment,
+    prev: usize,
+    next: usize,
+}
+
+/// 双向链表头，head 为最近使用端
+#[derive(Debug)]
+struct List {
+    head: usize,
+    tail: usize,
+    bytes: usize,
+}
+
+impl List {
+    fn new() -> Self {
+        Self { head: NIL, tail: NIL, bytes: 0 }
+    }
+}
+
+#[derive(Debug)]
+struct Shard<V> {
+    map: HashMap<String, usize>,
+    nodes: Vec<Option<Node<V>>>,
+    free: Vec<usize>,
+    window: List,
+    probation: List,
+    protected: List,
+    window_capacity: usize,
+    main_capacity: usize,
+    protected_capacity: usize,
+    sketch: FrequencySketch,
+}
+
+impl<V> Shard<V> {
+    fn new(capacity: usize) -> Self {
+        let window_capacity = (capacity / 100).max(1);
+        let main_capacity = capacity - window_capacity.min(capacity);
+        Self {
+            map: HashMap::new(),
+            nodes: Vec::new(),
+            free: Vec::new(),
+            window: List::new(),
+            probation: List::new(),
+            protected: List::new(),
+            window_capacity,
+            main_capacity,
+            protected_capacity: main_capacity * 4 / 5,
+            // 以约 64 字节一条估算预期条目数，宽度限制在 [1K, 64K]
+            sketch: FrequencySketch::new((capacity / 64).clamp(1024, 1 << 16)),
+        }
+    }
+
+    fn node(&self, index: usize) -> &Node<V> {
+        self.nodes[index].as_ref().expect("live cache node")
+    }
+
+    fn node_mut(&mut self, index: usize) -> &mut Node<V> {
+        self.nodes[index].as_mut().expect("live cache node")
+    }
+
+    fn list_mut(&mut self, segment: Segment) -> &mut List {
+        match segment {
+            Segment::Window => &mut self.window,
+            Segment::Probation => &mut self.probation,
+            Segment::Protected => &mut self.protected,
+        }
+    }
+
+    fn unlink(&mut self, index: usize) {
+        let (prev, next, segment, charge) = {
+            let node = self.node(index);
+            (node.prev, node.next, node.segment, node.charge)
+        };
+        if prev != NIL {
+            self.node_mut(prev).next = next;
+        }
+        if next != NIL {
+            self.node_mut(next).prev = prev;
+        }
+        let list = self.list_mut(segment);
+        if list.head == index {
+            list.head = next;
+        }
+        if list.tail == index {
+            list.tail = prev;
+        }
+        list.bytes -= charge;
+    }
+
+    fn push_front(&mut self, index: usize, segment: Segment) {
+        let head = self.list_mut(segment).head;
+        {
+            let node = self.node_mut(index);
+            node.segment = segment;
+            node.prev = NIL;
+            node.next = head;
+        }
+        if head != NIL {
+            self.node_mut(head).prev = index;
+        }
+        let charge = self.node(index).charge;
+        let list = self.list_mut(segment);
+        list.head = index;
+        if list.tail == NIL {
+            list.tail = index;
+        }
+        list.bytes += charge;
+    }
+
+    fn remove(&mut self, index: usize) -> Node<V> {
+        self.unlink(index);
+        let node = self.nodes[index].take().expect("live cache node");
+        self.map.remove(&node.key);
+        self.free.push(index);
+        node
+    }
+
+    fn bytes(&self) -> usize {
+        self.window.bytes + self.probation.bytes + self.protected.bytes
+    }
+
+    /// 命中后按段调整位置：试用段晋升保护段，保护段溢出时降级回试用段
+    fn touch(&mut self, index: usize) {
+        let segment = self.node(index).segment;
+        self.unlink(index);
+        match segment {
+            Segment::Window => self.push_front(index, Segment::Window),
+            Segment::Probation | Segment::Protected => {
+                self.push_front(index, Segment::Protected);
+                while self.protected.bytes > self.protected_capacity && self.protected.tail != index {
+                    let demoted = self.protected.tail;
+                    self.unlink(demoted);
+                    self.push_front(demoted, Segment::Probation);
+                }
+            }
+        }
+    }
+
+    /// 主区的淘汰对象：优先试用段尾部
+    fn main_victim(&self) -> usize {
+        if self.probation.tail != NIL {
+            self.probation.tail
+        } else {
+            self.protected.tail
+        }
+    }
+
+    /// 窗口段溢出时把候选条目移入主区，或在频率不占优时淘汰
+    fn rebalance(&mut self, counters: &CacheCounters) {
+        while self.window.bytes > self.window_capacity && self.window.tail != NIL {
+            let candidate = self.window.tail;
+            self.unlink(candidate);
+            let charge = self.node(candidate).charge;
+            let candidate_frequency = self.sketch.frequency(self.node(candidate).hash);
+
+            let mut admitted = true;
+            while self.probation.bytes + self.protected.bytes + charge > self.main_capacity {
+                let victim = self.main_victim();
+                if victim == NIL {
+                    admitted = charge <= self.main_capacity;
+                    break;
+                }
+                if candidate_frequency > self.sketch.frequency(self.node(victim).hash) {
+                    self.remove(victim);
+                    CacheCounters::bump(&counters.evictions);
+                } else {
+                    admitted = false;
+                    break;
+                }
+            }
+
+            if admitted {
+                self.push_front(candidate, Segment::Probation);
+            } else {
+                // remove 需要链表中的节点，先挂回窗口段再移除
+                self.push_front(candidate, Segment::Window);
+                self.remove(candidate);
+                CacheCounters::bump(&counters.rejections);
+                CacheCounters::bump(&counters.evictions);
+            }
+        }
+    }
+}
+
+/// 分片 W-TinyLFU 缓存，值在读取时克隆
+#[derive(Debug)]
+pub struct ShardedCache<V> {
+    shards: Vec<Mutex<Shard<V>>>,
+    capacity: usize,
+    ttl: Option<Duration>,
+    counters: CacheCounters,
+}
+
+impl<V: Clone> ShardedCache<V> {
+    /// 按字节预算创建缓存，预算平均分给各分片
+    pub fn new(capacity_bytes: usize) -> Self {
+        Self::with_shards(capacity_bytes, DEFAULT_SHARDS)
+    }
+
+    pub fn with_shards(capacity_bytes: usize, shards: usize) -> Self {
+        let shards = shards.max(1).next_power_of_two();
+        let per_shard = (capacity_bytes / shards).max(1);
+        Self {
+            shards: (0..shards).map(|_| Mutex::new(Shard::new(per_shard))).collect(),
+            capacity: capacity_bytes,
+            ttl: None,
+            counters: CacheCounters::default(),
+        }
+    }
+
+    /// 设置条目存活时间，过期条目在读取时丢弃
+    pub fn set_ttl(&mut self, ttl: Option<Duration>) {
+        self.ttl = ttl;
+    }
+
+    pub fn capacity(&self) -> usize {
+        self.capacity
+    }
+
+    pub fn counters(&self) -> &CacheCounters {
+        &self.counters
+    }
+
+    fn hash(key: &str) -> u64 {
+        let mut hasher = DefaultHasher::new();
+        key.hash(&mut hasher);
+        hasher.finish()
+    }
+
+    fn shard(&self, hash: u64) -> &Mutex<Shard<V>> {
+        &self.shards[(hash >> 48) as usize & (self.shards.len() - 1)]
+    }
+
+    /// 查找条目，命中时先用 f 读/改条目再返回其结果
+    pub fn get_with<R>(&self, key: &str, f: impl FnOnce(&mut V) -> R) -> Option<R> {
+        CacheCounters::bump(&self.counters.lookups);
+        let hash = Self::hash(key);
+        let mut shard = self.shard(hash).lock().unwrap();
+        shard.sketch.increment(hash);
+
+        let index = match shard.map.get(key) {
+            Some(&index) => index,
+            None => {
+                CacheCounters::bump(&self.counters.misses);
+                return None;
+            }
+        };
+        if let Some(ttl) = self.ttl {
+            if shard.node(index).inserted_at.elapsed() >= ttl {
+                shard.remove(index);
+                CacheCounters::bump(&self.counters.misses);
+                return None;
+            }
+        }
+        shard.touch(index);
+        CacheCounters::bump(&self.counters.hits);
+        Some(f(&mut shard.node_mut(index).value))
+    }
+
+    pub fn get(&self, key: &str) -> Option<V> {
+        self.get_with(key, |value| value.clone())
+    }
+
+    /// 插入或替换条目，charge 为条目占用的字节数；超过单个分片容量的条目不缓存
+    pub fn insert(&self, key: &str, value: V, charge: usize) -> bool {
+        let hash = Self::hash(key);
+        let mut shard = self.shard(hash).lock().unwrap();
+        shard.sketch.increment(hash);
+        if charge > shard.main_capacity.max(shard.window_capacity) {
+            CacheCounters::bump(&self.counters.rejections);
+            return false;
+        }
+
+        if let Some(&index) = shard.map.get(key) {
+            shard.remove(index);
+        }
+        let node = Node {
+            key: key.to_string(),
+            hash,
+            value,
+            charge,
+            inserted_at: Instant::now(),
+            segment: Segment::Window,
+            prev: NIL,
+            next: NIL,
+        };
+        let index = match shard.free.pop() {
+            Some(index) => {
+                shard.nodes[index] = Some(node);
+                index
+            }
+            None => {
+                shard.nodes.push(Some(node));
+                shard.nodes.len() - 1
+            }
+        };
+        shard.map.insert(key.to_string(), index);
+        shard.push_front(index, Segment::Window);
+        CacheCounters::bump(&self.counters.inserts);
+        shard.rebalance(&self.counters);
+        true
+    }
+
+    pub fn remove(&self, key: &str) -> Option<V> {
+        let hash = Self::hash(key);
+        let mut shard = self.shard(hash).lock().unwrap();
+        let index = *shard.map.get(key)?;
+        Some(shard.remove(index).value)
+    }
+
+    /// 保留满足条件的条目
+    pub fn retain(&self, mut keep: impl FnMut(&str, &V, Instant) -> bool) {
+        for shard in &self.shards {
+            let mut shard = shard.lock().unwrap();
+            let doomed: Vec<usize> = shard
+                .map
+                .values()
+                .copied()
+                .filter(|&index| {
+                    let node = shard.node(index);
+                    !keep(&node.key, &node.value, node.inserted_at)
+                })
+                .collect();
+            for index in doomed {
+                shard.remove(index);
+            }
+        }
+    }
+
+    pub fn clear(&self) {
+        self.retain(|_, _, _| false);
+    }
+
+    pub fn len(&self) -> usize {
+        self.shards.iter().map(|s| s.lock().unwrap().map.len()).sum()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// 当前占用的字节数
+    pub fn bytes(&self) -> usize {
+        self.shards.iter().map(|s| s.lock().unwrap().bytes()).sum()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_insert_get_and_replace() {
+        let cache = ShardedCache::new(64 * 1024);
+        assert!(cache.insert("a", 1, 10));
+        assert!(cache.insert("a", 2, 20));
+        assert_eq!(cache.get("a"), Some(2));
+        assert_eq!(cache.get("b"), None);
+        assert_eq!(cache.len(), 1);
+        assert_eq!(cache.bytes(), 20);
+        assert_eq!(cache.remove("a"), Some(2));
+        assert!(cache.is_empty());
+    }
+
+    #[test]
+    fn test_byte_budget_is_enforced() {
+        let cache = ShardedCache::with_shards(10_000, 1);
+        for i in 0..1000 {
+            cache.insert(&format!("k{}", i), i, 100);
+        }
+        assert!(cache.bytes() <= 10_000);
+        assert!(cache.counters().evictions.load(Ordering::Relaxed) > 0);
+        // 超过分片容量的条目直接拒绝
+        assert!(!cache.insert("huge", 0, 20_000));
+    }
+
+    #[test]
+    fn test_hot_entries_survive_one_off_scan() {
+        let cache = ShardedCache::with_shards(10_000, 1);
+        for i in 0..50 {
+            cache.insert(&format!("hot{}", i), i, 100);
+        }
+        for _ in 0..5 {
+            for i in 0..50 {
+                assert!(cache.get(&format!("hot{}", i)).is_some());
+            }
+        }
+        // 大量只出现一次的键不应冲掉热点
+        for i in 0..2000 {
+            cache.insert(&format!("once{}", i), i, 100);
+        }
+        let survivors = (0..50).filter(|i| cache.get(&format!("hot{}", i)).is_some()).count();
+        assert!(survivors >= 45, "only {} hot entries survived", survivors);
+    }
+
+    #[test]
+    fn test_ttl_expires_on_read() {
+        let mut cache = ShardedCache::new(1024);
+        cache.set_ttl(Some(Duration::from_millis(0)));
+        cache.insert("a", 1, 1);
+        assert_eq!(cache.get("a"), None);
+        assert!(cache.is_empty());
+    }
+}
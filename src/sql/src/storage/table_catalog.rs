@@ -0,0 +1,110 @@
+//! 表结构目录
+//!
+//! 记录每张表的列名、列 ID 与列类型。行按列 ID 编码 (`codec::encode_row_with_ids`)，
+//! 下推程序、区间摘要谓词和按列投影的扫描都需要把 SQL 中的列名落到列 ID 上，
+//! 不能使用列在 SELECT 列表中的位置。
+
+use std::collections::HashMap;
+use std::sync::{Arc, OnceLock, RwLock};
+
+use common::DataType;
+
+use crate::executor::record_batch::{Field, Schema};
+
+/// 表中的一列
+#[derive(Debug, Clone, PartialEq)]
+pub struct TableColumn {
+    pub name: String,
+    pub column_id: u32,
+    pub data_type: DataType,
+}
+
+impl TableColumn {
+    pub fn new(name: impl Into<String>, column_id: u32, data_type: DataType) -> Self {
+        Self { name: name.into(), column_id, data_type }
+    }
+}
+
+/// 表名 -> 表的列定义 (按定义顺序)
+#[derive(Debug, Default)]
+pub struct TableCatalog {
+    tables: RwLock<HashMap<String, Vec<TableColumn>>>,
+}
+
+impl TableCatalog {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// 进程级目录，未显式指定目录的 StorageHandler 共用
+    pub fn global() -> Arc<TableCatalog> {
+        static CATALOG: OnceLock<Arc<TableCatalog>> = OnceLock::new();
+        CATALOG.get_or_init(|| Arc::new(TableCatalog::new())).clone()
+    }
+
+    /// 注册表结构；已存在的表被覆盖
+    pub fn register(&self, table: &str, columns: Vec<TableColumn>) {
+        self.tables.write().unwrap().insert(table.to_string(), columns);
+    }
+
+    /// 删除表结构，返回它是否存在
+    pub fn remove(&self, table: &str) -> bool {
+        self.tables.write().unwrap().remove(table).is_some()
+    }
+
+    /// 表的全部列，表未注册时返回 None
+    pub fn columns(&self, table: &str) -> Option<Vec<TableColumn>> {
+        self.tables.read().unwrap().get(table).cloned()
+    }
+
+    /// 按列名查找列；先精确匹配 (忽略大小写)，再去掉表名限定 (`t.id` → `id`) 重试
+    pub fn column(&self, table: &str, name: &str) -> Option<TableColumn> {
+        let tables = self.tables.read().unwrap();
+        let columns = tables.get(table)?;
+        let find = |name: &str| columns.iter().find(|c| c.name.eq_ignore_ascii_case(name)).cloned();
+        find(name).or_else(|| name.rsplit_once('.').and_then(|(_, column)| find(column)))
+    }
+
+    /// 按给定列名解析列，任一列不存在时返回 None；空列表或 `*` 表示全部列
+    pub fn resolve(&self, table: &str, names: &[String]) -> Option<Vec<TableColumn>> {
+        if names.is_empty() || names.iter().any(|c| c == "*") {
+            return self.columns(table);
+        }
+        names.iter().map(|name| self.column(table, name)).collect()
+    }
+
+    /// 给定列的批模式，列名与扫描输出一致
+    pub fn schema(&self, table: &str, names: &[String]) -> Option<Schema> {
+        let columns = self.resolve(table, names)?;
+        Some(Schema::new(columns.into_iter().map(|c| Field::new(c.name, c.data_type)).collect()))
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_register_and_resolve() {
+        let catalog = TableCatalog::new();
+        assert!(catalog.resolve("emp", &[]).is_none());
+
+        catalog.register("emp", vec![
+            TableColumn::new("id", 1, DataType::BigInt),
+            TableColumn::new("dept", 2, DataType::String),
+            TableColumn::new("salary", 5, DataType::Double),
+        ]);
+
+        // 列 ID 来自表定义，与 SELECT 列表中的位置无关
+        let columns = catalog.resolve("emp", &["salary".to_string(), "emp.id".to_string()]).unwrap();
+        assert_eq!(columns.iter().map(|c| c.column_id).collect::<Vec<_>>(), vec![5, 1]);
+        assert_eq!(catalog.resolve("emp", &["*".to_string()]).unwrap().len(), 3);
+        assert!(catalog.resolve("emp", &["bonus".to_string()]).is_none());
+
+        let schema = catalog.schema("emp", &["SALARY".to_string()]).unwrap();
+        assert_eq!(schema.fields[0].data_type, DataType::Double);
+
+        assert!(catalog.remove("emp"));
+        assert!(catalog.columns("emp").is_none());
+    }
+}
@@ -0,0 +1,124 @@
+//! 存储引擎基准：get / scan / batch_get / batch_put
+//!
+//! MemoryEngine 始终运行；TiKVEngine 需要可用的集群，设置
+//! `SEALDB_BENCH_PD_ENDPOINTS=127.0.0.1:2379[,...]` 后才会加入对比，否则跳过。
+//!
+//! 运行：`cargo bench -p storage --bench engines`，基线的保存与比较见顶层 Makefile。
+
+use std::time::Duration;
+
+use criterion::{black_box, criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+use storage::{EngineType, Key, MemoryEngine, StorageConfig, StorageContext, StorageEngine, StorageOptions, TiKVEngine, Value};
+
+/// 预先写入的键数
+const PRELOADED_KEYS: usize = 100_000;
+const VALUE_SIZE: usize = 128;
+const BATCH_SIZES: [usize; 3] = [16, 128, 1024];
+const SCAN_LIMITS: [u32; 3] = [10, 100, 1000];
+
+fn key(i: usize) -> Key {
+    format!("bench_{:010}", i).into_bytes().into()
+}
+
+fn value(i: usize) -> Value {
+    let mut value = vec![b'v'; VALUE_SIZE];
+    value[..8].copy_from_slice(&(i as u64).to_be_bytes());
+    value.into()
+}
+
+/// 要对比的引擎，每个都已初始化并写入 `PRELOADED_KEYS` 个键
+fn engines(rt: &tokio::runtime::Runtime) -> Vec<(&'static str, Box<dyn StorageEngine>)> {
+    let mut engines: Vec<(&'static str, Box<dyn StorageEngine>)> = Vec::new();
+
+    let mut memory = MemoryEngine::new();
+    rt.block_on(memory.initialize(&StorageConfig::default())).expect("initialize memory engine");
+    engines.push(("memory", Box::new(memory)));
+
+    if let Ok(endpoints) = std::env::var("SEALDB_BENCH_PD_ENDPOINTS") {
+        let mut config = StorageConfig::default();
+        config.engine_type = EngineType::TiKV;
+        config.connection_string = endpoints;
+        let mut tikv = TiKVEngine::new();
+        match rt.block_on(tikv.initialize(&config)) {
+            Ok(()) => engines.push(("tikv", Box::new(tikv))),
+            Err(e) => eprintln!("skipping TiKV benchmarks: {}", e),
+        }
+    }
+
+    let (context, options) = (StorageContext::default(), StorageOptions::default());
+    for (_, engine) in &engines {
+        rt.block_on(async {
+            let pairs: Vec<_> = (0..PRELOADED_KEYS).map(|i| (key(i), value(i))).collect();
+            for chunk in pairs.chunks(1024) {
+                engine.batch_put(chunk, &context, &options).await.expect("preload");
+            }
+        });
+    }
+    engines
+}
+
+fn bench_engines(c: &mut Criterion) {
+    let rt = tokio::runtime::Builder::new_multi_thread().enable_all().build().expect("tokio runtime");
+    let engines = engines(&rt);
+    let (context, options) = (StorageContext::default(), StorageOptions::default());
+
+    let mut group = c.benchmark_group("engine/get");
+    group.throughput(Throughput::Elements(1));
+    for (name, engine) in &engines {
+        let mut i = 0usize;
+        group.bench_function(*name, |b| {
+            b.to_async(&rt).iter(|| {
+                // 步长与键数互质，依次访问全部键且不落在同一热点上
+                i = (i + 7_919) % PRELOADED_KEYS;
+                let key = key(i);
+                let (engine, context, options) = (engine, &context, &options);
+                async move { black_box(engine.get(&key, context, options).await.unwrap()) }
+            })
+        });
+    }
+    group.finish();
+
+    let mut group = c.benchmark_group("engine/scan");
+    for limit in SCAN_LIMITS {
+        group.throughput(Throughput::Elements(limit as u64));
+        for (name, engine) in &engines {
+            let (start, end) = (key(PRELOADED_KEYS / 2), key(PRELOADED_KEYS));
+            group.bench_with_input(BenchmarkId::new(*name, limit), &limit, |b, &limit| {
+                b.to_async(&rt).iter(|| async { black_box(engine.scan(&start, &end, limit, &context, &options).await.unwrap()) })
+            });
+        }
+    }
+    group.finish();
+
+    let mut group = c.benchmark_group("engine/batch_get");
+    for size in BATCH_SIZES {
+        group.throughput(Throughput::Elements(size as u64));
+        let keys: Vec<_> = (0..size).map(|i| key(i * (PRELOADED_KEYS / size))).collect();
+        for (name, engine) in &engines {
+            group.bench_with_input(BenchmarkId::new(*name, size), &size, |b, _| {
+                b.to_async(&rt).iter(|| async { black_box(engine.batch_get(&keys, &context, &options).await.unwrap()) })
+            });
+        }
+    }
+    group.finish();
+
+    let mut group = c.benchmark_group("engine/batch_put");
+    for size in BATCH_SIZES {
+        group.throughput(Throughput::Elements(size as u64));
+        // 覆盖写已有的键，数据集大小在整个基准期间保持不变
+        let pairs: Vec<_> = (0..size).map(|i| (key(i), value(i + 1))).collect();
+        for (name, engine) in &engines {
+            group.bench_with_input(BenchmarkId::new(*name, size), &size, |b, _| {
+                b.to_async(&rt).iter(|| async { black_box(engine.batch_put(&pairs, &context, &options).await.unwrap()) })
+            });
+        }
+    }
+    group.finish();
+}
+
+criterion_group! {
+    name = engines_benches;
+    config = Criterion::default().measurement_time(Duration::from_secs(5));
+    targets = bench_engines
+}
+criterion_main!(engines_benches);
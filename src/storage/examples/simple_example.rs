@@ -19,8 +19,8 @@ async fn main() -> Result<()> {
     let options = StorageOptions::default();
 
     // PUT 操作
-    let key = b"test_key".to_vec();
-    let value = b"test_value".to_vec();
+    let key = Key::from_static(b"test_key");
+    let value = Value::from_static(b"test_value");
     engine.put(&key, &value, &context, &options).await?;
     println!("PUT 操作完成");
 
@@ -29,12 +29,12 @@ async fn main() -> Result<()> {
     println!("GET 操作结果: {:?}", result.value);
 
     // SCAN 操作
-    let scan_result = engine.scan(&b"test".to_vec(), &b"test\xff".to_vec(), 10, &context, &options).await?;
+    let scan_result = engine.scan(&Key::from_static(b"test"), &Key::from_static(b"test\xff"), 10, &context, &options).await?;
     println!("SCAN 操作结果: {} 条记录", scan_result.value.len());
 
     // 批量操作
-    let batch_keys = vec![b"key1".to_vec(), b"key2".to_vec()];
-    let batch_values = vec![b"value1".to_vec(), b"value2".to_vec()];
+    let batch_keys = vec![Key::from_static(b"key1"), Key::from_static(b"key2")];
+    let batch_values = vec![Value::from_static(b"value1"), Value::from_static(b"value2")];
     let batch_data: Vec<KeyValue> = batch_keys.iter()
         .zip(batch_values.iter())
         .map(|(k, v)| (k.clone(), v.clone()))
@@ -47,8 +47,8 @@ async fn main() -> Result<()> {
     let mut transaction = engine.begin_transaction(&context, &options).await?;
     println!("事务开始: {}", transaction.transaction_id());
 
-    let tx_key = b"tx_key".to_vec();
-    let tx_value = b"tx_value".to_vec();
+    let tx_key = Key::from_static(b"tx_key");
+    let tx_value = Value::from_static(b"tx_value");
     transaction.put(&tx_key, &tx_value, &options).await?;
 
     transaction.commit().await?;
@@ -0,0 +1,396 @@
+//! 点请求合并与自动批处理
+//!
+//! 并发到达、落在同一区域的点读写在一个很短的时间窗口内攒成一批：
+//! 重复的键只读一次，结果按键分发给所有等待者；批次攒满 `max_batch_size`
+//! 时立即发出，否则在 `max_wait` 到期后发出。显式的 `batch_get` 按区域拆分，
+//! 各区域的子请求并行执行。
+
+use async_trait::async_trait;
+use parking_lot::{Mutex, RwLock};
+use std::collections::{BTreeMap, HashMap};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::Arc;
+use std::time::Duration;
+use tokio::sync::oneshot;
+use tracing::debug;
+
+use crate::common::{Key, KeyValue, StorageError, Value};
+
+/// 批处理配置
+#[derive(Debug, Clone)]
+pub struct BatchConfig {
+    /// 是否启用点请求合并
+    pub enabled: bool,
+    /// 单批最多的键数，攒满立即发出
+    pub max_batch_size: usize,
+    /// 批次从第一个请求开始最多等待的时间
+    pub max_wait: Duration,
+}
+
+impl Default for BatchConfig {
+    fn default() -> Self {
+        Self {
+            enabled: false,
+            max_batch_size: 128,
+            max_wait: Duration::from_micros(500),
+        }
+    }
+}
+
+/// 区域划分：按升序分裂键把键空间切成若干区域
+#[derive(Debug, Clone, Default)]
+pub struct RegionMap {
+    split_keys: Vec<Key>,
+}
+
+impl RegionMap {
+    pub fn new(mut split_keys: Vec<Key>) -> Self {
+        split_keys.sort();
+        split_keys.dedup();
+        Self { split_keys }
+    }
+
+    /// 区域数
+    pub fn region_count(&self) -> usize {
+        self.split_keys.len() + 1
+    }
+
+    /// 键所在区域：区域 i 覆盖 `[split[i-1], split[i])`
+    pub fn region_of(&self, key: &[u8]) -> usize {
+        self.split_keys.partition_point(|split| split[..] <= *key)
+    }
+
+    /// 按区域分组，组内保持输入顺序
+    pub fn group_by_region<T>(&self, items: Vec<T>, key: impl Fn(&T) -> &[u8]) -> BTreeMap<usize, Vec<T>> {
+        let mut groups: BTreeMap<usize, Vec<T>> = BTreeMap::new();
+        for item in items {
+            groups.entry(self.region_of(key(&item))).or_default().push(item);
+        }
+        groups
+    }
+}
+
+/// 批量请求的实际执行者
+#[async_trait]
+pub trait BatchExecutor: Send + Sync {
+    async fn batch_get(&self, keys: Vec<Key>) -> Result<HashMap<Key, Option<Value>>, StorageError>;
+
+    async fn batch_put(&self, pairs: Vec<KeyValue>) -> Result<(), StorageError>;
+}
+
+/// 批处理统计
+#[derive(Debug, Clone, Default)]
+pub struct BatcherStats {
+    /// 进入合并层的点请求数
+    pub requests: u64,
+    /// 发出的批量请求数
+    pub batches: u64,
+    /// 因重复而省掉的键数
+    pub deduplicated: u64,
+}
+
+type GetWaiter = oneshot::Sender<Result<Option<Value>, StorageError>>;
+type PutWaiter = oneshot::Sender<Result<(), StorageError>>;
+
+struct PendingGets {
+    generation: u64,
+    waiters: HashMap<Key, Vec<GetWaiter>>,
+}
+
+struct PendingPuts {
+    generation: u64,
+    /// 同一批内对同一键的多次写入，后到者覆盖先到者
+    values: HashMap<Key, Value>,
+    waiters: Vec<PutWaiter>,
+}
+
+/// 点请求合并器
+pub struct RequestBatcher {
+    config: BatchConfig,
+    regions: Arc<RwLock<RegionMap>>,
+    executor: Arc<dyn BatchExecutor>,
+    gets: Mutex<HashMap<usize, PendingGets>>,
+    puts: Mutex<HashMap<usize, PendingPuts>>,
+    generation: AtomicU64,
+    requests: AtomicU64,
+    batches: AtomicU64,
+    deduplicated: AtomicU64,
+}
+
+impl RequestBatcher {
+    pub fn new(config: BatchConfig, regions: Arc<RwLock<RegionMap>>, executor: Arc<dyn BatchExecutor>) -> Self {
+        Self {
+            config,
+            regions,
+            executor,
+            gets: Mutex::new(HashMap::new()),
+            puts: Mutex::new(HashMap::new()),
+            generation: AtomicU64::new(0),
+            requests: AtomicU64::new(0),
+            batches: AtomicU64::new(0),
+            deduplicated: AtomicU64::new(0),
+        }
+    }
+
+    pub fn stats(&self) -> BatcherStats {
+        BatcherStats {
+            requests: self.requests.load(Ordering::Relaxed),
+            batches: self.batches.load(Ordering::Relaxed),
+            deduplicated: self.deduplicated.load(Ordering::Relaxed),
+        }
+    }
+
+    /// 合并读取单个键
+    pub async fn get(self: &Arc<Self>, key: Key) -> Result<Option<Value>, StorageError> {
+        self.requests.fetch_add(1, Ordering::Relaxed);
+        let region = self.regions.read().region_of(&key);
+        let (sender, receiver) = oneshot::channel();
+
+        let (full, timer) = {
+            let mut gets = self.gets.lock();
+            let pending = gets.entry(region).or_insert_with(|| PendingGets {
+                generation: self.generation.fetch_add(1, Ordering::Relaxed),
+                waiters: HashMap::new(),
+            });
+            let timer = pending.waiters.is_empty().then_some(pending.generation);
+            let waiters = pending.waiters.entry(key).or_default();
+            if !waiters.is_empty() {
+                self.deduplicated.fetch_add(1, Ordering::Relaxed);
+            }
+            waiters.push(sender);
+            let full = if pending.waiters.len() >= self.config.max_batch_size {
+                gets.remove(&region)
+            } else {
+                None
+            };
+            (full, timer)
+        };
+
+        if let Some(batch) = full {
+            tokio::spawn(self.clone().flush_gets(batch));
+        } else if let Some(generation) = timer {
+            let batcher = self.clone();
+            tokio::spawn(async move {
+                tokio::time::sleep(batcher.config.max_wait).await;
+                let batch = {
+                    let mut gets = batcher.gets.lock();
+                    match gets.get(&region) {
+                        Some(pending) if pending.generation == generation => gets.remove(&region),
+                        _ => None,
+                    }
+                };
+                if let Some(batch) = batch {
+                    batcher.flush_gets(batch).await;
+                }
+            });
+        }
+
+        receiver
+            .await
+            .unwrap_or_else(|_| Err(StorageError::Internal("batched get was dropped".to_string())))
+    }
+
+    /// 合并写入单个键
+    pub async fn put(self: &Arc<Self>, key: Key, value: Value) -> Result<(), StorageError> {
+        self.requests.fetch_add(1, Ordering::Relaxed);
+        let region = self.regions.read().region_of(&key);
+        let (sender, receiver) = oneshot::channel();
+
+        let (full, timer) = {
+            let mut puts = self.puts.lock();
+            let pending = puts.entry(region).or_insert_with(|| PendingPuts {
+                generation: self.generation.fetch_add(1, Ordering::Relaxed),
+                values: HashMap::new(),
+                waiters: Vec::new(),
+            });
+            let timer = pending.waiters.is_empty().then_some(pending.generation);
+            if pending.values.insert(key, value).is_some() {
+                self.deduplicated.fetch_add(1, Ordering::Relaxed);
+            }
+            pending.waiters.push(sender);
+            let full = if pending.values.len() >= self.config.max_batch_size {
+                puts.remove(&region)
+            } else {
+                None
+            };
+            (full, timer)
+        };
+
+        if let Some(batch) = full {
+            tokio::spawn(self.clone().flush_puts(batch));
+        } else if let Some(generation) = timer {
+            let batcher = self.clone();
+            tokio::spawn(async move {
+                tokio::time::sleep(batcher.config.max_wait).await;
+                let batch = {
+                    let mut puts = batcher.puts.lock();
+                    match puts.get(&region) {
+                        Some(pending) if pending.generation == generation => puts.remove(&region),
+                        _ => None,
+                    }
+                };
+                if let Some(batch) = batch {
+                    batcher.flush_puts(batch).await;
+                }
+            });
+        }
+
+        receiver
+            .await
+            .unwrap_or_else(|_| Err(StorageError::Internal("batched put was dropped".to_string())))
+    }
+
+    /// 批量读取：去重后按区域拆分，各区域按 `max_batch_size` 分块并行执行
+    pub async fn batch_get(&self, keys: &[Key]) -> Result<HashMap<Key, Option<Value>>, StorageError> {
+        let mut unique = keys.to_vec();
+        unique.sort_unstable();
+        unique.dedup();
+        self.deduplicated.fetch_add((keys.len() - unique.len()) as u64, Ordering::Relaxed);
+
+        let groups = self.regions.read().group_by_region(unique, |key| key.as_ref());
+        let chunk_size = self.config.max_batch_size.max(1);
+        let requests = groups
+            .into_values()
+            .flat_map(|keys| keys.chunks(chunk_size).map(<[Key]>::to_vec).collect::<Vec<_>>())
+            .map(|chunk| {
+                self.batches.fetch_add(1, Ordering::Relaxed);
+                self.executor.batch_get(chunk)
+            });
+
+        let mut result = HashMap::with_capacity(keys.len());
+        for partial in futures::future::try_join_all(requests).await? {
+            result.extend(partial);
+        }
+        Ok(result)
+    }
+
+    async fn flush_gets(self: Arc<Self>, batch: PendingGets) {
+        self.batches.fetch_add(1, Ordering::Relaxed);
+        let keys: Vec<Key> = batch.waiters.keys().cloned().collect();
+        debug!("Flushing coalesced get batch: {} keys", keys.len());
+
+        match self.executor.batch_get(keys).await {
+            Ok(mut values) => {
+                for (key, waiters) in batch.waiters {
+                    let value = values.remove(&key).flatten();
+                    for waiter in waiters {
+                        let _ = waiter.send(Ok(value.clone()));
+                    }
+                }
+            }
+            Err(e) => {
+                for waiter in batch.waiters.into_values().flatten() {
+                    let _ = waiter.send(Err(e.clone()));
+                }
+            }
+        }
+    }
+
+    async fn flush_puts(self: Arc<Self>, batch: PendingPuts) {
+        self.batches.fetch_add(1, Ordering::Relaxed);
+        let pairs: Vec<KeyValue> = batch.values.into_iter().collect();
+        debug!("Flushing coalesced put batch: {} keys", pairs.len());
+
+        let result = self.executor.batch_put(pairs).await;
+        for waiter in batch.waiters {
+            let _ = waiter.send(result.clone());
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::common::Bytes;
+
+    /// 记录每次批量调用的执行者
+    #[derive(Default)]
+    struct RecordingExecutor {
+        data: Mutex<HashMap<Key, Value>>,
+        get_calls: Mutex<Vec<Vec<Key>>>,
+        put_calls: Mutex<Vec<usize>>,
+    }
+
+    #[async_trait]
+    impl BatchExecutor for RecordingExecutor {
+        async fn batch_get(&self, keys: Vec<Key>) -> Result<HashMap<Key, Option<Value>>, StorageError> {
+            let data = self.data.lock();
+            let result = keys.iter().map(|key| (key.clone(), data.get(key).cloned())).collect();
+            self.get_calls.lock().push(keys);
+            Ok(result)
+        }
+
+        async fn batch_put(&self, pairs: Vec<KeyValue>) -> Result<(), StorageError> {
+            self.put_calls.lock().push(pairs.len());
+            self.data.lock().extend(pairs);
+            Ok(())
+        }
+    }
+
+    fn batcher(executor: Arc<RecordingExecutor>, splits: Vec<Key>, max_batch_size: usize, max_wait: Duration) -> Arc<RequestBatcher> {
+        let config = BatchConfig {
+            enabled: true,
+            max_batch_size,
+            max_wait,
+        };
+        Arc::new(RequestBatcher::new(config, Arc::new(RwLock::new(RegionMap::new(splits))), executor))
+    }
+
+    #[tokio::test]
+    async fn test_concurrent_gets_are_coalesced_and_deduplicated() {
+        let executor = Arc::new(RecordingExecutor::default());
+        executor.data.lock().insert(Bytes::from_static(b"a"), Bytes::from_static(b"1"));
+        let batcher = batcher(executor.clone(), vec![], 64, Duration::from_millis(5));
+
+        let lookups = ["a", "b", "a", "a", "c"].map(|key| {
+            let batcher = batcher.clone();
+            tokio::spawn(async move { batcher.get(Key::from(key)).await })
+        });
+        let mut values = Vec::new();
+        for lookup in lookups {
+            values.push(lookup.await.unwrap().unwrap());
+        }
+
+        assert_eq!(values[0], Some(Bytes::from_static(b"1")));
+        assert_eq!(values[1], None);
+        assert_eq!(values[3], Some(Bytes::from_static(b"1")));
+        let calls = executor.get_calls.lock();
+        assert_eq!(calls.len(), 1);
+        assert_eq!(calls[0].len(), 3);
+        assert_eq!(batcher.stats().deduplicated, 2);
+    }
+
+    #[tokio::test]
+    async fn test_full_batch_flushes_without_waiting() {
+        let executor = Arc::new(RecordingExecutor::default());
+        // 等待窗口远长于测试超时，只有攒满才会发出
+        let batcher = batcher(executor.clone(), vec![], 2, Duration::from_secs(60));
+
+        let writes = (0..4).map(|i| {
+            let batcher = batcher.clone();
+            tokio::spawn(async move { batcher.put(Key::from(vec![i]), Value::from(vec![i])).await })
+        });
+        let done = tokio::time::timeout(Duration::from_secs(5), futures::future::join_all(writes)).await;
+        assert!(done.is_ok());
+        assert_eq!(executor.put_calls.lock().iter().sum::<usize>(), 4);
+    }
+
+    #[tokio::test]
+    async fn test_batch_get_is_split_by_region() {
+        let executor = Arc::new(RecordingExecutor::default());
+        let batcher = batcher(executor.clone(), vec![Bytes::from_static(b"m")], 2, Duration::from_millis(5));
+
+        let keys: Vec<Key> = ["a", "b", "c", "x", "y", "a"].iter().map(|k| Key::from(*k)).collect();
+        let result = batcher.batch_get(&keys).await.unwrap();
+        assert_eq!(result.len(), 5);
+
+        let mut calls: Vec<Vec<Key>> = executor.get_calls.lock().clone();
+        calls.sort();
+        // 区域 0: a b | c，区域 1: x y
+        assert_eq!(calls.len(), 3);
+        assert!(calls.iter().all(|call| {
+            let regions: Vec<usize> = call.iter().map(|key| batcher.regions.read().region_of(key)).collect();
+            regions.windows(2).all(|pair| pair[0] == pair[1])
+        }));
+    }
+}
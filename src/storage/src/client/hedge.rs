@@ -0,0 +1,277 @@
+//! 对冲读
+//!
+//! 允许读从副本的请求在主请求超过延迟分位数 (默认 p95) 仍未返回时，
+//! 向另一个副本再发一次，先返回成功结果者胜出。对冲请求受令牌预算约束：
+//! 每个主请求存入 `budget_ratio` 个令牌，每次对冲消耗一个，
+//! 因此额外负载不会超过主请求量的 `budget_ratio`。
+
+use parking_lot::Mutex;
+use std::future::Future;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::time::{Duration, Instant};
+
+use crate::client::load_balancer::{ConnectionInfo, LoadBalancer};
+use crate::common::{EngineType, StorageError};
+
+/// 对冲策略
+#[derive(Debug, Clone)]
+pub struct HedgePolicy {
+    pub enabled: bool,
+    /// 触发对冲的延迟分位数
+    pub quantile: f64,
+    /// 对冲延迟下限，也是没有延迟样本时使用的延迟
+    pub min_delay: Duration,
+    /// 对冲延迟上限
+    pub max_delay: Duration,
+    /// 对冲请求占主请求的最大比例
+    pub budget_ratio: f64,
+    /// 令牌桶容量，限制突发对冲
+    pub max_tokens: f64,
+}
+
+impl Default for HedgePolicy {
+    fn default() -> Self {
+        Self {
+            enabled: false,
+            quantile: 0.95,
+            min_delay: Duration::from_millis(2),
+            max_delay: Duration::from_millis(200),
+            budget_ratio: 0.1,
+            max_tokens: 10.0,
+        }
+    }
+}
+
+/// 对冲统计
+#[derive(Debug, Clone, Default)]
+pub struct HedgeStats {
+    pub requests: u64,
+    pub hedges_sent: u64,
+    /// 对冲请求先于主请求成功的次数
+    pub hedges_won: u64,
+}
+
+/// 对冲读执行器
+pub struct HedgedReader {
+    policy: HedgePolicy,
+    tokens: Mutex<f64>,
+    requests: AtomicU64,
+    hedges_sent: AtomicU64,
+    hedges_won: AtomicU64,
+}
+
+impl HedgedReader {
+    pub fn new(policy: HedgePolicy) -> Self {
+        Self {
+            policy,
+            tokens: Mutex::new(0.0),
+            requests: AtomicU64::new(0),
+            hedges_sent: AtomicU64::new(0),
+            hedges_won: AtomicU64::new(0),
+        }
+    }
+
+    pub fn policy(&self) -> &HedgePolicy {
+        &self.policy
+    }
+
+    pub fn stats(&self) -> HedgeStats {
+        HedgeStats {
+            requests: self.requests.load(Ordering::Relaxed),
+            hedges_sent: self.hedges_sent.load(Ordering::Relaxed),
+            hedges_won: self.hedges_won.load(Ordering::Relaxed),
+        }
+    }
+
+    /// 当前对冲延迟：延迟分位数截断到 `[min_delay, max_delay]`
+    pub fn hedge_delay(&self, load_balancer: &LoadBalancer, engine_type: EngineType) -> Duration {
+        load_balancer
+            .latency_percentile(engine_type, self.policy.quantile)
+            .unwrap_or(self.policy.min_delay)
+            .clamp(self.policy.min_delay, self.policy.max_delay)
+    }
+
+    fn deposit(&self) {
+        let mut tokens = self.tokens.lock();
+        *tokens = (*tokens + self.policy.budget_ratio).min(self.policy.max_tokens);
+    }
+
+    fn try_withdraw(&self) -> bool {
+        let mut tokens = self.tokens.lock();
+        if *tokens >= 1.0 {
+            *tokens -= 1.0;
+            true
+        } else {
+            false
+        }
+    }
+
+    /// 执行一次可对冲的读；每个发出请求的副本的结果恰好向负载均衡器反馈一次
+    pub async fn read<T, F, Fut>(
+        &self,
+        load_balancer: &LoadBalancer,
+        engine_type: EngineType,
+        operation: F,
+    ) -> Result<T, StorageError>
+    where
+        F: Fn(ConnectionInfo) -> Fut,
+        Fut: Future<Output = Result<T, StorageError>>,
+    {
+        let primary = load_balancer
+            .select_connection(engine_type)
+            .ok_or_else(|| StorageError::Connection(format!("no connection available for {:?}", engine_type)))?;
+        self.read_from(load_balancer, engine_type, primary, operation).await
+    }
+
+    /// 以给定连接为主副本执行可对冲的读，对冲副本避开主副本
+    pub async fn read_from<T, F, Fut>(
+        &self,
+        load_balancer: &LoadBalancer,
+        engine_type: EngineType,
+        primary: ConnectionInfo,
+        operation: F,
+    ) -> Result<T, StorageError>
+    where
+        F: Fn(ConnectionInfo) -> Fut,
+        Fut: Future<Output = Result<T, StorageError>>,
+    {
+        self.requests.fetch_add(1, Ordering::Relaxed);
+        self.deposit();
+
+        let primary_id = primary.id.clone();
+        let primary_started = Instant::now();
+        let mut primary_request = Box::pin(operation(primary));
+
+        if !self.policy.enabled {
+            let result = primary_request.await;
+            load_balancer.record_latency(&primary_id, primary_started.elapsed(), result.is_ok());
+            return result;
+        }
+
+        let delay = self.hedge_delay(load_balancer, engine_type);
+        tokio::select! {
+            result = &mut primary_request => {
+                load_balancer.record_latency(&primary_id, primary_started.elapsed(), result.is_ok());
+                return result;
+            }
+            _ = tokio::time::sleep(delay) => {}
+        }
+
+        let secondary = if self.try_withdraw() {
+            load_balancer.select_connection_excluding(engine_type, &[primary_id.clone()])
+        } else {
+            None
+        };
+        let Some(secondary) = secondary else {
+            let result = primary_request.await;
+            load_balancer.record_latency(&primary_id, primary_started.elapsed(), result.is_ok());
+            return result;
+        };
+
+        self.hedges_sent.fetch_add(1, Ordering::Relaxed);
+        let secondary_id = secondary.id.clone();
+        let secondary_started = Instant::now();
+        let mut secondary_request = Box::pin(operation(secondary));
+
+        tokio::select! {
+            result = &mut primary_request => {
+                load_balancer.record_latency(&primary_id, primary_started.elapsed(), result.is_ok());
+                if result.is_ok() {
+                    // 被取消的对冲请求没有结果，只记为取消
+                    load_balancer.record_cancelled(&secondary_id, secondary_started.elapsed());
+                    return result;
+                }
+                let result = secondary_request.await;
+                load_balancer.record_latency(&secondary_id, secondary_started.elapsed(), result.is_ok());
+                if result.is_ok() {
+                    self.hedges_won.fetch_add(1, Ordering::Relaxed);
+                }
+                result
+            }
+            result = &mut secondary_request => {
+                load_balancer.record_latency(&secondary_id, secondary_started.elapsed(), result.is_ok());
+                if result.is_ok() {
+                    self.hedges_won.fetch_add(1, Ordering::Relaxed);
+                    // 慢的主副本记为取消，已等待的时长仍会抬高它的延迟估计
+                    load_balancer.record_cancelled(&primary_id, primary_started.elapsed());
+                    return result;
+                }
+                let result = primary_request.await;
+                load_balancer.record_latency(&primary_id, primary_started.elapsed(), result.is_ok());
+                result
+            }
+        }
+    }
+}
+
+impl Default for HedgedReader {
+    fn default() -> Self {
+        Self::new(HedgePolicy::default())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::client::load_balancer::LoadBalancingStrategy;
+
+    fn load_balancer() -> LoadBalancer {
+        let lb = LoadBalancer::with_strategy(LoadBalancingStrategy::RoundRobin);
+        for id in ["slow", "fast"] {
+            lb.add_connection(EngineType::TiKV, ConnectionInfo {
+                id: id.to_string(),
+                engine_type: EngineType::TiKV,
+                active_connections: 0,
+                total_connections: 1,
+                last_used: Instant::now(),
+                weight: 1.0,
+            });
+        }
+        lb
+    }
+
+    async fn replica_read(conn: ConnectionInfo) -> Result<String, StorageError> {
+        let delay = if conn.id == "slow" { 500 } else { 1 };
+        tokio::time::sleep(Duration::from_millis(delay)).await;
+        Ok(conn.id)
+    }
+
+    fn policy(budget_ratio: f64) -> HedgePolicy {
+        HedgePolicy {
+            enabled: true,
+            min_delay: Duration::from_millis(5),
+            max_delay: Duration::from_millis(5),
+            budget_ratio,
+            ..HedgePolicy::default()
+        }
+    }
+
+    #[tokio::test]
+    async fn test_hedge_wins_against_slow_primary() {
+        let lb = load_balancer();
+        let reader = HedgedReader::new(policy(1.0));
+
+        let started = Instant::now();
+        let winner = reader.read(&lb, EngineType::TiKV, replica_read).await.unwrap();
+        assert_eq!(winner, "fast");
+        assert!(started.elapsed() < Duration::from_millis(400));
+        assert_eq!(reader.stats().hedges_won, 1);
+
+        // 胜出的对冲副本记成功，被取消的主副本既不算成功也不算失败
+        let fast = lb.latency_stats("fast").unwrap();
+        assert_eq!((fast.samples, fast.successes, fast.cancelled), (1, 1, 0));
+        let slow = lb.latency_stats("slow").unwrap();
+        assert_eq!((slow.samples, slow.successes, slow.failures, slow.cancelled), (0, 0, 0, 1));
+        assert!(slow.ewma_ms >= 5.0);
+    }
+
+    #[tokio::test]
+    async fn test_budget_caps_extra_load() {
+        let lb = load_balancer();
+        let reader = HedgedReader::new(policy(0.0));
+
+        let winner = reader.read(&lb, EngineType::TiKV, replica_read).await.unwrap();
+        assert_eq!(winner, "slow");
+        assert_eq!(reader.stats().hedges_sent, 0);
+    }
+}
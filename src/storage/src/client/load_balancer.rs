@@ -2,13 +2,25 @@
 //!
 //! 提供多种负载均衡策略
 
-use std::collections::HashMap;
+use std::collections::{HashMap, VecDeque};
+use std::sync::atomic::{AtomicU64, Ordering};
 use std::sync::Arc;
+use std::time::{Duration, Instant};
 use parking_lot::RwLock;
 use tracing::{debug, info};
 
 use crate::common::*;
 
+/// 延迟 EWMA 的平滑系数
+const EWMA_ALPHA: f64 = 0.3;
+
+/// 每个连接保留的最近延迟样本数，用于估计分位数
+const LATENCY_WINDOW: usize = 128;
+
+/// 最近失败过的连接在这段时间内得分加倍惩罚
+const FAILURE_PENALTY_WINDOW: Duration = Duration::from_secs(5);
+const FAILURE_PENALTY_FACTOR: f64 = 4.0;
+
 /// 负载均衡策略
 #[derive(Debug, Clone, Copy, PartialEq, Eq)]
 pub enum LoadBalancingStrategy {
@@ -16,6 +28,8 @@ pub enum LoadBalancingStrategy {
     LeastConnections,
     Random,
     Weighted,
+    /// 随机取两个连接，选 EWMA 延迟乘以在途请求数较低的一个 (power of two choices)
+    LatencyAware,
 }
 
 /// 负载均衡器
@@ -23,6 +37,79 @@ pub struct LoadBalancer {
     strategy: LoadBalancingStrategy,
     connections: Arc<RwLock<HashMap<EngineType, Vec<ConnectionInfo>>>>,
     round_robin_index: Arc<RwLock<HashMap<EngineType, usize>>>,
+    /// 连接 ID -> 延迟统计，由 `record_latency` 反馈
+    latency: Arc<RwLock<HashMap<String, LatencyStats>>>,
+    rng: AtomicU64,
+}
+
+/// 单个连接的延迟反馈
+#[derive(Debug, Clone, Default)]
+pub struct LatencyStats {
+    pub ewma_ms: f64,
+    pub samples: u64,
+    pub successes: u64,
+    pub failures: u64,
+    /// 落败后被取消的请求数，既不算成功也不算失败
+    pub cancelled: u64,
+    pub last_failure: Option<Instant>,
+    window: VecDeque<f64>,
+}
+
+impl LatencyStats {
+    fn record(&mut self, latency_ms: f64, success: bool) {
+        self.ewma_ms = if self.samples == 0 {
+            latency_ms
+        } else {
+            EWMA_ALPHA * latency_ms + (1.0 - EWMA_ALPHA) * self.ewma_ms
+        };
+        self.samples += 1;
+        if success {
+            self.successes += 1;
+        } else {
+            self.failures += 1;
+            self.last_failure = Some(Instant::now());
+        }
+        if self.window.len() == LATENCY_WINDOW {
+            self.window.pop_front();
+        }
+        self.window.push_back(latency_ms);
+    }
+
+    /// 已等待时长只是真实延迟的下界：只在它高于当前估计时抬高 EWMA，
+    /// 不进入分位数窗口，以免拉低对冲延迟
+    fn record_cancelled(&mut self, waited_ms: f64) {
+        self.cancelled += 1;
+        if self.samples == 0 || waited_ms > self.ewma_ms {
+            self.ewma_ms = if self.samples == 0 {
+                waited_ms
+            } else {
+                EWMA_ALPHA * waited_ms + (1.0 - EWMA_ALPHA) * self.ewma_ms
+            };
+        }
+    }
+
+    /// 最近样本的分位数，`quantile` 取 0..=1
+    pub fn percentile(&self, quantile: f64) -> Option<f64> {
+        percentile_of(self.window.iter().copied().collect(), quantile)
+    }
+
+    /// P2C 得分，越低越好
+    fn score(&self, active_connections: u32) -> f64 {
+        let mut score = self.ewma_ms.max(0.001) * (active_connections as f64 + 1.0);
+        if self.last_failure.map_or(false, |at| at.elapsed() < FAILURE_PENALTY_WINDOW) {
+            score *= FAILURE_PENALTY_FACTOR;
+        }
+        score
+    }
+}
+
+fn percentile_of(mut samples: Vec<f64>, quantile: f64) -> Option<f64> {
+    if samples.is_empty() {
+        return None;
+    }
+    samples.sort_unstable_by(|a, b| a.total_cmp(b));
+    let rank = ((samples.len() - 1) as f64 * quantile.clamp(0.0, 1.0)).round() as usize;
+    Some(samples[rank])
 }
 
 /// 连接信息
@@ -43,9 +130,18 @@ impl LoadBalancer {
             strategy: LoadBalancingStrategy::RoundRobin,
             connections: Arc::new(RwLock::new(HashMap::new())),
             round_robin_index: Arc::new(RwLock::new(HashMap::new())),
+            latency: Arc::new(RwLock::new(HashMap::new())),
+            rng: AtomicU64::new(0x2545_F491_4F6C_DD1D),
         }
     }
 
+    /// 以指定策略创建负载均衡器
+    pub fn with_strategy(strategy: LoadBalancingStrategy) -> Self {
+        let mut load_balancer = Self::new();
+        load_balancer.set_strategy(strategy);
+        load_balancer
+    }
+
     /// 设置负载均衡策略
     pub fn set_strategy(&mut self, strategy: LoadBalancingStrategy) {
         self.strategy = strategy;
@@ -64,24 +160,43 @@ impl LoadBalancer {
         let mut connections = self.connections.write();
         if let Some(engine_connections) = connections.get_mut(&engine_type) {
             engine_connections.retain(|conn| conn.id != connection_id);
+            self.latency.write().remove(connection_id);
             debug!("Removed connection {} for engine: {:?}", connection_id, engine_type);
         }
     }
 
     /// 选择连接
     pub fn select_connection(&self, engine_type: EngineType) -> Option<ConnectionInfo> {
+        self.select_connection_excluding(engine_type, &[])
+    }
+
+    /// 选择连接，跳过 `excluded` 中的连接 (例如刚刚失败的节点或对冲请求的主副本)
+    pub fn select_connection_excluding(&self, engine_type: EngineType, excluded: &[String]) -> Option<ConnectionInfo> {
         let connections = self.connections.read();
         let engine_connections = connections.get(&engine_type)?;
 
-        if engine_connections.is_empty() {
+        let filtered: Vec<ConnectionInfo>;
+        let candidates: &[ConnectionInfo] = if excluded.is_empty() {
+            engine_connections
+        } else {
+            filtered = engine_connections
+                .iter()
+                .filter(|conn| !excluded.contains(&conn.id))
+                .cloned()
+                .collect();
+            &filtered
+        };
+
+        if candidates.is_empty() {
             return None;
         }
 
         let selected = match self.strategy {
-            LoadBalancingStrategy::RoundRobin => self.select_round_robin(engine_type, engine_connections),
-            LoadBalancingStrategy::LeastConnections => self.select_least_connections(engine_connections),
-            LoadBalancingStrategy::Random => self.select_random(engine_connections),
-            LoadBalancingStrategy::Weighted => self.select_weighted(engine_connections),
+            LoadBalancingStrategy::RoundRobin => self.select_round_robin(engine_type, candidates),
+            LoadBalancingStrategy::LeastConnections => self.select_least_connections(candidates),
+            LoadBalancingStrategy::Random => self.select_random(candidates),
+            LoadBalancingStrategy::Weighted => self.select_weighted(candidates),
+            LoadBalancingStrategy::LatencyAware => self.select_latency_aware(candidates),
         };
 
         selected
@@ -91,6 +206,7 @@ impl LoadBalancer {
     fn select_round_robin(&self, engine_type: EngineType, connections: &[ConnectionInfo]) -> Option<ConnectionInfo> {
         let mut index = self.round_robin_index.write();
         let current_index = index.entry(engine_type).or_insert(0);
+        *current_index %= connections.len();
         let selected = connections.get(*current_index).cloned();
 
         if let Some(_) = selected {
@@ -145,6 +261,72 @@ impl LoadBalancer {
         connections.last().cloned()
     }
 
+    /// 延迟感知选择：随机取两个候选，比较延迟得分
+    fn select_latency_aware(&self, connections: &[ConnectionInfo]) -> Option<ConnectionInfo> {
+        if connections.len() == 1 {
+            return connections.first().cloned();
+        }
+        let n = connections.len();
+        let first = (self.next_random() % n as u64) as usize;
+        let second = (first + 1 + (self.next_random() % (n as u64 - 1)) as usize) % n;
+
+        let latency = self.latency.read();
+        let score = |conn: &ConnectionInfo| {
+            latency
+                .get(&conn.id)
+                .map_or(0.0, |stats| stats.score(conn.active_connections))
+        };
+        // 没有样本的连接得分为 0，会先被探测
+        let (a, b) = (&connections[first], &connections[second]);
+        Some(if score(b) < score(a) { b.clone() } else { a.clone() })
+    }
+
+    fn next_random(&self) -> u64 {
+        // xorshift64，竞争时丢失一次更新无关紧要
+        let mut x = self.rng.load(Ordering::Relaxed);
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        self.rng.store(x, Ordering::Relaxed);
+        x
+    }
+
+    /// 记录一次请求的延迟与结果，作为延迟感知策略的反馈
+    pub fn record_latency(&self, connection_id: &str, latency: Duration, success: bool) {
+        let mut stats = self.latency.write();
+        stats
+            .entry(connection_id.to_string())
+            .or_default()
+            .record(latency.as_secs_f64() * 1000.0, success);
+    }
+
+    /// 记录一次被取消的请求 (对冲读中落败的一方)，`waited` 为取消前已等待的时长
+    pub fn record_cancelled(&self, connection_id: &str, waited: Duration) {
+        let mut stats = self.latency.write();
+        stats
+            .entry(connection_id.to_string())
+            .or_default()
+            .record_cancelled(waited.as_secs_f64() * 1000.0);
+    }
+
+    /// 连接的延迟统计
+    pub fn latency_stats(&self, connection_id: &str) -> Option<LatencyStats> {
+        self.latency.read().get(connection_id).cloned()
+    }
+
+    /// 某类引擎所有连接最近延迟的分位数
+    pub fn latency_percentile(&self, engine_type: EngineType, quantile: f64) -> Option<Duration> {
+        let connections = self.connections.read();
+        let latency = self.latency.read();
+        let samples: Vec<f64> = connections
+            .get(&engine_type)?
+            .iter()
+            .filter_map(|conn| latency.get(&conn.id))
+            .flat_map(|stats| stats.window.iter().copied())
+            .collect();
+        percentile_of(samples, quantile).map(|ms| Duration::from_secs_f64(ms / 1000.0))
+    }
+
     /// 更新连接统计信息
     pub fn update_connection_stats(&self, engine_type: EngineType, connection_id: &str, active_connections: u32) {
         let mut connections = self.connections.write();
@@ -170,4 +352,56 @@ impl Default for LoadBalancer {
     fn default() -> Self {
         Self::new()
     }
-}
\ No newline at end of file
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn connection(id: &str) -> ConnectionInfo {
+        ConnectionInfo {
+            id: id.to_string(),
+            engine_type: EngineType::TiKV,
+            active_connections: 0,
+            total_connections: 1,
+            last_used: Instant::now(),
+            weight: 1.0,
+        }
+    }
+
+    #[test]
+    fn test_latency_aware_avoids_slow_store() {
+        let lb = LoadBalancer::with_strategy(LoadBalancingStrategy::LatencyAware);
+        for id in ["store-1", "store-2", "store-3"] {
+            lb.add_connection(EngineType::TiKV, connection(id));
+        }
+        for _ in 0..20 {
+            lb.record_latency("store-1", Duration::from_millis(2), true);
+            lb.record_latency("store-2", Duration::from_millis(80), true);
+            lb.record_latency("store-3", Duration::from_millis(3), true);
+        }
+
+        let picks: Vec<String> = (0..200)
+            .map(|_| lb.select_connection(EngineType::TiKV).unwrap().id)
+            .collect();
+        // 两两比较时慢节点总是输，永远不会被选中
+        assert!(picks.iter().all(|id| id != "store-2"));
+        assert!(picks.iter().any(|id| id == "store-1"));
+
+        let p95 = lb.latency_percentile(EngineType::TiKV, 0.95).unwrap();
+        assert_eq!(p95, Duration::from_millis(80));
+    }
+
+    #[test]
+    fn test_selection_honours_exclusions() {
+        let lb = LoadBalancer::new();
+        lb.add_connection(EngineType::TiKV, connection("a"));
+        lb.add_connection(EngineType::TiKV, connection("b"));
+
+        for _ in 0..4 {
+            let selected = lb.select_connection_excluding(EngineType::TiKV, &["a".to_string()]).unwrap();
+            assert_eq!(selected.id, "b");
+        }
+        assert!(lb.select_connection_excluding(EngineType::TiKV, &["a".to_string(), "b".to_string()]).is_none());
+    }
+}
@@ -3,7 +3,9 @@
 //! 提供高级存储操作接口，包括连接池、重试机制、负载均衡等
 
 
+use async_trait::async_trait;
 use common::Result;
+use parking_lot::{Mutex, RwLock};
 use std::collections::HashMap;
 use std::sync::Arc;
 
@@ -15,10 +17,14 @@ use crate::engine::{StorageEngine, StorageEngineFactory, StorageTransaction};
 pub mod connection_pool;
 pub mod retry;
 pub mod load_balancer;
+pub mod batcher;
+pub mod hedge;
 
+pub use hedge::{HedgePolicy, HedgeStats, HedgedReader};
+pub use batcher::{BatchConfig, BatchExecutor, BatcherStats, RegionMap, RequestBatcher};
 pub use connection_pool::ConnectionPool;
 pub use retry::RetryPolicy;
-pub use load_balancer::LoadBalancer;
+pub use load_balancer::{ConnectionInfo, LoadBalancer, LoadBalancingStrategy};
 
 /// 存储客户端
 pub struct StorageClient {
@@ -28,6 +34,13 @@ pub struct StorageClient {
     load_balancer: Arc<LoadBalancer>,
     default_context: StorageContext,
     default_options: StorageOptions,
+    /// 点请求合并配置，默认关闭
+    batch_config: BatchConfig,
+    regions: Arc<RwLock<RegionMap>>,
+    batchers: Mutex<HashMap<EngineType, Arc<RequestBatcher>>>,
+    hedged_reader: Arc<HedgedReader>,
+    /// 连接 ID -> 该副本的引擎实例，从副本读按负载均衡器选中的连接寻址
+    replicas: RwLock<HashMap<String, Arc<dyn StorageEngine>>>,
 }
 
 impl StorageClient {
@@ -52,11 +65,93 @@ impl StorageClient {
             load_balancer,
             default_context,
             default_options,
+            batch_config: BatchConfig::default(),
+            regions: Arc::new(RwLock::new(RegionMap::default())),
+            batchers: Mutex::new(HashMap::new()),
+            hedged_reader: Arc::new(HedgedReader::default()),
+            replicas: RwLock::new(HashMap::new()),
         })
     }
 
+    /// 替换负载均衡器，例如切换为延迟感知策略
+    pub fn set_load_balancer(&mut self, load_balancer: LoadBalancer) {
+        self.load_balancer = Arc::new(load_balancer);
+    }
+
+    pub fn load_balancer(&self) -> &Arc<LoadBalancer> {
+        &self.load_balancer
+    }
+
+    /// 登记一个副本：连接加入负载均衡器，从副本读选中该连接时由 `engine` 处理
+    ///
+    /// 替换负载均衡器后需要重新登记。
+    pub fn add_replica(&self, connection: ConnectionInfo, engine: Arc<dyn StorageEngine>) {
+        self.replicas.write().insert(connection.id.clone(), engine);
+        self.load_balancer.add_connection(connection.engine_type, connection);
+    }
+
+    /// 副本连接对应的引擎；直接登记在负载均衡器上、没有单独引擎的连接使用工厂中的引擎
+    async fn replica_engine(&self, replica: &ConnectionInfo) -> Result<Arc<dyn StorageEngine>> {
+        if let Some(engine) = self.replicas.read().get(&replica.id) {
+            return Ok(engine.clone());
+        }
+        self.get_engine(replica.engine_type).await
+    }
+
+    /// 设置从副本读的对冲策略
+    pub fn set_hedge_policy(&mut self, policy: HedgePolicy) {
+        self.hedged_reader = Arc::new(HedgedReader::new(policy));
+    }
+
+    pub fn hedge_stats(&self) -> HedgeStats {
+        self.hedged_reader.stats()
+    }
+
+    /// 启用点请求合并
+    ///
+    /// 只有使用默认上下文和选项的 `get`/`put`/`batch_get` 会进入合并层，
+    /// 显式传入上下文的请求仍然逐个发送。
+    pub fn enable_batching(&mut self, config: BatchConfig) {
+        self.batch_config = BatchConfig { enabled: true, ..config };
+        self.batchers.lock().clear();
+    }
+
+    /// 设置区域分裂键，合并与批量读取按区域分组
+    pub fn set_region_splits(&self, split_keys: Vec<Key>) {
+        *self.regions.write() = RegionMap::new(split_keys);
+    }
+
+    /// 合并层统计，未启用合并时返回 None
+    pub fn batcher_stats(&self, engine_type: EngineType) -> Option<BatcherStats> {
+        self.batchers.lock().get(&engine_type).map(|batcher| batcher.stats())
+    }
+
+    /// 引擎对应的合并器，未启用合并或请求带有自定义参数时返回 None
+    fn batcher(
+        &self,
+        engine_type: EngineType,
+        context: &Option<StorageContext>,
+        options: &Option<StorageOptions>,
+    ) -> Option<Arc<RequestBatcher>> {
+        if !self.batch_config.enabled || context.is_some() || options.is_some() {
+            return None;
+        }
+        let mut batchers = self.batchers.lock();
+        let batcher = batchers.entry(engine_type).or_insert_with(|| {
+            let executor = Arc::new(EngineBatchExecutor {
+                factory: self.factory.clone(),
+                retry_policy: self.retry_policy.clone(),
+                engine_type,
+                context: self.default_context.clone(),
+                options: self.default_options.clone(),
+            });
+            Arc::new(RequestBatcher::new(self.batch_config.clone(), self.regions.clone(), executor))
+        });
+        Some(batcher.clone())
+    }
+
     /// 获取存储引擎
-    async fn get_engine(&self, engine_type: EngineType) -> Result<Box<dyn StorageEngine>> {
+    async fn get_engine(&self, engine_type: EngineType) -> Result<Arc<dyn StorageEngine>> {
         self.factory.get_engine(engine_type).await
     }
 
@@ -95,9 +190,31 @@ impl StorageClient {
         context: Option<StorageContext>,
         options: Option<StorageOptions>,
     ) -> Result<StorageResult<Option<Value>>> {
+        if let Some(batcher) = self.batcher(engine_type, &context, &options) {
+            let start_time = std::time::Instant::now();
+            let value = batcher.get(key.clone()).await.map_err(|e| common::Error::Storage(e.to_string()))?;
+            return Ok(StorageResult::new(value, start_time.elapsed().as_millis() as u64, engine_type));
+        }
+
         let context = context.unwrap_or_else(|| self.default_context.clone());
         let options = options.unwrap_or_else(|| self.default_options.clone());
 
+        // 允许读从副本且负载均衡器登记了副本连接时走对冲读，失败时避开出错的节点重试
+        if options.consistency_level != ConsistencyLevel::Strong
+            && !self.load_balancer.get_connection_stats(engine_type).is_empty()
+        {
+            return self.retry_policy
+                .execute_hedged_with_failover(&self.load_balancer, engine_type, &self.hedged_reader, |replica| {
+                    let (context, options) = (&context, &options);
+                    async move {
+                        let engine = self.replica_engine(&replica).await?;
+                        engine.get(key, context, options).await
+                    }
+                })
+                .await
+                .map_err(|e| common::Error::Storage(e.to_string()));
+        }
+
         self.execute_with_retry(|| async {
             let engine = self.get_engine(engine_type).await.map_err(|e| StorageError::Engine(e.to_string()))?;
             engine.get(key, &context, &options).await.map_err(|e| StorageError::Engine(e.to_string()))
@@ -113,6 +230,12 @@ impl StorageClient {
         context: Option<StorageContext>,
         options: Option<StorageOptions>,
     ) -> Result<StorageResult<()>> {
+        if let Some(batcher) = self.batcher(engine_type, &context, &options) {
+            let start_time = std::time::Instant::now();
+            batcher.put(key.clone(), value.clone()).await.map_err(|e| common::Error::Storage(e.to_string()))?;
+            return Ok(StorageResult::new((), start_time.elapsed().as_millis() as u64, engine_type));
+        }
+
         let context = context.unwrap_or_else(|| self.default_context.clone());
         let options = options.unwrap_or_else(|| self.default_options.clone());
 
@@ -166,6 +289,12 @@ impl StorageClient {
         context: Option<StorageContext>,
         options: Option<StorageOptions>,
     ) -> Result<StorageResult<HashMap<Key, Option<Value>>>> {
+        if let Some(batcher) = self.batcher(engine_type, &context, &options) {
+            let start_time = std::time::Instant::now();
+            let values = batcher.batch_get(keys).await.map_err(|e| common::Error::Storage(e.to_string()))?;
+            return Ok(StorageResult::new(values, start_time.elapsed().as_millis() as u64, engine_type));
+        }
+
         let context = context.unwrap_or_else(|| self.default_context.clone());
         let options = options.unwrap_or_else(|| self.default_options.clone());
 
@@ -262,4 +391,102 @@ impl StorageClient {
     pub async fn shutdown(&self) -> Result<()> {
         self.factory.shutdown_all().await
     }
-}
\ No newline at end of file
+}
+
+/// 合并层通过存储引擎执行批量请求，失败时按客户端的重试策略重试
+struct EngineBatchExecutor {
+    factory: Arc<StorageEngineFactory>,
+    retry_policy: Arc<RetryPolicy>,
+    engine_type: EngineType,
+    context: StorageContext,
+    options: StorageOptions,
+}
+
+impl EngineBatchExecutor {
+    async fn with_retry<T, F, Fut>(&self, operation: F) -> std::result::Result<T, StorageError>
+    where
+        F: Fn() -> Fut + Send + Sync,
+        Fut: std::future::Future<Output = std::result::Result<T, StorageError>> + Send,
+    {
+        let mut attempt = 0;
+        loop {
+            match operation().await {
+                Ok(result) => return Ok(result),
+                Err(e) if attempt + 1 < self.retry_policy.max_retries => {
+                    self.retry_policy.log_retry(attempt, &e.to_string());
+                    tokio::time::sleep(self.retry_policy.calculate_delay(attempt)).await;
+                    attempt += 1;
+                }
+                Err(e) => return Err(e),
+            }
+        }
+    }
+}
+
+#[async_trait]
+impl BatchExecutor for EngineBatchExecutor {
+    async fn batch_get(&self, keys: Vec<Key>) -> std::result::Result<HashMap<Key, Option<Value>>, StorageError> {
+        self.with_retry(|| async {
+            let engine = self.factory.get_engine(self.engine_type).await?;
+            Ok(engine.batch_get(&keys, &self.context, &self.options).await?.value)
+        }).await
+    }
+
+    async fn batch_put(&self, pairs: Vec<KeyValue>) -> std::result::Result<(), StorageError> {
+        self.with_retry(|| async {
+            let engine = self.factory.get_engine(self.engine_type).await?;
+            engine.batch_put(&pairs, &self.context, &self.options).await.map(|_| ())
+        }).await
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::engine::memory::MemoryEngine;
+    use bytes::Bytes;
+    use std::time::Instant;
+
+    async fn replica(value: &'static str) -> Arc<dyn StorageEngine> {
+        let mut engine = MemoryEngine::new();
+        engine.initialize(&StorageConfig::default()).await.unwrap();
+        engine
+            .put(&Bytes::from_static(b"k"), &Bytes::from_static(value.as_bytes()),
+                 &StorageContext::default(), &StorageOptions::default())
+            .await
+            .unwrap();
+        Arc::new(engine)
+    }
+
+    #[tokio::test]
+    async fn test_follower_reads_reach_the_selected_replica() {
+        let config = StorageConfig { engine_type: EngineType::Memory, ..StorageConfig::default() };
+        let mut client = StorageClient::new(config).await.unwrap();
+        client.set_load_balancer(LoadBalancer::with_strategy(LoadBalancingStrategy::RoundRobin));
+        for (id, value) in [("r1", "from-r1"), ("r2", "from-r2")] {
+            client.add_replica(ConnectionInfo {
+                id: id.to_string(),
+                engine_type: EngineType::Memory,
+                active_connections: 0,
+                total_connections: 1,
+                last_used: Instant::now(),
+                weight: 1.0,
+            }, replica(value).await);
+        }
+
+        let options = StorageOptions { consistency_level: ConsistencyLevel::Eventual, ..StorageOptions::default() };
+        let mut values = Vec::new();
+        for _ in 0..2 {
+            let result = client.get(&Bytes::from_static(b"k"), EngineType::Memory, None, Some(options.clone())).await.unwrap();
+            values.push(result.value.unwrap());
+        }
+        values.sort();
+        assert_eq!(values, vec![Bytes::from_static(b"from-r1"), Bytes::from_static(b"from-r2")]);
+
+        // 每个副本的结果只记一次
+        for id in ["r1", "r2"] {
+            let stats = client.load_balancer().latency_stats(id).unwrap();
+            assert_eq!((stats.samples, stats.successes), (1, 1));
+        }
+    }
+}
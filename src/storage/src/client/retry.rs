@@ -2,9 +2,14 @@
 //!
 //! 提供可配置的重试机制
 
-use std::time::Duration;
+use std::future::Future;
+use std::time::{Duration, Instant};
 use tracing::warn;
 
+use crate::client::hedge::HedgedReader;
+use crate::client::load_balancer::{ConnectionInfo, LoadBalancer};
+use crate::common::{EngineType, StorageError};
+
 /// 重试策略
 pub struct RetryPolicy {
     pub max_retries: u32,
@@ -60,8 +65,165 @@ impl RetryPolicy {
     }
 }
 
+impl RetryPolicy {
+    /// 带故障转移的重试：每次重试通过负载均衡器重新选择连接，避开已经失败的节点，
+    /// 每次尝试的延迟与结果都反馈给负载均衡器
+    pub async fn execute_with_failover<T, F, Fut>(
+        &self,
+        load_balancer: &LoadBalancer,
+        engine_type: EngineType,
+        operation: F,
+    ) -> Result<T, StorageError>
+    where
+        F: Fn(ConnectionInfo) -> Fut,
+        Fut: Future<Output = Result<T, StorageError>>,
+    {
+        self.failover(load_balancer, engine_type, true, operation).await
+    }
+
+    /// 带故障转移的对冲读：每次尝试以选中的连接为主副本发起对冲读
+    ///
+    /// 延迟与结果由对冲读按实际发出请求的副本反馈，这里不再重复记录，
+    /// 否则主副本的延迟会记两次，对冲副本胜出时也会被记到主副本头上。
+    pub async fn execute_hedged_with_failover<T, F, Fut>(
+        &self,
+        load_balancer: &LoadBalancer,
+        engine_type: EngineType,
+        hedged_reader: &HedgedReader,
+        operation: F,
+    ) -> Result<T, StorageError>
+    where
+        F: Fn(ConnectionInfo) -> Fut,
+        Fut: Future<Output = Result<T, StorageError>>,
+    {
+        self.failover(load_balancer, engine_type, false, |primary| {
+            hedged_reader.read_from(load_balancer, engine_type, primary, &operation)
+        })
+        .await
+    }
+
+    async fn failover<T, F, Fut>(
+        &self,
+        load_balancer: &LoadBalancer,
+        engine_type: EngineType,
+        record: bool,
+        operation: F,
+    ) -> Result<T, StorageError>
+    where
+        F: Fn(ConnectionInfo) -> Fut,
+        Fut: Future<Output = Result<T, StorageError>>,
+    {
+        let mut failed: Vec<String> = Vec::new();
+        let mut last_error = None;
+
+        for attempt in 0..self.max_retries.max(1) {
+            // 所有节点都失败过时不再排除，从头再试
+            let connection = load_balancer
+                .select_connection_excluding(engine_type, &failed)
+                .or_else(|| load_balancer.select_connection(engine_type))
+                .ok_or_else(|| StorageError::Connection(format!("no connection available for {:?}", engine_type)))?;
+            let connection_id = connection.id.clone();
+
+            let started = Instant::now();
+            let result = operation(connection).await;
+            if record {
+                load_balancer.record_latency(&connection_id, started.elapsed(), result.is_ok());
+            }
+            match result {
+                Ok(result) => return Ok(result),
+                Err(e) => {
+                    self.log_retry(attempt, &e.to_string());
+                    failed.push(connection_id);
+                    last_error = Some(e);
+                    if attempt + 1 < self.max_retries {
+                        tokio::time::sleep(self.calculate_delay(attempt)).await;
+                    }
+                }
+            }
+        }
+
+        Err(last_error.unwrap_or_else(|| StorageError::Internal("Max retries exceeded".to_string())))
+    }
+}
+
 impl Default for RetryPolicy {
     fn default() -> Self {
         Self::new(3, 100)
     }
-}
\ No newline at end of file
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::client::load_balancer::LoadBalancingStrategy;
+    use parking_lot::Mutex;
+
+    #[tokio::test]
+    async fn test_failover_avoids_failed_node() {
+        let lb = LoadBalancer::with_strategy(LoadBalancingStrategy::RoundRobin);
+        for id in ["a", "b"] {
+            lb.add_connection(EngineType::TiKV, ConnectionInfo {
+                id: id.to_string(),
+                engine_type: EngineType::TiKV,
+                active_connections: 0,
+                total_connections: 1,
+                last_used: Instant::now(),
+                weight: 1.0,
+            });
+        }
+        let policy = RetryPolicy::new(3, 1);
+        let attempts = Mutex::new(Vec::new());
+
+        let result = policy
+            .execute_with_failover(&lb, EngineType::TiKV, |conn| {
+                attempts.lock().push(conn.id.clone());
+                async move {
+                    if conn.id == "a" {
+                        Err(StorageError::Timeout("store a is slow".to_string()))
+                    } else {
+                        Ok(conn.id)
+                    }
+                }
+            })
+            .await
+            .unwrap();
+
+        assert_eq!(result, "b");
+        assert_eq!(*attempts.lock(), vec!["a".to_string(), "b".to_string()]);
+        assert_eq!(lb.latency_stats("a").unwrap().failures, 1);
+    }
+
+    #[tokio::test]
+    async fn test_hedged_failover_records_each_attempt_once() {
+        let lb = LoadBalancer::with_strategy(LoadBalancingStrategy::RoundRobin);
+        for id in ["a", "b"] {
+            lb.add_connection(EngineType::TiKV, ConnectionInfo {
+                id: id.to_string(),
+                engine_type: EngineType::TiKV,
+                active_connections: 0,
+                total_connections: 1,
+                last_used: Instant::now(),
+                weight: 1.0,
+            });
+        }
+        let policy = RetryPolicy::new(3, 1);
+        let reader = HedgedReader::default();
+
+        let result = policy
+            .execute_hedged_with_failover(&lb, EngineType::TiKV, &reader, |conn| async move {
+                if conn.id == "a" {
+                    Err(StorageError::Timeout("store a is slow".to_string()))
+                } else {
+                    Ok(conn.id)
+                }
+            })
+            .await
+            .unwrap();
+
+        assert_eq!(result, "b");
+        let a = lb.latency_stats("a").unwrap();
+        assert_eq!((a.samples, a.failures), (1, 1));
+        let b = lb.latency_stats("b").unwrap();
+        assert_eq!((b.samples, b.successes), (1, 1));
+    }
+}
@@ -0,0 +1,345 @@
+//! memcomparable 键编码
+//!
+//! 每个值以类型标志开头，整数翻转符号位后按大端写出，浮点数按 IEEE 754 位模式
+//! 变换为可比较的无符号整数 (-0.0 先归一为 0.0、NaN 归一为同一个位模式，相等的值
+//! 编码相同)，字节串按 8 字节分组并在每组后追加填充标记。
+//! 编码无前缀歧义，因此复合键逐列拼接后整体仍按字节序有序。
+//!
+//! 表数据键布局：
+//! - 行：`t{表名}_r{主键列...}`
+//! - 索引：`t{表名}_i{索引名}{索引列...}{主键列...}`
+//! - 位图索引：`t{表名}_b{索引名}{列值}{块号}`，值为该取值落在块内的行号集合；
+//!   块号是行号的高 16 位，一块对应 Roaring 位图的一个容器
+//! - 行号：`t{表名}_k{主键列...}` 存行号，`t{表名}_h{行号}` 反查行键，
+//!   `t{表名}_s{块号}` 是全部存活行号 (同样分块)，`t{表名}_n` 是下一个待分配的行号
+//! - 区间摘要：`t{表名}_z{区间起始主键列...}`，值为该区间的 min/max/NULL 计数摘要
+
+use super::{take_bytes, Datum};
+use crate::common::{Key, StorageError};
+
+const NULL_FLAG: u8 = 0x00;
+const BYTES_FLAG: u8 = 0x01;
+const BOOL_FLAG: u8 = 0x02;
+const INT_FLAG: u8 = 0x03;
+const FLOAT_FLAG: u8 = 0x05;
+
+const GROUP_SIZE: usize = 8;
+const GROUP_MARKER: u8 = 0xFF;
+
+const TABLE_PREFIX: u8 = b't';
+const RECORD_SEP: &[u8] = b"_r";
+const INDEX_SEP: &[u8] = b"_i";
+const BITMAP_SEP: &[u8] = b"_b";
+const ROW_ID_SEP: &[u8] = b"_k";
+const ROW_HANDLE_SEP: &[u8] = b"_h";
+const ROW_SET_SEP: &[u8] = b"_s";
+const ROW_ID_COUNTER_SEP: &[u8] = b"_n";
+const ZONE_MAP_SEP: &[u8] = b"_z";
+
+/// 追加一个值的 memcomparable 编码
+pub fn encode_key_datum(out: &mut Vec<u8>, datum: &Datum) {
+    match datum {
+        Datum::Null => out.push(NULL_FLAG),
+        Datum::Bool(v) => {
+            out.push(BOOL_FLAG);
+            out.push(*v as u8);
+        }
+        Datum::Int(v) => {
+            out.push(INT_FLAG);
+            out.extend_from_slice(&((*v as u64) ^ (1 << 63)).to_be_bytes());
+        }
+        Datum::Float(v) => {
+            out.push(FLOAT_FLAG);
+            let bits = normalize_float(*v).to_bits();
+            // 正数翻转符号位，负数按位取反，使位模式按数值升序排列
+            let ordered = if bits >> 63 == 0 { bits | (1 << 63) } else { !bits };
+            out.extend_from_slice(&ordered.to_be_bytes());
+        }
+        Datum::Bytes(bytes) => {
+            out.push(BYTES_FLAG);
+            encode_bytes(out, bytes);
+        }
+    }
+}
+
+/// 键中的浮点数：-0.0 与 0.0 相等，所有 NaN 视为同一个值
+fn normalize_float(value: f64) -> f64 {
+    if value == 0.0 {
+        0.0
+    } else if value.is_nan() {
+        f64::NAN
+    } else {
+        value
+    }
+}
+
+/// 依次编码多个值
+pub fn encode_key_datums(datums: &[Datum]) -> Key {
+    let mut out = Vec::with_capacity(datums.len() * 9);
+    for datum in datums {
+        encode_key_datum(&mut out, datum);
+    }
+    out.into()
+}
+
+/// 解码 `encode_key_datums` 的输出
+pub fn decode_key_datums(mut key: &[u8]) -> Result<Vec<Datum>, StorageError> {
+    let mut datums = Vec::new();
+    while !key.is_empty() {
+        let (datum, consumed) = decode_key_datum(key)?;
+        datums.push(datum);
+        key = &key[consumed..];
+    }
+    Ok(datums)
+}
+
+/// 表的行键前缀
+pub fn record_prefix(table: &str) -> Key {
+    record_prefix_vec(table).into()
+}
+
+fn record_prefix_vec(table: &str) -> Vec<u8> {
+    let mut out = table_prefix(table);
+    out.extend_from_slice(RECORD_SEP);
+    out
+}
+
+/// 行键：表前缀后接主键列
+pub fn record_key(table: &str, primary_key: &[Datum]) -> Key {
+    let mut out = record_prefix_vec(table);
+    for datum in primary_key {
+        encode_key_datum(&mut out, datum);
+    }
+    out.into()
+}
+
+/// 索引键前缀
+pub fn index_prefix(table: &str, index: &str) -> Key {
+    index_prefix_vec(table, index).into()
+}
+
+fn index_prefix_vec(table: &str, index: &str) -> Vec<u8> {
+    let mut out = table_prefix(table);
+    out.extend_from_slice(INDEX_SEP);
+    encode_bytes(&mut out, index.as_bytes());
+    out
+}
+
+/// 索引键：索引列之后追加主键列，非唯一索引也能保证键唯一
+pub fn index_key(table: &str, index: &str, values: &[Datum], primary_key: &[Datum]) -> Key {
+    let mut out = index_prefix_vec(table, index);
+    for datum in values.iter().chain(primary_key) {
+        encode_key_datum(&mut out, datum);
+    }
+    out.into()
+}
+
+/// 位图索引键：一个索引取值一个键，是该取值各个块键的公共前缀
+pub fn bitmap_index_key(table: &str, index: &str, value: &[u8]) -> Key {
+    let mut out = table_prefix(table);
+    out.extend_from_slice(BITMAP_SEP);
+    encode_bytes(&mut out, index.as_bytes());
+    encode_bytes(&mut out, value);
+    out.into()
+}
+
+/// 行键到行号的映射键；`record_key` 必须是该表的行键
+pub fn row_id_key(table: &str, record_key: &[u8]) -> Key {
+    let prefix_len = record_prefix_vec(table).len();
+    let mut out = table_prefix(table);
+    out.extend_from_slice(ROW_ID_SEP);
+    out.extend_from_slice(&record_key[prefix_len.min(record_key.len())..]);
+    out.into()
+}
+
+/// 行号到行键的反查键
+pub fn row_handle_key(table: &str, row_id: u32) -> Key {
+    let mut out = table_prefix(table);
+    out.extend_from_slice(ROW_HANDLE_SEP);
+    out.extend_from_slice(&row_id.to_be_bytes());
+    out.into()
+}
+
+/// 表的存活行号集合键，是各个块键的公共前缀
+pub fn row_set_key(table: &str) -> Key {
+    let mut out = table_prefix(table);
+    out.extend_from_slice(ROW_SET_SEP);
+    out.into()
+}
+
+/// 分块位图的块键：位图键后接大端块号，同一位图的块按行号有序
+pub fn bitmap_chunk_key(bitmap_key: &[u8], chunk: u16) -> Key {
+    let mut out = bitmap_key.to_vec();
+    out.extend_from_slice(&chunk.to_be_bytes());
+    out.into()
+}
+
+/// 表的行号分配计数器键
+pub fn row_id_counter_key(table: &str) -> Key {
+    let mut out = table_prefix(table);
+    out.extend_from_slice(ROW_ID_COUNTER_SEP);
+    out.into()
+}
+
+/// 表的区间摘要键前缀
+pub fn zone_map_prefix(table: &str) -> Key {
+    let mut out = table_prefix(table);
+    out.extend_from_slice(ZONE_MAP_SEP);
+    out.into()
+}
+
+/// 区间摘要键；`zone_start` 是区间起始行键去掉行键前缀后的部分
+pub fn zone_map_key(table: &str, zone_start: &[u8]) -> Key {
+    let mut out = table_prefix(table);
+    out.extend_from_slice(ZONE_MAP_SEP);
+    out.extend_from_slice(zone_start);
+    out.into()
+}
+
+/// 以 `prefix` 开头的所有键的上界 (不含)
+pub fn prefix_end(prefix: &[u8]) -> Key {
+    let mut end = prefix.to_vec();
+    while let Some(last) = end.pop() {
+        if last < 0xFF {
+            end.push(last + 1);
+            return end.into();
+        }
+    }
+    // 全 0xFF 前缀没有有限的后继，本模块产生的前缀不会出现这种情况
+    vec![0xFF; prefix.len() + 1].into()
+}
+
+fn table_prefix(table: &str) -> Vec<u8> {
+    let mut out = Vec::with_capacity(table.len() + 12);
+    out.push(TABLE_PREFIX);
+    encode_bytes(&mut out, table.as_bytes());
+    out
+}
+
+/// 字节串分组编码：每 8 字节一组，不足补 0，组后标记 `0xFF - 填充数`
+fn encode_bytes(out: &mut Vec<u8>, bytes: &[u8]) {
+    out.reserve((bytes.len() / GROUP_SIZE + 1) * (GROUP_SIZE + 1));
+    let mut chunks = bytes.chunks_exact(GROUP_SIZE);
+    for chunk in &mut chunks {
+        out.extend_from_slice(chunk);
+        out.push(GROUP_MARKER);
+    }
+    let remainder = chunks.remainder();
+    let pad = GROUP_SIZE - remainder.len();
+    out.extend_from_slice(remainder);
+    out.extend(std::iter::repeat(0).take(pad));
+    out.push(GROUP_MARKER - pad as u8);
+}
+
+fn decode_bytes(key: &[u8], pos: &mut usize) -> Result<Vec<u8>, StorageError> {
+    let mut out = Vec::new();
+    loop {
+        let group = take_bytes(key, pos, GROUP_SIZE + 1, "memcomparable bytes")?;
+        let pad = (GROUP_MARKER - group[GROUP_SIZE]) as usize;
+        if pad > GROUP_SIZE {
+            return Err(StorageError::Deserialization("invalid memcomparable group marker".to_string()));
+        }
+        let real = GROUP_SIZE - pad;
+        if group[real..GROUP_SIZE].iter().any(|&b| b != 0) {
+            return Err(StorageError::Deserialization("invalid memcomparable padding".to_string()));
+        }
+        out.extend_from_slice(&group[..real]);
+        if pad != 0 {
+            return Ok(out);
+        }
+    }
+}
+
+fn decode_key_datum(key: &[u8]) -> Result<(Datum, usize), StorageError> {
+    let mut pos = 1;
+    let datum = match key[0] {
+        NULL_FLAG => Datum::Null,
+        BOOL_FLAG => Datum::Bool(take_bytes(key, &mut pos, 1, "memcomparable bool")?[0] != 0),
+        INT_FLAG => {
+            let raw = u64::from_be_bytes(take_bytes(key, &mut pos, 8, "memcomparable int")?.try_into().unwrap());
+            Datum::Int((raw ^ (1 << 63)) as i64)
+        }
+        FLOAT_FLAG => {
+            let raw = u64::from_be_bytes(take_bytes(key, &mut pos, 8, "memcomparable float")?.try_into().unwrap());
+            let bits = if raw >> 63 == 1 { raw & !(1 << 63) } else { !raw };
+            Datum::Float(f64::from_bits(bits))
+        }
+        BYTES_FLAG => Datum::Bytes(decode_bytes(key, &mut pos)?),
+        flag => return Err(StorageError::Deserialization(format!("unknown key flag {flag}"))),
+    };
+    Ok((datum, pos))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_key_order_matches_value_order() {
+        let ints = [i64::MIN, -1000, -1, 0, 1, 7, i64::MAX];
+        let encoded: Vec<Key> = ints.iter().map(|&v| encode_key_datums(&[Datum::Int(v)])).collect();
+        assert!(encoded.windows(2).all(|pair| pair[0] < pair[1]));
+
+        let floats = [f64::NEG_INFINITY, -2.5, -0.0, 0.5, 3.0, f64::INFINITY];
+        let encoded: Vec<Key> = floats.iter().map(|&v| encode_key_datums(&[Datum::Float(v)])).collect();
+        assert!(encoded.windows(2).all(|pair| pair[0] < pair[1]));
+
+        let strings: [&[u8]; 6] = [b"", b"a", b"a\0", b"ab", b"abcdefgh", b"abcdefghi"];
+        let encoded: Vec<Key> = strings.iter().map(|s| encode_key_datums(&[Datum::Bytes(s.to_vec())])).collect();
+        assert!(encoded.windows(2).all(|pair| pair[0] < pair[1]));
+    }
+
+    #[test]
+    fn test_equal_floats_encode_identically() {
+        let key = |v: f64| encode_key_datums(&[Datum::Float(v)]);
+        assert_eq!(key(-0.0), key(0.0));
+        assert_eq!(decode_key_datums(&key(-0.0)).unwrap(), vec![Datum::Float(0.0)]);
+        assert!(decode_key_datums(&key(-0.0)).unwrap()[0].as_f64().unwrap().is_sign_positive());
+        assert_eq!(key(f64::NAN), key(-f64::NAN));
+        assert_eq!(key(f64::from_bits(0x7FF0_0000_0000_0001)), key(f64::NAN));
+        assert!(key(-1e-300) < key(0.0) && key(0.0) < key(1e-300));
+    }
+
+    #[test]
+    fn test_composite_key_round_trip_and_order() {
+        let a = vec![Datum::Bytes(b"abc".to_vec()), Datum::Int(2)];
+        let b = vec![Datum::Bytes(b"abc".to_vec()), Datum::Int(10)];
+        let c = vec![Datum::Bytes(b"abcd".to_vec()), Datum::Int(-5)];
+        let (ka, kb, kc) = (encode_key_datums(&a), encode_key_datums(&b), encode_key_datums(&c));
+        assert!(ka < kb && kb < kc);
+
+        let mixed = vec![Datum::Null, Datum::Bool(true), Datum::Int(-3), Datum::Float(1.25), Datum::Bytes(b"12345678".to_vec())];
+        assert_eq!(decode_key_datums(&encode_key_datums(&mixed)).unwrap(), mixed);
+        assert!(decode_key_datums(&[INT_FLAG, 1, 2]).is_err());
+    }
+
+    #[test]
+    fn test_table_key_layout() {
+        let prefix = record_prefix("users");
+        let end = prefix_end(&prefix);
+        let row = record_key("users", &[Datum::Int(42)]);
+        assert!(row.starts_with(&prefix) && row < end);
+
+        // 表名是另一个表名的前缀时，两表的行键范围互不重叠
+        let other = record_key("users2", &[Datum::Int(1)]);
+        assert!(!(other >= prefix && other < end));
+
+        let index = index_key("users", "by_name", &[Datum::Bytes(b"bob".to_vec())], &[Datum::Int(42)]);
+        assert!(index.starts_with(&index_prefix("users", "by_name")));
+        assert!(!(index >= prefix && index < end));
+
+        // 位图索引与行号映射键都落在行键范围之外，表扫描不会读到它们
+        for key in [
+            bitmap_index_key("users", "by_status", b"active"),
+            row_id_key("users", &row),
+            row_handle_key("users", 7),
+            row_set_key("users"),
+            row_id_counter_key("users"),
+            zone_map_key("users", &row[prefix.len()..]),
+        ] {
+            assert!(!(key >= prefix && key < end));
+        }
+        assert_eq!(&row_id_key("users", &row)[..], &row_id_key("users", &record_key("users", &[Datum::Int(42)]))[..]);
+        assert_eq!(decode_key_datums(&row[prefix.len()..]).unwrap(), vec![Datum::Int(42)]);
+    }
+}
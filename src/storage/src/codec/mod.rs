@@ -0,0 +1,138 @@
+//! 键值编码
+//!
+//! - `key`：memcomparable 键编码，编码后的字节序与值的自然序一致，
+//!   复合主键和索引键上的范围扫描可以直接按字节比较
+//! - `row`：紧凑的版本化行格式，带列 ID、空值位图和定长槽位，可按列惰性解码
+
+use serde::{Deserialize, Serialize};
+use std::cmp::Ordering;
+
+use crate::common::StorageError;
+
+pub mod key;
+pub mod row;
+
+pub use key::{
+    bitmap_chunk_key, bitmap_index_key, decode_key_datums, encode_key_datums, index_key, index_prefix, prefix_end, record_key, record_prefix,
+    row_handle_key, row_id_counter_key, row_id_key, row_set_key, zone_map_key, zone_map_prefix,
+};
+pub use row::{decode_row, encode_row, encode_row_with_ids, slice_column, RowView, ROW_FORMAT_MAGIC, ROW_FORMAT_V2};
+
+/// 存储层的值
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub enum Datum {
+    Null,
+    Bool(bool),
+    Int(i64),
+    Float(f64),
+    Bytes(Vec<u8>),
+}
+
+impl Datum {
+    pub fn is_null(&self) -> bool {
+        matches!(self, Datum::Null)
+    }
+
+    /// 数值视图；文本按十进制解析，兼容旧的纯文本行
+    pub fn as_f64(&self) -> Option<f64> {
+        match self {
+            Datum::Int(v) => Some(*v as f64),
+            Datum::Float(v) => Some(*v),
+            Datum::Bool(v) => Some(*v as i64 as f64),
+            Datum::Bytes(bytes) => std::str::from_utf8(bytes).ok()?.trim().parse().ok(),
+            Datum::Null => None,
+        }
+    }
+
+    /// 三值逻辑下的真值，NULL 返回 None
+    pub fn truth(&self) -> Option<bool> {
+        match self {
+            Datum::Null => None,
+            Datum::Bool(v) => Some(*v),
+            Datum::Int(v) => Some(*v != 0),
+            Datum::Float(v) => Some(*v != 0.0),
+            Datum::Bytes(bytes) => Some(!bytes.is_empty()),
+        }
+    }
+
+    /// SQL 比较语义：任一侧为 NULL 或类型不可比时返回 None
+    pub fn sql_cmp(&self, other: &Datum) -> Option<Ordering> {
+        match (self, other) {
+            (Datum::Null, _) | (_, Datum::Null) => None,
+            (Datum::Int(a), Datum::Int(b)) => Some(a.cmp(b)),
+            (Datum::Bool(a), Datum::Bool(b)) => Some(a.cmp(b)),
+            (Datum::Bytes(a), Datum::Bytes(b)) => Some(a.cmp(b)),
+            (a, b) => a.as_f64()?.partial_cmp(&b.as_f64()?),
+        }
+    }
+
+    /// 以文本形式输出，供 SQL 层的字符串行使用
+    pub fn to_text(&self) -> String {
+        match self {
+            Datum::Null => "NULL".to_string(),
+            Datum::Bool(v) => v.to_string(),
+            Datum::Int(v) => v.to_string(),
+            Datum::Float(v) => v.to_string(),
+            Datum::Bytes(bytes) => String::from_utf8_lossy(bytes).into_owned(),
+        }
+    }
+}
+
+/// 借用行缓冲的值，字节串直接指向所在的缓冲
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum DatumRef<'a> {
+    Null,
+    Bool(bool),
+    Int(i64),
+    Float(f64),
+    Bytes(&'a [u8]),
+}
+
+impl<'a> DatumRef<'a> {
+    pub fn is_null(&self) -> bool {
+        matches!(self, DatumRef::Null)
+    }
+
+    /// 复制为独立持有的值
+    pub fn to_owned(self) -> Datum {
+        match self {
+            DatumRef::Null => Datum::Null,
+            DatumRef::Bool(v) => Datum::Bool(v),
+            DatumRef::Int(v) => Datum::Int(v),
+            DatumRef::Float(v) => Datum::Float(v),
+            DatumRef::Bytes(bytes) => Datum::Bytes(bytes.to_vec()),
+        }
+    }
+
+    /// 以文本形式输出，与 `Datum::to_text` 一致；字节串只在这里复制一次
+    pub fn to_text(&self) -> String {
+        match self {
+            DatumRef::Null => "NULL".to_string(),
+            DatumRef::Bool(v) => v.to_string(),
+            DatumRef::Int(v) => v.to_string(),
+            DatumRef::Float(v) => v.to_string(),
+            DatumRef::Bytes(bytes) => String::from_utf8_lossy(bytes).into_owned(),
+        }
+    }
+}
+
+impl<'a> From<&'a Datum> for DatumRef<'a> {
+    fn from(datum: &'a Datum) -> Self {
+        match datum {
+            Datum::Null => DatumRef::Null,
+            Datum::Bool(v) => DatumRef::Bool(*v),
+            Datum::Int(v) => DatumRef::Int(*v),
+            Datum::Float(v) => DatumRef::Float(*v),
+            Datum::Bytes(bytes) => DatumRef::Bytes(bytes),
+        }
+    }
+}
+
+/// 从 `value[*pos..]` 取 `n` 个字节，越界时报告截断
+pub(crate) fn take_bytes<'a>(value: &'a [u8], pos: &mut usize, n: usize, what: &str) -> Result<&'a [u8], StorageError> {
+    let bytes = value
+        .get(*pos..pos.saturating_add(n))
+        .ok_or_else(|| StorageError::Deserialization(format!("truncated {what}")))?;
+    *pos += n;
+    Ok(bytes)
+}
@@ -0,0 +1,378 @@
+//! 版本化行格式
+//!
+//! v2 格式 (`ROW_FORMAT_V2`)：
+//!
+//! ```text
+//! [版本][标志][列数 u16][列 ID...][空值位图][类型...][列结束偏移...][数据]
+//! ```
+//!
+//! 列 ID 升序排列，按二分查找定位；整数与浮点占 8 字节定长槽位，布尔占 1 字节，
+//! 空值不占数据空间。列 ID 都小于 256 且数据不超过 64KB 时列 ID 用 1 字节、
+//! 偏移用 2 字节，否则置 `FLAG_LARGE` 改用 4 字节。`RowView` 只解析头部，
+//! 按需解码被访问的列；`DatumRef` 形式的列值直接借用行缓冲，字节串列不复制，
+//! 需要脱离行缓冲持有时用 `slice_column` 取共享同一块内存的 `Bytes` 切片。
+//!
+//! 仍可读取旧的 `ROW_FORMAT_MAGIC` 行和不带格式首字节的纯文本值。
+
+use super::{take_bytes, Datum, DatumRef};
+use crate::common::{Bytes, StorageError};
+
+/// 旧行格式首字节。0xC0 在 UTF-8 中不可能出现，借此区分编码行与纯文本值
+pub const ROW_FORMAT_MAGIC: u8 = 0xC0;
+
+/// v2 行格式首字节，同样不会出现在 UTF-8 文本开头
+pub const ROW_FORMAT_V2: u8 = 0xC1;
+
+const FLAG_LARGE: u8 = 0x01;
+
+const TYPE_NULL: u8 = 0;
+const TYPE_BOOL: u8 = 1;
+const TYPE_INT: u8 = 2;
+const TYPE_FLOAT: u8 = 3;
+const TYPE_BYTES: u8 = 4;
+
+/// 编码一行，列 ID 依次为 0..n
+pub fn encode_row(row: &[Datum]) -> Vec<u8> {
+    let columns: Vec<(u32, &Datum)> = row.iter().enumerate().map(|(id, datum)| (id as u32, datum)).collect();
+    encode_columns(columns)
+}
+
+/// 按列 ID 编码一行，列顺序任意
+pub fn encode_row_with_ids(row: &[(u32, Datum)]) -> Vec<u8> {
+    let mut columns: Vec<(u32, &Datum)> = row.iter().map(|(id, datum)| (*id, datum)).collect();
+    columns.sort_unstable_by_key(|(id, _)| *id);
+    columns.dedup_by_key(|(id, _)| *id);
+    encode_columns(columns)
+}
+
+fn encode_columns(columns: Vec<(u32, &Datum)>) -> Vec<u8> {
+    let count = columns.len();
+    let mut data = Vec::new();
+    let mut types = Vec::with_capacity(count);
+    let mut offsets = Vec::with_capacity(count);
+    let mut nulls = vec![0u8; (count + 7) / 8];
+
+    for (i, (_, datum)) in columns.iter().enumerate() {
+        let tag = match datum {
+            Datum::Null => {
+                nulls[i / 8] |= 1 << (i % 8);
+                TYPE_NULL
+            }
+            Datum::Bool(v) => {
+                data.push(*v as u8);
+                TYPE_BOOL
+            }
+            Datum::Int(v) => {
+                data.extend_from_slice(&v.to_le_bytes());
+                TYPE_INT
+            }
+            Datum::Float(v) => {
+                data.extend_from_slice(&v.to_le_bytes());
+                TYPE_FLOAT
+            }
+            Datum::Bytes(bytes) => {
+                data.extend_from_slice(bytes);
+                TYPE_BYTES
+            }
+        };
+        types.push(tag);
+        offsets.push(data.len());
+    }
+
+    let large = columns.last().map_or(false, |(id, _)| *id > u8::MAX as u32) || data.len() > u16::MAX as usize;
+    let (id_width, offset_width) = if large { (4, 4) } else { (1, 2) };
+
+    let mut out = Vec::with_capacity(4 + count * (id_width + offset_width + 1) + nulls.len() + data.len());
+    out.push(ROW_FORMAT_V2);
+    out.push(if large { FLAG_LARGE } else { 0 });
+    out.extend_from_slice(&(count as u16).to_le_bytes());
+    for (id, _) in &columns {
+        if large {
+            out.extend_from_slice(&id.to_le_bytes());
+        } else {
+            out.push(*id as u8);
+        }
+    }
+    out.extend_from_slice(&nulls);
+    out.extend_from_slice(&types);
+    for offset in offsets {
+        if large {
+            out.extend_from_slice(&(offset as u32).to_le_bytes());
+        } else {
+            out.extend_from_slice(&(offset as u16).to_le_bytes());
+        }
+    }
+    out.extend_from_slice(&data);
+    out
+}
+
+/// 解码整行，按列 ID 升序输出；旧格式与纯文本值同样支持
+pub fn decode_row(value: &[u8]) -> Result<Vec<Datum>, StorageError> {
+    RowView::new(value)?.to_datums()
+}
+
+/// 取 v2 行中字节串列的共享切片，与 `value` 共用底层缓冲
+///
+/// 列为其他类型、为 NULL 或行中没有该列时返回 None；纯文本值作为第 0 列。
+pub fn slice_column(value: &Bytes, column_id: u32) -> Result<Option<Bytes>, StorageError> {
+    match RowView::new(value)?.get_ref(column_id)? {
+        DatumRef::Bytes(bytes) if !bytes.is_empty() => Ok(Some(value.slice_ref(bytes))),
+        DatumRef::Bytes(_) => Ok(Some(Bytes::new())),
+        _ => Ok(None),
+    }
+}
+
+/// 行的惰性视图：只解析头部，列值在访问时才解码
+pub struct RowView<'a> {
+    inner: RowInner<'a>,
+}
+
+enum RowInner<'a> {
+    Compact {
+        large: bool,
+        count: usize,
+        ids: &'a [u8],
+        nulls: &'a [u8],
+        types: &'a [u8],
+        offsets: &'a [u8],
+        data: &'a [u8],
+    },
+    /// 不带格式首字节的纯文本值，视为单个字节串列
+    Text(&'a [u8]),
+    /// 旧格式，列 ID 即列位置
+    Decoded(Vec<Datum>),
+}
+
+impl<'a> RowView<'a> {
+    pub fn new(value: &'a [u8]) -> Result<Self, StorageError> {
+        let inner = match value.first() {
+            Some(&ROW_FORMAT_V2) => {
+                let mut pos = 1;
+                let flags = take_bytes(value, &mut pos, 1, "row header")?[0];
+                let large = flags & FLAG_LARGE != 0;
+                let count = u16::from_le_bytes(take_bytes(value, &mut pos, 2, "row header")?.try_into().unwrap()) as usize;
+                let (id_width, offset_width) = if large { (4, 4) } else { (1, 2) };
+                let ids = take_bytes(value, &mut pos, count * id_width, "row column ids")?;
+                let nulls = take_bytes(value, &mut pos, (count + 7) / 8, "row null bitmap")?;
+                let types = take_bytes(value, &mut pos, count, "row column types")?;
+                let offsets = take_bytes(value, &mut pos, count * offset_width, "row offsets")?;
+                RowInner::Compact { large, count, ids, nulls, types, offsets, data: &value[pos..] }
+            }
+            Some(&ROW_FORMAT_MAGIC) => RowInner::Decoded(decode_legacy_row(value)?),
+            _ => RowInner::Text(value),
+        };
+        Ok(Self { inner })
+    }
+
+    /// 列数
+    pub fn len(&self) -> usize {
+        match &self.inner {
+            RowInner::Compact { count, .. } => *count,
+            RowInner::Text(_) => 1,
+            RowInner::Decoded(row) => row.len(),
+        }
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// 第 `index` 列的列 ID
+    pub fn column_id(&self, index: usize) -> u32 {
+        match &self.inner {
+            RowInner::Compact { large: true, ids, .. } => u32::from_le_bytes(ids[index * 4..index * 4 + 4].try_into().unwrap()),
+            RowInner::Compact { ids, .. } => ids[index] as u32,
+            RowInner::Text(_) | RowInner::Decoded(_) => index as u32,
+        }
+    }
+
+    /// 列 ID 对应的列位置
+    pub fn position(&self, column_id: u32) -> Option<usize> {
+        let (mut low, mut high) = (0, self.len());
+        while low < high {
+            let mid = (low + high) / 2;
+            match self.column_id(mid).cmp(&column_id) {
+                std::cmp::Ordering::Less => low = mid + 1,
+                std::cmp::Ordering::Greater => high = mid,
+                std::cmp::Ordering::Equal => return Some(mid),
+            }
+        }
+        None
+    }
+
+    /// 列为 NULL 或不存在时返回 true，不解码列值
+    pub fn is_null(&self, column_id: u32) -> bool {
+        match (self.position(column_id), &self.inner) {
+            (None, _) => true,
+            (Some(index), RowInner::Compact { nulls, .. }) => nulls[index / 8] & (1 << (index % 8)) != 0,
+            (Some(_), RowInner::Text(_)) => false,
+            (Some(index), RowInner::Decoded(row)) => row[index].is_null(),
+        }
+    }
+
+    /// 按列 ID 读取，行中没有该列时视为 NULL
+    pub fn get(&self, column_id: u32) -> Result<Datum, StorageError> {
+        self.get_ref(column_id).map(DatumRef::to_owned)
+    }
+
+    /// 按列 ID 借用读取，字节串列直接指向行缓冲
+    pub fn get_ref(&self, column_id: u32) -> Result<DatumRef<'_>, StorageError> {
+        match self.position(column_id) {
+            Some(index) => self.datum_ref_at(index),
+            None => Ok(DatumRef::Null),
+        }
+    }
+
+    /// 只解码投影列
+    pub fn project(&self, column_ids: &[u32]) -> Result<Vec<Datum>, StorageError> {
+        column_ids.iter().map(|&id| self.get(id)).collect()
+    }
+
+    /// 解码所有列
+    pub fn to_datums(&self) -> Result<Vec<Datum>, StorageError> {
+        if let RowInner::Decoded(row) = &self.inner {
+            return Ok(row.clone());
+        }
+        (0..self.len()).map(|index| self.datum_at(index)).collect()
+    }
+
+    /// 解码第 `index` 列
+    pub fn datum_at(&self, index: usize) -> Result<Datum, StorageError> {
+        self.datum_ref_at(index).map(DatumRef::to_owned)
+    }
+
+    /// 借用第 `index` 列
+    pub fn datum_ref_at(&self, index: usize) -> Result<DatumRef<'_>, StorageError> {
+        let (large, nulls, types, offsets, data) = match &self.inner {
+            RowInner::Compact { large, nulls, types, offsets, data, .. } => (*large, *nulls, *types, *offsets, *data),
+            RowInner::Text(text) => return Ok(DatumRef::Bytes(text)),
+            RowInner::Decoded(row) => return Ok(DatumRef::from(&row[index])),
+        };
+        if nulls[index / 8] & (1 << (index % 8)) != 0 {
+            return Ok(DatumRef::Null);
+        }
+
+        let offset_at = |i: usize| -> usize {
+            if large {
+                u32::from_le_bytes(offsets[i * 4..i * 4 + 4].try_into().unwrap()) as usize
+            } else {
+                u16::from_le_bytes(offsets[i * 2..i * 2 + 2].try_into().unwrap()) as usize
+            }
+        };
+        let start = if index == 0 { 0 } else { offset_at(index - 1) };
+        let end = offset_at(index);
+        let bytes = data
+            .get(start..end)
+            .ok_or_else(|| StorageError::Deserialization("row column out of bounds".to_string()))?;
+
+        let fixed = |width: usize| -> Result<&'a [u8], StorageError> {
+            if bytes.len() == width {
+                Ok(bytes)
+            } else {
+                Err(StorageError::Deserialization(format!("row column expects {width} bytes, found {}", bytes.len())))
+            }
+        };
+        Ok(match types[index] {
+            TYPE_NULL => DatumRef::Null,
+            TYPE_BOOL => DatumRef::Bool(fixed(1)?[0] != 0),
+            TYPE_INT => DatumRef::Int(i64::from_le_bytes(fixed(8)?.try_into().unwrap())),
+            TYPE_FLOAT => DatumRef::Float(f64::from_le_bytes(fixed(8)?.try_into().unwrap())),
+            TYPE_BYTES => DatumRef::Bytes(bytes),
+            tag => return Err(StorageError::Deserialization(format!("unknown datum tag {tag}"))),
+        })
+    }
+}
+
+/// 旧格式：`[magic][列数 u16][(tag, payload)...]`
+fn decode_legacy_row(value: &[u8]) -> Result<Vec<Datum>, StorageError> {
+    let mut pos = 1;
+    let mut take = |n: usize| take_bytes(value, &mut pos, n, "coprocessor row");
+
+    let count = u16::from_le_bytes(take(2)?.try_into().unwrap()) as usize;
+    let mut row = Vec::with_capacity(count);
+    for _ in 0..count {
+        let datum = match take(1)?[0] {
+            0 => Datum::Null,
+            1 => Datum::Bool(take(1)?[0] != 0),
+            2 => Datum::Int(i64::from_le_bytes(take(8)?.try_into().unwrap())),
+            3 => Datum::Float(f64::from_le_bytes(take(8)?.try_into().unwrap())),
+            4 => {
+                let len = u32::from_le_bytes(take(4)?.try_into().unwrap()) as usize;
+                Datum::Bytes(take(len)?.to_vec())
+            }
+            tag => return Err(StorageError::Deserialization(format!("unknown datum tag {tag}"))),
+        };
+        row.push(datum);
+    }
+    Ok(row)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_compact_row_is_smaller_than_legacy() {
+        let row = vec![Datum::Int(1), Datum::Null, Datum::Bytes(b"alice".to_vec()), Datum::Float(2.5), Datum::Bool(false)];
+        let encoded = encode_row(&row);
+        assert_eq!(encoded[1], 0);
+        assert_eq!(decode_row(&encoded).unwrap(), row);
+        // 头部 4 + 列 ID 5 + 位图 1 + 类型 5 + 偏移 10 + 数据 22
+        assert_eq!(encoded.len(), 47);
+
+        let mut legacy = vec![ROW_FORMAT_MAGIC, 2, 0, 2];
+        legacy.extend_from_slice(&7i64.to_le_bytes());
+        legacy.push(0);
+        assert_eq!(decode_row(&legacy).unwrap(), vec![Datum::Int(7), Datum::Null]);
+    }
+
+    #[test]
+    fn test_lazy_projection_by_column_id() {
+        let encoded = encode_row_with_ids(&[
+            (300, Datum::Bytes(b"late".to_vec())),
+            (2, Datum::Int(-9)),
+            (7, Datum::Null),
+        ]);
+        assert_eq!(encoded[1], FLAG_LARGE);
+
+        let view = RowView::new(&encoded).unwrap();
+        assert_eq!(view.len(), 3);
+        assert_eq!(view.column_id(2), 300);
+        assert!(view.is_null(7) && view.is_null(99) && !view.is_null(2));
+        assert_eq!(
+            view.project(&[300, 2, 5]).unwrap(),
+            vec![Datum::Bytes(b"late".to_vec()), Datum::Int(-9), Datum::Null]
+        );
+    }
+
+    #[test]
+    fn test_borrowed_columns_share_the_row_buffer() {
+        let value = Bytes::from(encode_row(&[Datum::Int(3), Datum::Bytes(b"shared".to_vec()), Datum::Null]));
+        let view = RowView::new(&value).unwrap();
+        let name = match view.get_ref(1).unwrap() {
+            DatumRef::Bytes(bytes) => bytes,
+            other => panic!("unexpected datum {:?}", other),
+        };
+        assert!(value.as_ptr_range().contains(&name.as_ptr()));
+        assert_eq!(view.get_ref(0).unwrap(), DatumRef::Int(3));
+        assert_eq!(view.get_ref(9).unwrap().to_text(), "NULL");
+
+        let column = slice_column(&value, 1).unwrap().unwrap();
+        assert_eq!(&column[..], b"shared");
+        assert_eq!(column.as_ptr(), name.as_ptr());
+        assert_eq!(slice_column(&value, 0).unwrap(), None);
+
+        // 纯文本值作为第 0 列，同样不复制
+        let text = Bytes::from_static(b"plain");
+        assert_eq!(slice_column(&text, 0).unwrap().unwrap().as_ptr(), text.as_ptr());
+    }
+
+    #[test]
+    fn test_corrupted_row_is_rejected() {
+        let encoded = encode_row(&[Datum::Int(1), Datum::Bytes(b"xyz".to_vec())]);
+        assert!(RowView::new(&encoded[..5]).is_err());
+        let truncated = RowView::new(&encoded[..encoded.len() - 2]).unwrap();
+        assert!(truncated.get(0).is_ok());
+        assert!(truncated.get(1).is_err());
+    }
+}
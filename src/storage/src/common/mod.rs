@@ -1,11 +1,12 @@
 //! 存储层通用类型和错误定义
 
+pub use bytes::Bytes;
 use serde::{Deserialize, Serialize};
 use std::collections::HashMap;
 use thiserror::Error;
 
 /// 存储层错误类型
-#[derive(Error, Debug)]
+#[derive(Error, Debug, Clone)]
 pub enum StorageError {
     #[error("连接错误: {0}")]
     Connection(String),
@@ -55,10 +56,13 @@ impl From<common::Error> for StorageError {
 
 
 /// 存储键类型
-pub type Key = Vec<u8>;
+///
+/// 引用计数、可切片的字节缓冲：克隆只增加引用计数，`slice` 共享同一块内存，
+/// 从客户端响应到扫描结果再到行解码都不复制键值字节。
+pub type Key = Bytes;
 
-/// 存储值类型
-pub type Value = Vec<u8>;
+/// 存储值类型，与 [`Key`] 相同的零拷贝缓冲
+pub type Value = Bytes;
 
 /// 键值对
 pub type KeyValue = (Key, Value);
@@ -0,0 +1,519 @@
+//! 协处理器下推
+//!
+//! SQL 层把过滤、投影和部分聚合编译为 `CoprocessorProgram`，序列化后随扫描范围
+//! 一起交给存储引擎。程序由 `CoprocessorEvaluator` 在数据所在位置逐行求值，
+//! 只有通过过滤的投影列或部分聚合状态才会返回，协调节点再用
+//! `merge_partial_aggregates` 合并各区域的部分聚合结果。
+
+use serde::{Deserialize, Serialize};
+use std::cmp::Ordering;
+use std::collections::HashMap;
+
+use crate::common::{Key, StorageError};
+
+pub use crate::codec::{decode_row, encode_row, Datum, RowView, ROW_FORMAT_MAGIC};
+
+/// 二元运算符
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+pub enum CopBinaryOp {
+    Eq,
+    Ne,
+    Lt,
+    Le,
+    Gt,
+    Ge,
+    And,
+    Or,
+    Add,
+    Sub,
+    Mul,
+    Div,
+}
+
+/// 下推表达式，列按列 ID 引用
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub enum CopExpr {
+    Column(usize),
+    Literal(Datum),
+    Binary {
+        op: CopBinaryOp,
+        left: Box<CopExpr>,
+        right: Box<CopExpr>,
+    },
+    Not(Box<CopExpr>),
+    IsNull(Box<CopExpr>),
+}
+
+impl CopExpr {
+    pub fn binary(op: CopBinaryOp, left: CopExpr, right: CopExpr) -> Self {
+        CopExpr::Binary { op, left: Box::new(left), right: Box::new(right) }
+    }
+
+    /// 收集表达式引用的列
+    pub fn collect_columns(&self, columns: &mut Vec<usize>) {
+        match self {
+            CopExpr::Column(index) => columns.push(*index),
+            CopExpr::Literal(_) => {}
+            CopExpr::Not(inner) | CopExpr::IsNull(inner) => inner.collect_columns(columns),
+            CopExpr::Binary { left, right, .. } => {
+                left.collect_columns(columns);
+                right.collect_columns(columns);
+            }
+        }
+    }
+
+    /// 对一行求值
+    pub fn eval(&self, row: &[Datum]) -> Datum {
+        match self {
+            CopExpr::Column(index) => row.get(*index).cloned().unwrap_or(Datum::Null),
+            CopExpr::Literal(datum) => datum.clone(),
+            CopExpr::Not(inner) => match inner.eval(row).truth() {
+                Some(v) => Datum::Bool(!v),
+                None => Datum::Null,
+            },
+            CopExpr::IsNull(inner) => Datum::Bool(inner.eval(row).is_null()),
+            CopExpr::Binary { op, left, right } => {
+                let left = left.eval(row);
+                match op {
+                    // AND/OR 按三值逻辑短路
+                    CopBinaryOp::And => {
+                        if left.truth() == Some(false) {
+                            return Datum::Bool(false);
+                        }
+                        match (left.truth(), right.eval(row).truth()) {
+                            (_, Some(false)) => Datum::Bool(false),
+                            (Some(true), Some(true)) => Datum::Bool(true),
+                            _ => Datum::Null,
+                        }
+                    }
+                    CopBinaryOp::Or => {
+                        if left.truth() == Some(true) {
+                            return Datum::Bool(true);
+                        }
+                        match (left.truth(), right.eval(row).truth()) {
+                            (_, Some(true)) => Datum::Bool(true),
+                            (Some(false), Some(false)) => Datum::Bool(false),
+                            _ => Datum::Null,
+                        }
+                    }
+                    _ => Self::eval_scalar(*op, &left, &right.eval(row)),
+                }
+            }
+        }
+    }
+
+    fn eval_scalar(op: CopBinaryOp, left: &Datum, right: &Datum) -> Datum {
+        let compare = |accept: fn(Ordering) -> bool| match left.sql_cmp(right) {
+            Some(ordering) => Datum::Bool(accept(ordering)),
+            None => Datum::Null,
+        };
+        match op {
+            CopBinaryOp::Eq => compare(|o| o == Ordering::Equal),
+            CopBinaryOp::Ne => compare(|o| o != Ordering::Equal),
+            CopBinaryOp::Lt => compare(|o| o == Ordering::Less),
+            CopBinaryOp::Le => compare(|o| o != Ordering::Greater),
+            CopBinaryOp::Gt => compare(|o| o == Ordering::Greater),
+            CopBinaryOp::Ge => compare(|o| o != Ordering::Less),
+            CopBinaryOp::Add | CopBinaryOp::Sub | CopBinaryOp::Mul => {
+                if let (Datum::Int(a), Datum::Int(b)) = (left, right) {
+                    let exact = match op {
+                        CopBinaryOp::Add => a.checked_add(*b),
+                        CopBinaryOp::Sub => a.checked_sub(*b),
+                        _ => a.checked_mul(*b),
+                    };
+                    if let Some(v) = exact {
+                        return Datum::Int(v);
+                    }
+                }
+                match (left.as_f64(), right.as_f64()) {
+                    (Some(a), Some(b)) => Datum::Float(match op {
+                        CopBinaryOp::Add => a + b,
+                        CopBinaryOp::Sub => a - b,
+                        _ => a * b,
+                    }),
+                    _ => Datum::Null,
+                }
+            }
+            CopBinaryOp::Div => match (left.as_f64(), right.as_f64()) {
+                (Some(_), Some(b)) if b == 0.0 => Datum::Null,
+                (Some(a), Some(b)) => Datum::Float(a / b),
+                _ => Datum::Null,
+            },
+            CopBinaryOp::And | CopBinaryOp::Or => unreachable!("logical operators are evaluated lazily"),
+        }
+    }
+}
+
+/// 可分解的聚合函数；AVG 由 SQL 层拆为 SUM 与 COUNT
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+pub enum CopAggregateFunction {
+    Count,
+    Sum,
+    Min,
+    Max,
+}
+
+/// 单个部分聚合，`column` 为 None 表示 `COUNT(*)`
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct CopAggregate {
+    pub function: CopAggregateFunction,
+    pub column: Option<usize>,
+}
+
+impl CopAggregate {
+    fn initial(&self) -> Datum {
+        match self.function {
+            CopAggregateFunction::Count => Datum::Int(0),
+            _ => Datum::Null,
+        }
+    }
+
+    /// 用输入值更新部分状态
+    fn update(&self, state: &mut Datum, row: &[Datum]) {
+        let value = match self.column {
+            Some(index) => row.get(index).cloned().unwrap_or(Datum::Null),
+            None => Datum::Int(1),
+        };
+        match self.function {
+            CopAggregateFunction::Count => {
+                if !value.is_null() {
+                    if let Datum::Int(count) = state {
+                        *count += 1;
+                    }
+                }
+            }
+            _ => self.merge(state, value),
+        }
+    }
+
+    /// 合并两个部分状态 (COUNT 的状态按 SUM 合并)
+    fn merge(&self, state: &mut Datum, value: Datum) {
+        if value.is_null() {
+            return;
+        }
+        if state.is_null() {
+            *state = match self.function {
+                // 文本形式的数值在求和时转为数值
+                CopAggregateFunction::Sum | CopAggregateFunction::Count => match value {
+                    Datum::Int(_) | Datum::Float(_) => value,
+                    other => match other.as_f64() {
+                        Some(v) => Datum::Float(v),
+                        None => return,
+                    },
+                },
+                _ => value,
+            };
+            return;
+        }
+        match self.function {
+            CopAggregateFunction::Sum | CopAggregateFunction::Count => {
+                *state = CopExpr::eval_scalar(CopBinaryOp::Add, state, &value);
+            }
+            CopAggregateFunction::Min => {
+                if value.sql_cmp(state) == Some(Ordering::Less) {
+                    *state = value;
+                }
+            }
+            CopAggregateFunction::Max => {
+                if value.sql_cmp(state) == Some(Ordering::Greater) {
+                    *state = value;
+                }
+            }
+        }
+    }
+}
+
+/// 部分聚合：输出行为 `分组键... , 聚合状态...`
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct PartialAggregate {
+    pub group_by: Vec<usize>,
+    pub aggregates: Vec<CopAggregate>,
+}
+
+/// 下推到存储端执行的程序
+#[derive(Debug, Clone, Default, PartialEq, Serialize, Deserialize)]
+pub struct CoprocessorProgram {
+    /// 过滤条件，结果为真的行才会保留
+    pub filter: Option<CopExpr>,
+    /// 输出列，None 表示整行
+    pub projection: Option<Vec<usize>>,
+    /// 部分聚合，设置后忽略 projection
+    pub aggregate: Option<PartialAggregate>,
+    /// 非聚合程序最多返回的行数
+    pub limit: Option<u64>,
+}
+
+impl CoprocessorProgram {
+    /// 程序需要读取的列，升序去重；None 表示需要整行
+    pub fn referenced_columns(&self) -> Option<Vec<usize>> {
+        let mut columns = Vec::new();
+        if let Some(aggregate) = &self.aggregate {
+            columns.extend(aggregate.group_by.iter().copied());
+            columns.extend(aggregate.aggregates.iter().filter_map(|aggregate| aggregate.column));
+        } else {
+            columns.extend(self.projection.as_ref()?.iter().copied());
+        }
+        if let Some(filter) = &self.filter {
+            filter.collect_columns(&mut columns);
+        }
+        columns.sort_unstable();
+        columns.dedup();
+        Some(columns)
+    }
+
+    pub fn serialize(&self) -> Result<Vec<u8>, StorageError> {
+        serde_json::to_vec(self).map_err(|e| StorageError::Serialization(e.to_string()))
+    }
+
+    pub fn deserialize(bytes: &[u8]) -> Result<Self, StorageError> {
+        serde_json::from_slice(bytes).map_err(|e| StorageError::Deserialization(e.to_string()))
+    }
+}
+
+/// 协处理器请求
+#[derive(Debug, Clone)]
+pub struct CoprocessorRequest {
+    pub start_key: Key,
+    pub end_key: Key,
+    /// `CoprocessorProgram::serialize` 的输出
+    pub program: Vec<u8>,
+}
+
+impl CoprocessorRequest {
+    pub fn new(start_key: Key, end_key: Key, program: &CoprocessorProgram) -> Result<Self, StorageError> {
+        Ok(Self { start_key, end_key, program: program.serialize()? })
+    }
+}
+
+/// 协处理器响应
+#[derive(Debug, Clone, Default)]
+pub struct CoprocessorResponse {
+    /// 投影后的行或部分聚合行
+    pub rows: Vec<Vec<Datum>>,
+    /// 扫描过的行数
+    pub scanned_rows: u64,
+    /// 扫描过的键值字节数
+    pub scanned_bytes: u64,
+    /// 返回结果按行格式编码后的字节数
+    pub returned_bytes: u64,
+}
+
+/// 在数据所在位置逐行执行协处理器程序
+pub struct CoprocessorEvaluator {
+    program: CoprocessorProgram,
+    /// 需要解码的列，其余列不解码
+    columns: Option<Vec<usize>>,
+    rows: Vec<Vec<Datum>>,
+    /// 编码后的分组键 -> groups 下标，分组按首次出现的顺序输出
+    group_index: HashMap<Vec<u8>, usize>,
+    groups: Vec<(Vec<Datum>, Vec<Datum>)>,
+    scanned_rows: u64,
+    scanned_bytes: u64,
+}
+
+impl CoprocessorEvaluator {
+    pub fn new(program: CoprocessorProgram) -> Self {
+        Self {
+            columns: program.referenced_columns(),
+            program,
+            rows: Vec::new(),
+            group_index: HashMap::new(),
+            groups: Vec::new(),
+            scanned_rows: 0,
+            scanned_bytes: 0,
+        }
+    }
+
+    /// 处理一条键值对；返回 false 表示已达到 limit，调用方可以停止扫描
+    pub fn feed(&mut self, key: &[u8], value: &[u8]) -> Result<bool, StorageError> {
+        self.scanned_rows += 1;
+        self.scanned_bytes += (key.len() + value.len()) as u64;
+
+        let row = self.decode(value)?;
+        if let Some(filter) = &self.program.filter {
+            if filter.eval(&row).truth() != Some(true) {
+                return Ok(true);
+            }
+        }
+
+        if let Some(aggregate) = &self.program.aggregate {
+            let group_key: Vec<Datum> = aggregate
+                .group_by
+                .iter()
+                .map(|&index| row.get(index).cloned().unwrap_or(Datum::Null))
+                .collect();
+            let encoded = encode_row(&group_key);
+            let slot = match self.group_index.get(&encoded) {
+                Some(&slot) => slot,
+                None => {
+                    let states = aggregate.aggregates.iter().map(CopAggregate::initial).collect();
+                    self.groups.push((group_key, states));
+                    self.group_index.insert(encoded, self.groups.len() - 1);
+                    self.groups.len() - 1
+                }
+            };
+            let states = &mut self.groups[slot].1;
+            for (aggregate, state) in aggregate.aggregates.iter().zip(states.iter_mut()) {
+                aggregate.update(state, &row);
+            }
+            return Ok(true);
+        }
+
+        let output = match &self.program.projection {
+            Some(columns) => columns
+                .iter()
+                .map(|&index| row.get(index).cloned().unwrap_or(Datum::Null))
+                .collect(),
+            None => row,
+        };
+        self.rows.push(output);
+        Ok(self.program.limit.map_or(true, |limit| (self.rows.len() as u64) < limit))
+    }
+
+    /// 只解码程序引用的列，未引用的位置填 NULL
+    fn decode(&self, value: &[u8]) -> Result<Vec<Datum>, StorageError> {
+        let view = RowView::new(value)?;
+        let Some(columns) = &self.columns else {
+            return view.to_datums();
+        };
+        let width = columns.last().map_or(0, |&last| last + 1);
+        let mut row = vec![Datum::Null; width];
+        for &column in columns {
+            row[column] = view.get(column as u32)?;
+        }
+        Ok(row)
+    }
+
+    pub fn finish(self) -> CoprocessorResponse {
+        let mut rows = self.rows;
+        if let Some(aggregate) = &self.program.aggregate {
+            // 无分组键的聚合即使没有输入也要输出一行
+            if self.groups.is_empty() && aggregate.group_by.is_empty() {
+                rows.push(aggregate.aggregates.iter().map(CopAggregate::initial).collect());
+            }
+            rows.extend(self.groups.into_iter().map(|(mut key, states)| {
+                key.extend(states);
+                key
+            }));
+        }
+        let returned_bytes = rows.iter().map(|row| encode_row(row).len() as u64).sum();
+        CoprocessorResponse {
+            rows,
+            scanned_rows: self.scanned_rows,
+            scanned_bytes: self.scanned_bytes,
+            returned_bytes,
+        }
+    }
+}
+
+/// 合并多个区域返回的部分聚合行，输出最终的 `分组键..., 聚合值...`
+pub fn merge_partial_aggregates(aggregate: &PartialAggregate, partials: Vec<Vec<Datum>>) -> Vec<Vec<Datum>> {
+    let key_len = aggregate.group_by.len();
+    let mut group_index: HashMap<Vec<u8>, usize> = HashMap::new();
+    let mut groups: Vec<Vec<Datum>> = Vec::new();
+
+    for row in partials {
+        let encoded = encode_row(&row[..key_len.min(row.len())]);
+        match group_index.get(&encoded) {
+            Some(&slot) => {
+                let merged = &mut groups[slot];
+                for (i, (spec, value)) in aggregate.aggregates.iter().zip(row.into_iter().skip(key_len)).enumerate() {
+                    spec.merge(&mut merged[key_len + i], value);
+                }
+            }
+            None => {
+                group_index.insert(encoded, groups.len());
+                groups.push(row);
+            }
+        }
+    }
+    groups
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn row(id: i64, dept: &str, salary: f64) -> Vec<u8> {
+        encode_row(&[Datum::Int(id), Datum::Bytes(dept.as_bytes().to_vec()), Datum::Float(salary)])
+    }
+
+    #[test]
+    fn test_row_codec_round_trip() {
+        let original = vec![Datum::Null, Datum::Bool(true), Datum::Int(-7), Datum::Float(1.5), Datum::Bytes(b"abc".to_vec())];
+        assert_eq!(decode_row(&encode_row(&original)).unwrap(), original);
+
+        // 旧的纯文本值视为单列
+        assert_eq!(decode_row(b"42").unwrap(), vec![Datum::Bytes(b"42".to_vec())]);
+        assert!(decode_row(&[ROW_FORMAT_MAGIC, 1, 0, 2, 0]).is_err());
+    }
+
+    #[test]
+    fn test_filter_and_projection() {
+        let program = CoprocessorProgram {
+            filter: Some(CopExpr::binary(
+                CopBinaryOp::And,
+                CopExpr::binary(CopBinaryOp::Gt, CopExpr::Column(2), CopExpr::Literal(Datum::Int(150))),
+                CopExpr::binary(CopBinaryOp::Ne, CopExpr::Column(1), CopExpr::Literal(Datum::Bytes(b"hr".to_vec()))),
+            )),
+            projection: Some(vec![0]),
+            ..Default::default()
+        };
+        let program = CoprocessorProgram::deserialize(&program.serialize().unwrap()).unwrap();
+
+        let mut evaluator = CoprocessorEvaluator::new(program);
+        evaluator.feed(b"k1", &row(1, "it", 100.0)).unwrap();
+        evaluator.feed(b"k2", &row(2, "it", 200.0)).unwrap();
+        evaluator.feed(b"k3", &row(3, "hr", 300.0)).unwrap();
+        let response = evaluator.finish();
+
+        assert_eq!(response.rows, vec![vec![Datum::Int(2)]]);
+        assert_eq!(response.scanned_rows, 3);
+        assert!(response.returned_bytes < response.scanned_bytes);
+    }
+
+    #[test]
+    fn test_partial_and_final_aggregate() {
+        let aggregate = PartialAggregate {
+            group_by: vec![1],
+            aggregates: vec![
+                CopAggregate { function: CopAggregateFunction::Count, column: None },
+                CopAggregate { function: CopAggregateFunction::Sum, column: Some(2) },
+                CopAggregate { function: CopAggregateFunction::Max, column: Some(0) },
+            ],
+        };
+        let program = CoprocessorProgram { aggregate: Some(aggregate.clone()), ..Default::default() };
+
+        // 两个区域各自做部分聚合
+        let mut region_a = CoprocessorEvaluator::new(program.clone());
+        region_a.feed(b"k1", &row(1, "it", 100.0)).unwrap();
+        region_a.feed(b"k2", &row(2, "hr", 50.0)).unwrap();
+        let mut region_b = CoprocessorEvaluator::new(program);
+        region_b.feed(b"k3", &row(3, "it", 200.0)).unwrap();
+
+        let mut partials = region_a.finish().rows;
+        partials.extend(region_b.finish().rows);
+        let merged = merge_partial_aggregates(&aggregate, partials);
+
+        assert_eq!(
+            merged,
+            vec![
+                vec![Datum::Bytes(b"it".to_vec()), Datum::Int(2), Datum::Float(300.0), Datum::Int(3)],
+                vec![Datum::Bytes(b"hr".to_vec()), Datum::Int(1), Datum::Float(50.0), Datum::Int(2)],
+            ]
+        );
+    }
+
+    #[test]
+    fn test_global_aggregate_on_empty_input() {
+        let program = CoprocessorProgram {
+            aggregate: Some(PartialAggregate {
+                group_by: vec![],
+                aggregates: vec![CopAggregate { function: CopAggregateFunction::Count, column: None }],
+            }),
+            ..Default::default()
+        };
+        let response = CoprocessorEvaluator::new(program).finish();
+        assert_eq!(response.rows, vec![vec![Datum::Int(0)]]);
+    }
+}
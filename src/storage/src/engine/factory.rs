@@ -1,6 +1,7 @@
 //! 存储引擎工厂
 //!
-//! 负责创建和管理不同的存储引擎实例
+//! 负责创建和管理不同的存储引擎实例。每种引擎只创建一次，之后的调用共享同一实例，
+//! 内存引擎的数据因此在多次获取之间保持可见。
 
 use std::collections::HashMap;
 use std::sync::Arc;
@@ -12,7 +13,7 @@ use crate::engine::{StorageEngine, TiKVEngine, MemoryEngine};
 
 /// 存储引擎工厂
 pub struct StorageEngineFactory {
-    engines: Arc<RwLock<HashMap<EngineType, Box<dyn StorageEngine>>>>,
+    engines: Arc<RwLock<HashMap<EngineType, Arc<dyn StorageEngine>>>>,
     configs: Arc<RwLock<HashMap<EngineType, StorageConfig>>>,
 }
 
@@ -71,10 +72,16 @@ impl StorageEngineFactory {
         }
     }
 
-    /// 获取存储引擎实例
-    pub async fn get_engine(&self, engine_type: EngineType) -> Result<Box<dyn StorageEngine>> {
-        // 由于 Box<dyn StorageEngine> 不能克隆，每次都创建新实例
-        self.create_engine(engine_type).await
+    /// 获取存储引擎实例，首次获取时创建，之后返回同一实例
+    pub async fn get_engine(&self, engine_type: EngineType) -> Result<Arc<dyn StorageEngine>> {
+        if let Some(engine) = self.engines.read().get(&engine_type) {
+            return Ok(engine.clone());
+        }
+
+        let created: Arc<dyn StorageEngine> = Arc::from(self.create_engine(engine_type).await?);
+        // 并发创建时以先写入的实例为准
+        let mut engines = self.engines.write();
+        Ok(engines.entry(engine_type).or_insert(created).clone())
     }
 
     /// 获取所有已注册的引擎类型
@@ -85,19 +92,24 @@ impl StorageEngineFactory {
 
     /// 移除存储引擎
     pub async fn remove_engine(&self, engine_type: EngineType) -> Result<()> {
-        let mut engines = self.engines.write();
-        if let Some(mut engine) = engines.remove(&engine_type) {
-            engine.shutdown().await.map_err(|e| common::Error::Storage(e.to_string()))?;
+        let engine = self.engines.write().remove(&engine_type);
+        if let Some(mut engine) = engine {
+            // 仍被其他调用方持有的实例随最后一个引用释放
+            if let Some(engine) = Arc::get_mut(&mut engine) {
+                engine.shutdown().await.map_err(|e| common::Error::Storage(e.to_string()))?;
+            }
         }
         Ok(())
     }
 
     /// 关闭所有存储引擎
     pub async fn shutdown_all(&self) -> Result<()> {
-        let mut engines = self.engines.write();
-        for (_, mut engine) in engines.drain() {
-            if let Err(e) = engine.shutdown().await {
-                tracing::error!("Failed to shutdown engine: {}", e);
+        let engines: Vec<_> = self.engines.write().drain().collect();
+        for (_, mut engine) in engines {
+            if let Some(engine) = Arc::get_mut(&mut engine) {
+                if let Err(e) = engine.shutdown().await {
+                    tracing::error!("Failed to shutdown engine: {}", e);
+                }
             }
         }
         Ok(())
@@ -106,7 +118,7 @@ impl StorageEngineFactory {
     /// 健康检查所有引擎
     pub async fn health_check_all(&self) -> HashMap<EngineType, bool> {
         let mut results = HashMap::new();
-        let engines = self.engines.read();
+        let engines: Vec<_> = self.engines.read().iter().map(|(t, e)| (*t, e.clone())).collect();
 
         for (engine_type, engine) in engines.iter() {
             let is_healthy = engine.health_check().await.unwrap_or(false);
@@ -119,7 +131,7 @@ impl StorageEngineFactory {
     /// 获取所有引擎的统计信息
     pub async fn get_all_stats(&self) -> HashMap<EngineType, StorageStats> {
         let mut results = HashMap::new();
-        let engines = self.engines.read();
+        let engines: Vec<_> = self.engines.read().iter().map(|(t, e)| (*t, e.clone())).collect();
 
         for (engine_type, engine) in engines.iter() {
             if let Ok(stats) = engine.get_stats().await {
@@ -0,0 +1,361 @@
+//! 组提交
+//!
+//! 并发会话提交的小事务在一个很短的时间窗口内攒成一组，合并为一个存储层事务提交，
+//! 一组只付一次提交往返。组按区域划分：写集合落在同一区域的事务才进同一组，合并后的
+//! 事务仍然只涉及一个区域，存储层可以继续走一阶段提交；跨区域的事务另成一组。
+//!
+//! 组内事务的写集合互不相交：与待提交组有相同键的事务让那些组立即提交，自己进入的组
+//! 等它们提交完成后才提交，同一个键上的写入按到达顺序落盘，合并不会吞掉任何一方的写入，
+//! 冲突仍由存储引擎判定。组提交失败时逐个单独重试组内事务，各自得到自己的结果。
+//! 组攒满 `max_group_size` 时立即提交。
+
+use parking_lot::{Mutex, RwLock};
+use std::collections::{HashMap, HashSet};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::Arc;
+use std::time::Duration;
+use tokio::sync::oneshot;
+use tracing::debug;
+
+use super::write_buffer::WriteBuffer;
+use super::{StorageEngine, StorageTransaction};
+use crate::client::RegionMap;
+use crate::common::{Key, StorageContext, StorageError, StorageOptions};
+
+/// 组提交配置
+#[derive(Debug, Clone)]
+pub struct GroupCommitConfig {
+    /// 组从第一个事务开始最多等待的时间
+    pub max_wait: Duration,
+    /// 一组最多的事务数，攒满立即提交
+    pub max_group_size: usize,
+}
+
+impl Default for GroupCommitConfig {
+    fn default() -> Self {
+        Self {
+            max_wait: Duration::from_micros(200),
+            max_group_size: 64,
+        }
+    }
+}
+
+/// 组提交统计
+#[derive(Debug, Clone, Default)]
+pub struct GroupCommitStats {
+    /// 提交的事务数
+    pub commits: u64,
+    /// 发出的存储层事务数
+    pub groups: u64,
+}
+
+type CommitWaiter = oneshot::Sender<Result<(), StorageError>>;
+
+/// 组的归属：写集合所在的区域，跨区域的事务为 None
+type GroupKey = Option<usize>;
+
+struct PendingGroup {
+    generation: u64,
+    /// 组内所有事务写过的键
+    keys: HashSet<Key>,
+    members: Vec<(WriteBuffer, CommitWaiter)>,
+    /// 与本组写集合相交、先行提交的组，本组等它们提交完成后再提交
+    predecessors: Vec<oneshot::Receiver<()>>,
+    /// 等待本组提交完成的后继组，本组提交完成时丢弃即通知
+    successors: Vec<oneshot::Sender<()>>,
+}
+
+impl PendingGroup {
+    fn new(generation: u64) -> Self {
+        Self {
+            generation,
+            keys: HashSet::new(),
+            members: Vec::new(),
+            predecessors: Vec::new(),
+            successors: Vec::new(),
+        }
+    }
+}
+
+/// 组提交器
+pub struct GroupCommitter {
+    engine: Arc<dyn StorageEngine>,
+    config: GroupCommitConfig,
+    regions: Arc<RwLock<RegionMap>>,
+    pending: Mutex<HashMap<GroupKey, PendingGroup>>,
+    generation: AtomicU64,
+    commits: AtomicU64,
+    groups: AtomicU64,
+}
+
+impl GroupCommitter {
+    /// 按引擎自己的区域划分分组，不分区域的引擎所有事务共用一组
+    pub fn new(engine: Arc<dyn StorageEngine>, config: GroupCommitConfig) -> Self {
+        let regions = engine.region_map().unwrap_or_default();
+        Self::with_regions(engine, config, regions)
+    }
+
+    /// 按给定的区域划分分组
+    pub fn with_regions(engine: Arc<dyn StorageEngine>, config: GroupCommitConfig, regions: Arc<RwLock<RegionMap>>) -> Self {
+        Self {
+            engine,
+            config,
+            regions,
+            pending: Mutex::new(HashMap::new()),
+            generation: AtomicU64::new(0),
+            commits: AtomicU64::new(0),
+            groups: AtomicU64::new(0),
+        }
+    }
+
+    pub fn stats(&self) -> GroupCommitStats {
+        GroupCommitStats {
+            commits: self.commits.load(Ordering::Relaxed),
+            groups: self.groups.load(Ordering::Relaxed),
+        }
+    }
+
+    /// 提交一个事务的写缓冲，所在的组提交成功后返回
+    pub async fn commit(self: &Arc<Self>, buffer: WriteBuffer) -> Result<(), StorageError> {
+        if buffer.is_empty() {
+            return Ok(());
+        }
+        self.commits.fetch_add(1, Ordering::Relaxed);
+        let (sender, receiver) = oneshot::channel();
+        let group_key = self.group_key(&buffer);
+
+        let (overlapping, full, timer) = {
+            let mut pending = self.pending.lock();
+            // 与待提交组写集合相交时那些组先行提交，本事务所在的组排在它们之后
+            let overlapping_keys: Vec<GroupKey> = pending
+                .iter()
+                .filter(|(_, group)| buffer.keys().any(|key| group.keys.contains(key)))
+                .map(|(key, _)| *key)
+                .collect();
+            let mut overlapping = Vec::with_capacity(overlapping_keys.len());
+            let mut predecessors = Vec::with_capacity(overlapping_keys.len());
+            for key in overlapping_keys {
+                let mut group = pending.remove(&key).expect("listed above");
+                let (done, wait) = oneshot::channel();
+                group.successors.push(done);
+                predecessors.push(wait);
+                overlapping.push(group);
+            }
+
+            let group = pending
+                .entry(group_key)
+                .or_insert_with(|| PendingGroup::new(self.generation.fetch_add(1, Ordering::Relaxed)));
+            let timer = group.members.is_empty().then_some(group.generation);
+            group.predecessors.extend(predecessors);
+            group.keys.extend(buffer.keys().cloned());
+            group.members.push((buffer, sender));
+            let full = if group.members.len() >= self.config.max_group_size { pending.remove(&group_key) } else { None };
+            (overlapping, full, timer)
+        };
+
+        // 提交在后台任务里完成，调用方被取消时组内其他事务不受影响
+        for group in overlapping {
+            tokio::spawn(self.clone().flush(group));
+        }
+        if let Some(group) = full {
+            tokio::spawn(self.clone().flush(group));
+        } else if let Some(generation) = timer {
+            let committer = self.clone();
+            tokio::spawn(async move {
+                tokio::time::sleep(committer.config.max_wait).await;
+                let group = {
+                    let mut pending = committer.pending.lock();
+                    match pending.get(&group_key) {
+                        Some(group) if group.generation == generation => pending.remove(&group_key),
+                        _ => None,
+                    }
+                };
+                if let Some(group) = group {
+                    committer.flush(group).await;
+                }
+            });
+        }
+
+        receiver
+            .await
+            .unwrap_or_else(|_| Err(StorageError::Internal("group commit was dropped".to_string())))
+    }
+
+    /// 写集合所在的区域，跨区域时为 None
+    fn group_key(&self, buffer: &WriteBuffer) -> GroupKey {
+        let regions = self.regions.read();
+        let mut keys = buffer.keys();
+        let region = regions.region_of(keys.next()?);
+        keys.all(|key| regions.region_of(key) == region).then_some(region)
+    }
+
+    async fn flush(self: Arc<Self>, group: PendingGroup) {
+        // successors 在本函数返回时丢弃，通知后继组
+        let PendingGroup { members, predecessors, successors: _successors, .. } = group;
+        for predecessor in predecessors {
+            let _ = predecessor.await;
+        }
+
+        self.groups.fetch_add(1, Ordering::Relaxed);
+        let (mut buffers, mut waiters): (Vec<_>, Vec<_>) = members.into_iter().unzip();
+        debug!("Group commit of {} transactions", buffers.len());
+
+        if buffers.len() == 1 {
+            let result = commit_in_transaction(self.engine.as_ref(), buffers.pop().unwrap()).await;
+            let _ = waiters.pop().unwrap().send(result);
+            return;
+        }
+
+        let mut merged = WriteBuffer::new();
+        for buffer in &buffers {
+            merged.extend(buffer.clone());
+        }
+        if commit_in_transaction(self.engine.as_ref(), merged).await.is_ok() {
+            for waiter in waiters {
+                let _ = waiter.send(Ok(()));
+            }
+            return;
+        }
+
+        // 一个事务失败不应拖累同组其他事务：逐个单独提交
+        debug!("Group commit failed, retrying {} transactions individually", buffers.len());
+        for (buffer, waiter) in buffers.into_iter().zip(waiters) {
+            self.groups.fetch_add(1, Ordering::Relaxed);
+            let _ = waiter.send(commit_in_transaction(self.engine.as_ref(), buffer).await);
+        }
+    }
+}
+
+/// 把写缓冲作为一个存储引擎事务提交
+pub async fn commit_in_transaction(engine: &dyn StorageEngine, buffer: WriteBuffer) -> Result<(), StorageError> {
+    let options = StorageOptions::default();
+    let mut transaction = engine.begin_transaction(&StorageContext::default(), &options).await?;
+    commit_buffer(transaction.as_mut(), buffer).await
+}
+
+/// 把写缓冲写入已经打开的存储引擎事务并提交，写入失败时回滚
+pub async fn commit_buffer(transaction: &mut dyn StorageTransaction, buffer: WriteBuffer) -> Result<(), StorageError> {
+    let options = StorageOptions::default();
+    for (key, value) in buffer.into_mutations() {
+        let applied = match value {
+            Some(value) => transaction.put(&key, &value, &options).await.map(|_| ()),
+            None => transaction.delete(&key, &options).await.map(|_| ()),
+        };
+        if let Err(e) = applied {
+            let _ = transaction.rollback().await;
+            return Err(e);
+        }
+    }
+    transaction.commit().await
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::common::{Key, StorageConfig};
+    use crate::engine::MemoryEngine;
+
+    #[tokio::test]
+    async fn test_concurrent_commits_share_one_transaction() {
+        let mut engine = MemoryEngine::new();
+        engine.initialize(&StorageConfig::default()).await.unwrap();
+        let engine: Arc<dyn StorageEngine> = Arc::new(engine);
+        let config = GroupCommitConfig { max_wait: Duration::from_millis(20), max_group_size: 8 };
+        let committer = Arc::new(GroupCommitter::new(engine.clone(), config));
+
+        let commits: Vec<_> = (0..8)
+            .map(|i| {
+                let committer = committer.clone();
+                tokio::spawn(async move {
+                    let mut buffer = WriteBuffer::new();
+                    buffer.put(Key::from(format!("k{}", i)), Key::from(format!("v{}", i)));
+                    committer.commit(buffer).await
+                })
+            })
+            .collect();
+        for commit in commits {
+            commit.await.unwrap().unwrap();
+        }
+
+        // 攒满一组立即提交，不用等到窗口结束
+        assert_eq!(committer.stats().commits, 8);
+        assert_eq!(committer.stats().groups, 1);
+        let (context, options) = (StorageContext::default(), StorageOptions::default());
+        let stored = engine.scan(&Key::from("k"), &Key::from("l"), 100, &context, &options).await.unwrap().value;
+        assert_eq!(stored.len(), 8);
+
+        // 组未满时在窗口到期后提交
+        let mut buffer = WriteBuffer::new();
+        buffer.delete(Key::from("k0"));
+        committer.commit(buffer).await.unwrap();
+        assert_eq!(committer.stats().groups, 2);
+        assert!(engine.get(&Key::from("k0"), &context, &options).await.unwrap().value.is_none());
+        committer.commit(WriteBuffer::new()).await.unwrap();
+        assert_eq!(committer.stats().commits, 9);
+    }
+
+    #[tokio::test]
+    async fn test_overlapping_write_sets_commit_in_separate_groups() {
+        let mut engine = MemoryEngine::new();
+        engine.initialize(&StorageConfig::default()).await.unwrap();
+        let engine: Arc<dyn StorageEngine> = Arc::new(engine);
+        let config = GroupCommitConfig { max_wait: Duration::from_millis(20), max_group_size: 2 };
+        let committer = Arc::new(GroupCommitter::new(engine.clone(), config));
+
+        // 两个事务都写 shared，第二个到达时第一个所在的组先行提交；第三个事务攒满第二组，
+        // 第二组立即提交，但要等第一组提交完成，shared 最终是后到者写入的值
+        let commits: Vec<_> = (0..3)
+            .map(|i| {
+                let committer = committer.clone();
+                let mut buffer = WriteBuffer::new();
+                buffer.put(Key::from(format!("own{}", i)), Key::from("v"));
+                if i < 2 {
+                    buffer.put(Key::from("shared"), Key::from(format!("v{}", i)));
+                }
+                tokio::spawn(async move { committer.commit(buffer).await })
+            })
+            .collect();
+        for commit in commits {
+            commit.await.unwrap().unwrap();
+        }
+        assert_eq!(committer.stats().commits, 3);
+        assert_eq!(committer.stats().groups, 2);
+        let (context, options) = (StorageContext::default(), StorageOptions::default());
+        let stored = engine.scan(&Key::from("own"), &Key::from("owo"), 100, &context, &options).await.unwrap().value;
+        assert_eq!(stored.len(), 3);
+        let shared = engine.get(&Key::from("shared"), &context, &options).await.unwrap().value;
+        assert_eq!(shared, Some(Key::from("v1")));
+    }
+
+    #[tokio::test]
+    async fn test_groups_are_keyed_by_region() {
+        let mut engine = MemoryEngine::new();
+        engine.initialize(&StorageConfig::default()).await.unwrap();
+        let engine: Arc<dyn StorageEngine> = Arc::new(engine);
+        let config = GroupCommitConfig { max_wait: Duration::from_millis(20), max_group_size: 8 };
+        let regions = Arc::new(RwLock::new(RegionMap::new(vec![Key::from("m")])));
+        let committer = Arc::new(GroupCommitter::with_regions(engine.clone(), config, regions));
+
+        // 区域 0 两个事务、区域 1 一个事务、跨区域一个事务，各成一组
+        let write_sets: Vec<Vec<&str>> = vec![vec!["a"], vec!["b"], vec!["x"], vec!["c", "y"]];
+        let commits: Vec<_> = write_sets
+            .into_iter()
+            .map(|keys| {
+                let committer = committer.clone();
+                let mut buffer = WriteBuffer::new();
+                for key in keys {
+                    buffer.put(Key::from(key), Key::from("v"));
+                }
+                tokio::spawn(async move { committer.commit(buffer).await })
+            })
+            .collect();
+        for commit in commits {
+            commit.await.unwrap().unwrap();
+        }
+        assert_eq!(committer.stats().commits, 4);
+        assert_eq!(committer.stats().groups, 3);
+        let (context, options) = (StorageContext::default(), StorageOptions::default());
+        let stored = engine.scan(&Key::from("a"), &Key::from("z"), 100, &context, &options).await.unwrap().value;
+        assert_eq!(stored.len(), 5);
+    }
+}
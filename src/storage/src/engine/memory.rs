@@ -1,23 +1,36 @@
 //! 内存存储引擎实现
 //!
-//! 基于内存的存储引擎，用于测试和开发
+//! 基于内存的存储引擎，用于测试和开发。数据存放在有序并发跳表中：
+//! 读操作无锁，范围扫描按键序直接遍历，事务在跳表快照上读取。
 
 use async_trait::async_trait;
 
 use std::collections::HashMap;
+use std::sync::atomic::{AtomicU64, Ordering};
 use std::sync::Arc;
-use parking_lot::RwLock;
 use tracing::{debug, info};
 use uuid::Uuid;
 
 use crate::common::*;
 use crate::engine::{StorageEngine, StorageTransaction};
+use crate::engine::write_buffer::WriteBuffer;
+use crate::engine::coprocessor::{CoprocessorEvaluator, CoprocessorProgram, CoprocessorRequest, CoprocessorResponse};
+use crate::engine::skiplist::{SkipMap, Snapshot};
+
+/// 操作统计计数器，读路径上只做原子累加
+#[derive(Default)]
+struct StatsCounters {
+    total_operations: AtomicU64,
+    successful_operations: AtomicU64,
+    failed_operations: AtomicU64,
+    total_latency_ms: AtomicU64,
+}
 
 /// 内存存储引擎
 pub struct MemoryEngine {
-    data: Arc<RwLock<HashMap<Key, Value>>>,
+    data: Arc<SkipMap>,
     config: Option<StorageConfig>,
-    stats: Arc<RwLock<StorageStats>>,
+    stats: Arc<StatsCounters>,
     is_initialized: bool,
 }
 
@@ -25,24 +38,27 @@ impl MemoryEngine {
     /// 创建新的内存引擎
     pub fn new() -> Self {
         Self {
-            data: Arc::new(RwLock::new(HashMap::new())),
+            data: Arc::new(SkipMap::new()),
             config: None,
-            stats: Arc::new(RwLock::new(StorageStats::default())),
+            stats: Arc::new(StatsCounters::default()),
             is_initialized: false,
         }
     }
 
+    /// 当前键数
+    pub fn len(&self) -> usize {
+        self.data.len()
+    }
+
     /// 更新统计信息
     fn update_stats(&self, operation_success: bool, latency_ms: u64) {
-        let mut stats = self.stats.write();
-        stats.total_operations += 1;
+        self.stats.total_operations.fetch_add(1, Ordering::Relaxed);
         if operation_success {
-            stats.successful_operations += 1;
+            self.stats.successful_operations.fetch_add(1, Ordering::Relaxed);
         } else {
-            stats.failed_operations += 1;
+            self.stats.failed_operations.fetch_add(1, Ordering::Relaxed);
         }
-        stats.total_latency_ms += latency_ms;
-        stats.avg_latency_ms = stats.total_latency_ms as f64 / stats.total_operations as f64;
+        self.stats.total_latency_ms.fetch_add(latency_ms, Ordering::Relaxed);
     }
 }
 
@@ -78,8 +94,7 @@ impl StorageEngine for MemoryEngine {
         }
 
         info!("Shutting down Memory engine");
-        let mut data = self.data.write();
-        data.clear();
+        self.data.clear();
         self.is_initialized = false;
         info!("Memory engine shut down successfully");
         Ok(())
@@ -90,8 +105,20 @@ impl StorageEngine for MemoryEngine {
     }
 
     async fn get_stats(&self) -> std::result::Result<StorageStats, StorageError> {
-        let stats = self.stats.read();
-        Ok(stats.clone())
+        let total_operations = self.stats.total_operations.load(Ordering::Relaxed);
+        let total_latency_ms = self.stats.total_latency_ms.load(Ordering::Relaxed);
+        Ok(StorageStats {
+            total_operations,
+            successful_operations: self.stats.successful_operations.load(Ordering::Relaxed),
+            failed_operations: self.stats.failed_operations.load(Ordering::Relaxed),
+            total_latency_ms,
+            avg_latency_ms: if total_operations > 0 {
+                total_latency_ms as f64 / total_operations as f64
+            } else {
+                0.0
+            },
+            ..StorageStats::default()
+        })
     }
 
     async fn get(
@@ -102,8 +129,7 @@ impl StorageEngine for MemoryEngine {
     ) -> std::result::Result<StorageResult<Option<Value>>, StorageError> {
         let start_time = std::time::Instant::now();
 
-        let data = self.data.read();
-        let result = data.get(key).cloned();
+        let result = self.data.get(key);
 
         let latency = start_time.elapsed().as_millis() as u64;
         self.update_stats(true, latency);
@@ -120,8 +146,7 @@ impl StorageEngine for MemoryEngine {
     ) -> std::result::Result<StorageResult<()>, StorageError> {
         let start_time = std::time::Instant::now();
 
-        let mut data = self.data.write();
-        data.insert(key.clone(), value.clone());
+        self.data.insert(key.clone(), value.clone());
 
         let latency = start_time.elapsed().as_millis() as u64;
         self.update_stats(true, latency);
@@ -137,8 +162,7 @@ impl StorageEngine for MemoryEngine {
     ) -> std::result::Result<StorageResult<()>, StorageError> {
         let start_time = std::time::Instant::now();
 
-        let mut data = self.data.write();
-        data.remove(key);
+        self.data.remove(key);
 
         let latency = start_time.elapsed().as_millis() as u64;
         self.update_stats(true, latency);
@@ -156,17 +180,8 @@ impl StorageEngine for MemoryEngine {
     ) -> std::result::Result<StorageResult<Vec<KeyValue>>, StorageError> {
         let start_time = std::time::Instant::now();
 
-        let data = self.data.read();
-        let mut result = Vec::new();
-
-        for (key, value) in data.iter() {
-            if key >= start_key && key < end_key {
-                result.push((key.clone(), value.clone()));
-                if result.len() >= limit as usize {
-                    break;
-                }
-            }
-        }
+        // 跳表按键有序，只遍历范围内的前 limit 个键
+        let result = self.data.range(start_key, end_key, limit as usize);
 
         let latency = start_time.elapsed().as_millis() as u64;
         self.update_stats(true, latency);
@@ -174,6 +189,27 @@ impl StorageEngine for MemoryEngine {
         Ok(StorageResult::new(result, latency, EngineType::Memory))
     }
 
+    async fn coprocessor(
+        &self,
+        request: &CoprocessorRequest,
+        _context: &StorageContext,
+        _options: &StorageOptions,
+    ) -> std::result::Result<StorageResult<CoprocessorResponse>, StorageError> {
+        let start_time = std::time::Instant::now();
+        let program = CoprocessorProgram::deserialize(&request.program)?;
+        let mut evaluator = CoprocessorEvaluator::new(program);
+
+        // 直接对跳表中的原始值求值，未通过过滤的行不会被复制
+        self.data
+            .for_each_in_range(&request.start_key, &request.end_key, |key, value| evaluator.feed(key, value))?;
+
+        let latency = start_time.elapsed().as_millis() as u64;
+        self.update_stats(true, latency);
+        let response = evaluator.finish();
+        debug!("Memory coprocessor: scanned {} rows, returned {}", response.scanned_rows, response.rows.len());
+        Ok(StorageResult::new(response, latency, EngineType::Memory))
+    }
+
     async fn batch_get(
         &self,
         keys: &[Key],
@@ -182,11 +218,10 @@ impl StorageEngine for MemoryEngine {
     ) -> std::result::Result<StorageResult<HashMap<Key, Option<Value>>>, StorageError> {
         let start_time = std::time::Instant::now();
 
-        let data = self.data.read();
         let mut result = HashMap::new();
 
         for key in keys {
-            result.insert(key.clone(), data.get(key).cloned());
+            result.insert(key.clone(), self.data.get(key));
         }
 
         let latency = start_time.elapsed().as_millis() as u64;
@@ -203,10 +238,12 @@ impl StorageEngine for MemoryEngine {
     ) -> std::result::Result<StorageResult<()>, StorageError> {
         let start_time = std::time::Instant::now();
 
-        let mut data = self.data.write();
-        for (key, value) in key_values {
-            data.insert(key.clone(), value.clone());
-        }
+        self.data.apply(
+            key_values
+                .iter()
+                .map(|(key, value)| (key.clone(), Some(value.clone())))
+                .collect(),
+        );
 
         let latency = start_time.elapsed().as_millis() as u64;
         self.update_stats(true, latency);
@@ -222,10 +259,7 @@ impl StorageEngine for MemoryEngine {
     ) -> std::result::Result<StorageResult<()>, StorageError> {
         let start_time = std::time::Instant::now();
 
-        let mut data = self.data.write();
-        for key in keys {
-            data.remove(key);
-        }
+        self.data.apply(keys.iter().map(|key| (key.clone(), None)).collect());
 
         let latency = start_time.elapsed().as_millis() as u64;
         self.update_stats(true, latency);
@@ -335,20 +369,23 @@ impl StorageEngine for MemoryEngine {
 }
 
 /// 内存事务实现
+///
+/// 开始时在跳表上建立快照，读操作看到的是快照与本事务未提交修改的合并结果；
+/// 提交时所有修改作为一批原子写入。
 pub struct MemoryTransaction {
-    data: Arc<RwLock<HashMap<Key, Value>>>,
+    snapshot: Snapshot,
     transaction_id: String,
     context: StorageContext,
-    pending_changes: HashMap<Key, Option<Value>>, // None 表示删除
+    pending_changes: WriteBuffer,
 }
 
 impl MemoryTransaction {
-    pub fn new(data: Arc<RwLock<HashMap<Key, Value>>>, context: StorageContext) -> Self {
+    pub fn new(data: Arc<SkipMap>, context: StorageContext) -> Self {
         Self {
-            data,
+            snapshot: data.snapshot(),
             transaction_id: Uuid::new_v4().to_string(),
             context,
-            pending_changes: HashMap::new(),
+            pending_changes: WriteBuffer::new(),
         }
     }
 }
@@ -360,19 +397,14 @@ impl StorageTransaction for MemoryTransaction {
     }
 
     async fn commit(&mut self) -> std::result::Result<(), StorageError> {
-        let mut data = self.data.write();
-        for (key, value_opt) in self.pending_changes.drain() {
-            match value_opt {
-                Some(value) => data.insert(key, value),
-                None => data.remove(&key),
-            };
-        }
+        let changes: Vec<(Key, Option<Value>)> = std::mem::take(&mut self.pending_changes).into_mutations().collect();
+        self.snapshot.map().apply(changes);
         debug!("Memory transaction committed: {}", self.transaction_id);
         Ok(())
     }
 
     async fn rollback(&mut self) -> std::result::Result<(), StorageError> {
-        self.pending_changes.clear();
+        self.pending_changes = WriteBuffer::new();
         debug!("Memory transaction rolled back: {}", self.transaction_id);
         Ok(())
     }
@@ -387,12 +419,11 @@ impl StorageTransaction for MemoryTransaction {
         // 先检查待处理的更改
         if let Some(value_opt) = self.pending_changes.get(key) {
             let latency = start_time.elapsed().as_millis() as u64;
-            return Ok(StorageResult::new(value_opt.clone(), latency, EngineType::Memory));
+            return Ok(StorageResult::new(value_opt.cloned(), latency, EngineType::Memory));
         }
 
-        // 从主数据中获取
-        let data = self.data.read();
-        let result = data.get(key).cloned();
+        // 从事务快照中获取
+        let result = self.snapshot.get(key);
 
         let latency = start_time.elapsed().as_millis() as u64;
         debug!("Memory transaction get: {:?} -> {:?}", key, result.is_some());
@@ -407,7 +438,7 @@ impl StorageTransaction for MemoryTransaction {
     ) -> std::result::Result<StorageResult<()>, StorageError> {
         let start_time = std::time::Instant::now();
 
-        self.pending_changes.insert(key.clone(), Some(value.clone()));
+        self.pending_changes.put(key.clone(), value.clone());
 
         let latency = start_time.elapsed().as_millis() as u64;
         debug!("Memory transaction put: {:?}", key);
@@ -421,7 +452,7 @@ impl StorageTransaction for MemoryTransaction {
     ) -> std::result::Result<StorageResult<()>, StorageError> {
         let start_time = std::time::Instant::now();
 
-        self.pending_changes.insert(key.clone(), None);
+        self.pending_changes.delete(key.clone());
 
         let latency = start_time.elapsed().as_millis() as u64;
         debug!("Memory transaction delete: {:?}", key);
@@ -437,29 +468,78 @@ impl StorageTransaction for MemoryTransaction {
     ) -> std::result::Result<StorageResult<Vec<KeyValue>>, StorageError> {
         let start_time = std::time::Instant::now();
 
-        let data = self.data.read();
-        let mut result = Vec::new();
-
-        for (key, value) in data.iter() {
-            if key >= start_key && key < end_key {
-                // 检查是否有待处理的更改
-                if let Some(pending_value) = self.pending_changes.get(key) {
-                    match pending_value {
-                        Some(value) => result.push((key.clone(), value.clone())),
-                        None => continue, // 跳过已删除的键
-                    }
-                } else {
-                    result.push((key.clone(), value.clone()));
-                }
-
-                if result.len() >= limit as usize {
-                    break;
-                }
-            }
-        }
+        // 快照中多取被本事务删除的键数，保证合并后仍能凑满前 limit 个键
+        let overfetch = self.pending_changes.scan_overfetch(start_key, end_key);
+        let stored = self.snapshot.range(start_key, end_key, (limit as usize).saturating_add(overfetch));
+        let result = self.pending_changes.merge_scan(stored, start_key, end_key, limit as usize);
 
         let latency = start_time.elapsed().as_millis() as u64;
         debug!("Memory transaction scan: found {} pairs", result.len());
         Ok(StorageResult::new(result, latency, EngineType::Memory))
     }
-}
\ No newline at end of file
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::common::Bytes;
+
+    fn key(i: usize) -> Key {
+        Key::from(format!("row:{:04}", i))
+    }
+
+    #[tokio::test]
+    async fn test_scan_limit_returns_first_keys_in_order() {
+        let engine = MemoryEngine::new();
+        let context = StorageContext::default();
+        let options = StorageOptions::default();
+        for i in (0..100).rev() {
+            engine.put(&key(i), &key(i), &context, &options).await.unwrap();
+        }
+
+        let result = engine.scan(&key(10), &key(90), 5, &context, &options).await.unwrap().value;
+        let keys: Vec<Key> = result.into_iter().map(|(k, _)| k).collect();
+        assert_eq!(keys, (10..15).map(key).collect::<Vec<_>>());
+        assert_eq!(engine.get_stats().await.unwrap().total_operations, 101);
+    }
+
+    #[tokio::test]
+    async fn test_scan_shares_stored_buffers() {
+        let engine = MemoryEngine::new();
+        let context = StorageContext::default();
+        let options = StorageOptions::default();
+        let value = Value::from(vec![7u8; 4096]);
+        engine.put(&key(1), &value, &context, &options).await.unwrap();
+
+        // 扫描结果与写入的值共用同一块内存
+        let scanned = engine.scan(&key(0), &key(9), 10, &context, &options).await.unwrap().value;
+        assert_eq!(scanned[0].1.as_ptr(), value.as_ptr());
+        let fetched = engine.get(&key(1), &context, &options).await.unwrap().value.unwrap();
+        assert_eq!(fetched.as_ptr(), value.as_ptr());
+    }
+
+    #[tokio::test]
+    async fn test_transaction_reads_its_snapshot() {
+        let engine = MemoryEngine::new();
+        let context = StorageContext::default();
+        let options = StorageOptions::default();
+        engine.put(&key(1), &Bytes::from_static(b"v1"), &context, &options).await.unwrap();
+        engine.put(&key(2), &Bytes::from_static(b"v2"), &context, &options).await.unwrap();
+
+        let mut txn = engine.begin_transaction(&context, &options).await.unwrap();
+        // 事务开始后的外部写入对事务不可见
+        engine.put(&key(1), &Bytes::from_static(b"outside"), &context, &options).await.unwrap();
+        engine.put(&key(3), &Bytes::from_static(b"v3"), &context, &options).await.unwrap();
+        assert_eq!(txn.get(&key(1), &options).await.unwrap().value, Some(Bytes::from_static(b"v1")));
+
+        txn.delete(&key(2), &options).await.unwrap();
+        txn.put(&key(0), &Bytes::from_static(b"v0"), &options).await.unwrap();
+        let scanned = txn.scan(&key(0), &key(10), 10, &options).await.unwrap().value;
+        assert_eq!(scanned, vec![(key(0), Bytes::from_static(b"v0")), (key(1), Bytes::from_static(b"v1"))]);
+
+        txn.commit().await.unwrap();
+        let after = engine.scan(&key(0), &key(10), 10, &context, &options).await.unwrap().value;
+        let keys: Vec<Key> = after.into_iter().map(|(k, _)| k).collect();
+        assert_eq!(keys, vec![key(0), key(1), key(3)]);
+    }
+}
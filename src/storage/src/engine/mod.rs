@@ -3,17 +3,29 @@
 //! 提供统一的存储引擎接口，支持多种存储引擎的插件化实现
 
 use async_trait::async_trait;
+use parking_lot::RwLock;
 use std::collections::HashMap;
+use std::sync::Arc;
 
+use crate::client::RegionMap;
 use crate::common::{StorageConfig, StorageContext, StorageOptions, StorageResult, StorageStats, StorageOperation, StorageOperationResult, Key, Value, KeyValue, EngineType, StorageError};
 
 pub mod tikv;
 pub mod memory;
 pub mod factory;
+pub mod scan;
+pub mod coprocessor;
+pub mod skiplist;
+pub mod write_buffer;
+pub mod group_commit;
 
 pub use factory::StorageEngineFactory;
+pub use scan::{ScanPage, ScanStream, ScanStreamOptions};
+pub use coprocessor::{CoprocessorProgram, CoprocessorRequest, CoprocessorResponse, CoprocessorEvaluator};
 pub use tikv::TiKVEngine;
 pub use memory::MemoryEngine;
+pub use write_buffer::{CommitMode, CommitPolicy, WriteBuffer};
+pub use group_commit::{commit_buffer, commit_in_transaction, GroupCommitConfig, GroupCommitStats, GroupCommitter};
 
 /// 存储引擎 trait
 ///
@@ -29,6 +41,13 @@ pub trait StorageEngine: Send + Sync {
     /// 引擎版本
     fn version(&self) -> &str;
 
+    /// 引擎的区域划分，与引擎内部共用同一份，刷新后调用方立即看到新的划分
+    ///
+    /// 不分区域的引擎返回 None，整个键空间视为一个区域。
+    fn region_map(&self) -> Option<Arc<RwLock<RegionMap>>> {
+        None
+    }
+
         /// 初始化引擎
     async fn initialize(&mut self, config: &StorageConfig) -> std::result::Result<(), StorageError>;
 
@@ -76,6 +95,59 @@ pub trait StorageEngine: Send + Sync {
         options: &StorageOptions,
     ) -> std::result::Result<StorageResult<Vec<KeyValue>>, StorageError>;
 
+    /// 扫描一页键值对，并给出下一页的续扫键
+    ///
+    /// 默认实现基于 `scan`，要求其结果按键升序；引擎可以覆盖以利用原生游标。
+    async fn scan_page(
+        &self,
+        start_key: &Key,
+        end_key: &Key,
+        page_size: u32,
+        context: &StorageContext,
+        options: &StorageOptions,
+    ) -> std::result::Result<StorageResult<scan::ScanPage>, StorageError> {
+        let result = self.scan(start_key, end_key, page_size, context, options).await?;
+        Ok(StorageResult::new(
+            scan::ScanPage::from_pairs(result.value, page_size),
+            result.latency_ms,
+            result.engine_type,
+        ))
+    }
+
+    /// 在存储端执行协处理器程序 (过滤、投影、部分聚合)，只返回程序的输出
+    ///
+    /// 默认实现逐页扫描并在本地求值，作为不支持原生下推的引擎的兜底路径。
+    async fn coprocessor(
+        &self,
+        request: &CoprocessorRequest,
+        context: &StorageContext,
+        options: &StorageOptions,
+    ) -> std::result::Result<StorageResult<CoprocessorResponse>, StorageError> {
+        let start_time = std::time::Instant::now();
+        let program = CoprocessorProgram::deserialize(&request.program)?;
+        let mut evaluator = CoprocessorEvaluator::new(program);
+
+        let mut next_key = Some(request.start_key.clone());
+        'pages: while let Some(start_key) = next_key.take() {
+            if start_key >= request.end_key {
+                break;
+            }
+            let page = self
+                .scan_page(&start_key, &request.end_key, scan::DEFAULT_SCAN_PAGE_SIZE, context, options)
+                .await?
+                .value;
+            for (key, value) in &page.pairs {
+                if !evaluator.feed(key, value)? {
+                    break 'pages;
+                }
+            }
+            next_key = page.next_key;
+        }
+
+        let latency = start_time.elapsed().as_millis() as u64;
+        Ok(StorageResult::new(evaluator.finish(), latency, self.engine_type()))
+    }
+
         /// 批量获取
     async fn batch_get(
         &self,
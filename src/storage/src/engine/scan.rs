@@ -0,0 +1,277 @@
+//! 分页流式扫描
+//!
+//! 大范围扫描按页读取：每页结束时给出续扫键，下一页从续扫键开始，
+//! 因此任何时刻只有固定数量的页驻留在内存中。后台任务提前读取后续页面，
+//! 页面通过有界通道交给消费者，消费者处理不过来时预读会自然停下 (背压)。
+
+use futures::Stream;
+use std::pin::Pin;
+use std::sync::Arc;
+use std::task::{Context, Poll};
+use tokio::sync::mpsc;
+use tokio::task::JoinHandle;
+
+use super::StorageEngine;
+use crate::common::{Key, KeyValue, StorageContext, StorageError, StorageOptions};
+
+/// 默认每页键值对数
+pub const DEFAULT_SCAN_PAGE_SIZE: u32 = 1024;
+
+/// 默认预读页数
+pub const DEFAULT_SCAN_READAHEAD: usize = 2;
+
+/// 一页扫描结果
+#[derive(Debug, Clone, Default)]
+pub struct ScanPage {
+    /// 本页的键值对，按键升序
+    pub pairs: Vec<KeyValue>,
+    /// 下一页的起始键；为 `None` 表示范围已扫完
+    pub next_key: Option<Key>,
+}
+
+impl ScanPage {
+    /// 由一次 `scan` 的结果构造页面：取满一页才可能还有后续数据
+    pub fn from_pairs(pairs: Vec<KeyValue>, page_size: u32) -> Self {
+        let next_key = if page_size > 0 && pairs.len() >= page_size as usize {
+            pairs.last().map(|(key, _)| successor_key(key))
+        } else {
+            None
+        };
+        Self { pairs, next_key }
+    }
+}
+
+/// 字典序中紧跟在 `key` 之后的键
+pub fn successor_key(key: &[u8]) -> Key {
+    let mut next = Vec::with_capacity(key.len() + 1);
+    next.extend_from_slice(key);
+    next.push(0);
+    next.into()
+}
+
+/// 流式扫描选项
+#[derive(Debug, Clone)]
+pub struct ScanStreamOptions {
+    /// 每页键值对数
+    pub page_size: u32,
+    /// 消费者之前最多预读的页数，至少为 1
+    pub readahead: usize,
+    /// 最多返回的键值对数，`None` 表示扫完整个范围
+    pub limit: Option<u64>,
+}
+
+impl Default for ScanStreamOptions {
+    fn default() -> Self {
+        Self {
+            page_size: DEFAULT_SCAN_PAGE_SIZE,
+            readahead: DEFAULT_SCAN_READAHEAD,
+            limit: None,
+        }
+    }
+}
+
+/// 分页流式扫描迭代器
+///
+/// 丢弃迭代器会取消后台预读任务。
+pub struct ScanStream {
+    receiver: mpsc::Receiver<std::result::Result<Vec<KeyValue>, StorageError>>,
+    prefetch: JoinHandle<()>,
+    pages_read: u64,
+    pairs_read: u64,
+}
+
+impl ScanStream {
+    /// 在 `[start_key, end_key)` 上启动流式扫描
+    pub fn new(
+        engine: Arc<dyn StorageEngine>,
+        start_key: Key,
+        end_key: Key,
+        stream_options: ScanStreamOptions,
+        context: StorageContext,
+        options: StorageOptions,
+    ) -> Self {
+        let page_size = stream_options.page_size.max(1);
+        let (sender, receiver) = mpsc::channel(stream_options.readahead.max(1));
+
+        let prefetch = tokio::spawn(async move {
+            let mut next_key = Some(start_key);
+            let mut remaining = stream_options.limit;
+
+            while let Some(start) = next_key.take() {
+                if start >= end_key || remaining == Some(0) {
+                    break;
+                }
+                let limit = match remaining {
+                    Some(remaining) => remaining.min(page_size as u64) as u32,
+                    None => page_size,
+                };
+
+                let page = match engine.scan_page(&start, &end_key, limit, &context, &options).await {
+                    Ok(result) => result.value,
+                    Err(e) => {
+                        let _ = sender.send(Err(e)).await;
+                        break;
+                    }
+                };
+                if page.pairs.is_empty() {
+                    break;
+                }
+
+                if let Some(remaining) = remaining.as_mut() {
+                    *remaining -= page.pairs.len() as u64;
+                }
+                next_key = page.next_key;
+
+                // 通道满时在此等待，预读深度不会超过 readahead
+                if sender.send(Ok(page.pairs)).await.is_err() {
+                    break;
+                }
+            }
+        });
+
+        Self {
+            receiver,
+            prefetch,
+            pages_read: 0,
+            pairs_read: 0,
+        }
+    }
+
+    /// 读取下一页；范围扫完后返回 `None`
+    pub async fn next_page(&mut self) -> std::result::Result<Option<Vec<KeyValue>>, StorageError> {
+        match self.receiver.recv().await {
+            Some(Ok(pairs)) => {
+                self.pages_read += 1;
+                self.pairs_read += pairs.len() as u64;
+                Ok(Some(pairs))
+            }
+            Some(Err(e)) => Err(e),
+            None => Ok(None),
+        }
+    }
+
+    /// 读取剩余全部页面，仅用于确定结果集较小的场景
+    pub async fn collect_all(mut self) -> std::result::Result<Vec<KeyValue>, StorageError> {
+        let mut pairs = Vec::new();
+        while let Some(page) = self.next_page().await? {
+            pairs.extend(page);
+        }
+        Ok(pairs)
+    }
+
+    /// 已交给消费者的页数
+    pub fn pages_read(&self) -> u64 {
+        self.pages_read
+    }
+
+    /// 已交给消费者的键值对数
+    pub fn pairs_read(&self) -> u64 {
+        self.pairs_read
+    }
+}
+
+impl Stream for ScanStream {
+    type Item = std::result::Result<Vec<KeyValue>, StorageError>;
+
+    fn poll_next(mut self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<Option<Self::Item>> {
+        let this = &mut *self;
+        match this.receiver.poll_recv(cx) {
+            Poll::Ready(Some(Ok(pairs))) => {
+                this.pages_read += 1;
+                this.pairs_read += pairs.len() as u64;
+                Poll::Ready(Some(Ok(pairs)))
+            }
+            other => other,
+        }
+    }
+}
+
+impl Drop for ScanStream {
+    fn drop(&mut self) {
+        self.prefetch.abort();
+    }
+}
+
+impl dyn StorageEngine {
+    /// 在 `[start_key, end_key)` 上启动分页流式扫描
+    pub fn scan_stream(
+        self: Arc<Self>,
+        start_key: Key,
+        end_key: Key,
+        stream_options: ScanStreamOptions,
+        context: StorageContext,
+        options: StorageOptions,
+    ) -> ScanStream {
+        ScanStream::new(self, start_key, end_key, stream_options, context, options)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::common::Bytes;
+    use crate::common::StorageConfig;
+    use crate::engine::MemoryEngine;
+    use futures::StreamExt;
+
+    async fn engine_with_rows(rows: usize) -> Arc<dyn StorageEngine> {
+        let mut engine = MemoryEngine::new();
+        engine.initialize(&StorageConfig::default()).await.unwrap();
+        let context = StorageContext::default();
+        let options = StorageOptions::default();
+        for i in 0..rows {
+            let key = Key::from(format!("k{:05}", i));
+            engine.put(&key, &key, &context, &options).await.unwrap();
+        }
+        Arc::new(engine)
+    }
+
+    fn stream_options(page_size: u32, limit: Option<u64>) -> ScanStreamOptions {
+        ScanStreamOptions { page_size, readahead: 1, limit }
+    }
+
+    #[tokio::test]
+    async fn test_scan_stream_pages_through_range() {
+        let engine = engine_with_rows(2500).await;
+        let mut stream = engine.scan_stream(
+            Bytes::from_static(b"k"),
+            Bytes::from_static(b"l"),
+            stream_options(1000, None),
+            StorageContext::default(),
+            StorageOptions::default(),
+        );
+
+        let mut keys = Vec::new();
+        while let Some(page) = stream.next_page().await.unwrap() {
+            assert!(page.len() <= 1000);
+            keys.extend(page.into_iter().map(|(key, _)| key));
+        }
+        assert_eq!(stream.pages_read(), 3);
+        assert_eq!(keys.len(), 2500);
+        assert!(keys.windows(2).all(|pair| pair[0] < pair[1]));
+    }
+
+    #[tokio::test]
+    async fn test_scan_stream_respects_limit() {
+        let engine = engine_with_rows(100).await;
+        let stream = engine.scan_stream(
+            Bytes::from_static(b"k"),
+            Bytes::from_static(b"l"),
+            stream_options(30, Some(45)),
+            StorageContext::default(),
+            StorageOptions::default(),
+        );
+
+        let pages: Vec<_> = stream.collect().await;
+        let sizes: Vec<usize> = pages.into_iter().map(|page| page.unwrap().len()).collect();
+        assert_eq!(sizes, vec![30, 15]);
+    }
+
+    #[test]
+    fn test_scan_page_continuation_key() {
+        let full = ScanPage::from_pairs(vec![(Bytes::from_static(b"a"), Bytes::new()), (Bytes::from_static(b"b"), Bytes::new())], 2);
+        assert_eq!(full.next_key, Some(Bytes::from_static(b"b\0")));
+        let partial = ScanPage::from_pairs(vec![(Bytes::from_static(b"a"), Bytes::new())], 2);
+        assert_eq!(partial.next_key, None);
+    }
+}
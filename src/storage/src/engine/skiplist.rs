@@ -0,0 +1,673 @@
+//! 有序并发跳表
+//!
+//! `MemoryEngine` 的存储结构。读操作完全无锁：沿原子指针查找，按序号选取可见版本；
+//! 写操作在一个互斥锁内串行，给每个键追加带提交序号的新版本，整批写入共用一个序号，
+//! 提交序号发布之后才对读者可见，因此批量写入是原子的，事务快照也可以直接按序号读取。
+//!
+//! 节点只增不删 (删除写入墓碑版本)，与 LSM 的 memtable 相同。旧版本按水位线回收：
+//! 每个读者在槽位中登记它读取的序号，快照登记在快照表中，水位线是其中最小的序号。
+//! 读者沿版本链只走到第一个不超过自己序号的版本，因此比水位线可见版本更旧的版本
+//! 不会再被任何读者访问，可以立即释放。写入时裁剪被写的键；旧版本累积过多时整表清扫，
+//! 回收不再被改写的键上残留的版本。
+
+use std::collections::BTreeMap;
+use std::ptr;
+use std::sync::atomic::{fence, AtomicPtr, AtomicU64, AtomicUsize, Ordering};
+use std::sync::{Arc, Mutex};
+
+use crate::common::{Key, KeyValue, Value};
+
+/// 最大层数，晋升概率 1/4 时足以容纳千万级键
+const MAX_HEIGHT: usize = 12;
+
+/// 读者序号槽位数，槽位用尽的读者按溢出读者计数
+const READER_SLOTS: usize = 64;
+
+/// 空闲槽位
+const FREE_SLOT: u64 = u64::MAX;
+
+/// 旧版本数超过该值且超过存活键数时，写入后整表清扫一次
+const GC_MIN_STALE_VERSIONS: usize = 1024;
+
+/// 键的一个版本，`value` 为 None 表示删除
+struct Version {
+    seq: u64,
+    value: Option<Value>,
+    next: AtomicPtr<Version>,
+}
+
+struct Node {
+    key: Key,
+    /// 版本链，按序号从新到旧
+    versions: AtomicPtr<Version>,
+    next: Box<[AtomicPtr<Node>]>,
+}
+
+impl Node {
+    fn alloc(key: Key, height: usize, versions: *mut Version) -> *mut Node {
+        let next = (0..height).map(|_| AtomicPtr::new(ptr::null_mut())).collect();
+        Box::into_raw(Box::new(Node { key, versions: AtomicPtr::new(versions), next }))
+    }
+
+    /// 序号不超过 `seq` 的最新版本
+    ///
+    /// # Safety
+    /// 调用方必须持有 `ReadGuard`，或者是持有写锁的写者。
+    unsafe fn visible(&self, seq: u64) -> Option<&Version> {
+        let mut version = self.versions.load(Ordering::Acquire);
+        while !version.is_null() {
+            if (*version).seq <= seq {
+                return Some(&*version);
+            }
+            version = (*version).next.load(Ordering::Acquire);
+        }
+        None
+    }
+}
+
+/// 读取最新提交的读者，存活期间它读取的序号登记在槽位中，写者据此计算水位线
+struct ReadGuard<'a> {
+    map: &'a SkipMap,
+    /// 登记所在槽位，None 表示计入了溢出读者
+    slot: Option<usize>,
+    seq: u64,
+}
+
+impl<'a> ReadGuard<'a> {
+    fn enter(map: &'a SkipMap) -> Self {
+        let start = map.slot_hint.fetch_add(1, Ordering::Relaxed);
+        for i in 0..READER_SLOTS {
+            let index = (start + i) % READER_SLOTS;
+            let slot = &map.reader_seqs[index];
+            let mut seq = map.committed_seq.load(Ordering::SeqCst);
+            if slot.compare_exchange(FREE_SLOT, seq, Ordering::SeqCst, Ordering::Relaxed).is_err() {
+                continue;
+            }
+            // 登记之后提交序号若已前进，写者可能没看到这次登记就按更新的水位线裁剪了，
+            // 改用新的序号重新登记，直到登记后确认序号未变
+            loop {
+                let current = map.committed_seq.load(Ordering::SeqCst);
+                if current == seq {
+                    return Self { map, slot: Some(index), seq };
+                }
+                seq = current;
+                slot.store(seq, Ordering::SeqCst);
+            }
+        }
+        // 槽位用尽：有溢出读者时写者不裁剪
+        map.overflow_readers.fetch_add(1, Ordering::SeqCst);
+        let seq = map.committed_seq.load(Ordering::SeqCst);
+        Self { map, slot: None, seq }
+    }
+}
+
+impl Drop for ReadGuard<'_> {
+    fn drop(&mut self) {
+        match self.slot {
+            Some(index) => self.map.reader_seqs[index].store(FREE_SLOT, Ordering::Release),
+            None => {
+                self.map.overflow_readers.fetch_sub(1, Ordering::Release);
+            }
+        }
+    }
+}
+
+/// 写者私有状态
+struct WriterState {
+    rng: u64,
+}
+
+/// 多版本有序跳表
+pub struct SkipMap {
+    head: *mut Node,
+    height: AtomicUsize,
+    writer: Mutex<WriterState>,
+    /// 已提交的最大序号，读者只看到不超过它的版本
+    committed_seq: AtomicU64,
+    live_keys: AtomicUsize,
+    /// 各读者读取的序号，空闲为 `FREE_SLOT`
+    reader_seqs: Box<[AtomicU64]>,
+    /// 下一个读者开始找空闲槽位的位置
+    slot_hint: AtomicUsize,
+    /// 没有分到槽位的读者数
+    overflow_readers: AtomicUsize,
+    /// 被更新版本覆盖、尚未回收的旧版本数
+    stale_versions: AtomicUsize,
+    /// 活跃快照序号 -> 引用数
+    snapshots: Mutex<BTreeMap<u64, usize>>,
+}
+
+// 节点在 SkipMap 释放前不会被回收，旧版本只在低于水位线后回收 (见读者登记协议)，
+// 跨线程共享裸指针是安全的
+unsafe impl Send for SkipMap {}
+unsafe impl Sync for SkipMap {}
+
+impl SkipMap {
+    pub fn new() -> Self {
+        Self {
+            head: Node::alloc(Key::new(), MAX_HEIGHT, ptr::null_mut()),
+            height: AtomicUsize::new(1),
+            writer: Mutex::new(WriterState { rng: 0x9E37_79B9_7F4A_7C15 }),
+            committed_seq: AtomicU64::new(0),
+            live_keys: AtomicUsize::new(0),
+            reader_seqs: (0..READER_SLOTS).map(|_| AtomicU64::new(FREE_SLOT)).collect(),
+            slot_hint: AtomicUsize::new(0),
+            overflow_readers: AtomicUsize::new(0),
+            stale_versions: AtomicUsize::new(0),
+            snapshots: Mutex::new(BTreeMap::new()),
+        }
+    }
+
+    /// 当前可见的键数
+    pub fn len(&self) -> usize {
+        self.live_keys.load(Ordering::Relaxed)
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// 最新提交序号
+    pub fn committed_seq(&self) -> u64 {
+        self.committed_seq.load(Ordering::Acquire)
+    }
+
+    /// 被覆盖而尚未回收的旧版本数
+    pub fn stale_versions(&self) -> usize {
+        self.stale_versions.load(Ordering::Relaxed)
+    }
+
+    pub fn get(&self, key: &[u8]) -> Option<Value> {
+        let guard = ReadGuard::enter(self);
+        self.get_at(key, guard.seq)
+    }
+
+    /// 扫描 `[start, end)` 内最多 `limit` 个键，按键升序
+    pub fn range(&self, start: &[u8], end: &[u8], limit: usize) -> Vec<KeyValue> {
+        let guard = ReadGuard::enter(self);
+        self.range_at(start, end, limit, guard.seq)
+    }
+
+    /// 按键升序访问 `[start, end)` 内的键值，回调返回 false 时停止
+    ///
+    /// 回调拿到的是跳表内部数据的引用，不产生任何拷贝。
+    pub fn for_each_in_range<E>(
+        &self,
+        start: &[u8],
+        end: &[u8],
+        mut f: impl FnMut(&[u8], &[u8]) -> Result<bool, E>,
+    ) -> Result<(), E> {
+        let guard = ReadGuard::enter(self);
+        self.for_each_at(start, end, guard.seq, |key, value| f(key, value))
+    }
+
+    pub fn insert(&self, key: Key, value: Value) {
+        self.apply(vec![(key, Some(value))]);
+    }
+
+    pub fn remove(&self, key: &[u8]) {
+        self.apply(vec![(Key::copy_from_slice(key), None)]);
+    }
+
+    /// 原子地写入一批修改 (`None` 表示删除)，整批共用一个提交序号
+    pub fn apply(&self, batch: Vec<(Key, Option<Value>)>) {
+        if batch.is_empty() {
+            return;
+        }
+
+        let mut writer = self.writer.lock().unwrap();
+        let committed = self.committed_seq.load(Ordering::Relaxed);
+        let seq = committed + 1;
+
+        let keep_seq = self.watermark(committed);
+        for (key, value) in batch {
+            // Safety: 持有写锁，节点指针在 SkipMap 存活期间有效
+            unsafe { self.write_version(&mut writer, key, value, seq, keep_seq) };
+        }
+        self.committed_seq.store(seq, Ordering::SeqCst);
+
+        let stale = self.stale_versions.load(Ordering::Relaxed);
+        if stale >= GC_MIN_STALE_VERSIONS && stale > self.len() {
+            // Safety: 持有写锁
+            unsafe { self.sweep(seq) };
+        }
+    }
+
+    /// 回收所有键上低于水位线的旧版本，返回释放的版本数
+    pub fn collect_garbage(&self) -> usize {
+        let _writer = self.writer.lock().unwrap();
+        // Safety: 持有写锁
+        unsafe { self.sweep(self.committed_seq.load(Ordering::Relaxed)) }
+    }
+
+    /// 仍可能被读取的最老序号；有溢出读者时无法确定，返回 None
+    ///
+    /// 由持有写锁的写者调用，`committed` 是调用时的提交序号。此后才登记的读者与快照
+    /// 读取的序号都不小于 `committed`。
+    fn watermark(&self, committed: u64) -> Option<u64> {
+        fence(Ordering::SeqCst);
+        if self.overflow_readers.load(Ordering::SeqCst) > 0 {
+            return None;
+        }
+        let readers = self.reader_seqs.iter().map(|slot| slot.load(Ordering::SeqCst)).filter(|&seq| seq != FREE_SLOT);
+        let oldest_snapshot = self.snapshots.lock().unwrap().keys().next().copied();
+        Some(readers.chain(oldest_snapshot).fold(committed, u64::min))
+    }
+
+    /// 整表清扫，调用方必须持有写锁
+    unsafe fn sweep(&self, committed: u64) -> usize {
+        let Some(keep_seq) = self.watermark(committed) else { return 0 };
+        let mut freed = 0;
+        let mut node = (*self.head).next[0].load(Ordering::Acquire);
+        while !node.is_null() {
+            freed += self.prune((*node).versions.load(Ordering::Relaxed), keep_seq);
+            node = (*node).next[0].load(Ordering::Acquire);
+        }
+        freed
+    }
+
+    /// 删除所有键 (写入墓碑)，读者仍可安全访问已有节点
+    pub fn clear(&self) {
+        let mut batch = Vec::new();
+        {
+            let guard = ReadGuard::enter(self);
+            let seq = guard.seq;
+            unsafe {
+                let mut node = (*self.head).next[0].load(Ordering::Acquire);
+                while !node.is_null() {
+                    if let Some(Some(_)) = (*node).visible(seq).map(|version| version.value.as_ref()) {
+                        batch.push(((*node).key.clone(), None));
+                    }
+                    node = (*node).next[0].load(Ordering::Acquire);
+                }
+            }
+        }
+        self.apply(batch);
+    }
+
+    /// 在当前提交序号上建立快照，快照存活期间其可见版本不会被裁剪
+    pub fn snapshot(self: &Arc<Self>) -> Snapshot {
+        let mut snapshots = self.snapshots.lock().unwrap();
+        let seq = self.committed_seq();
+        *snapshots.entry(seq).or_insert(0) += 1;
+        Snapshot { map: self.clone(), seq }
+    }
+
+    fn release_snapshot(&self, seq: u64) {
+        let mut snapshots = self.snapshots.lock().unwrap();
+        if let Some(count) = snapshots.get_mut(&seq) {
+            *count -= 1;
+            if *count == 0 {
+                snapshots.remove(&seq);
+            }
+        }
+    }
+
+    fn get_at(&self, key: &[u8], seq: u64) -> Option<Value> {
+        unsafe {
+            let node = self.find_greater_or_equal(key, None);
+            if node.is_null() || (*node).key != key {
+                return None;
+            }
+            (*node).visible(seq).and_then(|version| version.value.clone())
+        }
+    }
+
+    fn range_at(&self, start: &[u8], end: &[u8], limit: usize, seq: u64) -> Vec<KeyValue> {
+        let mut result = Vec::new();
+        if limit == 0 {
+            return result;
+        }
+        // 键值是共享缓冲，这里只增加引用计数
+        let _ = self.for_each_at::<()>(start, end, seq, |key, value| {
+            result.push((key.clone(), value.clone()));
+            Ok(result.len() < limit)
+        });
+        result
+    }
+
+    fn for_each_at<E>(
+        &self,
+        start: &[u8],
+        end: &[u8],
+        seq: u64,
+        mut f: impl FnMut(&Key, &Value) -> Result<bool, E>,
+    ) -> Result<(), E> {
+        unsafe {
+            let mut node = self.find_greater_or_equal(start, None);
+            while !node.is_null() && (&(*node).key)[..] < *end {
+                if let Some(Some(value)) = (*node).visible(seq).map(|version| version.value.as_ref()) {
+                    if !f(&(*node).key, value)? {
+                        break;
+                    }
+                }
+                node = (*node).next[0].load(Ordering::Acquire);
+            }
+        }
+        Ok(())
+    }
+
+    /// 第一个键不小于 `key` 的节点；`preds` 记录每层的前驱
+    unsafe fn find_greater_or_equal(&self, key: &[u8], mut preds: Option<&mut [*mut Node; MAX_HEIGHT]>) -> *mut Node {
+        let mut node = self.head;
+        let mut level = self.height.load(Ordering::Acquire) - 1;
+        loop {
+            let next = (*node).next[level].load(Ordering::Acquire);
+            if !next.is_null() && (&(*next).key)[..] < *key {
+                node = next;
+                continue;
+            }
+            if let Some(preds) = preds.as_deref_mut() {
+                preds[level] = node;
+            }
+            if level == 0 {
+                return next;
+            }
+            level -= 1;
+        }
+    }
+
+    unsafe fn write_version(&self, writer: &mut WriterState, key: Key, value: Option<Value>, seq: u64, keep_seq: Option<u64>) {
+        let mut preds = [ptr::null_mut(); MAX_HEIGHT];
+        let node = self.find_greater_or_equal(&key, Some(&mut preds));
+        let is_live = value.is_some();
+
+        if !node.is_null() && (*node).key == key {
+            let head = (*node).versions.load(Ordering::Relaxed);
+            let was_live = !head.is_null() && (*head).value.is_some();
+            let version = Box::into_raw(Box::new(Version { seq, value, next: AtomicPtr::new(head) }));
+            (*node).versions.store(version, Ordering::Release);
+            if !head.is_null() {
+                self.stale_versions.fetch_add(1, Ordering::Relaxed);
+            }
+            if let Some(keep_seq) = keep_seq {
+                self.prune(version, keep_seq);
+            }
+            match (was_live, is_live) {
+                (false, true) => {
+                    self.live_keys.fetch_add(1, Ordering::Relaxed);
+                }
+                (true, false) => {
+                    self.live_keys.fetch_sub(1, Ordering::Relaxed);
+                }
+                _ => {}
+            }
+            return;
+        }
+
+        if !is_live {
+            // 删除不存在的键
+            return;
+        }
+
+        let height = Self::random_height(writer);
+        let current = self.height.load(Ordering::Relaxed);
+        if height > current {
+            for pred in preds.iter_mut().take(height).skip(current) {
+                *pred = self.head;
+            }
+            self.height.store(height, Ordering::Release);
+        }
+
+        let version = Box::into_raw(Box::new(Version { seq, value, next: AtomicPtr::new(ptr::null_mut()) }));
+        let node = Node::alloc(key, height, version);
+        // 自底向上链接：读者在任何一层看到新节点时，它在更低层已经可达
+        for (level, &pred) in preds.iter().enumerate().take(height) {
+            (*node).next[level].store((*pred).next[level].load(Ordering::Relaxed), Ordering::Relaxed);
+            (*pred).next[level].store(node, Ordering::Release);
+        }
+        self.live_keys.fetch_add(1, Ordering::Relaxed);
+    }
+
+    /// 保留 `keep_seq` 可见的版本，释放比它更旧的版本，返回释放的版本数
+    ///
+    /// 序号不小于 `keep_seq` 的读者在走到这些版本之前就已停下。
+    unsafe fn prune(&self, head: *mut Version, keep_seq: u64) -> usize {
+        let mut version = head;
+        while !version.is_null() && (*version).seq > keep_seq {
+            version = (*version).next.load(Ordering::Relaxed);
+        }
+        if version.is_null() {
+            return 0;
+        }
+        let mut stale = (*version).next.swap(ptr::null_mut(), Ordering::AcqRel);
+        let mut freed = 0;
+        while !stale.is_null() {
+            let next = (*stale).next.load(Ordering::Relaxed);
+            drop(Box::from_raw(stale));
+            stale = next;
+            freed += 1;
+        }
+        self.stale_versions.fetch_sub(freed, Ordering::Relaxed);
+        freed
+    }
+
+    fn random_height(writer: &mut WriterState) -> usize {
+        // xorshift64*
+        let mut x = writer.rng;
+        x ^= x >> 12;
+        x ^= x << 25;
+        x ^= x >> 27;
+        writer.rng = x;
+        let mut bits = x.wrapping_mul(0x2545_F491_4F6C_DD1D);
+        let mut height = 1;
+        while height < MAX_HEIGHT && bits & 3 == 0 {
+            height += 1;
+            bits >>= 2;
+        }
+        height
+    }
+}
+
+impl Default for SkipMap {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl Drop for SkipMap {
+    fn drop(&mut self) {
+        // 独占访问，不再有读者
+        unsafe {
+            let mut node = self.head;
+            while !node.is_null() {
+                let next = (*node).next[0].load(Ordering::Relaxed);
+                let mut version = (*node).versions.load(Ordering::Relaxed);
+                while !version.is_null() {
+                    let next_version = (*version).next.load(Ordering::Relaxed);
+                    drop(Box::from_raw(version));
+                    version = next_version;
+                }
+                drop(Box::from_raw(node));
+                node = next;
+            }
+        }
+    }
+}
+
+/// 某个提交序号上的一致性快照
+pub struct Snapshot {
+    map: Arc<SkipMap>,
+    seq: u64,
+}
+
+impl Snapshot {
+    pub fn seq(&self) -> u64 {
+        self.seq
+    }
+
+    // 快照序号在快照表中登记，水位线不会越过它，读取无需再登记读者
+
+    pub fn get(&self, key: &[u8]) -> Option<Value> {
+        self.map.get_at(key, self.seq)
+    }
+
+    pub fn range(&self, start: &[u8], end: &[u8], limit: usize) -> Vec<KeyValue> {
+        self.map.range_at(start, end, limit, self.seq)
+    }
+
+    /// 快照所属的跳表，用于在快照之上提交写入
+    pub fn map(&self) -> &Arc<SkipMap> {
+        &self.map
+    }
+}
+
+impl Drop for Snapshot {
+    fn drop(&mut self) {
+        self.map.release_snapshot(self.seq);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::common::Bytes;
+    use std::thread;
+
+    fn key(i: usize) -> Key {
+        Key::from(format!("k{:06}", i))
+    }
+
+    #[test]
+    fn test_ordered_range_and_overwrite() {
+        let map = SkipMap::new();
+        for i in (0..1000).rev() {
+            map.insert(key(i), key(i));
+        }
+        map.insert(key(10), Bytes::from_static(b"updated"));
+        map.remove(&key(11));
+        map.remove(b"missing");
+
+        assert_eq!(map.len(), 999);
+        assert_eq!(map.get(&key(10)), Some(Bytes::from_static(b"updated")));
+        assert_eq!(map.get(&key(11)), None);
+
+        let range = map.range(&key(9), &key(14), 100);
+        let keys: Vec<Key> = range.into_iter().map(|(k, _)| k).collect();
+        assert_eq!(keys, vec![key(9), key(10), key(12), key(13)]);
+
+        // limit 取的是范围内最靠前的键
+        let first = map.range(&key(0), &key(1000), 3);
+        assert_eq!(first.iter().map(|(k, _)| k.clone()).collect::<Vec<_>>(), vec![key(0), key(1), key(2)]);
+    }
+
+    #[test]
+    fn test_snapshot_isolation() {
+        let map = Arc::new(SkipMap::new());
+        map.insert(Bytes::from_static(b"a"), Bytes::from_static(b"1"));
+        let snapshot = map.snapshot();
+
+        map.insert(Bytes::from_static(b"a"), Bytes::from_static(b"2"));
+        map.insert(Bytes::from_static(b"b"), Bytes::from_static(b"3"));
+        map.remove(b"a");
+        map.insert(Bytes::from_static(b"c"), Bytes::from_static(b"4"));
+
+        assert_eq!(snapshot.get(b"a"), Some(Bytes::from_static(b"1")));
+        assert_eq!(snapshot.get(b"b"), None);
+        assert_eq!(snapshot.range(b"", b"z", 10).len(), 1);
+        assert_eq!(map.get(b"a"), None);
+        assert_eq!(map.range(b"", b"z", 10).len(), 2);
+
+        drop(snapshot);
+        map.insert(Bytes::from_static(b"a"), Bytes::from_static(b"5"));
+        assert_eq!(map.get(b"a"), Some(Bytes::from_static(b"5")));
+    }
+
+    #[test]
+    fn test_garbage_collection_follows_snapshot_watermark() {
+        let map = Arc::new(SkipMap::new());
+        for i in 0..10 {
+            map.insert(key(i), Bytes::from_static(b"v1"));
+        }
+        let snapshot = map.snapshot();
+        for i in 0..10 {
+            map.insert(key(i), Bytes::from_static(b"v2"));
+        }
+
+        // 快照仍需要 v1，清扫不能回收
+        assert_eq!(map.stale_versions(), 10);
+        assert_eq!(map.collect_garbage(), 0);
+        assert_eq!(snapshot.get(&key(3)), Some(Bytes::from_static(b"v1")));
+
+        // 快照释放后水位线前进，没有再被改写的键上的旧版本也被回收
+        drop(snapshot);
+        assert_eq!(map.collect_garbage(), 10);
+        assert_eq!(map.stale_versions(), 0);
+        assert_eq!(map.get(&key(3)), Some(Bytes::from_static(b"v2")));
+    }
+
+    #[test]
+    fn test_versions_are_reclaimed_under_concurrent_readers() {
+        let map = Arc::new(SkipMap::new());
+        let stop = Arc::new(std::sync::atomic::AtomicBool::new(false));
+        let readers: Vec<_> = (0..4)
+            .map(|_| {
+                let (map, stop) = (map.clone(), stop.clone());
+                thread::spawn(move || {
+                    while !stop.load(Ordering::Relaxed) {
+                        assert!(map.range(&key(0), &key(100), usize::MAX).len() <= 100);
+                    }
+                })
+            })
+            .collect();
+
+        // 读者一直在读，旧版本仍随写入回收，不会无限累积
+        for round in 0..200 {
+            for i in 0..100 {
+                map.insert(key(i), Key::from(format!("{}", round)));
+            }
+        }
+        assert!(map.stale_versions() < 5000, "{} stale versions retained", map.stale_versions());
+        stop.store(true, Ordering::Relaxed);
+        for reader in readers {
+            reader.join().unwrap();
+        }
+        map.collect_garbage();
+        assert_eq!(map.stale_versions(), 0);
+        assert_eq!(map.get(&key(7)), Some(Key::from("199")));
+    }
+
+    #[test]
+    fn test_batch_is_atomic() {
+        let map = Arc::new(SkipMap::new());
+        map.apply(vec![(Bytes::from_static(b"x"), Some(Bytes::from_static(b"1"))), (Bytes::from_static(b"y"), Some(Bytes::from_static(b"1")))]);
+        let before = map.snapshot();
+        map.apply(vec![(Bytes::from_static(b"x"), Some(Bytes::from_static(b"2"))), (Bytes::from_static(b"y"), None)]);
+        assert_eq!(before.range(b"", b"z", 10).len(), 2);
+        assert_eq!(map.range(b"", b"z", 10), vec![(Bytes::from_static(b"x"), Bytes::from_static(b"2"))]);
+    }
+
+    #[test]
+    fn test_concurrent_readers_and_writer() {
+        let map = Arc::new(SkipMap::new());
+        let writer = {
+            let map = map.clone();
+            thread::spawn(move || {
+                for i in 0..2000 {
+                    map.insert(key(i), key(i));
+                    if i % 3 == 0 {
+                        map.insert(key(i / 2), Bytes::from_static(b"rewritten"));
+                    }
+                }
+            })
+        };
+        let readers: Vec<_> = (0..4)
+            .map(|_| {
+                let map = map.clone();
+                thread::spawn(move || {
+                    for _ in 0..200 {
+                        let range = map.range(&key(0), &key(2000), usize::MAX);
+                        assert!(range.windows(2).all(|pair| pair[0].0 < pair[1].0));
+                    }
+                })
+            })
+            .collect();
+
+        writer.join().unwrap();
+        for reader in readers {
+            reader.join().unwrap();
+        }
+        assert_eq!(map.len(), 2000);
+        assert_eq!(map.range(&key(0), &key(2000), usize::MAX).len(), 2000);
+    }
+}
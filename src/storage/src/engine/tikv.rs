@@ -5,23 +5,47 @@
 use async_trait::async_trait;
 use std::collections::HashMap;
 use std::sync::Arc;
+use std::time::Duration;
 use parking_lot::RwLock;
-use tikv_client::{RawClient, Value as TiKVValue, TransactionClient};
+use serde::Deserialize;
+use tokio::io::{AsyncReadExt, AsyncWriteExt};
+use tokio::net::TcpStream;
+use tikv_client::{KvPair, RawClient, Value as TiKVValue, TransactionClient, TransactionOptions};
 use tracing::{debug, error, info, warn};
 use uuid::Uuid;
 
+use crate::client::RegionMap;
 use crate::common::*;
 use crate::engine::{StorageEngine, StorageTransaction};
+use crate::engine::write_buffer::{CommitMode, CommitPolicy, WriteBuffer};
+
+/// 请求方向：tikv-client 只接受独占的 `Vec<u8>`，发送前复制一次
+fn to_tikv_key(key: &Key) -> tikv_client::Key {
+    tikv_client::Key::from(key.to_vec())
+}
+
+/// 响应方向：直接接管客户端返回的缓冲，之后的克隆与切片都只增加引用计数
+fn from_tikv_pair(pair: KvPair) -> KeyValue {
+    let (key, value): (tikv_client::Key, TiKVValue) = pair.into();
+    (Key::from(Vec::<u8>::from(key)), Value::from(value))
+}
 
 /// TiKV 存储引擎
 pub struct TiKVEngine {
     raw_client: Option<RawClient>,
-    transaction_client: Option<TransactionClient>,
+    transaction_client: Option<Arc<TransactionClient>>,
     config: Option<StorageConfig>,
     stats: Arc<RwLock<StorageStats>>,
+    /// 区域划分，提交时据此判断写集合能否走一阶段提交；初始化时从 PD 加载并定期刷新
+    regions: Arc<RwLock<RegionMap>>,
+    region_refresher: Option<tokio::task::JoinHandle<()>>,
+    commit_policy: CommitPolicy,
     is_initialized: bool,
 }
 
+/// 区域划分的默认刷新间隔，`engine_specific["region_refresh_interval_ms"]` 可以覆盖，0 表示不刷新
+const DEFAULT_REGION_REFRESH_INTERVAL_MS: u64 = 60_000;
+
 impl TiKVEngine {
     /// 创建新的 TiKV 引擎
     pub fn new() -> Self {
@@ -30,10 +54,33 @@ impl TiKVEngine {
             transaction_client: None,
             config: None,
             stats: Arc::new(RwLock::new(StorageStats::default())),
+            regions: Arc::new(RwLock::new(RegionMap::default())),
+            region_refresher: None,
+            commit_policy: CommitPolicy::default(),
             is_initialized: false,
         }
     }
 
+    /// 从 PD 重新加载区域划分
+    pub async fn refresh_region_map(&self) -> Result<()> {
+        let config = self
+            .config
+            .as_ref()
+            .ok_or_else(|| Error::Configuration("TiKV engine has no PD endpoints configured".to_string()))?;
+        let regions = load_region_map(&pd_endpoints(config), Duration::from_millis(config.timeout_ms)).await?;
+        self.set_region_map(regions);
+        Ok(())
+    }
+
+    /// 更新区域划分，之后提交的事务按新的划分选择提交方式
+    pub fn set_region_map(&self, regions: RegionMap) {
+        *self.regions.write() = regions;
+    }
+
+    pub fn set_commit_policy(&mut self, policy: CommitPolicy) {
+        self.commit_policy = policy;
+    }
+
     /// 获取原始客户端
     fn get_raw_client(&self) -> Result<&RawClient> {
         self.raw_client
@@ -42,7 +89,7 @@ impl TiKVEngine {
     }
 
     /// 获取事务客户端
-    fn get_transaction_client(&self) -> Result<&TransactionClient> {
+    fn get_transaction_client(&self) -> Result<&Arc<TransactionClient>> {
         self.transaction_client
             .as_ref()
             .ok_or_else(|| StorageError::Connection("TiKV transaction client not initialized".to_string()))
@@ -76,6 +123,10 @@ impl StorageEngine for TiKVEngine {
         "1.0.0"
     }
 
+    fn region_map(&self) -> Option<Arc<RwLock<RegionMap>>> {
+        Some(self.regions.clone())
+    }
+
     async fn initialize(&mut self, config: &StorageConfig) -> Result<()> {
         if self.is_initialized {
             return Ok(());
@@ -84,10 +135,7 @@ impl StorageEngine for TiKVEngine {
         info!("Initializing TiKV engine with config: {:?}", config);
 
         // 解析连接字符串
-        let pd_endpoints = config.connection_string
-            .split(',')
-            .map(|s| s.trim().to_string())
-            .collect::<Vec<_>>();
+        let pd_endpoints = pd_endpoints(config);
 
         if pd_endpoints.is_empty() {
             return Err(Error::Configuration("No PD endpoints provided".to_string()));
@@ -100,14 +148,40 @@ impl StorageEngine for TiKVEngine {
         };
 
         // 创建事务客户端
-        let transaction_client = match TransactionClient::new(pd_endpoints).await {
+        let transaction_client = match TransactionClient::new(pd_endpoints.clone()).await {
             Ok(client) => client,
             Err(e) => return Err(Error::Connection(format!("Failed to create TiKV transaction client: {e}"))),
         };
 
         self.raw_client = Some(raw_client);
-        self.transaction_client = Some(transaction_client);
+        self.transaction_client = Some(Arc::new(transaction_client));
         self.config = Some(config.clone());
+
+        // 区域划分只影响提交方式的选择，加载失败时按一个区域处理，等下次刷新
+        let timeout = Duration::from_millis(config.timeout_ms);
+        match load_region_map(&pd_endpoints, timeout).await {
+            Ok(regions) => self.set_region_map(regions),
+            Err(e) => warn!("Failed to load TiKV region map from PD: {}", e),
+        }
+        let interval_ms = config
+            .engine_specific
+            .get("region_refresh_interval_ms")
+            .and_then(|value| value.as_u64())
+            .unwrap_or(DEFAULT_REGION_REFRESH_INTERVAL_MS);
+        if interval_ms > 0 {
+            let regions = self.regions.clone();
+            self.region_refresher = Some(tokio::spawn(async move {
+                let mut ticker = tokio::time::interval(Duration::from_millis(interval_ms));
+                ticker.tick().await;
+                loop {
+                    ticker.tick().await;
+                    match load_region_map(&pd_endpoints, timeout).await {
+                        Ok(loaded) => *regions.write() = loaded,
+                        Err(e) => warn!("Failed to refresh TiKV region map from PD: {}", e),
+                    }
+                }
+            }));
+        }
         self.is_initialized = true;
 
         info!("TiKV engine initialized successfully");
@@ -122,6 +196,9 @@ impl StorageEngine for TiKVEngine {
         info!("Shutting down TiKV engine");
 
         // 关闭客户端
+        if let Some(refresher) = self.region_refresher.take() {
+            refresher.abort();
+        }
         self.raw_client = None;
         self.transaction_client = None;
         self.is_initialized = false;
@@ -136,7 +213,7 @@ impl StorageEngine for TiKVEngine {
         }
 
         // 简单的健康检查：尝试获取一个不存在的键
-        let test_key = b"health_check_test_key".to_vec();
+        let test_key = Key::from_static(b"health_check_test_key");
         match self.get(&test_key, &StorageContext::default(), &StorageOptions::default()).await {
             Ok(_) => Ok(true),
             Err(e) => {
@@ -160,14 +237,14 @@ impl StorageEngine for TiKVEngine {
         let start_time = std::time::Instant::now();
 
         let raw_client = self.get_raw_client()?;
-        let tikv_key = tikv_client::Key::from(key.clone());
+        let tikv_key = to_tikv_key(key);
 
         match raw_client.get(tikv_key).await {
             Ok(Some(value)) => {
                 let latency = start_time.elapsed().as_millis() as u64;
                 self.update_stats(true, latency);
                 debug!("TiKV get success: {:?}", key);
-                Ok(StorageResult::new(Some(value), latency, EngineType::TiKV))
+                Ok(StorageResult::new(Some(Value::from(value)), latency, EngineType::TiKV))
             }
             Ok(None) => {
                 let latency = start_time.elapsed().as_millis() as u64;
@@ -194,8 +271,8 @@ impl StorageEngine for TiKVEngine {
         let start_time = std::time::Instant::now();
 
         let raw_client = self.get_raw_client()?;
-        let tikv_key = tikv_client::Key::from(key.clone());
-        let tikv_value = tikv_client::Value::from(value.as_slice());
+        let tikv_key = to_tikv_key(key);
+        let tikv_value = TiKVValue::from(value.as_ref());
 
         match raw_client.put(tikv_key, tikv_value).await {
             Ok(_) => {
@@ -222,7 +299,7 @@ impl StorageEngine for TiKVEngine {
         let start_time = std::time::Instant::now();
 
         let raw_client = self.get_raw_client()?;
-        let tikv_key = tikv_client::Key::from(key.clone());
+        let tikv_key = to_tikv_key(key);
 
         match raw_client.delete(tikv_key).await {
             Ok(_) => {
@@ -251,14 +328,14 @@ impl StorageEngine for TiKVEngine {
         let start_time = std::time::Instant::now();
 
         let raw_client = self.get_raw_client()?;
-        let tikv_start_key = tikv_client::Key::from(start_key.clone());
-        let tikv_end_key = tikv_client::Key::from(end_key.clone());
+        let tikv_start_key = to_tikv_key(start_key);
+        let tikv_end_key = to_tikv_key(end_key);
 
         match raw_client.scan(tikv_start_key..tikv_end_key, limit).await {
             Ok(pairs) => {
                 let result: Vec<KeyValue> = pairs
                     .into_iter()
-                    .map(|pair| (pair.key().clone().into(), pair.value().clone()))
+                    .map(from_tikv_pair)
                     .collect();
 
                 let latency = start_time.elapsed().as_millis() as u64;
@@ -284,13 +361,14 @@ impl StorageEngine for TiKVEngine {
         let start_time = std::time::Instant::now();
 
         let raw_client = self.get_raw_client()?;
-        let tikv_keys: Vec<tikv_client::Key> = keys.iter().map(|k| tikv_client::Key::from(k.clone())).collect();
+        let tikv_keys: Vec<tikv_client::Key> = keys.iter().map(|k| to_tikv_key(k)).collect();
 
         match raw_client.batch_get(tikv_keys).await {
             Ok(pairs) => {
                 let mut result = HashMap::new();
                 for pair in pairs {
-                    result.insert(pair.key().clone().into(), Some(pair.value().clone()));
+                    let (key, value) = from_tikv_pair(pair);
+                    result.insert(key, Some(value));
                 }
 
                 // 对于没有返回的键，设置为 None
@@ -323,7 +401,7 @@ impl StorageEngine for TiKVEngine {
         let raw_client = self.get_raw_client()?;
         let tikv_pairs: Vec<(tikv_client::Key, TiKVValue)> = key_values
             .iter()
-            .map(|(k, v)| (tikv_client::Key::from(k.clone()), TiKVValue::from(v.as_slice())))
+            .map(|(k, v)| (to_tikv_key(k), TiKVValue::from(v.as_ref())))
             .collect();
 
         match raw_client.batch_put(tikv_pairs).await {
@@ -351,7 +429,7 @@ impl StorageEngine for TiKVEngine {
         let start_time = std::time::Instant::now();
 
         let raw_client = self.get_raw_client()?;
-        let tikv_keys: Vec<tikv_client::Key> = keys.iter().map(|k| tikv_client::Key::from(k.clone())).collect();
+        let tikv_keys: Vec<tikv_client::Key> = keys.iter().map(|k| to_tikv_key(k)).collect();
 
         match raw_client.batch_delete(tikv_keys).await {
             Ok(_) => {
@@ -375,9 +453,12 @@ impl StorageEngine for TiKVEngine {
         options: &StorageOptions,
     ) -> Result<Box<dyn StorageTransaction>> {
         let transaction_client = self.get_transaction_client()?;
-
-        // 暂时返回错误，因为 TiKV 客户端的事务 API 可能需要不同的调用方式
-        Err(Error::TransactionConflict("TiKV transaction API not implemented yet".to_string()))
+        Ok(Box::new(TiKVTransaction::new(
+            transaction_client.clone(),
+            self.regions.clone(),
+            self.commit_policy.clone(),
+            context.clone(),
+        )))
     }
 
     async fn execute_plan(
@@ -469,21 +550,175 @@ impl StorageEngine for TiKVEngine {
     }
 }
 
+/// 连接字符串中逗号分隔的 PD 地址
+fn pd_endpoints(config: &StorageConfig) -> Vec<String> {
+    config
+        .connection_string
+        .split(',')
+        .map(|s| s.trim().to_string())
+        .filter(|s| !s.is_empty())
+        .collect()
+}
+
+#[derive(Deserialize)]
+struct PdRegions {
+    #[serde(default)]
+    regions: Vec<PdRegion>,
+}
+
+#[derive(Deserialize)]
+struct PdRegion {
+    /// 十六进制的区域起始键，第一个区域为空
+    #[serde(default)]
+    start_key: String,
+}
+
+/// 依次尝试各个 PD 地址，从 HTTP 接口 `/pd/api/v1/regions` 读取区域划分
+///
+/// tikv-client 不公开区域路由信息，区域边界只能从 PD 读取。
+async fn load_region_map(endpoints: &[String], timeout: Duration) -> Result<RegionMap> {
+    let mut last_error = Error::Configuration("No PD endpoints provided".to_string());
+    for endpoint in endpoints {
+        match tokio::time::timeout(timeout, fetch_pd_regions(endpoint)).await {
+            Ok(Ok(body)) => return parse_region_map(&body),
+            Ok(Err(e)) => last_error = e,
+            Err(_) => last_error = Error::Timeout(format!("PD {endpoint} did not answer the region request")),
+        }
+    }
+    Err(last_error)
+}
+
+async fn fetch_pd_regions(endpoint: &str) -> Result<Vec<u8>> {
+    let address = endpoint.trim_start_matches("http://").trim_end_matches('/');
+    let connection_error = |e: std::io::Error| Error::Connection(format!("PD {address}: {e}"));
+    let mut stream = TcpStream::connect(address).await.map_err(connection_error)?;
+    let request = format!("GET /pd/api/v1/regions HTTP/1.0\r\nHost: {address}\r\nAccept: application/json\r\n\r\n");
+    stream.write_all(request.as_bytes()).await.map_err(connection_error)?;
+    let mut response = Vec::new();
+    stream.read_to_end(&mut response).await.map_err(connection_error)?;
+
+    let header_end = response
+        .windows(4)
+        .position(|window| window == b"\r\n\r\n")
+        .ok_or_else(|| Error::Deserialization(format!("PD {address} sent a malformed HTTP response")))?;
+    let status_line = String::from_utf8_lossy(&response[..header_end]).lines().next().unwrap_or_default().to_string();
+    if status_line.split_whitespace().nth(1) != Some("200") {
+        return Err(Error::Connection(format!("PD {address} answered {status_line}")));
+    }
+    Ok(response.split_off(header_end + 4))
+}
+
+/// 按各区域的起始键构造区域划分
+fn parse_region_map(body: &[u8]) -> Result<RegionMap> {
+    let response: PdRegions =
+        serde_json::from_slice(body).map_err(|e| Error::Deserialization(format!("PD region list: {e}")))?;
+    let mut split_keys = Vec::with_capacity(response.regions.len());
+    for region in response.regions {
+        if region.start_key.is_empty() {
+            continue;
+        }
+        let encoded = decode_hex(&region.start_key)
+            .ok_or_else(|| Error::Deserialization(format!("PD region start key {} is not hex", region.start_key)))?;
+        // 事务模式下区域边界是 memcomparable 编码的键；无法解码的按原始键处理
+        let key = decode_memcomparable(&encoded).unwrap_or(encoded);
+        split_keys.push(Key::from(key));
+    }
+    Ok(RegionMap::new(split_keys))
+}
+
+fn decode_hex(hex: &str) -> Option<Vec<u8>> {
+    if hex.len() % 2 != 0 {
+        return None;
+    }
+    (0..hex.len()).step_by(2).map(|i| u8::from_str_radix(hex.get(i..i + 2)?, 16).ok()).collect()
+}
+
+/// 解码 memcomparable 字节串：每 8 字节一组，组后一个标记字节为 255 减去本组的填充字节数
+fn decode_memcomparable(encoded: &[u8]) -> Option<Vec<u8>> {
+    const GROUP: usize = 8;
+    if encoded.is_empty() || encoded.len() % (GROUP + 1) != 0 {
+        return None;
+    }
+    let groups = encoded.len() / (GROUP + 1);
+    let mut key = Vec::with_capacity(groups * GROUP);
+    for (i, chunk) in encoded.chunks(GROUP + 1).enumerate() {
+        let padding = (u8::MAX - chunk[GROUP]) as usize;
+        let last = i + 1 == groups;
+        // 只有最后一组带填充，填充字节为 0
+        if padding > GROUP || (padding > 0) != last || chunk[GROUP - padding..GROUP].iter().any(|&b| b != 0) {
+            return None;
+        }
+        key.extend_from_slice(&chunk[..GROUP - padding]);
+    }
+    Some(key)
+}
+
+/// 按提交方式构造 TiKV 事务选项；写集合未知时 (第一次读时开始) 按策略同时打开两种快速路径，
+/// 由客户端在提交时根据实际涉及的区域决定
+fn transaction_options(policy: &CommitPolicy, mode: Option<CommitMode>) -> TransactionOptions {
+    let options = TransactionOptions::new_optimistic();
+    match mode {
+        Some(CommitMode::OnePhase) => options.try_one_pc(),
+        Some(CommitMode::AsyncCommit) => options.use_async_commit(),
+        Some(CommitMode::TwoPhase) => options,
+        None => {
+            let options = if policy.enable_one_pc { options.try_one_pc() } else { options };
+            if policy.enable_async_commit { options.use_async_commit() } else { options }
+        }
+    }
+}
+
 /// TiKV 事务实现
+///
+/// 写入先留在本地写缓冲，提交时一次性发出，读自己写过的键不访问 TiKV。TiKV 事务在第一次
+/// 读或提交时才开始：只写不读的事务在开始时已知写集合，落在一个区域内时直接按一阶段提交开始。
 pub struct TiKVTransaction {
-    transaction: tikv_client::Transaction,
+    client: Arc<TransactionClient>,
+    transaction: Option<tikv_client::Transaction>,
+    buffer: WriteBuffer,
+    regions: Arc<RwLock<RegionMap>>,
+    policy: CommitPolicy,
+    commit_mode: Option<CommitMode>,
     transaction_id: String,
     context: StorageContext,
 }
 
 impl TiKVTransaction {
-    pub fn new(transaction: tikv_client::Transaction, context: StorageContext) -> Self {
+    pub fn new(
+        client: Arc<TransactionClient>,
+        regions: Arc<RwLock<RegionMap>>,
+        policy: CommitPolicy,
+        context: StorageContext,
+    ) -> Self {
         Self {
-            transaction,
+            client,
+            transaction: None,
+            buffer: WriteBuffer::new(),
+            regions,
+            policy,
+            commit_mode: None,
             transaction_id: Uuid::new_v4().to_string(),
             context,
         }
     }
+
+    /// 提交时选定的提交方式，提交前为 None
+    pub fn commit_mode(&self) -> Option<CommitMode> {
+        self.commit_mode
+    }
+
+    async fn begin(&mut self, mode: Option<CommitMode>) -> Result<&mut tikv_client::Transaction> {
+        if self.transaction.is_none() {
+            let options = transaction_options(&self.policy, mode);
+            let transaction = self
+                .client
+                .begin_with_options(options)
+                .await
+                .map_err(|e| Error::Connection(format!("Failed to begin TiKV transaction: {e}")))?;
+            self.transaction = Some(transaction);
+        }
+        Ok(self.transaction.as_mut().expect("transaction begun above"))
+    }
 }
 
 #[async_trait]
@@ -493,20 +728,49 @@ impl StorageTransaction for TiKVTransaction {
     }
 
     async fn commit(&mut self) -> Result<()> {
-        match self.transaction.commit().await {
+        let buffer = std::mem::take(&mut self.buffer);
+        if buffer.is_empty() && self.transaction.is_none() {
+            return Ok(());
+        }
+
+        let mode = self.policy.choose(&self.regions.read(), &buffer);
+        self.commit_mode = Some(mode);
+        let transaction_id = self.transaction_id.clone();
+        let transaction = self.begin(Some(mode)).await?;
+        for (key, value) in buffer.into_mutations() {
+            let written = match value {
+                Some(value) => transaction.put(to_tikv_key(&key), TiKVValue::from(value.as_ref())).await,
+                None => transaction.delete(to_tikv_key(&key)).await,
+            };
+            if let Err(e) = written {
+                error!("TiKV transaction write failed: {}, error: {}", transaction_id, e);
+                let _ = transaction.rollback().await;
+                self.transaction = None;
+                return Err(Error::Engine(format!("Transaction write failed: {e}")));
+            }
+        }
+
+        let committed = transaction.commit().await;
+        self.transaction = None;
+        match committed {
             Ok(_) => {
-                debug!("TiKV transaction committed: {}", self.transaction_id);
+                debug!("TiKV transaction committed: {} ({:?})", transaction_id, mode);
                 Ok(())
             }
             Err(e) => {
-                error!("TiKV transaction commit failed: {}, error: {}", self.transaction_id, e);
+                error!("TiKV transaction commit failed: {}, error: {}", transaction_id, e);
                 Err(Error::TransactionConflict(format!("Commit failed: {e}")))
             }
         }
     }
 
     async fn rollback(&mut self) -> Result<()> {
-        match self.transaction.rollback().await {
+        self.buffer = WriteBuffer::new();
+        let Some(mut transaction) = self.transaction.take() else {
+            debug!("TiKV transaction rolled back: {}", self.transaction_id);
+            return Ok(());
+        };
+        match transaction.rollback().await {
             Ok(_) => {
                 debug!("TiKV transaction rolled back: {}", self.transaction_id);
                 Ok(())
@@ -524,13 +788,19 @@ impl StorageTransaction for TiKVTransaction {
         options: &StorageOptions,
     ) -> Result<StorageResult<Option<Value>>> {
         let start_time = std::time::Instant::now();
-        let tikv_key = tikv_client::Key::from(key.clone());
 
-        match self.transaction.get(tikv_key).await {
+        // 本事务写过的键直接从写缓冲返回
+        if let Some(buffered) = self.buffer.get(key) {
+            let latency = start_time.elapsed().as_millis() as u64;
+            return Ok(StorageResult::new(buffered.cloned(), latency, EngineType::TiKV));
+        }
+
+        let tikv_key = to_tikv_key(key);
+        match self.begin(None).await?.get(tikv_key).await {
             Ok(Some(value)) => {
                 let latency = start_time.elapsed().as_millis() as u64;
                 debug!("TiKV transaction get success: {:?}", key);
-                Ok(StorageResult::new(Some(value), latency, EngineType::TiKV))
+                Ok(StorageResult::new(Some(Value::from(value)), latency, EngineType::TiKV))
             }
             Ok(None) => {
                 let latency = start_time.elapsed().as_millis() as u64;
@@ -538,7 +808,6 @@ impl StorageTransaction for TiKVTransaction {
                 Ok(StorageResult::new(None, latency, EngineType::TiKV))
             }
             Err(e) => {
-                let latency = start_time.elapsed().as_millis() as u64;
                 error!("TiKV transaction get failed: {:?}, error: {}", key, e);
                 Err(Error::Engine(format!("Transaction get failed: {e}")))
             }
@@ -552,21 +821,12 @@ impl StorageTransaction for TiKVTransaction {
         options: &StorageOptions,
     ) -> Result<StorageResult<()>> {
         let start_time = std::time::Instant::now();
-        let tikv_key = tikv_client::Key::from(key.clone());
-        let tikv_value = TiKVValue::from(value.as_slice());
 
-        match self.transaction.put(tikv_key, tikv_value).await {
-            Ok(_) => {
-                let latency = start_time.elapsed().as_millis() as u64;
-                debug!("TiKV transaction put success: {:?}", key);
-                Ok(StorageResult::new((), latency, EngineType::TiKV))
-            }
-            Err(e) => {
-                let latency = start_time.elapsed().as_millis() as u64;
-                error!("TiKV transaction put failed: {:?}, error: {}", key, e);
-                Err(Error::Engine(format!("Transaction put failed: {e}")))
-            }
-        }
+        self.buffer.put(key.clone(), value.clone());
+
+        let latency = start_time.elapsed().as_millis() as u64;
+        debug!("TiKV transaction put buffered: {:?}", key);
+        Ok(StorageResult::new((), latency, EngineType::TiKV))
     }
 
     async fn delete(
@@ -575,20 +835,12 @@ impl StorageTransaction for TiKVTransaction {
         options: &StorageOptions,
     ) -> Result<StorageResult<()>> {
         let start_time = std::time::Instant::now();
-        let tikv_key = tikv_client::Key::from(key.clone());
 
-        match self.transaction.delete(tikv_key).await {
-            Ok(_) => {
-                let latency = start_time.elapsed().as_millis() as u64;
-                debug!("TiKV transaction delete success: {:?}", key);
-                Ok(StorageResult::new((), latency, EngineType::TiKV))
-            }
-            Err(e) => {
-                let latency = start_time.elapsed().as_millis() as u64;
-                error!("TiKV transaction delete failed: {:?}, error: {}", key, e);
-                Err(Error::Engine(format!("Transaction delete failed: {e}")))
-            }
-        }
+        self.buffer.delete(key.clone());
+
+        let latency = start_time.elapsed().as_millis() as u64;
+        debug!("TiKV transaction delete buffered: {:?}", key);
+        Ok(StorageResult::new((), latency, EngineType::TiKV))
     }
 
     async fn scan(
@@ -599,22 +851,25 @@ impl StorageTransaction for TiKVTransaction {
         options: &StorageOptions,
     ) -> Result<StorageResult<Vec<KeyValue>>> {
         let start_time = std::time::Instant::now();
-        let tikv_start_key = tikv_client::Key::from(start_key.clone());
-        let tikv_end_key = tikv_client::Key::from(end_key.clone());
+        let tikv_start_key = to_tikv_key(start_key);
+        let tikv_end_key = to_tikv_key(end_key);
 
-        match self.transaction.scan(tikv_start_key..tikv_end_key, limit).await {
+        // 多取被本事务删除的键数，与写缓冲合并后仍能凑满前 limit 个键
+        let overfetch = self.buffer.scan_overfetch(start_key, end_key) as u32;
+        let fetch_limit = limit.saturating_add(overfetch);
+        match self.begin(None).await?.scan(tikv_start_key..tikv_end_key, fetch_limit).await {
             Ok(pairs) => {
-                let result: Vec<KeyValue> = pairs
+                let stored: Vec<KeyValue> = pairs
                     .into_iter()
-                    .map(|pair| (pair.key().clone().into(), pair.value().clone()))
+                    .map(from_tikv_pair)
                     .collect();
+                let result = self.buffer.merge_scan(stored, start_key, end_key, limit as usize);
 
                 let latency = start_time.elapsed().as_millis() as u64;
                 debug!("TiKV transaction scan success, found {} pairs", result.len());
                 Ok(StorageResult::new(result, latency, EngineType::TiKV))
             }
             Err(e) => {
-                let latency = start_time.elapsed().as_millis() as u64;
                 error!("TiKV transaction scan failed: {}", e);
                 Err(Error::Engine(format!("Transaction scan failed: {e}")))
             }
@@ -622,3 +877,68 @@ impl StorageTransaction for TiKVTransaction {
     }
 }
 
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use tokio::net::TcpListener;
+
+    /// 只应答一次区域列表请求的 PD
+    async fn serve_regions_once(body: &'static str) -> String {
+        let listener = TcpListener::bind("127.0.0.1:0").await.unwrap();
+        let address = listener.local_addr().unwrap().to_string();
+        tokio::spawn(async move {
+            let (mut stream, _) = listener.accept().await.unwrap();
+            let mut request = Vec::new();
+            let mut buf = [0u8; 1024];
+            while !request.ends_with(b"\r\n\r\n") {
+                let n = stream.read(&mut buf).await.unwrap();
+                if n == 0 {
+                    break;
+                }
+                request.extend_from_slice(&buf[..n]);
+            }
+            assert!(request.starts_with(b"GET /pd/api/v1/regions "));
+            let response = format!("HTTP/1.0 200 OK\r\nContent-Length: {}\r\n\r\n{}", body.len(), body);
+            stream.write_all(response.as_bytes()).await.unwrap();
+        });
+        address
+    }
+
+    #[tokio::test]
+    async fn test_region_map_from_pd_selects_async_commit_for_multi_region_writes() {
+        // 两个区域，以 memcomparable 编码的 "m" 为界
+        let address = serve_regions_once(
+            r#"{"count":2,"regions":[{"id":2,"start_key":"","end_key":"6D00000000000000F8"},{"id":3,"start_key":"6D00000000000000F8","end_key":""}]}"#,
+        )
+        .await;
+        let mut engine = TiKVEngine::new();
+        engine.config = Some(StorageConfig { connection_string: format!("http://{address}"), ..StorageConfig::default() });
+        engine.refresh_region_map().await.unwrap();
+
+        // 事务与组提交器拿到的是同一份划分
+        let regions = engine.region_map().unwrap();
+        assert!(Arc::ptr_eq(&regions, &engine.regions));
+        assert_eq!(regions.read().region_count(), 2);
+        let mut buffer = WriteBuffer::new();
+        buffer.put(Key::from("a"), Value::from("1"));
+        assert_eq!(engine.commit_policy.choose(&regions.read(), &buffer), CommitMode::OnePhase);
+        buffer.put(Key::from("x"), Value::from("1"));
+        assert_eq!(engine.commit_policy.choose(&regions.read(), &buffer), CommitMode::AsyncCommit);
+    }
+
+    #[test]
+    fn test_decode_region_keys() {
+        assert_eq!(decode_memcomparable(&decode_hex("6D00000000000000F8").unwrap()), Some(b"m".to_vec()));
+        let full_group = decode_hex("6162636465666768FF0000000000000000F7").unwrap();
+        assert_eq!(decode_memcomparable(&full_group), Some(b"abcdefgh".to_vec()));
+        assert_eq!(decode_memcomparable(&[0x6D, 0x00]), None);
+        assert_eq!(decode_hex("6D0"), None);
+
+        // 无法解码的边界按原始键处理
+        let regions = parse_region_map(br#"{"regions":[{"start_key":""},{"start_key":"6D6E"}]}"#).unwrap();
+        assert_eq!(regions.region_of(b"mn"), 1);
+        assert_eq!(regions.region_of(b"m"), 0);
+        assert!(parse_region_map(b"not json").is_err());
+    }
+}
@@ -0,0 +1,184 @@
+//! 事务写缓冲与提交方式选择
+//!
+//! 事务内的写入先留在客户端的有序缓冲里，读自己写过的键直接从缓冲返回，提交时
+//! 一次性发出。提交前已知写集合落在几个区域：只涉及一个区域时走一阶段提交 (1PC)，
+//! 涉及多个区域且键数不大时走异步提交 (async commit)，否则退回普通两阶段提交。
+
+use std::collections::BTreeMap;
+
+use crate::client::RegionMap;
+use crate::common::{Key, KeyValue, Value};
+
+/// 事务写缓冲：键 -> 新值，None 表示删除；同一键的多次写入只保留最后一次
+#[derive(Debug, Clone, Default)]
+pub struct WriteBuffer {
+    mutations: BTreeMap<Key, Option<Value>>,
+}
+
+impl WriteBuffer {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    pub fn put(&mut self, key: Key, value: Value) {
+        self.mutations.insert(key, Some(value));
+    }
+
+    pub fn delete(&mut self, key: Key) {
+        self.mutations.insert(key, None);
+    }
+
+    /// 缓冲中的写入：`Some(None)` 表示本事务删除了该键，`None` 表示没有写过
+    pub fn get(&self, key: &Key) -> Option<Option<&Value>> {
+        self.mutations.get(key).map(Option::as_ref)
+    }
+
+    pub fn len(&self) -> usize {
+        self.mutations.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.mutations.is_empty()
+    }
+
+    pub fn keys(&self) -> impl Iterator<Item = &Key> {
+        self.mutations.keys()
+    }
+
+    /// 追加另一个缓冲的写入，同一键以 `other` 为准
+    pub fn extend(&mut self, other: WriteBuffer) {
+        self.mutations.extend(other.mutations);
+    }
+
+    pub fn into_mutations(self) -> impl Iterator<Item = (Key, Option<Value>)> {
+        self.mutations.into_iter()
+    }
+
+    /// 扫描 `[start_key, end_key)` 时需要从存储层多取的键数：本事务删除的键会从结果中去掉
+    pub fn scan_overfetch(&self, start_key: &Key, end_key: &Key) -> usize {
+        self.range(start_key, end_key).filter(|(_, value)| value.is_none()).count()
+    }
+
+    /// 把存储层的扫描结果与缓冲合并，返回前 `limit` 个键
+    ///
+    /// `stored` 需按 `limit + scan_overfetch()` 取得，合并后才能凑满前 limit 个键。
+    pub fn merge_scan(&self, stored: Vec<KeyValue>, start_key: &Key, end_key: &Key, limit: usize) -> Vec<KeyValue> {
+        let mut merged: BTreeMap<Key, Value> = stored.into_iter().collect();
+        for (key, value) in self.range(start_key, end_key) {
+            match value {
+                Some(value) => {
+                    merged.insert(key.clone(), value.clone());
+                }
+                None => {
+                    merged.remove(key);
+                }
+            }
+        }
+        merged.into_iter().take(limit).collect()
+    }
+
+    fn range<'a>(&'a self, start_key: &Key, end_key: &Key) -> impl Iterator<Item = (&'a Key, &'a Option<Value>)> {
+        let range = (start_key < end_key).then(|| self.mutations.range(start_key.clone()..end_key.clone()));
+        range.into_iter().flatten()
+    }
+}
+
+/// 提交方式
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum CommitMode {
+    /// 写集合在一个区域内，预写即提交，一次往返
+    OnePhase,
+    /// 预写完成即返回，提交在后台完成
+    AsyncCommit,
+    /// 普通两阶段提交
+    TwoPhase,
+}
+
+/// 提交方式选择策略
+#[derive(Debug, Clone)]
+pub struct CommitPolicy {
+    pub enable_one_pc: bool,
+    pub enable_async_commit: bool,
+    /// 异步提交要在主锁上记录全部次级键，键数超过该值时退回两阶段提交
+    pub async_commit_max_keys: usize,
+}
+
+impl Default for CommitPolicy {
+    fn default() -> Self {
+        Self {
+            enable_one_pc: true,
+            enable_async_commit: true,
+            async_commit_max_keys: 256,
+        }
+    }
+}
+
+impl CommitPolicy {
+    /// 按写集合涉及的区域数选择提交方式
+    pub fn choose(&self, regions: &RegionMap, buffer: &WriteBuffer) -> CommitMode {
+        let mut keys = buffer.keys();
+        let single_region = match keys.next() {
+            Some(first) => {
+                let region = regions.region_of(first);
+                keys.all(|key| regions.region_of(key) == region)
+            }
+            None => true,
+        };
+        if single_region && self.enable_one_pc {
+            CommitMode::OnePhase
+        } else if self.enable_async_commit && buffer.len() <= self.async_commit_max_keys {
+            CommitMode::AsyncCommit
+        } else {
+            CommitMode::TwoPhase
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn key(s: &str) -> Key {
+        Key::from(s.to_string())
+    }
+
+    #[test]
+    fn test_buffer_reads_own_writes_and_merges_scans() {
+        let mut buffer = WriteBuffer::new();
+        buffer.put(key("a"), key("1"));
+        buffer.put(key("b"), key("2"));
+        buffer.delete(key("b"));
+        buffer.put(key("d"), key("4"));
+        assert_eq!(buffer.get(&key("a")), Some(Some(&key("1"))));
+        assert_eq!(buffer.get(&key("b")), Some(None));
+        assert_eq!(buffer.get(&key("c")), None);
+
+        let stored = vec![(key("b"), key("old")), (key("c"), key("3")), (key("e"), key("5"))];
+        assert_eq!(buffer.scan_overfetch(&key("a"), &key("z")), 1);
+        assert_eq!(
+            buffer.merge_scan(stored, &key("a"), &key("z"), 3),
+            vec![(key("a"), key("1")), (key("c"), key("3")), (key("d"), key("4"))]
+        );
+        assert!(buffer.merge_scan(Vec::new(), &key("z"), &key("a"), 10).is_empty());
+    }
+
+    #[test]
+    fn test_commit_mode_follows_regions() {
+        let regions = RegionMap::new(vec![key("m")]);
+        let policy = CommitPolicy::default();
+        let mut buffer = WriteBuffer::new();
+        assert_eq!(policy.choose(&regions, &buffer), CommitMode::OnePhase);
+
+        buffer.put(key("a"), key("1"));
+        buffer.put(key("b"), key("1"));
+        assert_eq!(policy.choose(&regions, &buffer), CommitMode::OnePhase);
+
+        buffer.put(key("x"), key("1"));
+        assert_eq!(policy.choose(&regions, &buffer), CommitMode::AsyncCommit);
+
+        let small = CommitPolicy { async_commit_max_keys: 2, ..CommitPolicy::default() };
+        assert_eq!(small.choose(&regions, &buffer), CommitMode::TwoPhase);
+        let no_one_pc = CommitPolicy { enable_one_pc: false, ..CommitPolicy::default() };
+        assert_eq!(no_one_pc.choose(&RegionMap::default(), &buffer), CommitMode::AsyncCommit);
+    }
+}
@@ -0,0 +1,448 @@
+//! 位图二级索引的维护与查询
+//!
+//! 每张表的行按写入顺序分配 `u32` 行号，行键与行号之间保存双向映射 (`_k`/`_h`)，
+//! 另有一个存活行号集合 (`_s`) 作为 NOT 的全集。索引的每个取值对应一个 Roaring
+//! 位图 (`_b`)，取值是列的文本形式，NULL 不入索引。
+//!
+//! 位图按行号的高 16 位分块存储，每块一个键，块的大小有上限 (一个 Roaring 容器)。
+//! 维护是读-改-写：写行时只读出行号所在的块，更新后在一个批量写里写回，代价与表的
+//! 大小无关；查询按前缀读出全部块后合并。重建在内存中建好整张表的位图后一次写入。
+//! 存储层不提供跨键原子性，同一张表上的并发写入由调用方串行化。
+
+use std::collections::HashMap;
+
+use super::roaring::RoaringBitmap;
+use crate::codec::{self, DatumRef, RowView};
+use crate::common::{Key, StorageContext, StorageError, StorageOptions, Value};
+use crate::engine::StorageEngine;
+
+/// 一个位图索引：索引名与被索引的列 ID
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct BitmapIndex {
+    pub name: String,
+    pub column_id: u32,
+}
+
+impl BitmapIndex {
+    pub fn new(name: impl Into<String>, column_id: u32) -> Self {
+        Self { name: name.into(), column_id }
+    }
+}
+
+/// 索引中的取值：列的文本形式，NULL 返回 None
+pub fn index_value(datum: DatumRef<'_>) -> Option<Vec<u8>> {
+    match datum {
+        DatumRef::Null => None,
+        DatumRef::Bytes(bytes) => Some(bytes.to_vec()),
+        other => Some(other.to_text().into_bytes()),
+    }
+}
+
+/// 一次维护中读出并修改过的位图块 (按块键)，最后一次性写回
+#[derive(Default)]
+struct PendingBitmaps {
+    bitmaps: HashMap<Key, RoaringBitmap>,
+}
+
+impl PendingBitmaps {
+    /// 位图 `bitmap_key` 中 `row_id` 所在的块
+    async fn get_mut(&mut self, engine: &dyn StorageEngine, bitmap_key: &[u8], row_id: u32) -> Result<&mut RoaringBitmap, StorageError> {
+        let key = codec::bitmap_chunk_key(bitmap_key, RoaringBitmap::chunk_of(row_id));
+        if !self.bitmaps.contains_key(&key) {
+            let bitmap = load_bitmap(engine, &key).await?;
+            self.bitmaps.insert(key.clone(), bitmap);
+        }
+        Ok(self.bitmaps.get_mut(&key).expect("bitmap loaded above"))
+    }
+
+    /// 写回：非空的块批量写入，变空的块删除
+    async fn flush(self, engine: &dyn StorageEngine, mut puts: Vec<(Key, Value)>, mut deletes: Vec<Key>) -> Result<(), StorageError> {
+        let (context, options) = (StorageContext::default(), StorageOptions::default());
+        for (key, bitmap) in self.bitmaps {
+            if bitmap.is_empty() {
+                deletes.push(key);
+            } else {
+                puts.push((key, Value::from(bitmap.to_bytes())));
+            }
+        }
+        if !puts.is_empty() {
+            engine.batch_put(&puts, &context, &options).await?;
+        }
+        if !deletes.is_empty() {
+            engine.batch_delete(&deletes, &context, &options).await?;
+        }
+        Ok(())
+    }
+}
+
+async fn load_bitmap(engine: &dyn StorageEngine, key: &Key) -> Result<RoaringBitmap, StorageError> {
+    let stored = engine.get(key, &StorageContext::default(), &StorageOptions::default()).await?;
+    match stored.value {
+        Some(bytes) => RoaringBitmap::from_bytes(&bytes),
+        None => Ok(RoaringBitmap::new()),
+    }
+}
+
+/// 读出分块位图的全部块并合并
+async fn load_chunked_bitmap(engine: &dyn StorageEngine, bitmap_key: &Key) -> Result<RoaringBitmap, StorageError> {
+    let (context, options) = (StorageContext::default(), StorageOptions::default());
+    let end = codec::prefix_end(bitmap_key);
+    let mut next_key = Some(bitmap_key.clone());
+    let mut chunks = Vec::new();
+    while let Some(start_key) = next_key.take() {
+        let page = engine
+            .scan_page(&start_key, &end, crate::engine::scan::DEFAULT_SCAN_PAGE_SIZE, &context, &options)
+            .await?
+            .value;
+        for (_, bytes) in &page.pairs {
+            chunks.push(RoaringBitmap::from_bytes(bytes)?);
+        }
+        next_key = page.next_key;
+    }
+    Ok(RoaringBitmap::from_chunks(chunks))
+}
+
+/// 整个位图按块写出的键值对
+fn chunk_puts(bitmap_key: Key, bitmap: RoaringBitmap) -> impl Iterator<Item = (Key, Value)> {
+    bitmap
+        .into_chunks()
+        .map(move |(chunk, part)| (codec::bitmap_chunk_key(&bitmap_key, chunk), Value::from(part.to_bytes())))
+}
+
+fn decode_row_id(bytes: &[u8]) -> Result<u32, StorageError> {
+    bytes
+        .try_into()
+        .map(u32::from_be_bytes)
+        .map_err(|_| StorageError::Deserialization(format!("invalid row id of {} bytes", bytes.len())))
+}
+
+/// 一张表上的全部位图索引
+#[derive(Debug, Clone)]
+pub struct BitmapIndexSet {
+    table: String,
+    indexes: Vec<BitmapIndex>,
+}
+
+impl BitmapIndexSet {
+    pub fn new(table: impl Into<String>, indexes: Vec<BitmapIndex>) -> Self {
+        Self { table: table.into(), indexes }
+    }
+
+    pub fn table(&self) -> &str {
+        &self.table
+    }
+
+    pub fn indexes(&self) -> &[BitmapIndex] {
+        &self.indexes
+    }
+
+    fn value_keys(&self, row: Option<&[u8]>) -> Result<Vec<Option<Key>>, StorageError> {
+        let view = row.map(RowView::new).transpose()?;
+        self.indexes
+            .iter()
+            .map(|index| {
+                let Some(view) = &view else { return Ok(None) };
+                let value = index_value(view.get_ref(index.column_id)?);
+                Ok(value.map(|value| codec::bitmap_index_key(&self.table, &index.name, &value)))
+            })
+            .collect()
+    }
+
+    /// 下一个待分配的行号
+    async fn next_row_id(&self, engine: &dyn StorageEngine) -> Result<u32, StorageError> {
+        let counter_key = codec::row_id_counter_key(&self.table);
+        let counter = engine.get(&counter_key, &StorageContext::default(), &StorageOptions::default()).await?;
+        Ok(counter.value.map(|bytes| decode_row_id(&bytes)).transpose()?.unwrap_or(0))
+    }
+
+    /// 取出 `next` 作为新行号并前移计数
+    fn allocate_row_id(&self, next: &mut u32) -> Result<u32, StorageError> {
+        let row_id = *next;
+        *next = row_id
+            .checked_add(1)
+            .ok_or_else(|| StorageError::Internal(format!("row ids of table {} exhausted", self.table)))?;
+        Ok(row_id)
+    }
+
+    /// 新行号的双向映射
+    fn row_id_puts(&self, record_key: &Key, row_id: u32) -> [(Key, Value); 2] {
+        [
+            (codec::row_id_key(&self.table, record_key), Value::from(row_id.to_be_bytes().to_vec())),
+            (codec::row_handle_key(&self.table, row_id), record_key.clone()),
+        ]
+    }
+
+    async fn row_id_of(&self, engine: &dyn StorageEngine, record_key: &[u8]) -> Result<Option<u32>, StorageError> {
+        let key = codec::row_id_key(&self.table, record_key);
+        let stored = engine.get(&key, &StorageContext::default(), &StorageOptions::default()).await?;
+        stored.value.map(|bytes| decode_row_id(&bytes)).transpose()
+    }
+
+    /// 行写入后维护索引；`old_value` 是被覆盖的旧行。返回该行的行号
+    pub async fn on_insert(
+        &self,
+        engine: &dyn StorageEngine,
+        record_key: &Key,
+        old_value: Option<&[u8]>,
+        new_value: &[u8],
+    ) -> Result<u32, StorageError> {
+        let mut pending = PendingBitmaps::default();
+        let mut puts = Vec::new();
+
+        let row_id = match self.row_id_of(engine, record_key).await? {
+            Some(row_id) => row_id,
+            None => {
+                let counter_key = codec::row_id_counter_key(&self.table);
+                let mut next = self.next_row_id(engine).await?;
+                let row_id = self.allocate_row_id(&mut next)?;
+                puts.push((counter_key, Value::from(next.to_be_bytes().to_vec())));
+                puts.extend(self.row_id_puts(record_key, row_id));
+                pending.get_mut(engine, &codec::row_set_key(&self.table), row_id).await?.insert(row_id);
+                row_id
+            }
+        };
+
+        let old_keys = self.value_keys(old_value)?;
+        let new_keys = self.value_keys(Some(new_value))?;
+        for (old_key, new_key) in old_keys.into_iter().zip(new_keys) {
+            if old_key == new_key {
+                continue;
+            }
+            if let Some(key) = old_key {
+                pending.get_mut(engine, &key, row_id).await?.remove(row_id);
+            }
+            if let Some(key) = new_key {
+                pending.get_mut(engine, &key, row_id).await?.insert(row_id);
+            }
+        }
+
+        pending.flush(engine, puts, Vec::new()).await?;
+        Ok(row_id)
+    }
+
+    /// 行删除后维护索引并释放行号；该行不在索引中时返回 None
+    pub async fn on_delete(
+        &self,
+        engine: &dyn StorageEngine,
+        record_key: &Key,
+        old_value: &[u8],
+    ) -> Result<Option<u32>, StorageError> {
+        let Some(row_id) = self.row_id_of(engine, record_key).await? else { return Ok(None) };
+        let mut pending = PendingBitmaps::default();
+        for key in self.value_keys(Some(old_value))?.into_iter().flatten() {
+            pending.get_mut(engine, &key, row_id).await?.remove(row_id);
+        }
+        pending.get_mut(engine, &codec::row_set_key(&self.table), row_id).await?.remove(row_id);
+
+        let deletes = vec![codec::row_id_key(&self.table, record_key), codec::row_handle_key(&self.table, row_id)];
+        pending.flush(engine, Vec::new(), deletes).await?;
+        Ok(Some(row_id))
+    }
+
+    /// 索引列取值为 `values` 中任意一个的行 (取值的位图求并)
+    pub async fn lookup(&self, engine: &dyn StorageEngine, index: &str, values: &[&[u8]]) -> Result<RoaringBitmap, StorageError> {
+        if !self.indexes.iter().any(|i| i.name == index) {
+            return Err(StorageError::Internal(format!("no bitmap index {} on table {}", index, self.table)));
+        }
+        let mut result = RoaringBitmap::new();
+        for value in values {
+            let bitmap = load_chunked_bitmap(engine, &codec::bitmap_index_key(&self.table, index, value)).await?;
+            result = if result.is_empty() { bitmap } else { result.or(&bitmap) };
+        }
+        Ok(result)
+    }
+
+    /// 表上全部存活的行号
+    pub async fn live_rows(&self, engine: &dyn StorageEngine) -> Result<RoaringBitmap, StorageError> {
+        load_chunked_bitmap(engine, &codec::row_set_key(&self.table)).await
+    }
+
+    /// 把行号解析为行键，按行号升序；已删除的行号被跳过
+    pub async fn record_keys(&self, engine: &dyn StorageEngine, rows: &RoaringBitmap) -> Result<Vec<Key>, StorageError> {
+        let handles: Vec<Key> = rows.iter().map(|row_id| codec::row_handle_key(&self.table, row_id)).collect();
+        if handles.is_empty() {
+            return Ok(Vec::new());
+        }
+        let stored = engine.batch_get(&handles, &StorageContext::default(), &StorageOptions::default()).await?.value;
+        Ok(handles.iter().filter_map(|handle| stored.get(handle).cloned().flatten()).collect())
+    }
+
+    /// 扫描表中已有的行建立索引，返回处理的行数
+    ///
+    /// 已有行号的行 (表上已有其他索引) 沿用原行号，其余行按扫描顺序分配新行号；
+    /// 行号映射随每页写入，位图在内存中对整张表建好后按块一次写入。
+    pub async fn rebuild(&self, engine: &dyn StorageEngine) -> Result<u64, StorageError> {
+        let (context, options) = (StorageContext::default(), StorageOptions::default());
+        let counter_key = codec::row_id_counter_key(&self.table);
+        let mut next = self.next_row_id(engine).await?;
+        let mut live = RoaringBitmap::new();
+        let mut bitmaps: HashMap<Key, RoaringBitmap> = HashMap::new();
+
+        let start = codec::record_prefix(&self.table);
+        let end = codec::prefix_end(&start);
+        let mut next_key = Some(start);
+        let mut rows = 0;
+        while let Some(start_key) = next_key.take() {
+            let page = engine
+                .scan_page(&start_key, &end, crate::engine::scan::DEFAULT_SCAN_PAGE_SIZE, &context, &options)
+                .await?
+                .value;
+            let id_keys: Vec<Key> = page.pairs.iter().map(|(key, _)| codec::row_id_key(&self.table, key)).collect();
+            let stored_ids = if id_keys.is_empty() {
+                HashMap::new()
+            } else {
+                engine.batch_get(&id_keys, &context, &options).await?.value
+            };
+
+            let mut puts = Vec::new();
+            for ((key, value), id_key) in page.pairs.iter().zip(&id_keys) {
+                let row_id = match stored_ids.get(id_key).cloned().flatten() {
+                    Some(bytes) => decode_row_id(&bytes)?,
+                    None => {
+                        let row_id = self.allocate_row_id(&mut next)?;
+                        puts.extend(self.row_id_puts(key, row_id));
+                        row_id
+                    }
+                };
+                live.insert(row_id);
+                for bitmap_key in self.value_keys(Some(value))?.into_iter().flatten() {
+                    bitmaps.entry(bitmap_key).or_default().insert(row_id);
+                }
+                rows += 1;
+            }
+            if !puts.is_empty() {
+                puts.push((counter_key.clone(), Value::from(next.to_be_bytes().to_vec())));
+                engine.batch_put(&puts, &context, &options).await?;
+            }
+            next_key = page.next_key;
+        }
+
+        bitmaps.insert(codec::row_set_key(&self.table), live);
+        let puts: Vec<(Key, Value)> = bitmaps.into_iter().flat_map(|(key, bitmap)| chunk_puts(key, bitmap)).collect();
+        if !puts.is_empty() {
+            engine.batch_put(&puts, &context, &options).await?;
+        }
+        Ok(rows)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::codec::Datum;
+    use crate::common::StorageConfig;
+    use crate::engine::MemoryEngine;
+
+    async fn engine() -> MemoryEngine {
+        let mut engine = MemoryEngine::new();
+        engine.initialize(&StorageConfig::default()).await.unwrap();
+        engine
+    }
+
+    /// 列 1 为状态，列 2 为地区
+    fn row(status: &str, region: Option<&str>) -> Vec<u8> {
+        let region = region.map(|r| Datum::Bytes(r.as_bytes().to_vec())).unwrap_or(Datum::Null);
+        codec::encode_row_with_ids(&[(1, Datum::Bytes(status.as_bytes().to_vec())), (2, region)])
+    }
+
+    fn indexes() -> BitmapIndexSet {
+        BitmapIndexSet::new("orders", vec![BitmapIndex::new("by_status", 1), BitmapIndex::new("by_region", 2)])
+    }
+
+    async fn put(engine: &MemoryEngine, set: &BitmapIndexSet, id: i64, value: Vec<u8>) -> u32 {
+        let key = codec::record_key("orders", &[Datum::Int(id)]);
+        let old = engine.get(&key, &StorageContext::default(), &StorageOptions::default()).await.unwrap().value;
+        engine.put(&key, &Value::from(value.clone()), &StorageContext::default(), &StorageOptions::default()).await.unwrap();
+        set.on_insert(engine, &key, old.as_deref(), &value).await.unwrap()
+    }
+
+    async fn stored(engine: &MemoryEngine, key: &Key) -> Option<Value> {
+        engine.get(key, &StorageContext::default(), &StorageOptions::default()).await.unwrap().value
+    }
+
+    #[tokio::test]
+    async fn test_maintained_on_insert_update_and_delete() {
+        let engine = engine().await;
+        let set = indexes();
+        assert_eq!(put(&engine, &set, 10, row("active", Some("eu"))).await, 0);
+        assert_eq!(put(&engine, &set, 11, row("active", Some("us"))).await, 1);
+        assert_eq!(put(&engine, &set, 12, row("closed", None)).await, 2);
+
+        let ids = |bitmap: RoaringBitmap| bitmap.iter().collect::<Vec<_>>();
+        assert_eq!(ids(set.lookup(&engine, "by_status", &[b"active"]).await.unwrap()), vec![0, 1]);
+        assert_eq!(ids(set.lookup(&engine, "by_region", &[b"eu", b"us"]).await.unwrap()), vec![0, 1]);
+
+        // 覆盖写保留行号，只移动变化的列
+        assert_eq!(put(&engine, &set, 11, row("closed", Some("us"))).await, 1);
+        assert_eq!(ids(set.lookup(&engine, "by_status", &[b"active"]).await.unwrap()), vec![0]);
+        assert_eq!(ids(set.lookup(&engine, "by_status", &[b"closed"]).await.unwrap()), vec![1, 2]);
+
+        let key = codec::record_key("orders", &[Datum::Int(10)]);
+        assert_eq!(set.on_delete(&engine, &key, &row("active", Some("eu"))).await.unwrap(), Some(0));
+        assert!(set.lookup(&engine, "by_status", &[b"active"]).await.unwrap().is_empty());
+        assert_eq!(ids(set.live_rows(&engine).await.unwrap()), vec![1, 2]);
+        assert_eq!(set.on_delete(&engine, &key, &row("active", Some("eu"))).await.unwrap(), None);
+
+        // 被删除行的位图块也被删除，而不是留下空位图
+        let stale = codec::bitmap_chunk_key(&codec::bitmap_index_key("orders", "by_status", b"active"), 0);
+        assert!(engine.get(&stale, &StorageContext::default(), &StorageOptions::default()).await.unwrap().value.is_none());
+        assert!(set.lookup(&engine, "by_tenant", &[b"x"]).await.is_err());
+    }
+
+    #[tokio::test]
+    async fn test_bitmaps_are_stored_per_chunk() {
+        let (context, options) = (StorageContext::default(), StorageOptions::default());
+        let engine = engine().await;
+        let set = indexes();
+        // 从块边界前一个行号开始分配，两行落在相邻的两个块里
+        let counter = Value::from(65_535u32.to_be_bytes().to_vec());
+        engine.put(&codec::row_id_counter_key("orders"), &counter, &context, &options).await.unwrap();
+        assert_eq!(put(&engine, &set, 1, row("active", Some("eu"))).await, 65_535);
+        assert_eq!(put(&engine, &set, 2, row("active", Some("us"))).await, 65_536);
+
+        let active = codec::bitmap_index_key("orders", "by_status", b"active");
+        let chunk = |n| codec::bitmap_chunk_key(&active, n);
+        let first = stored(&engine, &chunk(0)).await.unwrap();
+        assert!(stored(&engine, &chunk(1)).await.is_some());
+        let ids = |bitmap: RoaringBitmap| bitmap.iter().collect::<Vec<_>>();
+        assert_eq!(ids(set.lookup(&engine, "by_status", &[b"active"]).await.unwrap()), vec![65_535, 65_536]);
+        assert_eq!(ids(set.live_rows(&engine).await.unwrap()), vec![65_535, 65_536]);
+
+        // 更新只改写行号所在的块
+        put(&engine, &set, 2, row("closed", Some("us"))).await;
+        assert_eq!(stored(&engine, &chunk(0)).await.unwrap(), first);
+        assert!(stored(&engine, &chunk(1)).await.is_none());
+
+        // 为已有行号的行补建索引：沿用原行号，不推进计数
+        let by_region = BitmapIndexSet::new("orders", vec![BitmapIndex::new("by_region_v2", 2)]);
+        assert_eq!(by_region.rebuild(&engine).await.unwrap(), 2);
+        assert_eq!(ids(by_region.lookup(&engine, "by_region_v2", &[b"us"]).await.unwrap()), vec![65_536]);
+        assert_eq!(stored(&engine, &codec::row_id_counter_key("orders")).await.unwrap(), Value::from(65_537u32.to_be_bytes().to_vec()));
+    }
+
+    #[tokio::test]
+    async fn test_combined_predicates_resolve_to_record_keys() {
+        let engine = engine().await;
+        for (id, status, region) in [(1, "active", "eu"), (2, "active", "us"), (3, "closed", "eu"), (4, "active", "eu")] {
+            let key = codec::record_key("orders", &[Datum::Int(id)]);
+            engine.put(&key, &Value::from(row(status, Some(region))), &StorageContext::default(), &StorageOptions::default()).await.unwrap();
+        }
+        // 索引建立在已有数据之上
+        let set = indexes();
+        assert_eq!(set.rebuild(&engine).await.unwrap(), 4);
+
+        // status = 'active' AND NOT region = 'us'
+        let active = set.lookup(&engine, "by_status", &[b"active"]).await.unwrap();
+        let us = set.lookup(&engine, "by_region", &[b"us"]).await.unwrap();
+        let keys = set.record_keys(&engine, &active.and_not(&us)).await.unwrap();
+        let ids: Vec<_> = keys
+            .iter()
+            .map(|key| codec::decode_key_datums(&key[codec::record_prefix("orders").len()..]).unwrap())
+            .collect();
+        assert_eq!(ids, vec![vec![Datum::Int(1)], vec![Datum::Int(4)]]);
+
+        // NOT 以存活行为全集
+        let not_active = set.live_rows(&engine).await.unwrap().and_not(&active);
+        assert_eq!(not_active.iter().collect::<Vec<_>>(), vec![2]);
+    }
+}
@@ -0,0 +1,13 @@
+//! 二级索引
+//!
+//! - `roaring`：Roaring 压缩位图，数组/位图两种容器，支持与、或、差运算
+//! - `bitmap`：基于 Roaring 位图的低基数列二级索引，随行写入/删除维护
+//! - `zone_map`：按行键区间保存的 min/max/NULL 计数与布隆过滤器摘要，扫描时跳过不可能匹配的区间
+
+pub mod bitmap;
+pub mod roaring;
+pub mod zone_map;
+
+pub use bitmap::{index_value, BitmapIndex, BitmapIndexSet};
+pub use roaring::RoaringBitmap;
+pub use zone_map::{ZoneCmp, ZoneMap, ZoneMapConfig, ZonePredicate, ZoneSynopsis};
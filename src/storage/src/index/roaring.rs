@@ -0,0 +1,577 @@
+//! Roaring 压缩位图
+//!
+//! 32 位行号按高 16 位分桶，每桶一个容器：基数不超过 4096 时用有序 `u16` 数组，
+//! 超过后换成 65536 位的定长位图。稀疏和稠密的桶各自取更省空间的表示，
+//! 低基数列上每个取值的行集合通常只占几 KB。
+//!
+//! 位图容器之间的与/或/差按 64 位字逐个运算，循环体是定长切片上的逐元素操作，
+//! 编译器会把它向量化为目标平台的 SIMD 指令 (SSE2/AVX2/NEON)，不依赖特定指令集。
+
+use crate::common::StorageError;
+
+/// 数组容器的最大基数，超过即转为位图容器
+const ARRAY_MAX: usize = 4096;
+/// 位图容器的 64 位字数 (2^16 位)
+const BITMAP_WORDS: usize = 1024;
+/// 序列化格式版本
+const FORMAT_VERSION: u8 = 1;
+const KIND_ARRAY: u8 = 0;
+const KIND_BITMAP: u8 = 1;
+
+#[derive(Clone, PartialEq, Eq)]
+enum Container {
+    Array(Vec<u16>),
+    Bitmap { words: Box<[u64; BITMAP_WORDS]>, cardinality: u32 },
+}
+
+impl Container {
+    fn len(&self) -> usize {
+        match self {
+            Container::Array(values) => values.len(),
+            Container::Bitmap { cardinality, .. } => *cardinality as usize,
+        }
+    }
+
+    fn contains(&self, low: u16) -> bool {
+        match self {
+            Container::Array(values) => values.binary_search(&low).is_ok(),
+            Container::Bitmap { words, .. } => words[low as usize / 64] & (1 << (low % 64)) != 0,
+        }
+    }
+
+    fn insert(&mut self, low: u16) -> bool {
+        match self {
+            Container::Array(values) => match values.binary_search(&low) {
+                Ok(_) => false,
+                Err(pos) => {
+                    values.insert(pos, low);
+                    if values.len() > ARRAY_MAX {
+                        *self = Container::bitmap_from_array(values);
+                    }
+                    true
+                }
+            },
+            Container::Bitmap { words, cardinality } => {
+                let (word, bit) = (low as usize / 64, 1u64 << (low % 64));
+                let inserted = words[word] & bit == 0;
+                words[word] |= bit;
+                *cardinality += inserted as u32;
+                inserted
+            }
+        }
+    }
+
+    fn remove(&mut self, low: u16) -> bool {
+        let removed = match self {
+            Container::Array(values) => match values.binary_search(&low) {
+                Ok(pos) => {
+                    values.remove(pos);
+                    true
+                }
+                Err(_) => false,
+            },
+            Container::Bitmap { words, cardinality } => {
+                let (word, bit) = (low as usize / 64, 1u64 << (low % 64));
+                let removed = words[word] & bit != 0;
+                words[word] &= !bit;
+                *cardinality -= removed as u32;
+                removed
+            }
+        };
+        if removed {
+            self.shrink();
+        }
+        removed
+    }
+
+    fn bitmap_from_array(values: &[u16]) -> Container {
+        let mut words = Box::new([0u64; BITMAP_WORDS]);
+        for &low in values {
+            words[low as usize / 64] |= 1 << (low % 64);
+        }
+        Container::Bitmap { words, cardinality: values.len() as u32 }
+    }
+
+    /// 运算结果的位图容器，基数较小时转为数组
+    fn from_words(words: Box<[u64; BITMAP_WORDS]>) -> Option<Container> {
+        let cardinality: u32 = words.iter().map(|w| w.count_ones()).sum();
+        let mut container = Container::Bitmap { words, cardinality };
+        container.shrink();
+        (cardinality > 0).then_some(container)
+    }
+
+    fn shrink(&mut self) {
+        if let Container::Bitmap { words, cardinality } = self {
+            if *cardinality as usize <= ARRAY_MAX {
+                *self = Container::Array(bitmap_values(words).collect());
+            }
+        }
+    }
+
+    fn and(&self, other: &Container) -> Option<Container> {
+        let result = match (self, other) {
+            (Container::Bitmap { words: a, .. }, Container::Bitmap { words: b, .. }) => {
+                return Container::from_words(zip_words(a, b, |x, y| x & y));
+            }
+            (Container::Array(a), Container::Array(b)) => intersect_sorted(a, b),
+            (Container::Array(values), bitmap @ Container::Bitmap { .. })
+            | (bitmap @ Container::Bitmap { .. }, Container::Array(values)) => {
+                values.iter().copied().filter(|&low| bitmap.contains(low)).collect()
+            }
+        };
+        (!result.is_empty()).then_some(Container::Array(result))
+    }
+
+    fn or(&self, other: &Container) -> Container {
+        match (self, other) {
+            (Container::Bitmap { words: a, .. }, Container::Bitmap { words: b, .. }) => {
+                Container::from_words(zip_words(a, b, |x, y| x | y)).expect("union of non-empty containers")
+            }
+            (Container::Array(a), Container::Array(b)) => {
+                let merged = union_sorted(a, b);
+                if merged.len() > ARRAY_MAX {
+                    Container::bitmap_from_array(&merged)
+                } else {
+                    Container::Array(merged)
+                }
+            }
+            (Container::Array(values), bitmap @ Container::Bitmap { .. })
+            | (bitmap @ Container::Bitmap { .. }, Container::Array(values)) => {
+                let mut result = bitmap.clone();
+                for &low in values {
+                    result.insert(low);
+                }
+                result
+            }
+        }
+    }
+
+    fn and_not(&self, other: &Container) -> Option<Container> {
+        match (self, other) {
+            (Container::Bitmap { words: a, .. }, Container::Bitmap { words: b, .. }) => {
+                Container::from_words(zip_words(a, b, |x, y| x & !y))
+            }
+            (Container::Bitmap { words, .. }, Container::Array(values)) => {
+                let mut words = words.clone();
+                for &low in values {
+                    words[low as usize / 64] &= !(1 << (low % 64));
+                }
+                Container::from_words(words)
+            }
+            (Container::Array(values), other) => {
+                let result: Vec<u16> = values.iter().copied().filter(|&low| !other.contains(low)).collect();
+                (!result.is_empty()).then_some(Container::Array(result))
+            }
+        }
+    }
+
+    fn iter(&self) -> Box<dyn Iterator<Item = u16> + '_> {
+        match self {
+            Container::Array(values) => Box::new(values.iter().copied()),
+            Container::Bitmap { words, .. } => Box::new(bitmap_values(words)),
+        }
+    }
+}
+
+/// 两个位图容器逐字运算；定长数组上的逐元素循环会被自动向量化
+fn zip_words(a: &[u64; BITMAP_WORDS], b: &[u64; BITMAP_WORDS], op: impl Fn(u64, u64) -> u64) -> Box<[u64; BITMAP_WORDS]> {
+    let mut out = Box::new([0u64; BITMAP_WORDS]);
+    for ((o, &x), &y) in out.iter_mut().zip(a.iter()).zip(b.iter()) {
+        *o = op(x, y);
+    }
+    out
+}
+
+fn bitmap_values(words: &[u64; BITMAP_WORDS]) -> impl Iterator<Item = u16> + '_ {
+    words.iter().enumerate().flat_map(|(index, &word)| {
+        let mut remaining = word;
+        std::iter::from_fn(move || {
+            (remaining != 0).then(|| {
+                let bit = remaining.trailing_zeros();
+                remaining &= remaining - 1;
+                (index * 64) as u16 + bit as u16
+            })
+        })
+    })
+}
+
+fn intersect_sorted(a: &[u16], b: &[u16]) -> Vec<u16> {
+    let (mut i, mut j, mut out) = (0, 0, Vec::with_capacity(a.len().min(b.len())));
+    while i < a.len() && j < b.len() {
+        match a[i].cmp(&b[j]) {
+            std::cmp::Ordering::Less => i += 1,
+            std::cmp::Ordering::Greater => j += 1,
+            std::cmp::Ordering::Equal => {
+                out.push(a[i]);
+                i += 1;
+                j += 1;
+            }
+        }
+    }
+    out
+}
+
+fn union_sorted(a: &[u16], b: &[u16]) -> Vec<u16> {
+    let (mut i, mut j, mut out) = (0, 0, Vec::with_capacity(a.len() + b.len()));
+    while i < a.len() && j < b.len() {
+        match a[i].cmp(&b[j]) {
+            std::cmp::Ordering::Less => {
+                out.push(a[i]);
+                i += 1;
+            }
+            std::cmp::Ordering::Greater => {
+                out.push(b[j]);
+                j += 1;
+            }
+            std::cmp::Ordering::Equal => {
+                out.push(a[i]);
+                i += 1;
+                j += 1;
+            }
+        }
+    }
+    out.extend_from_slice(&a[i..]);
+    out.extend_from_slice(&b[j..]);
+    out
+}
+
+/// Roaring 压缩位图
+#[derive(Clone, Default, PartialEq, Eq)]
+pub struct RoaringBitmap {
+    /// 各容器的高 16 位，升序
+    keys: Vec<u16>,
+    containers: Vec<Container>,
+}
+
+impl std::fmt::Debug for RoaringBitmap {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        write!(f, "RoaringBitmap {{ len: {}, containers: {} }}", self.len(), self.containers.len())
+    }
+}
+
+fn split(value: u32) -> (u16, u16) {
+    ((value >> 16) as u16, value as u16)
+}
+
+impl RoaringBitmap {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    pub fn len(&self) -> u64 {
+        self.containers.iter().map(|c| c.len() as u64).sum()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.containers.is_empty()
+    }
+
+    pub fn contains(&self, value: u32) -> bool {
+        let (high, low) = split(value);
+        self.keys.binary_search(&high).map(|i| self.containers[i].contains(low)).unwrap_or(false)
+    }
+
+    /// 插入，原本不存在时返回 true
+    pub fn insert(&mut self, value: u32) -> bool {
+        let (high, low) = split(value);
+        match self.keys.binary_search(&high) {
+            Ok(i) => self.containers[i].insert(low),
+            Err(i) => {
+                self.keys.insert(i, high);
+                self.containers.insert(i, Container::Array(vec![low]));
+                true
+            }
+        }
+    }
+
+    /// 删除，原本存在时返回 true
+    pub fn remove(&mut self, value: u32) -> bool {
+        let (high, low) = split(value);
+        let Ok(i) = self.keys.binary_search(&high) else { return false };
+        let removed = self.containers[i].remove(low);
+        if self.containers[i].len() == 0 {
+            self.keys.remove(i);
+            self.containers.remove(i);
+        }
+        removed
+    }
+
+    /// 值所在的块号，即它所在容器的高 16 位
+    pub fn chunk_of(value: u32) -> u16 {
+        split(value).0
+    }
+
+    /// 按容器拆分为单块位图，块号升序
+    pub fn into_chunks(self) -> impl Iterator<Item = (u16, RoaringBitmap)> {
+        self.keys
+            .into_iter()
+            .zip(self.containers)
+            .map(|(high, container)| (high, RoaringBitmap { keys: vec![high], containers: vec![container] }))
+    }
+
+    /// 合并各块位图：按块号升序给出时直接拼接容器，否则退化为求并
+    pub fn from_chunks(chunks: impl IntoIterator<Item = RoaringBitmap>) -> RoaringBitmap {
+        let mut result = RoaringBitmap::new();
+        for chunk in chunks {
+            let ordered = match (result.keys.last(), chunk.keys.first()) {
+                (Some(last), Some(first)) => last < first,
+                _ => true,
+            };
+            if ordered {
+                result.keys.extend(chunk.keys);
+                result.containers.extend(chunk.containers);
+            } else {
+                result = result.or(&chunk);
+            }
+        }
+        result
+    }
+
+    /// 升序遍历
+    pub fn iter(&self) -> impl Iterator<Item = u32> + '_ {
+        self.keys
+            .iter()
+            .zip(&self.containers)
+            .flat_map(|(&high, container)| container.iter().map(move |low| (high as u32) << 16 | low as u32))
+    }
+
+    /// 交集
+    pub fn and(&self, other: &RoaringBitmap) -> RoaringBitmap {
+        let mut result = RoaringBitmap::new();
+        let (mut i, mut j) = (0, 0);
+        while i < self.keys.len() && j < other.keys.len() {
+            match self.keys[i].cmp(&other.keys[j]) {
+                std::cmp::Ordering::Less => i += 1,
+                std::cmp::Ordering::Greater => j += 1,
+                std::cmp::Ordering::Equal => {
+                    if let Some(container) = self.containers[i].and(&other.containers[j]) {
+                        result.keys.push(self.keys[i]);
+                        result.containers.push(container);
+                    }
+                    i += 1;
+                    j += 1;
+                }
+            }
+        }
+        result
+    }
+
+    /// 并集
+    pub fn or(&self, other: &RoaringBitmap) -> RoaringBitmap {
+        let mut result = RoaringBitmap::new();
+        let (mut i, mut j) = (0, 0);
+        while i < self.keys.len() || j < other.keys.len() {
+            let next = match (self.keys.get(i), other.keys.get(j)) {
+                (Some(a), Some(b)) => a.cmp(b),
+                (Some(_), None) => std::cmp::Ordering::Less,
+                _ => std::cmp::Ordering::Greater,
+            };
+            match next {
+                std::cmp::Ordering::Less => {
+                    result.keys.push(self.keys[i]);
+                    result.containers.push(self.containers[i].clone());
+                    i += 1;
+                }
+                std::cmp::Ordering::Greater => {
+                    result.keys.push(other.keys[j]);
+                    result.containers.push(other.containers[j].clone());
+                    j += 1;
+                }
+                std::cmp::Ordering::Equal => {
+                    result.keys.push(self.keys[i]);
+                    result.containers.push(self.containers[i].or(&other.containers[j]));
+                    i += 1;
+                    j += 1;
+                }
+            }
+        }
+        result
+    }
+
+    /// 差集：在 `self` 中而不在 `other` 中
+    pub fn and_not(&self, other: &RoaringBitmap) -> RoaringBitmap {
+        let mut result = RoaringBitmap::new();
+        for (i, &high) in self.keys.iter().enumerate() {
+            let container = match other.keys.binary_search(&high) {
+                Ok(j) => self.containers[i].and_not(&other.containers[j]),
+                Err(_) => Some(self.containers[i].clone()),
+            };
+            if let Some(container) = container {
+                result.keys.push(high);
+                result.containers.push(container);
+            }
+        }
+        result
+    }
+
+    /// 序列化：版本号、容器数，之后每个容器依次为高 16 位、类型、基数和数据 (均为小端)
+    pub fn to_bytes(&self) -> Vec<u8> {
+        let payload: usize = self
+            .containers
+            .iter()
+            .map(|c| match c {
+                Container::Array(values) => values.len() * 2,
+                Container::Bitmap { .. } => BITMAP_WORDS * 8,
+            })
+            .sum();
+        let mut out = Vec::with_capacity(5 + self.containers.len() * 7 + payload);
+        out.push(FORMAT_VERSION);
+        out.extend_from_slice(&(self.containers.len() as u32).to_le_bytes());
+        for (&high, container) in self.keys.iter().zip(&self.containers) {
+            out.extend_from_slice(&high.to_le_bytes());
+            match container {
+                Container::Array(values) => {
+                    out.push(KIND_ARRAY);
+                    out.extend_from_slice(&(values.len() as u32).to_le_bytes());
+                    values.iter().for_each(|v| out.extend_from_slice(&v.to_le_bytes()));
+                }
+                Container::Bitmap { words, cardinality } => {
+                    out.push(KIND_BITMAP);
+                    out.extend_from_slice(&cardinality.to_le_bytes());
+                    words.iter().for_each(|w| out.extend_from_slice(&w.to_le_bytes()));
+                }
+            }
+        }
+        out
+    }
+
+    /// 反序列化 `to_bytes` 的输出
+    pub fn from_bytes(bytes: &[u8]) -> Result<Self, StorageError> {
+        let corrupt = |what: &str| StorageError::Deserialization(format!("corrupt roaring bitmap: {}", what));
+        let mut reader = bytes;
+        let mut take = |n: usize| -> Result<&[u8], StorageError> {
+            if reader.len() < n {
+                return Err(corrupt("truncated"));
+            }
+            let (head, rest) = reader.split_at(n);
+            reader = rest;
+            Ok(head)
+        };
+
+        if take(1)?[0] != FORMAT_VERSION {
+            return Err(corrupt("unknown format version"));
+        }
+        let count = u32::from_le_bytes(take(4)?.try_into().unwrap()) as usize;
+        let mut bitmap = RoaringBitmap::new();
+        for _ in 0..count {
+            let high = u16::from_le_bytes(take(2)?.try_into().unwrap());
+            let kind = take(1)?[0];
+            let cardinality = u32::from_le_bytes(take(4)?.try_into().unwrap());
+            let container = match kind {
+                KIND_ARRAY => {
+                    let values: Vec<u16> = take(cardinality as usize * 2)?
+                        .chunks_exact(2)
+                        .map(|c| u16::from_le_bytes([c[0], c[1]]))
+                        .collect();
+                    if values.is_empty() || values.len() > ARRAY_MAX || values.windows(2).any(|w| w[0] >= w[1]) {
+                        return Err(corrupt("invalid array container"));
+                    }
+                    Container::Array(values)
+                }
+                KIND_BITMAP => {
+                    let mut words = Box::new([0u64; BITMAP_WORDS]);
+                    for (word, chunk) in words.iter_mut().zip(take(BITMAP_WORDS * 8)?.chunks_exact(8)) {
+                        *word = u64::from_le_bytes(chunk.try_into().unwrap());
+                    }
+                    if words.iter().map(|w| w.count_ones()).sum::<u32>() != cardinality {
+                        return Err(corrupt("bitmap cardinality mismatch"));
+                    }
+                    Container::Bitmap { words, cardinality }
+                }
+                _ => return Err(corrupt("unknown container kind")),
+            };
+            if bitmap.keys.last().is_some_and(|&last| last >= high) {
+                return Err(corrupt("container keys out of order"));
+            }
+            bitmap.keys.push(high);
+            bitmap.containers.push(container);
+        }
+        if !reader.is_empty() {
+            return Err(corrupt("trailing bytes"));
+        }
+        Ok(bitmap)
+    }
+}
+
+impl FromIterator<u32> for RoaringBitmap {
+    fn from_iter<I: IntoIterator<Item = u32>>(iter: I) -> Self {
+        let mut bitmap = RoaringBitmap::new();
+        for value in iter {
+            bitmap.insert(value);
+        }
+        bitmap
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::collections::BTreeSet;
+
+    /// 覆盖数组容器、位图容器以及跨桶的值
+    fn sample(seed: u32, count: u32, stride: u32) -> (RoaringBitmap, BTreeSet<u32>) {
+        let values: BTreeSet<u32> = (0..count).map(|i| (i * stride + seed) % 300_000).collect();
+        (values.iter().copied().collect(), values)
+    }
+
+    #[test]
+    fn test_insert_remove_and_container_conversion() {
+        let mut bitmap = RoaringBitmap::new();
+        for value in 0..5000 {
+            assert!(bitmap.insert(value));
+        }
+        assert!(!bitmap.insert(42));
+        assert!(matches!(bitmap.containers[0], Container::Bitmap { cardinality: 5000, .. }));
+
+        for value in 0..1000 {
+            assert!(bitmap.remove(value));
+        }
+        assert!(!bitmap.remove(1));
+        // 降到 4096 以下后转回数组容器
+        assert!(matches!(&bitmap.containers[0], Container::Array(values) if values.len() == 4000));
+        assert!(bitmap.contains(4999) && !bitmap.contains(999));
+        assert_eq!(bitmap.iter().next(), Some(1000));
+        assert_eq!(bitmap.len(), 4000);
+    }
+
+    #[test]
+    fn test_set_operations_match_btreeset() {
+        let (a, a_set) = sample(7, 40_000, 3);
+        let (b, b_set) = sample(11, 9_000, 17);
+        let (c, c_set) = sample(3, 200, 1);
+
+        for (x, x_set, y, y_set) in [(&a, &a_set, &b, &b_set), (&b, &b_set, &c, &c_set), (&a, &a_set, &c, &c_set)] {
+            assert_eq!(x.and(y).iter().collect::<Vec<_>>(), x_set.intersection(y_set).copied().collect::<Vec<_>>());
+            assert_eq!(x.or(y).iter().collect::<Vec<_>>(), x_set.union(y_set).copied().collect::<Vec<_>>());
+            assert_eq!(x.and_not(y).iter().collect::<Vec<_>>(), x_set.difference(y_set).copied().collect::<Vec<_>>());
+            assert_eq!(y.and_not(x).iter().collect::<Vec<_>>(), y_set.difference(x_set).copied().collect::<Vec<_>>());
+        }
+        assert!(a.and_not(&a).is_empty());
+    }
+
+    #[test]
+    fn test_serialization_round_trip() {
+        let (bitmap, _) = sample(5, 70_000, 2);
+        let bytes = bitmap.to_bytes();
+        assert_eq!(RoaringBitmap::from_bytes(&bytes).unwrap(), bitmap);
+        assert_eq!(RoaringBitmap::from_bytes(&RoaringBitmap::new().to_bytes()).unwrap(), RoaringBitmap::new());
+
+        assert!(RoaringBitmap::from_bytes(&bytes[..bytes.len() - 1]).is_err());
+        let mut wrong_version = bytes.clone();
+        wrong_version[0] = 9;
+        assert!(RoaringBitmap::from_bytes(&wrong_version).is_err());
+    }
+
+    #[test]
+    fn test_split_into_chunks_and_merge() {
+        let (bitmap, _) = sample(5, 70_000, 2);
+        let chunks: Vec<_> = bitmap.clone().into_chunks().collect();
+        assert_eq!(chunks.iter().map(|(chunk, _)| *chunk).collect::<Vec<_>>(), vec![0, 1, 2]);
+        assert!(chunks.iter().all(|(chunk, part)| part.iter().all(|v| RoaringBitmap::chunk_of(v) == *chunk)));
+
+        let parts: Vec<_> = chunks.into_iter().map(|(_, part)| part).collect();
+        assert_eq!(RoaringBitmap::from_chunks(parts.clone()), bitmap);
+        // 乱序给出时结果相同
+        assert_eq!(RoaringBitmap::from_chunks(parts.into_iter().rev()), bitmap);
+    }
+}
@@ -0,0 +1,522 @@
+//! 区间摘要 (zone map)
+//!
+//! 表的行键空间按写入顺序切成连续的区间，每个区间为被跟踪的列保存 min/max 与 NULL
+//! 计数，可选地再保存一个布隆过滤器。扫描前先用谓词检查摘要，跳过不可能有匹配行的区间。
+//!
+//! 区间 i 覆盖 `[start_i, start_{i+1})`，第一个区间从行键前缀开始，整张表总被覆盖。
+//! 追加的行落在末尾区间，末尾区间写满后遇到更大的行键时开启新区间；落在中间的写入
+//! 只放宽所在区间的摘要。删除不收缩摘要：摘要始终覆盖区间内的数据，跳过总是安全的，
+//! `rebuild` 按当前数据重新计算。min/max 以 memcomparable 编码保存和比较。
+
+use std::collections::BTreeMap;
+use std::ops::Bound;
+
+use crate::codec::{self, Datum, RowView};
+use crate::common::{Key, KeyValue, StorageContext, StorageError, StorageOptions, Value};
+use crate::engine::scan::DEFAULT_SCAN_PAGE_SIZE;
+use crate::engine::StorageEngine;
+
+const FORMAT_VERSION: u8 = 1;
+const BLOOM_HASHES: u64 = 3;
+
+/// 区间摘要配置
+#[derive(Debug, Clone)]
+pub struct ZoneMapConfig {
+    /// 末尾区间达到该行数后开启新区间
+    pub rows_per_zone: u64,
+    /// 保存 min/max/NULL 计数的列 ID
+    pub columns: Vec<u32>,
+    /// 额外保存布隆过滤器的列 ID，用于等值谓词
+    pub bloom_columns: Vec<u32>,
+    /// 每个布隆过滤器的位数，向上取整到 64 的倍数
+    pub bloom_bits: usize,
+}
+
+impl Default for ZoneMapConfig {
+    fn default() -> Self {
+        Self {
+            rows_per_zone: 1024,
+            columns: Vec::new(),
+            bloom_columns: Vec::new(),
+            bloom_bits: 16 * 1024,
+        }
+    }
+}
+
+/// 比较运算
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum ZoneCmp {
+    Eq,
+    Lt,
+    Le,
+    Gt,
+    Ge,
+}
+
+/// 可用摘要判断的谓词，多个谓词之间是 AND 关系
+#[derive(Debug, Clone, PartialEq)]
+pub enum ZonePredicate {
+    Compare { column_id: u32, op: ZoneCmp, value: Datum },
+    IsNull(u32),
+    IsNotNull(u32),
+}
+
+/// 一列在一个区间内的摘要
+#[derive(Debug, Clone, Default, PartialEq)]
+pub struct ColumnSynopsis {
+    /// 非 NULL 值的最小/最大值 (memcomparable 编码)，全为 NULL 时为 None
+    pub min: Option<Vec<u8>>,
+    pub max: Option<Vec<u8>>,
+    pub null_count: u64,
+    bloom: Option<Vec<u64>>,
+}
+
+impl ColumnSynopsis {
+    fn observe(&mut self, datum: &Datum) {
+        if matches!(datum, Datum::Null) {
+            self.null_count += 1;
+            return;
+        }
+        let encoded = codec::encode_key_datums(std::slice::from_ref(datum)).to_vec();
+        if let Some(bloom) = &mut self.bloom {
+            for bit in bloom_positions(&encoded, bloom.len() as u64 * 64) {
+                bloom[(bit / 64) as usize] |= 1 << (bit % 64);
+            }
+        }
+        if self.min.as_ref().map_or(true, |min| encoded < *min) {
+            self.min = Some(encoded.clone());
+        }
+        if self.max.as_ref().map_or(true, |max| encoded > *max) {
+            self.max = Some(encoded);
+        }
+    }
+
+    fn may_match(&self, op: ZoneCmp, value: &Datum) -> bool {
+        // 与 NULL 比较永远不为真
+        if matches!(value, Datum::Null) {
+            return false;
+        }
+        // 区间内这一列全为 NULL
+        let (Some(min), Some(max)) = (&self.min, &self.max) else { return false };
+        let encoded = codec::encode_key_datums(std::slice::from_ref(value)).to_vec();
+        // 类型不同时 memcomparable 顺序没有意义，不做判断
+        if encoded[0] != min[0] || encoded[0] != max[0] {
+            return true;
+        }
+        match op {
+            ZoneCmp::Eq => {
+                *min <= encoded && encoded <= *max
+                    && self.bloom.as_ref().map_or(true, |bloom| {
+                        bloom_positions(&encoded, bloom.len() as u64 * 64)
+                            .all(|bit| bloom[(bit / 64) as usize] & (1 << (bit % 64)) != 0)
+                    })
+            }
+            ZoneCmp::Lt => *min < encoded,
+            ZoneCmp::Le => *min <= encoded,
+            ZoneCmp::Gt => *max > encoded,
+            ZoneCmp::Ge => *max >= encoded,
+        }
+    }
+}
+
+/// 持久化的哈希必须跨进程稳定，使用 FNV-1a 而不是标准库的随机化哈希
+fn bloom_hash(bytes: &[u8]) -> u64 {
+    bytes.iter().fold(0xcbf2_9ce4_8422_2325u64, |hash, &b| (hash ^ b as u64).wrapping_mul(0x0100_0000_01b3))
+}
+
+fn bloom_positions(encoded: &[u8], num_bits: u64) -> impl Iterator<Item = u64> {
+    // 双重哈希：h1 + i * h2
+    let h1 = bloom_hash(encoded);
+    let h2 = h1.rotate_left(32) | 1;
+    (0..BLOOM_HASHES).map(move |i| h1.wrapping_add(i.wrapping_mul(h2)) % num_bits)
+}
+
+/// 一个区间的摘要
+#[derive(Debug, Clone, Default, PartialEq)]
+pub struct ZoneSynopsis {
+    /// 写入次数，覆盖写也计入，只用于决定何时开启新区间
+    pub row_count: u64,
+    /// 区间内出现过的最大行键 (去掉行键前缀)
+    pub last_key: Vec<u8>,
+    pub columns: BTreeMap<u32, ColumnSynopsis>,
+}
+
+impl ZoneSynopsis {
+    pub fn new(config: &ZoneMapConfig) -> Self {
+        let bloom_words = config.bloom_bits.div_ceil(64).max(1);
+        let columns = config
+            .columns
+            .iter()
+            .chain(&config.bloom_columns)
+            .map(|&column_id| {
+                let bloom = config.bloom_columns.contains(&column_id).then(|| vec![0; bloom_words]);
+                (column_id, ColumnSynopsis { bloom, ..ColumnSynopsis::default() })
+            })
+            .collect();
+        Self { columns, ..Self::default() }
+    }
+
+    /// 把一行计入摘要
+    pub fn observe(&mut self, key_suffix: &[u8], row: &RowView<'_>) -> Result<(), StorageError> {
+        for (&column_id, synopsis) in &mut self.columns {
+            synopsis.observe(&row.get(column_id)?);
+        }
+        self.row_count += 1;
+        if key_suffix > self.last_key.as_slice() {
+            self.last_key = key_suffix.to_vec();
+        }
+        Ok(())
+    }
+
+    /// 区间内是否可能有满足全部谓词的行；未被跟踪的列不参与判断
+    pub fn may_match(&self, predicates: &[ZonePredicate]) -> bool {
+        predicates.iter().all(|predicate| match predicate {
+            ZonePredicate::Compare { column_id, op, value } => {
+                self.columns.get(column_id).map_or(true, |c| c.may_match(*op, value))
+            }
+            ZonePredicate::IsNull(column_id) => self.columns.get(column_id).map_or(true, |c| c.null_count > 0),
+            ZonePredicate::IsNotNull(column_id) => {
+                self.columns.get(column_id).map_or(true, |c| c.null_count < self.row_count)
+            }
+        })
+    }
+
+    /// 编码：版本、行数、最大行键，然后逐列写出 ID、NULL 计数、min、max 与布隆过滤器
+    pub fn to_bytes(&self) -> Vec<u8> {
+        fn put_bytes(out: &mut Vec<u8>, bytes: Option<&[u8]>) {
+            match bytes {
+                Some(bytes) => {
+                    out.extend_from_slice(&(bytes.len() as u32 + 1).to_be_bytes());
+                    out.extend_from_slice(bytes);
+                }
+                None => out.extend_from_slice(&0u32.to_be_bytes()),
+            }
+        }
+        let mut out = vec![FORMAT_VERSION];
+        out.extend_from_slice(&self.row_count.to_be_bytes());
+        put_bytes(&mut out, Some(&self.last_key));
+        out.extend_from_slice(&(self.columns.len() as u32).to_be_bytes());
+        for (column_id, synopsis) in &self.columns {
+            out.extend_from_slice(&column_id.to_be_bytes());
+            out.extend_from_slice(&synopsis.null_count.to_be_bytes());
+            put_bytes(&mut out, synopsis.min.as_deref());
+            put_bytes(&mut out, synopsis.max.as_deref());
+            let bloom: Option<Vec<u8>> = synopsis.bloom.as_ref().map(|words| words.iter().flat_map(|w| w.to_le_bytes()).collect());
+            put_bytes(&mut out, bloom.as_deref());
+        }
+        out
+    }
+
+    pub fn from_bytes(bytes: &[u8]) -> Result<Self, StorageError> {
+        fn take_u32(bytes: &[u8], pos: &mut usize) -> Result<u32, StorageError> {
+            Ok(u32::from_be_bytes(codec::take_bytes(bytes, pos, 4, "zone synopsis")?.try_into().unwrap()))
+        }
+        fn take_u64(bytes: &[u8], pos: &mut usize) -> Result<u64, StorageError> {
+            Ok(u64::from_be_bytes(codec::take_bytes(bytes, pos, 8, "zone synopsis")?.try_into().unwrap()))
+        }
+        fn take_opt(bytes: &[u8], pos: &mut usize) -> Result<Option<Vec<u8>>, StorageError> {
+            match take_u32(bytes, pos)? {
+                0 => Ok(None),
+                len => Ok(Some(codec::take_bytes(bytes, pos, len as usize - 1, "zone synopsis")?.to_vec())),
+            }
+        }
+
+        let mut pos = 0;
+        let version = codec::take_bytes(bytes, &mut pos, 1, "zone synopsis")?[0];
+        if version != FORMAT_VERSION {
+            return Err(StorageError::Deserialization(format!("unsupported zone synopsis version {}", version)));
+        }
+        let row_count = take_u64(bytes, &mut pos)?;
+        let last_key = take_opt(bytes, &mut pos)?.unwrap_or_default();
+        let mut columns = BTreeMap::new();
+        for _ in 0..take_u32(bytes, &mut pos)? {
+            let column_id = take_u32(bytes, &mut pos)?;
+            let null_count = take_u64(bytes, &mut pos)?;
+            let min = take_opt(bytes, &mut pos)?;
+            let max = take_opt(bytes, &mut pos)?;
+            let bloom = match take_opt(bytes, &mut pos)? {
+                Some(raw) if raw.is_empty() || raw.len() % 8 != 0 => {
+                    return Err(StorageError::Deserialization(format!("invalid bloom filter of {} bytes", raw.len())));
+                }
+                Some(raw) => Some(raw.chunks_exact(8).map(|w| u64::from_le_bytes(w.try_into().unwrap())).collect()),
+                None => None,
+            };
+            columns.insert(column_id, ColumnSynopsis { min, max, null_count, bloom });
+        }
+        if pos != bytes.len() {
+            return Err(StorageError::Deserialization("trailing bytes after zone synopsis".to_string()));
+        }
+        Ok(Self { row_count, last_key, columns })
+    }
+}
+
+/// 一张表的区间摘要
+///
+/// 维护是读-改-写，同一张表上的写入由调用方串行化。
+#[derive(Debug, Clone)]
+pub struct ZoneMap {
+    table: String,
+    config: ZoneMapConfig,
+    record_prefix: Key,
+    /// 区间起始行键 (去掉行键前缀) -> 摘要
+    zones: BTreeMap<Vec<u8>, ZoneSynopsis>,
+}
+
+impl ZoneMap {
+    pub fn new(table: impl Into<String>, config: ZoneMapConfig) -> Self {
+        let table = table.into();
+        let record_prefix = codec::record_prefix(&table);
+        Self { table, config, record_prefix, zones: BTreeMap::new() }
+    }
+
+    /// 为表启用区间摘要：按当前数据重建
+    ///
+    /// 不信任已持久化的摘要：未启用摘要的写入方 (其他处理器实例、重启后启用之前的写入)
+    /// 不会更新摘要，沿用旧摘要会漏掉这些行。
+    pub async fn open(engine: &dyn StorageEngine, table: &str, config: ZoneMapConfig) -> Result<Self, StorageError> {
+        let mut zone_map = Self::new(table, config);
+        zone_map.rebuild(engine).await?;
+        Ok(zone_map)
+    }
+
+    /// 读取已持久化的区间摘要
+    pub async fn load(engine: &dyn StorageEngine, table: &str, config: ZoneMapConfig) -> Result<Self, StorageError> {
+        let mut zone_map = Self::new(table, config);
+        let prefix = codec::zone_map_prefix(table);
+        for (key, value) in scan_prefix(engine, &prefix).await? {
+            zone_map.zones.insert(key[prefix.len()..].to_vec(), ZoneSynopsis::from_bytes(&value)?);
+        }
+        Ok(zone_map)
+    }
+
+    pub fn table(&self) -> &str {
+        &self.table
+    }
+
+    pub fn zone_count(&self) -> usize {
+        self.zones.len()
+    }
+
+    /// 把写入的一行计入所在区间，返回需要与该行一起写入的摘要键值对
+    pub fn observe(&mut self, record_key: &[u8], value: &[u8]) -> Result<KeyValue, StorageError> {
+        let suffix = record_key.strip_prefix(self.record_prefix.as_ref()).ok_or_else(|| {
+            StorageError::Internal(format!("key does not belong to table {}", self.table))
+        })?;
+        let row = RowView::new(value)?;
+
+        let tail_start = self.zones.keys().next_back();
+        let start = match self.zones.range::<[u8], _>((Bound::Unbounded, Bound::Included(suffix))).next_back() {
+            // 追加写入且末尾区间已满：从这一行开始一个新区间
+            Some((start, zone))
+                if Some(start) == tail_start
+                    && zone.row_count >= self.config.rows_per_zone
+                    && suffix > zone.last_key.as_slice() =>
+            {
+                suffix.to_vec()
+            }
+            Some((start, _)) => start.clone(),
+            // 第一个区间从行键前缀开始，覆盖整张表
+            None => Vec::new(),
+        };
+
+        let zone = self.zones.entry(start.clone()).or_insert_with(|| ZoneSynopsis::new(&self.config));
+        zone.observe(suffix, &row)?;
+        Ok((codec::zone_map_key(&self.table, &start), Value::from(zone.to_bytes())))
+    }
+
+    /// 需要扫描的行键范围：可能有匹配行的区间，相邻区间合并为一个范围
+    pub fn candidate_ranges(&self, predicates: &[ZonePredicate]) -> Vec<(Key, Key)> {
+        let table_end = codec::prefix_end(&self.record_prefix);
+        if self.zones.is_empty() {
+            return vec![(self.record_prefix.clone(), table_end)];
+        }
+
+        let full_key = |suffix: &[u8]| -> Key { [self.record_prefix.as_ref(), suffix].concat().into() };
+        let starts: Vec<&Vec<u8>> = self.zones.keys().collect();
+        let mut ranges: Vec<(Key, Key)> = Vec::new();
+        let mut extends_last = false;
+        for (i, (start, zone)) in self.zones.iter().enumerate() {
+            if !zone.may_match(predicates) {
+                extends_last = false;
+                continue;
+            }
+            let end = starts.get(i + 1).map(|next| full_key(next)).unwrap_or_else(|| table_end.clone());
+            match ranges.last_mut() {
+                Some(last) if extends_last => last.1 = end,
+                _ => ranges.push((full_key(start), end)),
+            }
+            extends_last = true;
+        }
+        ranges
+    }
+
+    /// 按表中当前数据重新计算全部区间，返回处理的行数
+    pub async fn rebuild(&mut self, engine: &dyn StorageEngine) -> Result<u64, StorageError> {
+        let (context, options) = (StorageContext::default(), StorageOptions::default());
+        let stale: Vec<Key> = scan_prefix(engine, &codec::zone_map_prefix(&self.table)).await?.into_iter().map(|(k, _)| k).collect();
+        if !stale.is_empty() {
+            engine.batch_delete(&stale, &context, &options).await?;
+        }
+
+        self.zones.clear();
+        let mut rows = 0;
+        let mut next_key = Some(self.record_prefix.clone());
+        let end = codec::prefix_end(&self.record_prefix);
+        while let Some(start_key) = next_key.take() {
+            let page = engine.scan_page(&start_key, &end, DEFAULT_SCAN_PAGE_SIZE, &context, &options).await?.value;
+            for (key, value) in &page.pairs {
+                self.observe(key, value)?;
+                rows += 1;
+            }
+            next_key = page.next_key;
+        }
+
+        let zones: Vec<KeyValue> = self
+            .zones
+            .iter()
+            .map(|(start, zone)| (codec::zone_map_key(&self.table, start), Value::from(zone.to_bytes())))
+            .collect();
+        if !zones.is_empty() {
+            engine.batch_put(&zones, &context, &options).await?;
+        }
+        Ok(rows)
+    }
+}
+
+async fn scan_prefix(engine: &dyn StorageEngine, prefix: &Key) -> Result<Vec<KeyValue>, StorageError> {
+    let (context, options) = (StorageContext::default(), StorageOptions::default());
+    let end = codec::prefix_end(prefix);
+    let mut pairs = Vec::new();
+    let mut next_key = Some(prefix.clone());
+    while let Some(start_key) = next_key.take() {
+        let page = engine.scan_page(&start_key, &end, DEFAULT_SCAN_PAGE_SIZE, &context, &options).await?.value;
+        pairs.extend(page.pairs);
+        next_key = page.next_key;
+    }
+    Ok(pairs)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::common::StorageConfig;
+    use crate::engine::MemoryEngine;
+
+    /// 列 1 为时间 (字符串)，列 2 为租户，列 3 为可空的备注
+    fn row(ts: &str, tenant: i64, note: Option<&str>) -> Vec<u8> {
+        let note = note.map(|n| Datum::Bytes(n.as_bytes().to_vec())).unwrap_or(Datum::Null);
+        codec::encode_row_with_ids(&[(1, Datum::Bytes(ts.as_bytes().to_vec())), (2, Datum::Int(tenant)), (3, note)])
+    }
+
+    fn config() -> ZoneMapConfig {
+        ZoneMapConfig { rows_per_zone: 10, columns: vec![1, 3], bloom_columns: vec![2], bloom_bits: 1024 }
+    }
+
+    fn cmp(column_id: u32, op: ZoneCmp, value: Datum) -> ZonePredicate {
+        ZonePredicate::Compare { column_id, op, value }
+    }
+
+    fn day(i: i64) -> String {
+        format!("2024-01-{:02}", i / 10 + 1)
+    }
+
+    #[test]
+    fn test_append_only_writes_split_into_zones_and_prune() {
+        let mut zone_map = ZoneMap::new("events", config());
+        for i in 0..40 {
+            let key = codec::record_key("events", &[Datum::Int(i)]);
+            // 每 10 行换一天、一个租户，最后一个区间的备注全为 NULL
+            let note = (i < 30).then_some("ok");
+            zone_map.observe(&key, &row(&day(i), i / 10, note)).unwrap();
+        }
+        assert_eq!(zone_map.zone_count(), 4);
+
+        // 时间范围只命中第 2、3 个区间，且两者相邻，合并为一个范围
+        let ranges = zone_map.candidate_ranges(&[
+            cmp(1, ZoneCmp::Ge, Datum::Bytes(b"2024-01-02".to_vec())),
+            cmp(1, ZoneCmp::Lt, Datum::Bytes(b"2024-01-04".to_vec())),
+        ]);
+        assert_eq!(ranges, vec![(codec::record_key("events", &[Datum::Int(10)]), codec::record_key("events", &[Datum::Int(30)]))]);
+
+        // 租户列带布隆过滤器，等值谓词先比 min/max 再查过滤器
+        let ranges = zone_map.candidate_ranges(&[cmp(2, ZoneCmp::Eq, Datum::Int(3))]);
+        assert_eq!(ranges, vec![(codec::record_key("events", &[Datum::Int(30)]), codec::prefix_end(&codec::record_prefix("events")))]);
+        assert_eq!(zone_map.candidate_ranges(&[cmp(2, ZoneCmp::Eq, Datum::Int(99))]).len(), 0);
+
+        // NULL 计数
+        assert_eq!(zone_map.candidate_ranges(&[ZonePredicate::IsNull(3)]).len(), 1);
+        assert_eq!(zone_map.candidate_ranges(&[ZonePredicate::IsNotNull(3)]).len(), 1);
+        assert!(zone_map.candidate_ranges(&[cmp(3, ZoneCmp::Eq, Datum::Null)]).is_empty());
+
+        // 类型不同或列未被跟踪时不跳过
+        assert_eq!(zone_map.candidate_ranges(&[cmp(1, ZoneCmp::Eq, Datum::Int(1))]).len(), 1);
+        assert_eq!(zone_map.candidate_ranges(&[cmp(9, ZoneCmp::Eq, Datum::Int(1))]).len(), 1);
+
+        // 落在中间区间的写入只放宽该区间
+        zone_map.observe(&codec::record_key("events", &[Datum::Int(5)]), &row("2030-01-01", 0, None)).unwrap();
+        assert_eq!(zone_map.zone_count(), 4);
+        let ranges = zone_map.candidate_ranges(&[cmp(1, ZoneCmp::Gt, Datum::Bytes(b"2029".to_vec()))]);
+        assert_eq!(ranges, vec![(codec::record_prefix("events"), codec::record_key("events", &[Datum::Int(10)]))]);
+    }
+
+    #[tokio::test]
+    async fn test_persisted_synopses_survive_reload_and_rebuild() {
+        let mut engine = MemoryEngine::new();
+        engine.initialize(&StorageConfig::default()).await.unwrap();
+        let (context, options) = (StorageContext::default(), StorageOptions::default());
+
+        let mut zone_map = ZoneMap::new("events", config());
+        for i in 0..25 {
+            let key = codec::record_key("events", &[Datum::Int(i)]);
+            let value = Value::from(row(&day(i), i / 10, Some("ok")));
+            let zone = zone_map.observe(&key, &value).unwrap();
+            engine.batch_put(&[zone, (key, value)], &context, &options).await.unwrap();
+        }
+
+        let loaded = ZoneMap::load(&engine, "events", config()).await.unwrap();
+        assert_eq!(loaded.zones, zone_map.zones);
+        assert_eq!(loaded.zone_count(), 3);
+
+        // 删除一个区间的全部行后重建，该区间消失
+        for i in 0..10 {
+            engine.delete(&codec::record_key("events", &[Datum::Int(i)]), &context, &options).await.unwrap();
+        }
+        let mut rebuilt = ZoneMap::new("events", config());
+        assert_eq!(rebuilt.rebuild(&engine).await.unwrap(), 15);
+        assert_eq!(rebuilt.zone_count(), 2);
+        let reloaded = ZoneMap::load(&engine, "events", config()).await.unwrap();
+        assert_eq!(reloaded.zones, rebuilt.zones);
+
+        assert!(ZoneSynopsis::from_bytes(&[FORMAT_VERSION, 0]).is_err());
+    }
+
+    #[tokio::test]
+    async fn test_open_covers_rows_written_without_zone_map() {
+        let mut engine = MemoryEngine::new();
+        engine.initialize(&StorageConfig::default()).await.unwrap();
+        let (context, options) = (StorageContext::default(), StorageOptions::default());
+
+        let mut zone_map = ZoneMap::open(&engine, "events", config()).await.unwrap();
+        for i in 0..20 {
+            let key = codec::record_key("events", &[Datum::Int(i)]);
+            let value = Value::from(row(&day(i), i / 10, Some("ok")));
+            let zone = zone_map.observe(&key, &value).unwrap();
+            engine.batch_put(&[zone, (key, value)], &context, &options).await.unwrap();
+        }
+        // 摘要停用期间 (如另一个写入方) 写入的行不会更新摘要
+        for i in 20..25 {
+            let key = codec::record_key("events", &[Datum::Int(i)]);
+            engine.put(&key, &Value::from(row("2030-01-01", 9, Some("late"))), &context, &options).await.unwrap();
+        }
+        let late = [cmp(1, ZoneCmp::Ge, Datum::Bytes(b"2030".to_vec()))];
+        assert!(ZoneMap::load(&engine, "events", config()).await.unwrap().candidate_ranges(&late).is_empty());
+
+        // 重新启用后剪枝扫描仍能找到这些行
+        let reopened = ZoneMap::open(&engine, "events", config()).await.unwrap();
+        let mut found = 0;
+        for (start, end) in reopened.candidate_ranges(&late) {
+            found += engine.scan(&start, &end, 100, &context, &options).await.unwrap().value.len();
+        }
+        assert_eq!(found, 5);
+    }
+}
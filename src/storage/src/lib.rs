@@ -9,6 +9,8 @@
 pub mod common;
 pub mod engine;
 pub mod client;
+pub mod codec;
+pub mod index;
 
 // 重新导出 common 模块
 pub use common::*;
@@ -72,8 +74,8 @@ mod tests {
         let options = StorageOptions::default();
 
         // 测试 put
-        let key = b"test_key".to_vec();
-        let value = b"test_value".to_vec();
+        let key = Bytes::from_static(b"test_key");
+        let value = Bytes::from_static(b"test_value");
         let result = engine.put(&key, &value, &context, &options).await;
         assert!(result.is_ok());
 